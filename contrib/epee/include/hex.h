@@ -70,6 +70,9 @@ namespace epee
     //! Append `src` as hex to `out`.
     static void buffer(std::ostream& out, const span<const std::uint8_t> src);
 
+    //! Write `src` as hex into `out`. \return False if `out` is not twice the length of `src`.
+    static bool buffer(span<char> out, const span<const std::uint8_t> src) noexcept;
+
     //! Append `< + src + >` as hex to `out`.
     static void formatted(std::ostream& out, const span<const std::uint8_t> src);
 
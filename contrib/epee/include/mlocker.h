@@ -30,6 +30,7 @@
 #pragma once 
 
 #include <map>
+#include <new>
 #include <boost/thread/mutex.hpp>
 
 namespace epee
@@ -48,7 +49,6 @@ namespace epee
     static void unlock(void *ptr, size_t len);
 
   private:
-    static size_t page_size;
     static size_t num_locked_objects;
 
     static boost::mutex &mutex();
@@ -60,6 +60,55 @@ namespace epee
     size_t len;
   };
 
+  /// Memory locked once up front, and handed out in fixed size slots
+  ///
+  /// Slots come from per thread free lists, so allocating and freeing them
+  /// takes no lock and no syscall in the common case. Slots are wiped when
+  /// freed. Objects living in the pool are not tracked by mlocker, since
+  /// the pool pages stay locked for the lifetime of the process.
+  class mlocked_pool
+  {
+  public:
+    static constexpr size_t min_slot_size = 32;
+    static constexpr size_t max_slot_size = 2048;
+
+    /// returns NULL if size is over max_slot_size or the pool is exhausted
+    static void *allocate(size_t size);
+    static void deallocate(void *ptr, size_t size);
+    static bool contains(const void *ptr);
+
+    static size_t get_num_slabs();
+  };
+
+  /// Allocator taking memory from mlocked_pool, and from the heap for
+  /// allocations too large for it
+  template <class T>
+  struct mlocked_allocator
+  {
+    using value_type = T;
+
+    mlocked_allocator() noexcept {}
+    template <class U> mlocked_allocator(const mlocked_allocator<U>&) noexcept {}
+
+    T *allocate(size_t n)
+    {
+      void *ptr = mlocked_pool::allocate(n * sizeof(T));
+      return static_cast<T*>(ptr ? ptr : ::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *ptr, size_t n) noexcept
+    {
+      if (mlocked_pool::contains(ptr))
+        mlocked_pool::deallocate(ptr, n * sizeof(T));
+      else
+        ::operator delete(ptr);
+    }
+  };
+
+  template <class T, class U>
+  bool operator==(const mlocked_allocator<T>&, const mlocked_allocator<U>&) noexcept { return true; }
+  template <class T, class U>
+  bool operator!=(const mlocked_allocator<T>&, const mlocked_allocator<U>&) noexcept { return false; }
+
   /// Locks memory while in scope
   ///
   /// Primarily useful for making sure that private keys don't get swapped out
@@ -64,6 +64,11 @@
 #define MONERO_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+// send() can block a handler until writes drain, so a shard needs a spare thread
+#define ABSTRACT_SERVER_THREADS_PER_SHARD 2
+// queued slices gathered into a single write (asio passes at most 64 iovecs)
+#define ABSTRACT_SERVER_SEND_BATCH_MAX_COUNT 64
+#define ABSTRACT_SERVER_SEND_BATCH_MAX_BYTES (256 * 1024)
 
 namespace epee
 {
@@ -120,6 +125,7 @@ namespace net_utils
     void start_handshake();
     void start_read();
     void start_write();
+    bool is_under_fair_share(const network_throttle_t &own, epee::net_utils::i_network_throttle &global);
     void start_shutdown();
     void cancel_socket();
 
@@ -349,6 +355,10 @@ namespace net_utils
 	const std::string port_ipv6 = "", const std::string address_ipv6 = "::", bool use_ipv6 = false, bool require_ipv4 = true,
 	ssl_options_t ssl_options = ssl_support_t::e_ssl_support_autodetect);
 
+    /// Spread connections over `count` io_services, each run by its own
+    /// threads, instead of the shared one. Must be called before `init_server`.
+    void set_io_shards(size_t count, bool pin_threads = false);
+
     /// Run the server's io_service loop.
     bool run_server(size_t threads_count, bool wait = true, const boost::thread::attributes& attrs = boost::thread::attributes());
 
@@ -470,6 +480,12 @@ namespace net_utils
   private:
     /// Run the server's io_service loop.
     bool worker_thread();
+    /// Run the loop of one connection shard.
+    bool shard_thread(size_t shard);
+    /// io_service for the next new connection.
+    boost::asio::io_service& next_io_service();
+    bool is_shard_thread();
+    bool is_multithreaded() const noexcept { return 1 < m_threads_count || !m_io_shards.empty(); }
     /// Handle completion of an asynchronous accept operation.
     void handle_accept_ipv4(const boost::system::error_code& e);
     void handle_accept_ipv6(const boost::system::error_code& e);
@@ -492,6 +508,10 @@ namespace net_utils
     std::unique_ptr<worker> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
 
+    /// Connection shards, empty when every connection uses `io_service_`
+    std::vector<std::unique_ptr<worker>> m_io_shards;
+    std::vector<boost::shared_ptr<boost::thread> > m_shard_threads;
+
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
     boost::asio::ip::tcp::acceptor acceptor_ipv6;
@@ -510,6 +530,8 @@ namespace net_utils
     boost::thread::id m_main_thread_id;
     critical_section m_threads_lock;
     std::atomic<uint32_t> m_thread_index;
+    std::atomic<uint32_t> m_next_io_shard;
+    bool m_pin_io_shards;
 
     t_connection_type m_connection_type;
 
@@ -41,6 +41,10 @@
 #include <boost/thread/condition_variable.hpp> // TODO
 #include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "warnings.h"
 #include "string_tools_lexical.h"
 #include "misc_language.h"
@@ -329,18 +333,16 @@ namespace net_utils
     }
     auto self = connection<T>::shared_from_this();
     if (m_connection_type != e_connection_type_RPC) {
-      auto calc_duration = []{
+      auto calc_duration = [this]{
         CRITICAL_REGION_LOCAL(
           network_throttle_manager_t::m_lock_get_global_throttle_in
         );
+        auto &throttle = network_throttle_manager_t::get_global_throttle_in();
+        double delay = std::min(throttle.get_sleep_time_after_tick(1), 1.0);
+        if (delay > 0 && is_under_fair_share(m_state.stat.in.throttle, throttle))
+          delay = 0;
         return std::chrono::duration_cast<connection<T>::duration_t>(
-            std::chrono::duration<double, std::chrono::seconds::period>(
-              std::min(
-                network_throttle_manager_t::get_global_throttle_in(
-                ).get_sleep_time_after_tick(1),
-                1.0
-              )
-            )
+            std::chrono::duration<double, std::chrono::seconds::period>(delay)
         );
       };
       const auto duration = calc_duration();
@@ -454,21 +456,33 @@ namespace net_utils
       return;
     }
     auto self = connection<T>::shared_from_this();
+
+    // Gather the oldest queued slices (at the back) into one write, so a
+    // burst of relayed messages goes out in a single writev.
+    std::vector<boost::asio::const_buffer> buffers;
+    std::size_t batch_bytes = 0;
+    for (auto it = m_state.data.write.queue.rbegin(); it != m_state.data.write.queue.rend(); ++it)
+    {
+      if (!buffers.empty() && (
+        buffers.size() >= ABSTRACT_SERVER_SEND_BATCH_MAX_COUNT ||
+        batch_bytes + it->size() > ABSTRACT_SERVER_SEND_BATCH_MAX_BYTES))
+        break;
+      buffers.emplace_back(it->data(), it->size());
+      batch_bytes += it->size();
+    }
+    const std::size_t batch_count = buffers.size();
+
     if (m_connection_type != e_connection_type_RPC) {
-      auto calc_duration = [this]{
+      auto calc_duration = [this, batch_bytes]{
         CRITICAL_REGION_LOCAL(
           network_throttle_manager_t::m_lock_get_global_throttle_out
         );
+        auto &throttle = network_throttle_manager_t::get_global_throttle_out();
+        double delay = std::min(throttle.get_sleep_time_after_tick(batch_bytes), 1.0);
+        if (delay > 0 && is_under_fair_share(m_state.stat.out.throttle, throttle))
+          delay = 0;
         return std::chrono::duration_cast<connection<T>::duration_t>(
-            std::chrono::duration<double, std::chrono::seconds::period>(
-              std::min(
-                network_throttle_manager_t::get_global_throttle_out(
-                ).get_sleep_time_after_tick(
-                  m_state.data.write.queue.back().size()
-                ),
-                1.0
-              )
-            )
+            std::chrono::duration<double, std::chrono::seconds::period>(delay)
         );
       };
       const auto duration = calc_duration();
@@ -492,7 +506,7 @@ namespace net_utils
     }
 
     m_state.socket.wait_write = true;
-    auto on_write = [this, self](const ec_t &ec, size_t bytes_transferred){
+    auto on_write = [this, self, batch_bytes, batch_count](const ec_t &ec, size_t bytes_transferred){
       std::lock_guard<std::mutex> guard(m_state.lock);
       m_state.socket.wait_write = false;
       if (m_state.socket.cancel_write) {
@@ -526,8 +540,12 @@ namespace net_utils
 
           start_timer(get_default_timeout(), true);
         }
-        assert(bytes_transferred == m_state.data.write.queue.back().size());
-        m_state.data.write.queue.pop_back();
+        assert(bytes_transferred == batch_bytes);
+        assert(batch_count <= m_state.data.write.queue.size());
+        m_state.data.write.queue.erase(
+          m_state.data.write.queue.end() - batch_count,
+          m_state.data.write.queue.end()
+        );
         m_state.condition.notify_all();
         start_write();
       }
@@ -535,27 +553,31 @@ namespace net_utils
     if (!m_state.ssl.enabled)
       boost::asio::async_write(
         connection_basic::socket_.next_layer(),
-        boost::asio::buffer(
-          m_state.data.write.queue.back().data(),
-          m_state.data.write.queue.back().size()
-        ),
+        buffers,
         m_strand.wrap(on_write)
       );
     else
       m_strand.post(
-        [this, self, on_write]{
+        [this, self, on_write, buffers]{
           boost::asio::async_write(
             connection_basic::socket_,
-            boost::asio::buffer(
-              m_state.data.write.queue.back().data(),
-              m_state.data.write.queue.back().size()
-            ),
+            buffers,
             m_strand.wrap(on_write)
           );
         }
       );
   }
 
+  template<typename T>
+  bool connection<T>::is_under_fair_share(const network_throttle_t &own, epee::net_utils::i_network_throttle &global)
+  {
+    // A connection moving less than its share of the global limit is not held
+    // back by the connections which used the limit up. Those go further into
+    // debt and wait longer instead.
+    const long connections = std::max<long>(1, connection_basic::get_state().sock_count - 1);
+    return own.get_current_speed() * connections < global.get_target_speed() * 1024;
+  }
+
   template<typename T>
   void connection<T>::start_shutdown()
   {
@@ -1139,6 +1161,8 @@ namespace net_utils
     m_stop_signal_sent(false), m_port(0), 
     m_threads_count(0),
     m_thread_index(0),
+    m_next_io_shard(0),
+    m_pin_io_shards(false),
 		m_connection_type( connection_type ),
     new_connection_(),
     new_connection_ipv6()
@@ -1157,6 +1181,8 @@ namespace net_utils
     m_stop_signal_sent(false), m_port(0),
     m_threads_count(0),
     m_thread_index(0),
+    m_next_io_shard(0),
+    m_pin_io_shards(false),
 		m_connection_type(connection_type),
     new_connection_(),
     new_connection_ipv6()
@@ -1213,7 +1239,7 @@ namespace net_utils
       boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_.local_endpoint();
       m_port = binded_endpoint.port();
       MDEBUG("start accept (IPv4)");
-      new_connection_.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, m_state->ssl_options().support));
+      new_connection_.reset(new connection<t_protocol_handler>(next_io_service(), m_state, m_connection_type, m_state->ssl_options().support));
       acceptor_.async_accept(new_connection_->socket(),
 	boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4, this,
 	boost::asio::placeholders::error));
@@ -1250,7 +1276,7 @@ namespace net_utils
         boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_ipv6.local_endpoint();
         m_port_ipv6 = binded_endpoint.port();
         MDEBUG("start accept (IPv6)");
-        new_connection_ipv6.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, m_state->ssl_options().support));
+        new_connection_ipv6.reset(new connection<t_protocol_handler>(next_io_service(), m_state, m_connection_type, m_state->ssl_options().support));
         acceptor_ipv6.async_accept(new_connection_ipv6->socket(),
             boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6, this,
               boost::asio::placeholders::error));
@@ -1335,6 +1361,79 @@ namespace net_utils
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::shard_thread(size_t shard)
+  {
+    TRY_ENTRY();
+    MLOG_SET_THREAD_NAME(std::string("[") + m_thread_name_prefix + "_IO" + boost::to_string(shard) + "]");
+#ifdef __linux__
+    const unsigned cpus = boost::thread::hardware_concurrency();
+    if (m_pin_io_shards && cpus)
+    {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(shard % cpus, &cpu_set);
+      const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+      if (err)
+        MWARNING("Failed to pin io shard " << shard << " to cpu " << shard % cpus << ": " << err);
+    }
+#endif
+    boost::asio::io_service& io_service = m_io_shards[shard]->io_service;
+    while(!m_stop_signal_sent)
+    {
+      try
+      {
+        io_service.run();
+        return true;
+      }
+      catch(const std::exception& ex)
+      {
+        _erro("Exception at server shard thread, what=" << ex.what());
+      }
+      catch(...)
+      {
+        _erro("Exception at server shard thread, unknown execption");
+      }
+    }
+    return true;
+    CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::shard_thread", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::set_io_shards(size_t count, bool pin_threads)
+  {
+    CRITICAL_REGION_LOCAL(m_threads_lock);
+    if (!m_shard_threads.empty())
+    {
+      MERROR("io shards cannot be changed while the server is running");
+      return;
+    }
+    m_io_shards.clear();
+    for (size_t i = 0; i < count; ++i)
+      m_io_shards.emplace_back(new worker());
+    m_pin_io_shards = pin_threads;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::next_io_service()
+  {
+    if (m_io_shards.empty())
+      return io_service_;
+    return m_io_shards[m_next_io_shard++ % m_io_shards.size()]->io_service;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::is_shard_thread()
+  {
+    CRITICAL_REGION_LOCAL(m_threads_lock);
+    for (const boost::shared_ptr<boost::thread>& thp: m_shard_threads)
+    {
+      if(thp->get_id() == boost::this_thread::get_id())
+        return true;
+    }
+    return false;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void boosted_tcp_server<t_protocol_handler>::set_threads_prefix(const std::string& prefix_name)
   {
     m_thread_name_prefix = prefix_name;
@@ -1363,6 +1462,16 @@ namespace net_utils
 
       // Create a pool of threads to run all of the io_services.
       CRITICAL_REGION_BEGIN(m_threads_lock);
+      if (m_shard_threads.empty())
+      {
+        for (std::size_t i = 0; i < m_io_shards.size() * ABSTRACT_SERVER_THREADS_PER_SHARD; ++i)
+        {
+          m_shard_threads.push_back(boost::make_shared<boost::thread>(
+            attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::shard_thread, this, i % m_io_shards.size())));
+        }
+        if (!m_io_shards.empty())
+          MINFO("Run " << m_io_shards.size() << " io shards" << (m_pin_io_shards ? ", pinned" : ""));
+      }
       for (std::size_t i = 0; i < threads_count; ++i)
       {
         boost::shared_ptr<boost::thread> thread(new boost::thread(
@@ -1380,6 +1489,12 @@ namespace net_utils
          }
          _fact("JOINING all threads - almost");
         m_threads.clear();
+        if (m_stop_signal_sent)
+        {
+          for (auto& thread: m_shard_threads)
+            thread->join();
+          m_shard_threads.clear();
+        }
         _fact("JOINING all threads - DONE");
 
       } 
@@ -1435,6 +1550,14 @@ namespace net_utils
         m_threads[i]->interrupt();
       }
     }
+    for (std::size_t i = 0; i < m_shard_threads.size(); ++i)
+    {
+      if(m_shard_threads[i]->joinable() && !m_shard_threads[i]->try_join_for(ms))
+      {
+        _dbg1("Interrupting shard thread " << m_shard_threads[i]->native_handle());
+        m_shard_threads[i]->interrupt();
+      }
+    }
     return true;
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::timed_wait_server_stop", false);
   }
@@ -1454,6 +1577,8 @@ namespace net_utils
     connections_.clear();
     connections_mutex.unlock();
     io_service_.stop();
+    for (auto& shard: m_io_shards)
+      shard->io_service.stop();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
@@ -1500,7 +1625,7 @@ namespace net_utils
         (*current_new_connection)->setRpcStation(); // hopefully this is not needed actually
       }
       connection_ptr conn(std::move((*current_new_connection)));
-      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, conn->get_ssl_support()));
+      (*current_new_connection).reset(new connection<t_protocol_handler>(next_io_service(), m_state, m_connection_type, conn->get_ssl_support()));
       current_acceptor->async_accept((*current_new_connection)->socket(),
           boost::bind(accept_function_pointer, this,
             boost::asio::placeholders::error));
@@ -1510,9 +1635,9 @@ namespace net_utils
 
       bool res;
       if (default_remote.get_type_id() == net_utils::address_type::invalid)
-        res = conn->start(true, 1 < m_threads_count);
+        res = conn->start(true, is_multithreaded());
       else
-        res = conn->start(true, 1 < m_threads_count, default_remote);
+        res = conn->start(true, is_multithreaded(), default_remote);
       if (!res)
       {
         conn->cancel();
@@ -1535,7 +1660,7 @@ namespace net_utils
     assert(m_state != nullptr); // always set in constructor
     _erro("Some problems at accept: " << e.message() << ", connections_count = " << m_state->sock_count);
     misc_utils::sleep_no_w(100);
-    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
+    (*current_new_connection).reset(new connection<t_protocol_handler>(next_io_service(), m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
     current_acceptor->async_accept((*current_new_connection)->socket(),
         boost::bind(accept_function_pointer, this,
           boost::asio::placeholders::error));
@@ -1547,7 +1672,7 @@ namespace net_utils
     if(std::addressof(get_io_service()) == std::addressof(GET_IO_SERVICE(sock)))
     {
       connection_ptr conn(new connection<t_protocol_handler>(std::move(sock), m_state, m_connection_type, ssl_support));
-      if(conn->start(false, 1 < m_threads_count, std::move(real_remote)))
+      if(conn->start(false, is_multithreaded(), std::move(real_remote)))
       {
         conn->get_context(out);
         conn->save_dbg_log();
@@ -1664,7 +1789,9 @@ namespace net_utils
   {
     TRY_ENTRY();
 
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, ssl_support) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(
+      // a shard thread blocking here could not complete its own connect
+      is_shard_thread() ? io_service_ : next_io_service(), m_state, m_connection_type, ssl_support) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1766,7 +1893,7 @@ namespace net_utils
     connections_mutex.lock();
     connections_.erase(new_connection_l);
     connections_mutex.unlock();
-    bool r = new_connection_l->start(false, 1 < m_threads_count);
+    bool r = new_connection_l->start(false, is_multithreaded());
     if (r)
     {
       new_connection_l->get_context(conn_context);
@@ -1789,7 +1916,7 @@ namespace net_utils
   bool boosted_tcp_server<t_protocol_handler>::connect_async(const std::string& adr, const std::string& port, uint32_t conn_timeout, const t_callback &cb, const std::string& bind_ip, epee::net_utils::ssl_support_t ssl_support)
   {
     TRY_ENTRY();    
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, ssl_support) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(next_io_service(), m_state, m_connection_type, ssl_support) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1898,7 +2025,7 @@ namespace net_utils
             connections_mutex.lock();
             connections_.erase(new_connection_l);
             connections_mutex.unlock();
-            bool r = new_connection_l->start(false, 1 < m_threads_count);
+            bool r = new_connection_l->start(false, is_multithreaded());
             if (r)
             {
               new_connection_l->get_context(conn_context);
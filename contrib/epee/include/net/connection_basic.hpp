@@ -184,7 +184,6 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static int get_tos_flag();
 
 		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
 		static void save_limit_to_file(int limit); ///< for dr-monero
 		static double get_sleep_time(size_t cb);
 };
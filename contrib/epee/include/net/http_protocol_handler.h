@@ -35,6 +35,7 @@
 #include "net_utils_base.h"
 #include "http_auth.h"
 #include "http_base.h"
+#include "syncobj.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.http"
@@ -111,7 +112,7 @@ namespace net_utils
 				http_body_transfer_undefined
 			};
 
-			bool handle_buff_in(std::string& buf);
+			bool handle_buff_in(const char* data, size_t size);
 
 			bool analize_cached_request_header_and_invoke_state(size_t pos);
 
@@ -25,8 +25,12 @@
 // 
 
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cctype>
+#include <limits>
 #include "http_protocol_handler.h"
 #include "reg_exp_definer.h"
 #include "string_tools.h"
@@ -40,6 +44,7 @@
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
 #define HTTP_MAX_STARTING_NEWLINES       8
+#define HTTP_MAX_BODY_RESERVE            (4*1024*1024)
 
 namespace epee
 {
@@ -229,23 +234,19 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_recv(const void* ptr, size_t cb)
 	{
-		std::string buf((const char*)ptr, cb);
-		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << buf);
-		//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
-
-		bool res = handle_buff_in(buf);
+		bool res = handle_buff_in(static_cast<const char*>(ptr), cb);
 		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/)
 			return false;
 		return res;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::string& buf)
+	bool simple_http_connection_handler<t_connection_context>::handle_buff_in(const char* data, size_t size)
 	{
 
 		size_t ndel;
 
-		m_bytes_read += buf.size();
+		m_bytes_read += size;
 		if (m_bytes_read > m_config.m_max_content_length)
 		{
 			LOG_ERROR("simple_http_connection_handler::handle_buff_in: Too much data: got " << m_bytes_read);
@@ -253,10 +254,22 @@ namespace net_utils
 			return false;
 		}
 
-		if(m_cache.size())
-			m_cache += buf;
-		else
-			m_cache.swap(buf);
+		// the rest of a body goes straight into the request, without a pass
+		// through the cache
+		if(m_state == http_state_retriving_body && m_body_transfer_type == http_body_transfer_measure && m_cache.empty())
+		{
+			const size_t count = std::min(size, m_len_remain);
+			m_query_info.m_body.append(data, count);
+			data += count;
+			size -= count;
+			m_len_remain -= count;
+			if(!m_len_remain && !handle_query_measure())
+				return false;
+		}
+
+		// the cache keeps its capacity between requests, so small requests
+		// do not allocate here
+		m_cache.append(data, size);
 
 		m_is_stop_handling = false;
 		while(!m_is_stop_handling)
@@ -318,7 +331,12 @@ namespace net_utils
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				if(!handle_retriving_query_body())
+					return false;
+				//a pipelined request may follow the body in the cache
+				if(m_state == http_state_retriving_body)
+					return true;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -336,57 +354,161 @@ namespace net_utils
 		return true;
 	}
 	//--------------------------------------------------------------------------------------------
-	inline bool analize_http_method(const boost::smatch& result, http::http_method& method, int& http_ver_major, int& http_ver_minor)
+	//! \return True if `str` is a run of digits fitting in `out`
+	template<typename T>
+	inline bool parse_http_number(const boost::string_ref str, T& out)
 	{
-		CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-		if (!boost::conversion::try_lexical_convert<int>(result[11], http_ver_major))
-			return false;
-		if (!boost::conversion::try_lexical_convert<int>(result[12], http_ver_minor))
+		if (str.empty())
 			return false;
+		out = 0;
+		for (const char c : str)
+		{
+			if (c < '0' || '9' < c)
+				return false;
+			const T digit = c - '0';
+			if ((std::numeric_limits<T>::max() - digit) / 10 < out)
+				return false;
+			out = out * 10 + digit;
+		}
+		return true;
+	}
+	//--------------------------------------------------------------------------------------------
+	/*! Parses a request line "METHOD URI HTTP/major.minor", without its line
+		break, in place of the request line regex. The out views point into
+		`line`.
+		\return False if `line` is not a request line */
+	inline bool parse_request_line(boost::string_ref line, http::http_method& method, boost::string_ref& method_str, boost::string_ref& uri, int& http_ver_major, int& http_ver_minor)
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
 
-		if(result[3].matched)
+		const std::size_t method_end = line.find(' ');
+		if (method_end == boost::string_ref::npos)
+			return false;
+		method_str = line.substr(0, method_end);
+		if (boost::iequals(method_str, "OPTIONS"))
 			method = http::http_method_options;
-		else if(result[4].matched)
+		else if (boost::iequals(method_str, "GET"))
 			method = http::http_method_get;
-		else if(result[5].matched)
+		else if (boost::iequals(method_str, "HEAD"))
 			method = http::http_method_head;
-		else if(result[6].matched)
+		else if (boost::iequals(method_str, "POST"))
 			method = http::http_method_post;
-		else if(result[7].matched)
+		else if (boost::iequals(method_str, "PUT"))
 			method = http::http_method_put;
-		else 
+		else if (boost::iequals(method_str, "DELETE") || boost::iequals(method_str, "TRACE"))
 			method = http::http_method_etc;
+		else
+			return false;
+		line.remove_prefix(method_end + 1);
 
-		return true;
+		const std::size_t uri_end = line.find_first_of(" \t\r\n\f\v");
+		if (uri_end == 0 || uri_end == boost::string_ref::npos)
+			return false;
+		uri = line.substr(0, uri_end);
+		line.remove_prefix(uri_end);
+
+		static constexpr const char version_prefix[] = " HTTP/";
+		if (!boost::istarts_with(line, version_prefix))
+			return false;
+		line.remove_prefix(sizeof(version_prefix) - 1);
+
+		const std::size_t dot = line.find('.');
+		return dot != boost::string_ref::npos &&
+			parse_http_number(line.substr(0, dot), http_ver_major) &&
+			parse_http_number(line.substr(dot + 1), http_ver_minor);
+	}
+	//--------------------------------------------------------------------------------------------
+	/*! Fills `body_info` from the header area `head`, which ends with the blank
+		line, in place of the header field regex. Values run to the line break
+		not followed by a space or tab, so folded lines stay part of them, and
+		lines that are not fields are skipped. */
+	inline void parse_header_fields(boost::string_ref head, http_header_info& body_info)
+	{
+		body_info.clear();
+		while (!head.empty() && head.front() != '\r' && head.front() != '\n')
+		{
+			std::size_t i = 0;
+			while (i < head.size() && (std::isalnum(static_cast<unsigned char>(head[i])) || head[i] == '_' || head[i] == '-'))
+				++i;
+			const boost::string_ref name = head.substr(0, i);
+			if (i < head.size() && head[i] == ' ')
+				++i;
+			if (name.empty() || head.size() <= i || head[i] != ':')
+			{
+				const std::size_t next = head.find('\n');
+				if (next == boost::string_ref::npos)
+					return;
+				head.remove_prefix(next + 1);
+				continue;
+			}
+			++i;
+			if (i < head.size() && head[i] == ' ')
+				++i;
+
+			const auto find_newline = [&head] (const std::size_t from)
+			{
+				const std::size_t found = head.substr(from).find('\n');
+				return found == boost::string_ref::npos ? found : from + found;
+			};
+			const std::size_t value_start = i;
+			std::size_t line_end = find_newline(value_start);
+			while (line_end != boost::string_ref::npos && line_end + 1 < head.size() && (head[line_end + 1] == ' ' || head[line_end + 1] == '\t'))
+				line_end = find_newline(line_end + 1);
+			if (line_end == boost::string_ref::npos || line_end + 1 == head.size())
+				return;
+			std::size_t value_end = line_end;
+			if (value_start < value_end && head[value_end - 1] == '\r')
+				--value_end;
+			const boost::string_ref value = head.substr(value_start, value_end - value_start);
+
+			if (boost::iequals(name, "Connection"))
+				body_info.m_connection.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Referer"))
+				body_info.m_referer.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Content-Length"))
+				body_info.m_content_length.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Content-Type"))
+				body_info.m_content_type.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Transfer-Encoding"))
+				body_info.m_transfer_encoding.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Content-Encoding"))
+				body_info.m_content_encoding.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Host"))
+				body_info.m_host.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Cookie"))
+				body_info.m_cookie.assign(value.data(), value.size());
+			else if (boost::iequals(name, "User-Agent"))
+				body_info.m_user_agent.assign(value.data(), value.size());
+			else if (boost::iequals(name, "Origin"))
+				body_info.m_origin.assign(value.data(), value.size());
+			else
+				body_info.m_etc_fields.emplace_back(std::string{name.data(), name.size()}, std::string{value.data(), value.size()});
+
+			head.remove_prefix(line_end + 1);
+		}
 	}
 
   //--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
-	{ 
-		STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+)\\.(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-		//											    123         4     5      6      7     8        9        10          11     12    
-		//size_t match_len = 0;
-		boost::smatch result;	
-		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
+	{
+		const std::string::size_type line_end = m_cache.find('\n');
+		boost::string_ref method_str, uri;
+		//the version minor ends up in m_http_ver_hi too, as always
+		if(line_end != std::string::npos && parse_request_line(boost::string_ref{m_cache}.substr(0, line_end), m_query_info.m_http_method, method_str, uri, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi))
 		{
-			if (!analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi))
-			{
-				m_state = http_state_error;
-				MERROR("Failed to analyze method");
-				return false;
-			}
-			m_query_info.m_URI = result[10];
+			m_query_info.m_URI.assign(uri.data(), uri.size());
 			if (!parse_uri(m_query_info.m_URI, m_query_info.m_uri_content))
 			{
 				m_state = http_state_error;
 				MERROR("Failed to parse URI: m_query_info.m_URI");
 				return false;
 			}
-			m_query_info.m_http_method_str = result[2];
-			m_query_info.m_full_request_str = result[0];
+			m_query_info.m_http_method_str.assign(method_str.data(), method_str.size());
+			m_query_info.m_full_request_str.assign(m_cache, 0, line_end + 1);
 
-			m_cache.erase(m_cache.begin(), result[0].second);
+			m_cache.erase(0, line_end + 1);
 
 			m_state = http_state_retriving_header;
 
@@ -445,6 +567,8 @@ namespace net_utils
 				m_state = http_state_error;
 				return false;
 			}
+			if(m_cache.size() < m_len_summary)
+				m_query_info.m_body.reserve(std::min<size_t>(std::min(m_len_summary, m_config.m_max_content_length), HTTP_MAX_BODY_RESERVE));
 			if(0 == m_len_summary)
 			{	//current query finished, next will be next query
 				if(handle_request_and_send_response(m_query_info))
@@ -486,7 +610,13 @@ namespace net_utils
 	bool simple_http_connection_handler<t_connection_context>::handle_query_measure()
 	{
 
-		if(m_len_remain >= m_cache.size())
+		if(m_len_remain == m_cache.size() && m_query_info.m_body.empty())
+		{
+			//the whole body arrived with the header, hand over the buffer
+			m_len_remain = 0;
+			m_query_info.m_body.swap(m_cache);
+			m_cache.clear();
+		}else if(m_len_remain >= m_cache.size())
 		{
 			m_len_remain -= m_cache.size();
 			m_query_info.m_body += m_cache;
@@ -510,71 +640,22 @@ namespace net_utils
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
-	{ 
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)"
-			//  12            3         4                5              6                   7                  8      9        10           11
-			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//11             1213   14 
-			boost::regex::icase | boost::regex::normal);
-
-		boost::smatch		result;
-		std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-		std::string::const_iterator it_end_bound = m_cache_to_process.begin()+pos;
-
-		body_info.clear();
-
-		//lookup all fields and fill well-known fields
-		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
-		{
-			const size_t field_val = 14;
-			const size_t field_etc_name = 12;
-
-			int i = 2; //start position = 2
-			if(result[i++].matched)//"Connection"
-				body_info.m_connection = result[field_val];
-			else if(result[i++].matched)//"Referer"
-				body_info.m_referer = result[field_val];
-			else if(result[i++].matched)//"Content-Length"
-				body_info.m_content_length = result[field_val];
-			else if(result[i++].matched)//"Content-Type"
-				body_info.m_content_type = result[field_val];
-			else if(result[i++].matched)//"Transfer-Encoding"
-				body_info.m_transfer_encoding = result[field_val];
-			else if(result[i++].matched)//"Content-Encoding"
-				body_info.m_content_encoding = result[field_val];
-			else if(result[i++].matched)//"Host"
-				body_info.m_host = result[field_val];
-			else if(result[i++].matched)//"Cookie"
-				body_info.m_cookie = result[field_val];
-			else if(result[i++].matched)//"User-Agent"
-				body_info.m_user_agent = result[field_val];
-			else if(result[i++].matched)//"Origin"
-				body_info.m_origin = result[field_val];
-			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-			else
-			{
-				LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:" << m_cache_to_process);
-			}
-
-			it_current_bound = result[(int)result.size()-1]. first;
-		}
+	{
+		parse_header_fields(boost::string_ref{m_cache_to_process}.substr(0, pos), body_info);
 		return  true;
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string& str, size_t& OUT len)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-		std::string res;
-		boost::smatch result;
-		if(!(boost::regex_search( str, result, rexp_mach_field, boost::match_default) && result[0].matched))
+		//the first run of digits, as the regex used to find
+		const std::string::size_type start = str.find_first_of("0123456789");
+		if(start == std::string::npos)
 			return false;
-
-		try { len = boost::lexical_cast<size_t>(result[0]); }
-		catch(...) { return false; }
-		return true;
+		std::string::size_type end = str.find_first_not_of("0123456789", start);
+		if(end == std::string::npos)
+			end = str.size();
+		return parse_http_number(boost::string_ref{str}.substr(start, end - start), len);
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
@@ -603,10 +684,10 @@ namespace net_utils
 
 		LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 
-		if ((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
-			response_data += response.m_body;
-
+		// the body goes out as its own slice, large binary responses are not copied behind the header
 		m_psnd_hndlr->do_send(byte_slice{std::move(response_data)});
+		if (!response.m_body.empty() && query_info.m_http_method != http::http_method_head)
+			m_psnd_hndlr->do_send(byte_slice{std::move(response.m_body)});
 		m_psnd_hndlr->send_done();
 		return res;
 	}
@@ -69,6 +69,11 @@ class network_throttle : public i_network_throttle {
 		uint64_t m_total_packets;
 		uint64_t m_total_bytes;
 
+		// token bucket deciding the delays: refills at m_target_speed up to one
+		// second worth of traffic, and goes into debt for traffic already done
+		double m_bucket_tokens;
+		network_time_seconds m_bucket_time;
+
 		std::string m_name; // my name for debug and logs
 		std::string m_nameshort; // my name for debug and logs (used in log file name)
 
@@ -102,6 +107,7 @@ class network_throttle : public i_network_throttle {
 	private:
 		virtual network_time_seconds time_to_slot(network_time_seconds t) const { return std::floor( t ); } // convert exact time eg 13.7 to rounded time for slot number in history 13
         virtual void _handle_trafic_exact(size_t packet_size, size_t orginal_size);
+		double get_bucket_tokens(network_time_seconds now) const; ///< tokens in the bucket at `now`, after refilling
         virtual void logger_handle_net(const std::string &filename, double time, size_t size);
 };
 
@@ -38,6 +38,9 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 
 namespace epee
 {
@@ -234,6 +237,60 @@ public:
     }
   }
 
+  //Replaces the contents with the last nItems items of [begin, end), in O(n)
+  //Same state as clear() then inserting them one by one, but heapified at once
+  template<typename It>
+  void assign(It begin, It end)
+  {
+    clear();
+    const size_t n = std::distance(begin, end);
+    if (n > (size_t)N)
+      std::advance(begin, n - N);
+    const int k = std::min<size_t>(n, N);
+    if (k == 0)
+      return;
+    for (int i = 0; i < k; ++i, ++begin)
+      data[i] = *begin;
+    idx = k % N;
+    sz = k;
+    //as inserting k items would have left them, per the fill pattern
+    maxCt = k / 2;
+    minCt = (k - 1) / 2;
+
+    //the median goes at 0, the maxCt smaller items in the max heap, the others in the min heap
+    std::vector<int> order(k);
+    for (int i = 0; i < k; ++i)
+      order[i] = i;
+    std::nth_element(order.begin(), order.begin() + maxCt, order.end(), [this](int i, int j) { return data[i] < data[j]; });
+    heap[0] = order[maxCt];
+    for (int i = 0; i < maxCt; ++i)
+      heap[-1 - i] = order[i];
+    for (int i = 0; i < minCt; ++i)
+      heap[1 + i] = order[maxCt + 1 + i];
+    for (int i = -maxCt; i <= minCt; ++i)
+      pos[heap[i]] = i;
+
+    //bottom up heap construction
+    for (int i = maxCt / 2; i >= 1; --i)
+      maxSortDown(-i);
+    for (int i = minCt / 2; i >= 1; --i)
+      minSortDown(i);
+  }
+
+  //Reverts the last insert, putting back the item it pushed out, in O(lg nItems)
+  //Only possible once the window is full, as the evicted item is needed
+  bool undo_insert(Item evicted)
+  {
+    if (sz < N)
+      return false;
+    //with a full window, insert only replaces the value in the slot it writes
+    const int prev = (idx + N - 1) % N;
+    idx = prev;
+    insert(evicted);
+    idx = prev;
+    return true;
+  }
+
   //returns median item (or average of 2 when item count is even)
   Item median() const
   {
@@ -56,8 +56,14 @@ namespace epee
         size_t n_strings; // not counting field names
       };
 
-      portable_storage(){}
+      portable_storage(): m_move_strings(false) {}
       virtual ~portable_storage(){}
+
+      /*! Strings are moved out of the storage when read instead of copied,
+          for a storage which is only read once into a struct. Large blobs,
+          like blocks and txes, then only get copied out of the input buffer. */
+      void set_move_strings(bool move) noexcept { m_move_strings = move; }
+
       hsection   open_section(const std::string& section_name,  hsection hparent_section, bool create_if_notexist = false);
       template<class t_value>
       bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
@@ -100,6 +106,7 @@ namespace epee
 
     private:
       section m_root;
+      bool m_move_strings;
       hsection	get_root_section() {return &m_root;}
       storage_entry* find_storage_entry(const std::string& pentry_name, hsection psection);
       template<class entry_type>
@@ -128,9 +135,17 @@ namespace epee
     struct get_value_visitor: boost::static_visitor<void>
     {
       to_type& m_target;
-      get_value_visitor(to_type& target):m_target(target){}
+      const bool m_move;
+      get_value_visitor(to_type& target, bool move = false):m_target(target), m_move(move){}
       template<class from_type>
       void operator()(const from_type& v){convert_t(v, m_target);}
+      void operator()(std::string& v)
+      {
+        if (m_move)
+          move_t(v, m_target);
+        else
+          convert_t(v, m_target);
+      }
     };
 
     template<class t_value>
@@ -143,7 +158,7 @@ namespace epee
       if(!pentry)
         return false;
 
-      get_value_visitor<t_value> gvv(val);
+      get_value_visitor<t_value> gvv(val, m_move_strings);
       boost::apply_visitor(gvv, *pentry);
       return true;
       //CATCH_ENTRY("portable_storage::template<>get_value", false);
@@ -186,7 +201,8 @@ namespace epee
     struct get_first_value_visitor: boost::static_visitor<bool>
     {
       to_type& m_target;
-      get_first_value_visitor(to_type& target):m_target(target){}
+      const bool m_move;
+      get_first_value_visitor(to_type& target, bool move = false):m_target(target), m_move(move){}
       template<class from_type>
       bool operator()(const array_entry_t<from_type>& a)
       {
@@ -196,6 +212,17 @@ namespace epee
         convert_t(*pv, m_target);
         return true;
       }
+      bool operator()(array_entry_t<std::string>& a)
+      {
+        std::string* pv = a.get_first_val();
+        if(!pv)
+          return false;
+        if (m_move)
+          move_t(*pv, m_target);
+        else
+          convert_t(*pv, m_target);
+        return true;
+      }
     };
     //---------------------------------------------------------------------------------------------------------------
     template<class t_value>
@@ -211,7 +238,7 @@ namespace epee
         return nullptr;
       array_entry& ar_entry = boost::get<array_entry>(*pentry);
       
-      get_first_value_visitor<t_value> gfv(target);
+      get_first_value_visitor<t_value> gfv(target, m_move_strings);
       if(!boost::apply_visitor(gfv, ar_entry))
         return nullptr;
       return &ar_entry;
@@ -222,7 +249,8 @@ namespace epee
     struct get_next_value_visitor: boost::static_visitor<bool>
     {
       to_type& m_target;
-      get_next_value_visitor(to_type& target):m_target(target){}
+      const bool m_move;
+      get_next_value_visitor(to_type& target, bool move = false):m_target(target), m_move(move){}
       template<class from_type>
       bool operator()(const array_entry_t<from_type>& a)
       {
@@ -233,6 +261,17 @@ namespace epee
         convert_t(*pv, m_target);
         return true;
       }
+      bool operator()(array_entry_t<std::string>& a)
+      {
+        std::string* pv = a.get_next_val();
+        if(!pv)
+          return false;
+        if (m_move)
+          move_t(*pv, m_target);
+        else
+          convert_t(*pv, m_target);
+        return true;
+      }
     };
 
     template<class t_value>
@@ -242,7 +281,7 @@ namespace epee
       //TRY_ENTRY();
       CHECK_AND_ASSERT(hval_array, false);
       array_entry& ar_entry = *hval_array;
-      get_next_value_visitor<t_value> gnv(target);
+      get_next_value_visitor<t_value> gnv(target, m_move_strings);
       if(!boost::apply_visitor(gnv, ar_entry))
         return false;
       return true;
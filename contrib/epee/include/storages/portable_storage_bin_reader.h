@@ -0,0 +1,476 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <vector>
+#include "misc_log_ex.h"
+#include "span.h"
+#include "portable_storage.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    //! A section indexed by a binary_reader, declared here so handles can be forward declared
+    struct binary_reader_section
+    {
+      std::size_t first;
+      std::size_t count;
+    };
+
+    /*! Reads the portable storage binary format for a KV_SERIALIZE map without
+     *  building a section tree. Loading only indexes the buffer: every entry
+     *  becomes a fixed size record pointing at its bytes, and values are
+     *  decoded straight into the struct when the map asks for them. It offers
+     *  the subset of the portable_storage interface used when loading, and
+     *  accepts and rejects the same input, limits included. The buffer must
+     *  outlive the reader.
+     */
+    class binary_reader
+    {
+      struct entry
+      {
+        const uint8_t *name;
+        uint8_t name_size;
+        uint8_t type;
+        const uint8_t *value;
+        std::size_t count; //!< elements, for arrays
+        std::size_t child; //!< section index, for objects and arrays of objects
+      };
+
+      typedef binary_reader_section section_index;
+
+      struct array_cursor
+      {
+        uint8_t type;
+        const uint8_t *next;
+        std::size_t remaining;
+        std::size_t next_section;
+      };
+
+    public:
+      typedef const section_index* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      binary_reader()
+        : m_ptr(nullptr), m_count(0), m_depth(0), m_objects(0), m_fields(0), m_strings(0)
+      {}
+
+      bool load_from_binary(const epee::span<const uint8_t> source, const portable_storage::limits_t *limits = nullptr)
+      {
+        m_entries.clear();
+        m_sections.clear();
+        m_cursors.clear();
+        static constexpr const std::size_t header_size = 2 * sizeof(uint32_t) + 1;
+        if (source.size() < header_size)
+        {
+          LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << header_size);
+          return false;
+        }
+        uint32_t signature_a, signature_b;
+        memcpy(&signature_a, source.data(), sizeof(signature_a));
+        memcpy(&signature_b, source.data() + sizeof(signature_a), sizeof(signature_b));
+        if (signature_a != SWAP32LE(PORTABLE_STORAGE_SIGNATUREA) || signature_b != SWAP32LE(PORTABLE_STORAGE_SIGNATUREB))
+        {
+          LOG_ERROR("portable_storage: wrong binary format - signature mismatch");
+          return false;
+        }
+        if (source[2 * sizeof(uint32_t)] != PORTABLE_STORAGE_FORMAT_VER)
+        {
+          LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << source[2 * sizeof(uint32_t)]);
+          return false;
+        }
+        TRY_ENTRY();
+        m_ptr = source.data() + header_size;
+        m_count = source.size() - header_size;
+        CHECK_AND_ASSERT_THROW_MES(m_count, "throwable_buffer_reader: sz==0");
+        m_depth = 0;
+        m_objects = 0;
+        m_fields = 0;
+        m_strings = 0;
+        m_max_objects = limits ? limits->n_objects : std::numeric_limits<std::size_t>::max();
+        m_max_fields = limits ? limits->n_fields : std::numeric_limits<std::size_t>::max();
+        m_max_strings = limits ? limits->n_strings : std::numeric_limits<std::size_t>::max();
+        m_sections.resize(1);
+        parse_section(0);
+        return true;
+        CATCH_ENTRY("portable_storage::load_from_binary", false);
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false)
+      {
+        const entry *e = find(section_name, hparent_section);
+        if (!e || e->type != SERIALIZE_TYPE_OBJECT)
+          return nullptr;
+        return &m_sections[e->child];
+      }
+
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+      {
+        const entry *e = find(value_name, hparent_section);
+        if (!e)
+          return false;
+        if (e->type == SERIALIZE_TYPE_OBJECT || (e->type & SERIALIZE_FLAG_ARRAY))
+          ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from a section or array to type " << typeid(t_value).name());
+        const uint8_t *p = e->value;
+        read_element(e->type, p, val);
+        return true;
+      }
+
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+      {
+        const entry *e = find(value_name, hparent_section);
+        if (!e || !(e->type & SERIALIZE_FLAG_ARRAY))
+          return nullptr;
+        if (!e->count)
+          return nullptr;
+        const uint8_t type = e->type & ~SERIALIZE_FLAG_ARRAY;
+        if (type == SERIALIZE_TYPE_OBJECT)
+          ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from a section to type " << typeid(t_value).name());
+        m_cursors.push_back({type, e->value, e->count, 0});
+        harray hval_array = &m_cursors.back();
+        get_next_value(hval_array, target);
+        return hval_array;
+      }
+
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target)
+      {
+        CHECK_AND_ASSERT(hval_array, false);
+        if (!hval_array->remaining)
+          return false;
+        read_element(hval_array->type, hval_array->next, target);
+        --hval_array->remaining;
+        return true;
+      }
+
+      harray get_first_section(const std::string& pSectionName, hsection& h_child_section, hsection hparent_section)
+      {
+        const entry *e = find(pSectionName, hparent_section);
+        if (!e || e->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !e->count)
+          return nullptr;
+        m_cursors.push_back({SERIALIZE_TYPE_OBJECT, nullptr, e->count, e->child});
+        harray hsec_array = &m_cursors.back();
+        get_next_section(hsec_array, h_child_section);
+        return hsec_array;
+      }
+
+      bool get_next_section(harray hsec_array, hsection& h_child_section)
+      {
+        CHECK_AND_ASSERT(hsec_array, false);
+        if (hsec_array->type != SERIALIZE_TYPE_OBJECT || !hsec_array->remaining)
+          return false;
+        h_child_section = &m_sections[hsec_array->next_section++];
+        --hsec_array->remaining;
+        return true;
+      }
+
+    private:
+      struct depth_guard
+      {
+        std::size_t &depth;
+        explicit depth_guard(std::size_t &d): depth(d)
+        {
+          ++depth;
+          CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+        }
+        ~depth_guard() { --depth; }
+      };
+
+      static bool name_less(const entry &e, const uint8_t *name, std::size_t name_size)
+      {
+        const int c = memcmp(e.name, name, std::min<std::size_t>(e.name_size, name_size));
+        return c < 0 || (c == 0 && e.name_size < name_size);
+      }
+
+      const entry *find(const std::string &name, hsection hparent_section) const
+      {
+        const section_index &sec = hparent_section ? *hparent_section : m_sections.front();
+        const auto begin = m_entries.begin() + sec.first, end = begin + sec.count;
+        const uint8_t *n = reinterpret_cast<const uint8_t*>(name.data());
+        const auto it = std::lower_bound(begin, end, name, [n](const entry &e, const std::string &name) { return name_less(e, n, name.size()); });
+        if (it == end || it->name_size != name.size() || memcmp(it->name, n, name.size()))
+          return nullptr;
+        return &*it;
+      }
+
+      const uint8_t *skip(std::size_t bytes)
+      {
+        CHECK_AND_ASSERT_THROW_MES(m_count >= bytes, " attempt to read " << bytes << " bytes from buffer with " << m_count << " bytes remained");
+        const uint8_t *p = m_ptr;
+        m_ptr += bytes;
+        m_count -= bytes;
+        return p;
+      }
+
+      uint8_t read_byte()
+      {
+        return *skip(1);
+      }
+
+      static std::size_t decode_varint(const uint8_t *&p, std::size_t *available)
+      {
+        std::size_t bytes = std::size_t(1) << (*p & PORTABLE_RAW_SIZE_MARK_MASK);
+        if (available)
+        {
+          CHECK_AND_ASSERT_THROW_MES(*available >= bytes, " attempt to read " << bytes << " bytes from buffer with " << *available << " bytes remained");
+          *available -= bytes;
+        }
+        uint64_t v = 0;
+        memcpy(&v, p, bytes);
+        p += bytes;
+        v = SWAP64LE(v);
+        return v >> 2;
+      }
+
+      std::size_t read_varint()
+      {
+        CHECK_AND_ASSERT_THROW_MES(m_count >= 1, "empty buff, expected place for varint");
+        return decode_varint(m_ptr, &m_count);
+      }
+
+      static std::size_t pod_size(uint8_t type)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_INT64: case SERIALIZE_TYPE_UINT64: case SERIALIZE_TYPE_DOUBLE: return 8;
+          case SERIALIZE_TYPE_INT32: case SERIALIZE_TYPE_UINT32: return 4;
+          case SERIALIZE_TYPE_INT16: case SERIALIZE_TYPE_UINT16: return 2;
+          case SERIALIZE_TYPE_INT8: case SERIALIZE_TYPE_UINT8: case SERIALIZE_TYPE_BOOL: return 1;
+          default: return 0;
+        }
+      }
+
+      static std::size_t min_bytes(uint8_t type)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_STRING: return ps_min_bytes<std::string>::strict;
+          case SERIALIZE_TYPE_OBJECT: return ps_min_bytes<section>::strict;
+          case SERIALIZE_TYPE_ARRAY: return ps_min_bytes<array_entry>::strict;
+          default: return pod_size(type) ? pod_size(type) : ps_min_bytes<void>::strict;
+        }
+      }
+
+      void skip_pod(uint8_t type)
+      {
+        const uint8_t *p = skip(pod_size(type));
+        CHECK_AND_ASSERT_THROW_MES(type != SERIALIZE_TYPE_BOOL || *p <= 1, "Invalid bool value " << *p);
+      }
+
+      void skip_string()
+      {
+        const std::size_t len = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+        CHECK_AND_ASSERT_THROW_MES(m_count >= len, "string len count value " << len << " goes out of remain storage len " << m_count);
+        skip(len);
+      }
+
+      void parse_array(std::size_t index, uint8_t type)
+      {
+        CHECK_AND_ASSERT_THROW_MES(pod_size(type) || type == SERIALIZE_TYPE_STRING || type == SERIALIZE_TYPE_OBJECT || type == SERIALIZE_TYPE_ARRAY, "unknown entry_type code = " << type);
+        const std::size_t size = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(size <= m_count / min_bytes(type), "Size sanity check failed");
+        if (type == SERIALIZE_TYPE_OBJECT)
+        {
+          CHECK_AND_ASSERT_THROW_MES(size <= m_max_objects - m_objects, "Too many objects");
+          m_objects += size;
+        }
+        else if (type == SERIALIZE_TYPE_STRING)
+        {
+          CHECK_AND_ASSERT_THROW_MES(size <= m_max_strings - m_strings, "Too many strings");
+          m_strings += size;
+        }
+        CHECK_AND_ASSERT_THROW_MES(type != SERIALIZE_TYPE_ARRAY || !size, "Reading array entry is not supported");
+
+        m_entries[index].type = type | SERIALIZE_FLAG_ARRAY;
+        m_entries[index].value = m_ptr;
+        m_entries[index].count = size;
+        if (type == SERIALIZE_TYPE_OBJECT)
+        {
+          const std::size_t child = m_sections.size();
+          m_entries[index].child = child;
+          m_sections.resize(child + size);
+          for (std::size_t i = 0; i < size; ++i)
+            parse_section(child + i);
+        }
+        else if (type == SERIALIZE_TYPE_STRING)
+        {
+          for (std::size_t i = 0; i < size; ++i)
+            skip_string();
+        }
+        else if (type == SERIALIZE_TYPE_BOOL)
+        {
+          for (std::size_t i = 0; i < size; ++i)
+            skip_pod(type);
+        }
+        else
+          skip(size * pod_size(type));
+      }
+
+      void parse_entry(std::size_t index)
+      {
+        uint8_t type = read_byte();
+        if (type & SERIALIZE_FLAG_ARRAY)
+          return parse_array(index, type & ~SERIALIZE_FLAG_ARRAY);
+
+        m_entries[index].type = type;
+        m_entries[index].count = 0;
+        switch (type)
+        {
+          case SERIALIZE_TYPE_STRING:
+            CHECK_AND_ASSERT_THROW_MES(m_strings + 1 <= m_max_strings, "Too many strings");
+            m_strings += 1;
+            m_entries[index].value = m_ptr;
+            skip_string();
+            break;
+          case SERIALIZE_TYPE_OBJECT:
+          {
+            CHECK_AND_ASSERT_THROW_MES(m_objects < m_max_objects, "Too many objects");
+            ++m_objects;
+            const std::size_t child = m_sections.size();
+            m_entries[index].child = child;
+            m_sections.resize(child + 1);
+            parse_section(child);
+            break;
+          }
+          case SERIALIZE_TYPE_ARRAY:
+            type = read_byte();
+            CHECK_AND_ASSERT_THROW_MES(type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+            parse_array(index, type & ~SERIALIZE_FLAG_ARRAY);
+            break;
+          default:
+            CHECK_AND_ASSERT_THROW_MES(pod_size(type), "unknown entry_type code = " << type);
+            m_entries[index].value = m_ptr;
+            skip_pod(type);
+            break;
+        }
+      }
+
+      void parse_section(std::size_t index)
+      {
+        depth_guard guard(m_depth);
+        const std::size_t count = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(count <= m_max_fields - m_fields, "Too many object fields");
+        CHECK_AND_ASSERT_THROW_MES(count <= m_count / 2, "Size sanity check failed");
+        m_fields += count;
+        const std::size_t first = m_entries.size();
+        m_entries.resize(first + count);
+        m_sections[index] = {first, count};
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          const std::size_t name_size = read_byte();
+          CHECK_AND_ASSERT_THROW_MES(name_size > 0, "Section name is missing");
+          m_entries[first + i].name = skip(name_size);
+          m_entries[first + i].name_size = name_size;
+          parse_entry(first + i);
+        }
+
+        const auto begin = m_entries.begin() + first, end = begin + count;
+        std::sort(begin, end, [](const entry &a, const entry &b) { return name_less(a, b.name, b.name_size); });
+        const auto dup = std::adjacent_find(begin, end, [](const entry &a, const entry &b) { return !name_less(a, b.name, b.name_size); });
+        CHECK_AND_ASSERT_THROW_MES(dup == end, "duplicate key: " << std::string(reinterpret_cast<const char*>(dup->name), dup->name_size));
+      }
+
+      template<typename t_pod>
+      static t_pod read_pod(const uint8_t *&p)
+      {
+        t_pod v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return CONVERT_POD(v);
+      }
+
+      static void read_string(const uint8_t *&p, std::string &s)
+      {
+        const std::size_t len = decode_varint(p, nullptr);
+        s.assign(reinterpret_cast<const char*>(p), len);
+        p += len;
+      }
+
+      template<typename t_value>
+      static void read_element(uint8_t type, const uint8_t *&p, t_value &val)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_INT64: convert_t(read_pod<int64_t>(p), val); break;
+          case SERIALIZE_TYPE_INT32: convert_t(read_pod<int32_t>(p), val); break;
+          case SERIALIZE_TYPE_INT16: convert_t(read_pod<int16_t>(p), val); break;
+          case SERIALIZE_TYPE_INT8: convert_t(read_pod<int8_t>(p), val); break;
+          case SERIALIZE_TYPE_UINT64: convert_t(read_pod<uint64_t>(p), val); break;
+          case SERIALIZE_TYPE_UINT32: convert_t(read_pod<uint32_t>(p), val); break;
+          case SERIALIZE_TYPE_UINT16: convert_t(read_pod<uint16_t>(p), val); break;
+          case SERIALIZE_TYPE_UINT8: convert_t(read_pod<uint8_t>(p), val); break;
+          case SERIALIZE_TYPE_DOUBLE: convert_t(read_pod<double>(p), val); break;
+          case SERIALIZE_TYPE_BOOL: convert_t(read_pod<uint8_t>(p) != 0, val); break;
+          case SERIALIZE_TYPE_STRING: read_string_element(p, val); break;
+          default: ASSERT_MES_AND_THROW("unknown entry_type code = " << type);
+        }
+      }
+
+      static void read_string_element(const uint8_t *&p, std::string &val)
+      {
+        read_string(p, val);
+      }
+
+      template<typename t_value>
+      static void read_string_element(const uint8_t *&p, t_value &val)
+      {
+        std::string s;
+        read_string(p, s);
+        move_t(s, val);
+      }
+
+      std::vector<entry> m_entries;
+      std::vector<section_index> m_sections;
+      std::deque<array_cursor> m_cursors;
+      const uint8_t *m_ptr;
+      std::size_t m_count;
+      std::size_t m_depth;
+      std::size_t m_objects;
+      std::size_t m_fields;
+      std::size_t m_strings;
+      std::size_t m_max_objects;
+      std::size_t m_max_fields;
+      std::size_t m_max_strings;
+    };
+  }
+}
@@ -0,0 +1,263 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include "byte_stream.h"
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_to_bin.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    inline void binary_writer_append(std::string& out, const char* data, std::size_t size) { out.append(data, size); }
+    inline void binary_writer_append(byte_stream& out, const char* data, std::size_t size) { out.write(data, size); }
+    inline void binary_writer_patch(std::string& out, std::size_t offset, const char* data, std::size_t size) { out.replace(offset, size, data, size); }
+    inline void binary_writer_patch(byte_stream& out, std::size_t offset, const char* data, std::size_t size) { std::memcpy(out.tellp() - out.size() + offset, data, size); }
+
+    //! An open section or array of a binary_writer, declared here so handles can be forward declared
+    struct binary_writer_frame
+    {
+      std::size_t count_offset;
+      std::size_t count;
+    };
+
+    template<typename t_value> struct binary_writer_type;
+    template<> struct binary_writer_type<uint64_t> { static constexpr uint8_t value = SERIALIZE_TYPE_UINT64; };
+    template<> struct binary_writer_type<uint32_t> { static constexpr uint8_t value = SERIALIZE_TYPE_UINT32; };
+    template<> struct binary_writer_type<uint16_t> { static constexpr uint8_t value = SERIALIZE_TYPE_UINT16; };
+    template<> struct binary_writer_type<uint8_t>  { static constexpr uint8_t value = SERIALIZE_TYPE_UINT8; };
+    template<> struct binary_writer_type<int64_t>  { static constexpr uint8_t value = SERIALIZE_TYPE_INT64; };
+    template<> struct binary_writer_type<int32_t>  { static constexpr uint8_t value = SERIALIZE_TYPE_INT32; };
+    template<> struct binary_writer_type<int16_t>  { static constexpr uint8_t value = SERIALIZE_TYPE_INT16; };
+    template<> struct binary_writer_type<int8_t>   { static constexpr uint8_t value = SERIALIZE_TYPE_INT8; };
+    template<> struct binary_writer_type<double>   { static constexpr uint8_t value = SERIALIZE_TYPE_DOUBLE; };
+    template<> struct binary_writer_type<bool>     { static constexpr uint8_t value = SERIALIZE_TYPE_BOOL; };
+    template<> struct binary_writer_type<std::string> { static constexpr uint8_t value = SERIALIZE_TYPE_STRING; };
+
+    /*! Writes the portable storage binary format while a KV_SERIALIZE map is
+     *  being walked, instead of first copying every value into a section tree
+     *  like portable_storage does. It offers the subset of the portable_storage
+     *  interface used when storing, and relies on entries being stored depth
+     *  first, which the serialization overloads do. Element counts are not
+     *  known up front, so they are written as fixed size varints and patched
+     *  once a section or array is done. Entries keep their declaration order,
+     *  which the reader does not care about. t_stream is std::string or
+     *  byte_stream.
+     */
+    template<class t_stream>
+    class binary_writer
+    {
+      typedef binary_writer_frame frame;
+
+      struct appender
+      {
+        t_stream &out;
+        void write(const char *data, std::size_t size) { binary_writer_append(out, data, size); }
+      };
+
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      explicit binary_writer(t_stream &out)
+        : m_out(out), m_appender{out}
+      {
+        const uint32_t signature_a = SWAP32LE(PORTABLE_STORAGE_SIGNATUREA);
+        const uint32_t signature_b = SWAP32LE(PORTABLE_STORAGE_SIGNATUREB);
+        m_appender.write(reinterpret_cast<const char*>(&signature_a), sizeof(signature_a));
+        m_appender.write(reinterpret_cast<const char*>(&signature_b), sizeof(signature_b));
+        write_byte(PORTABLE_STORAGE_FORMAT_VER);
+        push_frame();
+      }
+
+      //! Patches the counts still open, after which the output is complete
+      void finish()
+      {
+        close_frames(0);
+      }
+
+      template<typename t_value>
+      bool set_value(const std::string& value_name, t_value&& v, hsection hparent_section)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        begin_entry(value_name, hparent_section);
+        write_value(static_cast<const t_real_value&>(v));
+        return true;
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false)
+      {
+        CHECK_AND_ASSERT_THROW_MES(create_if_notexist, "binary_writer can only create sections");
+        begin_entry(section_name, hparent_section);
+        write_byte(SERIALIZE_TYPE_OBJECT);
+        return push_frame();
+      }
+
+      template<typename t_value>
+      harray insert_first_value(const std::string& value_name, t_value&& target, hsection hparent_section)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        begin_entry(value_name, hparent_section);
+        write_byte(binary_writer_type<t_real_value>::value | SERIALIZE_FLAG_ARRAY);
+        harray hval_array = push_frame();
+        write_element(static_cast<const t_real_value&>(target));
+        ++hval_array->count;
+        return hval_array;
+      }
+
+      template<typename t_value>
+      bool insert_next_value(harray hval_array, t_value&& target)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        close_frames(index_of(hval_array) + 1);
+        write_element(static_cast<const t_real_value&>(target));
+        ++hval_array->count;
+        return true;
+      }
+
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section)
+      {
+        begin_entry(pSectionName, hparent_section);
+        write_byte(SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+        harray hsec_array = push_frame();
+        ++hsec_array->count;
+        hinserted_childsection = push_frame();
+        return hsec_array;
+      }
+
+      bool insert_next_section(harray hSecArray, hsection& hinserted_childsection)
+      {
+        close_frames(index_of(hSecArray) + 1);
+        ++hSecArray->count;
+        hinserted_childsection = push_frame();
+        return true;
+      }
+
+    private:
+      std::size_t index_of(const frame *f) const
+      {
+        for (std::size_t i = m_frames.size(); i-- > 0; )
+          if (&m_frames[i] == f)
+            return i;
+        ASSERT_MES_AND_THROW("binary_writer: section or array is already closed");
+      }
+
+      frame *push_frame()
+      {
+        m_frames.push_back({m_out.size(), 0});
+        const uint32_t placeholder = 0;
+        m_appender.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+        return &m_frames.back();
+      }
+
+      void close_frames(std::size_t keep)
+      {
+        while (m_frames.size() > keep)
+        {
+          const frame &f = m_frames.back();
+          CHECK_AND_ASSERT_THROW_MES(f.count <= 1073741823, "binary_writer: too many entries: " << f.count);
+          const uint32_t v = CONVERT_POD(static_cast<uint32_t>((f.count << 2) | PORTABLE_RAW_SIZE_MARK_DWORD));
+          binary_writer_patch(m_out, f.count_offset, reinterpret_cast<const char*>(&v), sizeof(v));
+          m_frames.pop_back();
+        }
+      }
+
+      void begin_entry(const std::string &name, hsection hparent_section)
+      {
+        CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "binary_writer: already finished");
+        if (!hparent_section)
+          hparent_section = &m_frames.front();
+        close_frames(index_of(hparent_section) + 1);
+        CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+        CHECK_AND_ASSERT_THROW_MES(!name.empty(), "storage_entry_name is empty");
+        write_byte(static_cast<uint8_t>(name.size()));
+        m_appender.write(name.data(), name.size());
+        ++hparent_section->count;
+      }
+
+      void write_byte(uint8_t b)
+      {
+        const char c = static_cast<char>(b);
+        m_appender.write(&c, 1);
+      }
+
+      template<typename t_value>
+      void write_value(const t_value &v)
+      {
+        write_byte(binary_writer_type<t_value>::value);
+        write_element(v);
+      }
+
+      void write_value(const storage_entry &v)
+      {
+        pack_entry_to_buff(m_appender, v);
+      }
+
+      template<typename t_pod>
+      void write_element(const t_pod &v)
+      {
+        static_assert(std::is_arithmetic<t_pod>::value, "unexpected type in binary_writer");
+        const t_pod v0 = CONVERT_POD(v);
+        m_appender.write(reinterpret_cast<const char*>(&v0), sizeof(v0));
+      }
+
+      void write_element(const std::string &v)
+      {
+        put_string(m_appender, v);
+      }
+
+      t_stream &m_out;
+      appender m_appender;
+      std::deque<frame> m_frames;
+    };
+
+    //-----------------------------------------------------------------------------------------------------------
+    //! Loads back like store_t_to_binary output, but skips the intermediate portable_storage
+    template<class t_struct, class t_stream>
+    bool write_t_to_binary(const t_struct& str_in, t_stream& binary_buff)
+    {
+      TRY_ENTRY();
+      binary_writer<t_stream> writer(binary_buff);
+      str_in.store(writer);
+      writer.finish();
+      return true;
+      CATCH_ENTRY("write_t_to_binary", false);
+    }
+  }
+}
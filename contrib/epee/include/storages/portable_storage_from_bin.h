@@ -33,34 +33,10 @@
 #include "portable_storage_base.h"
 #include "portable_storage_bin_utils.h"
 
-#ifdef EPEE_PORTABLE_STORAGE_RECURSION_LIMIT
-#define EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL EPEE_PORTABLE_STORAGE_RECURSION_LIMIT
-#else 
-#define EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL 100
-#endif
-
 namespace epee
 {
   namespace serialization
   {
-    template<typename T>
-    struct ps_min_bytes {
-      static constexpr const size_t strict = 4096; // actual low bound
-    };
-    template<> struct ps_min_bytes<uint64_t> { static constexpr const size_t strict = 8; };
-    template<> struct ps_min_bytes<int64_t> { static constexpr const size_t strict = 8; };
-    template<> struct ps_min_bytes<uint32_t> { static constexpr const size_t strict = 4; };
-    template<> struct ps_min_bytes<int32_t> { static constexpr const size_t strict = 4; };
-    template<> struct ps_min_bytes<uint16_t> { static constexpr const size_t strict = 2; };
-    template<> struct ps_min_bytes<int16_t> { static constexpr const size_t strict = 2; };
-    template<> struct ps_min_bytes<uint8_t> { static constexpr const size_t strict = 1; };
-    template<> struct ps_min_bytes<int8_t> { static constexpr const size_t strict = 1; };
-    template<> struct ps_min_bytes<double> { static constexpr const size_t strict = 8; };
-    template<> struct ps_min_bytes<bool> { static constexpr const size_t strict = 1; };
-    template<> struct ps_min_bytes<std::string> { static constexpr const size_t strict = 2; };
-    template<> struct ps_min_bytes<section> { static constexpr const size_t strict = 1; };
-    template<> struct ps_min_bytes<array_entry> { static constexpr const size_t strict = 1; };
-
     struct throwable_buffer_reader
     {
       throwable_buffer_reader(const void* ptr, size_t sz);
@@ -25,341 +25,137 @@
 // 
 
 #pragma once
-#include <boost/lexical_cast.hpp>
-#include <boost/utility/string_ref.hpp>
-#include <boost/algorithm/string/predicate.hpp>
-#include "parserse_base_utils.h"
-#include "file_io_utils.h"
+#include <rapidjson/error/en.h>
+#include <rapidjson/reader.h>
+#include <string>
+#include <vector>
+#include "misc_log_ex.h"
 
 #define EPEE_JSON_RECURSION_LIMIT_INTERNAL 100
 
 namespace epee
 {
-  using namespace misc_utils::parse;
   namespace serialization
   {
     namespace json
     {
-#define CHECK_ISSPACE()  if(!epee::misc_utils::parse::isspace(*it)){ ASSERT_MES_AND_THROW("Wrong JSON character at: " << std::string(it, buf_end));}
-
-      /*inline void parse_error()
-      {
-        ASSERT_MES_AND_THROW("json parse error");
-      }*/
+      /*! rapidjson SAX handler which writes values straight into the storage
+          tree, without building intermediate token strings. Keeps the rules
+          of the previous hand-written parser: the document must be an
+          object, arrays hold values of one kind and cannot nest, and null
+          members are skipped. */
       template<class t_storage>
-      inline void run_handler(typename t_storage::hsection current_section, std::string::const_iterator& sec_buf_begin, std::string::const_iterator buf_end, t_storage& stg, unsigned int recursion)
+      class storage_handler
       {
-        CHECK_AND_ASSERT_THROW_MES(recursion < EPEE_JSON_RECURSION_LIMIT_INTERNAL, "Wrong JSON data: recursion limitation (" << EPEE_JSON_RECURSION_LIMIT_INTERNAL << ") exceeded");
-
-        std::string name;        
-        typename t_storage::harray h_array = nullptr;
-        enum match_state
+        struct frame
         {
-          match_state_lookup_for_section_start, 
-          match_state_lookup_for_name, 
-          match_state_waiting_separator, 
-          match_state_wonder_after_separator, 
-          match_state_wonder_after_value, 
-          match_state_wonder_array, 
-          match_state_array_after_value,
-          match_state_array_waiting_value, 
-          match_state_error
+          typename t_storage::hsection section;
+          typename t_storage::harray array;
+          std::string name; //!< Name of an array in `section`
+          bool is_array;
         };
 
-        enum array_mode
+        t_storage& m_stg;
+        std::vector<frame> m_stack;
+        std::string m_name;
+        unsigned m_sections;
+
+        bool fail(const char* error)
         {
-          array_mode_undifined = 0,
-          array_mode_sections, 
-          array_mode_string, 
-          array_mode_numbers,
-          array_mode_booleans
-        };
+          m_error = error;
+          return false;
+        }
 
-        match_state state = match_state_lookup_for_section_start;
-        array_mode array_md = array_mode_undifined;
-        std::string::const_iterator it = sec_buf_begin;
-        for(;it != buf_end;it++)
+        template<typename T>
+        bool value(T&& val)
         {
-          switch (state)
+          if (m_stack.empty())
+            return fail("JSON document is not an object");
+          frame& top = m_stack.back();
+          if (!top.is_array)
+            return m_stg.set_value(m_name, std::forward<T>(val), top.section) || fail("failed to set value");
+          if (!top.array)
           {
-          case match_state_lookup_for_section_start:
-            if(*it == '{')
-              state = match_state_lookup_for_name;
-            else CHECK_ISSPACE();
-            break;
-          case match_state_lookup_for_name:
-            switch(*it)
-            {
-            case '"':
-              match_string2(it, buf_end, name);
-              state = match_state_waiting_separator;
-              break;
-            case '}':
-              //this is it! section ends here.
-              //seems that it is empty section
-              sec_buf_begin = it;
-              return;
-            default:
-              CHECK_ISSPACE();
-            }
-            break;
-          case match_state_waiting_separator:
-            if(*it == ':')
-              state = match_state_wonder_after_separator;
-            else CHECK_ISSPACE();
-            break;
-          case match_state_wonder_after_separator:
-            if(*it == '"')
-            {//just a named string value started
-              std::string val;
-              match_string2(it, buf_end, val);
-              //insert text value 
-              stg.set_value(name, std::move(val), current_section);
-              state = match_state_wonder_after_value;
-            }else if (epee::misc_utils::parse::isdigit(*it) || *it == '-')
-            {//just a named number value started
-              boost::string_ref val;
-              bool is_v_float = false;bool is_signed = false;
-              match_number2(it, buf_end, val, is_v_float, is_signed);
-              if(!is_v_float)
-              {
-                if(is_signed)
-                {
-                  errno = 0;
-                  int64_t nval = strtoll(val.data(), NULL, 10);
-                  if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                  stg.set_value(name, int64_t(nval), current_section);
-                }else
-                {
-                  errno = 0;
-                  uint64_t nval = strtoull(val.data(), NULL, 10);
-                  if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                  stg.set_value(name, uint64_t(nval), current_section);
-                }
-              }else
-              {
-                errno = 0;
-                double nval = strtod(val.data(), NULL);
-                if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                stg.set_value(name, double(nval), current_section);
-              }
-              state = match_state_wonder_after_value;
-            }else if(isalpha(*it) )
-            {// could be null, true or false
-              boost::string_ref word;
-              match_word2(it, buf_end, word);
-              if(boost::iequals(word, "null"))
-              {
-                state = match_state_wonder_after_value;
-                //just skip this, 
-              }else if(boost::iequals(word, "true"))
-              {
-                stg.set_value(name, true, current_section);              
-                state = match_state_wonder_after_value;
-              }else if(boost::iequals(word, "false"))
-              {
-                stg.set_value(name, false, current_section);              
-                state = match_state_wonder_after_value;
-              }else ASSERT_MES_AND_THROW("Unknown value keyword " << word);
-            }else if(*it == '{')
-            {
-              //sub section here
-              typename t_storage::hsection new_sec = stg.open_section(name, current_section, true);
-              CHECK_AND_ASSERT_THROW_MES(new_sec, "Failed to insert new section in json: " << std::string(it, buf_end));
-              run_handler(new_sec, it, buf_end, stg, recursion + 1);
-              state = match_state_wonder_after_value;
-            }else if(*it == '[')
-            {//array of something
-              state = match_state_wonder_array;
-            }else CHECK_ISSPACE();
-            break;
-          case match_state_wonder_after_value:
-            if(*it == ',')
-              state = match_state_lookup_for_name;
-            else if(*it == '}')
-            {
-              //this is it! section ends here.
-              sec_buf_begin = it;
-              return;
-            }else CHECK_ISSPACE();
-            break;
-          case match_state_wonder_array:
-            if(*it == '[')
-            {
-              ASSERT_MES_AND_THROW("array of array not suppoerted yet :( sorry"); 
-              //mean array of array
-            }
-            if(*it == '{')
-            {
-              //mean array of sections
-              typename t_storage::hsection new_sec = nullptr;
-              h_array = stg.insert_first_section(name, new_sec, current_section);
-              CHECK_AND_ASSERT_THROW_MES(h_array&&new_sec, "failed to create new section");
-              run_handler(new_sec, it, buf_end, stg, recursion + 1);
-              state = match_state_array_after_value;
-              array_md = array_mode_sections;
-            }else if(*it == '"')
-            {
-              //mean array of strings
-              std::string val;
-              match_string2(it, buf_end, val);
-              h_array = stg.insert_first_value(name, std::move(val), current_section);
-              CHECK_AND_ASSERT_THROW_MES(h_array, " failed to insert values entry");
-              state = match_state_array_after_value;
-              array_md = array_mode_string;
-            }else if (epee::misc_utils::parse::isdigit(*it) || *it == '-')
-            {//array of numbers value started
-              boost::string_ref val;
-              bool is_v_float = false;bool is_signed_val = false;
-              match_number2(it, buf_end, val, is_v_float, is_signed_val);
-              if(!is_v_float)
-              {
-                if (is_signed_val)
-                {
-                  errno = 0;
-                  int64_t nval = strtoll(val.data(), NULL, 10);
-                  if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                  h_array = stg.insert_first_value(name, int64_t(nval), current_section);
-                }else
-                {
-                  errno = 0;
-                  uint64_t nval = strtoull(val.data(), NULL, 10);
-                  if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                  h_array = stg.insert_first_value(name, uint64_t(nval), current_section);
-                }
-                CHECK_AND_ASSERT_THROW_MES(h_array, " failed to insert values section entry");
-              }else
-              {
-                errno = 0;
-                double nval = strtod(val.data(), NULL);
-                if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                h_array = stg.insert_first_value(name, double(nval), current_section);
-                CHECK_AND_ASSERT_THROW_MES(h_array, " failed to insert values section entry");
-              }
+            top.array = m_stg.insert_first_value(top.name, std::forward<T>(val), top.section);
+            return top.array || fail("failed to insert values entry");
+          }
+          return m_stg.insert_next_value(top.array, std::forward<T>(val)) || fail("mixed types in array");
+        }
+
+      public:
+        const char* m_error;
 
-              state = match_state_array_after_value;
-              array_md = array_mode_numbers;
-            }else if(*it == ']')//empty array
-            {
-              array_md = array_mode_undifined;
-              state = match_state_wonder_after_value;
-            }else if(isalpha(*it) )
-            {// array of booleans
-              boost::string_ref word;
-              match_word2(it, buf_end, word);
-              if(boost::iequals(word, "true"))
-              {
-                h_array = stg.insert_first_value(name, true, current_section);              
-                CHECK_AND_ASSERT_THROW_MES(h_array, " failed to insert values section entry");
-                state = match_state_array_after_value;
-                array_md = array_mode_booleans;
-              }else if(boost::iequals(word, "false"))
-              {
-                h_array = stg.insert_first_value(name, false, current_section);              
-                CHECK_AND_ASSERT_THROW_MES(h_array, " failed to insert values section entry");
-                state = match_state_array_after_value;
-                array_md = array_mode_booleans;
+        explicit storage_handler(t_storage& stg)
+          : m_stg(stg), m_stack(), m_name(), m_sections(0), m_error(nullptr)
+        {}
 
-              }else ASSERT_MES_AND_THROW("Unknown value keyword " << word)
-            }else CHECK_ISSPACE();
-            break;
-          case match_state_array_after_value:
-            if(*it == ',')
-              state = match_state_array_waiting_value;
-            else if(*it == ']')
-            {
-              h_array = nullptr;
-              array_md = array_mode_undifined;
-              state = match_state_wonder_after_value;
-            }else CHECK_ISSPACE();
-            break;
-          case match_state_array_waiting_value:
-            switch(array_md)
-            {
-            case array_mode_sections:
-              if(*it == '{')
-              {
-                typename t_storage::hsection new_sec = NULL;
-                bool res = stg.insert_next_section(h_array, new_sec);
-                CHECK_AND_ASSERT_THROW_MES(res&&new_sec, "failed to insert next section");
-                run_handler(new_sec, it, buf_end, stg, recursion + 1);
-                state = match_state_array_after_value;
-              }else CHECK_ISSPACE();
-              break;
-            case array_mode_string:
-              if(*it == '"')
-              {
-                std::string val;
-                match_string2(it, buf_end, val);
-                bool res = stg.insert_next_value(h_array, std::move(val));
-                CHECK_AND_ASSERT_THROW_MES(res, "failed to insert values");
-                state = match_state_array_after_value;
-              }else CHECK_ISSPACE();
-              break;
-            case array_mode_numbers:
-              if (epee::misc_utils::parse::isdigit(*it) || *it == '-')
-              {//array of numbers value started
-                boost::string_ref val;
-                bool is_v_float = false;bool is_signed_val = false;
-                match_number2(it, buf_end, val, is_v_float, is_signed_val);
-                bool insert_res = false;
-                if(!is_v_float)
-                {
-                  if (is_signed_val)
-                  {
-                    errno = 0;
-                    int64_t nval = strtoll(val.data(), NULL, 10);
-                    if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                    insert_res = stg.insert_next_value(h_array, int64_t(nval));
-                  }else
-                  {
-                    errno = 0;
-                    uint64_t nval = strtoull(val.data(), NULL, 10);
-                    if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                    insert_res = stg.insert_next_value(h_array, uint64_t(nval));
-                  }
-                }else
-                {
-                  errno = 0;
-                  double nval = strtod(val.data(), NULL);
-                  if (errno) throw std::runtime_error("Invalid number: " + std::string(val));
-                  insert_res = stg.insert_next_value(h_array, double(nval));
-                }
-                CHECK_AND_ASSERT_THROW_MES(insert_res, "Failed to insert next value");
-                state = match_state_array_after_value;
-                array_md = array_mode_numbers;
-              }else CHECK_ISSPACE();
-              break;
-            case array_mode_booleans:
-              if(isalpha(*it) )
-              {// array of booleans
-                boost::string_ref word;
-                match_word2(it, buf_end, word);
-                if(boost::iequals(word, "true"))
-                {
-                  bool r = stg.insert_next_value(h_array, true);              
-                  CHECK_AND_ASSERT_THROW_MES(r, " failed to insert values section entry");
-                  state = match_state_array_after_value;
-                }else if(boost::iequals(word, "false"))
-                {
-                  bool r = stg.insert_next_value(h_array, false);
-                  CHECK_AND_ASSERT_THROW_MES(r, " failed to insert values section entry");
-                  state = match_state_array_after_value;
-                }
-                else ASSERT_MES_AND_THROW("Unknown value keyword " << word);
-              }else CHECK_ISSPACE();
-              break;
-            case array_mode_undifined:
-            default:
-              ASSERT_MES_AND_THROW("Bad array state");
-            }
-            break;
-          case match_state_error:
-          default:
-            ASSERT_MES_AND_THROW("WRONG JSON STATE");
+        bool Null()
+        {
+          if (!m_stack.empty() && m_stack.back().is_array)
+            return fail("null in array");
+          return !m_stack.empty() || fail("JSON document is not an object");
+        }
+        bool Bool(bool b) { return value(bool(b)); }
+        bool Int(int i) { return value(int64_t(i)); }
+        bool Uint(unsigned u) { return value(uint64_t(u)); }
+        bool Int64(int64_t i) { return value(int64_t(i)); }
+        bool Uint64(uint64_t u) { return value(uint64_t(u)); }
+        bool Double(double d) { return value(double(d)); }
+        bool RawNumber(const char*, rapidjson::SizeType, bool) { return fail("raw numbers not supported"); }
+        bool String(const char* str, rapidjson::SizeType length, bool)
+        {
+          return value(std::string(str, length));
+        }
+        bool Key(const char* str, rapidjson::SizeType length, bool)
+        {
+          m_name.assign(str, length);
+          return true;
+        }
+
+        bool StartObject()
+        {
+          if (m_sections >= EPEE_JSON_RECURSION_LIMIT_INTERNAL)
+            return fail("recursion limitation exceeded");
+          typename t_storage::hsection section = nullptr;
+          if (!m_stack.empty())
+          {
+            frame& top = m_stack.back();
+            if (!top.is_array)
+              section = m_stg.open_section(m_name, top.section, true);
+            else if (!top.array)
+              top.array = m_stg.insert_first_section(top.name, section, top.section);
+            else if (!m_stg.insert_next_section(top.array, section))
+              section = nullptr;
+            if (!section)
+              return fail("failed to insert new section");
           }
+          ++m_sections;
+          m_stack.push_back({section, nullptr, std::string(), false});
+          return true;
         }
-      }
+        bool EndObject(rapidjson::SizeType)
+        {
+          --m_sections;
+          m_stack.pop_back();
+          return true;
+        }
+
+        bool StartArray()
+        {
+          if (m_stack.empty())
+            return fail("JSON document is not an object");
+          if (m_stack.back().is_array)
+            return fail("array of array not supported");
+          const typename t_storage::hsection section = m_stack.back().section;
+          m_stack.push_back({section, nullptr, std::move(m_name), true});
+          return true;
+        }
+        bool EndArray(rapidjson::SizeType)
+        {
+          m_stack.pop_back();
+          return true;
+        }
+      };
 /*
 {
     "firstName": "John",
@@ -392,22 +188,19 @@ namespace epee
       template<class t_storage>
       inline bool load_from_json(const std::string& buff_json, t_storage& stg)
       {
-        std::string::const_iterator sec_buf_begin  = buff_json.begin();
-        try
-        {
-          run_handler(nullptr, sec_buf_begin, buff_json.end(), stg, 0);
-          return true;
-        }
-        catch(const std::exception& ex)
-        {
-          MERROR("Failed to parse json, what: " << ex.what());
-          return false;
-        }
-        catch(...)
+        // data after the top-level object has always been ignored
+        static constexpr unsigned flags = rapidjson::kParseStopWhenDoneFlag;
+
+        storage_handler<t_storage> handler{stg};
+        rapidjson::Reader reader{};
+        rapidjson::StringStream stream{buff_json.c_str()};
+        if (!reader.Parse<flags>(stream, handler))
         {
-          MERROR("Failed to parse json");
+          MERROR("Failed to parse json, what: " << (handler.m_error ? handler.m_error : rapidjson::GetParseError_En(reader.GetParseErrorCode()))
+            << " at offset " << reader.GetErrorOffset());
           return false;
         }
+        return true;
       }
     }
   }
@@ -0,0 +1,243 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    //! An open object or array of a json_writer, declared here so handles can be forward declared
+    struct json_writer_frame
+    {
+      std::size_t count;
+      std::size_t indent;
+      bool is_array;
+    };
+
+    /*! Writes the JSON portable_storage::dump_as_json would produce for a
+     *  KV_SERIALIZE map while the map is being walked, without building a
+     *  section tree first. Like binary_writer it offers the storing half of
+     *  the portable_storage interface and relies on entries being stored
+     *  depth first. Fields come out in declaration order rather than sorted.
+     */
+    class json_writer
+    {
+      typedef json_writer_frame frame;
+
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      json_writer(std::string &out, std::size_t indent, bool insert_newlines)
+        : m_out(out), m_newline(insert_newlines ? "\r\n" : "")
+      {
+        open_object(indent);
+      }
+
+      //! Closes the objects and arrays still open, after which the output is complete
+      void finish()
+      {
+        close_frames(0);
+      }
+
+      template<typename t_value>
+      bool set_value(const std::string& value_name, t_value&& v, hsection hparent_section)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        const frame &parent = begin_entry(value_name, hparent_section);
+        write_value(static_cast<const t_real_value&>(v), parent.indent + 1);
+        return true;
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false)
+      {
+        CHECK_AND_ASSERT_THROW_MES(create_if_notexist, "json_writer can only create sections");
+        const std::size_t indent = begin_entry(section_name, hparent_section).indent + 1;
+        return open_object(indent);
+      }
+
+      template<typename t_value>
+      harray insert_first_value(const std::string& value_name, t_value&& target, hsection hparent_section)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        const std::size_t indent = begin_entry(value_name, hparent_section).indent + 1;
+        harray hval_array = open_array(indent);
+        write_value(static_cast<const t_real_value&>(target), indent);
+        ++hval_array->count;
+        return hval_array;
+      }
+
+      template<typename t_value>
+      bool insert_next_value(harray hval_array, t_value&& target)
+      {
+        using t_real_value = typename std::decay<t_value>::type;
+        close_frames(index_of(hval_array) + 1);
+        m_out += ',';
+        write_value(static_cast<const t_real_value&>(target), hval_array->indent);
+        ++hval_array->count;
+        return true;
+      }
+
+      harray insert_first_section(const std::string& pSectionName, hsection& hinserted_childsection, hsection hparent_section)
+      {
+        const std::size_t indent = begin_entry(pSectionName, hparent_section).indent + 1;
+        harray hsec_array = open_array(indent);
+        ++hsec_array->count;
+        hinserted_childsection = open_object(indent);
+        return hsec_array;
+      }
+
+      bool insert_next_section(harray hSecArray, hsection& hinserted_childsection)
+      {
+        close_frames(index_of(hSecArray) + 1);
+        m_out += ',';
+        ++hSecArray->count;
+        hinserted_childsection = open_object(hSecArray->indent);
+        return true;
+      }
+
+    private:
+      std::size_t index_of(const frame *f) const
+      {
+        for (std::size_t i = m_frames.size(); i-- > 0; )
+          if (&m_frames[i] == f)
+            return i;
+        ASSERT_MES_AND_THROW("json_writer: object or array is already closed");
+      }
+
+      frame *open_object(std::size_t indent)
+      {
+        m_out += '{';
+        m_out += m_newline;
+        m_frames.push_back({0, indent, false});
+        return &m_frames.back();
+      }
+
+      frame *open_array(std::size_t indent)
+      {
+        m_out += '[';
+        m_frames.push_back({0, indent, true});
+        return &m_frames.back();
+      }
+
+      void close_frames(std::size_t keep)
+      {
+        while (m_frames.size() > keep)
+        {
+          const frame &f = m_frames.back();
+          if (f.is_array)
+            m_out += ']';
+          else
+          {
+            if (f.count)
+              m_out += m_newline;
+            m_out.append(f.indent * 2, ' ');
+            m_out += '}';
+          }
+          m_frames.pop_back();
+        }
+      }
+
+      const frame &begin_entry(const std::string &name, hsection hparent_section)
+      {
+        CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "json_writer: already finished");
+        if (!hparent_section)
+          hparent_section = &m_frames.front();
+        close_frames(index_of(hparent_section) + 1);
+        if (hparent_section->count++)
+        {
+          m_out += ',';
+          m_out += m_newline;
+        }
+        m_out.append((hparent_section->indent + 1) * 2, ' ');
+        write_string(name);
+        m_out += ": ";
+        return *hparent_section;
+      }
+
+      void write_string(const std::string &v)
+      {
+        m_out += '"';
+        m_out += misc_utils::parse::transform_to_escape_sequence(v);
+        m_out += '"';
+      }
+
+      void write_value(const std::string &v, std::size_t) { write_string(v); }
+      void write_value(bool v, std::size_t) { m_out += v ? "true" : "false"; }
+      void write_value(int8_t v, std::size_t) { m_out += std::to_string(static_cast<int32_t>(v)); }
+      void write_value(uint8_t v, std::size_t) { m_out += std::to_string(static_cast<int32_t>(v)); }
+
+      template<typename t_value>
+      typename std::enable_if<std::is_integral<t_value>::value>::type write_value(t_value v, std::size_t)
+      {
+        m_out += std::to_string(v);
+      }
+
+      void write_value(double v, std::size_t)
+      {
+        std::ostringstream ss;
+        ss << v;
+        m_out += ss.str();
+      }
+
+      void write_value(const storage_entry &v, std::size_t indent)
+      {
+        std::stringstream ss;
+        dump_as_json(ss, v, indent, !m_newline.empty());
+        m_out += ss.str();
+      }
+
+      std::string &m_out;
+      const std::string m_newline;
+      std::deque<frame> m_frames;
+    };
+
+    //-----------------------------------------------------------------------------------------------------------
+    //! Same text as storing into a portable_storage and dumping it, but with fields in declaration order
+    template<class t_struct>
+    bool write_t_to_json(const t_struct& str_in, std::string& json_buff, std::size_t indent = 0, bool insert_newlines = true)
+    {
+      json_buff.clear();
+      json_writer writer(json_buff, indent, insert_newlines);
+      str_in.store(writer);
+      writer.finish();
+      return true;
+    }
+  }
+}
@@ -29,8 +29,12 @@
 #include <string>
 
 #include "byte_slice.h"
+#include "byte_stream.h"
 #include "parserse_base_utils.h" /// TODO: (mj-xmr) This will be reduced in an another PR
 #include "portable_storage.h"
+#include "portable_storage_bin_reader.h"
+#include "portable_storage_bin_writer.h"
+#include "portable_storage_json_writer.h"
 #include "file_io_utils.h"
 #include "span.h"
 
@@ -65,10 +69,7 @@ namespace epee
     template<class t_struct>
     bool store_t_to_json(t_struct& str_in, std::string& json_buff, size_t indent = 0, bool insert_newlines = true)
     {
-      portable_storage ps;
-      str_in.store(ps);
-      ps.dump_as_json(json_buff, indent, insert_newlines);
-      return true;
+      return write_t_to_json(str_in, json_buff, indent, insert_newlines);
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -90,12 +91,12 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff, const epee::serialization::portable_storage::limits_t *limits = NULL)
     {
-      portable_storage ps;
-      bool rs = ps.load_from_binary(binary_buff, limits);
+      binary_reader reader;
+      bool rs = reader.load_from_binary(binary_buff, limits);
       if(!rs)
         return false;
 
-      return out.load(ps);
+      return out.load(reader);
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -117,9 +118,12 @@ namespace epee
     template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, byte_slice& binary_buff, size_t initial_buffer_size = 8192)
     {
-      portable_storage ps;
-      str_in.store(ps);
-      return ps.store_to_binary(binary_buff, initial_buffer_size);
+      byte_stream ss;
+      ss.reserve(initial_buffer_size);
+      if (!write_t_to_binary(str_in, ss))
+        return false;
+      binary_buff = byte_slice{std::move(ss), false};
+      return true;
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -133,9 +137,7 @@ namespace epee
     template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, byte_stream& binary_buff)
     {
-      portable_storage ps;
-      str_in.store(ps);
-      return ps.store_to_binary(binary_buff);
+      return write_t_to_binary(str_in, binary_buff);
     }
 
   }
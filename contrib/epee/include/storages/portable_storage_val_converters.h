@@ -203,5 +203,17 @@ POP_WARNINGS
     {
       convert_to_same<from_type, to_type, std::is_same<to_type, from_type>::value>::convert(from, to);
     }
+
+    //! Same as `convert_t`, but leaves `from` empty when it can be moved to `to`
+    template<class to_type>
+    void move_t(std::string& from, to_type& to)
+    {
+      convert_t(from, to);
+    }
+
+    inline void move_t(std::string& from, std::string& to)
+    {
+      to = std::move(from);
+    }
   }
 }
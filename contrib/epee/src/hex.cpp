@@ -28,6 +28,7 @@
 
 #include "hex.h"
 
+#include <algorithm>
 #include <iterator>
 #include <limits>
 #include <ostream>
@@ -35,6 +36,14 @@
 
 #include "storages/parserse_base_utils.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace epee
 {
   namespace
@@ -52,6 +61,149 @@ namespace epee
         ++out;
       }
     }
+
+    /* The vector kernels below handle the bulk of the input (hashes, keys and
+       tx blobs in RPC responses), the scalar loops finish the remainder. Each
+       returns the number of source bytes it consumed. */
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    inline __m128i nibbles_to_hex(const __m128i nibbles) noexcept
+    {
+      const __m128i over_nine = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+      const __m128i ascii = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+      return _mm_add_epi8(ascii, _mm_and_si128(over_nine, _mm_set1_epi8('a' - '0' - 10)));
+    }
+
+    //! \return 0xff per valid hex char, value of the char in `out`
+    inline __m128i hex_to_nibbles(const __m128i chars, __m128i& out) noexcept
+    {
+      const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+      const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+      const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+      const __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+      out = _mm_or_si128(
+        _mm_and_si128(is_digit, digit),
+        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10)))
+      );
+      return _mm_or_si128(is_digit, is_letter);
+    }
+
+    //! Combines `hi lo` char pairs (already converted to nibbles) into bytes
+    inline __m128i pack_nibbles(const __m128i first, const __m128i second) noexcept
+    {
+      const __m128i low_byte = _mm_set1_epi16(0x00ff);
+      const __m128i a = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(first, low_byte), 4), _mm_srli_epi16(first, 8));
+      const __m128i b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(second, low_byte), 4), _mm_srli_epi16(second, 8));
+      return _mm_packus_epi16(a, b);
+    }
+
+    std::size_t encode_vector(char* out, const std::uint8_t* src, const std::size_t size) noexcept
+    {
+      std::size_t i = 0;
+#if defined(__AVX2__)
+      const __m256i low_mask = _mm256_set1_epi8(0x0f);
+      for (; i + 32 <= size; i += 32, out += 64)
+      {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_mask);
+        const __m256i lo = _mm256_and_si256(bytes, low_mask);
+        const __m256i over_nine_hi = _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(9));
+        const __m256i over_nine_lo = _mm256_cmpgt_epi8(lo, _mm256_set1_epi8(9));
+        const __m256i hex_hi = _mm256_add_epi8(_mm256_add_epi8(hi, _mm256_set1_epi8('0')), _mm256_and_si256(over_nine_hi, _mm256_set1_epi8('a' - '0' - 10)));
+        const __m256i hex_lo = _mm256_add_epi8(_mm256_add_epi8(lo, _mm256_set1_epi8('0')), _mm256_and_si256(over_nine_lo, _mm256_set1_epi8('a' - '0' - 10)));
+        // unpack works per 128-bit lane, fix up the lane order afterwards
+        const __m256i first = _mm256_unpacklo_epi8(hex_hi, hex_lo);
+        const __m256i second = _mm256_unpackhi_epi8(hex_hi, hex_lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+      }
+#endif
+      const __m128i low_mask_128 = _mm_set1_epi8(0x0f);
+      for (; i + 16 <= size; i += 16, out += 32)
+      {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i hi = nibbles_to_hex(_mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask_128));
+        const __m128i lo = nibbles_to_hex(_mm_and_si128(bytes, low_mask_128));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+      }
+      return i;
+    }
+
+    bool decode_vector(std::uint8_t* dst, const char* src, const std::size_t size, std::size_t& consumed) noexcept
+    {
+      std::size_t i = 0;
+      for (; i + 32 <= size; i += 32, dst += 16)
+      {
+        __m128i first, second;
+        const __m128i valid_first = hex_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), first);
+        const __m128i valid_second = hex_to_nibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16)), second);
+        if (_mm_movemask_epi8(_mm_and_si128(valid_first, valid_second)) != 0xffff)
+          return false;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pack_nibbles(first, second));
+      }
+      consumed = i;
+      return true;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    inline uint8x16_t nibbles_to_hex(const uint8x16_t nibbles) noexcept
+    {
+      const uint8x16_t over_nine = vcgtq_u8(nibbles, vdupq_n_u8(9));
+      return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), vandq_u8(over_nine, vdupq_n_u8('a' - '0' - 10)));
+    }
+
+    inline uint8x16_t hex_to_nibbles(const uint8x16_t chars, uint8x16_t& out) noexcept
+    {
+      const uint8x16_t digit = vsubq_u8(chars, vdupq_n_u8('0'));
+      const uint8x16_t is_digit = vcleq_u8(digit, vdupq_n_u8(9));
+      const uint8x16_t letter = vsubq_u8(vorrq_u8(chars, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+      const uint8x16_t is_letter = vcleq_u8(letter, vdupq_n_u8(5));
+      out = vbslq_u8(is_digit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+      return vorrq_u8(is_digit, is_letter);
+    }
+
+    std::size_t encode_vector(char* out, const std::uint8_t* src, const std::size_t size) noexcept
+    {
+      std::size_t i = 0;
+      for (; i + 16 <= size; i += 16, out += 32)
+      {
+        const uint8x16_t bytes = vld1q_u8(src + i);
+        uint8x16x2_t hex;
+        hex.val[0] = nibbles_to_hex(vshrq_n_u8(bytes, 4));
+        hex.val[1] = nibbles_to_hex(vandq_u8(bytes, vdupq_n_u8(0x0f)));
+        vst2q_u8(reinterpret_cast<std::uint8_t*>(out), hex);
+      }
+      return i;
+    }
+
+    bool decode_vector(std::uint8_t* dst, const char* src, const std::size_t size, std::size_t& consumed) noexcept
+    {
+      std::size_t i = 0;
+      for (; i + 32 <= size; i += 32, dst += 16)
+      {
+        // de-interleaves high and low nibble chars
+        const uint8x16x2_t chars = vld2q_u8(reinterpret_cast<const std::uint8_t*>(src + i));
+        uint8x16_t hi, lo;
+        const uint8x16_t valid = vandq_u8(hex_to_nibbles(chars.val[0], hi), hex_to_nibbles(chars.val[1], lo));
+        if (vminvq_u8(valid) != 0xff)
+          return false;
+        vst1q_u8(dst, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+      }
+      consumed = i;
+      return true;
+    }
+#else
+    std::size_t encode_vector(char*, const std::uint8_t*, std::size_t) noexcept
+    {
+      return 0;
+    }
+
+    bool decode_vector(std::uint8_t*, const char*, std::size_t, std::size_t& consumed) noexcept
+    {
+      consumed = 0;
+      return true;
+    }
+#endif
   }
 
   template<typename T>
@@ -71,7 +223,21 @@ namespace epee
 
   void to_hex::buffer(std::ostream& out, const span<const std::uint8_t> src)
   {
-    write_hex(std::ostreambuf_iterator<char>{out}, src);
+    char chunk[512];
+    for (std::size_t offset = 0; offset < src.size(); offset += sizeof(chunk) / 2)
+    {
+      const std::size_t size = std::min(src.size() - offset, sizeof(chunk) / 2);
+      buffer_unchecked(chunk, {src.data() + offset, size});
+      out.write(chunk, size * 2);
+    }
+  }
+
+  bool to_hex::buffer(span<char> out, const span<const std::uint8_t> src) noexcept
+  {
+    if (out.size() / 2 != src.size() || out.size() % 2 != 0)
+      return false;
+    buffer_unchecked(out.data(), src);
+    return true;
   }
 
   void to_hex::formatted(std::ostream& out, const span<const std::uint8_t> src)
@@ -83,7 +249,8 @@ namespace epee
 
   void to_hex::buffer_unchecked(char* out, const span<const std::uint8_t> src) noexcept
   {
-    return write_hex(out, src);
+    const std::size_t done = encode_vector(out, src.data(), src.size());
+    return write_hex(out + done * 2, {src.data() + done, src.size() - done});
   }
 
 
@@ -105,8 +272,13 @@ namespace epee
       if (s.size() % 2 != 0)
         return false;
 
-      const unsigned char *src = (const unsigned char *)s.data();
-      for(size_t i = 0; i < s.size(); i += 2)
+      size_t done = 0;
+      if (!decode_vector(dst, s.data(), s.size(), done))
+        return false;
+      dst += done / 2;
+
+      const unsigned char *src = (const unsigned char *)s.data() + done;
+      for(size_t i = done; i < s.size(); i += 2)
       {
         int tmp = *src++;
         tmp = epee::misc_utils::parse::isx[tmp];
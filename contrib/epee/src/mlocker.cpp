@@ -37,13 +37,20 @@
 #endif
 #include "misc_log_ex.h"
 #include "syncobj.h"
+#include "memwipe.h"
 #include "mlocker.h"
 
+#include <algorithm>
 #include <atomic>
+#include <string.h>
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "mlocker"
 
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_MAX_SLABS 64
+#define POOL_THREAD_CACHE_BATCH 32
+
 // did an mlock operation previously fail? we only
 // want to log an error once and be done with it
 static std::atomic<bool> previously_failed{ false };
@@ -89,11 +96,186 @@ static void do_unlock(void *ptr, size_t len)
 #endif
 }
 
+namespace
+{
+  constexpr size_t num_slot_classes = 7; // 32 to 2048 bytes
+  static_assert(epee::mlocked_pool::min_slot_size << (num_slot_classes - 1) == epee::mlocked_pool::max_slot_size, "Inconsistent slot classes");
+
+  size_t slot_class(size_t size)
+  {
+    size_t c = 0;
+    while ((epee::mlocked_pool::min_slot_size << c) < size)
+      ++c;
+    return c;
+  }
+
+  size_t slab_size()
+  {
+    static const size_t size = std::max<size_t>(POOL_SLAB_SIZE, epee::mlocker::get_page_size());
+    return size;
+  }
+
+  void *next_slot(void *slot)
+  {
+    void *next;
+    memcpy(&next, slot, sizeof(next));
+    return next;
+  }
+
+  void set_next_slot(void *slot, void *next)
+  {
+    memcpy(slot, &next, sizeof(next));
+  }
+
+  // free slots shared by all threads, threads take and give back slots in batches
+  struct pool_state
+  {
+    boost::mutex mutex;
+    std::atomic<uintptr_t> region{0};
+    size_t num_slabs = 0;
+    void *free_slots[num_slot_classes] = {};
+  };
+
+  pool_state &pool()
+  {
+    static pool_state *state = new pool_state();
+    return *state;
+  }
+
+  // carves a new slab into free slots of the given class, with the pool mutex held
+  bool add_slab(pool_state &state, size_t c)
+  {
+#if defined HAVE_MLOCK
+    const size_t size = slab_size();
+    if (state.region.load(std::memory_order_relaxed) == 0)
+    {
+      // reserve the address space for all slabs up front, so telling whether
+      // some memory is part of the pool is a single range check
+      void *region = mmap(NULL, size * POOL_MAX_SLABS, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (region == MAP_FAILED)
+      {
+        MERROR("Failed to reserve address space for the mlocked pool: " << strerror(errno));
+        return false;
+      }
+      state.region.store((uintptr_t)region, std::memory_order_release);
+    }
+    if (state.num_slabs == POOL_MAX_SLABS)
+      return false;
+    char *slab = (char*)state.region.load(std::memory_order_relaxed) + state.num_slabs * size;
+    if (mprotect(slab, size, PROT_READ | PROT_WRITE) < 0)
+    {
+      MERROR("Failed to map mlocked pool slab: " << strerror(errno));
+      return false;
+    }
+    do_lock(slab, size);
+    ++state.num_slabs;
+
+    const size_t slot_size = epee::mlocked_pool::min_slot_size << c;
+    for (size_t offset = size; offset >= slot_size; offset -= slot_size)
+    {
+      void *slot = slab + offset - slot_size;
+      set_next_slot(slot, state.free_slots[c]);
+      state.free_slots[c] = slot;
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  struct thread_cache
+  {
+    void *free_slots[num_slot_classes] = {};
+    size_t num_free_slots[num_slot_classes] = {};
+
+    ~thread_cache()
+    {
+      for (size_t c = 0; c < num_slot_classes; ++c)
+        release(c, num_free_slots[c]);
+    }
+
+    bool refill(size_t c)
+    {
+      pool_state &state = pool();
+      CRITICAL_REGION_LOCAL(state.mutex);
+      if (!state.free_slots[c] && !add_slab(state, c))
+        return false;
+      for (size_t n = 0; n < POOL_THREAD_CACHE_BATCH && state.free_slots[c]; ++n)
+      {
+        void *slot = state.free_slots[c];
+        state.free_slots[c] = next_slot(slot);
+        set_next_slot(slot, free_slots[c]);
+        free_slots[c] = slot;
+        ++num_free_slots[c];
+      }
+      return true;
+    }
+
+    void release(size_t c, size_t count)
+    {
+      if (count == 0)
+        return;
+      pool_state &state = pool();
+      CRITICAL_REGION_LOCAL(state.mutex);
+      for (size_t n = 0; n < count; ++n)
+      {
+        void *slot = free_slots[c];
+        free_slots[c] = next_slot(slot);
+        set_next_slot(slot, state.free_slots[c]);
+        state.free_slots[c] = slot;
+      }
+      num_free_slots[c] -= count;
+    }
+  };
+
+  thread_local thread_cache cache;
+}
+
 namespace epee
 {
-  size_t mlocker::page_size = 0;
   size_t mlocker::num_locked_objects = 0;
 
+  constexpr size_t mlocked_pool::min_slot_size;
+  constexpr size_t mlocked_pool::max_slot_size;
+
+  void *mlocked_pool::allocate(size_t size)
+  {
+    if (size > max_slot_size)
+      return NULL;
+    const size_t c = slot_class(size);
+    if (!cache.free_slots[c] && !cache.refill(c))
+      return NULL;
+    void *slot = cache.free_slots[c];
+    cache.free_slots[c] = next_slot(slot);
+    --cache.num_free_slots[c];
+    return slot;
+  }
+
+  void mlocked_pool::deallocate(void *ptr, size_t size)
+  {
+    if (!ptr)
+      return;
+    const size_t c = slot_class(size);
+    memwipe(ptr, min_slot_size << c);
+    set_next_slot(ptr, cache.free_slots[c]);
+    cache.free_slots[c] = ptr;
+    if (++cache.num_free_slots[c] > 2 * POOL_THREAD_CACHE_BATCH)
+      cache.release(c, POOL_THREAD_CACHE_BATCH);
+  }
+
+  bool mlocked_pool::contains(const void *ptr)
+  {
+    const uintptr_t region = pool().region.load(std::memory_order_acquire);
+    return region && (uintptr_t)ptr - region < slab_size() * POOL_MAX_SLABS;
+  }
+
+  size_t mlocked_pool::get_num_slabs()
+  {
+    pool_state &state = pool();
+    CRITICAL_REGION_LOCAL(state.mutex);
+    return state.num_slabs;
+  }
+
   boost::mutex &mlocker::mutex()
   {
     static boost::mutex *vmutex = new boost::mutex();
@@ -107,9 +289,7 @@ namespace epee
 
   size_t mlocker::get_page_size()
   {
-    CRITICAL_REGION_LOCAL(mutex());
-    if (page_size == 0)
-      page_size = query_page_size();
+    static const size_t page_size = query_page_size();
     return page_size;
   }
 
@@ -128,6 +308,10 @@ namespace epee
   {
     TRY_ENTRY();
 
+    // pool pages are locked for good
+    if (mlocked_pool::contains(ptr))
+      return;
+
     size_t page_size = get_page_size();
     if (page_size == 0)
       return;
@@ -146,6 +330,9 @@ namespace epee
   {
     TRY_ENTRY();
 
+    if (mlocked_pool::contains(ptr))
+      return;
+
     size_t page_size = get_page_size();
     if (page_size == 0)
       return;
@@ -173,6 +360,7 @@ namespace epee
 
   void mlocker::lock_page(size_t page)
   {
+    const size_t page_size = get_page_size();
     std::pair<std::map<size_t, unsigned int>::iterator, bool> p = map().insert(std::make_pair(page, 1));
     if (p.second)
     {
@@ -186,6 +374,7 @@ namespace epee
 
   void mlocker::unlock_page(size_t page)
   {
+    const size_t page_size = get_page_size();
     std::map<size_t, unsigned int>::iterator i = map().find(page);
     if (i == map().end())
     {
@@ -137,6 +137,8 @@ network_throttle::network_throttle(const std::string &nameshort, const std::stri
 	m_history.resize(m_window_size);
 	m_total_packets = 0;
 	m_total_bytes = 0;
+	m_bucket_tokens = m_target_speed;
+	m_bucket_time = get_time_seconds();
 }
 
 void network_throttle::set_name(const std::string &name) 
@@ -146,7 +148,11 @@ void network_throttle::set_name(const std::string &name)
 
 void network_throttle::set_target_speed( network_speed_kbps target ) 
 {
+	const network_time_seconds now = get_time_seconds();
+	m_bucket_tokens = get_bucket_tokens(now);
+	m_bucket_time = now;
     m_target_speed = target * 1024;
+	m_bucket_tokens = std::min(m_bucket_tokens, m_target_speed);
 	MINFO("Setting LIMIT: " << target << " kbps");
 }
 
@@ -195,6 +201,8 @@ void network_throttle::_handle_trafic_exact(size_t packet_size, size_t orginal_s
 	m_history.front().m_size += packet_size;
 	m_total_packets++;
 	m_total_bytes += packet_size;
+	m_bucket_tokens = get_bucket_tokens(m_last_sample_time) - packet_size;
+	m_bucket_time = m_last_sample_time;
 
 	std::ostringstream oss; oss << "["; 	for (auto sample: m_history) oss << sample.m_size << " ";	 oss << "]" << std::ends;
 	std::string history_str = oss.str();
@@ -234,13 +242,23 @@ void network_throttle::logger_handle_net(const std::string &filename, double tim
     }
 }
 
-// fine tune this to decide about sending speed:
+double network_throttle::get_bucket_tokens(network_time_seconds now) const
+{
+	const network_time_seconds elapsed = std::max(0.0, now - m_bucket_time);
+	return std::min(m_target_speed, m_bucket_tokens + elapsed * m_target_speed);
+}
+
+// time until the bucket holds enough tokens for the packet. The caller does
+// not sleep on it, it schedules the packet (or the next one) that much later.
 network_time_seconds network_throttle::get_sleep_time(size_t packet_size) const 
 {
-	double D2=0;
-	calculate_times_struct cts = { 0, 0, 0, 0};
-	calculate_times(packet_size, cts, true, m_window_size); D2=cts.delay;
-	return D2;
+	if (m_target_speed <= 0)
+		return 0;
+	const double tokens = get_bucket_tokens(get_time_seconds());
+	const network_time_seconds delay = std::max(0.0, (packet_size - tokens) / m_target_speed);
+	if (delay > 0)
+		MTRACE("Throttle " << m_name << ": " << tokens << " tokens for " << packet_size << " b, delaying " << delay << " s");
+	return delay;
 }
 
 // MAIN LOGIC:
@@ -41,11 +41,15 @@ namespace misc_utils
   {
     std::string transform_to_escape_sequence(const std::string& src)
     {
-      static const char escaped[] = "\b\f\n\r\t\v\"\\/";
-      std::string::const_iterator it = std::find_first_of(src.begin(), src.end(), escaped, escaped + sizeof(escaped));
+      // control characters are not allowed raw in JSON strings
+      const auto needs_escape = [](const char c) {
+        return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\' || c == '/';
+      };
+      std::string::const_iterator it = std::find_if(src.begin(), src.end(), needs_escape);
       if (it == src.end())
         return src;
 
+      static const char hex[] = "0123456789abcdef";
       std::string res;
       res.reserve(2 * src.size());
       res.assign(src.begin(), it);
@@ -63,8 +67,6 @@ namespace misc_utils
           res+="\\r"; break;
         case '\t':  //Tab
           res+="\\t"; break;
-        case '\v':  //Vertical tab
-          res+="\\v"; break;
         //case '\'':  //Apostrophe or single quote
         //  res+="\\'"; break;
         case '"':  //Double quote
@@ -74,7 +76,14 @@ namespace misc_utils
         case '/':  //Backslash caracter
           res+="\\/"; break;
         default:
-          res.push_back(*it);
+          if (static_cast<unsigned char>(*it) < 0x20)
+          {
+            res+="\\u00";
+            res.push_back(hex[static_cast<unsigned char>(*it) >> 4]);
+            res.push_back(hex[*it & 0x0f]);
+          }
+          else
+            res.push_back(*it);
         }
       }
       return res;
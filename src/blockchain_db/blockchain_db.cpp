@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <numeric>
 #include <boost/range/adaptor/reversed.hpp>
 
 #include "string_tools.h"
@@ -160,6 +161,23 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_compress_prunable  = {
+  "db-compress-prunable"
+, "Compress prunable transaction data on disk. Existing data is converted on startup, and this cannot be undone"
+, false
+};
+
+const command_line::arg_descriptor<bool> arg_db_key_image_filter  = {
+  "db-key-image-filter"
+, "Keep an in memory filter of spent key images, so most unspent key image checks skip the database. Uses about 1.25 bytes of RAM per spent key image"
+, false
+};
+
+const command_line::arg_descriptor<bool> arg_db_read_ahead  = {
+  "db-read-ahead"
+, "Detect sequential block range reads (syncing peers, wallet refreshes from old heights) and load the following blocks and transactions from disk in the background"
+, false
+};
 
 BlockchainDB *new_db()
 {
@@ -170,6 +188,9 @@ void BlockchainDB::init_options(boost::program_options::options_description& des
 {
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_compress_prunable);
+  command_line::add_arg(desc, arg_db_key_image_filter);
+  command_line::add_arg(desc, arg_db_read_ahead);
 }
 
 void BlockchainDB::pop_block()
@@ -297,6 +318,18 @@ uint64_t BlockchainDB::add_block( const std::pair<block, blobdata>& blck
   // call out to subclass implementation to add the block & metadata
   time1 = epee::misc_utils::get_tick_count();
   add_block(blk, block_weight, long_term_block_weight, cumulative_difficulty, coins_generated, num_rct_outs, blk_hash);
+  if (blk.major_version >= HF_VERSION_VIEW_TAGS && has_view_tag_index())
+  {
+    block_view_tags tags;
+    tags.txes.resize(txs.size() + 1);
+    get_tx_view_tags(blk.miner_tx, get_transaction_hash(blk.miner_tx), tags.txes[0]);
+    for (size_t i = 0; i < txs.size(); ++i)
+      get_tx_view_tags(txs[i].first, blk.tx_hashes[i], tags.txes[i + 1]);
+    blobdata blob;
+    if (!t_serializable_object_to_blob(tags, blob))
+      throw DB_ERROR("Failed to serialize block view tags");
+    add_block_view_tags(prev_height, blob);
+  }
   TIME_MEASURE_FINISH(time1);
   time_add_block1 += time1;
 
@@ -1024,6 +1057,94 @@ void BlockchainDB::fixup()
   batch_stop();
 }
 
+void BlockchainDB::get_output_keys_batch(const std::vector<uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs) const
+{
+  get_output_key(epee::to_span(amounts), offsets, outputs);
+}
+
+std::vector<uint64_t> BlockchainDB::get_block_cumulative_rct_outputs_range(uint64_t start_height, uint64_t count) const
+{
+  std::vector<uint64_t> heights(count);
+  std::iota(heights.begin(), heights.end(), start_height);
+  return get_block_cumulative_rct_outputs(heights);
+}
+
+bool BlockchainDB::has_output_pubkey_index() const
+{
+  return false;
+}
+
+bool BlockchainDB::build_output_pubkey_index()
+{
+  return false;
+}
+
+bool BlockchainDB::get_output_index_by_pubkey(const crypto::public_key &pubkey, uint64_t &amount, uint64_t &amount_index) const
+{
+  throw DB_ERROR("Output public key index not supported by this database");
+}
+
+bool BlockchainDB::has_view_tag_index() const
+{
+  return false;
+}
+
+bool BlockchainDB::build_view_tag_index()
+{
+  return false;
+}
+
+void BlockchainDB::get_blocks_view_tags(uint64_t start_height, size_t count, std::vector<blobdata> &blobs) const
+{
+  throw DB_ERROR("View tag index not supported by this database");
+}
+
+void BlockchainDB::add_block_view_tags(uint64_t height, const blobdata &blob)
+{
+  throw DB_ERROR("View tag index not supported by this database");
+}
+
+bool BlockchainDB::get_db_stats(db_stats &stats) const
+{
+  return false;
+}
+
+bool BlockchainDB::for_all_key_images_parallel(const std::function<bool(const crypto::key_image&)> &f) const
+{
+  return for_all_key_images(f);
+}
+
+bool BlockchainDB::for_blocks_range_parallel(const uint64_t& h1, const uint64_t& h2, const std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> &f) const
+{
+  return for_blocks_range(h1, h2, f);
+}
+
+void BlockchainDB::set_hard_fork_voting_window(const hard_fork_voting_window &window)
+{
+}
+
+bool BlockchainDB::get_hard_fork_voting_window(hard_fork_voting_window &window) const
+{
+  return false;
+}
+
+bool BlockchainDB::for_all_transactions_parallel(const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const
+{
+  return for_all_transactions(f, pruned);
+}
+
+bool BlockchainDB::for_all_outputs_parallel(const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const
+{
+  return for_all_outputs(f);
+}
+
+void BlockchainDB::have_key_images_batch(const epee::span<const crypto::key_image> &imgs, std::vector<bool> &spent) const
+{
+  spent.resize(imgs.size());
+  for (size_t i = 0; i < imgs.size(); ++i)
+    spent[i] = has_key_image(imgs[i]);
+}
+
 bool BlockchainDB::txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category)
 {
   try
@@ -105,6 +105,9 @@ typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_compress_prunable;
+extern const command_line::arg_descriptor<bool, false> arg_db_key_image_filter;
+extern const command_line::arg_descriptor<bool, false> arg_db_read_ahead;
 
 enum class relay_category : uint8_t
 {
@@ -148,6 +151,55 @@ struct alt_block_data_t
   uint64_t already_generated_coins;
 };
 
+/**
+ * @brief per table storage and access statistics
+ *
+ * The access counters cover the hot lookup and insertion paths only, and
+ * count from the time the database was opened.
+ */
+struct db_table_stats
+{
+  std::string name;
+  uint64_t entries;
+  uint64_t depth;
+  uint64_t branch_pages;
+  uint64_t leaf_pages;
+  uint64_t overflow_pages;
+  uint64_t gets;
+  uint64_t misses;
+  uint64_t puts;
+  uint64_t deletes;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  std::vector<uint64_t> get_latency_histogram; //!< bucket i counts gets taking less than 2^i microseconds, the last bucket catches the rest
+};
+
+/**
+ * @brief database wide statistics, as returned by BlockchainDB::get_db_stats
+ */
+struct db_stats
+{
+  uint64_t map_size;
+  uint64_t page_size;
+  uint64_t last_page;       //!< highest page in use, a proxy for the resident set the OS has to page in
+  uint64_t max_readers;
+  uint64_t num_readers;
+  std::vector<db_table_stats> tables;
+};
+
+/**
+ * @brief a snapshot of the hard fork voting window, so HardFork::init can
+ * restore it without reading the last window_size blocks back
+ */
+struct hard_fork_voting_window
+{
+  uint64_t height;          //!< chain height the snapshot was taken at
+  crypto::hash top_hash;    //!< hash of the top block at that height
+  uint64_t window_size;
+  uint8_t max_version;      //!< highest fork version, votes above it are clamped to it
+  std::vector<uint8_t> versions; //!< effective votes of the last blocks, oldest first
+};
+
 /**
  * @brief a struct containing txpool per transaction metadata
  */
@@ -172,7 +224,9 @@ struct txpool_tx_meta_t
   uint8_t is_forwarding: 1;
   uint8_t bf_padding: 3;
 
-  uint8_t padding[76]; // till 192 bytes
+  uint8_t validated_version; //!< fork version the tx was last fully validated for, 0 if not known
+
+  uint8_t padding[75]; // till 192 bytes
 
   void set_relay_method(relay_method method) noexcept;
   relay_method get_relay_method() const noexcept;
@@ -193,6 +247,9 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_COMPRESS_PRUNABLE 0x20
+#define DBF_KEY_IMAGE_FILTER 0x40
+#define DBF_READ_AHEAD 0x80
 
 /***********************************
  * Exception Definitions
@@ -420,6 +477,17 @@ private:
    */
   virtual void remove_block() = 0;
 
+  /**
+   * @brief stores the view tag index entry of a new block
+   *
+   * Called right after add_block, once the view tag index has been built.
+   * The subclass's remove_block must then remove the entry too.
+   *
+   * @param height the height of the block
+   * @param blob the block's serialized block_view_tags
+   */
+  virtual void add_block_view_tags(uint64_t height, const blobdata &blob);
+
   /**
    * @brief store the transaction and its metadata
    *
@@ -977,6 +1045,21 @@ public:
    */
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const = 0;
 
+  /**
+   * @brief fetch the cumulative number of rct outputs of a range of blocks
+   *
+   * The default implementation forwards to the per-height lookup. A
+   * subclass may answer contiguous ranges more cheaply.
+   *
+   * If any block does not exist, the subclass should throw BLOCK_DNE
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   *
+   * @return the cumulative number of rct outputs, one per block
+   */
+  virtual std::vector<uint64_t> get_block_cumulative_rct_outputs_range(uint64_t start_height, uint64_t count) const;
+
   /**
    * @brief fetch the top block's timestamp
    *
@@ -1489,6 +1572,22 @@ public:
    * @param outputs return-by-reference a list of outputs' metadata
    */
   virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) const = 0;
+
+  /**
+   * @brief gets outputs' data for many ring members at once
+   *
+   * Like get_output_key(amounts, offsets, outputs), but the lookups may be
+   * reordered to walk the backing store sequentially, so callers can pass
+   * all ring members of several inputs in one call. The outputs are returned
+   * in the order of the offsets passed.
+   *
+   * If an output cannot be found, the subclass should throw OUTPUT_DNE.
+   *
+   * @param amounts the amount of each output
+   * @param offsets the amount-specific index of each output
+   * @param outputs return-by-reference a list of outputs' metadata
+   */
+  virtual void get_output_keys_batch(const std::vector<uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs) const;
   
   /*
    * FIXME: Need to check with git blame and ask what this does to
@@ -1513,6 +1612,73 @@ public:
    */
   virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_id, size_t n_txes = 1) const = 0;
 
+  /**
+   * @brief checks whether outputs can be looked up by public key
+   *
+   * @return true if the output public key index has been built
+   */
+  virtual bool has_output_pubkey_index() const;
+
+  /**
+   * @brief builds the index from output public keys to output indices
+   *
+   * The index is optional and not built by default. Once built, it is kept
+   * up to date as outputs are added and removed, and survives restarts.
+   * This walks every output in the chain, and must not run concurrently with
+   * adding or removing blocks.
+   *
+   * @return true if the index is available, false if the subclass does not support it
+   */
+  virtual bool build_output_pubkey_index();
+
+  /**
+   * @brief looks up an output by its one-time public key
+   *
+   * If several outputs share the key, the one with the lowest global index
+   * is returned.
+   *
+   * If the index has not been built, the subclass should throw DB_ERROR.
+   *
+   * @param pubkey the output public key
+   * @param amount return-by-reference the output's amount (0 for RingCT)
+   * @param amount_index return-by-reference the output's amount-specific index
+   *
+   * @return true if an output with that key was found, otherwise false
+   */
+  virtual bool get_output_index_by_pubkey(const crypto::public_key &pubkey, uint64_t &amount, uint64_t &amount_index) const;
+
+  /**
+   * @brief checks whether tx keys and view tags can be looked up by block
+   *
+   * @return true if the view tag index has been built
+   */
+  virtual bool has_view_tag_index() const;
+
+  /**
+   * @brief builds the index of tx public keys and output view tags by block
+   *
+   * Each block from HF_VERSION_VIEW_TAGS on gets its serialized
+   * block_view_tags, so wallets can find the txes that may pay them without
+   * downloading every tx. As for the output public key index, it is optional,
+   * kept up to date once built, and must not be built while blocks are added
+   * or removed.
+   *
+   * @return true if the index is available, false if the subclass does not support it
+   */
+  virtual bool build_view_tag_index();
+
+  /**
+   * @brief gets the serialized block_view_tags of a range of blocks
+   *
+   * Blocks from before view tags get an empty blob. If the index has not been
+   * built, the subclass should throw DB_ERROR.
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks, fewer are returned past the top block
+   * @param blobs return-by-reference one blob per block
+   */
+  virtual void get_blocks_view_tags(uint64_t start_height, size_t count, std::vector<blobdata> &blobs) const;
+
   /**
    * @brief check if a key image is stored as spent
    *
@@ -1522,6 +1688,16 @@ public:
    */
   virtual bool has_key_image(const crypto::key_image& img) const = 0;
 
+  /**
+   * @brief check if several key images are stored as spent
+   *
+   * The lookups may be reordered to walk the backing store sequentially.
+   *
+   * @param imgs the key images to check for
+   * @param spent return-by-reference whether each image is present, in the order passed
+   */
+  virtual void have_key_images_batch(const epee::span<const crypto::key_image> &imgs, std::vector<bool> &spent) const;
+
   /**
    * @brief add a txpool transaction
    *
@@ -1766,6 +1942,27 @@ public:
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const = 0;
   virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const = 0;
 
+  /**
+   * @brief parallel variants of the for_all_* / for_blocks_range iterators
+   *
+   * These run the passed function over the same set of entries as their
+   * serial counterparts, but the subclass may split the scan into ranges
+   * and run them concurrently on separate read transactions. The function
+   * must therefore be thread safe, and no ordering between calls is
+   * guaranteed. Each range sees its own snapshot, so the scan is only
+   * consistent as a whole if the db is not written to meanwhile.
+   *
+   * If any call to the function returns false, the remaining ranges are
+   * stopped early and false is returned. The default implementations just
+   * call the serial versions.
+   *
+   * @return false if the function returns false for any entry, otherwise true
+   */
+  virtual bool for_all_key_images_parallel(const std::function<bool(const crypto::key_image&)> &f) const;
+  virtual bool for_blocks_range_parallel(const uint64_t& h1, const uint64_t& h2, const std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> &f) const;
+  virtual bool for_all_transactions_parallel(const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const;
+  virtual bool for_all_outputs_parallel(const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const;
+
   /**
    * @brief runs a function over all alternative blocks stored
    *
@@ -1816,6 +2013,28 @@ public:
    */
   virtual void drop_hard_fork_info() = 0;
 
+  /**
+   * @brief saves a snapshot of the hard fork voting window
+   *
+   * Only one snapshot is kept, replacing any previous one. The snapshot
+   * is not updated as blocks are added or removed, so the caller has to
+   * check its height and top hash against the chain before using it.
+   *
+   * The default implementation does not store anything.
+   *
+   * @param window the voting window
+   */
+  virtual void set_hard_fork_voting_window(const hard_fork_voting_window &window);
+
+  /**
+   * @brief fetches the last hard fork voting window snapshot
+   *
+   * @param window return-by-reference the voting window
+   *
+   * @return true if a snapshot was found, false otherwise
+   */
+  virtual bool get_hard_fork_voting_window(hard_fork_voting_window &window) const;
+
   /**
    * @brief return a histogram of outputs on the blockchain
    *
@@ -1844,6 +2063,15 @@ public:
    */
   virtual uint64_t get_database_size() const = 0;
 
+  /**
+   * @brief get storage and access statistics
+   *
+   * @param stats return-by-reference the statistics
+   *
+   * @return true if the subclass supports statistics, otherwise false
+   */
+  virtual bool get_db_stats(db_stats &stats) const;
+
   // TODO: this should perhaps be (or call) a series of functions which
   // progressively update through version updates
   /**
@@ -31,17 +31,31 @@
 #include <boost/format.hpp>
 #include <boost/circular_buffer.hpp>
 #include <memory>  // std::unique_ptr
+#include <chrono>
 #include <cstring>  // memcpy
+#include <limits>
 
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "common/util.h"
+#include "common/metrics.h"
+#include "common/perf_timer.h"
 #include "common/pruning.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
 #include "ringct/rctOps.h"
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db.lmdb"
 
@@ -55,6 +69,11 @@ using namespace crypto;
 
 // Increase when the DB structure changes
 #define VERSION 5
+// Set in the stored version once txs_prunable holds tagged (possibly zstd
+// compressed) values. Binaries reading them as raw data see a version above
+// their own and refuse the DB, and schema bumps never reach this bit.
+#define VERSION_TAGGED_PRUNABLE 0x80000000u
+static_assert((VERSION & VERSION_TAGGED_PRUNABLE) == 0, "VERSION must not reach VERSION_TAGGED_PRUNABLE");
 
 namespace
 {
@@ -132,6 +151,36 @@ private:
   std::unique_ptr<char[]> data;
 };
 
+tools::metrics::histogram commit_metric("monero_db_commit_microseconds", "Time to commit an LMDB write transaction");
+tools::metrics::counter resize_metric("monero_db_resizes_total", "LMDB map resizes");
+tools::metrics::counter read_ahead_hits_metric("monero_db_read_ahead_hits_total", "Blocks read sequentially which the read-ahead had already loaded");
+tools::metrics::counter read_ahead_misses_metric("monero_db_read_ahead_misses_total", "Blocks read sequentially which the read-ahead had not loaded yet");
+tools::metrics::counter read_ahead_blocks_metric("monero_db_read_ahead_blocks_total", "Blocks loaded by the read-ahead");
+tools::metrics::counter read_ahead_bytes_metric("monero_db_read_ahead_bytes_total", "Block and tx bytes loaded by the read-ahead");
+
+// Pages a value in, so a reader coming after finds it resident. The env is
+// opened with MDB_NORDAHEAD, so large values get an explicit hint first to
+// have the kernel read them in one go rather than a fault at a time
+size_t touch_pages(const MDB_val &v)
+{
+  const unsigned char *p = (const unsigned char *)v.mv_data;
+  const size_t step = 4096;
+#ifndef _WIN32
+  static const size_t page_size = sysconf(_SC_PAGESIZE) > 0 ? sysconf(_SC_PAGESIZE) : step;
+  if (v.mv_size > page_size)
+  {
+    const uintptr_t start = (uintptr_t)p & ~(uintptr_t)(page_size - 1);
+    madvise((void *)start, (uintptr_t)p + v.mv_size - start, MADV_WILLNEED);
+  }
+#endif
+  volatile unsigned char sink = 0;
+  for (size_t offset = 0; offset < v.mv_size; offset += step)
+    sink = sink + p[offset];
+  if (v.mv_size)
+    sink = sink + p[v.mv_size - 1];
+  return v.mv_size;
+}
+
 }
 
 namespace cryptonote
@@ -226,6 +275,8 @@ const char* const LMDB_TX_OUTPUTS = "tx_outputs";
 
 const char* const LMDB_OUTPUT_TXS = "output_txs";
 const char* const LMDB_OUTPUT_AMOUNTS = "output_amounts";
+const char* const LMDB_OUTPUT_PUBKEYS = "output_pubkeys";
+const char* const LMDB_VIEW_TAGS = "view_tags";
 const char* const LMDB_SPENT_KEYS = "spent_keys";
 
 const char* const LMDB_TXPOOL_META = "txpool_meta";
@@ -241,6 +292,9 @@ const char* const LMDB_PROPERTIES = "properties";
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
+// the hf_voting_window property is {height, top hash, window size, max version} followed by the votes
+const size_t HF_VOTING_WINDOW_HEADER_SIZE = sizeof(uint64_t) + sizeof(crypto::hash) + sizeof(uint64_t) + sizeof(uint8_t);
+
 const std::string lmdb_error(const std::string& error_string, int mdb_res)
 {
   const std::string full_string = error_string + mdb_strerror(mdb_res);
@@ -253,6 +307,81 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
     throw0(cryptonote::DB_OPEN_FAILURE((lmdb_error(error_string + " : ", res) + std::string(" - you may want to start with --db-salvage")).c_str()));
 }
 
+/* Once prunable data storage is converted, each txs_prunable value starts with
+ * one of these tags, followed by the data itself.
+ */
+enum : uint8_t { PRUNABLE_TAG_RAW = 0, PRUNABLE_TAG_ZSTD = 1 };
+const int PRUNABLE_ZSTD_LEVEL = 3;
+
+// room for key images added after open, the filter is only sized on open
+const uint64_t KEY_IMAGE_FILTER_MIN_HEADROOM = 1 << 20;
+
+const size_t TX_INDEX_CACHE_SIZE = 1 << 16;
+
+// ranges per compute thread, so a few dense ranges don't leave the other threads idle
+const size_t PARALLEL_SCAN_PARTITIONS_PER_THREAD = 4;
+
+// sequential reads before the blocks ahead of a stream are loaded
+const unsigned READ_AHEAD_MIN_READS = 2;
+// how far ahead of a stream blocks are loaded, and the most loaded per job
+const uint64_t READ_AHEAD_BLOCKS = 1000;
+const uint64_t READ_AHEAD_MAX_BYTES = 32 * 1024 * 1024;
+// streams tracked at once, about the number of peers syncing off us at once
+const size_t READ_AHEAD_MAX_STREAMS = 16;
+
+#ifdef HAVE_ZSTD
+struct zstd_dctx_deleter { void operator()(ZSTD_DCtx *dctx) const { ZSTD_freeDCtx(dctx); } };
+#endif
+
+void encode_prunable_blob(const void *data, size_t size, std::string &out)
+{
+#ifdef HAVE_ZSTD
+  out.resize(1 + ZSTD_compressBound(size));
+  const size_t csize = ZSTD_compress(&out[1], out.size() - 1, data, size, PRUNABLE_ZSTD_LEVEL);
+  if (!ZSTD_isError(csize) && csize < size)
+  {
+    out[0] = PRUNABLE_TAG_ZSTD;
+    out.resize(1 + csize);
+    return;
+  }
+#endif
+  // keep it as is if it does not compress
+  out.resize(1 + size);
+  out[0] = PRUNABLE_TAG_RAW;
+  if (size)
+    memcpy(&out[1], data, size);
+}
+
+void decode_prunable_blob(const MDB_val &v, cryptonote::blobdata &bd)
+{
+  if (v.mv_size == 0)
+    throw0(cryptonote::DB_ERROR("Invalid prunable data: missing tag"));
+  const uint8_t tag = *(const uint8_t*)v.mv_data;
+  const char *data = (const char*)v.mv_data + 1;
+  const size_t size = v.mv_size - 1;
+  if (tag == PRUNABLE_TAG_RAW)
+  {
+    bd.append(data, size);
+    return;
+  }
+#ifdef HAVE_ZSTD
+  if (tag == PRUNABLE_TAG_ZSTD)
+  {
+    static thread_local std::unique_ptr<ZSTD_DCtx, zstd_dctx_deleter> dctx(ZSTD_createDCtx());
+    const unsigned long long dsize = ZSTD_getFrameContentSize(data, size);
+    if (dsize == ZSTD_CONTENTSIZE_ERROR || dsize == ZSTD_CONTENTSIZE_UNKNOWN || dsize > CRYPTONOTE_MAX_TX_SIZE)
+      throw0(cryptonote::DB_ERROR("Invalid compressed prunable data"));
+    const size_t offset = bd.size();
+    bd.resize(offset + dsize);
+    const size_t r = ZSTD_decompressDCtx(dctx.get(), &bd[offset], dsize, data, size);
+    if (ZSTD_isError(r) || r != dsize)
+      throw0(cryptonote::DB_ERROR("Failed to decompress prunable data"));
+    return;
+  }
+#endif
+  throw0(cryptonote::DB_ERROR("Unsupported prunable data encoding, this build may lack zstd support"));
+}
+
 
 }  // anonymous namespace
 
@@ -351,6 +480,12 @@ typedef struct outtx {
     uint64_t local_index;
 } outtx;
 
+typedef struct outpubkey {
+    uint64_t output_id;
+    uint64_t amount;
+    uint64_t amount_index;
+} outpubkey;
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
 
@@ -365,6 +500,50 @@ mdb_threadinfo::~mdb_threadinfo()
     mdb_txn_abort(m_ti_rtxn);
 }
 
+mdb_table_counters::mdb_table_counters(): gets(0), misses(0), puts(0), deletes(0), bytes_read(0), bytes_written(0)
+{
+  for (auto &b: get_latency)
+    b = 0;
+}
+
+// cursor ops which also update a table's counters; the bytes read are those
+// of the value found, the key is known to the caller
+static inline int counted_get(mdb_table_counters &c, MDB_cursor *cur, MDB_val *k, MDB_val *v, MDB_cursor_op op)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const int result = mdb_cursor_get(cur, k, v, op);
+  const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  size_t bucket = 0;
+  while (bucket + 1 < mdb_table_counters::LATENCY_BUCKETS && (1ull << bucket) <= us)
+    ++bucket;
+  c.get_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+  c.gets.fetch_add(1, std::memory_order_relaxed);
+  if (result == 0)
+    c.bytes_read.fetch_add(v->mv_size, std::memory_order_relaxed);
+  else if (result == MDB_NOTFOUND)
+    c.misses.fetch_add(1, std::memory_order_relaxed);
+  return result;
+}
+
+static inline int counted_put(mdb_table_counters &c, MDB_cursor *cur, MDB_val *k, MDB_val *v, unsigned int flags)
+{
+  const int result = mdb_cursor_put(cur, k, v, flags);
+  if (result == 0)
+  {
+    c.puts.fetch_add(1, std::memory_order_relaxed);
+    c.bytes_written.fetch_add(k->mv_size + v->mv_size, std::memory_order_relaxed);
+  }
+  return result;
+}
+
+static inline int counted_del(mdb_table_counters &c, MDB_cursor *cur, unsigned int flags)
+{
+  const int result = mdb_cursor_del(cur, flags);
+  if (result == 0)
+    c.deletes.fetch_add(1, std::memory_order_relaxed);
+  return result;
+}
+
 mdb_txn_safe::mdb_txn_safe(const bool check) : m_txn(NULL), m_tinfo(NULL), m_check(check)
 {
   if (check)
@@ -418,12 +597,14 @@ void mdb_txn_safe::commit(std::string message)
     message = "Failed to commit a transaction to the db";
   }
 
+  tools::PerformanceTimer timer;
   if (auto result = mdb_txn_commit(m_txn))
   {
     m_txn = nullptr;
     throw0(DB_ERROR(lmdb_error(message + ": ", result).c_str()));
   }
   m_txn = nullptr;
+  commit_metric.observe(timer.value() / 1000);
 }
 
 void mdb_txn_safe::abort()
@@ -551,12 +732,15 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   CRITICAL_REGION_LOCAL(m_synchronization_lock);
   const uint64_t add_size = 1LL << 30;
+  const uint64_t max_ahead_size = 16LL << 30;
+  uint64_t available = std::numeric_limits<uint64_t>::max();
 
   // check disk capacity
   try
   {
     boost::filesystem::path path(m_folder);
     boost::filesystem::space_info si = boost::filesystem::space(path);
+    available = si.available;
     if(si.available < add_size)
     {
       MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
@@ -587,6 +771,20 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   if (increase_size > 0)
     new_mapsize = mei.me_mapsize + increase_size;
 
+  // Every resize waits for all readers to drain, which stalls a fast sync.
+  // Grow by at least twice what was written since the previous resize, so
+  // under a steady write rate the time between stalls doubles each time.
+  const uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+  if (m_size_used_at_resize && size_used > m_size_used_at_resize)
+  {
+    const uint64_t ahead_size = std::min(std::min(2 * (size_used - m_size_used_at_resize), max_ahead_size), available / 2);
+    if (new_mapsize < mei.me_mapsize + ahead_size)
+    {
+      MDEBUG("Growing LMDB map ahead of demand by " << ahead_size / (1024 * 1024) << "MiB");
+      new_mapsize = mei.me_mapsize + ahead_size;
+    }
+  }
+
   new_mapsize += (new_mapsize % mst.ms_psize);
 
   mdb_txn_safe::prevent_new_txns();
@@ -610,6 +808,8 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
 
   MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
+  m_size_used_at_resize = size_used;
+  resize_metric.inc();
 
   mdb_txn_safe::allow_new_txns();
 }
@@ -840,6 +1040,15 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
+  {
+    // staged until the write txn commits, readers only see committed blocks
+    boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+    if (m_cum_rct_column_loaded && m_cum_rct_pending_valid && m_cum_rct_column.size() - m_cum_rct_pending_pops + m_cum_rct_pending.size() == m_height)
+      m_cum_rct_pending.push_back(bi.bi_cum_rct);
+    else
+      m_cum_rct_pending_valid = false;
+  }
+
   // we use weight as a proxy for size, since we don't have size but weight is >= size
   // and often actually equal
   m_cum_size += block_weight;
@@ -881,6 +1090,51 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+  if (m_view_tags_indexed)
+  {
+    // blocks from before view tags have no entry
+    CURSOR(view_tags)
+    MDB_val_copy<uint64_t> vk(m_height - 1);
+    MDB_val vv;
+    result = counted_get(m_table_counters[MDB_TABLE_VIEW_TAGS], m_cur_view_tags, &vk, &vv, MDB_SET);
+    if (result == 0)
+      result = counted_del(m_table_counters[MDB_TABLE_VIEW_TAGS], m_cur_view_tags, 0);
+    if (result && result != MDB_NOTFOUND)
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of block view tags to db transaction: ", result).c_str()));
+  }
+
+  boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+  if (m_cum_rct_column_loaded && m_cum_rct_pending_valid && m_cum_rct_column.size() - m_cum_rct_pending_pops + m_cum_rct_pending.size() == m_height)
+  {
+    if (!m_cum_rct_pending.empty())
+      m_cum_rct_pending.pop_back();
+    else
+      ++m_cum_rct_pending_pops;
+  }
+  else
+    m_cum_rct_pending_valid = false;
+}
+
+void BlockchainLMDB::finish_cum_rct_column_txn(bool committed)
+{
+  boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+  if (committed && (!m_cum_rct_pending_valid || m_cum_rct_pending_pops > 0 || !m_cum_rct_pending.empty()))
+  {
+    if (m_cum_rct_column_loaded && m_cum_rct_pending_valid)
+    {
+      m_cum_rct_column.resize(m_cum_rct_column.size() - m_cum_rct_pending_pops);
+      m_cum_rct_column.insert(m_cum_rct_column.end(), m_cum_rct_pending.begin(), m_cum_rct_pending.end());
+    }
+    else
+    {
+      m_cum_rct_column.clear();
+      m_cum_rct_column_loaded = false;
+    }
+  }
+  m_cum_rct_pending.clear();
+  m_cum_rct_pending_pops = 0;
+  m_cum_rct_pending_valid = true;
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata_ref>& txp, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash)
@@ -901,7 +1155,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
 
   MDB_val_set(val_tx_id, tx_id);
   MDB_val_set(val_h, tx_hash);
-  result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
+  result = counted_get(m_table_counters[MDB_TABLE_TX_INDICES], m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
   if (result == 0) {
     txindex *tip = (txindex *)val_h.mv_data;
     throw1(TX_EXISTS(std::string("Attempting to add transaction that's already in the db (tx id ").append(boost::lexical_cast<std::string>(tip->data.tx_id)).append(")").c_str()));
@@ -919,7 +1173,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   val_h.mv_size = sizeof(ti);
   val_h.mv_data = (void *)&ti;
 
-  result = mdb_cursor_put(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, 0);
+  result = counted_put(m_table_counters[MDB_TABLE_TX_INDICES], m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add tx data to db transaction: ", result).c_str()));
 
@@ -940,12 +1194,18 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     throw0(DB_ERROR("pruned tx size is larger than tx size"));
 
   MDB_val pruned_blob = {unprunable_size, (void*)blob.data()};
-  result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
+  result = counted_put(m_table_counters[MDB_TABLE_TXS_PRUNED], m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
 
   MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
-  result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
+  std::string encoded_prunable_blob;
+  if (tx_id < m_prunable_tagged_below)
+  {
+    encode_prunable_blob(prunable_blob.mv_data, prunable_blob.mv_size, encoded_prunable_blob);
+    prunable_blob = {encoded_prunable_blob.size(), (void*)encoded_prunable_blob.data()};
+  }
+  result = counted_put(m_table_counters[MDB_TABLE_TXS_PRUNABLE], m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
 
@@ -989,6 +1249,13 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
 
   if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH))
       throw1(TX_DNE("Attempting to remove transaction that isn't in the db"));
+
+  // raise the bar before removing, so a reader still on an older snapshot
+  // cannot add the entry back
+  const uint64_t txn_id = mdb_txn_id(*m_write_txn);
+  if (m_tx_index_cache_invalidated_at < txn_id)
+    m_tx_index_cache_invalidated_at = txn_id;
+  m_tx_index_cache.remove(tx_hash);
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
 
@@ -1072,14 +1339,14 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   outtx ot = {m_num_outputs, tx_hash, local_index};
   MDB_val_set(vot, ot);
 
-  result = mdb_cursor_put(m_cur_output_txs, (MDB_val *)&zerokval, &vot, MDB_APPENDDUP);
+  result = counted_put(m_table_counters[MDB_TABLE_OUTPUT_TXS], m_cur_output_txs, (MDB_val *)&zerokval, &vot, MDB_APPENDDUP);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add output tx hash to db transaction: ", result).c_str()));
 
   outkey ok;
   MDB_val data;
   MDB_val_copy<uint64_t> val_amount(tx_output.amount);
-  result = mdb_cursor_get(m_cur_output_amounts, &val_amount, &data, MDB_SET);
+  result = counted_get(m_table_counters[MDB_TABLE_OUTPUT_AMOUNTS], m_cur_output_amounts, &val_amount, &data, MDB_SET);
   if (!result)
     {
       mdb_size_t num_elems = 0;
@@ -1107,9 +1374,19 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   }
   data.mv_data = &ok;
 
-  if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
+  if ((result = counted_put(m_table_counters[MDB_TABLE_OUTPUT_AMOUNTS], m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
       throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to db transaction: ", result).c_str()));
 
+  if (m_output_pubkeys_indexed)
+  {
+    CURSOR(output_pubkeys)
+    outpubkey opk = {m_num_outputs, tx_output.amount, ok.amount_index};
+    MDB_val_set(kpk, output_public_key);
+    MDB_val_set(vpk, opk);
+    if ((result = counted_put(m_table_counters[MDB_TABLE_OUTPUT_PUBKEYS], m_cur_output_pubkeys, &kpk, &vpk, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to add output pubkey index to db transaction: ", result).c_str()));
+  }
+
   return ok.amount_index;
 }
 
@@ -1177,6 +1454,8 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
     throw0(DB_ERROR(lmdb_error("DB error attempting to get an output", result).c_str()));
 
   const pre_rct_outkey *ok = (const pre_rct_outkey *)v.mv_data;
+  const crypto::public_key pubkey = ok->data.pubkey;
+  const uint64_t output_id = ok->output_id;
   MDB_val_set(otxk, ok->output_id);
   result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &otxk, MDB_GET_BOTH);
   if (result == MDB_NOTFOUND)
@@ -1195,6 +1474,28 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   result = mdb_cursor_del(m_cur_output_amounts, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting amount for output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
+
+  if (m_output_pubkeys_indexed)
+    remove_output_pubkey(pubkey, output_id);
+}
+
+void BlockchainLMDB::remove_output_pubkey(const crypto::public_key &pubkey, uint64_t output_id)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(output_pubkeys);
+
+  MDB_val_set(k, pubkey);
+  MDB_val_set(v, output_id);
+  auto result = mdb_cursor_get(m_cur_output_pubkeys, &k, &v, MDB_GET_BOTH);
+  if (result == MDB_NOTFOUND)
+    throw0(DB_ERROR("Unexpected: output pubkey not found in m_output_pubkeys"));
+  else if (result)
+    throw0(DB_ERROR(lmdb_error("Error looking up output pubkey: ", result).c_str()));
+  result = mdb_cursor_del(m_cur_output_pubkeys, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Error deleting output pubkey: ", result).c_str()));
 }
 
 void BlockchainLMDB::prune_outputs(uint64_t amount)
@@ -1220,11 +1521,14 @@ void BlockchainLMDB::prune_outputs(uint64_t amount)
   mdb_cursor_count(m_cur_output_amounts, &num_elems);
   MINFO(num_elems << " outputs found");
   std::vector<uint64_t> output_ids;
+  std::vector<crypto::public_key> output_pubkeys;
   output_ids.reserve(num_elems);
   while (1)
   {
     const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
     output_ids.push_back(okp->output_id);
+    if (m_output_pubkeys_indexed)
+      output_pubkeys.push_back(okp->data.pubkey);
     MDEBUG("output id " << okp->output_id);
     result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_NEXT_DUP);
     if (result == MDB_NOTFOUND)
@@ -1239,6 +1543,11 @@ void BlockchainLMDB::prune_outputs(uint64_t amount)
   if (result)
     throw0(DB_ERROR(lmdb_error("Error deleting outputs: ", result).c_str()));
 
+  for (size_t i = 0; i < output_pubkeys.size(); ++i)
+    remove_output_pubkey(output_pubkeys[i], output_ids[i]);
+
+  // output_txs is keyed by output id, deleting in order keeps to neighbouring pages
+  std::sort(output_ids.begin(), output_ids.end());
   for (uint64_t output_id: output_ids)
   {
     MDB_val_set(v, output_id);
@@ -1259,8 +1568,11 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
 
   CURSOR(spent_keys)
 
+  // before the put, so a concurrent reader can never miss a committed key image
+  m_key_image_filter.add(key_image_filter_hash(k_image));
+
   MDB_val k = {sizeof(k_image), (void *)&k_image};
-  if (auto result = mdb_cursor_put(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA)) {
+  if (auto result = counted_put(m_table_counters[MDB_TABLE_SPENT_KEYS], m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(KEY_IMAGE_EXISTS("Attempting to add spent key image that's already in the db"));
     else
@@ -1277,12 +1589,12 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
   CURSOR(spent_keys)
 
   MDB_val k = {sizeof(k_image), (void *)&k_image};
-  auto result = mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
+  auto result = counted_get(m_table_counters[MDB_TABLE_SPENT_KEYS], m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
   if (result != 0 && result != MDB_NOTFOUND)
       throw1(DB_ERROR(lmdb_error("Error finding spent key to remove", result).c_str()));
   if (!result)
   {
-    result = mdb_cursor_del(m_cur_spent_keys, 0);
+    result = counted_del(m_table_counters[MDB_TABLE_SPENT_KEYS], m_cur_spent_keys, 0);
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
   }
@@ -1315,6 +1627,19 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_size_used_at_resize = 0;
+  m_cum_rct_column_loaded = false;
+  m_cum_rct_pending_pops = 0;
+  m_cum_rct_pending_valid = true;
+  m_output_pubkeys_indexed = false;
+  m_view_tags_indexed = false;
+  m_prunable_tagged_below = 0;
+  m_key_image_filter_salt = crypto::rand<uint64_t>();
+  m_tx_index_cache.set_max_size(TX_INDEX_CACHE_SIZE);
+  m_tx_index_cache_invalidated_at = 0;
+  m_read_ahead_next_id = 0;
+  m_read_ahead_enabled = false;
+  m_read_ahead_stop = false;
 
   // reset may also need changing when initialize things here
 
@@ -1435,6 +1760,32 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_OUTPUT_TXS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_output_txs, "Failed to open db handle for m_output_txs");
   lmdb_db_open(txn, LMDB_OUTPUT_AMOUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_amounts, "Failed to open db handle for m_output_amounts");
 
+  // this subdb is optional and only filled once the index is built, so an
+  // older DB opened read-only may not have it: m_output_pubkeys stays 0 then
+  // (user subdbs never get handle 0, that is the free page DB)
+  if (mdb_flags & MDB_RDONLY)
+  {
+    result = mdb_dbi_open(txn, LMDB_OUTPUT_PUBKEYS, MDB_DUPSORT | MDB_DUPFIXED, &m_output_pubkeys);
+    if (result == MDB_NOTFOUND)
+      m_output_pubkeys = 0;
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open db handle for m_output_pubkeys: ", result).c_str()));
+  }
+  else
+    lmdb_db_open(txn, LMDB_OUTPUT_PUBKEYS, MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_pubkeys, "Failed to open db handle for m_output_pubkeys");
+
+  // optional too, same as m_output_pubkeys
+  if (mdb_flags & MDB_RDONLY)
+  {
+    result = mdb_dbi_open(txn, LMDB_VIEW_TAGS, MDB_INTEGERKEY, &m_view_tags);
+    if (result == MDB_NOTFOUND)
+      m_view_tags = 0;
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open db handle for m_view_tags: ", result).c_str()));
+  }
+  else
+    lmdb_db_open(txn, LMDB_VIEW_TAGS, MDB_INTEGERKEY | MDB_CREATE, m_view_tags, "Failed to open db handle for m_view_tags");
+
   lmdb_db_open(txn, LMDB_SPENT_KEYS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_keys, "Failed to open db handle for m_spent_keys");
 
   lmdb_db_open(txn, LMDB_TXPOOL_META, MDB_CREATE, m_txpool_meta, "Failed to open db handle for m_txpool_meta");
@@ -1457,6 +1808,11 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
   mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
   mdb_set_dupsort(txn, m_output_txs, compare_uint64);
+  if (m_output_pubkeys)
+  {
+    mdb_set_compare(txn, m_output_pubkeys, compare_hash32);
+    mdb_set_dupsort(txn, m_output_pubkeys, compare_uint64);
+  }
   mdb_set_dupsort(txn, m_block_info, compare_uint64);
   if (!(mdb_flags & MDB_RDONLY))
     mdb_set_dupsort(txn, m_txs_prunable_tip, compare_uint64);
@@ -1489,7 +1845,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   auto get_result = mdb_get(txn, m_properties, &k, &v);
   if(get_result == MDB_SUCCESS)
   {
-    const uint32_t db_version = *(const uint32_t*)v.mv_data;
+    const uint32_t db_version = *(const uint32_t*)v.mv_data & ~VERSION_TAGGED_PRUNABLE;
     if (db_version > VERSION)
     {
       MWARNING("Existing lmdb database was made by a later version (" << db_version << "). We don't know how it will change yet.");
@@ -1555,16 +1911,60 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     }
   }
 
+  MDB_val_str(ik, "output_pubkeys_indexed");
+  m_output_pubkeys_indexed = m_output_pubkeys && mdb_get(txn, m_properties, &ik, &v) == MDB_SUCCESS;
+
+  MDB_val_str(vk, "view_tags_indexed");
+  m_view_tags_indexed = m_view_tags && mdb_get(txn, m_properties, &vk, &v) == MDB_SUCCESS;
+
+  MDB_val_str(pk, "prunable_tagged_below");
+  m_prunable_tagged_below = 0;
+  if (mdb_get(txn, m_properties, &pk, &v) == MDB_SUCCESS)
+  {
+    if (v.mv_size != sizeof(m_prunable_tagged_below))
+      throw0(DB_ERROR("Failed to retrieve prunable data storage state: unexpected value size"));
+    memcpy(&m_prunable_tagged_below, v.mv_data, sizeof(m_prunable_tagged_below));
+  }
+  if (m_prunable_tagged_below > 0 && !(mdb_flags & MDB_RDONLY))
+  {
+    // the version written above for an empty DB, or by a build predating the flag
+    if (mdb_get(txn, m_properties, &k, &v) != MDB_SUCCESS || v.mv_size != sizeof(uint32_t) || *(const uint32_t*)v.mv_data != (VERSION | VERSION_TAGGED_PRUNABLE))
+    {
+      MDB_val_copy<uint32_t> tv(VERSION | VERSION_TAGGED_PRUNABLE);
+      if (auto result = mdb_put(txn, m_properties, &k, &tv, 0))
+        throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
+    }
+  }
+
   // commit the transaction
   txn.commit();
 
   m_open = true;
   // from here, init should be finished
+
+  if ((db_flags & DBF_COMPRESS_PRUNABLE) && m_prunable_tagged_below != std::numeric_limits<uint64_t>::max())
+  {
+#ifdef HAVE_ZSTD
+    if (mdb_flags & MDB_RDONLY)
+      MWARNING("Cannot compress prunable data on a read-only database");
+    else
+      compress_prunable_data();
+#else
+    MWARNING("This build does not have zstd support, prunable data will not be compressed");
+#endif
+  }
+
+  if (db_flags & DBF_KEY_IMAGE_FILTER)
+    build_key_image_filter();
+
+  if (db_flags & DBF_READ_AHEAD)
+    start_read_ahead();
 }
 
 void BlockchainLMDB::close()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  stop_read_ahead();
   if (m_batch_active)
   {
     LOG_PRINT_L3("close() first calling batch_abort() due to active batch transaction");
@@ -1576,6 +1976,12 @@ void BlockchainLMDB::close()
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
   m_open = false;
+  m_key_image_filter.clear();
+  m_tx_index_cache.clear();
+
+  boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+  m_cum_rct_column.clear();
+  m_cum_rct_column_loaded = false;
 }
 
 void BlockchainLMDB::sync()
@@ -1631,6 +2037,10 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amounts: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_output_pubkeys, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_output_pubkeys: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_view_tags, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_view_tags: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_spent_keys, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_keys: ", result).c_str()));
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
@@ -1645,7 +2055,20 @@ void BlockchainLMDB::reset()
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
 
+  m_tx_index_cache_invalidated_at = mdb_txn_id(txn);
+  m_tx_index_cache.clear();
+
   txn.commit();
+  {
+    boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+    m_cum_rct_column.clear();
+    m_cum_rct_column_loaded = false;
+  }
+  m_output_pubkeys_indexed = false;
+  m_view_tags_indexed = false;
+  m_prunable_tagged_below = 0;
+  if (!m_key_image_filter.empty())
+    m_key_image_filter.reset(KEY_IMAGE_FILTER_MIN_HEADROOM);
   m_cum_size = 0;
   m_cum_count = 0;
 }
@@ -2138,6 +2561,27 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
     MDB_cursor_op op = MDB_FIRST;
+
+    // an interrupted run records the last tx it got through at each checkpoint
+    MDB_val_str(rk, "pruning_resume");
+    if (mode == prune_mode_prune && mdb_get(txn, m_properties, &rk, &v) == 0)
+    {
+      txindex ti;
+      memset(&ti, 0, sizeof(ti));
+      if (v.mv_size != sizeof(ti.key))
+        throw0(DB_ERROR("Failed to retrieve pruning resume point: unexpected value size"));
+      memcpy(&ti.key, v.mv_data, sizeof(ti.key));
+      MDB_val val = {sizeof(ti), (void *)&ti};
+      result = mdb_cursor_get(c_tx_indices, (MDB_val*)&zerokval, &val, MDB_GET_BOTH);
+      if (result == 0)
+      {
+        MINFO("Resuming interrupted pruning");
+        op = MDB_NEXT;
+      }
+      else if (result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to restore pruning resume point: ", result).c_str()));
+    }
+
     while (1)
     {
       int ret = mdb_cursor_get(c_tx_indices, &k, &v, op);
@@ -2218,6 +2662,13 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       if (mode != prune_mode_check && commit_counter >= 4096)
       {
         MDEBUG("Committing txn at checkpoint...");
+        if (mode == prune_mode_prune)
+        {
+          MDB_val rv = {sizeof(ti.key), (void *)&ti.key};
+          result = mdb_put(txn, m_properties, &rk, &rv, 0);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to save pruning resume point: ", result).c_str()));
+        }
         txn.commit();
         result = mdb_txn_begin(m_env, NULL, 0, txn);
         if (result)
@@ -2244,6 +2695,13 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       }
     }
     mdb_cursor_close(c_tx_indices);
+
+    if (mode == prune_mode_prune)
+    {
+      result = mdb_del(txn, m_properties, &rk, NULL);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to clear pruning resume point: ", result).c_str()));
+    }
   }
 
   if ((result = mdb_stat(txn, m_txs_prunable, &db_stats)))
@@ -2451,7 +2909,7 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_blocks, &key, &result, MDB_SET);
+  auto get_result = counted_get(m_table_counters[MDB_TABLE_BLOCKS], m_cur_blocks, &key, &result, MDB_SET);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get block from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
@@ -2464,6 +2922,8 @@ cryptonote::blobdata BlockchainLMDB::get_block_blob_from_height(const uint64_t&
 
   TXN_POSTFIX_RDONLY();
 
+  note_sequential_read(height, height + 1);
+
   return bd;
 }
 
@@ -2552,6 +3012,36 @@ std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs(const std
   return res;
 }
 
+std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs_range(uint64_t start_height, uint64_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (count == 0)
+    return {};
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_cum_rct_column_lock);
+    // the writer's own reads would load blocks it has not committed yet
+    const bool in_write_txn = m_write_txn && m_writer == boost::this_thread::get_id();
+    if (!m_cum_rct_column_loaded && !in_write_txn)
+    {
+      const uint64_t db_height = height();
+      if (db_height > 0)
+        m_cum_rct_column = BlockchainDB::get_block_cumulative_rct_outputs_range(0, db_height);
+      else
+        m_cum_rct_column.clear();
+      m_cum_rct_column_loaded = true;
+      MDEBUG("Loaded rct output column for " << db_height << " blocks");
+    }
+    if (start_height < m_cum_rct_column.size() && count <= m_cum_rct_column.size() - start_height)
+      return std::vector<uint64_t>(m_cum_rct_column.begin() + start_height, m_cum_rct_column.begin() + start_height + count);
+  }
+
+  // not (or no longer) covered by the column, the db will throw if out of range
+  return BlockchainDB::get_block_cumulative_rct_outputs_range(start_height, count);
+}
+
 uint64_t BlockchainLMDB::get_top_block_timestamp() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2949,19 +3439,42 @@ uint64_t BlockchainLMDB::num_outputs() const
   return num;
 }
 
+int BlockchainLMDB::get_tx_index(const crypto::hash &h, tx_data_t &td, MDB_txn *m_txn, mdb_txn_cursors *m_cursors) const
+{
+  const uint64_t txn_id = mdb_txn_id(m_txn);
+  cached_tx_index cti;
+  if (m_tx_index_cache.get(h, cti) && cti.txn_id <= txn_id)
+  {
+    td = cti.data;
+    return 0;
+  }
+
+  RCURSOR(tx_indices);
+
+  MDB_val_set(v, h);
+  const int result = counted_get(m_table_counters[MDB_TABLE_TX_INDICES], m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (result)
+    return result;
+  td = ((const txindex *)v.mv_data)->data;
+
+  // a write txn may yet be aborted, so only committed data gets cached
+  if (m_cursors != &m_wcursors)
+    m_tx_index_cache.add_if(h, cached_tx_index{td, txn_id}, [this, txn_id]() { return txn_id >= m_tx_index_cache_invalidated_at; });
+  return 0;
+}
+
 bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
 
-  MDB_val_set(key, h);
+  tx_data_t td;
   bool tx_found = false;
 
   TIME_MEASURE_START(time1);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &key, MDB_GET_BOTH);
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   if (get_result == 0)
     tx_found = true;
   else if (get_result != MDB_NOTFOUND)
@@ -2987,18 +3500,15 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h, uint64_t& tx_id) const
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
 
-  MDB_val_set(v, h);
+  tx_data_t td;
 
   TIME_MEASURE_START(time1);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   TIME_MEASURE_FINISH(time1);
   time_tx_exists += time1;
-  if (!get_result) {
-    txindex *tip = (txindex *)v.mv_data;
-    tx_id = tip->data.tx_id;
-  }
+  if (!get_result)
+    tx_id = td.tx_id;
 
   TXN_POSTFIX_RDONLY();
 
@@ -3021,17 +3531,15 @@ uint64_t BlockchainLMDB::get_tx_unlock_time(const crypto::hash& h) const
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
 
-  MDB_val_set(v, h);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  tx_data_t td;
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   if (get_result == MDB_NOTFOUND)
     throw1(TX_DNE(lmdb_error(std::string("tx data with hash ") + epee::string_tools::pod_to_hex(h) + " not found in db: ", get_result).c_str()));
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx data from hash: ", get_result).c_str()));
 
-  txindex *tip = (txindex *)v.mv_data;
-  uint64_t ret = tip->data.unlock_time;
+  uint64_t ret = td.unlock_time;
   TXN_POSTFIX_RDONLY();
   return ret;
 }
@@ -3042,21 +3550,21 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
   RCURSOR(txs_pruned);
   RCURSOR(txs_prunable);
 
-  MDB_val_set(v, h);
   MDB_val result0, result1;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  tx_data_t td;
+  uint64_t tx_id = 0;
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   if (get_result == 0)
   {
-    txindex *tip = (txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
+    tx_id = td.tx_id;
+    MDB_val_set(val_tx_id, tx_id);
+    get_result = counted_get(m_table_counters[MDB_TABLE_TXS_PRUNED], m_cur_txs_pruned, &val_tx_id, &result0, MDB_SET);
     if (get_result == 0)
     {
-      get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result1, MDB_SET);
+      get_result = counted_get(m_table_counters[MDB_TABLE_TXS_PRUNABLE], m_cur_txs_prunable, &val_tx_id, &result1, MDB_SET);
     }
   }
   if (get_result == MDB_NOTFOUND)
@@ -3065,7 +3573,7 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
   bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
-  bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
+  append_prunable_blob(tx_id, result1, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3078,17 +3586,15 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
   RCURSOR(txs_pruned);
 
-  MDB_val_set(v, h);
   MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  tx_data_t td;
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   if (get_result == 0)
   {
-    txindex *tip = (txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
+    MDB_val_set(val_tx_id, td.tx_id);
+    get_result = counted_get(m_table_counters[MDB_TABLE_TXS_PRUNED], m_cur_txs_pruned, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
@@ -3231,7 +3737,9 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
         result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
         if (result)
           throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-        tx_blob.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+        uint64_t prunable_tx_id;
+        memcpy(&prunable_tx_id, val_tx_id.mv_data, sizeof(prunable_tx_id));
+        append_prunable_blob(prunable_tx_id, v, tx_blob);
       }
       current_block.second.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
       size += current_block.second.back().second.size();
@@ -3243,60 +3751,394 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
 
   TXN_POSTFIX_RDONLY();
 
+  note_sequential_read(start_height, start_height + blocks.size());
+
   return true;
 }
 
-bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+void BlockchainLMDB::start_read_ahead()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  check_open();
-
-  TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
-  RCURSOR(txs_prunable);
+  boost::lock_guard<boost::mutex> lock(m_read_ahead_lock);
+  m_read_ahead_streams.clear();
+  m_read_ahead_jobs.clear();
+  m_read_ahead_stop = false;
+  m_read_ahead_thread = boost::thread([this]() { read_ahead_loop(); });
+  m_read_ahead_enabled = true;
+}
 
-  MDB_val_set(v, h);
-  MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
-  if (get_result == 0)
+void BlockchainLMDB::stop_read_ahead()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (!m_read_ahead_enabled)
+    return;
   {
-    const txindex *tip = (const txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+    boost::lock_guard<boost::mutex> lock(m_read_ahead_lock);
+    m_read_ahead_enabled = false;
+    m_read_ahead_stop = true;
+    m_read_ahead_jobs.clear();
   }
-  if (get_result == MDB_NOTFOUND)
-    return false;
-  else if (get_result)
-    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
+  m_read_ahead_cond.notify_all();
+  m_read_ahead_thread.join();
+  MDEBUG("Read-ahead stopped, " << read_ahead_hits_metric.value() << " hits, " << read_ahead_misses_metric.value() << " misses");
+}
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+void BlockchainLMDB::read_ahead_loop()
+{
+  boost::unique_lock<boost::mutex> lock(m_read_ahead_lock);
+  while (true)
+  {
+    m_read_ahead_cond.wait(lock, [this]() { return m_read_ahead_stop || !m_read_ahead_jobs.empty(); });
+    if (m_read_ahead_stop)
+      break;
+    const read_ahead_job job = m_read_ahead_jobs.front();
+    m_read_ahead_jobs.pop_front();
+    lock.unlock();
 
-  TXN_POSTFIX_RDONLY();
+    uint64_t loaded_to = job.start_height;
+    try
+    {
+      loaded_to = read_ahead_range(job.start_height, job.end_height);
+    }
+    catch (const std::exception &e)
+    {
+      MDEBUG("Read-ahead of blocks " << job.start_height << " to " << job.end_height << " failed: " << e.what());
+    }
 
-  return true;
+    lock.lock();
+    for (read_ahead_stream &stream: m_read_ahead_streams)
+    {
+      if (stream.id != job.stream_id)
+        continue;
+      stream.loaded_to = std::max(stream.loaded_to, loaded_to);
+      // stopped short (byte cap, chain tip): let the stream schedule the rest again
+      if (loaded_to < job.end_height)
+        stream.scheduled_to = std::min(stream.scheduled_to, loaded_to);
+      break;
+    }
+  }
 }
 
-bool BlockchainLMDB::get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const
+uint64_t BlockchainLMDB::read_ahead_range(uint64_t start_height, uint64_t end_height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
   TXN_PREFIX_RDONLY();
+  RCURSOR(blocks);
   RCURSOR(tx_indices);
-  RCURSOR(txs_prunable_hash);
+  RCURSOR(txs_pruned);
+  RCURSOR(txs_prunable);
 
-  MDB_val_set(v, tx_hash);
-  MDB_val result;
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
-  if (get_result == 0)
+  end_height = std::min(end_height, height());
+  uint64_t bytes = 0;
+  uint64_t first_tx_id = 0, num_txes = 0;
+  MDB_val_copy<uint64_t> key(start_height);
+  MDB_val v;
+  uint64_t h = start_height;
+  for (; h < end_height && bytes < READ_AHEAD_MAX_BYTES && !m_read_ahead_stop; ++h)
   {
-    txindex *tip = (txindex *)v.mv_data;
-    MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &result, MDB_SET);
-  }
-  if (get_result == MDB_NOTFOUND)
-    return false;
-  else if (get_result)
+    int result = mdb_cursor_get(m_cur_blocks, &key, &v, h == start_height ? MDB_SET : MDB_NEXT);
+    if (result)
+      break;
+    bytes += touch_pages(v);
+
+    cryptonote::block b;
+    if (!parse_and_validate_block_from_blob(cryptonote::blobdata_ref(reinterpret_cast<const char*>(v.mv_data), v.mv_size), b))
+      break;
+    if (h == start_height)
+    {
+      crypto::hash hash = cryptonote::get_transaction_hash(b.miner_tx);
+      MDB_val_set(vh, hash);
+      if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &vh, MDB_GET_BOTH))
+        break;
+      first_tx_id = ((const txindex *)vh.mv_data)->data.tx_id;
+    }
+    num_txes += b.tx_hashes.size() + 1;
+  }
+
+  // tx ids follow the chain order, so the txes of these blocks are contiguous
+  MDB_val_copy<uint64_t> tx_key(first_tx_id);
+  for (uint64_t n = 0; n < num_txes && !m_read_ahead_stop; ++n)
+  {
+    if (mdb_cursor_get(m_cur_txs_pruned, &tx_key, &v, n == 0 ? MDB_SET : MDB_NEXT))
+      break;
+    bytes += touch_pages(v);
+  }
+  // pruned or partially pruned dbs lack the prunable data of older txes
+  MDB_val_copy<uint64_t> prunable_key(first_tx_id);
+  MDB_val k = prunable_key;
+  for (uint64_t n = 0; n < num_txes && !m_read_ahead_stop; ++n)
+  {
+    if (mdb_cursor_get(m_cur_txs_prunable, &k, &v, n == 0 ? MDB_SET_RANGE : MDB_NEXT))
+      break;
+    uint64_t tx_id;
+    memcpy(&tx_id, k.mv_data, sizeof(tx_id));
+    if (tx_id >= first_tx_id + num_txes)
+      break;
+    bytes += touch_pages(v);
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  read_ahead_blocks_metric.inc(h - start_height);
+  read_ahead_bytes_metric.inc(bytes);
+  return h;
+}
+
+void BlockchainLMDB::note_sequential_read(uint64_t start_height, uint64_t end_height) const
+{
+  if (!m_read_ahead_enabled || end_height <= start_height)
+    return;
+
+  bool scheduled = false;
+  {
+    boost::lock_guard<boost::mutex> lock(m_read_ahead_lock);
+    if (!m_read_ahead_enabled)
+      return;
+
+    read_ahead_stream *stream = nullptr, *oldest = nullptr;
+    for (read_ahead_stream &s: m_read_ahead_streams)
+    {
+      if (s.next_height == start_height)
+        stream = &s;
+      if (!oldest || s.last_used < oldest->last_used)
+        oldest = &s;
+    }
+
+    const uint64_t use = m_read_ahead_next_id++;
+    if (!stream)
+    {
+      if (m_read_ahead_streams.size() < READ_AHEAD_MAX_STREAMS)
+      {
+        m_read_ahead_streams.emplace_back();
+        stream = &m_read_ahead_streams.back();
+      }
+      else
+        stream = oldest;
+      *stream = {use, end_height, 0, 0, use, 1};
+      return;
+    }
+
+    const uint64_t hits = stream->loaded_to > start_height ? std::min(end_height, stream->loaded_to) - start_height : 0;
+    read_ahead_hits_metric.inc(hits);
+    read_ahead_misses_metric.inc(end_height - start_height - hits);
+
+    stream->next_height = end_height;
+    stream->last_used = use;
+    ++stream->reads;
+
+    // keep at least half a window queued ahead of the reader
+    if (stream->reads >= READ_AHEAD_MIN_READS && stream->scheduled_to < end_height + READ_AHEAD_BLOCKS / 2)
+    {
+      const uint64_t start = std::max(end_height, stream->scheduled_to);
+      stream->scheduled_to = end_height + READ_AHEAD_BLOCKS;
+      m_read_ahead_jobs.push_back({stream->id, start, stream->scheduled_to});
+      while (m_read_ahead_jobs.size() > READ_AHEAD_MAX_STREAMS)
+        m_read_ahead_jobs.pop_front();
+      scheduled = true;
+    }
+  }
+  if (scheduled)
+    m_read_ahead_cond.notify_one();
+}
+
+uint64_t BlockchainLMDB::key_image_filter_hash(const crypto::key_image &k_image) const
+{
+  // key images are already uniformly distributed, the salt just keeps
+  // anyone from lining them up on purpose
+  uint64_t w[2];
+  memcpy(w, &k_image, sizeof(w));
+  uint64_t x = w[0] ^ m_key_image_filter_salt;
+  x = (x ^ (x >> 33)) * 0xff51afd7ed558ccdull;
+  x = (x ^ (x >> 33)) * 0xc4ceb9fe1a85ec53ull;
+  return x ^ (x >> 33) ^ w[1];
+}
+
+void BlockchainLMDB::build_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TIME_MEASURE_START(t);
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(spent_keys);
+
+  MDB_stat ms;
+  int result = mdb_stat(m_txn, m_spent_keys, &ms);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+  const uint64_t n_keys = ms.ms_entries;
+  m_key_image_filter.reset(n_keys + n_keys / 4 + KEY_IMAGE_FILTER_MIN_HEADROOM);
+
+  // all key images are dups of a single key, so read them a page at a time
+  MDB_val k = zerokval, v;
+  result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_SET);
+  if (result == 0)
+    result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_GET_MULTIPLE);
+  while (result == 0)
+  {
+    const crypto::key_image *ki = (const crypto::key_image*)v.mv_data;
+    for (size_t i = 0; i < v.mv_size / sizeof(crypto::key_image); ++i)
+      m_key_image_filter.add(key_image_filter_hash(ki[i]));
+    result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_NEXT_MULTIPLE);
+  }
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate key images: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+
+  TIME_MEASURE_FINISH(t);
+  MGINFO("Key image filter built from " << n_keys << " key images in " << t << " ms, using " << m_key_image_filter.size_bytes() / (1024 * 1024) << " MB");
+}
+
+void BlockchainLMDB::compress_prunable_data()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_batch_active)
+    throw0(DB_ERROR("Cannot compress prunable data while a batch transaction is active"));
+
+  MGINFO("Compressing prunable transaction data - this may take a while");
+  TIME_MEASURE_START(t);
+
+  uint64_t n_records = 0, n_raw_bytes = 0, n_stored_bytes = 0;
+  std::string encoded;
+  while (m_prunable_tagged_below != std::numeric_limits<uint64_t>::max())
+  {
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    mdb_txn_safe txn;
+    int result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_cursor *c_txs_prunable;
+    result = mdb_cursor_open(txn, m_txs_prunable, &c_txs_prunable);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+
+    // tx ids may have gaps on a pruned DB, so look for the next one present
+    uint64_t next_tx_id = m_prunable_tagged_below;
+    MDB_val k = {sizeof(next_tx_id), (void *)&next_tx_id}, v;
+    MDB_cursor_op op = MDB_SET_RANGE;
+    for (size_t n = 0; n < 4096; ++n)
+    {
+      result = mdb_cursor_get(c_txs_prunable, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND)
+      {
+        next_tx_id = std::numeric_limits<uint64_t>::max();
+        break;
+      }
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate prunable data: ", result).c_str()));
+
+      uint64_t tx_id;
+      memcpy(&tx_id, k.mv_data, sizeof(tx_id));
+      encode_prunable_blob(v.mv_data, v.mv_size, encoded);
+      n_raw_bytes += v.mv_size;
+      n_stored_bytes += encoded.size();
+
+      MDB_val_set(nk, tx_id);
+      MDB_val nv = {encoded.size(), (void *)encoded.data()};
+      result = mdb_cursor_put(c_txs_prunable, &nk, &nv, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to update prunable data: ", result).c_str()));
+      next_tx_id = tx_id + 1;
+      ++n_records;
+    }
+
+    MDB_val_str(pk, "prunable_tagged_below");
+    MDB_val_set(pv, next_tx_id);
+    result = mdb_put(txn, m_properties, &pk, &pv, 0);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to save prunable data storage state: ", result).c_str()));
+    if (m_prunable_tagged_below == 0)
+    {
+      // committed with the first tagged records, older binaries must not read them raw
+      MDB_val_str(vk, "version");
+      MDB_val_copy<uint32_t> vv(VERSION | VERSION_TAGGED_PRUNABLE);
+      result = mdb_put(txn, m_properties, &vk, &vv, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
+    }
+    txn.commit();
+    m_prunable_tagged_below = next_tx_id;
+    MINFO(n_records << " prunable records compressed");
+  }
+
+  TIME_MEASURE_FINISH(t);
+  MGINFO("Compressed prunable data for " << n_records << " transactions in " << t << " ms: " <<
+      n_raw_bytes << " bytes stored as " << n_stored_bytes << " bytes");
+}
+
+void BlockchainLMDB::append_prunable_blob(uint64_t tx_id, const MDB_val &v, cryptonote::blobdata &bd) const
+{
+  if (tx_id < m_prunable_tagged_below)
+    decode_prunable_blob(v, bd);
+  else
+    bd.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+}
+
+bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(txs_prunable);
+
+  MDB_val result;
+  tx_data_t td;
+  uint64_t tx_id = 0;
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
+  if (get_result == 0)
+  {
+    tx_id = td.tx_id;
+    MDB_val_set(val_tx_id, tx_id);
+    get_result = counted_get(m_table_counters[MDB_TABLE_TXS_PRUNABLE], m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+  }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
+    throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
+
+  bd.clear();
+  append_prunable_blob(tx_id, result, bd);
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
+bool BlockchainLMDB::get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(tx_indices);
+  RCURSOR(txs_prunable_hash);
+
+  MDB_val_set(v, tx_hash);
+  MDB_val result;
+  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (get_result == 0)
+  {
+    txindex *tip = (txindex *)v.mv_data;
+    MDB_val_set(val_tx_id, tip->data.tx_id);
+    get_result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &result, MDB_SET);
+  }
+  if (get_result == MDB_NOTFOUND)
+    return false;
+  else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx prunable hash from tx hash", get_result).c_str()));
 
   prunable_hash = *(const crypto::hash*)result.mv_data;
@@ -3343,10 +4185,9 @@ uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(tx_indices);
 
-  MDB_val_set(v, h);
-  auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  tx_data_t td;
+  auto get_result = get_tx_index(h, td, m_txn, m_cursors);
   if (get_result == MDB_NOTFOUND)
   {
     throw1(TX_DNE(std::string("tx_data_t with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
@@ -3354,8 +4195,7 @@ uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx height from hash", get_result).c_str()));
 
-  txindex *tip = (txindex *)v.mv_data;
-  uint64_t ret = tip->data.block_id;
+  uint64_t ret = td.block_id;
   TXN_POSTFIX_RDONLY();
   return ret;
 }
@@ -3394,7 +4234,7 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
 
   MDB_val_set(k, amount);
   MDB_val_set(v, index);
-  auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+  auto get_result = counted_get(m_table_counters[MDB_TABLE_OUTPUT_AMOUNTS], m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE(std::string("Attempting to get output pubkey by index, but key does not exist: amount " +
         std::to_string(amount) + ", index " + std::to_string(index)).c_str()));
@@ -3497,24 +4337,361 @@ std::vector<std::vector<uint64_t>> BlockchainLMDB::get_tx_amount_output_indices(
   return amount_output_indices_set;
 }
 
+bool BlockchainLMDB::has_output_pubkey_index() const
+{
+  return m_output_pubkeys_indexed;
+}
+
+bool BlockchainLMDB::build_output_pubkey_index()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_output_pubkeys_indexed)
+    return true;
+  if (is_read_only())
+    throw0(DB_ERROR("Cannot build the output public key index on a read-only database"));
+  if (m_batch_active)
+    throw0(DB_ERROR("Cannot build the output public key index while a batch transaction is active"));
+
+  MGINFO("Building output public key index - this may take a while");
+  TIME_MEASURE_START(t);
+
+  uint64_t amount = 0, amount_index = 0;
+  size_t n_records = 0;
+  bool done = false;
+  while (!done)
+  {
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    mdb_txn_safe txn;
+    int result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_cursor *c_output_amounts, *c_output_pubkeys;
+    result = mdb_cursor_open(txn, m_output_amounts, &c_output_amounts);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+    result = mdb_cursor_open(txn, m_output_pubkeys, &c_output_pubkeys);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_pubkeys: ", result).c_str()));
+
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    if (n_records == 0)
+    {
+      // an interrupted build may have left a partial index behind
+      result = mdb_drop(txn, m_output_pubkeys, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to drop m_output_pubkeys: ", result).c_str()));
+    }
+    else
+    {
+      // pick up after the last output indexed in the previous txn
+      k = {sizeof(amount), (void *)&amount};
+      v = {sizeof(amount_index), (void *)&amount_index};
+      result = mdb_cursor_get(c_output_amounts, &k, &v, MDB_GET_BOTH);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to find last indexed output: ", result).c_str()));
+      op = MDB_NEXT;
+    }
+
+    for (size_t n = 0; n < 100000; ++n)
+    {
+      result = mdb_cursor_get(c_output_amounts, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND)
+      {
+        done = true;
+        break;
+      }
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", result).c_str()));
+
+      // pre_rct_outkey is a prefix of outkey, so this works for both
+      const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
+      memcpy(&amount, k.mv_data, sizeof(amount));
+      amount_index = okp->amount_index;
+
+      outpubkey opk = {okp->output_id, amount, amount_index};
+      crypto::public_key pubkey = okp->data.pubkey;
+      MDB_val_set(kpk, pubkey);
+      MDB_val_set(vpk, opk);
+      result = mdb_cursor_put(c_output_pubkeys, &kpk, &vpk, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to index: ", result).c_str()));
+      ++n_records;
+    }
+
+    if (done)
+    {
+      MDB_val_str(pk, "output_pubkeys_indexed");
+      MDB_val_copy<uint32_t> pv(1);
+      result = mdb_put(txn, m_properties, &pk, &pv, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to save output public key index state: ", result).c_str()));
+    }
+    txn.commit();
+    MINFO(n_records << " outputs indexed");
+  }
+
+  m_output_pubkeys_indexed = true;
+  TIME_MEASURE_FINISH(t);
+  MGINFO("Output public key index built for " << n_records << " outputs in " << t << " ms");
+  return true;
+}
+
+bool BlockchainLMDB::get_output_index_by_pubkey(const crypto::public_key &pubkey, uint64_t &amount, uint64_t &amount_index) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (!m_output_pubkeys_indexed)
+    throw0(DB_ERROR("Output public key index not built"));
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(output_pubkeys);
+
+  MDB_val_set(k, pubkey);
+  MDB_val v;
+  int result = counted_get(m_table_counters[MDB_TABLE_OUTPUT_PUBKEYS], m_cur_output_pubkeys, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to look up output pubkey: ", result).c_str()));
+
+  outpubkey opk;
+  memcpy(&opk, v.mv_data, sizeof(opk));
+  amount = opk.amount;
+  amount_index = opk.amount_index;
+
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
+bool BlockchainLMDB::has_view_tag_index() const
+{
+  return m_view_tags_indexed;
+}
+
+bool BlockchainLMDB::build_view_tag_index()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_view_tags_indexed)
+    return true;
+  if (is_read_only())
+    throw0(DB_ERROR("Cannot build the view tag index on a read-only database"));
+  if (m_batch_active)
+    throw0(DB_ERROR("Cannot build the view tag index while a batch transaction is active"));
+
+  MGINFO("Building view tag index - this may take a while");
+  TIME_MEASURE_START(t);
+
+  // versions only go up, so older blocks can be skipped
+  const uint64_t top = height();
+  uint64_t h = 0, end = top;
+  while (h < end)
+  {
+    const uint64_t mid = h + (end - h) / 2;
+    if (get_block_from_height(mid).major_version >= HF_VERSION_VIEW_TAGS)
+      end = mid;
+    else
+      h = mid + 1;
+  }
+
+  std::vector<std::pair<uint64_t, blobdata>> entries;
+  size_t n_records = 0;
+  bool first = true;
+  do
+  {
+    // blocks and txes are read before the write txn, which only stores them
+    entries.clear();
+    for (; h < top && entries.size() < 1000; ++h)
+    {
+      const block b = get_block_from_height(h);
+      if (b.major_version < HF_VERSION_VIEW_TAGS)
+        continue;
+      block_view_tags tags;
+      tags.txes.resize(b.tx_hashes.size() + 1);
+      get_tx_view_tags(b.miner_tx, get_transaction_hash(b.miner_tx), tags.txes[0]);
+      for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+      {
+        transaction tx;
+        if (!get_pruned_tx(b.tx_hashes[i], tx))
+          throw0(DB_ERROR("Failed to get tx from the db for the view tag index"));
+        get_tx_view_tags(tx, b.tx_hashes[i], tags.txes[i + 1]);
+      }
+      entries.emplace_back(h, blobdata());
+      if (!t_serializable_object_to_blob(tags, entries.back().second))
+        throw0(DB_ERROR("Failed to serialize block view tags"));
+    }
+
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    mdb_txn_safe txn;
+    int result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    if (first)
+    {
+      // an interrupted build may have left a partial index behind
+      result = mdb_drop(txn, m_view_tags, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to drop m_view_tags: ", result).c_str()));
+      first = false;
+    }
+
+    MDB_cursor *c_view_tags;
+    result = mdb_cursor_open(txn, m_view_tags, &c_view_tags);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for view_tags: ", result).c_str()));
+    for (const auto &e: entries)
+    {
+      MDB_val_copy<uint64_t> k(e.first);
+      MDB_val v = {e.second.size(), (void *)e.second.data()};
+      result = mdb_cursor_put(c_view_tags, &k, &v, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to add block view tags to index: ", result).c_str()));
+    }
+    n_records += entries.size();
+
+    if (h == top)
+    {
+      MDB_val_str(pk, "view_tags_indexed");
+      MDB_val_copy<uint32_t> pv(1);
+      result = mdb_put(txn, m_properties, &pk, &pv, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to save view tag index state: ", result).c_str()));
+    }
+    txn.commit();
+    MINFO(n_records << " blocks indexed");
+  } while (h < top);
+
+  m_view_tags_indexed = true;
+  TIME_MEASURE_FINISH(t);
+  MGINFO("View tag index built for " << n_records << " blocks in " << t << " ms");
+  return true;
+}
+
+void BlockchainLMDB::get_blocks_view_tags(uint64_t start_height, size_t count, std::vector<blobdata> &blobs) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (!m_view_tags_indexed)
+    throw0(DB_ERROR("View tag index not built"));
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(view_tags);
+
+  blobs.clear();
+  const uint64_t top = height();
+  if (start_height >= top)
+    return;
+  count = std::min<uint64_t>(count, top - start_height);
+  blobs.resize(count);
+
+  // walk the entries from start_height on, heights without one are left empty
+  MDB_val_copy<uint64_t> k(start_height);
+  MDB_val key = k, v;
+  int result = counted_get(m_table_counters[MDB_TABLE_VIEW_TAGS], m_cur_view_tags, &key, &v, MDB_SET_RANGE);
+  while (result == 0)
+  {
+    uint64_t h;
+    memcpy(&h, key.mv_data, sizeof(h));
+    if (h >= start_height + count)
+      break;
+    blobs[h - start_height].assign((const char *)v.mv_data, v.mv_size);
+    result = counted_get(m_table_counters[MDB_TABLE_VIEW_TAGS], m_cur_view_tags, &key, &v, MDB_NEXT);
+  }
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate block view tags: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+}
+
+void BlockchainLMDB::add_block_view_tags(uint64_t height, const blobdata &blob)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(view_tags)
+
+  MDB_val_copy<uint64_t> k(height);
+  MDB_val v = {blob.size(), (void *)blob.data()};
+  int result = counted_put(m_table_counters[MDB_TABLE_VIEW_TAGS], m_cur_view_tags, &k, &v, MDB_APPEND);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add block view tags to db transaction: ", result).c_str()));
+}
+
 bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (!m_key_image_filter.empty() && !m_key_image_filter.may_contain(key_image_filter_hash(img)))
+    return false;
+
   bool ret;
 
   TXN_PREFIX_RDONLY();
   RCURSOR(spent_keys);
 
   MDB_val k = {sizeof(img), (void *)&img};
-  ret = (mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
+  ret = (counted_get(m_table_counters[MDB_TABLE_SPENT_KEYS], m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
 
   TXN_POSTFIX_RDONLY();
   return ret;
 }
 
-bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
+void BlockchainLMDB::have_key_images_batch(const epee::span<const crypto::key_image> &imgs, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  spent.clear();
+  spent.resize(imgs.size(), false);
+  if (imgs.empty())
+    return;
+
+  // visit the keys in the table's own order, so the cursor moves forward only
+  std::vector<size_t> order(imgs.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&imgs](size_t a, size_t b) {
+    const MDB_val va = {sizeof(crypto::key_image), (void*)&imgs[a]};
+    const MDB_val vb = {sizeof(crypto::key_image), (void*)&imgs[b]};
+    return compare_hash32(&va, &vb) < 0;
+  });
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(spent_keys);
+
+  const bool filtered = !m_key_image_filter.empty();
+  for (const size_t i: order)
+  {
+    if (filtered && !m_key_image_filter.may_contain(key_image_filter_hash(imgs[i])))
+      continue;
+    MDB_val k = {sizeof(imgs[i]), (void *)&imgs[i]};
+    spent[i] = (counted_get(m_table_counters[MDB_TABLE_SPENT_KEYS], m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
+  }
+
+  TXN_POSTFIX_RDONLY();
+}
+
+bool BlockchainLMDB::for_key_images_range(const crypto::key_image *lo, const crypto::key_image *hi, const std::function<bool(const crypto::key_image&)> &f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
@@ -3527,6 +4704,12 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
 
   k = zerokval;
   MDB_cursor_op op = MDB_FIRST;
+  if (lo)
+  {
+    v = MDB_val{sizeof(*lo), (void*)lo};
+    op = MDB_GET_BOTH_RANGE;
+  }
+  const MDB_val hi_val{sizeof(crypto::key_image), (void*)hi};
   while (1)
   {
     int ret = mdb_cursor_get(m_cur_spent_keys, &k, &v, op);
@@ -3535,6 +4718,8 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
       break;
     if (ret < 0)
       throw0(DB_ERROR("Failed to enumerate key images"));
+    if (hi && compare_hash32(&v, &hi_val) >= 0)
+      break;
     const crypto::key_image k_image = *(const crypto::key_image*)v.mv_data;
     if (!f(k_image)) {
       fret = false;
@@ -3547,6 +4732,11 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   return fret;
 }
 
+bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
+{
+  return for_key_images_range(NULL, NULL, f);
+}
+
 bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3597,7 +4787,7 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
   return fret;
 }
 
-bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)> f, bool pruned) const
+bool BlockchainLMDB::for_transactions_range(const crypto::hash *lo, const crypto::hash *hi, const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
@@ -3612,6 +4802,13 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
   bool fret = true;
 
   MDB_cursor_op op = MDB_FIRST;
+  if (lo)
+  {
+    k = zerokval;
+    v = MDB_val{sizeof(*lo), (void*)lo};
+    op = MDB_GET_BOTH_RANGE;
+  }
+  const MDB_val hi_val{sizeof(crypto::hash), (void*)hi};
   while (1)
   {
     int ret = mdb_cursor_get(m_cur_tx_indices, &k, &v, op);
@@ -3620,7 +4817,8 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       break;
     if (ret)
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
-
+    if (hi && compare_hash32(&v, &hi_val) >= 0)
+      break;
     txindex *ti = (txindex *)v.mv_data;
     const crypto::hash hash = ti->key;
     k.mv_data = (void *)&ti->data.tx_id;
@@ -3645,7 +4843,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
-      bd.append(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+      append_prunable_blob(ti->data.tx_id, v, bd);
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
     }
@@ -3660,7 +4858,12 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
   return fret;
 }
 
-bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const
+bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)> f, bool pruned) const
+{
+  return for_transactions_range(NULL, NULL, f, pruned);
+}
+
+bool BlockchainLMDB::for_outputs_range(const std::pair<uint64_t, uint64_t> *lo, const std::pair<uint64_t, uint64_t> *hi, const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
@@ -3673,9 +4876,22 @@ bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const c
   bool fret = true;
 
   MDB_cursor_op op = MDB_FIRST;
+  if (lo)
+  {
+    k = MDB_val{sizeof(lo->first), (void*)&lo->first};
+    v = MDB_val{sizeof(lo->second), (void*)&lo->second};
+    op = MDB_GET_BOTH_RANGE;
+  }
   while (1)
   {
     int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+    if (ret == MDB_NOTFOUND && op == MDB_GET_BOTH_RANGE && lo->first != std::numeric_limits<uint64_t>::max())
+    {
+      // nothing at or past the start index for this amount, carry on from the next one
+      const uint64_t next_amount = lo->first + 1;
+      k = MDB_val{sizeof(next_amount), (void*)&next_amount};
+      ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_SET_RANGE);
+    }
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -3683,6 +4899,8 @@ bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const c
       throw0(DB_ERROR("Failed to enumerate outputs"));
     uint64_t amount = *(const uint64_t*)k.mv_data;
     outkey *ok = (outkey *)v.mv_data;
+    if (hi && (amount > hi->first || (amount == hi->first && ok->amount_index >= hi->second)))
+      break;
     tx_out_index toi = get_output_tx_and_index_from_global(ok->output_id);
     if (!f(amount, toi.first, ok->data.height, toi.second)) {
       fret = false;
@@ -3695,6 +4913,11 @@ bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const c
   return fret;
 }
 
+bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const
+{
+  return for_outputs_range(NULL, NULL, f);
+}
+
 bool BlockchainLMDB::for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3735,6 +4958,181 @@ bool BlockchainLMDB::for_all_outputs(uint64_t amount, const std::function<bool(u
   return fret;
 }
 
+size_t BlockchainLMDB::get_parallel_scan_partitions() const
+{
+  // a writer would not see its own uncommitted data from the other threads' read txns
+  if (m_write_txn && m_writer == boost::this_thread::get_id())
+    return 1;
+  const size_t threads = tools::threadpool::getInstanceForCompute().get_max_concurrency();
+  if (threads <= 1)
+    return 1;
+  return threads * PARALLEL_SCAN_PARTITIONS_PER_THREAD;
+}
+
+bool BlockchainLMDB::run_parallel_scan(size_t n, const std::function<bool(size_t, const std::atomic<bool>&)> &job) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  tools::threadpool &tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  std::atomic<bool> ok(true);
+  boost::mutex error_lock;
+  std::exception_ptr error;
+  for (size_t i = 0; i < n; ++i)
+  {
+    tpool.submit(&waiter, [&, i]() {
+      if (!ok)
+        return;
+      try
+      {
+        if (!job(i, ok))
+          ok = false;
+      }
+      catch (...)
+      {
+        boost::unique_lock<boost::mutex> lock(error_lock);
+        if (!error)
+          error = std::current_exception();
+        ok = false;
+      }
+    }, true);
+  }
+  waiter.wait();
+  if (error)
+    std::rethrow_exception(error);
+  return ok;
+}
+
+// splits the hash space into n ranges on the most significant word, as ordered by compare_hash32
+template<typename T>
+static T get_hash32_partition_bound(size_t i, size_t n)
+{
+  static_assert(sizeof(T) == 8 * sizeof(uint32_t), "Unexpected hash32 size");
+  T h;
+  memset(&h, 0, sizeof(h));
+  const uint32_t word = (((uint64_t)i) << 32) / n;
+  memcpy(reinterpret_cast<char*>(&h) + 7 * sizeof(uint32_t), &word, sizeof(word));
+  return h;
+}
+
+bool BlockchainLMDB::for_all_key_images_parallel(const std::function<bool(const crypto::key_image&)> &f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  const size_t n = get_parallel_scan_partitions();
+  if (n <= 1)
+    return for_all_key_images(f);
+
+  return run_parallel_scan(n, [&](size_t i, const std::atomic<bool> &ok) {
+    const crypto::key_image lo = get_hash32_partition_bound<crypto::key_image>(i, n);
+    const crypto::key_image hi = get_hash32_partition_bound<crypto::key_image>(i + 1, n);
+    return for_key_images_range(i ? &lo : NULL, i + 1 < n ? &hi : NULL, [&](const crypto::key_image &k_image) {
+      return ok && f(k_image);
+    });
+  });
+}
+
+bool BlockchainLMDB::for_blocks_range_parallel(const uint64_t& h1, const uint64_t& h2, const std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> &f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  const uint64_t db_height = height();
+  const size_t n = get_parallel_scan_partitions();
+  if (n <= 1 || db_height == 0 || h1 > h2 || h1 >= db_height)
+    return for_blocks_range(h1, h2, f);
+
+  const uint64_t top = std::min<uint64_t>(h2, db_height - 1);
+  const uint64_t span = top - h1 + 1;
+  const size_t parts = std::min<uint64_t>(n, span);
+  return run_parallel_scan(parts, [&](size_t i, const std::atomic<bool> &ok) {
+    const uint64_t start = h1 + span * i / parts;
+    const uint64_t end = h1 + span * (i + 1) / parts - 1;
+    return for_blocks_range(start, end, [&](uint64_t height, const crypto::hash &hash, const cryptonote::block &b) {
+      return ok && f(height, hash, b);
+    });
+  });
+}
+
+bool BlockchainLMDB::for_all_transactions_parallel(const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  const size_t n = get_parallel_scan_partitions();
+  if (n <= 1)
+    return for_all_transactions(f, pruned);
+
+  return run_parallel_scan(n, [&](size_t i, const std::atomic<bool> &ok) {
+    const crypto::hash lo = get_hash32_partition_bound<crypto::hash>(i, n);
+    const crypto::hash hi = get_hash32_partition_bound<crypto::hash>(i + 1, n);
+    return for_transactions_range(i ? &lo : NULL, i + 1 < n ? &hi : NULL, [&](const crypto::hash &hash, const cryptonote::transaction &tx) {
+      return ok && f(hash, tx);
+    }, pruned);
+  });
+}
+
+bool BlockchainLMDB::for_all_outputs_parallel(const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  const size_t n = get_parallel_scan_partitions();
+  if (n <= 1)
+    return for_all_outputs(f);
+
+  // output_amounts is keyed by amount, with most outputs under amount 0, so
+  // split on (amount, amount_index) positions rather than on whole amounts
+  std::vector<std::pair<uint64_t, uint64_t>> amount_counts;
+  uint64_t total = 0;
+  {
+    TXN_PREFIX_RDONLY();
+    RCURSOR(output_amounts);
+
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    while (1)
+    {
+      int ret = mdb_cursor_get(m_cur_output_amounts, &k, &v, op);
+      op = MDB_NEXT_NODUP;
+      if (ret == MDB_NOTFOUND)
+        break;
+      if (ret)
+        throw0(DB_ERROR(lmdb_error("Failed to enumerate outputs: ", ret).c_str()));
+      mdb_size_t count;
+      if ((ret = mdb_cursor_count(m_cur_output_amounts, &count)))
+        throw0(DB_ERROR(lmdb_error("Failed to count outputs: ", ret).c_str()));
+      amount_counts.push_back({*(const uint64_t*)k.mv_data, count});
+      total += count;
+    }
+
+    TXN_POSTFIX_RDONLY();
+  }
+  if (total == 0)
+    return true;
+
+  const size_t parts = std::min<uint64_t>(n, total);
+  std::vector<std::pair<uint64_t, uint64_t>> bounds;
+  bounds.reserve(parts - 1);
+  uint64_t seen = 0;
+  size_t idx = 0;
+  for (size_t i = 1; i < parts; ++i)
+  {
+    const uint64_t pos = total * i / parts;
+    while (seen + amount_counts[idx].second <= pos)
+      seen += amount_counts[idx++].second;
+    bounds.push_back({amount_counts[idx].first, pos - seen});
+  }
+
+  return run_parallel_scan(parts, [&](size_t i, const std::atomic<bool> &ok) {
+    return for_outputs_range(i ? &bounds[i - 1] : NULL, i + 1 < parts ? &bounds[i] : NULL,
+        [&](uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx) {
+      return ok && f(amount, tx_hash, height, tx_idx);
+    });
+  });
+}
+
 // batch_num_blocks: (optional) Used to check if resize needed before batch transaction starts.
 bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes)
 {
@@ -3798,6 +5196,7 @@ void BlockchainLMDB::batch_commit()
   m_write_txn->commit();
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
+  finish_cum_rct_column_txn(true);
   LOG_PRINT_L3("batch transaction: committed");
 
   m_write_txn = nullptr;
@@ -3835,10 +5234,12 @@ void BlockchainLMDB::batch_stop()
     m_write_txn->commit();
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
+    finish_cum_rct_column_txn(true);
     cleanup_batch();
   }
   catch (const std::exception &e)
   {
+    finish_cum_rct_column_txn(false);
     cleanup_batch();
     throw;
   }
@@ -3865,6 +5266,7 @@ void BlockchainLMDB::batch_abort()
   m_write_batch_txn = nullptr;
   m_batch_active = false;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+  finish_cum_rct_column_txn(false);
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
@@ -3982,9 +5384,18 @@ void BlockchainLMDB::block_wtxn_stop()
     if (! m_batch_active)
 	{
       TIME_MEASURE_START(time1);
-      m_write_txn->commit();
+      try
+      {
+        m_write_txn->commit();
+      }
+      catch (...)
+      {
+        finish_cum_rct_column_txn(false);
+        throw;
+      }
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
+      finish_cum_rct_column_txn(true);
 
       delete m_write_txn;
       m_write_txn = nullptr;
@@ -4006,6 +5417,7 @@ void BlockchainLMDB::block_wtxn_abort()
     delete m_write_txn;
     m_write_txn = nullptr;
     memset(&m_wcursors, 0, sizeof(m_wcursors));
+    finish_cum_rct_column_txn(false);
   }
 }
 
@@ -4113,7 +5525,7 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
     MDB_val_set(k, amount);
     MDB_val_set(v, offsets[i]);
 
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+    auto get_result = counted_get(m_table_counters[MDB_TABLE_OUTPUT_AMOUNTS], m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
     if (get_result == MDB_NOTFOUND)
     {
       if (allow_partial)
@@ -4147,6 +5559,35 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   LOG_PRINT_L3("db3: " << db3);
 }
 
+void BlockchainLMDB::get_output_keys_batch(const std::vector<uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (amounts.size() != offsets.size())
+    throw0(DB_ERROR("Invalid sizes of amounts and offsets"));
+
+  // sort by (amount, offset), which is the order of the output_amounts table
+  std::vector<size_t> order(offsets.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&amounts, &offsets](size_t a, size_t b) {
+    return amounts[a] < amounts[b] || (amounts[a] == amounts[b] && offsets[a] < offsets[b]);
+  });
+
+  std::vector<uint64_t> sorted_amounts(order.size()), sorted_offsets(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    sorted_amounts[i] = amounts[order[i]];
+    sorted_offsets[i] = offsets[order[i]];
+  }
+
+  std::vector<output_data_t> sorted_outputs;
+  get_output_key(epee::to_span(sorted_amounts), sorted_offsets, sorted_outputs);
+
+  outputs.resize(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    outputs[order[i]] = sorted_outputs[i];
+}
+
 void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -4240,34 +5681,48 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
 
   if (unlocked || recent_cutoff > 0) {
     const uint64_t blockchain_height = height();
-    for (std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>::iterator i = histogram.begin(); i != histogram.end(); ++i) {
-      uint64_t amount = i->first;
-      uint64_t num_elems = std::get<0>(i->second);
-      while (num_elems > 0) {
-        const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-        const uint64_t height = get_tx_block_height(toi.first);
-        if (height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= blockchain_height)
-          break;
-        --num_elems;
+    const uint64_t unlocked_height = blockchain_height + 1 > CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE ? blockchain_height + 1 - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE : 0;
+
+    // first height at or after the cutoff, taking block timestamps as ordered
+    uint64_t cutoff_height = unlocked_height;
+    if (recent_cutoff > 0)
+    {
+      uint64_t lo = 0, hi = blockchain_height;
+      while (lo < hi)
+      {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (get_block_timestamp(mid) < recent_cutoff)
+          lo = mid + 1;
+        else
+          hi = mid;
       }
-      // modifying second does not invalidate the iterator
-      std::get<1>(i->second) = num_elems;
+      cutoff_height = std::min(lo, unlocked_height);
+    }
 
-      if (recent_cutoff > 0)
+    // an amount's outputs are indexed in height order, so how many of the
+    // first num_elems are below a height is a bisection, not a tail walk
+    const auto count_below = [this](uint64_t amount, uint64_t num_elems, uint64_t below_height) -> uint64_t {
+      if (num_elems == 0 || get_output_key(amount, num_elems - 1, false).height < below_height)
+        return num_elems;
+      uint64_t lo = 0, hi = num_elems - 1;
+      while (lo < hi)
       {
-        uint64_t recent = 0;
-        while (num_elems > 0) {
-          const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
-          const uint64_t height = get_tx_block_height(toi.first);
-          const uint64_t ts = get_block_timestamp(height);
-          if (ts < recent_cutoff)
-            break;
-          --num_elems;
-          ++recent;
-        }
-        // modifying second does not invalidate the iterator
-        std::get<2>(i->second) = recent;
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (get_output_key(amount, mid, false).height < below_height)
+          lo = mid + 1;
+        else
+          hi = mid;
       }
+      return lo;
+    };
+
+    for (std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>::iterator i = histogram.begin(); i != histogram.end(); ++i) {
+      const uint64_t amount = i->first;
+      const uint64_t num_unlocked = count_below(amount, std::get<0>(i->second), unlocked_height);
+      // modifying second does not invalidate the iterator
+      std::get<1>(i->second) = num_unlocked;
+      if (recent_cutoff > 0)
+        std::get<2>(i->second) = num_unlocked - count_below(amount, num_unlocked, cutoff_height);
     }
   }
 
@@ -4339,10 +5794,69 @@ void BlockchainLMDB::drop_hard_fork_info()
   result = mdb_drop(*txn_ptr, m_hf_versions, 1);
   if (result)
     throw1(DB_ERROR(lmdb_error("Error dropping hard fork versions db: ", result).c_str()));
+  MDB_val_str(k, "hf_voting_window");
+  result = mdb_del(*txn_ptr, m_properties, &k, NULL);
+  if (result && result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Error dropping hard fork voting window: ", result).c_str()));
+
+  TXN_POSTFIX_SUCCESS();
+}
+
+void BlockchainLMDB::set_hard_fork_voting_window(const hard_fork_voting_window &window)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  std::string data(HF_VOTING_WINDOW_HEADER_SIZE + window.versions.size(), '\0');
+  char *ptr = &data[0];
+  memcpy(ptr, &window.height, sizeof(window.height)); ptr += sizeof(window.height);
+  memcpy(ptr, &window.top_hash, sizeof(window.top_hash)); ptr += sizeof(window.top_hash);
+  memcpy(ptr, &window.window_size, sizeof(window.window_size)); ptr += sizeof(window.window_size);
+  *ptr++ = window.max_version;
+  if (!window.versions.empty())
+    memcpy(ptr, window.versions.data(), window.versions.size());
+
+  TXN_PREFIX(0);
+
+  MDB_val_str(k, "hf_voting_window");
+  MDB_val v = {data.size(), (void *)data.data()};
+  if (auto result = mdb_put(*txn_ptr, m_properties, &k, &v, 0))
+    throw1(DB_ERROR(lmdb_error("Error saving hard fork voting window: ", result).c_str()));
 
   TXN_POSTFIX_SUCCESS();
 }
 
+bool BlockchainLMDB::get_hard_fork_voting_window(hard_fork_voting_window &window) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_val_str(k, "hf_voting_window");
+  MDB_val v;
+  auto result = mdb_get(m_txn, m_properties, &k, &v);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Error attempting to retrieve the hard fork voting window: ", result).c_str()));
+  if (v.mv_size < HF_VOTING_WINDOW_HEADER_SIZE)
+  {
+    MWARNING("Ignoring hard fork voting window with unexpected size " << v.mv_size);
+    return false;
+  }
+
+  const char *ptr = (const char*)v.mv_data;
+  memcpy(&window.height, ptr, sizeof(window.height)); ptr += sizeof(window.height);
+  memcpy(&window.top_hash, ptr, sizeof(window.top_hash)); ptr += sizeof(window.top_hash);
+  memcpy(&window.window_size, ptr, sizeof(window.window_size)); ptr += sizeof(window.window_size);
+  window.max_version = *ptr++;
+  window.versions.assign((const uint8_t*)ptr, (const uint8_t*)v.mv_data + v.mv_size);
+
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
 void BlockchainLMDB::set_hard_fork_version(uint64_t height, uint8_t version)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -4508,6 +6022,85 @@ uint64_t BlockchainLMDB::get_database_size() const
   return size;
 }
 
+bool BlockchainLMDB::get_db_stats(db_stats &stats) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MDB_envinfo mei;
+  MDB_stat mst;
+  int result = mdb_env_info(m_env, &mei);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get environment info: ", result).c_str()));
+  result = mdb_env_stat(m_env, &mst);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to stat environment: ", result).c_str()));
+  stats.map_size = mei.me_mapsize;
+  stats.page_size = mst.ms_psize;
+  stats.last_page = mei.me_last_pgno;
+  stats.max_readers = mei.me_maxreaders;
+  stats.num_readers = mei.me_numreaders;
+
+  const struct { const char *name; MDB_dbi dbi; } tables[MDB_TABLE_COUNT] = {
+    { LMDB_BLOCKS, m_blocks },
+    { LMDB_BLOCK_HEIGHTS, m_block_heights },
+    { LMDB_BLOCK_INFO, m_block_info },
+    { LMDB_TXS, m_txs },
+    { LMDB_TXS_PRUNED, m_txs_pruned },
+    { LMDB_TXS_PRUNABLE, m_txs_prunable },
+    { LMDB_TXS_PRUNABLE_HASH, m_txs_prunable_hash },
+    { LMDB_TXS_PRUNABLE_TIP, m_txs_prunable_tip },
+    { LMDB_TX_INDICES, m_tx_indices },
+    { LMDB_TX_OUTPUTS, m_tx_outputs },
+    { LMDB_OUTPUT_TXS, m_output_txs },
+    { LMDB_OUTPUT_AMOUNTS, m_output_amounts },
+    { LMDB_OUTPUT_PUBKEYS, m_output_pubkeys },
+    { LMDB_VIEW_TAGS, m_view_tags },
+    { LMDB_SPENT_KEYS, m_spent_keys },
+    { LMDB_TXPOOL_META, m_txpool_meta },
+    { LMDB_TXPOOL_BLOB, m_txpool_blob },
+    { LMDB_ALT_BLOCKS, m_alt_blocks },
+    { LMDB_HF_VERSIONS, m_hf_versions },
+    { LMDB_PROPERTIES, m_properties },
+  };
+
+  TXN_PREFIX_RDONLY();
+
+  stats.tables.clear();
+  stats.tables.reserve(MDB_TABLE_COUNT);
+  for (size_t i = 0; i < MDB_TABLE_COUNT; ++i)
+  {
+    db_table_stats ts{};
+    ts.name = tables[i].name;
+    // a table missing from a read only database is left at 0, the free list
+    if (tables[i].dbi)
+    {
+      result = mdb_stat(m_txn, tables[i].dbi, &mst);
+      if (result)
+        throw0(DB_ERROR(lmdb_error(std::string("Failed to stat table ") + tables[i].name + ": ", result).c_str()));
+      ts.entries = mst.ms_entries;
+      ts.depth = mst.ms_depth;
+      ts.branch_pages = mst.ms_branch_pages;
+      ts.leaf_pages = mst.ms_leaf_pages;
+      ts.overflow_pages = mst.ms_overflow_pages;
+    }
+    const mdb_table_counters &c = m_table_counters[i];
+    ts.gets = c.gets.load(std::memory_order_relaxed);
+    ts.misses = c.misses.load(std::memory_order_relaxed);
+    ts.puts = c.puts.load(std::memory_order_relaxed);
+    ts.deletes = c.deletes.load(std::memory_order_relaxed);
+    ts.bytes_read = c.bytes_read.load(std::memory_order_relaxed);
+    ts.bytes_written = c.bytes_written.load(std::memory_order_relaxed);
+    ts.get_latency_histogram.reserve(mdb_table_counters::LATENCY_BUCKETS);
+    for (const auto &b: c.get_latency)
+      ts.get_latency_histogram.push_back(b.load(std::memory_order_relaxed));
+    stats.tables.push_back(std::move(ts));
+  }
+
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
 void BlockchainLMDB::fixup()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
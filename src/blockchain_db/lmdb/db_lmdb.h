@@ -27,11 +27,18 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
+#include <vector>
 
 #include "blockchain_db/blockchain_db.h"
+#include "common/bloom_filter.h"
+#include "common/data_cache.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <lmdb.h>
 
@@ -45,6 +52,31 @@ typedef struct txindex {
     tx_data_t data;
 } txindex;
 
+// a tx_indices record, and the id of the read txn it was read in
+struct cached_tx_index
+{
+  tx_data_t data;
+  uint64_t txn_id;
+};
+
+// a reader walking the chain in height order, as seen by the read-ahead
+struct read_ahead_stream
+{
+  uint64_t id;
+  uint64_t next_height; // where its next read is expected to start
+  uint64_t loaded_to; // heights below this were loaded by the read-ahead
+  uint64_t scheduled_to; // and below this are queued for it
+  uint64_t last_used;
+  unsigned reads;
+};
+
+struct read_ahead_job
+{
+  uint64_t stream_id;
+  uint64_t start_height;
+  uint64_t end_height;
+};
+
 typedef struct mdb_txn_cursors
 {
   MDB_cursor *m_txc_blocks;
@@ -53,6 +85,8 @@ typedef struct mdb_txn_cursors
 
   MDB_cursor *m_txc_output_txs;
   MDB_cursor *m_txc_output_amounts;
+  MDB_cursor *m_txc_output_pubkeys;
+  MDB_cursor *m_txc_view_tags;
 
   MDB_cursor *m_txc_txs;
   MDB_cursor *m_txc_txs_pruned;
@@ -79,6 +113,8 @@ typedef struct mdb_txn_cursors
 #define m_cur_block_info	m_cursors->m_txc_block_info
 #define m_cur_output_txs	m_cursors->m_txc_output_txs
 #define m_cur_output_amounts	m_cursors->m_txc_output_amounts
+#define m_cur_output_pubkeys	m_cursors->m_txc_output_pubkeys
+#define m_cur_view_tags	m_cursors->m_txc_view_tags
 #define m_cur_txs	m_cursors->m_txc_txs
 #define m_cur_txs_pruned	m_cursors->m_txc_txs_pruned
 #define m_cur_txs_prunable	m_cursors->m_txc_txs_prunable
@@ -101,6 +137,8 @@ typedef struct mdb_rflags
   bool m_rf_block_info;
   bool m_rf_output_txs;
   bool m_rf_output_amounts;
+  bool m_rf_output_pubkeys;
+  bool m_rf_view_tags;
   bool m_rf_txs;
   bool m_rf_txs_pruned;
   bool m_rf_txs_prunable;
@@ -125,6 +163,48 @@ typedef struct mdb_threadinfo
   ~mdb_threadinfo();
 } mdb_threadinfo;
 
+// tables with access counters, in the order get_db_stats reports them
+enum mdb_table_id
+{
+  MDB_TABLE_BLOCKS,
+  MDB_TABLE_BLOCK_HEIGHTS,
+  MDB_TABLE_BLOCK_INFO,
+  MDB_TABLE_TXS,
+  MDB_TABLE_TXS_PRUNED,
+  MDB_TABLE_TXS_PRUNABLE,
+  MDB_TABLE_TXS_PRUNABLE_HASH,
+  MDB_TABLE_TXS_PRUNABLE_TIP,
+  MDB_TABLE_TX_INDICES,
+  MDB_TABLE_TX_OUTPUTS,
+  MDB_TABLE_OUTPUT_TXS,
+  MDB_TABLE_OUTPUT_AMOUNTS,
+  MDB_TABLE_OUTPUT_PUBKEYS,
+  MDB_TABLE_VIEW_TAGS,
+  MDB_TABLE_SPENT_KEYS,
+  MDB_TABLE_TXPOOL_META,
+  MDB_TABLE_TXPOOL_BLOB,
+  MDB_TABLE_ALT_BLOCKS,
+  MDB_TABLE_HF_VERSIONS,
+  MDB_TABLE_PROPERTIES,
+  MDB_TABLE_COUNT
+};
+
+// relaxed atomics, these are only ever summed up for display
+struct mdb_table_counters
+{
+  static constexpr size_t LATENCY_BUCKETS = 16;
+
+  std::atomic<uint64_t> gets;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> puts;
+  std::atomic<uint64_t> deletes;
+  std::atomic<uint64_t> bytes_read;
+  std::atomic<uint64_t> bytes_written;
+  std::atomic<uint64_t> get_latency[LATENCY_BUCKETS]; // log2 of microseconds
+
+  mdb_table_counters();
+};
+
 struct mdb_txn_safe
 {
   mdb_txn_safe(const bool check=true);
@@ -218,6 +298,8 @@ public:
 
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const;
 
+  virtual std::vector<uint64_t> get_block_cumulative_rct_outputs_range(uint64_t start_height, uint64_t count) const;
+
   virtual uint64_t get_block_timestamp(const uint64_t& height) const;
 
   virtual uint64_t get_top_block_timestamp() const;
@@ -272,6 +354,7 @@ public:
 
   virtual output_data_t get_output_key(const uint64_t& amount, const uint64_t& index, bool include_commitmemt) const;
   virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) const;
+  virtual void get_output_keys_batch(const std::vector<uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs) const;
 
   virtual tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const;
   virtual void get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices,
@@ -282,7 +365,16 @@ public:
 
   virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_id, size_t n_txes) const;
 
+  virtual bool has_output_pubkey_index() const;
+  virtual bool build_output_pubkey_index();
+  virtual bool get_output_index_by_pubkey(const crypto::public_key &pubkey, uint64_t &amount, uint64_t &amount_index) const;
+
+  virtual bool has_view_tag_index() const;
+  virtual bool build_view_tag_index();
+  virtual void get_blocks_view_tags(uint64_t start_height, size_t count, std::vector<blobdata> &blobs) const;
+
   virtual bool has_key_image(const crypto::key_image& img) const;
+  virtual void have_key_images_batch(const epee::span<const crypto::key_image> &imgs, std::vector<bool> &spent) const;
 
   virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const txpool_tx_meta_t& meta);
   virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta);
@@ -310,6 +402,10 @@ public:
   virtual bool for_all_transactions(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const;
   virtual bool for_all_outputs(std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> f) const;
   virtual bool for_all_outputs(uint64_t amount, const std::function<bool(uint64_t height)> &f) const;
+  virtual bool for_all_key_images_parallel(const std::function<bool(const crypto::key_image&)> &f) const;
+  virtual bool for_blocks_range_parallel(const uint64_t& h1, const uint64_t& h2, const std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> &f) const;
+  virtual bool for_all_transactions_parallel(const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const;
+  virtual bool for_all_outputs_parallel(const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const;
   virtual bool for_all_alt_blocks(std::function<bool(const crypto::hash &blkid, const alt_block_data_t &data, const cryptonote::blobdata_ref *blob)> f, bool include_blob = false) const;
 
   virtual uint64_t add_block( const std::pair<block, blobdata>& blk
@@ -376,6 +472,8 @@ private:
 
   virtual void remove_block();
 
+  virtual void add_block_view_tags(uint64_t height, const blobdata &blob);
+
   virtual uint64_t add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata_ref>& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash);
 
   virtual void remove_transaction_data(const crypto::hash& tx_hash, const transaction& tx);
@@ -395,6 +493,35 @@ private:
 
   void remove_output(const uint64_t amount, const uint64_t& out_index);
 
+  void remove_output_pubkey(const crypto::public_key &pubkey, uint64_t output_id);
+
+  void compress_prunable_data();
+
+  void build_key_image_filter();
+
+  // sequential read-ahead, only running when opened with DBF_READ_AHEAD
+  void start_read_ahead();
+  void stop_read_ahead();
+  void read_ahead_loop();
+  uint64_t read_ahead_range(uint64_t start_height, uint64_t end_height) const;
+  void note_sequential_read(uint64_t start_height, uint64_t end_height) const;
+
+  int get_tx_index(const crypto::hash &h, tx_data_t &td, MDB_txn *m_txn, mdb_txn_cursors *m_cursors) const;
+
+  uint64_t key_image_filter_hash(const crypto::key_image &k_image) const;
+
+  void append_prunable_blob(uint64_t tx_id, const MDB_val &v, cryptonote::blobdata &bd) const;
+
+  // range scans backing both the serial and parallel iterators, a NULL bound is open ended
+  bool for_key_images_range(const crypto::key_image *lo, const crypto::key_image *hi, const std::function<bool(const crypto::key_image&)> &f) const;
+  bool for_transactions_range(const crypto::hash *lo, const crypto::hash *hi, const std::function<bool(const crypto::hash&, const cryptonote::transaction&)> &f, bool pruned) const;
+  bool for_outputs_range(const std::pair<uint64_t, uint64_t> *lo, const std::pair<uint64_t, uint64_t> *hi, const std::function<bool(uint64_t amount, const crypto::hash &tx_hash, uint64_t height, size_t tx_idx)> &f) const;
+
+  // number of ranges a parallel scan should be split into, 1 if it should run serially
+  size_t get_parallel_scan_partitions() const;
+  // runs job(0) .. job(n - 1) on the compute threadpool, each on its own read txn
+  bool run_parallel_scan(size_t n, const std::function<bool(size_t, const std::atomic<bool>&)> &job) const;
+
   virtual void prune_outputs(uint64_t amount);
 
   virtual void add_spent_key(const crypto::key_image& k_image);
@@ -408,6 +535,8 @@ private:
   virtual uint8_t get_hard_fork_version(uint64_t height) const;
   virtual void check_hard_fork_info();
   virtual void drop_hard_fork_info();
+  virtual void set_hard_fork_voting_window(const hard_fork_voting_window &window);
+  virtual bool get_hard_fork_voting_window(hard_fork_voting_window &window) const;
 
   inline void check_open() const;
 
@@ -417,6 +546,8 @@ private:
 
   virtual uint64_t get_database_size() const;
 
+  virtual bool get_db_stats(db_stats &stats) const;
+
   std::vector<uint64_t> get_block_info_64bit_fields(uint64_t start_height, size_t count, off_t offset) const;
 
   uint64_t get_max_block_size();
@@ -445,6 +576,9 @@ private:
 
   void cleanup_batch();
 
+  // applies (committed) or drops the write txn's staged rct column changes
+  void finish_cum_rct_column_txn(bool committed);
+
 private:
   MDB_env* m_env;
 
@@ -462,6 +596,8 @@ private:
 
   MDB_dbi m_output_txs;
   MDB_dbi m_output_amounts;
+  MDB_dbi m_output_pubkeys;
+  MDB_dbi m_view_tags;
 
   MDB_dbi m_spent_keys;
 
@@ -477,6 +613,53 @@ private:
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
+  uint64_t m_size_used_at_resize; // used to grow the map ahead of the write rate
+
+  // bi_cum_rct by height, loaded on first range read and kept up to date by
+  // add_block/remove_block; dropped whenever it stops lining up with them.
+  // Changes made by the write txn are staged, and only applied to the column
+  // once it commits
+  mutable boost::mutex m_cum_rct_column_lock;
+  mutable std::vector<uint64_t> m_cum_rct_column;
+  mutable bool m_cum_rct_column_loaded;
+  uint64_t m_cum_rct_pending_pops; // committed entries removed by the write txn
+  std::vector<uint64_t> m_cum_rct_pending; // entries added by the write txn after those removals
+  bool m_cum_rct_pending_valid; // false if the staged changes no longer line up
+
+  // whether m_output_pubkeys has been built and must be kept up to date
+  bool m_output_pubkeys_indexed;
+  // same for m_view_tags
+  bool m_view_tags_indexed;
+
+  // txs_prunable values for tx ids below this carry a storage tag, and may be
+  // compressed; all of them once it reaches the max uint64_t
+  uint64_t m_prunable_tagged_below;
+
+  mutable mdb_table_counters m_table_counters[MDB_TABLE_COUNT];
+
+  // maybe-spent filter over m_spent_keys, empty unless enabled at open; key
+  // images removed on pop_block stay in it, which is harmless
+  tools::bloom_filter m_key_image_filter;
+  uint64_t m_key_image_filter_salt;
+
+  // tx hash to tx_indices record, filled from read txns only. An entry is
+  // used only by txns at least as recent as the one it was read in, and
+  // none is added from a txn older than the latest removal
+  mutable tools::sharded_lru_cache<crypto::hash, cached_tx_index> m_tx_index_cache;
+  std::atomic<uint64_t> m_tx_index_cache_invalidated_at;
+
+  // readers are matched to streams by the height their next read starts at;
+  // once a stream has read twice in a row, the blocks and txes ahead of it are
+  // paged in by m_read_ahead_thread. Guarded by m_read_ahead_lock
+  mutable boost::mutex m_read_ahead_lock;
+  mutable boost::condition_variable m_read_ahead_cond;
+  mutable std::vector<read_ahead_stream> m_read_ahead_streams;
+  mutable std::deque<read_ahead_job> m_read_ahead_jobs;
+  mutable uint64_t m_read_ahead_next_id;
+  std::atomic<bool> m_read_ahead_enabled;
+  std::atomic<bool> m_read_ahead_stop;
+  boost::thread m_read_ahead_thread;
+
   std::string m_folder;
   mdb_txn_safe* m_write_txn; // may point to either a short-lived txn or a batch txn
   mdb_txn_safe* m_write_batch_txn; // persist batch txn outside of BlockchainLMDB
@@ -36,13 +36,15 @@ namespace cryptonote
     // If a batch exists, it can't be from another thread, since we can
     // only be called with the txpool lock taken, and it is held during
     // the whole prepare/handle/cleanup incoming block sequence.
+    // A txpool kept out of the database does not need the batch at all.
     class LockedTXN {
     public:
-      LockedTXN(BlockchainDB &db): m_db(db), m_batch(false), m_active(false) {
-        m_batch = m_db.batch_start();
+      LockedTXN(BlockchainDB &db, bool needed = true): m_db(db), m_batch(false), m_active(false) {
+        m_batch = needed && m_db.batch_start();
         m_active = true;
       }
-      void commit() { try { if (m_batch && m_active) { m_db.batch_stop(); m_active = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::commit filtering exception: " << e.what()); } }
+      // returns false if the batch failed to commit
+      bool commit() { try { if (m_batch && m_active) { m_db.batch_stop(); m_active = false; } return true; } catch (const std::exception &e) { MWARNING("LockedTXN::commit filtering exception: " << e.what()); return false; } }
       void abort() { try { if (m_batch && m_active) { m_db.batch_abort(); m_active = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::abort filtering exception: " << e.what()); } }
       ~LockedTXN() { abort(); }
     private:
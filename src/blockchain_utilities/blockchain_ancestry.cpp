@@ -53,6 +53,7 @@ using namespace cryptonote;
 static bool stop_requested = false;
 static uint64_t cached_txes = 0, cached_blocks = 0, cached_outputs = 0, total_txes = 0, total_blocks = 0, total_outputs = 0;
 static bool opt_cache_outputs = false, opt_cache_txes = false, opt_cache_blocks = false;
+static uint64_t opt_cache_limit = 0, cached_block_entries = 0;
 
 struct ancestor
 {
@@ -197,12 +198,11 @@ static size_t get_deduplicated_ancestry(const std::unordered_map<ancestor, unsig
 
 static void add_ancestry(std::unordered_map<crypto::hash, std::unordered_set<ancestor>> &ancestry, const crypto::hash &txid, const std::unordered_set<ancestor> &ancestors)
 {
-  std::pair<std::unordered_map<crypto::hash, std::unordered_set<ancestor>>::iterator, bool> p = ancestry.insert(std::make_pair(txid, ancestors));
-  if (!p.second)
-  {
-    for (const auto &e: ancestors)
-      p.first->second.insert(e);
-  }
+  std::unordered_map<crypto::hash, std::unordered_set<ancestor>>::iterator i = ancestry.find(txid);
+  if (i == ancestry.end())
+    ancestry.insert(std::make_pair(txid, ancestors));
+  else
+    i->second.insert(ancestors.begin(), ancestors.end());
 }
 
 static void add_ancestry(std::unordered_map<crypto::hash, std::unordered_set<ancestor>> &ancestry, const crypto::hash &txid, const ancestor &new_ancestor)
@@ -211,18 +211,48 @@ static void add_ancestry(std::unordered_map<crypto::hash, std::unordered_set<anc
   p.first->second.insert(new_ancestor);
 }
 
-static std::unordered_set<ancestor> get_ancestry(const std::unordered_map<crypto::hash, std::unordered_set<ancestor>> &ancestry, const crypto::hash &txid)
+// returns a reference into the map, which stays valid across inserts of other txids, so merging
+// a parent's ancestry does not need a temporary copy of it
+static const std::unordered_set<ancestor> &get_ancestry(const std::unordered_map<crypto::hash, std::unordered_set<ancestor>> &ancestry, const crypto::hash &txid)
 {
+  static const std::unordered_set<ancestor> empty;
   std::unordered_map<crypto::hash, std::unordered_set<ancestor>>::const_iterator i = ancestry.find(txid);
   if (i == ancestry.end())
   {
     //MERROR("txid ancestry not found: " << txid);
     //throw std::runtime_error("txid ancestry not found");
-    return std::unordered_set<ancestor>();
+    return empty;
   }
   return i->second;
 }
 
+// with --cache-limit, a full cache drops half its entries (in no particular order) before
+// taking a new one, so memory stays bounded whatever the range being processed
+template<typename K, typename V>
+static void add_to_cache(std::unordered_map<K, V> &cache, const K &key, const V &value)
+{
+  if (opt_cache_limit && cache.size() >= opt_cache_limit)
+  {
+    size_t n = cache.size() / 2;
+    for (auto i = cache.begin(); i != cache.end() && n > 0; --n)
+      i = cache.erase(i);
+  }
+  cache.insert(std::make_pair(key, value));
+}
+
+static void add_block_to_cache(ancestry_state_t &state, uint64_t height, const cryptonote::block &b)
+{
+  if (opt_cache_limit && cached_block_entries >= opt_cache_limit)
+  {
+    std::vector<cryptonote::block>().swap(state.block_cache);
+    cached_block_entries = 0;
+  }
+  if (state.block_cache.size() <= height)
+    state.block_cache.resize(height + 1);
+  state.block_cache[height] = b;
+  ++cached_block_entries;
+}
+
 static bool get_block_from_height(ancestry_state_t &state, BlockchainDB *db, uint64_t height, cryptonote::block &b)
 {
   ++total_blocks;
@@ -239,10 +269,7 @@ static bool get_block_from_height(ancestry_state_t &state, BlockchainDB *db, uin
     return false;
   }
   if (opt_cache_blocks)
-  {
-    state.block_cache.resize(height + 1);
-    state.block_cache[height] = b;
-  }
+    add_block_to_cache(state, height, b);
   return true;
 }
 
@@ -271,7 +298,7 @@ static bool get_transaction(ancestry_state_t &state, BlockchainDB *db, const cry
   }
   tx_data = ::tx_data_t(tx);
   if (opt_cache_txes)
-    state.tx_cache.insert(std::make_pair(txid, tx_data));
+    add_to_cache(state.tx_cache, txid, tx_data);
   return true;
 }
 
@@ -300,7 +327,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
       {
         txid = cryptonote::get_transaction_hash(b.miner_tx);
         if (opt_cache_outputs)
-          state.output_cache.insert(std::make_pair(ancestor{amount, offset}, txid));
+          add_to_cache(state.output_cache, ancestor{amount, offset}, txid);
         return true;
       }
     }
@@ -322,7 +349,7 @@ static bool get_output_txid(ancestry_state_t &state, BlockchainDB *db, uint64_t
       {
         txid = block_txid;
         if (opt_cache_outputs)
-          state.output_cache.insert(std::make_pair(ancestor{amount, offset}, txid));
+          add_to_cache(state.output_cache, ancestor{amount, offset}, txid);
         return true;
       }
     }
@@ -352,6 +379,7 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<bool> arg_cache_outputs  = {"cache-outputs", "Cache outputs (memory hungry)", false};
   const command_line::arg_descriptor<bool> arg_cache_txes  = {"cache-txes", "Cache txes (memory hungry)", false};
   const command_line::arg_descriptor<bool> arg_cache_blocks  = {"cache-blocks", "Cache blocks (memory hungry)", false};
+  const command_line::arg_descriptor<uint64_t> arg_cache_limit  = {"cache-limit", "Maximum number of entries in each cache (0 for unlimited)", 0};
   const command_line::arg_descriptor<bool> arg_include_coinbase  = {"include-coinbase", "Including coinbase tx in per height average", false};
   const command_line::arg_descriptor<bool> arg_show_cache_stats  = {"show-cache-stats", "Show cache statistics", false};
 
@@ -366,6 +394,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_cache_outputs);
   command_line::add_arg(desc_cmd_sett, arg_cache_txes);
   command_line::add_arg(desc_cmd_sett, arg_cache_blocks);
+  command_line::add_arg(desc_cmd_sett, arg_cache_limit);
   command_line::add_arg(desc_cmd_sett, arg_include_coinbase);
   command_line::add_arg(desc_cmd_sett, arg_show_cache_stats);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
@@ -410,6 +439,7 @@ int main(int argc, char* argv[])
   opt_cache_outputs = command_line::get_arg(vm, arg_cache_outputs);
   opt_cache_txes = command_line::get_arg(vm, arg_cache_txes);
   opt_cache_blocks = command_line::get_arg(vm, arg_cache_blocks);
+  opt_cache_limit = command_line::get_arg(vm, arg_cache_limit);
   bool opt_include_coinbase = command_line::get_arg(vm, arg_include_coinbase);
   bool opt_show_cache_stats = command_line::get_arg(vm, arg_show_cache_stats);
 
@@ -509,7 +539,8 @@ int main(int argc, char* argv[])
   if (opt_refresh)
   {
     MINFO("Starting from height " << state.height);
-    state.block_cache.reserve(db_height);
+    if (opt_cache_blocks && !opt_cache_limit)
+      state.block_cache.reserve(db_height);
     for (uint64_t h = state.height; h < db_height; ++h)
     {
       size_t block_ancestry_size = 0;
@@ -522,10 +553,7 @@ int main(int argc, char* argv[])
         return 1;
       }
       if (opt_cache_blocks)
-      {
-        state.block_cache.resize(h + 1);
-        state.block_cache[h] = b;
-      }
+        add_block_to_cache(state, h, b);
       std::vector<crypto::hash> txids;
       txids.reserve(1 + b.tx_hashes.size());
       if (opt_include_coinbase)
@@ -560,7 +588,7 @@ int main(int argc, char* argv[])
           }
           tx_data = ::tx_data_t(tx);
           if (opt_cache_txes)
-            state.tx_cache.insert(std::make_pair(txid, tx_data));
+            add_to_cache(state.tx_cache, txid, tx_data);
         }
         if (tx_data.coinbase)
         {
@@ -32,6 +32,7 @@
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/command_line.h"
 #include "common/varint.h"
+#include "common/threadpool.h"
 #include "serialization/crypto.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_core/tx_pool.h"
@@ -1599,6 +1600,65 @@ int main(int argc, char* argv[])
     int dbr = resize_env(cache_dir.c_str());
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
 
+    std::vector<output_data> scan_spent = std::move(work_spent);
+    work_spent.clear();
+
+    // the rings of the outputs found spent so far are checked in parallel, each partition with
+    // its own read txn on the state at the start of the pass; outputs found here are only added
+    // afterwards, so a chain reaction within a pass carries over to the next pass instead
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    const size_t n_partitions = std::min<size_t>(scan_spent.size(), std::max(1u, tpool.get_max_concurrency()) * 4);
+    std::vector<std::vector<std::pair<output_data, size_t>>> found(n_partitions);
+    {
+      tools::threadpool::waiter waiter(tpool);
+      for (size_t p = 0; p < n_partitions; ++p)
+      {
+        tpool.submit(&waiter, [&, p](){
+          MDB_txn *rtxn;
+          int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &rtxn);
+          CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+          epee::misc_utils::auto_scope_leave_caller rtxn_dtor = epee::misc_utils::create_scope_leave_handler([&](){mdb_txn_abort(rtxn);});
+          MDB_cursor *rcur;
+          dbr = mdb_cursor_open(rtxn, dbi_spent, &rcur);
+          CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+          for (size_t i = p; i < scan_spent.size(); i += n_partitions)
+          {
+            const output_data &od = scan_spent[i];
+            std::vector<crypto::key_image> key_images = get_key_images(rtxn, od);
+            for (const crypto::key_image &ki: key_images)
+            {
+              std::vector<uint64_t> relative_ring;
+              CHECK_AND_ASSERT_THROW_MES(get_relative_ring(rtxn, ki, relative_ring), "Relative ring not found");
+              std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
+              size_t known = 0;
+              uint64_t last_unknown = 0;
+              for (uint64_t out: absolute)
+              {
+                output_data new_od(od.amount, out);
+                if (is_output_spent(rcur, new_od))
+                  ++known;
+                else
+                  last_unknown = out;
+              }
+              if (known == absolute.size() - 1)
+                found[p].push_back(std::make_pair(output_data(od.amount, last_unknown), absolute.size()));
+            }
+            if (stop_requested)
+              break;
+          }
+          mdb_cursor_close(rcur);
+        }, true);
+      }
+      CHECK_AND_ASSERT_THROW_MES(waiter.wait(), "Failed to check rings of spent outputs");
+    }
+
+    if (stop_requested)
+    {
+      MINFO("Stopping secondary passes. Secondary passes are not incremental, they will re-run fully.");
+      return 0;
+    }
+
     MDB_txn *txn;
     dbr = mdb_txn_begin(env, NULL, 0, &txn);
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
@@ -1607,45 +1667,23 @@ int main(int argc, char* argv[])
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
 
     std::vector<std::pair<uint64_t, uint64_t>> blackballs;
-    std::vector<output_data> scan_spent = std::move(work_spent);
-    work_spent.clear();
-    for (const output_data &od: scan_spent)
+    for (const auto &partition: found)
     {
-      std::vector<crypto::key_image> key_images = get_key_images(txn, od);
-      for (const crypto::key_image &ki: key_images)
+      for (const auto &e: partition)
       {
-        std::vector<uint64_t> relative_ring;
-        CHECK_AND_ASSERT_THROW_MES(get_relative_ring(txn, ki, relative_ring), "Relative ring not found");
-        std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_ring);
-        size_t known = 0;
-        uint64_t last_unknown = 0;
-        for (uint64_t out: absolute)
-        {
-          output_data new_od(od.amount, out);
-          if (is_output_spent(cur, new_od))
-            ++known;
-          else
-            last_unknown = out;
-        }
-        if (known == absolute.size() - 1)
+        const output_data &od = e.first;
+        // several rings may have pointed at the same output
+        if (!add_spent_output(cur, od))
+          continue;
+        const std::pair<uint64_t, uint64_t> output = std::make_pair(od.amount, od.offset);
+        if (opt_verbose)
         {
-          const std::pair<uint64_t, uint64_t> output = std::make_pair(od.amount, last_unknown);
-          if (opt_verbose)
-          {
-            MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
-                absolute.size() << "-ring where all other outputs are known to be spent");
-          }
-          blackballs.push_back(output);
-          if (add_spent_output(cur, output_data(od.amount, last_unknown)))
-            inc_stat(txn, od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
-          work_spent.push_back(output_data(od.amount, last_unknown));
+          MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a " <<
+              e.second << "-ring where all other outputs are known to be spent");
         }
-      }
-
-      if (stop_requested)
-      {
-        MINFO("Stopping secondary passes. Secondary passes are not incremental, they will re-run fully.");
-        return 0;
+        blackballs.push_back(output);
+        inc_stat(txn, od.amount ? "pre-rct-chain-reaction" : "rct-chain-reaction");
+        work_spent.push_back(od);
       }
     }
     if (!blackballs.empty())
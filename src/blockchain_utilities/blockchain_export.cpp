@@ -28,6 +28,7 @@
 
 #include "bootstrap_file.h"
 #include "blocksdat_file.h"
+#include "snapshot_file.h"
 #include "common/command_line.h"
 #include "cryptonote_core/tx_pool.h"
 #include "cryptonote_core/cryptonote_core.h"
@@ -62,6 +63,9 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<uint64_t> arg_block_start = {"block-start", "Start at block number", block_start};
   const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
   const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+  const command_line::arg_descriptor<bool> arg_snapshot = {"snapshot", "Output a database snapshot at a checkpoint to the output directory", false};
+  const command_line::arg_descriptor<uint64_t> arg_snapshot_height = {"snapshot-height", "Snapshot at the highest checkpoint at or below this height, 0 for the highest one", 0};
+  const command_line::arg_descriptor<bool> arg_dns_checkpoints = {"dns-checkpoints", "Also use DNS checkpoints for snapshots", false};
 
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
@@ -72,6 +76,9 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_block_start);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
   command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+  command_line::add_arg(desc_cmd_sett, arg_snapshot);
+  command_line::add_arg(desc_cmd_sett, arg_snapshot_height);
+  command_line::add_arg(desc_cmd_sett, arg_dns_checkpoints);
 
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -118,12 +125,26 @@ int main(int argc, char* argv[])
 
   m_config_folder = command_line::get_arg(vm, cryptonote::arg_data_dir);
 
+  const bool opt_snapshot = command_line::get_arg(vm, arg_snapshot);
   if (command_line::has_arg(vm, arg_output_file))
     output_file_path = boost::filesystem::path(command_line::get_arg(vm, arg_output_file));
   else
-    output_file_path = boost::filesystem::path(m_config_folder) / "export" / BLOCKCHAIN_RAW;
+    output_file_path = boost::filesystem::path(m_config_folder) / "export" / (opt_snapshot ? "snapshot" : BLOCKCHAIN_RAW);
   LOG_PRINT_L0("Export output file: " << output_file_path.string());
 
+  if (opt_snapshot)
+  {
+    // works on the LMDB environment directly, a Blockchain would hold it open
+    std::unique_ptr<BlockchainDB> db(new_db());
+    const boost::filesystem::path db_path = boost::filesystem::path(m_config_folder) / db->get_db_name();
+    SnapshotFile snapshot;
+    r = snapshot.store_snapshot(db_path, output_file_path, opt_testnet ? cryptonote::TESTNET : opt_stagenet ? cryptonote::STAGENET : cryptonote::MAINNET,
+        command_line::get_arg(vm, arg_snapshot_height), command_line::get_arg(vm, arg_dns_checkpoints));
+    CHECK_AND_ASSERT_MES(r, 1, "Failed to export snapshot");
+    LOG_PRINT_L0("Snapshot exported OK");
+    return 0;
+  }
+
   // If we wanted to use the memory pool, we would set up a fake_core.
 
   // Use Blockchain instead of lower-level BlockchainDB for two reasons:
@@ -155,7 +176,8 @@ int main(int argc, char* argv[])
   LOG_PRINT_L0("Loading blockchain from folder " << filename << " ...");
   try
   {
-    db->open(filename, DBF_RDONLY);
+    // the export reads every block in order
+    db->open(filename, DBF_RDONLY | DBF_READ_AHEAD);
   }
   catch (const std::exception& e)
   {
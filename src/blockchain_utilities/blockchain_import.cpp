@@ -27,9 +27,11 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <atomic>
+#include <cmath>
 #include <cstdio>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
@@ -37,11 +39,14 @@
 #include "misc_log_ex.h"
 #include "bootstrap_file.h"
 #include "bootstrap_serialization.h"
+#include "snapshot_file.h"
 #include "blocks/blocks.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
 #include "include_base_utils.h"
+#include "common/threadpool.h"
+#include "common/perf_timer.h"
 #include "cryptonote_core/cryptonote_core.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -218,6 +223,89 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
   return 0;
 }
 
+bool parse_block_package(const std::string &chunk, uint8_t major_version, bootstrap::block_package &bp)
+{
+  if (major_version == 0)
+  {
+    bootstrap::block_package_1 bp1;
+    if (!::serialization::parse_binary(chunk, bp1))
+      return false;
+    bp.block = std::move(bp1.block);
+    bp.txs = std::move(bp1.txs);
+    bp.block_weight = bp1.block_weight;
+    bp.cumulative_difficulty = bp1.cumulative_difficulty;
+    bp.coins_generated = bp1.coins_generated;
+    return true;
+  }
+  return ::serialization::parse_binary(chunk, bp);
+}
+
+bool decode_chunk(const std::string &chunk, uint8_t major_version, block_complete_entry &bce)
+{
+  try
+  {
+    bootstrap::block_package bp;
+    if (!parse_block_package(chunk, major_version, bp))
+      return false;
+    bce.pruned = false;
+    bce.block = cryptonote::block_to_blob(bp.block);
+    bce.txs.clear();
+    bce.txs.reserve(bp.txs.size());
+    for (const auto &tx: bp.txs)
+    {
+      bce.txs.push_back({cryptonote::blobdata(), crypto::null_hash});
+      cryptonote::tx_to_blob(tx, bce.txs.back().blob);
+    }
+    return true;
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to decode bootstrap chunk: " << e.what());
+    return false;
+  }
+}
+
+// Deserializing chunks and turning them back into blobs is single threaded
+// work that used to dominate verified imports, so a span of raw chunks is
+// decoded on the compute threadpool before being handed to core in order.
+int decode_and_verify(cryptonote::core &core, std::vector<std::string> &raw_chunks, uint8_t major_version, std::vector<block_complete_entry> &blocks)
+{
+  if (raw_chunks.empty())
+    return 0;
+
+  std::vector<block_complete_entry> entries(raw_chunks.size());
+  std::vector<char> decoded(raw_chunks.size(), 0);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const size_t per_thread = (raw_chunks.size() + threads - 1) / threads;
+  for (size_t start = 0; start < raw_chunks.size(); start += per_thread)
+  {
+    const size_t end = std::min(start + per_thread, raw_chunks.size());
+    tpool.submit(&waiter, [&raw_chunks, &entries, &decoded, major_version, start, end]() {
+      for (size_t i = start; i < end; ++i)
+        decoded[i] = decode_chunk(raw_chunks[i], major_version, entries[i]);
+    }, true);
+  }
+  if (!waiter.wait())
+    return 1;
+  raw_chunks.clear();
+
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    if (!decoded[i])
+    {
+      MFATAL("Error in deserialization of chunk");
+      return 1;
+    }
+    blocks.push_back(std::move(entries[i]));
+    int ret = check_flush(core, blocks, false);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
 int import_from_file(cryptonote::core& core, const std::string& import_file_path, uint64_t block_stop=0)
 {
   // Reset stats, in case we're using newly created db, accumulating stats
@@ -297,6 +385,7 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   std::cout << ENDL;
 
   std::vector<block_complete_entry> blocks;
+  std::vector<std::string> raw_chunks;
 
   // Skip to start_height before we start adding.
   {
@@ -385,27 +474,31 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
       break;
     }
 
+    if (opt_verify)
+    {
+      // decoded in parallel once a whole span is read, see decode_and_verify
+      raw_chunks.emplace_back(buffer_block, chunk_size);
+      ++h;
+      ++num_imported;
+      if ((h-1) % 10 == 0)
+      {
+        std::cout << refresh_string << "block " << h-1
+          << " / " << block_stop
+          << "\r" << std::flush;
+      }
+      if (raw_chunks.size() >= db_batch_size && decode_and_verify(core, raw_chunks, major_version, blocks))
+      {
+        quit = 2; // make sure we don't commit partial block data
+        break;
+      }
+      continue;
+    }
+
     try
     {
       str1.assign(buffer_block, chunk_size);
       bootstrap::block_package bp;
-      bool res;
-      if (major_version == 0)
-      {
-        bootstrap::block_package_1 bp1;
-        res = ::serialization::parse_binary(str1, bp1);
-        if (res)
-        {
-          bp.block = std::move(bp1.block);
-          bp.txs = std::move(bp1.txs);
-          bp.block_weight = bp1.block_weight;
-          bp.cumulative_difficulty = bp1.cumulative_difficulty;
-          bp.coins_generated = bp1.coins_generated;
-        }
-      }
-      else
-        res = ::serialization::parse_binary(str1, bp);
-      if (!res)
+      if (!parse_block_package(str1, major_version, bp))
         throw std::runtime_error("Error in deserialization of chunk");
 
       int display_interval = 1000;
@@ -433,29 +526,6 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
             << "\r" << std::flush;
         }
 
-        if (opt_verify)
-        {
-          cryptonote::blobdata block;
-          cryptonote::block_to_blob(bp.block, block);
-          std::vector<tx_blob_entry> txs;
-          for (const auto &tx: bp.txs)
-          {
-            txs.push_back({cryptonote::blobdata(), crypto::null_hash});
-            cryptonote::tx_to_blob(tx, txs.back().blob);
-          }
-          block_complete_entry bce;
-          bce.pruned = false;
-          bce.block = std::move(block);
-          bce.txs = std::move(txs);
-          blocks.push_back(bce);
-          int ret = check_flush(core, blocks, false);
-          if (ret)
-          {
-            quit = 2; // make sure we don't commit partial block data
-            break;
-          }
-        }
-        else
         {
           std::vector<std::pair<transaction, blobdata>> txs;
           std::vector<transaction> archived_txs;
@@ -533,7 +603,10 @@ quitting:
 
   if (opt_verify)
   {
-    int ret = check_flush(core, blocks, true);
+    int ret = quit > 1 ? 0 : decode_and_verify(core, raw_chunks, major_version, blocks);
+    if (ret)
+      return ret;
+    ret = check_flush(core, blocks, true);
     if (ret)
       return ret;
   }
@@ -561,6 +634,203 @@ quitting:
   return 0;
 }
 
+// Benchmark mode: replays the same bootstrap segment into a fresh database
+// several times, and optionally compares the throughput against the samples
+// saved by an earlier run with Welch's t-test
+struct benchmark_sample
+{
+  double seconds;
+  uint64_t blocks;
+  uint64_t txs;
+  cryptonote::Blockchain::import_stage_times_t stages;
+
+  double blocks_per_second() const { return seconds > 0 ? blocks / seconds : 0.0; }
+  double txs_per_second() const { return seconds > 0 ? txs / seconds : 0.0; }
+};
+
+struct sample_stats
+{
+  size_t n;
+  double mean, variance;
+};
+
+sample_stats get_sample_stats(const std::vector<double> &v)
+{
+  sample_stats s{v.size(), 0.0, 0.0};
+  if (v.empty())
+    return s;
+  for (double x: v)
+    s.mean += x;
+  s.mean /= v.size();
+  if (v.size() > 1)
+  {
+    for (double x: v)
+      s.variance += (x - s.mean) * (x - s.mean);
+    s.variance /= v.size() - 1;
+  }
+  return s;
+}
+
+// two sided 95% critical values of the t distribution, for 1 to 30 degrees of freedom
+double t_critical_95(double df)
+{
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  const size_t idx = df < 1 ? 0 : (size_t)df - 1;
+  return idx < sizeof(table) / sizeof(table[0]) ? table[idx] : 1.960;
+}
+
+// returns true if current is significantly lower than baseline
+bool is_significant_regression(const sample_stats &baseline, const sample_stats &current, double &t)
+{
+  t = 0.0;
+  if (baseline.n < 2 || current.n < 2)
+    return false;
+  const double vb = baseline.variance / baseline.n, vc = current.variance / current.n;
+  if (vb + vc <= 0.0)
+    return current.mean < baseline.mean;
+  t = (current.mean - baseline.mean) / std::sqrt(vb + vc);
+  const double df = (vb + vc) * (vb + vc) / (vb * vb / (baseline.n - 1) + vc * vc / (current.n - 1));
+  return t < -t_critical_95(df);
+}
+
+bool load_benchmark_samples(const std::string &path, std::vector<double> &blocks_per_second, std::vector<double> &txs_per_second)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+    double bps, tps;
+    std::istringstream iss(line);
+    if (!(iss >> bps >> tps))
+      return false;
+    blocks_per_second.push_back(bps);
+    txs_per_second.push_back(tps);
+  }
+  return true;
+}
+
+bool save_benchmark_samples(const std::string &path, const std::vector<benchmark_sample> &samples)
+{
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  out << "# blocks/s txs/s" << std::endl;
+  for (const auto &s: samples)
+    out << s.blocks_per_second() << " " << s.txs_per_second() << std::endl;
+  return out.good();
+}
+
+int run_import_benchmark(po::variables_map vm, const std::string &import_file_path, uint64_t block_stop, uint64_t runs,
+    const std::string &baseline_path, const std::string &save_path)
+{
+#if defined(PER_BLOCK_CHECKPOINT)
+  const GetCheckpointsCallback& get_checkpoints = blocks::GetCheckpointsData;
+#else
+  const GetCheckpointsCallback& get_checkpoints = nullptr;
+#endif
+
+  std::vector<benchmark_sample> samples;
+  for (uint64_t run = 0; run < runs; ++run)
+  {
+    boost::system::error_code ec;
+    const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("monero-import-benchmark-%%%%-%%%%-%%%%");
+    if (!boost::filesystem::create_directories(dir, ec))
+    {
+      MFATAL("Failed to create benchmark data directory " << dir << ": " << ec.message());
+      return 1;
+    }
+    vm.erase(cryptonote::arg_data_dir.name);
+    vm.insert(std::make_pair(std::string(cryptonote::arg_data_dir.name), po::variable_value(boost::any(dir.string()), false)));
+
+    benchmark_sample sample;
+    bool success = false;
+    {
+      cryptonote::cryptonote_protocol_stub pr;
+      cryptonote::core core(&pr);
+      core.disable_dns_checkpoints(true);
+      if (core.init(vm, nullptr, get_checkpoints))
+      {
+        core.get_blockchain_storage().get_db().set_batch_transactions(true);
+        const uint64_t start_height = core.get_blockchain_storage().get_current_blockchain_height();
+        const uint64_t start_txs = core.get_blockchain_storage().get_db().get_tx_count();
+        const uint64_t t0 = epee::misc_utils::get_ns_count();
+        success = import_from_file(core, import_file_path, block_stop) == 0;
+        sample.seconds = (epee::misc_utils::get_ns_count() - t0) / 1e9;
+        const uint64_t height = core.get_blockchain_storage().get_current_blockchain_height();
+        sample.blocks = height - start_height;
+        // do not count the miner txes
+        sample.txs = core.get_blockchain_storage().get_db().get_tx_count() - start_txs - sample.blocks;
+        sample.stages = core.get_blockchain_storage().get_import_stage_totals();
+        core.deinit();
+      }
+      else
+      {
+        MFATAL("Failed to initialize core");
+      }
+    }
+    boost::filesystem::remove_all(dir, ec);
+    if (!success || sample.blocks == 0)
+    {
+      MFATAL("Benchmark run " << run + 1 << " failed");
+      return 1;
+    }
+    MINFO("Benchmark run " << run + 1 << "/" << runs << ": " << sample.blocks << " blocks, " << sample.txs << " txes in " << sample.seconds
+        << " s (" << sample.blocks_per_second() << " blocks/s, " << sample.txs_per_second() << " txs/s), stages: prefetch " << sample.stages.prefetch
+        << " ms, pow " << sample.stages.pow << " ms, scan " << sample.stages.scan << " ms, verify " << sample.stages.verify
+        << " ms, add " << sample.stages.add << " ms, commit " << sample.stages.commit << " ms");
+    samples.push_back(sample);
+  }
+
+  std::vector<double> bps, tps;
+  for (const auto &s: samples)
+  {
+    bps.push_back(s.blocks_per_second());
+    tps.push_back(s.txs_per_second());
+  }
+  const sample_stats bps_stats = get_sample_stats(bps), tps_stats = get_sample_stats(tps);
+  std::cout << "blocks/s: mean " << bps_stats.mean << ", stddev " << std::sqrt(bps_stats.variance) << ", min " << *std::min_element(bps.begin(), bps.end()) << ENDL;
+  std::cout << "txs/s:    mean " << tps_stats.mean << ", stddev " << std::sqrt(tps_stats.variance) << ", min " << *std::min_element(tps.begin(), tps.end()) << ENDL;
+  for (const auto &site: tools::get_aggregate_performance_stats())
+    std::cout << "  " << site.name << ": " << site.count << " calls, median " << site.median_ns / 1000 << " us, p99 " << site.p99_ns / 1000 << " us" << ENDL;
+
+  if (!save_path.empty() && !save_benchmark_samples(save_path, samples))
+  {
+    MERROR("Failed to save benchmark samples to " << save_path);
+    return 1;
+  }
+
+  if (!baseline_path.empty())
+  {
+    std::vector<double> baseline_bps, baseline_tps;
+    if (!load_benchmark_samples(baseline_path, baseline_bps, baseline_tps))
+    {
+      MERROR("Failed to load benchmark baseline from " << baseline_path);
+      return 1;
+    }
+    const sample_stats baseline_bps_stats = get_sample_stats(baseline_bps), baseline_tps_stats = get_sample_stats(baseline_tps);
+    double t_bps, t_tps;
+    const bool bps_regression = is_significant_regression(baseline_bps_stats, bps_stats, t_bps);
+    const bool tps_regression = is_significant_regression(baseline_tps_stats, tps_stats, t_tps);
+    std::cout << "baseline blocks/s: mean " << baseline_bps_stats.mean << " (" << baseline_bps_stats.n << " runs), t = " << t_bps << ENDL;
+    std::cout << "baseline txs/s:    mean " << baseline_tps_stats.mean << " (" << baseline_tps_stats.n << " runs), t = " << t_tps << ENDL;
+    if (bps_regression || tps_regression)
+    {
+      MERROR("Import throughput is significantly lower than the baseline");
+      return 2;
+    }
+    std::cout << "No significant regression against the baseline" << ENDL;
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   TRY_ENTRY();
@@ -596,6 +866,14 @@ int main(int argc, char* argv[])
     "Batch transactions for faster import", true};
   const command_line::arg_descriptor<bool> arg_resume =  {"resume",
     "Resume from current height if output database already exists", true};
+  const command_line::arg_descriptor<std::string> arg_snapshot = {"snapshot", "Create the database from a snapshot directory written by blockchain-export --snapshot", ""};
+  const command_line::arg_descriptor<bool> arg_dns_checkpoints = {"dns-checkpoints", "Also use DNS checkpoints to verify snapshots", false};
+  const command_line::arg_descriptor<uint64_t> arg_benchmark_runs = {"benchmark-runs",
+    "Import the input file this many times into fresh temporary databases and report throughput", 0};
+  const command_line::arg_descriptor<std::string> arg_benchmark_baseline = {"benchmark-baseline",
+    "Compare benchmark throughput against samples saved with --benchmark-save", ""};
+  const command_line::arg_descriptor<std::string> arg_benchmark_save = {"benchmark-save",
+    "Save benchmark samples to this file", ""};
 
   command_line::add_arg(desc_cmd_sett, arg_input_file);
   command_line::add_arg(desc_cmd_sett, arg_log_level);
@@ -605,6 +883,11 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_only, arg_count_blocks);
   command_line::add_arg(desc_cmd_only, arg_pop_blocks);
   command_line::add_arg(desc_cmd_only, arg_drop_hf);
+  command_line::add_arg(desc_cmd_only, arg_snapshot);
+  command_line::add_arg(desc_cmd_only, arg_dns_checkpoints);
+  command_line::add_arg(desc_cmd_only, arg_benchmark_runs);
+  command_line::add_arg(desc_cmd_only, arg_benchmark_baseline);
+  command_line::add_arg(desc_cmd_only, arg_benchmark_save);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
   // call add_options() directly for these arguments since
@@ -698,6 +981,19 @@ int main(int argc, char* argv[])
     return 0;
   }
 
+  if (!command_line::is_arg_defaulted(vm, arg_snapshot))
+  {
+    std::unique_ptr<BlockchainDB> db(new_db());
+    const boost::filesystem::path db_path = boost::filesystem::path(m_config_folder) / db->get_db_name();
+    MINFO("snapshot path: " << command_line::get_arg(vm, arg_snapshot));
+    MINFO("database path: " << db_path.string());
+    SnapshotFile snapshot;
+    if (!snapshot.load_snapshot(command_line::get_arg(vm, arg_snapshot), db_path, opt_testnet ? cryptonote::TESTNET : opt_stagenet ? cryptonote::STAGENET : cryptonote::MAINNET,
+        command_line::get_arg(vm, arg_dns_checkpoints)))
+      return 1;
+    return 0;
+  }
+
   MINFO("database: LMDB");
   MINFO("verify:  " << std::boolalpha << opt_verify << std::noboolalpha);
   if (opt_batch)
@@ -727,6 +1023,12 @@ int main(int argc, char* argv[])
     sleep(90);
   }
 
+  if (!command_line::is_arg_defaulted(vm, arg_benchmark_runs))
+  {
+    return run_import_benchmark(vm, import_file_path, block_stop, command_line::get_arg(vm, arg_benchmark_runs),
+        command_line::get_arg(vm, arg_benchmark_baseline), command_line::get_arg(vm, arg_benchmark_save));
+  }
+
   cryptonote::cryptonote_protocol_stub pr; //TODO: stub only for this kind of test, make real validation of relayed objects
   cryptonote::core core(&pr);
 
@@ -57,6 +57,10 @@ static const size_t slack = 512 * 1024 * 1024;
 
 static std::vector<bool> is_v1;
 
+// set when carrying on from an interrupted run, tables are then appended to rather than emptied
+static bool resume_copy = false;
+static const char resume_marker_key[] = "prune_copy_source_height";
+
 static std::error_code replace_file(const boost::filesystem::path& replacement_name, const boost::filesystem::path& replaced_name)
 {
   std::error_code ec = tools::replace_file(replacement_name.string(), replaced_name.string());
@@ -91,6 +95,60 @@ static void close(MDB_env *env)
   mdb_env_close(env);
 }
 
+static bool get_property(MDB_env *env, const char *key, uint64_t &value)
+{
+  MDB_txn *txn;
+  MDB_dbi dbi;
+  int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){ mdb_txn_abort(txn); });
+  dbr = mdb_dbi_open(txn, "properties", 0, &dbi);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  mdb_set_compare(txn, dbi, BlockchainLMDB::compare_string);
+  MDB_val k = {strlen(key) + 1, (void*)key}, v;
+  dbr = mdb_get(txn, dbi, &k, &v);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  if (dbr) throw std::runtime_error("Failed to read property: " + std::string(mdb_strerror(dbr)));
+  if (v.mv_size != sizeof(value))
+    return false;
+  memcpy(&value, v.mv_data, sizeof(value));
+  return true;
+}
+
+static void set_property(MDB_env *env, const char *key, const uint64_t *value)
+{
+  MDB_txn *txn;
+  MDB_dbi dbi;
+  int dbr = mdb_txn_begin(env, NULL, 0, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  bool tx_active = true;
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    if (tx_active) mdb_txn_abort(txn);
+  });
+  dbr = mdb_dbi_open(txn, "properties", 0, &dbi);
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  mdb_set_compare(txn, dbi, BlockchainLMDB::compare_string);
+  MDB_val k = {strlen(key) + 1, (void*)key};
+  if (value)
+  {
+    MDB_val v = {sizeof(*value), (void*)value};
+    dbr = mdb_put(txn, dbi, &k, &v, 0);
+  }
+  else
+  {
+    dbr = mdb_del(txn, dbi, &k, NULL);
+    if (dbr == MDB_NOTFOUND)
+      dbr = 0;
+  }
+  if (dbr) throw std::runtime_error("Failed to write property: " + std::string(mdb_strerror(dbr)));
+  dbr = mdb_txn_commit(txn);
+  tx_active = false;
+  if (dbr) throw std::runtime_error("Failed to commit txn: " + std::string(mdb_strerror(dbr)));
+}
+
 static void mark_v1_tx(const MDB_val &k, const MDB_val &v)
 {
   const uint64_t tx_id = *(const uint64_t*)k.mv_data;
@@ -203,8 +261,11 @@ static void copy_table(MDB_env *env0, MDB_env *env1, const char *table, unsigned
   if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
   tx_active1 = true;
 
-  dbr = mdb_drop(txn1, dbi1, 0);
-  if (dbr) throw std::runtime_error("Failed to empty " + std::string(table) + " LMDB table: " + std::string(mdb_strerror(dbr)));
+  if (!resume_copy)
+  {
+    dbr = mdb_drop(txn1, dbi1, 0);
+    if (dbr) throw std::runtime_error("Failed to empty " + std::string(table) + " LMDB table: " + std::string(mdb_strerror(dbr)));
+  }
 
   dbr = mdb_cursor_open(txn0, dbi0, &cur0);
   if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
@@ -220,6 +281,37 @@ static void copy_table(MDB_env *env0, MDB_env *env1, const char *table, unsigned
   MDB_val v;
   MDB_cursor_op op = MDB_FIRST;
   size_t nrecords = 0, bytes = 0;
+
+  if (resume_copy)
+  {
+    // records already copied are not seen again below, so replay them to the hook
+    size_t ncopied = 0;
+    MDB_cursor_op op1 = MDB_FIRST;
+    while (f)
+    {
+      int ret = mdb_cursor_get(cur1, &k, &v, op1);
+      op1 = MDB_NEXT;
+      if (ret == MDB_NOTFOUND)
+        break;
+      if (ret)
+        throw std::runtime_error("Failed to enumerate copied " + std::string(table) + " records: " + std::string(mdb_strerror(ret)));
+      (*f)(k, v);
+      ++ncopied;
+    }
+
+    // carry on after the last record the interrupted run committed
+    int ret = mdb_cursor_get(cur1, &k, &v, MDB_LAST);
+    if (ret == 0)
+    {
+      ret = mdb_cursor_get(cur0, &k, &v, (flags & MDB_DUPSORT) ? MDB_GET_BOTH : MDB_SET);
+      if (ret)
+        throw std::runtime_error("Failed to find last copied " + std::string(table) + " record in the source: " + std::string(mdb_strerror(ret)));
+      op = MDB_NEXT;
+      MINFO("Resuming copy of " << table << (f ? " after " + std::to_string(ncopied) + " records" : ""));
+    }
+    else if (ret != MDB_NOTFOUND)
+      throw std::runtime_error("Failed to find last copied " + std::string(table) + " record: " + std::string(mdb_strerror(ret)));
+  }
   while (1)
   {
     int ret = mdb_cursor_get(cur0, &k, &v, op);
@@ -255,7 +347,7 @@ static void copy_table(MDB_env *env0, MDB_env *env1, const char *table, unsigned
   mdb_dbi_close(env0, dbi0);
 }
 
-static void prune(MDB_env *env0, MDB_env *env1)
+static void prune(MDB_env *env0, MDB_env *env1, uint32_t stripe)
 {
   MDB_dbi dbi0_blocks, dbi0_txs_pruned, dbi0_txs_prunable, dbi0_tx_indices, dbi1_txs_prunable, dbi1_txs_prunable_tip, dbi1_properties;
   MDB_txn *txn0, *txn1;
@@ -316,7 +408,7 @@ static void prune(MDB_env *env0, MDB_env *env1)
   if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
 
   MDB_val k, v;
-  uint32_t pruning_seed = tools::make_pruning_seed(tools::get_random_stripe(), CRYPTONOTE_PRUNING_LOG_STRIPES);
+  uint32_t pruning_seed = tools::make_pruning_seed(stripe, CRYPTONOTE_PRUNING_LOG_STRIPES);
   static char pruning_seed_key[] = "pruning_seed";
   k.mv_data = pruning_seed_key;
   k.mv_size = strlen("pruning_seed") + 1;
@@ -503,6 +595,9 @@ int main(int argc, char* argv[])
   , "fast:" + std::to_string(records_per_sync)
   };
   const command_line::arg_descriptor<bool> arg_copy_pruned_database  = {"copy-pruned-database",  "Copy database anyway if already pruned"};
+  const command_line::arg_descriptor<bool> arg_in_place  = {"in-place",  "Prune the database in place instead of making a pruned copy, needs no extra disk space"};
+  const command_line::arg_descriptor<uint32_t> arg_pruning_stripe  = {"pruning-stripe",  "Stripe of prunable data to keep (1-8), random if 0", 0};
+  const command_line::arg_descriptor<std::string> arg_output_data_dir  = {"output-data-dir",  "Write the pruned copy to this data directory for another node, leaving the source in place", ""};
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
@@ -510,6 +605,9 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_log_level);
   command_line::add_arg(desc_cmd_sett, arg_db_sync_mode);
   command_line::add_arg(desc_cmd_sett, arg_copy_pruned_database);
+  command_line::add_arg(desc_cmd_sett, arg_in_place);
+  command_line::add_arg(desc_cmd_sett, arg_pruning_stripe);
+  command_line::add_arg(desc_cmd_sett, arg_output_data_dir);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
   po::options_description desc_options("Allowed options");
@@ -545,9 +643,22 @@ int main(int argc, char* argv[])
   bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
   network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
   bool opt_copy_pruned_database = command_line::get_arg(vm, arg_copy_pruned_database);
+  bool opt_in_place = command_line::get_arg(vm, arg_in_place);
   std::string data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
   while (boost::ends_with(data_dir, "/") || boost::ends_with(data_dir, "\\"))
     data_dir.pop_back();
+  uint32_t opt_pruning_stripe = command_line::get_arg(vm, arg_pruning_stripe);
+  if (opt_pruning_stripe > (1u << CRYPTONOTE_PRUNING_LOG_STRIPES))
+  {
+    MERROR("Invalid pruning stripe: " << opt_pruning_stripe);
+    return 1;
+  }
+  const std::string opt_output_data_dir = command_line::get_arg(vm, arg_output_data_dir);
+  if (opt_in_place && (opt_pruning_stripe || !opt_output_data_dir.empty()))
+  {
+    MERROR("--" << arg_in_place.name << " cannot be used with --" << arg_pruning_stripe.name << " or --" << arg_output_data_dir.name);
+    return 1;
+  }
 
   std::string db_sync_mode = command_line::get_arg(vm, arg_db_sync_mode);
   uint64_t db_flags = 0;
@@ -574,6 +685,40 @@ int main(int argc, char* argv[])
   tx_memory_pool m_mempool(*blockchain);
   boost::filesystem::path paths[2];
   bool already_pruned = false;
+  uint64_t source_height = 0;
+
+  if (opt_in_place)
+  {
+    // the stripe logic and bounded write batches of the daemon's own pruning
+    // apply here, and an interrupted run picks up where it left off
+    core_storage[0].reset(new Blockchain(m_mempool));
+    BlockchainDB* db = new_db();
+    if (db == NULL)
+    {
+      MERROR("Failed to initialize a database");
+      return 1;
+    }
+    paths[0] = boost::filesystem::path(data_dir) / db->get_db_name();
+    MINFO("Pruning blockchain in place in folder " << paths[0] << " ...");
+    try
+    {
+      db->open(paths[0].string(), db_flags);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Error opening database: " << e.what());
+      return 1;
+    }
+    r = core_storage[0]->init(db, net_type);
+    CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize blockchain storage");
+    r = core_storage[0]->prune_blockchain();
+    core_storage[0]->deinit();
+    core_storage[0].reset(NULL);
+    CHECK_AND_ASSERT_MES(r, 1, "Failed to prune blockchain");
+    MINFO("Blockchain pruned OK");
+    return 0;
+  }
+
   for (size_t n = 0; n < core_storage.size(); ++n)
   {
     core_storage[n].reset(new Blockchain(m_mempool));
@@ -587,7 +732,10 @@ int main(int argc, char* argv[])
 
     if (n == 1)
     {
-      paths[1] = boost::filesystem::path(data_dir) / (db->get_db_name() + "-pruned");
+      if (opt_output_data_dir.empty())
+        paths[1] = boost::filesystem::path(data_dir) / (db->get_db_name() + "-pruned");
+      else
+        paths[1] = boost::filesystem::path(opt_output_data_dir) / db->get_db_name();
       if (boost::filesystem::exists(paths[1]))
       {
         if (!boost::filesystem::is_directory(paths[1]))
@@ -595,6 +743,23 @@ int main(int argc, char* argv[])
           MERROR("LMDB needs a directory path, but a file was passed: " << paths[1].string());
           return 1;
         }
+
+        // a previous run may have left a partial copy of this same source behind
+        if (boost::filesystem::exists(paths[1] / CRYPTONOTE_BLOCKCHAINDATA_FILENAME))
+        {
+          uint64_t marker_height;
+          MDB_env *env = NULL;
+          open(env, paths[1], 0, true);
+          resume_copy = get_property(env, resume_marker_key, marker_height) && marker_height == source_height;
+          close(env);
+        }
+        if (resume_copy)
+        {
+          MINFO("Resuming interrupted pruning into " << paths[1].string());
+          delete db;
+          db_path = paths[1].string();
+          break;
+        }
       }
       else
       {
@@ -634,18 +799,31 @@ int main(int argc, char* argv[])
         MERROR("Blockchain is already pruned, use --" << arg_copy_pruned_database.name << " to copy it anyway");
         return 1;
       }
+      // a pruned source only holds its own stripe, the copy can only keep that one
+      const uint32_t source_stripe = tools::get_pruning_stripe(core_storage[0]->get_blockchain_pruning_seed());
+      if (opt_pruning_stripe && opt_pruning_stripe != source_stripe)
+      {
+        MERROR("Blockchain is already pruned to stripe " << source_stripe << ", cannot copy stripe " << opt_pruning_stripe);
+        return 1;
+      }
       already_pruned = true;
     }
+    if (n == 0)
+      source_height = core_storage[0]->get_current_blockchain_height();
   }
   core_storage[0]->deinit();
   core_storage[0].reset(NULL);
-  core_storage[1]->deinit();
-  core_storage[1].reset(NULL);
+  if (core_storage[1])
+  {
+    core_storage[1]->deinit();
+    core_storage[1].reset(NULL);
+  }
 
   MINFO("Pruning...");
   MDB_env *env0 = NULL, *env1 = NULL;
   open(env0, paths[0], db_flags, true);
   open(env1, paths[1], db_flags, false);
+  set_property(env1, resume_marker_key, &source_height);
   copy_table(env0, env1, "blocks", MDB_INTEGERKEY, 0);
   copy_table(env0, env1, "block_info", MDB_INTEGERKEY | MDB_DUPSORT| MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64);
   copy_table(env0, env1, "block_heights", MDB_INTEGERKEY | MDB_DUPSORT| MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32);
@@ -662,7 +840,16 @@ int main(int argc, char* argv[])
   copy_table(env0, env1, "txpool_blob", 0, 0, BlockchainLMDB::compare_hash32);
   copy_table(env0, env1, "alt_blocks", 0, 0, BlockchainLMDB::compare_hash32);
   copy_table(env0, env1, "hf_versions", MDB_INTEGERKEY, 0);
-  copy_table(env0, env1, "properties", 0, 0, BlockchainLMDB::compare_string);
+  {
+    // properties are few, and the resume marker breaks their append order: copy them afresh
+    const bool resuming = resume_copy;
+    resume_copy = false;
+    copy_table(env0, env1, "properties", 0, 0, BlockchainLMDB::compare_string);
+    resume_copy = resuming;
+    set_property(env1, resume_marker_key, &source_height);
+    // the output pubkey index is not copied, it can be rebuilt on the pruned db
+    set_property(env1, "output_pubkeys_indexed", NULL);
+  }
   if (already_pruned)
   {
     copy_table(env0, env1, "txs_prunable", MDB_INTEGERKEY, 0, BlockchainLMDB::compare_uint64);
@@ -670,11 +857,18 @@ int main(int argc, char* argv[])
   }
   else
   {
-    prune(env0, env1);
+    prune(env0, env1, opt_pruning_stripe ? opt_pruning_stripe : tools::get_random_stripe());
   }
+  set_property(env1, resume_marker_key, NULL);
   close(env1);
   close(env0);
 
+  if (!opt_output_data_dir.empty())
+  {
+    MINFO("Blockchain pruned OK into " << paths[1].string());
+    return 0;
+  }
+
   MINFO("Swapping databases, pre-pruning blockchain will be left in " << paths[0].string() + "-old and can be removed if desired");
   if (replace_file(paths[0].string(), paths[0].string() + "-old") || replace_file(paths[1].string(), paths[0].string()))
   {
@@ -28,6 +28,7 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
 #include "common/command_line.h"
 #include "serialization/crypto.h"
 #include "cryptonote_core/tx_pool.h"
@@ -191,10 +192,17 @@ int main(int argc, char* argv[])
   if (input.empty())
   {
     std::map<uint64_t, std::pair<uint64_t, uint64_t>> outputs;
+    boost::mutex outputs_lock;
 
     LOG_PRINT_L0("Scanning for known spent data...");
-    db->for_all_transactions([&](const crypto::hash &txid, const cryptonote::transaction &tx){
+    db->for_all_transactions_parallel([&](const crypto::hash &txid, const cryptonote::transaction &tx){
       const bool miner_tx = tx.vin.size() == 1 && tx.vin[0].type() == typeid(txin_gen);
+      // most txes are RingCT and have nothing to count, only take the lock for those which do
+      const auto has_amount = [miner_tx, &tx](const cryptonote::tx_out &out) { return out.amount && !(miner_tx && tx.version >= 2); };
+      const auto has_input_amount = [](const cryptonote::txin_v &in) { return in.type() == typeid(txin_to_key) && boost::get<txin_to_key>(in).amount; };
+      if (std::none_of(tx.vin.begin(), tx.vin.end(), has_input_amount) && std::none_of(tx.vout.begin(), tx.vout.end(), has_amount))
+        return true;
+      boost::unique_lock<boost::mutex> lock(outputs_lock);
       for (const auto &in: tx.vin)
       {
         if (in.type() != typeid(txin_to_key))
@@ -241,9 +249,18 @@ int main(int argc, char* argv[])
 
   db->batch_start();
 
+  // pruned amounts are committed every so often, an interrupted run loses little
+  // and a rerun skips them since they then have no outputs left
+  static const size_t pruned_amounts_per_batch = 64;
+  size_t pruned_amounts_in_batch = 0;
   size_t num_total_outputs = 0, num_prunable_outputs = 0, num_known_spent_outputs = 0, num_eligible_outputs = 0, num_eligible_known_spent_outputs = 0;
   for (auto i = known_spent_outputs.begin(); i != known_spent_outputs.end(); ++i)
   {
+    if (stop_requested)
+    {
+      MWARNING("Interrupted, pruned data so far is kept");
+      break;
+    }
     uint64_t num_outputs = db->get_num_outputs(i->first);
     num_total_outputs += num_outputs;
     num_known_spent_outputs += i->second;
@@ -267,7 +284,16 @@ int main(int argc, char* argv[])
     if (opt_verbose)
       MINFO("Pruning data for " << num_outputs << " outputs");
     if (!opt_dry_run)
-      db->prune_outputs(i->first);
+    {
+      if (num_outputs)
+        db->prune_outputs(i->first);
+      if (++pruned_amounts_in_batch == pruned_amounts_per_batch)
+      {
+        db->batch_stop();
+        db->batch_start();
+        pruned_amounts_in_batch = 0;
+      }
+    }
     num_prunable_outputs += i->second;
   }
 
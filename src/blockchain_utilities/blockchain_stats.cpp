@@ -46,7 +46,7 @@ using namespace cryptonote;
 
 static bool stop_requested = false;
 
-static bool do_inputs, do_outputs, do_ringsize, do_hours, do_emission, do_fees, do_diff;
+static bool do_inputs, do_outputs, do_ringsize, do_hours, do_emission, do_fees, do_diff, do_usage;
 
 static struct tm prevtm, currtm;
 static uint64_t prevsz, currsz;
@@ -67,6 +67,50 @@ static uint32_t minrings = MAX_RINGS, maxrings;
 static uint32_t io, tottxs;
 static uint32_t txhr[24];
 
+// amount -> output index -> number of rings referencing it, for outputs created in the scanned range
+static std::unordered_map<uint64_t, std::unordered_map<uint64_t, uint32_t>> usage;
+
+static void add_usage_outputs(const transaction &tx, const std::vector<uint64_t> &indices)
+{
+  for (size_t n = 0; n < tx.vout.size() && n < indices.size(); ++n)
+    usage[tx.vout[n].amount].emplace(indices[n], 0);
+}
+
+static void add_usage_inputs(const transaction &tx)
+{
+  for (const auto &in: tx.vin)
+  {
+    if (in.type() != typeid(txin_to_key))
+      continue;
+    const auto &txin = boost::get<txin_to_key>(in);
+    auto amount_usage = usage.find(txin.amount);
+    if (amount_usage == usage.end())
+      continue;
+    for (uint64_t offset: cryptonote::relative_output_offsets_to_absolute(txin.key_offsets))
+    {
+      auto i = amount_usage->second.find(offset);
+      if (i != amount_usage->second.end())
+        ++i->second;
+    }
+  }
+}
+
+static void print_usage()
+{
+  std::map<uint32_t, uint64_t> counts;
+  uint64_t total = 0;
+  for (const auto &amount_usage: usage)
+  {
+    for (const auto &e: amount_usage.second)
+      counts[e.second]++;
+    total += amount_usage.second.size();
+  }
+  std::cout << ENDL << "# USAGE" << ENDL;
+  std::cout << "Uses\tOutputs\tPercent" << ENDL;
+  for (const auto &c: counts)
+    std::cout << c.first << "\t" << c.second << "\t" << 100.0 * c.second / total << ENDL;
+}
+
 static void doprint()
 {
   char timebuf[64];
@@ -143,6 +187,7 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<bool> arg_emission  = {"with-emission", "with coin emission", false};
   const command_line::arg_descriptor<bool> arg_fees  = {"with-fees", "with txn fees", false};
   const command_line::arg_descriptor<bool> arg_diff  = {"with-diff", "with difficulty", false};
+  const command_line::arg_descriptor<bool> arg_usage  = {"with-usage", "with ring usage of outputs created in the range", false};
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
@@ -157,6 +202,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_emission);
   command_line::add_arg(desc_cmd_sett, arg_fees);
   command_line::add_arg(desc_cmd_sett, arg_diff);
+  command_line::add_arg(desc_cmd_sett, arg_usage);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
   po::options_description desc_options("Allowed options");
@@ -201,6 +247,7 @@ int main(int argc, char* argv[])
   do_emission = command_line::get_arg(vm, arg_emission);
   do_fees = command_line::get_arg(vm, arg_fees);
   do_diff = command_line::get_arg(vm, arg_diff);
+  do_usage = command_line::get_arg(vm, arg_usage);
 
   LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
   std::unique_ptr<Blockchain> core_storage;
@@ -305,6 +352,19 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
     currsz += bd.size();
     uint64_t coinbase_amount;
     uint64_t tx_fee_amount = 0;
+    std::vector<std::vector<uint64_t>> output_indices;
+    if (do_usage)
+    {
+      // a block's txes are stored consecutively, starting with the miner tx
+      uint64_t miner_tx_index;
+      if (!db->tx_exists(get_transaction_hash(blk.miner_tx), miner_tx_index))
+      {
+        throw std::runtime_error("Aborting: miner tx not found");
+      }
+      output_indices = db->get_tx_amount_output_indices(miner_tx_index, 1 + blk.tx_hashes.size());
+      add_usage_outputs(blk.miner_tx, output_indices[0]);
+    }
+    size_t txn = 0;
     for (const auto& tx_id : blk.tx_hashes)
     {
       if (tx_id == crypto::null_hash)
@@ -356,6 +416,11 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
           maxouts = io;
         totouts += io;
       }
+      if (do_usage)
+      {
+        add_usage_inputs(tx);
+        add_usage_outputs(tx, output_indices[++txn]);
+      }
       tottxs++;
     }
     if (do_diff) {
@@ -380,6 +445,8 @@ plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, ''
   }
   if (currblks)
     doprint();
+  if (do_usage)
+    print_usage();
 
   core_storage->deinit();
   return 0;
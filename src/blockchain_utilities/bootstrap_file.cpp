@@ -31,6 +31,7 @@
 #include "serialization/json_utils.h" // dump_json()
 
 #include "bootstrap_file.h"
+#include "common/threadpool.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
@@ -47,6 +48,11 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // echo Monero bootstrap index | sha1sum
+  const uint32_t blockchain_index_magic = 0xa60eeb98;
+  // 4 byte magic + 8 byte height of the first indexed chunk
+  const uint32_t index_header_size = 12;
+
   std::string refresh_string = "\r                                    \r";
 }
 
@@ -110,6 +116,110 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path, uint64
   if (do_initialize_file)
     initialize_file(start_block, stop_block);
 
+  // an index is only kept in step with the export if it covers up to its end
+  uint64_t index_first;
+  std::vector<uint64_t> offsets;
+  const bool keep_index = !do_initialize_file && load_index(file_path.string(), index_first, offsets);
+  if (!open_index_writer(file_path, !keep_index, m_height ? m_height : start_block))
+    MWARNING("Failed to open chunk index for write, exporting without index");
+
+  return true;
+}
+
+bool BootstrapFile::open_index_writer(const boost::filesystem::path& file_path, bool truncate, uint64_t index_first)
+{
+  m_index_file = new std::ofstream();
+  if (truncate)
+    m_index_file->open(index_path(file_path.string()), std::ios_base::binary | std::ios_base::out | std::ios::trunc);
+  else
+    m_index_file->open(index_path(file_path.string()), std::ios_base::binary | std::ios_base::out | std::ios::app | std::ios::ate);
+  if (m_index_file->fail())
+  {
+    delete m_index_file;
+    m_index_file = nullptr;
+    return false;
+  }
+
+  if (truncate)
+  {
+    std::string blob;
+    uint32_t magic = blockchain_index_magic;
+    if (! ::serialization::dump_binary(magic, blob))
+      throw std::runtime_error("Error in serialization of index magic");
+    *m_index_file << blob;
+    if (! ::serialization::dump_binary(index_first, blob))
+      throw std::runtime_error("Error in serialization of index first height");
+    *m_index_file << blob;
+  }
+  return true;
+}
+
+std::string BootstrapFile::index_path(const std::string& import_file_path)
+{
+  return import_file_path + ".index";
+}
+
+bool BootstrapFile::load_index(const std::string& import_file_path, uint64_t& index_first, std::vector<uint64_t>& offsets)
+{
+  offsets.clear();
+
+  std::ifstream index_file(index_path(import_file_path), std::ios_base::binary | std::ifstream::in);
+  if (index_file.fail())
+    return false;
+  std::string contents((std::istreambuf_iterator<char>(index_file)), std::istreambuf_iterator<char>());
+  if (contents.size() < index_header_size || (contents.size() - index_header_size) % sizeof(uint64_t))
+  {
+    MWARNING("Chunk index " << index_path(import_file_path) << " is malformed, ignoring");
+    return false;
+  }
+
+  uint32_t magic;
+  if (! ::serialization::parse_binary(contents.substr(0, sizeof(magic)), magic) || magic != blockchain_index_magic)
+  {
+    MWARNING("Chunk index " << index_path(import_file_path) << " not recognized, ignoring");
+    return false;
+  }
+  if (! ::serialization::parse_binary(contents.substr(sizeof(magic), sizeof(index_first)), index_first))
+    return false;
+
+  const size_t n_offsets = (contents.size() - index_header_size) / sizeof(uint64_t);
+  offsets.reserve(n_offsets);
+  for (size_t i = 0; i < n_offsets; ++i)
+  {
+    uint64_t offset;
+    if (! ::serialization::parse_binary(contents.substr(index_header_size + i * sizeof(offset), sizeof(offset)), offset))
+      return false;
+    if (!offsets.empty() && offset <= offsets.back())
+    {
+      MWARNING("Chunk index " << index_path(import_file_path) << " is not ordered, ignoring");
+      offsets.clear();
+      return false;
+    }
+    offsets.push_back(offset);
+  }
+  if (offsets.empty())
+    return false;
+
+  // the last indexed chunk must end exactly at the end of the file, or
+  // something appended to (or truncated) the export without the index
+  std::ifstream import_file(import_file_path, std::ios_base::binary | std::ifstream::in);
+  uint32_t chunk_size;
+  char buf1[sizeof(chunk_size)];
+  import_file.seekg(offsets.back());
+  import_file.read(buf1, sizeof(chunk_size));
+  if (!import_file || ! ::serialization::parse_binary(std::string(buf1, sizeof(chunk_size)), chunk_size))
+  {
+    offsets.clear();
+    return false;
+  }
+  boost::system::error_code ec;
+  const uint64_t file_size = boost::filesystem::file_size(import_file_path, ec);
+  if (ec || offsets.back() + sizeof(chunk_size) + chunk_size != file_size)
+  {
+    MWARNING("Chunk index " << index_path(import_file_path) << " does not match the bootstrap file, ignoring");
+    offsets.clear();
+    return false;
+  }
   return true;
 }
 
@@ -181,6 +291,15 @@ void BootstrapFile::flush_chunk()
   }
 
   std::string blob;
+  if (m_index_file)
+  {
+    uint64_t offset = m_raw_data_file->tellp();
+    if (! ::serialization::dump_binary(offset, blob))
+    {
+      throw std::runtime_error("Error in serialization of chunk offset");
+    }
+    *m_index_file << blob;
+  }
   if (! ::serialization::dump_binary(chunk_size, blob))
   {
     throw std::runtime_error("Error in serialization of chunk size");
@@ -209,6 +328,12 @@ void BootstrapFile::flush_chunk()
 }
 
 void BootstrapFile::write_block(block& block)
+{
+  const blobdata bd = get_block_package_blob(block);
+  m_output_stream->write((const char*)bd.data(), bd.size());
+}
+
+blobdata BootstrapFile::get_block_package_blob(const block& block) const
 {
   bootstrap::block_package bp;
   bp.block = block;
@@ -246,8 +371,7 @@ void BootstrapFile::write_block(block& block)
     bp.coins_generated = coins_generated;
   }
 
-  blobdata bd = t_serializable_object_to_blob(bp);
-  m_output_stream->write((const char*)bd.data(), bd.size());
+  return t_serializable_object_to_blob(bp);
 }
 
 bool BootstrapFile::close()
@@ -258,6 +382,13 @@ bool BootstrapFile::close()
   m_raw_data_file->flush();
   delete m_output_stream;
   delete m_raw_data_file;
+  if (m_index_file)
+  {
+    // the index is an optional accelerator, readers check it before use
+    m_index_file->flush();
+    delete m_index_file;
+    m_index_file = nullptr;
+  }
   return true;
 }
 
@@ -270,7 +401,6 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
   m_tx_pool = _tx_pool;
   uint64_t progress_interval = 100;
   MINFO("Storing blocks raw data...");
-  block b;
 
   // block_start, block_stop use 0-based height. m_height uses 1-based height. So to resume export
   // from last exported block, block_start doesn't need to add 1 here, as it's already at the next
@@ -294,19 +424,44 @@ bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_mem
   }
   uint64_t block_start = m_height ? m_height : start_block;
   MINFO("Starting block height: " << block_start);
-  for (m_cur_height = block_start; m_cur_height <= block_stop; ++m_cur_height)
-  {
-    // this method's height refers to 0-based height (genesis block = height 0)
-    crypto::hash hash = m_blockchain_storage->get_block_id_by_height(m_cur_height);
-    m_blockchain_storage->get_block_by_hash(hash, b);
-    write_block(b);
-    if (m_cur_height % NUM_BLOCKS_PER_CHUNK == 0) {
-      flush_chunk();
-      num_blocks_written += NUM_BLOCKS_PER_CHUNK;
+
+  // block packages are read and serialized in parallel a batch at a time, then
+  // written out in height order so the file and its index stay sequential
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const uint64_t batch_size = std::max(1u, tpool.get_max_concurrency()) * 16;
+  std::vector<blobdata> blobs;
+  for (m_cur_height = block_start; m_cur_height <= block_stop; )
+  {
+    const uint64_t batch_start = m_cur_height;
+    blobs.clear();
+    blobs.resize(std::min(batch_size, block_stop - batch_start + 1));
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+      tpool.submit(&waiter, [&, i]() {
+        // this method's height refers to 0-based height (genesis block = height 0)
+        const block blk = m_blockchain_storage->get_db().get_block_from_height(batch_start + i);
+        blobs[i] = get_block_package_blob(blk);
+      }, true);
     }
-    if (m_cur_height % progress_interval == 0) {
-      std::cout << refresh_string;
-      std::cout << "block " << m_cur_height << "/" << block_stop << "\r" << std::flush;
+    if (!waiter.wait())
+    {
+      MFATAL("Failed to read blocks from height " << batch_start);
+      return false;
+    }
+
+    for (const blobdata &bd: blobs)
+    {
+      m_output_stream->write((const char*)bd.data(), bd.size());
+      if (m_cur_height % NUM_BLOCKS_PER_CHUNK == 0) {
+        flush_chunk();
+        num_blocks_written += NUM_BLOCKS_PER_CHUNK;
+      }
+      if (m_cur_height % progress_interval == 0) {
+        std::cout << refresh_string;
+        std::cout << "block " << m_cur_height << "/" << block_stop << "\r" << std::flush;
+      }
+      ++m_cur_height;
     }
   }
   // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
@@ -495,6 +650,24 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
   uint64_t block_last;
   full_header_size = seek_to_first_chunk(import_file, major_version, minor_version, block_first, block_last);
 
+  // with a full chunk index, both the count and the seek are lookups
+  uint64_t index_first;
+  std::vector<uint64_t> offsets;
+  if (load_index(import_file_path, index_first, offsets) && index_first == block_first)
+  {
+    import_file.close();
+    h = offsets.size() * NUM_BLOCKS_PER_CHUNK;
+    if (start_height)
+    {
+      // like the scan below, stop short of start_height so the caller skips at least one chunk
+      const uint64_t chunk = std::min<uint64_t>((start_height > block_first ? start_height - block_first - 1 : 0) / NUM_BLOCKS_PER_CHUNK, offsets.size() - 1);
+      start_pos = offsets[chunk];
+      seek_height = block_first + chunk * NUM_BLOCKS_PER_CHUNK;
+    }
+    MINFO("Number of blocks from chunk index: " << h);
+    return h;
+  }
+
   MINFO("Scanning blockchain from bootstrap file...");
   bool quit = false;
   uint64_t bytes_read = 0, blocks;
@@ -64,6 +64,11 @@ public:
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
       boost::filesystem::path& output_file, uint64_t start_block=0, uint64_t stop_block=0);
 
+  // chunk index written alongside an export: the file offset of each chunk, by height
+  static std::string index_path(const std::string& import_file_path);
+  // loads and checks the index against the bootstrap file, false if missing or stale
+  static bool load_index(const std::string& import_file_path, uint64_t& index_first, std::vector<uint64_t>& offsets);
+
 protected:
 
   Blockchain* m_blockchain_storage;
@@ -71,14 +76,18 @@ protected:
   tx_memory_pool* m_tx_pool;
   typedef std::vector<char> buffer_type;
   std::ofstream * m_raw_data_file;
+  std::ofstream * m_index_file;
   buffer_type m_buffer;
   boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>* m_output_stream;
 
   // open export file for write
   bool open_writer(const boost::filesystem::path& file_path, uint64_t start_block, uint64_t stop_block);
+  bool open_index_writer(const boost::filesystem::path& file_path, bool truncate, uint64_t index_first);
   bool initialize_file(uint64_t start_block, uint64_t stop_block);
   bool close();
   void write_block(block& block);
+  // serialized block package, safe to call from several threads at once
+  blobdata get_block_package_blob(const block& block) const;
   void flush_chunk();
 
 private:
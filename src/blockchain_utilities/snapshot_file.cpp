@@ -0,0 +1,544 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <lmdb.h>
+#include <boost/filesystem.hpp>
+#include "snapshot_file.h"
+#include "misc_log_ex.h"
+#include "misc_language.h"
+#include "storages/portable_storage_template_helper.h"
+#include "checkpoints/checkpoints.h"
+#include "common/util.h"
+#include "crypto/keccak.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "int-util.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
+
+using namespace cryptonote;
+
+namespace
+{
+  struct snapshot_table
+  {
+    const char *name;
+    unsigned int flags;
+    MDB_cmp_func *key_cmp;
+    MDB_cmp_func *dup_cmp;
+  };
+
+  // flags and comparators as BlockchainLMDB::open sets them, tables missing from a database are skipped
+  const snapshot_table tables[] = {
+    {"blocks", MDB_INTEGERKEY, NULL, NULL},
+    {"block_info", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_uint64},
+    {"block_heights", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_hash32},
+    {"txs", MDB_INTEGERKEY, NULL, NULL},
+    {"txs_pruned", MDB_INTEGERKEY, NULL, NULL},
+    {"txs_prunable", MDB_INTEGERKEY, BlockchainLMDB::compare_uint64, NULL},
+    {"txs_prunable_hash", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_uint64},
+    {"txs_prunable_tip", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_uint64},
+    {"tx_indices", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_hash32},
+    {"tx_outputs", MDB_INTEGERKEY, NULL, NULL},
+    {"output_txs", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_uint64},
+    {"output_amounts", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_uint64},
+    {"output_pubkeys", MDB_DUPSORT | MDB_DUPFIXED, BlockchainLMDB::compare_hash32, BlockchainLMDB::compare_uint64},
+    {"view_tags", MDB_INTEGERKEY, NULL, NULL},
+    {"spent_keys", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, NULL, BlockchainLMDB::compare_hash32},
+    {"txpool_meta", 0, BlockchainLMDB::compare_hash32, NULL},
+    {"txpool_blob", 0, BlockchainLMDB::compare_hash32, NULL},
+    {"alt_blocks", 0, BlockchainLMDB::compare_hash32, NULL},
+    {"hf_starting_heights", 0, NULL, NULL},
+    {"hf_versions", MDB_INTEGERKEY, NULL, NULL},
+    {"properties", 0, BlockchainLMDB::compare_string, NULL},
+  };
+
+  // records written per write transaction when loading
+  constexpr const size_t records_per_txn = 1024 * 1024;
+  constexpr const uint64_t map_slack = 512 * 1024 * 1024;
+
+  void open_env(MDB_env *&env, const boost::filesystem::path &path, unsigned int flags, uint64_t mapsize = 0)
+  {
+    int dbr = mdb_env_create(&env);
+    if (dbr) throw std::runtime_error("Failed to create LMDB environment: " + std::string(mdb_strerror(dbr)));
+    dbr = mdb_env_set_maxdbs(env, 32);
+    if (dbr) throw std::runtime_error("Failed to set max env dbs: " + std::string(mdb_strerror(dbr)));
+    if (mapsize)
+    {
+      dbr = mdb_env_set_mapsize(env, mapsize);
+      if (dbr) throw std::runtime_error("Failed to set LMDB map size: " + std::string(mdb_strerror(dbr)));
+    }
+    dbr = mdb_env_open(env, path.string().c_str(), flags, 0664);
+    if (dbr) throw std::runtime_error("Failed to open database file '" + path.string() + "': " + std::string(mdb_strerror(dbr)));
+  }
+
+  std::unique_ptr<MDB_env, decltype(&mdb_env_close)> env_guard(MDB_env *env)
+  {
+    return std::unique_ptr<MDB_env, decltype(&mdb_env_close)>(env, &mdb_env_close);
+  }
+
+  void set_comparators(MDB_txn *txn, MDB_dbi dbi, const snapshot_table &table)
+  {
+    if (table.key_cmp)
+      mdb_set_compare(txn, dbi, table.key_cmp);
+    if (table.dup_cmp)
+      mdb_set_dupsort(txn, dbi, table.dup_cmp);
+  }
+
+  void hash_record(KECCAK_CTX &ctx, const MDB_val &k, const MDB_val &v)
+  {
+    const uint64_t sizes[2] = {SWAP64LE((uint64_t)k.mv_size), SWAP64LE((uint64_t)v.mv_size)};
+    keccak_update(&ctx, (const uint8_t*)sizes, sizeof(sizes));
+    keccak_update(&ctx, (const uint8_t*)k.mv_data, k.mv_size);
+    keccak_update(&ctx, (const uint8_t*)v.mv_data, v.mv_size);
+  }
+
+  /**
+   * Copies a table to env1 if given, hashing its records in order.
+   * Returns false if env0 does not have the table.
+   */
+  bool hash_table(MDB_env *env0, MDB_env *env1, const snapshot_table &table, snapshot_table_manifest &entry)
+  {
+    MDB_txn *txn0 = NULL, *txn1 = NULL;
+    MDB_dbi dbi0, dbi1;
+    MDB_cursor *cur0 = NULL, *cur1 = NULL;
+    epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+      if (txn1) mdb_txn_abort(txn1);
+      if (txn0) mdb_txn_abort(txn0);
+    });
+
+    int dbr = mdb_txn_begin(env0, NULL, MDB_RDONLY, &txn0);
+    if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+    dbr = mdb_dbi_open(txn0, table.name, table.flags, &dbi0);
+    if (dbr == MDB_NOTFOUND)
+      return false;
+    if (dbr) throw std::runtime_error("Failed to open LMDB dbi " + std::string(table.name) + ": " + std::string(mdb_strerror(dbr)));
+    set_comparators(txn0, dbi0, table);
+    dbr = mdb_cursor_open(txn0, dbi0, &cur0);
+    if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+
+    const unsigned int putflags = (table.flags & MDB_DUPSORT) ? MDB_APPENDDUP : MDB_APPEND;
+    auto begin_write = [&]() {
+      dbr = mdb_txn_begin(env1, NULL, 0, &txn1);
+      if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+      dbr = mdb_dbi_open(txn1, table.name, table.flags | MDB_CREATE, &dbi1);
+      if (dbr) throw std::runtime_error("Failed to open LMDB dbi " + std::string(table.name) + ": " + std::string(mdb_strerror(dbr)));
+      set_comparators(txn1, dbi1, table);
+      dbr = mdb_cursor_open(txn1, dbi1, &cur1);
+      if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+    };
+    auto commit_write = [&]() {
+      dbr = mdb_txn_commit(txn1);
+      txn1 = NULL;
+      if (dbr) throw std::runtime_error("Failed to commit " + std::string(table.name) + " records: " + std::string(mdb_strerror(dbr)));
+    };
+    if (env1)
+      begin_write();
+
+    KECCAK_CTX ctx;
+    keccak_init(&ctx);
+    entry.name = table.name;
+    entry.records = 0;
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    while (1)
+    {
+      dbr = mdb_cursor_get(cur0, &k, &v, op);
+      op = MDB_NEXT;
+      if (dbr == MDB_NOTFOUND)
+        break;
+      if (dbr) throw std::runtime_error("Failed to enumerate " + std::string(table.name) + " records: " + std::string(mdb_strerror(dbr)));
+      hash_record(ctx, k, v);
+      ++entry.records;
+      if (env1)
+      {
+        dbr = mdb_cursor_put(cur1, &k, &v, putflags);
+        if (dbr) throw std::runtime_error("Failed to write " + std::string(table.name) + " record: " + std::string(mdb_strerror(dbr)));
+        if (entry.records % records_per_txn == 0)
+        {
+          commit_write();
+          begin_write();
+        }
+      }
+    }
+    if (env1)
+      commit_write();
+    keccak_finish(&ctx, (uint8_t*)entry.hash.data);
+    return true;
+  }
+
+  bool get_checkpoints(network_type nettype, bool dns_checkpoints, checkpoints &points)
+  {
+    if (!points.init_default_checkpoints(nettype))
+    {
+      MERROR("Failed to initialize checkpoints");
+      return false;
+    }
+    if (dns_checkpoints && !points.load_checkpoints_from_dns(nettype))
+    {
+      MERROR("Failed to load DNS checkpoints");
+      return false;
+    }
+    return true;
+  }
+
+  void trim_hf_versions(MDB_env *env, uint64_t height)
+  {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    MDB_cursor *cur;
+    int dbr = mdb_txn_begin(env, NULL, 0, &txn);
+    if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+    bool tx_active = true;
+    epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+      if (tx_active) mdb_txn_abort(txn);
+    });
+    dbr = mdb_dbi_open(txn, "hf_versions", MDB_INTEGERKEY, &dbi);
+    if (dbr == MDB_NOTFOUND)
+      return;
+    if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+    dbr = mdb_cursor_open(txn, dbi, &cur);
+    if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+    MDB_val k = {sizeof(height), (void*)&height}, v;
+    dbr = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    while (dbr == 0)
+    {
+      dbr = mdb_cursor_del(cur, 0);
+      if (dbr) throw std::runtime_error("Failed to delete hard fork version: " + std::string(mdb_strerror(dbr)));
+      dbr = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+    }
+    if (dbr != MDB_NOTFOUND)
+      throw std::runtime_error("Failed to enumerate hard fork versions: " + std::string(mdb_strerror(dbr)));
+    dbr = mdb_txn_commit(txn);
+    tx_active = false;
+    if (dbr) throw std::runtime_error("Failed to commit txn: " + std::string(mdb_strerror(dbr)));
+  }
+
+  bool check_chain(BlockchainDB &db, const snapshot_manifest &manifest, const checkpoints &points)
+  {
+    if (db.height() != manifest.height)
+    {
+      MERROR("Snapshot has " << db.height() << " blocks, but its manifest says " << manifest.height);
+      return false;
+    }
+    crypto::hash expected = manifest.top_hash;
+    for (uint64_t height = manifest.height; height-- > 0; )
+    {
+      block b;
+      crypto::hash hash;
+      if (!parse_and_validate_block_from_blob(db.get_block_blob_from_height(height), b, hash))
+      {
+        MERROR("Failed to parse block at height " << height);
+        return false;
+      }
+      if (hash != expected)
+      {
+        MERROR("Block " << hash << " at height " << height << " does not link to the snapshot top block");
+        return false;
+      }
+      if (db.get_block_hash_from_height(height) != hash)
+      {
+        MERROR("Block index disagrees with the block at height " << height);
+        return false;
+      }
+      if (!points.check_block(height, hash))
+      {
+        MERROR("Block " << hash << " at height " << height << " does not match its checkpoint");
+        return false;
+      }
+      expected = b.prev_id;
+      if (height % 100000 == 0)
+        MINFO("Checked blocks down to height " << height);
+    }
+    if (expected != crypto::null_hash)
+    {
+      MERROR("Snapshot does not start at a genesis block");
+      return false;
+    }
+    return true;
+  }
+}
+
+bool SnapshotFile::store_snapshot(const boost::filesystem::path &db_dir, const boost::filesystem::path &output_dir,
+    network_type nettype, uint64_t max_height, bool dns_checkpoints)
+{
+  checkpoints points;
+  if (!get_checkpoints(nettype, dns_checkpoints, points))
+    return false;
+
+  boost::system::error_code ec;
+  if (boost::filesystem::exists(output_dir / SNAPSHOT_MANIFEST, ec) || boost::filesystem::exists(output_dir / "data.mdb", ec))
+  {
+    MERROR("Snapshot directory " << output_dir << " is not empty");
+    return false;
+  }
+  const boost::filesystem::path tmp_dir = output_dir / "tmp";
+  if (!boost::filesystem::create_directories(tmp_dir, ec) && ec)
+  {
+    MERROR("Failed to create directory " << tmp_dir << ": " << ec.message());
+    return false;
+  }
+  epee::misc_utils::auto_scope_leave_caller tmp_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(tmp_dir, ec);
+  });
+
+  snapshot_manifest manifest;
+  manifest.version = SNAPSHOT_FORMAT_VERSION;
+  manifest.nettype = nettype;
+  try
+  {
+    // the copy runs in a single read txn, so it is consistent even if a daemon is writing
+    MINFO("Copying database " << db_dir);
+    {
+      MDB_env *env;
+      open_env(env, db_dir, MDB_RDONLY);
+      auto env_dtor = env_guard(env);
+      int dbr = mdb_env_copy2(env, tmp_dir.string().c_str(), MDB_CP_COMPACT);
+      if (dbr) throw std::runtime_error("Failed to copy database: " + std::string(mdb_strerror(dbr)));
+    }
+
+    uint64_t checkpoint_height = 0;
+    {
+      std::unique_ptr<BlockchainDB> db(new_db());
+      db->open(tmp_dir.string(), 0);
+      const uint64_t db_height = db->height();
+      const auto &cps = points.get_points();
+      auto it = cps.rbegin();
+      while (it != cps.rend() && (it->first >= db_height || (max_height && it->first > max_height)))
+        ++it;
+      if (it == cps.rend())
+      {
+        MERROR("No checkpoint below height " << (max_height ? std::min(max_height + 1, db_height) : db_height));
+        db->close();
+        return false;
+      }
+      checkpoint_height = it->first;
+      if (db->get_block_hash_from_height(checkpoint_height) != it->second)
+      {
+        MERROR("Block at height " << checkpoint_height << " does not match its checkpoint");
+        db->close();
+        return false;
+      }
+
+      MINFO("Rolling back from height " << db_height << " to checkpoint at " << checkpoint_height);
+      db->set_batch_transactions(true);
+      db->batch_start();
+      try
+      {
+        while (db->height() > checkpoint_height + 1)
+        {
+          block b;
+          std::vector<transaction> txs;
+          db->pop_block(b, txs);
+        }
+        db->drop_alt_blocks();
+        std::vector<crypto::hash> pool;
+        db->for_all_txpool_txes([&pool](const crypto::hash &txid, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*) {
+          pool.push_back(txid);
+          return true;
+        }, false, relay_category::all);
+        for (const crypto::hash &txid: pool)
+          db->remove_txpool_tx(txid);
+      }
+      catch (...)
+      {
+        db->batch_abort();
+        throw;
+      }
+      db->batch_stop();
+      manifest.height = db->height();
+      manifest.top_hash = db->top_block_hash();
+      db->close();
+    }
+
+    MINFO("Writing snapshot to " << output_dir);
+    {
+      MDB_env *env;
+      open_env(env, tmp_dir, 0);
+      auto env_dtor = env_guard(env);
+      trim_hf_versions(env, checkpoint_height + 1);
+      int dbr = mdb_env_copy2(env, output_dir.string().c_str(), MDB_CP_COMPACT);
+      if (dbr) throw std::runtime_error("Failed to copy database: " + std::string(mdb_strerror(dbr)));
+    }
+
+    {
+      MDB_env *env;
+      open_env(env, output_dir, MDB_RDONLY);
+      auto env_dtor = env_guard(env);
+      for (const snapshot_table &table: tables)
+      {
+        snapshot_table_manifest entry;
+        if (hash_table(env, NULL, table, entry))
+        {
+          MINFO("Table " << entry.name << ": " << entry.records << " records, hash " << entry.hash);
+          manifest.tables.push_back(std::move(entry));
+        }
+      }
+    }
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to write snapshot: " << e.what());
+    return false;
+  }
+
+  if (!epee::serialization::store_t_to_json_file(manifest, (output_dir / SNAPSHOT_MANIFEST).string()))
+  {
+    MERROR("Failed to write snapshot manifest");
+    return false;
+  }
+  MINFO("Snapshot at height " << manifest.height << ", top block " << manifest.top_hash);
+  return true;
+}
+
+bool SnapshotFile::load_snapshot(const boost::filesystem::path &snapshot_dir, const boost::filesystem::path &db_dir,
+    network_type nettype, bool dns_checkpoints)
+{
+  snapshot_manifest manifest;
+  if (!epee::serialization::load_t_from_json_file(manifest, (snapshot_dir / SNAPSHOT_MANIFEST).string()))
+  {
+    MERROR("Failed to load snapshot manifest from " << snapshot_dir);
+    return false;
+  }
+  if (manifest.version != SNAPSHOT_FORMAT_VERSION)
+  {
+    MERROR("Unsupported snapshot version " << manifest.version);
+    return false;
+  }
+  if (manifest.nettype != nettype)
+  {
+    MERROR("Snapshot is for another network");
+    return false;
+  }
+
+  checkpoints points;
+  if (!get_checkpoints(nettype, dns_checkpoints, points))
+    return false;
+  bool is_a_checkpoint = false;
+  if (manifest.height == 0 || !points.check_block(manifest.height - 1, manifest.top_hash, is_a_checkpoint) || !is_a_checkpoint)
+  {
+    MERROR("Snapshot top block " << manifest.top_hash << " at height " << manifest.height - 1 << " is not a known checkpoint");
+    return false;
+  }
+
+  boost::system::error_code ec;
+  if (boost::filesystem::exists(db_dir / "data.mdb", ec))
+  {
+    MERROR("A database already exists in " << db_dir);
+    return false;
+  }
+  if (!boost::filesystem::create_directories(db_dir, ec) && ec)
+  {
+    MERROR("Failed to create directory " << db_dir << ": " << ec.message());
+    return false;
+  }
+  bool success = false;
+  epee::misc_utils::auto_scope_leave_caller db_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    if (success)
+      return;
+    boost::system::error_code ec;
+    boost::filesystem::remove(db_dir / "data.mdb", ec);
+    boost::filesystem::remove(db_dir / "lock.mdb", ec);
+  });
+
+  try
+  {
+    const uint64_t snapshot_size = boost::filesystem::file_size(snapshot_dir / "data.mdb");
+    MDB_env *env0, *env1;
+    open_env(env0, snapshot_dir, MDB_RDONLY);
+    auto env0_dtor = env_guard(env0);
+    open_env(env1, db_dir, MDB_NOSYNC, snapshot_size + snapshot_size / 8 + map_slack);
+    auto env1_dtor = env_guard(env1);
+
+    size_t matched = 0;
+    for (const snapshot_table &table: tables)
+    {
+      const auto expected = std::find_if(manifest.tables.begin(), manifest.tables.end(),
+          [&table](const snapshot_table_manifest &e) { return e.name == table.name; });
+      snapshot_table_manifest entry;
+      MINFO("Loading " << table.name);
+      if (!hash_table(env0, expected == manifest.tables.end() ? NULL : env1, table, entry))
+      {
+        if (expected != manifest.tables.end())
+        {
+          MERROR("Snapshot is missing table " << table.name);
+          return false;
+        }
+        continue;
+      }
+      if (expected == manifest.tables.end())
+      {
+        MERROR("Snapshot has table " << table.name << " which is not in its manifest");
+        return false;
+      }
+      if (entry.records != expected->records || entry.hash != expected->hash)
+      {
+        MERROR("Table " << table.name << " does not match the manifest: " << entry.records << " records with hash " << entry.hash
+            << ", expected " << expected->records << " with hash " << expected->hash);
+        return false;
+      }
+      ++matched;
+    }
+    if (matched != manifest.tables.size())
+    {
+      MERROR("Snapshot manifest lists unknown tables");
+      return false;
+    }
+    int dbr = mdb_env_sync(env1, 1);
+    if (dbr) throw std::runtime_error("Failed to sync database: " + std::string(mdb_strerror(dbr)));
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to load snapshot: " << e.what());
+    return false;
+  }
+
+  MINFO("Checking blocks against the snapshot top block and checkpoints");
+  try
+  {
+    std::unique_ptr<BlockchainDB> db(new_db());
+    db->open(db_dir.string(), DBF_RDONLY);
+    const bool r = check_chain(*db, manifest, points);
+    db->close();
+    if (!r)
+      return false;
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to check snapshot blocks: " << e.what());
+    return false;
+  }
+
+  success = true;
+  MINFO("Loaded snapshot at height " << manifest.height << ", top block " << manifest.top_hash);
+  return true;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2014-2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include "cryptonote_config.h"
+#include "crypto/hash.h"
+#include "serialization/keyvalue_serialization.h"
+
+#define SNAPSHOT_MANIFEST "manifest.json"
+#define SNAPSHOT_FORMAT_VERSION 1
+
+struct snapshot_table_manifest
+{
+  std::string name;
+  uint64_t records;
+  crypto::hash hash;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(records)
+    KV_SERIALIZE_VAL_POD_AS_BLOB(hash)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct snapshot_manifest
+{
+  uint32_t version;
+  uint8_t nettype;
+  uint64_t height;
+  crypto::hash top_hash;
+  std::vector<snapshot_table_manifest> tables;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(version)
+    KV_SERIALIZE(nettype)
+    KV_SERIALIZE(height)
+    KV_SERIALIZE_VAL_POD_AS_BLOB(top_hash)
+    KV_SERIALIZE(tables)
+  END_KV_SERIALIZE_MAP()
+};
+
+/**
+ * @brief LMDB level chain state snapshots
+ *
+ * A snapshot is a compacted copy of the LMDB database, rolled back to a
+ * checkpointed height, next to a manifest with the height, top block hash
+ * and a hash of the contents of each table. Loading one copies the tables
+ * into a new database with MDB_APPEND, so a node can start from it and only
+ * sync the blocks after the checkpoint.
+ */
+class SnapshotFile
+{
+public:
+
+  /**
+   * @brief write a snapshot of a database
+   *
+   * @param db_dir the directory of the database to snapshot
+   * @param output_dir the directory to write the snapshot to
+   * @param nettype the network the database belongs to
+   * @param max_height snapshot at the highest checkpoint at or below this height, 0 for the highest one
+   * @param dns_checkpoints whether to use DNS checkpoints as well as the embedded ones
+   *
+   * @return true on success
+   */
+  bool store_snapshot(const boost::filesystem::path &db_dir, const boost::filesystem::path &output_dir,
+      cryptonote::network_type nettype, uint64_t max_height, bool dns_checkpoints);
+
+  /**
+   * @brief create a database from a snapshot
+   *
+   * The snapshot top block must match a checkpoint, each table must match
+   * its manifest hash and the blocks must link back from the top to the
+   * genesis block. The database directory must not already hold a database.
+   *
+   * @param snapshot_dir the directory holding the snapshot
+   * @param db_dir the directory of the database to create
+   * @param nettype the network the database belongs to
+   * @param dns_checkpoints whether to use DNS checkpoints as well as the embedded ones
+   *
+   * @return true on success
+   */
+  bool load_snapshot(const boost::filesystem::path &snapshot_dir, const boost::filesystem::path &db_dir,
+      cryptonote::network_type nettype, bool dns_checkpoints);
+};
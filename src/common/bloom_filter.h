@@ -0,0 +1,110 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+namespace tools
+{
+  // A Bloom filter over 64 bit hashes of its elements, which callers are
+  // expected to provide already well mixed. Elements cannot be removed.
+  //
+  // add and may_contain may be called concurrently; an add becomes visible
+  // to other threads once they synchronize with the adding thread by other
+  // means. reset is not thread safe.
+  class bloom_filter
+  {
+  public:
+    bloom_filter(): m_words(), m_mask(0), m_hashes(0), m_count(0) {}
+
+    // sizes the filter for capacity elements, and empties it
+    void reset(uint64_t capacity, unsigned bits_per_element = 10)
+    {
+      uint64_t bits = 64;
+      while (bits < capacity * bits_per_element && bits < (1ull << 40))
+        bits <<= 1;
+      m_words.reset(new std::atomic<uint64_t>[bits / 64]);
+      for (uint64_t i = 0; i < bits / 64; ++i)
+        m_words[i].store(0, std::memory_order_relaxed);
+      m_mask = bits - 1;
+      // optimal for the requested density rather than the rounded up size,
+      // which just lowers the false positive rate a bit
+      m_hashes = std::max(1u, (unsigned)std::lround(bits_per_element * 0.6931));
+      m_count = 0;
+    }
+
+    void clear()
+    {
+      m_words.reset();
+      m_mask = 0;
+      m_hashes = 0;
+      m_count = 0;
+    }
+
+    bool empty() const { return !m_words; }
+    uint64_t size_bytes() const { return m_words ? (m_mask + 1) / 8 : 0; }
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+    void add(uint64_t hash)
+    {
+      uint64_t pos = hash, step = mix(hash) | 1;
+      for (unsigned i = 0; i < m_hashes; ++i, pos += step)
+        m_words[(pos & m_mask) / 64].fetch_or(1ull << (pos % 64), std::memory_order_relaxed);
+      m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // false means the element was never added, true that it may have been
+    bool may_contain(uint64_t hash) const
+    {
+      uint64_t pos = hash, step = mix(hash) | 1;
+      for (unsigned i = 0; i < m_hashes; ++i, pos += step)
+        if (!(m_words[(pos & m_mask) / 64].load(std::memory_order_relaxed) & (1ull << (pos % 64))))
+          return false;
+      return true;
+    }
+
+  private:
+    // splitmix64 finalizer, to get a second independent hash for the probe step
+    static uint64_t mix(uint64_t x)
+    {
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+      return x ^ (x >> 31);
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+    uint64_t m_mask;
+    unsigned m_hashes;
+    std::atomic<uint64_t> m_count;
+  };
+}
@@ -30,8 +30,12 @@
 
 #pragma once 
 
+#include <list>
+#include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <functional>
 
 namespace tools
 {
@@ -62,4 +66,184 @@ namespace tools
     T buf[MAX_SIZE] = {};
     size_t counter = 0;
   };
+
+  // Splits the entries across SHARDS independently locked data_caches, so
+  // concurrent lookups from several verification threads rarely contend,
+  // and counts hits and misses
+  template<typename T, size_t MAX_SIZE, size_t SHARDS = 16>
+  class sharded_data_cache
+  {
+    static_assert(SHARDS > 0 && MAX_SIZE >= SHARDS, "Invalid number of shards");
+  public:
+    void add(const T& value)
+    {
+      shard(value).add(value);
+    }
+
+    bool has(const T& value) const
+    {
+      const bool found = shard(value).has(value);
+      if (found)
+        ++hits;
+      else
+        ++misses;
+      return found;
+    }
+
+    uint64_t get_hits() const { return hits; }
+    uint64_t get_misses() const { return misses; }
+
+  private:
+    data_cache<T, MAX_SIZE / SHARDS>& shard(const T& value) { return shards[std::hash<T>()(value) % SHARDS]; }
+    const data_cache<T, MAX_SIZE / SHARDS>& shard(const T& value) const { return shards[std::hash<T>()(value) % SHARDS]; }
+
+    data_cache<T, MAX_SIZE / SHARDS> shards[SHARDS];
+    mutable std::atomic<uint64_t> hits{0};
+    mutable std::atomic<uint64_t> misses{0};
+  };
+
+  // A key to value map which keeps the max_size most recently used entries
+  template<typename K, typename V>
+  class lru_cache
+  {
+  public:
+    explicit lru_cache(size_t max_size = 0): max_size(max_size) {}
+
+    void set_max_size(size_t size)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      max_size = size;
+      trim();
+    }
+
+    bool get(const K& key, V& value)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      const auto i = index.find(key);
+      if (i == index.end())
+        return false;
+      entries.splice(entries.begin(), entries, i->second);
+      value = i->second->second;
+      return true;
+    }
+
+    void add(const K& key, const V& value)
+    {
+      add_if(key, value, []() { return true; });
+    }
+
+    // adds only if pred(), which is called with the cache locked, so callers
+    // can order the check against their own calls to remove
+    template<typename P>
+    bool add_if(const K& key, const V& value, P pred)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (!pred())
+        return false;
+      const auto i = index.find(key);
+      if (i != index.end())
+      {
+        i->second->second = value;
+        entries.splice(entries.begin(), entries, i->second);
+        return true;
+      }
+      entries.emplace_front(key, value);
+      index.emplace(key, entries.begin());
+      trim();
+      return true;
+    }
+
+    void remove(const K& key)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      const auto i = index.find(key);
+      if (i == index.end())
+        return;
+      entries.erase(i->second);
+      index.erase(i);
+    }
+
+    void clear()
+    {
+      std::lock_guard<std::mutex> lock(m);
+      entries.clear();
+      index.clear();
+    }
+
+    size_t size() const
+    {
+      std::lock_guard<std::mutex> lock(m);
+      return entries.size();
+    }
+
+  private:
+    void trim()
+    {
+      while (entries.size() > max_size)
+      {
+        index.erase(entries.back().first);
+        entries.pop_back();
+      }
+    }
+
+    mutable std::mutex m;
+    size_t max_size;
+    std::list<std::pair<K, V>> entries; // most recently used first
+    std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator> index;
+  };
+
+  // lru_cache split across SHARDS independently locked shards, with hit
+  // and miss counts
+  template<typename K, typename V, size_t SHARDS = 16>
+  class sharded_lru_cache
+  {
+    static_assert(SHARDS > 0, "Invalid number of shards");
+  public:
+    explicit sharded_lru_cache(size_t max_size = 0) { set_max_size(max_size); }
+
+    void set_max_size(size_t size)
+    {
+      for (auto &s: shards)
+        s.set_max_size((size + SHARDS - 1) / SHARDS);
+    }
+
+    bool get(const K& key, V& value)
+    {
+      const bool found = shard(key).get(key, value);
+      if (found)
+        ++hits;
+      else
+        ++misses;
+      return found;
+    }
+
+    void add(const K& key, const V& value) { shard(key).add(key, value); }
+    template<typename P>
+    bool add_if(const K& key, const V& value, P pred) { return shard(key).add_if(key, value, pred); }
+    void remove(const K& key) { shard(key).remove(key); }
+
+    void clear()
+    {
+      for (auto &s: shards)
+        s.clear();
+    }
+
+    size_t size() const
+    {
+      size_t n = 0;
+      for (const auto &s: shards)
+        n += s.size();
+      return n;
+    }
+
+    uint64_t get_hits() const { return hits; }
+    uint64_t get_misses() const { return misses; }
+
+  private:
+    lru_cache<K, V>& shard(const K& key) { return shards[std::hash<K>()(key) % SHARDS]; }
+
+    lru_cache<K, V> shards[SHARDS];
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
 }
@@ -30,7 +30,10 @@
 // check local first (in the event of static or in-source compilation of libunbound)
 #include "unbound.h"
 
+#include <algorithm>
+#include <chrono>
 #include <deque>
+#include <map>
 #include <set>
 #include <stdlib.h>
 #include "include_base_utils.h"
@@ -56,6 +59,9 @@ static const char *DEFAULT_DNS_PUBLIC_ADDR[] =
 
 static boost::mutex instance_lock;
 
+// upper bound on how long an answer is reused, whatever its TTL
+#define DNS_CACHE_MAX_TTL 3600
+
 namespace
 {
 
@@ -225,9 +231,19 @@ private:
 
 typedef class scoped_ptr<ub_result,ub_resolve_free> ub_result_ptr;
 
+struct dns_cache_entry
+{
+  std::vector<std::string> records;
+  bool dnssec_available;
+  bool dnssec_valid;
+  std::chrono::steady_clock::time_point expiry;
+};
+
 struct DNSResolverData
 {
   ub_ctx* m_ub_context;
+  boost::mutex m_cache_lock;
+  std::map<std::pair<std::string, int>, dns_cache_entry> m_cache; //!< answers by (name, record type), kept for their TTL
 };
 
 // work around for bug https://www.nlnetlabs.nl/bugs-script/show_bug.cgi?id=515 needed for it to compile on e.g. Debian 7
@@ -301,6 +317,7 @@ DNSResolver::DNSResolver() : m_data(new DNSResolverData())
       MINFO("Failed to verify DNSSEC record from " << probe_hostname << ", falling back to TCP with well known DNSSEC resolvers");
       ub_ctx_delete(m_data->m_ub_context);
       m_data->m_ub_context = ub_ctx_create();
+      m_data->m_cache.clear();
       add_anchors(m_data->m_ub_context);
       for (const auto &ip: DEFAULT_DNS_PUBLIC_ADDR)
         ub_ctx_set_fwd(m_data->m_ub_context, string_copy(ip));
@@ -328,6 +345,24 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
   dnssec_available = false;
   dnssec_valid = false;
 
+  const auto key = std::make_pair(url, record_type);
+  const auto now = std::chrono::steady_clock::now();
+  {
+    boost::lock_guard<boost::mutex> lock(m_data->m_cache_lock);
+    const auto entry = m_data->m_cache.find(key);
+    if (entry != m_data->m_cache.end())
+    {
+      if (now < entry->second.expiry)
+      {
+        MDEBUG("Using cached " << get_record_name(record_type) << " records for " << url);
+        dnssec_available = entry->second.dnssec_available;
+        dnssec_valid = entry->second.dnssec_valid;
+        return entry->second.records;
+      }
+      m_data->m_cache.erase(entry);
+    }
+  }
+
   // destructor takes care of cleanup
   ub_result_ptr result;
 
@@ -353,6 +388,20 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
         }
       }
     }
+
+    const int ttl = std::min(std::max(result->ttl, 0), DNS_CACHE_MAX_TTL);
+    if (ttl > 0)
+    {
+      boost::lock_guard<boost::mutex> lock(m_data->m_cache_lock);
+      for (auto entry = m_data->m_cache.begin(); entry != m_data->m_cache.end(); )
+      {
+        if (entry->second.expiry <= now)
+          entry = m_data->m_cache.erase(entry);
+        else
+          ++entry;
+      }
+      m_data->m_cache[key] = {addresses, dnssec_available, dnssec_valid, now + std::chrono::seconds(ttl)};
+    }
   }
 
   return addresses;
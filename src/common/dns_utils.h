@@ -50,7 +50,8 @@ struct DNSResolverData;
  *
  * This class is designed to provide a high-level abstraction to DNS resolution
  * functionality, including access to TXT records and such.  It will also
- * handle DNSSEC validation of the results.
+ * handle DNSSEC validation of the results.  Answers are cached for their
+ * TTL, up to an hour, so repeated lookups do not go to the network.
  */
 class DNSResolver
 {
@@ -0,0 +1,210 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tools
+{
+  // An open addressing map from a fixed size key to a 32 bit index, with the
+  // keys stored inline in one array, for indexes keyed by hashes or curve
+  // points whose std::hash is already well mixed. Robin Hood probing keeps
+  // lookups of absent keys short at a high load, and erase shifts entries
+  // back rather than leaving tombstones. Inserting or erasing invalidates
+  // iterators, and the index npos is reserved to mark empty slots.
+  template<typename K>
+  class flat_index_map
+  {
+    static_assert(std::is_trivially_copyable<K>::value, "Keys must be trivially copyable");
+  public:
+    typedef K key_type;
+    typedef uint32_t mapped_type;
+    static constexpr mapped_type npos = std::numeric_limits<mapped_type>::max();
+
+    struct value_type
+    {
+      K first;
+      mapped_type second;
+    };
+
+    template<typename V>
+    class basic_iterator
+    {
+    public:
+      basic_iterator(V *slot, V *last): slot(slot), last(last) { skip(); }
+      V& operator*() const { return *slot; }
+      V* operator->() const { return slot; }
+      basic_iterator& operator++() { ++slot; skip(); return *this; }
+      basic_iterator operator++(int) { basic_iterator it = *this; ++*this; return it; }
+      bool operator==(const basic_iterator &other) const { return slot == other.slot; }
+      bool operator!=(const basic_iterator &other) const { return slot != other.slot; }
+
+    private:
+      friend class flat_index_map;
+      void skip() { while (slot != last && slot->second == npos) ++slot; }
+      V *slot;
+      V *last;
+    };
+    typedef basic_iterator<value_type> iterator;
+    typedef basic_iterator<const value_type> const_iterator;
+
+    flat_index_map(): count(0) {}
+
+    size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+    size_t memory_usage() const noexcept { return slots.capacity() * sizeof(value_type); }
+
+    iterator begin() { return {slots.data(), slots.data() + slots.size()}; }
+    iterator end() { return {slots.data() + slots.size(), slots.data() + slots.size()}; }
+    const_iterator begin() const { return {slots.data(), slots.data() + slots.size()}; }
+    const_iterator end() const { return {slots.data() + slots.size(), slots.data() + slots.size()}; }
+
+    void clear()
+    {
+      std::vector<value_type>().swap(slots);
+      count = 0;
+    }
+
+    //! Sizes the table for n entries, so filling it up to n does not rehash
+    void reserve(size_t n)
+    {
+      if (n * 8 > slots.size() * 7)
+        rehash(n * 8 / 7 + 1);
+    }
+
+    iterator find(const K &key) { return {slots.data() + lookup(key), slots.data() + slots.size()}; }
+    const_iterator find(const K &key) const { return {slots.data() + lookup(key), slots.data() + slots.size()}; }
+
+    std::pair<iterator, bool> emplace(const K &key, mapped_type value)
+    {
+      const size_t existing = lookup(key);
+      if (existing != slots.size())
+        return {{slots.data() + existing, slots.data() + slots.size()}, false};
+      if ((count + 1) * 8 > slots.size() * 7)
+        rehash(std::max<size_t>(16, slots.size() + slots.size() / 2));
+      const size_t i = insert_new({key, value});
+      return {{slots.data() + i, slots.data() + slots.size()}, true};
+    }
+
+    mapped_type& operator[](const K &key) { return emplace(key, 0).first->second; }
+
+    void erase(iterator it)
+    {
+      size_t i = it.slot - slots.data();
+      for (size_t j = next(i); slots[j].second != npos && distance(j) > 0; j = next(j))
+      {
+        slots[i] = slots[j];
+        i = j;
+      }
+      slots[i].second = npos;
+      --count;
+    }
+
+    size_t erase(const K &key)
+    {
+      const iterator it = find(key);
+      if (it == end())
+        return 0;
+      erase(it);
+      return 1;
+    }
+
+  private:
+    size_t home(const K &key) const { return std::hash<K>()(key) % slots.size(); }
+    size_t next(size_t i) const { return i + 1 == slots.size() ? 0 : i + 1; }
+    size_t distance(size_t i) const
+    {
+      const size_t h = home(slots[i].first);
+      return i >= h ? i - h : i + slots.size() - h;
+    }
+
+    //! slot holding key, or slots.size() if absent
+    size_t lookup(const K &key) const
+    {
+      if (count == 0)
+        return slots.size();
+      size_t i = home(key);
+      for (size_t d = 0; slots[i].second != npos && distance(i) >= d; ++d)
+      {
+        if (slots[i].first == key)
+          return i;
+        i = next(i);
+      }
+      return slots.size();
+    }
+
+    //! inserts a key known to be absent, returns where it landed
+    size_t insert_new(value_type entry)
+    {
+      size_t i = home(entry.first);
+      size_t placed = slots.size();
+      for (size_t d = 0; ; ++d)
+      {
+        if (slots[i].second == npos)
+        {
+          slots[i] = entry;
+          ++count;
+          return placed == slots.size() ? i : placed;
+        }
+        const size_t existing = distance(i);
+        if (existing < d)
+        {
+          // the poorer entry takes the slot, and the richer one moves on
+          std::swap(entry, slots[i]);
+          if (placed == slots.size())
+            placed = i;
+          d = existing;
+        }
+        i = next(i);
+      }
+    }
+
+    void rehash(size_t n)
+    {
+      std::vector<value_type> old(n, value_type{K{}, npos});
+      old.swap(slots);
+      count = 0;
+      for (const value_type &entry: old)
+        if (entry.second != npos)
+          insert_new(entry);
+    }
+
+    std::vector<value_type> slots;
+    size_t count;
+  };
+
+  template<typename K>
+  constexpr typename flat_index_map<K>::mapped_type flat_index_map<K>::npos;
+}
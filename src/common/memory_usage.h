@@ -0,0 +1,72 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tools
+{
+  //! approximate heap usage of one cache or container
+  struct memory_usage
+  {
+    std::string name;
+    uint64_t entries;
+    uint64_t bytes;
+  };
+
+  // Estimates of the memory held by standard containers: the storage for the
+  // elements plus the usual per node and per bucket pointers, not counting
+  // allocator overhead or what the elements point to themselves
+  namespace memory
+  {
+    template<typename T>
+    uint64_t vector_bytes(const std::vector<T> &v)
+    {
+      return v.capacity() * sizeof(T);
+    }
+
+    template<typename C>
+    uint64_t hash_container_bytes(const C &c)
+    {
+      return c.bucket_count() * sizeof(void*) + c.size() * (sizeof(typename C::value_type) + 2 * sizeof(void*));
+    }
+
+    template<typename C>
+    uint64_t tree_container_bytes(const C &c)
+    {
+      return c.size() * (sizeof(typename C::value_type) + 4 * sizeof(void*));
+    }
+  }
+
+  //! resident set size of the process, 0 if not known on this platform
+  uint64_t get_resident_memory();
+}
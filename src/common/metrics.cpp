@@ -0,0 +1,177 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.h"
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+
+namespace tools
+{
+namespace metrics
+{
+  namespace
+  {
+    struct registry
+    {
+      boost::mutex mutex;
+      std::multimap<std::string, const metric*> metrics;
+    };
+
+    registry &get_registry()
+    {
+      static registry r;
+      return r;
+    }
+  }
+
+  metric::metric(const char *name, const char *help, std::string labels, bool restricted)
+    : name_(name), help_(help), labels_(std::move(labels)), restricted_(restricted)
+  {
+    registry &r = get_registry();
+    boost::lock_guard<boost::mutex> lock(r.mutex);
+    r.metrics.emplace(name_, this);
+  }
+
+  metric::~metric()
+  {
+    registry &r = get_registry();
+    boost::lock_guard<boost::mutex> lock(r.mutex);
+    const auto range = r.metrics.equal_range(name_);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == this)
+      {
+        r.metrics.erase(it);
+        break;
+      }
+    }
+  }
+
+  void metric::render_sample(std::string &out, const char *suffix, const std::string &extra_label, const std::string &value) const
+  {
+    out += name_;
+    out += suffix;
+    if (!labels_.empty() || !extra_label.empty())
+    {
+      out += '{';
+      out += labels_;
+      if (!labels_.empty() && !extra_label.empty())
+        out += ',';
+      out += extra_label;
+      out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+  }
+
+  void counter::render(std::string &out) const
+  {
+    render_sample(out, "", {}, std::to_string(value()));
+  }
+
+  void gauge::render(std::string &out) const
+  {
+    render_sample(out, "", {}, std::to_string(value()));
+  }
+
+  std::uint64_t histogram::count() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (const auto &bucket: buckets_)
+      total += bucket.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  std::uint64_t histogram::quantile(double q) const noexcept
+  {
+    std::array<std::uint64_t, bucket_count> counts;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i)
+      total += (counts[i] = buckets_[i].load(std::memory_order_relaxed));
+    if (total == 0)
+      return 0;
+
+    const double rank = std::min(std::max(q, 0.0), 1.0) * total;
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i)
+    {
+      cumulative += counts[i];
+      if (counts[i] && cumulative >= rank)
+        return std::uint64_t(1) << i;
+    }
+    return std::uint64_t(1) << (bucket_count - 1);
+  }
+
+  void histogram::render(std::string &out) const
+  {
+    // the count is the sum of the buckets read here, so it always matches
+    // the +Inf bucket even while other threads are observing
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i)
+    {
+      cumulative += buckets_[i].load(std::memory_order_relaxed);
+      const std::string le = i + 1 < bucket_count ? std::to_string(std::uint64_t(1) << i) : std::string("+Inf");
+      render_sample(out, "_bucket", "le=\"" + le + "\"", std::to_string(cumulative));
+    }
+    render_sample(out, "_sum", {}, std::to_string(sum()));
+    render_sample(out, "_count", {}, std::to_string(cumulative));
+  }
+
+  std::string render(bool restricted)
+  {
+    std::string out;
+    registry &r = get_registry();
+    boost::lock_guard<boost::mutex> lock(r.mutex);
+    const std::string *family = nullptr;
+    for (const auto &e: r.metrics)
+    {
+      if (restricted && e.second->restricted())
+        continue;
+      if (!family || *family != e.first)
+      {
+        family = &e.first;
+        out += "# HELP ";
+        out += e.first;
+        out += ' ';
+        out += e.second->help();
+        out += "\n# TYPE ";
+        out += e.first;
+        out += ' ';
+        out += e.second->type();
+        out += '\n';
+      }
+      e.second->render(out);
+    }
+    return out;
+  }
+}
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tools
+{
+namespace metrics
+{
+  /*! A named value exported in the Prometheus text format by `render`.
+
+      Metrics register themselves on construction and unregister on
+      destruction, so they are normally objects with static storage (globals,
+      or function statics for the per call site ones). Updating a metric is a
+      relaxed atomic operation, only registration and `render` take a lock.
+      `name` and `help` must be string literals, `labels` is the Prometheus
+      label list without braces, eg `rpc="get_info"`. `restricted` metrics
+      carry data a restricted RPC would not give out, and are left out when
+      rendering for one. */
+  class metric
+  {
+  public:
+    metric(const char *name, const char *help, std::string labels = {}, bool restricted = false);
+    virtual ~metric();
+
+    metric(const metric&) = delete;
+    metric& operator=(const metric&) = delete;
+
+    const char *name() const noexcept { return name_; }
+    const char *help() const noexcept { return help_; }
+    const std::string &labels() const noexcept { return labels_; }
+    bool restricted() const noexcept { return restricted_; }
+
+    virtual const char *type() const noexcept = 0;
+
+    //! Appends the sample lines of this metric (no HELP/TYPE) to `out`
+    virtual void render(std::string &out) const = 0;
+
+  protected:
+    void render_sample(std::string &out, const char *suffix, const std::string &extra_label, const std::string &value) const;
+
+  private:
+    const char *const name_;
+    const char *const help_;
+    const std::string labels_;
+    const bool restricted_;
+  };
+
+  class counter final : public metric
+  {
+  public:
+    using metric::metric;
+
+    void inc(std::uint64_t n = 1) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+    //! For counters mirroring another monotonic source, updated at scrape time
+    void set(std::uint64_t v) noexcept { value_.store(v, std::memory_order_relaxed); }
+    std::uint64_t value() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+    const char *type() const noexcept override { return "counter"; }
+    void render(std::string &out) const override;
+
+  private:
+    std::atomic<std::uint64_t> value_{0};
+  };
+
+  class gauge final : public metric
+  {
+  public:
+    using metric::metric;
+
+    void set(std::int64_t v) noexcept { value_.store(v, std::memory_order_relaxed); }
+    void add(std::int64_t n) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+    std::int64_t value() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+    const char *type() const noexcept override { return "gauge"; }
+    void render(std::string &out) const override;
+
+  private:
+    std::atomic<std::int64_t> value_{0};
+  };
+
+  /*! Histogram with power of two buckets: bucket `i` counts the values in
+      (2^(i-1), 2^i], the last one everything above 2^(bucket_count-2). This
+      keeps the relative error under 2x over the whole range with a fixed
+      number of counters, which is what matters for latencies. */
+  class histogram final : public metric
+  {
+  public:
+    static constexpr std::size_t bucket_count = 40; // up to ~4.5 minutes in ns
+
+    using metric::metric;
+
+    void observe(std::uint64_t v) noexcept
+    {
+      buckets_[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+      sum_.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const noexcept;
+    std::uint64_t sum() const noexcept { return sum_.load(std::memory_order_relaxed); }
+    //! \return Upper bound of the bucket holding quantile `q` (0 to 1), 0 if nothing was observed
+    std::uint64_t quantile(double q) const noexcept;
+
+    const char *type() const noexcept override { return "histogram"; }
+    void render(std::string &out) const override;
+
+    static std::size_t bucket_index(std::uint64_t v) noexcept
+    {
+      if (v <= 1)
+        return 0;
+      std::size_t i = 0;
+      for (--v; v; v >>= 1)
+        ++i;
+      return i < bucket_count ? i : bucket_count - 1;
+    }
+
+  private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+    std::atomic<std::uint64_t> sum_{0};
+  };
+
+  //! \return Registered metrics in the Prometheus text exposition format, without the restricted ones if `restricted`
+  std::string render(bool restricted = false);
+}
+}
@@ -28,7 +28,20 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <deque>
 #include <stdarg.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 #include "misc_log_ex.h"
 #include "file_io_utils.h"
 #include "spawn.h"
@@ -40,6 +53,148 @@
 namespace tools
 {
 
+static const char batch_prefix[] = "batch:";
+static constexpr size_t max_batch_queue = 4096; //!< lines beyond this are dropped
+static constexpr std::chrono::seconds batch_restart_delay{1};
+
+#ifndef _WIN32
+//! owns the long-lived child of a batch mode Notify and its writer thread
+struct Notify::batch
+{
+  batch(const std::string &filename, std::vector<std::string> argv): filename(filename), argv(std::move(argv)), dropped(0), stopping(false), fd(-1), pid(-1),
+    last_start(std::chrono::steady_clock::now() - batch_restart_delay)
+  {
+    thread = boost::thread([this]{ run(); });
+  }
+
+  ~batch()
+  {
+    {
+      boost::lock_guard<boost::mutex> guard(lock);
+      stopping = true;
+    }
+    cond.notify_one();
+    thread.join();
+    stop_child();
+  }
+
+  void push(std::string line)
+  {
+    {
+      boost::lock_guard<boost::mutex> guard(lock);
+      if (queue.size() >= max_batch_queue)
+      {
+        if (dropped++ == 0)
+          MWARNING("Notification queue for " << filename << " is full, dropping notifications");
+        return;
+      }
+      queue.push_back(std::move(line));
+    }
+    cond.notify_one();
+  }
+
+  void run()
+  {
+    std::deque<std::string> lines;
+    bool done = false;
+    while (!done)
+    {
+      size_t dropped_before = 0;
+      {
+        boost::unique_lock<boost::mutex> guard(lock);
+        while (queue.empty() && !stopping)
+          cond.wait(guard);
+        // everything queued meanwhile goes out in one write
+        lines.swap(queue);
+        done = stopping;
+        std::swap(dropped_before, dropped);
+      }
+      if (dropped_before)
+        MWARNING("Dropped " << dropped_before << " notifications for " << filename);
+      if (lines.empty())
+        continue;
+
+      std::string buffer;
+      for (const std::string &line: lines)
+      {
+        buffer += line;
+        buffer += '\n';
+      }
+      if (fd < 0 && std::chrono::steady_clock::now() - last_start >= batch_restart_delay)
+        start_child();
+      if (fd < 0 || !send_all(buffer))
+        MWARNING("Failed to deliver " << lines.size() << " notifications to " << filename);
+      lines.clear();
+    }
+  }
+
+  void start_child()
+  {
+    last_start = std::chrono::steady_clock::now();
+    pid = tools::spawn_with_input(filename.c_str(), argv, fd);
+    if (pid < 0)
+    {
+      fd = -1;
+      return;
+    }
+    // a child not reading its input must not hold the writer forever
+    struct timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  }
+
+  void stop_child()
+  {
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+    // the child exits on EOF, it is reaped here if it already has
+    if (pid > 0)
+      waitpid(pid, NULL, WNOHANG);
+    pid = -1;
+  }
+
+  bool send_all(const std::string &buffer)
+  {
+#ifdef MSG_NOSIGNAL
+    static constexpr int flags = MSG_NOSIGNAL;
+#else
+    static constexpr int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < buffer.size())
+    {
+      const ssize_t r = send(fd, buffer.data() + sent, buffer.size() - sent, flags);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+      {
+        MWARNING("Notification program " << filename << " went away: " << strerror(errno));
+        stop_child();
+        return false;
+      }
+      sent += r;
+    }
+    return true;
+  }
+
+  const std::string filename;
+  const std::vector<std::string> argv;
+  boost::mutex lock;
+  boost::condition_variable cond;
+  std::deque<std::string> queue;
+  size_t dropped;
+  bool stopping;
+  int fd;
+  int pid;
+  std::chrono::steady_clock::time_point last_start;
+  boost::thread thread;
+};
+#else
+struct Notify::batch
+{
+};
+#endif
+
 /*
   TODO: 
   - Improve tokenization to handle paths containing whitespaces, quotes, etc.
@@ -49,12 +204,31 @@ Notify::Notify(const char *spec)
 {
   CHECK_AND_ASSERT_THROW_MES(spec, "Null spec");
 
+  const bool batched = !strncmp(spec, batch_prefix, sizeof(batch_prefix) - 1);
+  if (batched)
+    spec += sizeof(batch_prefix) - 1;
+
   boost::split(args, spec, boost::is_any_of(" \t"), boost::token_compress_on);
   CHECK_AND_ASSERT_THROW_MES(args.size() > 0, "Failed to parse spec");
   if (strchr(spec, '\'') || strchr(spec, '\"') || strchr(spec, '\\'))
     MWARNING("A notification spec contains a quote or backslash: note that these are handled verbatim, which may not be the intent");
   filename = args[0];
   CHECK_AND_ASSERT_THROW_MES(epee::file_io_utils::is_file_exist(filename), "File not found: " << filename);
+
+  if (batched)
+  {
+#ifdef _WIN32
+    MWARNING("Batched notifications are not supported on Windows, running " << filename << " for each event");
+#else
+    // arguments with tags make up the lines, the others are given at start
+    std::vector<std::string> argv{filename};
+    std::vector<std::string> line_args{filename};
+    for (size_t n = 1; n < args.size(); ++n)
+      (args[n].find('%') == std::string::npos ? argv : line_args).push_back(args[n]);
+    args = std::move(line_args);
+    batcher = std::make_shared<batch>(filename, std::move(argv));
+#endif
+  }
 }
 
 static void replace(std::vector<std::string> &v, const char *tag, const char *s)
@@ -78,6 +252,14 @@ int Notify::notify(const char *tag, const char *s, ...) const
   }
   va_end(ap);
 
+#ifndef _WIN32
+  if (batcher)
+  {
+    margs.erase(margs.begin());
+    batcher->push(boost::join(margs, " "));
+    return 0;
+  }
+#endif
   return tools::spawn(filename.c_str(), margs, false);
 }
 
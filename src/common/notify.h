@@ -29,12 +29,22 @@
 
 #pragma once 
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace tools
 {
 
+/**
+ * @brief runs a program on events, substituting tags in its arguments
+ *
+ * A spec starting with "batch:" instead starts the program once, with the
+ * spec's arguments which have no tag, and writes each event to its stdin
+ * as a line of the arguments with tags, substituted and space separated.
+ * Lines are queued, bounded, and written by a background thread, so
+ * notify never waits for the program.
+ */
 class Notify
 {
 public:
@@ -47,8 +57,11 @@ public:
   int notify(const char *tag, const char *s, ...) const;
 
 private:
+  struct batch;
+
   std::string filename;
   std::vector<std::string> args;
+  std::shared_ptr<batch> batcher; //!< shared by copies, set in batch mode
 };
 
 }
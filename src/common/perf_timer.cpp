@@ -26,7 +26,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <map>
 #include <vector>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 #include "time_helper.h"
 #include "perf_timer.h"
 
@@ -194,4 +197,49 @@ uint64_t PerformanceTimer::value() const
   return ticks_to_ns(v);
 }
 
+AggregatePerformanceTimer::~AggregatePerformanceTimer()
+{
+  pause();
+  histogram.observe(ticks_to_ns(ticks));
+}
+
+namespace
+{
+  struct aggregate_sites
+  {
+    boost::mutex mutex;
+    std::map<std::string, std::unique_ptr<metrics::histogram>> histograms;
+  };
+
+  aggregate_sites &get_aggregate_sites()
+  {
+    static aggregate_sites sites;
+    return sites;
+  }
+}
+
+metrics::histogram &get_aggregate_performance_histogram(const char *name)
+{
+  aggregate_sites &sites = get_aggregate_sites();
+  boost::lock_guard<boost::mutex> lock(sites.mutex);
+  std::unique_ptr<metrics::histogram> &histogram = sites.histograms[name];
+  if (!histogram)
+    histogram.reset(new metrics::histogram("monero_perf_nanoseconds", "Time spent in PERF_TIMER_AGG sites", std::string("site=\"") + name + "\""));
+  return *histogram;
+}
+
+std::vector<aggregate_performance_stats> get_aggregate_performance_stats()
+{
+  std::vector<aggregate_performance_stats> stats;
+  aggregate_sites &sites = get_aggregate_sites();
+  boost::lock_guard<boost::mutex> lock(sites.mutex);
+  stats.reserve(sites.histograms.size());
+  for (const auto &e: sites.histograms)
+  {
+    const metrics::histogram &h = *e.second;
+    stats.push_back({e.first, h.count(), h.sum(), h.quantile(0.5), h.quantile(0.9), h.quantile(0.99)});
+  }
+  return stats;
+}
+
 }
@@ -31,7 +31,9 @@
 #include <string>
 #include <stdio.h>
 #include <memory>
+#include <vector>
 #include "misc_log_ex.h"
+#include "metrics.h"
 
 namespace tools
 {
@@ -74,6 +76,32 @@ private:
   el::Level level;
 };
 
+//! Adds its time to a histogram rather than logging it, cheap enough to leave on in hot code
+class AggregatePerformanceTimer: public PerformanceTimer
+{
+public:
+  AggregatePerformanceTimer(metrics::histogram &histogram): histogram(histogram) {}
+  ~AggregatePerformanceTimer();
+
+private:
+  metrics::histogram &histogram;
+};
+
+//! \return The histogram of timings (ns) for the PERF_TIMER_AGG site(s) called `name`
+metrics::histogram &get_aggregate_performance_histogram(const char *name);
+
+struct aggregate_performance_stats
+{
+  std::string name;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t median_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+};
+//! \return A snapshot of all PERF_TIMER_AGG sites hit so far, sorted by name, percentiles within 2x
+std::vector<aggregate_performance_stats> get_aggregate_performance_stats();
+
 void set_performance_timer_log_level(el::Level level);
 
 #define PERF_TIMER_NAME(name) pt_##name
@@ -86,5 +114,8 @@ void set_performance_timer_log_level(el::Level level);
 #define PERF_TIMER_STOP(name) do { PERF_TIMER_NAME(name).reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) PERF_TIMER_NAME(name).pause()
 #define PERF_TIMER_RESUME(name) PERF_TIMER_NAME(name).resume()
+#define PERF_TIMER_AGG(name) \
+  static tools::metrics::histogram &PERF_TIMER_NAME(name##_histogram) = tools::get_aggregate_performance_histogram(#name); \
+  tools::AggregatePerformanceTimer PERF_TIMER_NAME(name)(PERF_TIMER_NAME(name##_histogram))
 
 }
@@ -35,7 +35,9 @@
 #include <boost/scope_exit.hpp>
 #include <windows.h>
 #else
+#include <sys/socket.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <signal.h>
 #endif
 
@@ -149,4 +151,53 @@ int spawn(const char *filename, const std::vector<std::string>& args, bool wait)
 #endif
 }
 
+#ifndef _WIN32
+int spawn_with_input(const char *filename, const std::vector<std::string>& args, int &input_fd)
+{
+  std::vector<char*> argv(args.size() + 1);
+  for (size_t n = 0; n < args.size(); ++n)
+    argv[n] = (char*)args[n].c_str();
+  argv[args.size()] = NULL;
+
+  // a socket rather than a pipe, so a dead child fails sends instead of raising SIGPIPE
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+  {
+    MERROR("Error creating socket pair: " << strerror(errno));
+    return -1;
+  }
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    MERROR("Error forking: " << strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  // child
+  if (pid == 0)
+  {
+    if (dup2(fds[1], 0) < 0)
+      _exit(1);
+    tools::closefrom(3);
+    char *envp[] = {NULL};
+    execve(filename, argv.data(), envp);
+    MERROR("Failed to execve: " << strerror(errno));
+    _exit(1);
+  }
+
+  // parent
+  close(fds[1]);
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  input_fd = fds[0];
+  return pid;
+}
+#endif
+
 }
@@ -34,4 +34,15 @@ namespace tools
 
 int spawn(const char *filename, const std::vector<std::string>& args, bool wait);
 
+#ifndef _WIN32
+/**
+ * @brief starts a program with a stream socket as its stdin
+ *
+ * @param input_fd return-by-reference the parent's end of the socket
+ *
+ * @return the child's pid, or -1 on error
+ */
+int spawn_with_input(const char *filename, const std::vector<std::string>& args, int &input_fd);
+#endif
+
 }
@@ -26,6 +26,7 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "misc_log_ex.h"
+#include "time_helper.h"
 #include "common/threadpool.h"
 
 #include "cryptonote_config.h"
@@ -33,10 +34,12 @@
 
 static __thread int depth = 0;
 static __thread bool is_leaf = false;
+static __thread const tools::threadpool *worker_pool = NULL;
+static __thread size_t worker_queue = 0;
 
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) : running(true), active(0) {
+threadpool::threadpool(unsigned int max_threads) : pending(0), submitted(0), inlined(0), next_queue(0), idle(0), active(0), running(true) {
   create(max_threads);
 }
 
@@ -76,19 +79,35 @@ void threadpool::create(unsigned int max_threads) {
   attrs.set_stack_size(THREAD_STACK_SIZE);
   max = max_threads ? max_threads : tools::get_max_concurrency();
   size_t i = max ? max - 1 : 0;
+
+  // tasks left over from before a recycle go to the new queue 0
+  std::deque<entry> leftover;
+  for (auto &q: queues)
+    for (auto &e: q->jobs)
+      leftover.push_back(std::move(e));
+  queues.clear();
+  for (size_t n = 0; n <= i; ++n)
+    queues.emplace_back(new job_queue());
+  queues[0]->jobs = std::move(leftover);
+
   running = true;
-  while(i--) {
-    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, false)));
+  for (size_t n = 1; n <= i; ++n) {
+    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, n)));
   }
 }
 
+size_t threadpool::local_queue() {
+  if (worker_pool == this)
+    return worker_queue;
+  return next_queue++ % queues.size();
+}
+
 void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  boost::unique_lock<boost::mutex> lock(mutex);
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
+  if (!leaf && ((active == max && pending > 0) || depth > 0)) {
     // if all available threads are already running
     // and there's work waiting, just run in current thread
-    lock.unlock();
+    ++inlined;
     ++depth;
     is_leaf = leaf;
     f();
@@ -97,11 +116,23 @@ void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   } else {
     if (obj)
       obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
-    else
-      queue.push_back({obj, f, leaf});
-    has_work.notify_one();
+    // counted before it can be seen, so pending never drops below the queued count
+    ++pending;
+    job_queue &q = *queues[local_queue()];
+    {
+      const boost::unique_lock<boost::mutex> lock(q.mutex);
+      if (leaf)
+        q.jobs.push_front({obj, std::move(f), leaf});
+      else
+        q.jobs.push_back({obj, std::move(f), leaf});
+    }
+    ++submitted;
+    // a worker going to sleep bumps idle before checking pending, so one of
+    // the two sides is guaranteed to see the other's update
+    if (idle > 0) {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      has_work.notify_one();
+    }
   }
 }
 
@@ -109,6 +140,17 @@ unsigned int threadpool::get_max_concurrency() const {
   return max;
 }
 
+threadpool::stats threadpool::get_stats() const {
+  stats s{submitted, inlined, 0, 0, 0, pending, (unsigned int)threads.size()};
+  for (const auto &q: queues)
+  {
+    s.executed += q->executed;
+    s.steals += q->steals;
+    s.idle_ns += q->idle_ns;
+  }
+  return s;
+}
+
 threadpool::waiter::~waiter()
 {
   try
@@ -129,10 +171,22 @@ threadpool::waiter::~waiter()
 }
 
 bool threadpool::waiter::wait() {
-  pool.run(true);
-  boost::unique_lock<boost::mutex> lock(mt);
-  while(num)
-    cv.wait(lock);
+  while (true)
+  {
+    {
+      const boost::unique_lock<boost::mutex> lock(mt);
+      if (!num)
+        break;
+    }
+    // help with whatever is queued rather than block while tasks are left
+    if (pool.run_one())
+      continue;
+    boost::unique_lock<boost::mutex> lock(mt);
+    if (!num)
+      break;
+    // woken up by dec, the timeout picks up tasks queued by our running ones
+    cv.wait_for(lock, boost::chrono::milliseconds(1));
+  }
   return !error();
 }
 
@@ -148,33 +202,72 @@ void threadpool::waiter::dec() {
     cv.notify_all();
 }
 
-void threadpool::run(bool flush) {
-  boost::unique_lock<boost::mutex> lock(mutex);
+bool threadpool::pop(size_t index, entry &e) {
+  {
+    job_queue &q = *queues[index];
+    const boost::unique_lock<boost::mutex> lock(q.mutex);
+    if (!q.jobs.empty()) {
+      e = std::move(q.jobs.front());
+      q.jobs.pop_front();
+      --pending;
+      return true;
+    }
+  }
+  for (size_t n = 1; n < queues.size(); ++n) {
+    job_queue &q = *queues[(index + n) % queues.size()];
+    const boost::unique_lock<boost::mutex> lock(q.mutex);
+    if (!q.jobs.empty()) {
+      e = std::move(q.jobs.back());
+      q.jobs.pop_back();
+      --pending;
+      ++queues[index]->steals;
+      return true;
+    }
+  }
+  return false;
+}
+
+void threadpool::execute(size_t index, entry &e) {
+  active++;
+  ++depth;
+  is_leaf = e.leaf;
+  try { e.f(); }
+  catch (const std::exception &ex) { if (e.wo) e.wo->set_error(); try { MERROR("Exception in threadpool job: " << ex.what()); } catch (...) {} }
+  --depth;
+  is_leaf = false;
+  ++queues[index]->executed;
+
+  if (e.wo)
+    e.wo->dec();
+  active--;
+}
+
+bool threadpool::run_one() {
+  const size_t index = worker_pool == this ? worker_queue : 0;
+  entry e;
+  if (!pop(index, e))
+    return false;
+  execute(index, e);
+  return true;
+}
+
+void threadpool::run(size_t index) {
+  worker_pool = this;
+  worker_queue = index;
   while (running) {
     entry e;
-    while(queue.empty() && running)
-    {
-      if (flush)
-        return;
-      has_work.wait(lock);
+    if (pop(index, e)) {
+      execute(index, e);
+      continue;
     }
-    if (!running) break;
-
-    active++;
-    e = std::move(queue.front());
-    queue.pop_front();
-    lock.unlock();
-    ++depth;
-    is_leaf = e.leaf;
-    try { e.f(); }
-    catch (const std::exception &ex) { e.wo->set_error(); try { MERROR("Exception in threadpool job: " << ex.what()); } catch (...) {} }
-    --depth;
-    is_leaf = false;
 
-    if (e.wo)
-      e.wo->dec();
-    lock.lock();
-    active--;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    ++idle;
+    const uint64_t t0 = epee::misc_utils::get_ns_count();
+    while (pending == 0 && running)
+      has_work.wait(lock);
+    queues[index]->idle_ns += epee::misc_utils::get_ns_count() - t0;
+    --idle;
   }
 }
 }
@@ -30,9 +30,12 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <stdexcept>
@@ -66,7 +69,7 @@ public:
     public:
     void inc();
     void dec();
-    bool wait();  //! Wait for a set of tasks to finish, returns false iff any error
+    bool wait();  //! Wait for a set of tasks to finish, running queued tasks meanwhile, returns false iff any error
     void set_error() noexcept { error_flag = true; }
     bool error() const noexcept { return error_flag; }
     waiter(threadpool &pool) : pool(pool), num(0), error_flag(false) {}
@@ -83,6 +86,18 @@ public:
 
   unsigned int get_max_concurrency() const;
 
+  struct stats
+  {
+    uint64_t submitted;   //!< tasks queued
+    uint64_t inlined;     //!< tasks run right away by the submitting thread
+    uint64_t executed;    //!< queued tasks run so far, by workers or by waiting callers
+    uint64_t steals;      //!< queued tasks taken from another thread's queue
+    uint64_t idle_ns;     //!< time the worker threads spent waiting for work
+    uint64_t queue_depth; //!< tasks currently queued
+    unsigned int threads; //!< worker threads
+  };
+  stats get_stats() const;
+
   ~threadpool();
 
   private:
@@ -94,14 +109,33 @@ public:
       std::function<void()> f;
       bool leaf;
     } entry;
-    std::deque<entry> queue;
+    // Each worker thread has its own queue, which it takes from the front of
+    // and other threads steal from the back of. Threads outside the pool spread
+    // their tasks over all the queues, and look at queue 0, which has no worker
+    // of its own, first when running tasks while they wait.
+    struct job_queue {
+      boost::mutex mutex;
+      std::deque<entry> jobs;
+      std::atomic<uint64_t> executed{0};
+      std::atomic<uint64_t> steals{0};
+      std::atomic<uint64_t> idle_ns{0};
+    };
+    std::vector<std::unique_ptr<job_queue>> queues;
+    std::atomic<uint64_t> pending;
+    std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> inlined;
+    std::atomic<unsigned int> next_queue;
+    std::atomic<unsigned int> idle;
     boost::condition_variable has_work;
     boost::mutex mutex;
     std::vector<boost::thread> threads;
-    unsigned int active;
+    std::atomic<unsigned int> active;
     unsigned int max;
-    bool running;
-    void run(bool flush = false);
+    std::atomic<bool> running;
+    size_t local_queue();
+    bool pop(size_t index, entry &e);
+    void execute(size_t index, entry &e);
+    bool run_one();
+    void run(size_t index);
 };
-
 }
@@ -48,6 +48,20 @@ namespace crypto {
 #endif
     void chacha8(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
     void chacha20(const void* data, size_t length, const uint8_t* key, const uint8_t* iv, char* cipher);
+
+    /* Streaming interface: chacha_update may be called any number of times, with any
+     * lengths, and produces the same output as a single chacha8/chacha20 call on the
+     * concatenated data. The state holds key material, and should be wiped after use.
+     */
+    typedef struct chacha_state {
+      uint32_t input[16];
+      uint8_t keystream[64];
+      unsigned int keystream_used;
+      unsigned int rounds;
+    } chacha_state;
+    void chacha8_init(chacha_state *state, const uint8_t* key, const uint8_t* iv);
+    void chacha20_init(chacha_state *state, const uint8_t* key, const uint8_t* iv);
+    void chacha_update(chacha_state *state, const void* data, size_t length, char* cipher);
 #if defined(__cplusplus)
   }
 
@@ -70,6 +84,23 @@ namespace crypto {
     chacha20(data, length, key.data(), reinterpret_cast<const uint8_t*>(&iv), cipher);
   }
 
+  class chacha20_stream {
+  public:
+    chacha20_stream(const chacha_key& key, const chacha_iv& iv) {
+      chacha20_init(&state, key.data(), reinterpret_cast<const uint8_t*>(&iv));
+    }
+    ~chacha20_stream() { memwipe(&state, sizeof(state)); }
+    chacha20_stream(const chacha20_stream&) = delete;
+    chacha20_stream& operator=(const chacha20_stream&) = delete;
+
+    void update(const void* data, std::size_t length, char* cipher) {
+      chacha_update(&state, data, length, cipher);
+    }
+
+  private:
+    chacha_state state;
+  };
+
   inline void generate_chacha_key(const void *data, size_t size, chacha_key& key, uint64_t kdf_rounds) {
     static_assert(sizeof(chacha_key) <= sizeof(hash), "Size of hash must be at least that of chacha_key");
     epee::mlocked<tools::scrubbed_arr<char, HASH_SIZE>> pwd_hash;
@@ -253,9 +253,211 @@ static void fe_copy(fe h, const fe f) {
   h[9] = f9;
 }
 
+/* Radix 2^51 field arithmetic */
+
+/*
+On targets with a 64x64->128 multiplier, the long exponentiation chains in
+fe_invert and fe_divpowm1 (which dominate ge_frombytes_vartime, ge_tobytes
+and ge_p3_tobytes) run in five 51-bit limbs, which needs about a third of
+the multiplications of the 32-bit ref10 limbs. Only the chains use it, with
+a conversion at each end, so callers keep seeing ref10 field elements.
+*/
+
+#if defined(__SIZEOF_INT128__)
+#define CRYPTO_OPS_FE51
+
+typedef uint64_t fe51[5];
+typedef unsigned __int128 fe51_uint128;
+
+#define FE51_MASK ((((uint64_t) 1) << 51) - 1)
+
+/*
+f[2i] holds bits 51i..51i+25 and f[2i+1] bits 51i+26..51i+50, so each pair
+folds into one limb; 8*q is added so every limb is positive before carrying.
+
+Preconditions:
+   |f| bounded by 1.1*2^27,1.1*2^26,1.1*2^27,1.1*2^26,etc.
+
+Postconditions:
+   h[1] bounded by 2^51+2^13, the other limbs by 2^51.
+*/
+
+static void fe51_from_fe(fe51 h, const fe f) {
+  uint64_t h0 = (uint64_t) ((int64_t) f[0] + (int64_t) f[1] * ((int64_t) 1 << 26) + (int64_t) (8 * (FE51_MASK - 18)));
+  uint64_t h1 = (uint64_t) ((int64_t) f[2] + (int64_t) f[3] * ((int64_t) 1 << 26) + (int64_t) (8 * FE51_MASK));
+  uint64_t h2 = (uint64_t) ((int64_t) f[4] + (int64_t) f[5] * ((int64_t) 1 << 26) + (int64_t) (8 * FE51_MASK));
+  uint64_t h3 = (uint64_t) ((int64_t) f[6] + (int64_t) f[7] * ((int64_t) 1 << 26) + (int64_t) (8 * FE51_MASK));
+  uint64_t h4 = (uint64_t) ((int64_t) f[8] + (int64_t) f[9] * ((int64_t) 1 << 26) + (int64_t) (8 * FE51_MASK));
+
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+  h2 += h1 >> 51; h1 &= FE51_MASK;
+  h3 += h2 >> 51; h2 &= FE51_MASK;
+  h4 += h3 >> 51; h3 &= FE51_MASK;
+  h0 += (h4 >> 51) * 19; h4 &= FE51_MASK;
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/*
+Postconditions:
+   |h| bounded by 2^26,2^25+1,2^26,2^25,etc.
+*/
+
+static void fe51_to_fe(fe h, const fe51 f) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+
+  f1 += f0 >> 51; f0 &= FE51_MASK;
+  f2 += f1 >> 51; f1 &= FE51_MASK;
+  f3 += f2 >> 51; f2 &= FE51_MASK;
+  f4 += f3 >> 51; f3 &= FE51_MASK;
+  f0 += (f4 >> 51) * 19; f4 &= FE51_MASK;
+  f1 += f0 >> 51; f0 &= FE51_MASK;
+
+  h[0] = (int32_t) (f0 & 67108863); h[1] = (int32_t) (f0 >> 26);
+  h[2] = (int32_t) (f1 & 67108863); h[3] = (int32_t) (f1 >> 26);
+  h[4] = (int32_t) (f2 & 67108863); h[5] = (int32_t) (f2 >> 26);
+  h[6] = (int32_t) (f3 & 67108863); h[7] = (int32_t) (f3 >> 26);
+  h[8] = (int32_t) (f4 & 67108863); h[9] = (int32_t) (f4 >> 26);
+}
+
+static void fe51_reduce(fe51 h, fe51_uint128 r0, fe51_uint128 r1, fe51_uint128 r2, fe51_uint128 r3, fe51_uint128 r4) {
+  uint64_t h0, h1;
+
+  r1 += (uint64_t) (r0 >> 51); h0 = (uint64_t) r0 & FE51_MASK;
+  r2 += (uint64_t) (r1 >> 51); h1 = (uint64_t) r1 & FE51_MASK;
+  r3 += (uint64_t) (r2 >> 51); h[2] = (uint64_t) r2 & FE51_MASK;
+  r4 += (uint64_t) (r3 >> 51); h[3] = (uint64_t) r3 & FE51_MASK;
+  h0 += (uint64_t) (r4 >> 51) * 19; h[4] = (uint64_t) r4 & FE51_MASK;
+  h1 += h0 >> 51; h0 &= FE51_MASK;
+
+  h[0] = h0;
+  h[1] = h1;
+}
+
+/*
+h = f * g
+Can overlap h with f or g.
+
+Preconditions:
+   |f|, |g| bounded by 2^51+2^13.
+
+Postconditions:
+   h[1] bounded by 2^51+2^13, the other limbs by 2^51.
+*/
+
+static void fe51_mul(fe51 h, const fe51 f, const fe51 g) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+  uint64_t g0 = g[0];
+  uint64_t g1 = g[1];
+  uint64_t g2 = g[2];
+  uint64_t g3 = g[3];
+  uint64_t g4 = g[4];
+  uint64_t g1_19 = 19 * g1;
+  uint64_t g2_19 = 19 * g2;
+  uint64_t g3_19 = 19 * g3;
+  uint64_t g4_19 = 19 * g4;
+
+  fe51_uint128 r0 = (fe51_uint128) f0 * g0 + (fe51_uint128) f1 * g4_19 + (fe51_uint128) f2 * g3_19 + (fe51_uint128) f3 * g2_19 + (fe51_uint128) f4 * g1_19;
+  fe51_uint128 r1 = (fe51_uint128) f0 * g1 + (fe51_uint128) f1 * g0 + (fe51_uint128) f2 * g4_19 + (fe51_uint128) f3 * g3_19 + (fe51_uint128) f4 * g2_19;
+  fe51_uint128 r2 = (fe51_uint128) f0 * g2 + (fe51_uint128) f1 * g1 + (fe51_uint128) f2 * g0 + (fe51_uint128) f3 * g4_19 + (fe51_uint128) f4 * g3_19;
+  fe51_uint128 r3 = (fe51_uint128) f0 * g3 + (fe51_uint128) f1 * g2 + (fe51_uint128) f2 * g1 + (fe51_uint128) f3 * g0 + (fe51_uint128) f4 * g4_19;
+  fe51_uint128 r4 = (fe51_uint128) f0 * g4 + (fe51_uint128) f1 * g3 + (fe51_uint128) f2 * g2 + (fe51_uint128) f3 * g1 + (fe51_uint128) f4 * g0;
+
+  fe51_reduce(h, r0, r1, r2, r3, r4);
+}
+
+/*
+h = f^(2^n), n >= 1
+Can overlap h with f.
+
+Preconditions and postconditions as for fe51_mul.
+*/
+
+static void fe51_sq_n(fe51 h, const fe51 f, int n) {
+  uint64_t f0 = f[0];
+  uint64_t f1 = f[1];
+  uint64_t f2 = f[2];
+  uint64_t f3 = f[3];
+  uint64_t f4 = f[4];
+
+  while (n-- > 0) {
+    uint64_t f0_2 = 2 * f0;
+    uint64_t f1_2 = 2 * f1;
+    uint64_t f3_19 = 19 * f3;
+    uint64_t f4_19 = 19 * f4;
+    fe51 t;
+
+    fe51_uint128 r0 = (fe51_uint128) f0 * f0 + (fe51_uint128) f1_2 * f4_19 + (fe51_uint128) (2 * f2) * f3_19;
+    fe51_uint128 r1 = (fe51_uint128) f0_2 * f1 + (fe51_uint128) (2 * f2) * f4_19 + (fe51_uint128) f3 * f3_19;
+    fe51_uint128 r2 = (fe51_uint128) f0_2 * f2 + (fe51_uint128) f1 * f1 + (fe51_uint128) (2 * f3) * f4_19;
+    fe51_uint128 r3 = (fe51_uint128) f0_2 * f3 + (fe51_uint128) f1_2 * f2 + (fe51_uint128) f4 * f4_19;
+    fe51_uint128 r4 = (fe51_uint128) f0_2 * f4 + (fe51_uint128) f1_2 * f3 + (fe51_uint128) f2 * f2;
+
+    fe51_reduce(t, r0, r1, r2, r3, r4);
+    f0 = t[0];
+    f1 = t[1];
+    f2 = t[2];
+    f3 = t[3];
+    f4 = t[4];
+  }
+
+  h[0] = f0;
+  h[1] = f1;
+  h[2] = f2;
+  h[3] = f3;
+  h[4] = f4;
+}
+
+static void fe51_sq(fe51 h, const fe51 f) {
+  fe51_sq_n(h, f, 1);
+}
+
+#endif
+
 /* From fe_invert.c */
 
 void fe_invert(fe out, const fe z) {
+#ifdef CRYPTO_OPS_FE51
+  fe51 z51, t0, t1, t2, t3;
+
+  fe51_from_fe(z51, z);
+  fe51_sq(t0, z51);
+  fe51_sq_n(t1, t0, 2);
+  fe51_mul(t1, z51, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t2, t0);
+  fe51_mul(t1, t1, t2);
+  fe51_sq_n(t2, t1, 5);
+  fe51_mul(t1, t2, t1);
+  fe51_sq_n(t2, t1, 10);
+  fe51_mul(t2, t2, t1);
+  fe51_sq_n(t3, t2, 20);
+  fe51_mul(t2, t3, t2);
+  fe51_sq_n(t2, t2, 10);
+  fe51_mul(t1, t2, t1);
+  fe51_sq_n(t2, t1, 50);
+  fe51_mul(t2, t2, t1);
+  fe51_sq_n(t3, t2, 100);
+  fe51_mul(t2, t3, t2);
+  fe51_sq_n(t2, t2, 50);
+  fe51_mul(t1, t2, t1);
+  fe51_sq_n(t1, t1, 5);
+  fe51_mul(t1, t1, t0);
+  fe51_to_fe(out, t1);
+#else
   fe t0;
   fe t1;
   fe t2;
@@ -309,6 +511,7 @@ void fe_invert(fe out, const fe z) {
     fe_sq(t1, t1);
   }
   fe_mul(out, t1, t0);
+#endif
 
   return;
 }
@@ -1574,6 +1777,69 @@ void ge_p3_tobytes(unsigned char *s, const ge_p3 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* New code */
+
+/*
+Encodes n points into n consecutive 32 byte strings, as ge_p3_tobytes
+would. The Z inversions are shared with Montgomery's trick, so a chunk of
+points costs one inversion and three multiplications per point.
+*/
+
+#define GE_P3_BATCH_TOBYTES_CHUNK 64
+
+/* X, Y and Z point to the coordinates of the first point, and the next point's are stride fe further */
+static void ge_batch_tobytes(unsigned char *s, const fe *X, const fe *Y, const fe *Z, size_t stride, size_t n) {
+  fe acc[GE_P3_BATCH_TOBYTES_CHUNK];
+  fe inv;
+  fe recip;
+  fe x;
+  fe y;
+  size_t i, m;
+
+  while (n > 0) {
+    m = n < GE_P3_BATCH_TOBYTES_CHUNK ? n : GE_P3_BATCH_TOBYTES_CHUNK;
+
+    /* acc[i] = Z_0 * ... * Z_i */
+    fe_copy(acc[0], Z[0]);
+    for (i = 1; i < m; ++i) {
+      fe_mul(acc[i], acc[i - 1], Z[i * stride]);
+    }
+    fe_invert(inv, acc[m - 1]);
+
+    for (i = m - 1; i > 0; --i) {
+      fe_mul(recip, inv, acc[i - 1]);   /* 1/Z_i */
+      fe_mul(inv, inv, Z[i * stride]);  /* 1/(Z_0 * ... * Z_{i-1}) */
+      fe_mul(x, X[i * stride], recip);
+      fe_mul(y, Y[i * stride], recip);
+      fe_tobytes(s + 32 * i, y);
+      s[32 * i + 31] ^= fe_isnegative(x) << 7;
+    }
+    fe_mul(x, X[0], inv);
+    fe_mul(y, Y[0], inv);
+    fe_tobytes(s, y);
+    s[31] ^= fe_isnegative(x) << 7;
+
+    s += 32 * m;
+    X += m * stride;
+    Y += m * stride;
+    Z += m * stride;
+    n -= m;
+  }
+}
+
+void ge_p3_batch_tobytes(unsigned char *s, const ge_p3 *h, size_t n) {
+  if (n > 0) {
+    ge_batch_tobytes(s, &h->X, &h->Y, &h->Z, sizeof(ge_p3) / sizeof(fe), n);
+  }
+}
+
+/* As ge_p3_batch_tobytes, for points in projective coordinates, as ge_tobytes would */
+void ge_p2_batch_tobytes(unsigned char *s, const ge_p2 *h, size_t n) {
+  if (n > 0) {
+    ge_batch_tobytes(s, &h->X, &h->Y, &h->Z, sizeof(ge_p2) / sizeof(fe), n);
+  }
+}
+
 /* From ge_precomp_0.c */
 
 static void ge_precomp_0(ge_precomp *h) {
@@ -1956,6 +2222,46 @@ void sc_reduce(unsigned char *s) {
 /* New code */
 
 static void fe_divpowm1(fe r, const fe u, const fe v) {
+#ifdef CRYPTO_OPS_FE51
+  fe51 u51, v51, v3, uv7, t0, t1, t2;
+
+  fe51_from_fe(u51, u);
+  fe51_from_fe(v51, v);
+  fe51_sq(v3, v51);
+  fe51_mul(v3, v3, v51); /* v3 = v^3 */
+  fe51_sq(uv7, v3);
+  fe51_mul(uv7, uv7, v51);
+  fe51_mul(uv7, uv7, u51); /* uv7 = uv^7 */
+
+  /* fe_pow22523, as below */
+  fe51_sq(t0, uv7);
+  fe51_sq_n(t1, t0, 2);
+  fe51_mul(t1, uv7, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t0, t0);
+  fe51_mul(t0, t1, t0);
+  fe51_sq_n(t1, t0, 5);
+  fe51_mul(t0, t1, t0);
+  fe51_sq_n(t1, t0, 10);
+  fe51_mul(t1, t1, t0);
+  fe51_sq_n(t2, t1, 20);
+  fe51_mul(t1, t2, t1);
+  fe51_sq_n(t1, t1, 10);
+  fe51_mul(t0, t1, t0);
+  fe51_sq_n(t1, t0, 50);
+  fe51_mul(t1, t1, t0);
+  fe51_sq_n(t2, t1, 100);
+  fe51_mul(t1, t2, t1);
+  fe51_sq_n(t1, t1, 50);
+  fe51_mul(t0, t1, t0);
+  fe51_sq_n(t0, t0, 2);
+  fe51_mul(t0, t0, uv7);
+
+  /* t0 = (uv^7)^((q-5)/8) */
+  fe51_mul(t0, t0, v3);
+  fe51_mul(t0, t0, u51); /* u^(m+1)v^(-(m+1)) */
+  fe51_to_fe(r, t0);
+#else
   fe v3, uv7, t0, t1, t2;
   int i;
 
@@ -2017,6 +2323,7 @@ static void fe_divpowm1(fe r, const fe u, const fe v) {
   /* t0 = (uv^7)^((q-5)/8) */
   fe_mul(t0, t0, v3);
   fe_mul(r, t0, u); /* u^(m+1)v^(-(m+1)) */
+#endif
 }
 
 static void ge_cached_0(ge_cached *r) {
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* From fe.h */
@@ -114,6 +115,8 @@ void ge_p3_to_p2(ge_p2 *, const ge_p3 *);
 /* From ge_p3_tobytes.c */
 
 void ge_p3_tobytes(unsigned char *, const ge_p3 *);
+void ge_p3_batch_tobytes(unsigned char *, const ge_p3 *, size_t);
+void ge_p2_batch_tobytes(unsigned char *, const ge_p2 *, size_t);
 
 /* From ge_scalarmult_base.c */
 
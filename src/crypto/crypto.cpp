@@ -202,6 +202,23 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const public_key *keys1, const secret_key &key2, key_derivation *derivations, std::size_t count) {
+    std::vector<ge_p2> points(count);
+    assert(sc_check(&key2) == 0);
+    for (size_t i = 0; i < count; ++i) {
+      ge_p3 point;
+      ge_p1p1 point3;
+      if (ge_frombytes_vartime(&point, &keys1[i]) != 0) {
+        return false;
+      }
+      ge_scalarmult(&points[i], &unwrap(key2), &point);
+      ge_mul8(&point3, &points[i]);
+      ge_p1p1_to_p2(&points[i], &point3);
+    }
+    ge_p2_batch_tobytes(reinterpret_cast<unsigned char*>(derivations), points.data(), count);
+    return true;
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -234,6 +251,28 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::derive_public_keys(const key_derivation *derivations, const std::size_t *output_indices,
+    const public_key *bases, public_key *derived_keys, std::size_t count) {
+    std::vector<ge_p2> points(count);
+    for (size_t i = 0; i < count; ++i) {
+      ec_scalar scalar;
+      ge_p3 point1;
+      ge_p3 point2;
+      ge_cached point3;
+      ge_p1p1 point4;
+      if (ge_frombytes_vartime(&point1, &bases[i]) != 0) {
+        return false;
+      }
+      derivation_to_scalar(derivations[i], output_indices[i], scalar);
+      ge_scalarmult_base(&point2, &scalar);
+      ge_p3_to_cached(&point3, &point2);
+      ge_add(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&points[i], &point4);
+    }
+    ge_p2_batch_tobytes(reinterpret_cast<unsigned char*>(derived_keys), points.data(), count);
+    return true;
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -340,6 +379,40 @@ namespace crypto {
     return sc_isnonzero(&c) == 0;
   }
 
+  bool crypto_ops::check_signatures(const hash &prefix_hash, const public_key *pubs, const signature *sigs, std::size_t count) {
+    // the commitments are computed first, so that they can be encoded with a single inversion
+    std::vector<ge_p2> comms(count);
+    std::vector<ec_point> comm_bytes(count);
+    for (size_t i = 0; i < count; ++i) {
+      ge_p3 tmp3;
+      assert(check_key(pubs[i]));
+      if (ge_frombytes_vartime(&tmp3, &pubs[i]) != 0) {
+        return false;
+      }
+      if (sc_check(&sigs[i].c) != 0 || sc_check(&sigs[i].r) != 0 || !sc_isnonzero(&sigs[i].c)) {
+        return false;
+      }
+      ge_double_scalarmult_base_vartime(&comms[i], &sigs[i].c, &tmp3, &sigs[i].r);
+    }
+    ge_p2_batch_tobytes(reinterpret_cast<unsigned char*>(comm_bytes.data()), comms.data(), count);
+
+    static const ec_point infinity = {{ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
+    for (size_t i = 0; i < count; ++i) {
+      ec_scalar c;
+      s_comm buf;
+      buf.h = prefix_hash;
+      buf.key = pubs[i];
+      buf.comm = comm_bytes[i];
+      if (memcmp(&buf.comm, &infinity, 32) == 0)
+        return false;
+      hash_to_scalar(&buf, sizeof(s_comm), c);
+      sc_sub(&c, &c, &sigs[i].c);
+      if (sc_isnonzero(&c) != 0)
+        return false;
+    }
+    return true;
+  }
+
   // Generate a proof of knowledge of `r` such that (`R = rG` and `D = rA`) or (`R = rB` and `D = rA`) via a Schnorr proof
   // This handles use cases for both standard addresses and subaddresses
   //
@@ -627,6 +700,17 @@ namespace crypto {
     ge_tobytes(&image, &point2);
   }
 
+  void crypto_ops::generate_key_images(const public_key *pubs, const secret_key *secs, key_image *images, std::size_t count) {
+    std::vector<ge_p2> points(count);
+    for (size_t i = 0; i < count; ++i) {
+      ge_p3 point;
+      assert(sc_check(&secs[i]) == 0);
+      hash_to_ec(pubs[i], point);
+      ge_scalarmult(&points[i], &unwrap(secs[i]), &point);
+    }
+    ge_p2_batch_tobytes(reinterpret_cast<unsigned char*>(images), points.data(), count);
+  }
+
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4200)
   struct ec_point_pair {
@@ -729,8 +813,10 @@ POP_WARNINGS
     ge_dsm_precomp(image_pre, &image_unp);
     sc_0(&sum);
     buf->h = prefix_hash;
+    // the a and b of every ring member are computed first, so that they can
+    // be encoded into buf with a single inversion
+    std::vector<ge_p2> ab(2 * pubs_count);
     for (i = 0; i < pubs_count; i++) {
-      ge_p2 tmp2;
       ge_p3 tmp3;
       if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
         return false;
@@ -738,13 +824,13 @@ POP_WARNINGS
       if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
         return false;
       }
-      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
-      ge_tobytes(&buf->ab[i].a, &tmp2);
+      ge_double_scalarmult_base_vartime(&ab[2 * i], &sig[i].c, &tmp3, &sig[i].r);
       hash_to_ec(*pubs[i], tmp3);
-      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
-      ge_tobytes(&buf->ab[i].b, &tmp2);
+      ge_double_scalarmult_precomp_vartime(&ab[2 * i + 1], &sig[i].r, &tmp3, &sig[i].c, image_pre);
       sc_add(&sum, &sum, &sig[i].c);
     }
+    static_assert(sizeof(ec_point_pair) == 2 * sizeof(ec_point), "Unexpected ec_point_pair padding");
+    ge_p2_batch_tobytes(reinterpret_cast<unsigned char*>(buf->ab), ab.data(), ab.size());
     hash_to_scalar(buf.get(), rs_comm_size(pubs_count), h);
     sc_sub(&h, &h, &sum);
     return sc_isnonzero(&h) == 0;
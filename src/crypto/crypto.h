@@ -127,10 +127,14 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static bool generate_key_derivations(const public_key *, const secret_key &, key_derivation *, std::size_t);
+    friend bool generate_key_derivations(const public_key *, const secret_key &, key_derivation *, std::size_t);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool derive_public_keys(const key_derivation *, const std::size_t *, const public_key *, public_key *, std::size_t);
+    friend bool derive_public_keys(const key_derivation *, const std::size_t *, const public_key *, public_key *, std::size_t);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
@@ -139,6 +143,8 @@ namespace crypto {
     friend void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
     static bool check_signature(const hash &, const public_key &, const signature &);
     friend bool check_signature(const hash &, const public_key &, const signature &);
+    static bool check_signatures(const hash &, const public_key *, const signature *, std::size_t);
+    friend bool check_signatures(const hash &, const public_key *, const signature *, std::size_t);
     static void generate_tx_proof(const hash &, const public_key &, const public_key &, const boost::optional<public_key> &, const public_key &, const secret_key &, signature &);
     friend void generate_tx_proof(const hash &, const public_key &, const public_key &, const boost::optional<public_key> &, const public_key &, const secret_key &, signature &);
     static void generate_tx_proof_v1(const hash &, const public_key &, const public_key &, const boost::optional<public_key> &, const public_key &, const secret_key &, signature &);
@@ -147,6 +153,8 @@ namespace crypto {
     friend bool check_tx_proof(const hash &, const public_key &, const public_key &, const boost::optional<public_key> &, const public_key &, const signature &, const int);
     static void generate_key_image(const public_key &, const secret_key &, key_image &);
     friend void generate_key_image(const public_key &, const secret_key &, key_image &);
+    static void generate_key_images(const public_key *, const secret_key *, key_image *, std::size_t);
+    friend void generate_key_images(const public_key *, const secret_key *, key_image *, std::size_t);
     static void generate_ring_signature(const hash &, const key_image &,
       const public_key *const *, std::size_t, const secret_key &, std::size_t, signature *);
     friend void generate_ring_signature(const hash &, const key_image &,
@@ -234,6 +242,16 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Batched versions of the above: the resulting points are encoded together, sharing a
+   * single field inversion. They fail as a whole if any of the input points is invalid.
+   */
+  inline bool generate_key_derivations(const public_key *keys1, const secret_key &key2, key_derivation *derivations, std::size_t count) {
+    return crypto_ops::generate_key_derivations(keys1, key2, derivations, count);
+  }
+  inline bool derive_public_keys(const key_derivation *derivations, const std::size_t *output_indices,
+    const public_key *bases, public_key *derived_keys, std::size_t count) {
+    return crypto_ops::derive_public_keys(derivations, output_indices, bases, derived_keys, count);
+  }
   inline void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     return crypto_ops::derivation_to_scalar(derivation, output_index, res);
   }
@@ -254,6 +272,12 @@ namespace crypto {
     return crypto_ops::check_signature(prefix_hash, pub, sig);
   }
 
+  /* Checks count signatures of the same prefix hash, true if all of them are valid.
+   */
+  inline bool check_signatures(const hash &prefix_hash, const public_key *pubs, const signature *sigs, std::size_t count) {
+    return crypto_ops::check_signatures(prefix_hash, pubs, sigs, count);
+  }
+
   /* Generation and checking of a tx proof; given a tx pubkey R, the recipient's view pubkey A, and the key 
    * derivation D, the signature proves the knowledge of the tx secret key r such that R=r*G and D=r*A
    * When the recipient's address is a subaddress, the tx pubkey R is defined as R=r*B where B is the recipient's spend pubkey
@@ -277,6 +301,9 @@ namespace crypto {
   inline void generate_key_image(const public_key &pub, const secret_key &sec, key_image &image) {
     crypto_ops::generate_key_image(pub, sec, image);
   }
+  inline void generate_key_images(const public_key *pubs, const secret_key *secs, key_image *images, std::size_t count) {
+    crypto_ops::generate_key_images(pubs, secs, images, count);
+  }
   inline void generate_ring_signature(const hash &prefix_hash, const key_image &image,
     const public_key *const *pubs, std::size_t pubs_count,
     const secret_key &sec, std::size_t sec_index,
@@ -79,6 +79,8 @@ enum {
 };
 
 void cn_fast_hash(const void *data, size_t length, char *hash);
+// hashes count inputs of the same length, several at a time; a hash may overwrite its own or an earlier input
+void cn_fast_hash_multi(const void *const *data, size_t length, char *const *hashes, size_t count);
 void cn_slow_hash(const void *data, size_t length, char *hash, int variant, int prehashed, uint64_t height);
 
 void hash_extra_blake(const void *data, size_t length, char *hash);
@@ -99,7 +101,9 @@ uint64_t rx_seedheight(const uint64_t height);
 void rx_seedheights(const uint64_t height, uint64_t *seed_height, uint64_t *next_height);
 
 void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads);
+void rx_set_next_seedhash(const char *seedhash);
 void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash);
 
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads);
 uint32_t rx_get_miner_thread(void);
+void rx_get_memory_usage(uint64_t *caches, uint64_t *cache_bytes, uint64_t *dataset_bytes);
@@ -55,3 +55,13 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_multi(const void *const *data, size_t length, char *const *hashes, size_t count) {
+  size_t i = 0;
+  for (; i + KECCAK_LANES <= count; i += KECCAK_LANES) {
+    keccak_lanes((const uint8_t *const *)(data + i), length, (uint8_t *const *)(hashes + i), HASH_SIZE);
+  }
+  for (; i < count; ++i) {
+    cn_fast_hash(data[i], length, hashes[i]);
+  }
+}
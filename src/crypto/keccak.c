@@ -171,6 +171,168 @@ void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md)
     keccak(in, inlen, md, sizeof(state_t));
 }
 
+#if defined(__GNUC__)
+
+// the same permutation on KECCAK_LANES independent states, one lane per vector
+// element; compilers map this onto SSE2, AVX2, AVX-512 or NEON registers
+typedef uint64_t lanes_t __attribute__((vector_size(8 * KECCAK_LANES)));
+
+static void keccakf_lanes(lanes_t st[25], int rounds)
+{
+    int round;
+    lanes_t t, bc[5];
+
+    for (round = 0; round < rounds; ++round) {
+        // Theta
+        bc[0] = st[0] ^ st[5] ^ st[10] ^ st[15] ^ st[20];
+        bc[1] = st[1] ^ st[6] ^ st[11] ^ st[16] ^ st[21];
+        bc[2] = st[2] ^ st[7] ^ st[12] ^ st[17] ^ st[22];
+        bc[3] = st[3] ^ st[8] ^ st[13] ^ st[18] ^ st[23];
+        bc[4] = st[4] ^ st[9] ^ st[14] ^ st[19] ^ st[24];
+
+        THETA(0);
+        THETA(1);
+        THETA(2);
+        THETA(3);
+        THETA(4);
+
+        // Rho Pi
+        t = st[1];
+        st[ 1] = ROTL64(st[ 6], 44);
+        st[ 6] = ROTL64(st[ 9], 20);
+        st[ 9] = ROTL64(st[22], 61);
+        st[22] = ROTL64(st[14], 39);
+        st[14] = ROTL64(st[20], 18);
+        st[20] = ROTL64(st[ 2], 62);
+        st[ 2] = ROTL64(st[12], 43);
+        st[12] = ROTL64(st[13], 25);
+        st[13] = ROTL64(st[19],  8);
+        st[19] = ROTL64(st[23], 56);
+        st[23] = ROTL64(st[15], 41);
+        st[15] = ROTL64(st[ 4], 27);
+        st[ 4] = ROTL64(st[24], 14);
+        st[24] = ROTL64(st[21],  2);
+        st[21] = ROTL64(st[ 8], 55);
+        st[ 8] = ROTL64(st[16], 45);
+        st[16] = ROTL64(st[ 5], 36);
+        st[ 5] = ROTL64(st[ 3], 28);
+        st[ 3] = ROTL64(st[18], 21);
+        st[18] = ROTL64(st[17], 15);
+        st[17] = ROTL64(st[11], 10);
+        st[11] = ROTL64(st[ 7],  6);
+        st[ 7] = ROTL64(st[10],  3);
+        st[10] = ROTL64(t, 1);
+
+        //  Chi
+#define CHI_LANES(j) { \
+            const lanes_t st0 = st[j    ]; \
+            const lanes_t st1 = st[j + 1]; \
+            const lanes_t st2 = st[j + 2]; \
+            const lanes_t st3 = st[j + 3]; \
+            const lanes_t st4 = st[j + 4]; \
+            st[j    ] ^= ~st1 & st2; \
+            st[j + 1] ^= ~st2 & st3; \
+            st[j + 2] ^= ~st3 & st4; \
+            st[j + 3] ^= ~st4 & st0; \
+            st[j + 4] ^= ~st0 & st1; \
+        }
+
+        CHI_LANES( 0);
+        CHI_LANES( 5);
+        CHI_LANES(10);
+        CHI_LANES(15);
+        CHI_LANES(20);
+
+        //  Iota
+        st[0] ^= keccakf_rndc[round];
+    }
+}
+
+void keccak_lanes(const uint8_t *const in[KECCAK_LANES], size_t inlen, uint8_t *const md[KECCAK_LANES], int mdlen)
+{
+    lanes_t st[25];
+    uint8_t temp[KECCAK_LANES][144];
+    size_t i, l, rsiz, rsizw, offset;
+
+    static_assert(HASH_DATA_AREA <= sizeof(temp[0]), "Bad keccak preconditions");
+    if (mdlen <= 0 || (mdlen >= 100 && sizeof(state_t) != (size_t)mdlen))
+    {
+      local_abort("Bad keccak use");
+    }
+
+    rsiz = sizeof(state_t) == mdlen ? HASH_DATA_AREA : 200 - 2 * mdlen;
+    rsizw = rsiz / 8;
+
+    memset(st, 0, sizeof(st));
+
+    for (offset = 0; inlen - offset >= rsiz; offset += rsiz) {
+      for (i = 0; i < rsizw; i++) {
+        for (l = 0; l < KECCAK_LANES; l++) {
+          uint64_t ina;
+          memcpy(&ina, in[l] + offset + i * 8, 8);
+          st[i][l] ^= swap64le(ina);
+        }
+      }
+      keccakf_lanes(st, KECCAK_ROUNDS);
+    }
+    inlen -= offset;
+
+    // last block and padding
+    if (inlen + 1 >= sizeof(temp[0]) || inlen > rsiz || rsiz == 0 || rsiz - 1 >= sizeof(temp[0]) || rsizw * 8 > sizeof(temp[0]))
+    {
+      local_abort("Bad keccak use");
+    }
+
+    // all the inputs are read before any output is written, so an output may overwrite an input
+    for (l = 0; l < KECCAK_LANES; l++) {
+      if (inlen > 0)
+        memcpy(temp[l], in[l] + offset, inlen);
+      temp[l][inlen] = 1;
+      memset(temp[l] + inlen + 1, 0, rsiz - inlen - 1);
+      temp[l][rsiz - 1] |= 0x80;
+
+      for (i = 0; i < rsizw; i++) {
+        uint64_t ina;
+        memcpy(&ina, temp[l] + i * 8, 8);
+        st[i][l] ^= swap64le(ina);
+      }
+    }
+
+    keccakf_lanes(st, KECCAK_ROUNDS);
+
+    if (((size_t)mdlen % sizeof(uint64_t)) != 0)
+    {
+      local_abort("Bad keccak use");
+    }
+    for (l = 0; l < KECCAK_LANES; l++) {
+      for (i = 0; i < (size_t)mdlen / sizeof(uint64_t); i++) {
+        const uint64_t out = swap64le(st[i][l]);
+        memcpy(md[l] + i * 8, &out, 8);
+      }
+    }
+}
+
+#else
+
+void keccak_lanes(const uint8_t *const in[KECCAK_LANES], size_t inlen, uint8_t *const md[KECCAK_LANES], int mdlen)
+{
+    uint8_t out[KECCAK_LANES][sizeof(state_t)];
+    size_t l;
+
+    if (mdlen <= 0 || (size_t)mdlen > sizeof(out[0]))
+    {
+      local_abort("Bad keccak use");
+    }
+
+    // all the inputs are read before any output is written, so an output may overwrite an input
+    for (l = 0; l < KECCAK_LANES; l++)
+      keccak(in[l], inlen, out[l], mdlen);
+    for (l = 0; l < KECCAK_LANES; l++)
+      memcpy(md[l], out[l], mdlen);
+}
+
+#endif
+
 #define KECCAK_FINALIZED 0x80000000
 #define KECCAK_BLOCKLEN 136
 #define KECCAK_WORDS 17
@@ -34,6 +34,10 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
+// compute KECCAK_LANES keccak hashes of inputs of the same length at once
+#define KECCAK_LANES 4
+void keccak_lanes(const uint8_t *const in[KECCAK_LANES], size_t inlen, uint8_t *const md[KECCAK_LANES], int mdlen);
+
 void keccak_init(KECCAK_CTX * ctx);
 void keccak_update(KECCAK_CTX * ctx, const uint8_t *in, size_t inlen);
 void keccak_finish(KECCAK_CTX * ctx, uint8_t *md);
@@ -35,6 +35,11 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "randomx.h"
 #include "c_threads.h"
@@ -50,15 +55,31 @@ static CTHR_RWLOCK_TYPE main_dataset_lock = CTHR_RWLOCK_INIT;
 static CTHR_RWLOCK_TYPE main_cache_lock = CTHR_RWLOCK_INIT;
 
 static randomx_dataset *main_dataset = NULL;
+static int main_dataset_large_pages = 0;
 static randomx_cache *main_cache = NULL;
 static char main_seedhash[HASH_SIZE];
 static int main_seedhash_set = 0;
 
-static CTHR_RWLOCK_TYPE secondary_cache_lock = CTHR_RWLOCK_INIT;
+// Caches for seed hashes other than the main one: the epoch before the main one
+// (kept when the main seed hash changes), the next one (prepared ahead of the
+// switch) and whatever alt chains or batched sync hashing ask for, replaced
+// least recently used first. Each cache takes 256 MB.
+#define RX_SECONDARY_CACHES 2
+
+typedef struct secondary_cache_info {
+  CTHR_RWLOCK_TYPE lock;
+  randomx_cache *cache;
+  char seedhash[HASH_SIZE];
+  int seedhash_set;
+  uint64_t last_used;
+} secondary_cache_info;
+
+#define SECONDARY_CACHE_INFO_INIT { CTHR_RWLOCK_INIT, NULL, {0}, 0, 0 }
+static secondary_cache_info secondary_caches[RX_SECONDARY_CACHES] = { SECONDARY_CACHE_INFO_INIT, SECONDARY_CACHE_INFO_INIT };
 
-static randomx_cache *secondary_cache = NULL;
-static char secondary_seedhash[HASH_SIZE];
-static int secondary_seedhash_set = 0;
+// Protects last_used of all the secondary caches, and the choice of which one to replace
+static CTHR_RWLOCK_TYPE secondary_lru_lock = CTHR_RWLOCK_INIT;
+static uint64_t secondary_lru_clock = 0;
 
 #if defined(_MSC_VER)
 #define THREADV __declspec(thread)
@@ -68,12 +89,12 @@ static int secondary_seedhash_set = 0;
 
 static THREADV randomx_vm *main_vm_full = NULL;
 static THREADV randomx_vm *main_vm_light = NULL;
-static THREADV randomx_vm *secondary_vm_light = NULL;
+static THREADV randomx_vm *secondary_vm_light[RX_SECONDARY_CACHES] = { NULL };
 
 static THREADV uint32_t miner_thread = 0;
 
 static bool is_main(const char* seedhash) { return main_seedhash_set && (memcmp(seedhash, main_seedhash, HASH_SIZE) == 0); }
-static bool is_secondary(const char* seedhash) { return secondary_seedhash_set && (memcmp(seedhash, secondary_seedhash, HASH_SIZE) == 0); }
+static bool is_secondary(const secondary_cache_info* sc, const char* seedhash) { return sc->seedhash_set && (memcmp(seedhash, sc->seedhash, HASH_SIZE) == 0); }
 
 static void local_abort(const char *msg)
 {
@@ -214,6 +235,7 @@ static void rx_alloc_dataset(randomx_flags flags, randomx_dataset** dataset, int
   }
 
   *dataset = randomx_alloc_dataset((flags | RANDOMX_FLAG_LARGE_PAGES) & ~disabled_flags());
+  main_dataset_large_pages = *dataset && !(disabled_flags() & RANDOMX_FLAG_LARGE_PAGES);
   if (!*dataset) {
     alloc_err_msg("Couldn't allocate RandomX dataset using large pages");
     *dataset = randomx_alloc_dataset(flags & ~disabled_flags());
@@ -286,6 +308,59 @@ static void rx_init_light_vm(randomx_flags flags, randomx_vm** vm, randomx_cache
   }
 }
 
+static int rx_find_secondary(const char *seedhash) {
+  for (int i = 0; i < RX_SECONDARY_CACHES; ++i) {
+    if (is_secondary(&secondary_caches[i], seedhash)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void rx_touch_secondary(int i) {
+  CTHR_RWLOCK_LOCK_WRITE(secondary_lru_lock);
+  secondary_caches[i].last_used = ++secondary_lru_clock;
+  CTHR_RWLOCK_UNLOCK_WRITE(secondary_lru_lock);
+}
+
+static int rx_lru_secondary(void) {
+  int lru = 0;
+  CTHR_RWLOCK_LOCK_WRITE(secondary_lru_lock);
+  for (int i = 1; i < RX_SECONDARY_CACHES; ++i) {
+    if (secondary_caches[i].last_used < secondary_caches[lru].last_used) {
+      lru = i;
+    }
+  }
+  // Mark it as used right away, so that concurrent misses replace different caches
+  secondary_caches[lru].last_used = ++secondary_lru_clock;
+  CTHR_RWLOCK_UNLOCK_WRITE(secondary_lru_lock);
+  return lru;
+}
+
+// Returns the index of a secondary cache initialized with seedhash, replacing the
+// least recently used one if needed. Its lock is returned held for writing.
+static int rx_load_secondary(randomx_flags flags, const char *seedhash) {
+  int i = rx_find_secondary(seedhash);
+  if (i < 0) {
+    i = rx_lru_secondary();
+  }
+
+  secondary_cache_info *sc = &secondary_caches[i];
+  CTHR_RWLOCK_LOCK_WRITE(sc->lock);
+  if (!is_secondary(sc, seedhash)) {
+    char buf[HASH_SIZE * 2 + 1];
+    hash2hex(seedhash, buf);
+    minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
+
+    rx_alloc_cache(flags, &sc->cache);
+    randomx_init_cache(sc->cache, seedhash, HASH_SIZE);
+    minfo(RX_LOGCAT, "RandomX secondary cache updated");
+    memcpy(sc->seedhash, seedhash, HASH_SIZE);
+    sc->seedhash_set = 1;
+  }
+  return i;
+}
+
 typedef struct seedinfo {
   randomx_cache *si_cache;
   unsigned long si_start;
@@ -342,6 +417,186 @@ static void rx_init_dataset(size_t max_threads) {
   minfo(RX_LOGCAT, "RandomX dataset initialized");
 }
 
+// With MONERO_RANDOMX_SHARED_DATASET set to a directory (ideally a hugetlbfs mount such as
+// /dev/hugepages, else /dev/shm), an initialized dataset is also written there in a file
+// named after its seed hash. Restarts and other processes on the same machine then take it
+// from there instead of spending tens of seconds computing it again. When our own dataset
+// sits in large pages and the file is on hugetlbfs, the file is mapped read only over it,
+// so all the processes share a single copy; otherwise it is copied. Only files owned by us
+// and not writable by anyone else are used, and a full mode hash is checked against light
+// mode before trusting one, since a bad dataset means bad hashes.
+#if defined(__linux__)
+
+#define RX_SHARED_DATASET_HUGE_PAGE (2 * 1024 * 1024)
+
+static size_t main_dataset_shared_size = 0; // size of the shared mapping over the dataset, if any
+
+static uint64_t rx_dataset_size(void) { return (uint64_t)randomx_dataset_item_count() * RANDOMX_DATASET_ITEM_SIZE; }
+
+static int rx_shared_dataset_path(const char *seedhash, char *path, size_t size) {
+  const char *dir = getenv("MONERO_RANDOMX_SHARED_DATASET");
+  if (!dir || !*dir) {
+    return 0;
+  }
+  char hex[HASH_SIZE * 2 + 1];
+  hash2hex(seedhash, hex);
+  const int n = snprintf(path, size, "%s/monero-randomx-%s", dir, hex);
+  return n > 0 && (size_t)n < size;
+}
+
+// Gives the dataset private writable memory again, before it is computed for another seed hash
+static void rx_detach_shared_dataset(void) {
+  if (!main_dataset_shared_size) {
+    return;
+  }
+  void *mem = randomx_get_dataset_memory(main_dataset);
+  if (mmap(mem, main_dataset_shared_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != mem &&
+      mmap(mem, main_dataset_shared_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != mem) {
+    local_abort("Couldn't replace the shared RandomX dataset mapping");
+  }
+  main_dataset_shared_size = 0;
+}
+
+// One hash in full mode must match the light mode one, or the dataset is not for this seed hash
+static int rx_check_dataset(const char *seedhash) {
+  randomx_flags flags = enabled_flags() & ~disabled_flags() & ~RANDOMX_FLAG_LARGE_PAGES;
+  if (flags & RANDOMX_FLAG_JIT) {
+    flags |= RANDOMX_FLAG_SECURE;
+  }
+  CTHR_RWLOCK_LOCK_READ(main_cache_lock);
+  randomx_vm *full = randomx_create_vm(flags | RANDOMX_FLAG_FULL_MEM, NULL, main_dataset);
+  randomx_vm *light = randomx_create_vm(flags & ~RANDOMX_FLAG_FULL_MEM, main_cache, NULL);
+  int ok = 0;
+  if (full && light) {
+    char full_hash[HASH_SIZE], light_hash[HASH_SIZE];
+    randomx_calculate_hash(full, seedhash, HASH_SIZE, full_hash);
+    randomx_calculate_hash(light, seedhash, HASH_SIZE, light_hash);
+    ok = memcmp(full_hash, light_hash, HASH_SIZE) == 0;
+  }
+  CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
+  if (full) randomx_destroy_vm(full);
+  if (light) randomx_destroy_vm(light);
+  return ok;
+}
+
+// Returns 1 if the dataset now holds the shared one for this seed hash; with map_only,
+// a dataset which can't be mapped over ours is left alone
+static int rx_attach_shared_dataset(const char *seedhash, int map_only) {
+  char path[PATH_MAX];
+  if (!rx_shared_dataset_path(seedhash, path, sizeof(path))) {
+    return 0;
+  }
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  const uint64_t size = rx_dataset_size();
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) || (uint64_t)st.st_size < size) {
+    mwarning(RX_LOGCAT, "Ignoring shared RandomX dataset %s: wrong owner, permissions or size", path);
+    close(fd);
+    return 0;
+  }
+
+  rx_detach_shared_dataset();
+  void *mem = randomx_get_dataset_memory(main_dataset);
+  const size_t map_size = (size + RX_SHARED_DATASET_HUGE_PAGE - 1) / RX_SHARED_DATASET_HUGE_PAGE * RX_SHARED_DATASET_HUGE_PAGE;
+  int ok = 0;
+  if (main_dataset_large_pages && st.st_blksize == RX_SHARED_DATASET_HUGE_PAGE && (uint64_t)st.st_size >= map_size &&
+      (uintptr_t)mem % RX_SHARED_DATASET_HUGE_PAGE == 0 && mmap(mem, map_size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == mem) {
+    main_dataset_shared_size = map_size;
+    ok = 1;
+  }
+  else if (!map_only) {
+    uint64_t done = 0;
+    while (done < size) {
+      const ssize_t r = pread(fd, (char*)mem + done, size - done, done);
+      if (r <= 0) {
+        break;
+      }
+      done += r;
+    }
+    ok = done == size;
+  }
+  close(fd);
+
+  if (ok && !rx_check_dataset(seedhash)) {
+    mwarning(RX_LOGCAT, "Shared RandomX dataset %s does not match its seed hash, ignoring it", path);
+    ok = 0;
+  }
+  if (!ok) {
+    rx_detach_shared_dataset();
+    return 0;
+  }
+  minfo(RX_LOGCAT, "RandomX dataset %s from %s", main_dataset_shared_size ? "mapped" : "copied", path);
+  return 1;
+}
+
+static void rx_publish_shared_dataset(const char *seedhash, const char *old_seedhash) {
+  char path[PATH_MAX], tmp[PATH_MAX];
+  if (!rx_shared_dataset_path(seedhash, path, sizeof(path)) || snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp)) {
+    return;
+  }
+  const int fd = mkstemp(tmp);
+  if (fd < 0) {
+    mwarning(RX_LOGCAT, "Couldn't create shared RandomX dataset %s", tmp);
+    return;
+  }
+
+  // hugetlbfs files can't be written to, only mapped
+  const uint64_t size = rx_dataset_size();
+  struct stat st;
+  int ok = fstat(fd, &st) == 0 && st.st_blksize > 0;
+  const size_t file_size = ok ? (size + st.st_blksize - 1) / st.st_blksize * st.st_blksize : 0;
+  ok = ok && ftruncate(fd, file_size) == 0;
+  void *shared = ok ? mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ok = shared != MAP_FAILED;
+  if (ok) {
+    memcpy(shared, randomx_get_dataset_memory(main_dataset), size);
+    munmap(shared, file_size);
+  }
+  close(fd);
+
+  // readers only ever see complete files
+  if (!ok || rename(tmp, path) != 0) {
+    mwarning(RX_LOGCAT, "Couldn't write shared RandomX dataset %s", path);
+    unlink(tmp);
+    return;
+  }
+  minfo(RX_LOGCAT, "RandomX dataset shared in %s", path);
+
+  // processes still using the previous one keep their mapping
+  if (old_seedhash && rx_shared_dataset_path(old_seedhash, path, sizeof(path)) && stat(path, &st) == 0 && st.st_uid == geteuid()) {
+    unlink(path);
+  }
+
+  // and from now on, use the shared copy ourselves
+  rx_attach_shared_dataset(seedhash, 1);
+}
+
+#else
+
+static int rx_attach_shared_dataset(const char *seedhash, int map_only) { return 0; }
+static void rx_detach_shared_dataset(void) {}
+static void rx_publish_shared_dataset(const char *seedhash, const char *old_seedhash) {}
+
+#endif
+
+// Fills the main dataset for the main seed hash, from the shared one if there is one
+static void rx_prepare_dataset(size_t max_threads, const char *old_seedhash) {
+  if (!main_dataset) {
+    return;
+  }
+  if (main_seedhash_set && rx_attach_shared_dataset(main_seedhash, 0)) {
+    return;
+  }
+  rx_detach_shared_dataset();
+  rx_init_dataset(max_threads);
+  if (main_seedhash_set) {
+    rx_publish_shared_dataset(main_seedhash, old_seedhash);
+  }
+}
+
 typedef struct thread_info {
   char seedhash[HASH_SIZE];
   size_t max_threads;
@@ -360,6 +615,35 @@ static CTHR_THREAD_RTYPE rx_set_main_seedhash_thread(void *arg) {
     free(info);
     CTHR_THREAD_RETURN;
   }
+
+  // Take over the secondary cache with this seed hash if there is one, and keep
+  // the outgoing main cache as a secondary cache, since alt blocks and reorgs
+  // will most likely ask for the previous epoch
+  const int had_main = main_seedhash_set && main_cache;
+  int reused = 0;
+  int i = rx_find_secondary(info->seedhash);
+  if (i >= 0 || had_main) {
+    if (i < 0) {
+      i = rx_lru_secondary();
+    } else {
+      rx_touch_secondary(i);
+    }
+    secondary_cache_info *sc = &secondary_caches[i];
+    CTHR_RWLOCK_LOCK_WRITE(sc->lock);
+    reused = is_secondary(sc, info->seedhash);
+    randomx_cache *cache = sc->cache;
+    sc->cache = main_cache;
+    sc->seedhash_set = had_main;
+    if (had_main) {
+      memcpy(sc->seedhash, main_seedhash, HASH_SIZE);
+    }
+    main_cache = cache;
+    CTHR_RWLOCK_UNLOCK_WRITE(sc->lock);
+  }
+
+  char old_seedhash[HASH_SIZE];
+  const int had_old_seedhash = main_seedhash_set;
+  memcpy(old_seedhash, main_seedhash, HASH_SIZE);
   memcpy(main_seedhash, info->seedhash, HASH_SIZE);
   main_seedhash_set = 1;
 
@@ -369,15 +653,19 @@ static CTHR_THREAD_RTYPE rx_set_main_seedhash_thread(void *arg) {
 
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   rx_alloc_dataset(flags, &main_dataset, 0);
-  rx_alloc_cache(flags, &main_cache);
 
-  randomx_init_cache(main_cache, info->seedhash, HASH_SIZE);
-  minfo(RX_LOGCAT, "RandomX main cache initialized");
+  if (reused) {
+    minfo(RX_LOGCAT, "RandomX main cache taken from a secondary cache");
+  } else {
+    rx_alloc_cache(flags, &main_cache);
+    randomx_init_cache(main_cache, info->seedhash, HASH_SIZE);
+    minfo(RX_LOGCAT, "RandomX main cache initialized");
+  }
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_cache_lock);
 
   // From this point, rx_slow_hash can calculate hashes in light mode, but dataset is not initialized yet
-  rx_init_dataset(info->max_threads);
+  rx_prepare_dataset(info->max_threads, had_old_seedhash ? old_seedhash : NULL);
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
 
@@ -404,6 +692,55 @@ void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads)
   }
 }
 
+static char next_seedhash[HASH_SIZE];
+static int next_seedhash_pending = 0;
+
+static CTHR_THREAD_RTYPE rx_set_next_seedhash_thread(void *arg) {
+  thread_info* info = arg;
+
+  if (!is_main(info->seedhash)) {
+    const randomx_flags flags = enabled_flags() & ~disabled_flags();
+    const int i = rx_load_secondary(flags, info->seedhash);
+    CTHR_RWLOCK_UNLOCK_WRITE(secondary_caches[i].lock);
+  }
+
+  CTHR_RWLOCK_LOCK_WRITE(secondary_lru_lock);
+  next_seedhash_pending = 0;
+  CTHR_RWLOCK_UNLOCK_WRITE(secondary_lru_lock);
+
+  free(info);
+  CTHR_THREAD_RETURN;
+}
+
+void rx_set_next_seedhash(const char *seedhash) {
+  // Early out if seedhash is already cached
+  if (is_main(seedhash) || rx_find_secondary(seedhash) >= 0) {
+    return;
+  }
+
+  // Only one preparation at a time, the next seed hash doesn't change often
+  CTHR_RWLOCK_LOCK_WRITE(secondary_lru_lock);
+  if (next_seedhash_pending) {
+    CTHR_RWLOCK_UNLOCK_WRITE(secondary_lru_lock);
+    return;
+  }
+  memcpy(next_seedhash, seedhash, HASH_SIZE);
+  next_seedhash_pending = 1;
+  CTHR_RWLOCK_UNLOCK_WRITE(secondary_lru_lock);
+
+  // Initialize a secondary cache in the background, rx_set_main_seedhash takes it over at the epoch switch
+  thread_info* info = malloc(sizeof(thread_info));
+  if (!info) local_abort("Couldn't allocate RandomX seed threadinfo");
+
+  memcpy(info->seedhash, seedhash, HASH_SIZE);
+  info->max_threads = 0;
+
+  CTHR_THREAD_TYPE t;
+  if (!CTHR_THREAD_CREATE(t, rx_set_next_seedhash_thread, info)) {
+    local_abort("Couldn't start RandomX seed thread");
+  }
+}
+
 void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash) {
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   int success = 0;
@@ -438,52 +775,32 @@ void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *r
     return;
   }
 
-  char buf[HASH_SIZE * 2 + 1];
-
-  // Slow path (seedhash != main_seedhash, but seedhash == secondary_seedhash)
+  // Slow path (seedhash != main_seedhash, but seedhash is in a secondary cache)
   // Multiple threads can run in parallel in light mode, 10-15 ms per hash per thread
-  if (!secondary_cache) {
-    CTHR_RWLOCK_LOCK_WRITE(secondary_cache_lock);
-    if (!secondary_cache) {
-      hash2hex(seedhash, buf);
-      minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
-
-      rx_alloc_cache(flags, &secondary_cache);
-      randomx_init_cache(secondary_cache, seedhash, HASH_SIZE);
-      minfo(RX_LOGCAT, "RandomX secondary cache updated");
-      memcpy(secondary_seedhash, seedhash, HASH_SIZE);
-      secondary_seedhash_set = 1;
+  int i = rx_find_secondary(seedhash);
+  if (i >= 0) {
+    secondary_cache_info *sc = &secondary_caches[i];
+    CTHR_RWLOCK_LOCK_READ(sc->lock);
+    // Double check that the cache wasn't replaced
+    if (is_secondary(sc, seedhash)) {
+      rx_init_light_vm(flags, &secondary_vm_light[i], sc->cache);
+      randomx_calculate_hash(secondary_vm_light[i], data, length, result_hash);
+      success = 1;
     }
-    CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
-  }
-
-  CTHR_RWLOCK_LOCK_READ(secondary_cache_lock);
-  if (is_secondary(seedhash)) {
-    rx_init_light_vm(flags, &secondary_vm_light, secondary_cache);
-    randomx_calculate_hash(secondary_vm_light, data, length, result_hash);
-    success = 1;
+    CTHR_RWLOCK_UNLOCK_READ(sc->lock);
   }
-  CTHR_RWLOCK_UNLOCK_READ(secondary_cache_lock);
 
   if (success) {
+    rx_touch_secondary(i);
     return;
   }
 
-  // Slowest path (seedhash != main_seedhash, seedhash != secondary_seedhash)
-  // Only one thread runs at a time and updates secondary_seedhash if needed, up to 200-500 ms per hash
-  CTHR_RWLOCK_LOCK_WRITE(secondary_cache_lock);
-  if (!is_secondary(seedhash)) {
-    hash2hex(seedhash, buf);
-    minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
-
-    randomx_init_cache(secondary_cache, seedhash, HASH_SIZE);
-    minfo(RX_LOGCAT, "RandomX secondary cache updated");
-    memcpy(secondary_seedhash, seedhash, HASH_SIZE);
-    secondary_seedhash_set = 1;
-  }
-  rx_init_light_vm(flags, &secondary_vm_light, secondary_cache);
-  randomx_calculate_hash(secondary_vm_light, data, length, result_hash);
-  CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
+  // Slowest path (seedhash isn't in any cache)
+  // Only one thread runs at a time per secondary cache and replaces the least recently used one, up to 200-500 ms per hash
+  i = rx_load_secondary(flags, seedhash);
+  rx_init_light_vm(flags, &secondary_vm_light[i], secondary_caches[i].cache);
+  randomx_calculate_hash(secondary_vm_light[i], data, length, result_hash);
+  CTHR_RWLOCK_UNLOCK_WRITE(secondary_caches[i].lock);
 }
 
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
@@ -498,7 +815,7 @@ void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
 
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   rx_alloc_dataset(flags, &main_dataset, 1);
-  rx_init_dataset(max_dataset_init_threads);
+  rx_prepare_dataset(max_dataset_init_threads, NULL);
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
 }
@@ -507,6 +824,29 @@ uint32_t rx_get_miner_thread() {
   return miner_thread;
 }
 
+// The dataset only exists once mining started, each cache holds the 256 MB Argon2 memory
+void rx_get_memory_usage(uint64_t *caches, uint64_t *cache_bytes, uint64_t *dataset_bytes) {
+  static const uint64_t cache_size = 256 * 1024 * 1024;
+  uint64_t n = 0;
+
+  CTHR_RWLOCK_LOCK_READ(main_cache_lock);
+  if (main_cache)
+    ++n;
+  CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
+  for (int i = 0; i < RX_SECONDARY_CACHES; ++i) {
+    CTHR_RWLOCK_LOCK_READ(secondary_caches[i].lock);
+    if (secondary_caches[i].cache)
+      ++n;
+    CTHR_RWLOCK_UNLOCK_READ(secondary_caches[i].lock);
+  }
+  *caches = n;
+  *cache_bytes = n * cache_size;
+
+  CTHR_RWLOCK_LOCK_READ(main_dataset_lock);
+  *dataset_bytes = main_dataset ? (uint64_t)randomx_dataset_item_count() * RANDOMX_DATASET_ITEM_SIZE : 0;
+  CTHR_RWLOCK_UNLOCK_READ(main_dataset_lock);
+}
+
 void rx_slow_hash_allocate_state() {}
 
 static void rx_destroy_vm(randomx_vm** vm) {
@@ -519,5 +859,7 @@ static void rx_destroy_vm(randomx_vm** vm) {
 void rx_slow_hash_free_state() {
   rx_destroy_vm(&main_vm_full);
   rx_destroy_vm(&main_vm_light);
-  rx_destroy_vm(&secondary_vm_light);
+  for (int i = 0; i < RX_SECONDARY_CACHES; ++i) {
+    rx_destroy_vm(&secondary_vm_light[i]);
+  }
 }
@@ -59,6 +59,20 @@ size_t tree_hash_cnt(size_t count) {
 	return pow >> 1;
 }
 
+// hashes the n pairs of hashes at in into the n hashes at out, which may be the same buffer
+static void tree_hash_pairs(const char *in, size_t n, char *out) {
+  const void *data[8];
+  char *res[8];
+  size_t i, k;
+  for (i = 0; i < n; i += k) {
+    for (k = 0; k < 8 && i + k < n; ++k) {
+      data[k] = in + (i + k) * 2 * HASH_SIZE;
+      res[k] = out + (i + k) * HASH_SIZE;
+    }
+    cn_fast_hash_multi(data, 2 * HASH_SIZE, res, k);
+  }
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 // The blockchain block at height 202612 https://moneroblocks.info/block/202612
 // contained 514 transactions, that triggered bad calculation of variable "cnt" in the original version of this function
@@ -88,16 +102,14 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints + j * HASH_SIZE);
-    }
-    assert(i == count);
+    i = 2 * cnt - count;
+    j = 2 * cnt - count;
+    tree_hash_pairs(hashes[i], cnt - j, ints + j * HASH_SIZE);
+    assert(i + 2 * (cnt - j) == count);
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints + i * HASH_SIZE, 64, ints + j * HASH_SIZE);
-      }
+      tree_hash_pairs(ints, cnt, ints);
     }
 
     cn_fast_hash(ints, 64, root_hash);
@@ -182,39 +194,31 @@ bool tree_branch(const char (*hashes)[HASH_SIZE], size_t count, const char *hash
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      if (idx == i || idx == i+1)
-      {
-        memcpy(branch[*depth], hashes[idx == i ? i + 1 : i], HASH_SIZE);
-        ++*depth;
-        *path = (*path << 1) | (idx == i ? 0 : 1);
-        idx = j;
-      }
-      cn_fast_hash(hashes[i], 64, ints + j * HASH_SIZE);
+    // the sibling at each level is picked before the level is hashed in place
+    i = 2 * cnt - count;
+    j = 2 * cnt - count;
+    if (idx >= i)
+    {
+      memcpy(branch[*depth], hashes[i + ((idx - i) ^ 1)], HASH_SIZE);
+      ++*depth;
+      *path = (*path << 1) | ((idx - i) & 1);
+      idx = j + ((idx - i) >> 1);
     }
-    assert(i == count);
+    tree_hash_pairs(hashes[i], cnt - j, ints + j * HASH_SIZE);
 
     while (cnt > 2) {
+      memcpy(branch[*depth], ints + (idx ^ 1) * HASH_SIZE, HASH_SIZE);
+      ++*depth;
+      *path = (*path << 1) | (idx & 1);
+      idx >>= 1;
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        if (idx == i || idx == i + 1)
-        {
-          memcpy(branch[*depth], ints + (idx == i ? i + 1 : i) * HASH_SIZE, HASH_SIZE);
-          ++*depth;
-          *path = (*path << 1) | (idx == i ? 0 : 1);
-          idx = j;
-        }
-        cn_fast_hash(ints + i * HASH_SIZE, 64, ints + j * HASH_SIZE);
-      }
+      tree_hash_pairs(ints, cnt, ints);
     }
 
-    if (idx == 0 || idx == 1)
-    {
-      memcpy(branch[*depth], ints + (idx == 0 ? 1 : 0) * HASH_SIZE, HASH_SIZE);
-      ++*depth;
-      *path = (*path << 1) | (idx == 0 ? 0 : 1);
-      idx = 0;
-    }
+    assert(idx == 0 || idx == 1);
+    memcpy(branch[*depth], ints + (idx ^ 1) * HASH_SIZE, HASH_SIZE);
+    ++*depth;
+    *path = (*path << 1) | (idx & 1);
 
     free(ints);
   }
@@ -42,6 +42,15 @@ namespace crypto {
         return monero_crypto_generate_key_derivation(out.data, tx_pub.data, view_sec.data) == 0;
       }
 
+      inline
+      bool generate_key_derivations(const public_key *tx_pubs, const secret_key &view_sec, key_derivation *out, std::size_t count)
+      {
+        for (std::size_t i = 0; i < count; ++i)
+          if (!generate_key_derivation(tx_pubs[i], view_sec, out[i]))
+            return false;
+        return true;
+      }
+
       inline
       bool derive_subaddress_public_key(const public_key &output_pub, const key_derivation &d, std::size_t index, public_key &out)
       {
@@ -51,6 +60,7 @@ namespace crypto {
       }
 #else
     using ::crypto::generate_key_derivation;
+    using ::crypto::generate_key_derivations;
     using ::crypto::derive_subaddress_public_key;
 #endif
   }
@@ -64,6 +64,16 @@ namespace cryptonote
       return 1024 * 1024; // 1 MB
     case cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID:
       return 1024 * 1024 * 4; // 4 MB
+    case cryptonote::NOTIFY_NEW_COMPACT_BLOCK::ID:
+      return 1024 * 1024 * 128; // 128 MB, as it may include transaction data
+    case cryptonote::NOTIFY_REQUEST_TX_SKETCH::ID:
+      return 4096;
+    case cryptonote::NOTIFY_TX_SKETCH::ID:
+      return 64 * 1024; // 64 kB
+    case cryptonote::NOTIFY_TX_RECONCILIATION_DIFF::ID:
+      return 64 * 1024; // 64 kB
+    case cryptonote::NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::ID:
+      return 4096;
     default:
       break;
     };
@@ -30,6 +30,7 @@
 // Parts of this file are originally copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
 
 #pragma once
+#include <deque>
 #include <unordered_set>
 #include <atomic>
 #include <algorithm>
@@ -44,7 +45,14 @@ namespace cryptonote
     cryptonote_connection_context(): m_state(state_before_handshake), m_remote_blockchain_height(0), m_last_response_height(0),
         m_last_request_time(boost::date_time::not_a_date_time), m_callback_request_count(0),
         m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_rpc_port(0), m_rpc_credits_per_hash(0), m_anchor(false), m_score(0),
-        m_expect_response(0), m_expect_height(0), m_num_requested(0) {}
+        m_expect_response(0), m_expect_height(0), m_num_requested(0), m_chain_response_time(0.0f), m_txs_flooded(0), m_txs_reconciled(0),
+        m_txs_reconciled_known(0), m_reconciliations(0), m_reconciliation_failures(0), m_txpool_complement_sketch_cells(0) {}
+
+    struct span_request
+    {
+      uint64_t start_height;
+      size_t nblocks;
+    };
 
     enum state
     {
@@ -108,6 +116,14 @@ namespace cryptonote
     int m_expect_response;
     uint64_t m_expect_height;
     size_t m_num_requested;
+    std::deque<span_request> m_span_requests; //!< spans asked for and not received yet, oldest first
+    float m_chain_response_time; //!< average seconds for the peer to answer a chain request, or 0
+    uint64_t m_txs_flooded; //!< txes sent by flooding
+    uint64_t m_txs_reconciled; //!< txes sent after reconciling
+    uint64_t m_txs_reconciled_known; //!< txes reconciled without sending them, the peer had them
+    uint64_t m_reconciliations;
+    uint64_t m_reconciliation_failures;
+    uint64_t m_txpool_complement_sketch_cells; //!< cells of the txpool complement sketch we sent and the peer did not fail yet, or 0
     copyable_atomic m_new_stripe_notification{0};
     copyable_atomic m_idle_peer_notification{0};
   };
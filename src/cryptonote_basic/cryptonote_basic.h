@@ -225,7 +225,9 @@ namespace cryptonote
 
     transaction();
     transaction(const transaction &t);
+    transaction(transaction &&t) noexcept;
     transaction &operator=(const transaction &t);
+    transaction &operator=(transaction &&t) noexcept;
     virtual ~transaction();
     void set_null();
     void invalidate_hashes();
@@ -402,6 +404,70 @@ namespace cryptonote
     return *this;
   }
 
+  // moves keep the cached hashes and blob size, so a parsed tx can be handed
+  // down the import path without anyone having to hash it again
+  inline transaction::transaction(transaction &&t) noexcept:
+    transaction_prefix(std::move(t)),
+    hash_valid(false),
+    prunable_hash_valid(false),
+    blob_size_valid(false),
+    signatures(std::move(t.signatures)),
+    rct_signatures(std::move(t.rct_signatures)),
+    pruned(t.pruned),
+    unprunable_size(t.unprunable_size.load()),
+    prefix_size(t.prefix_size.load())
+  {
+    if (t.is_hash_valid())
+    {
+      hash = t.hash;
+      set_hash_valid(true);
+    }
+    if (t.is_blob_size_valid())
+    {
+      blob_size = t.blob_size;
+      set_blob_size_valid(true);
+    }
+    if (t.is_prunable_hash_valid())
+    {
+      prunable_hash = t.prunable_hash;
+      set_prunable_hash_valid(true);
+    }
+    t.invalidate_hashes();
+  }
+
+  inline transaction &transaction::operator=(transaction &&t) noexcept
+  {
+    if (this == &t)
+      return *this;
+    transaction_prefix::operator=(std::move(t));
+
+    set_hash_valid(false);
+    set_prunable_hash_valid(false);
+    set_blob_size_valid(false);
+    signatures = std::move(t.signatures);
+    rct_signatures = std::move(t.rct_signatures);
+    if (t.is_hash_valid())
+    {
+      hash = t.hash;
+      set_hash_valid(true);
+    }
+    if (t.is_prunable_hash_valid())
+    {
+      prunable_hash = t.prunable_hash;
+      set_prunable_hash_valid(true);
+    }
+    if (t.is_blob_size_valid())
+    {
+      blob_size = t.blob_size;
+      set_blob_size_valid(true);
+    }
+    pruned = t.pruned;
+    unprunable_size = t.unprunable_size.load();
+    prefix_size = t.prefix_size.load();
+    t.invalidate_hashes();
+    return *this;
+  }
+
   inline
   transaction::transaction()
   {
@@ -480,7 +546,9 @@ namespace cryptonote
   public:
     block(): block_header(), hash_valid(false) {}
     block(const block &b): block_header(b), hash_valid(false), miner_tx(b.miner_tx), tx_hashes(b.tx_hashes) { if (b.is_hash_valid()) { hash = b.hash; set_hash_valid(true); } }
+    block(block &&b) noexcept: block_header(std::move(b)), hash_valid(false), miner_tx(std::move(b.miner_tx)), tx_hashes(std::move(b.tx_hashes)) { if (b.is_hash_valid()) { hash = b.hash; set_hash_valid(true); b.invalidate_hashes(); } }
     block &operator=(const block &b) { block_header::operator=(b); hash_valid = false; miner_tx = b.miner_tx; tx_hashes = b.tx_hashes; if (b.is_hash_valid()) { hash = b.hash; set_hash_valid(true); } return *this; }
+    block &operator=(block &&b) noexcept { if (this == &b) return *this; block_header::operator=(std::move(b)); hash_valid = false; miner_tx = std::move(b.miner_tx); tx_hashes = std::move(b.tx_hashes); if (b.is_hash_valid()) { hash = b.hash; set_hash_valid(true); b.invalidate_hashes(); } return *this; }
     void invalidate_hashes() { set_hash_valid(false); }
     bool is_hash_valid() const { return hash_valid.load(std::memory_order_acquire); }
     void set_hash_valid(bool v) const { hash_valid.store(v,std::memory_order_release); }
@@ -504,6 +572,31 @@ namespace cryptonote
     END_SERIALIZE()
   };
 
+  // what a wallet needs to tell whether a tx may pay it before downloading it
+  struct tx_view_tags
+  {
+    crypto::hash tx_hash;
+    std::vector<crypto::public_key> tx_pub_keys;
+    std::vector<crypto::public_key> additional_tx_pub_keys;
+    std::vector<crypto::view_tag> view_tags; // one per output, empty if an output has none
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELD(tx_hash)
+      FIELD(tx_pub_keys)
+      FIELD(additional_tx_pub_keys)
+      FIELD(view_tags)
+    END_SERIALIZE()
+  };
+
+  struct block_view_tags
+  {
+    std::vector<tx_view_tags> txes; // miner tx first
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELD(txes)
+    END_SERIALIZE()
+  };
+
 
   /************************************************************************/
   /*                                                                      */
@@ -30,11 +30,14 @@
 
 #include <atomic>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include "wipeable_string.h"
 #include "string_tools.h"
 #include "string_tools_lexical.h"
 #include "serialization/string.h"
 #include "cryptonote_format_utils.h"
+#include "transaction_view.h"
 #include "cryptonote_config.h"
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
@@ -79,6 +82,21 @@ static std::atomic<uint64_t> tx_hashes_cached_count(0);
 static std::atomic<uint64_t> block_hashes_calculated_count(0);
 static std::atomic<uint64_t> block_hashes_cached_count(0);
 
+// below this many txes, hashing the whole tree is cheap enough
+#define TX_TREE_HASH_CACHE_MIN_TXES 16
+
+// the non coinbase txes of the last large block hashed, and, once they were
+// seen twice, the coinbase's branch, which does not depend on the coinbase
+// itself. Block templates only differ by their coinbase, so rehashing one
+// costs log2 of the number of txes.
+static struct
+{
+  boost::mutex mutex;
+  std::vector<crypto::hash> tx_hashes;
+  std::vector<crypto::hash> coinbase_branch;
+  uint32_t coinbase_path;
+} tx_tree_hash_cache;
+
 #define CHECK_AND_ASSERT_THROW_MES_L1(expr, message) {if(!(expr)) {MWARNING(message); throw std::runtime_error(message);}}
 
 namespace cryptonote
@@ -651,14 +669,14 @@ namespace cryptonote
   //---------------------------------------------------------------
   crypto::public_key get_tx_pub_key_from_extra(const std::vector<uint8_t>& tx_extra, size_t pk_index)
   {
-    std::vector<tx_extra_field> tx_extra_fields;
-    parse_tx_extra(tx_extra, tx_extra_fields);
+    tx_extra_view view;
+    view.parse(epee::to_span(tx_extra)); // ok if partially parsed
 
-    tx_extra_pub_key pub_key_field;
-    if(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index))
+    crypto::public_key pub_key;
+    if(!view.get_pub_key(pub_key, pk_index))
       return null_pkey;
 
-    return pub_key_field.pub_key;
+    return pub_key;
   }
   //---------------------------------------------------------------
   crypto::public_key get_tx_pub_key_from_extra(const transaction_prefix& tx_prefix, size_t pk_index)
@@ -691,14 +709,13 @@ namespace cryptonote
   //---------------------------------------------------------------
   std::vector<crypto::public_key> get_additional_tx_pub_keys_from_extra(const std::vector<uint8_t>& tx_extra)
   {
-    // parse
-    std::vector<tx_extra_field> tx_extra_fields;
-    parse_tx_extra(tx_extra, tx_extra_fields);
-    // find corresponding field
-    tx_extra_additional_pub_keys additional_pub_keys;
-    if(!find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
-      return {};
-    return additional_pub_keys.data;
+    tx_extra_view view;
+    view.parse(epee::to_span(tx_extra)); // ok if partially parsed
+
+    std::vector<crypto::public_key> additional_pub_keys(view.additional_pub_key_count());
+    for (size_t i = 0; i < additional_pub_keys.size(); ++i)
+      view.get_additional_pub_key(i, additional_pub_keys[i]);
+    return additional_pub_keys;
   }
   //---------------------------------------------------------------
   std::vector<crypto::public_key> get_additional_tx_pub_keys_from_extra(const transaction_prefix& tx)
@@ -930,6 +947,35 @@ namespace cryptonote
       : boost::optional<crypto::view_tag>();
   }
   //---------------------------------------------------------------
+  void get_tx_view_tags(const transaction& tx, const crypto::hash& tx_hash, tx_view_tags& tags)
+  {
+    tx_extra_view extra;
+    extra.parse(epee::to_span(tx.extra)); // ok if partially parsed
+
+    tags.tx_hash = tx_hash;
+    crypto::public_key pub_key;
+    tags.tx_pub_keys.clear();
+    for (size_t i = 0; extra.get_pub_key(pub_key, i); ++i)
+      tags.tx_pub_keys.push_back(pub_key);
+    tags.additional_tx_pub_keys.resize(extra.additional_pub_key_count());
+    for (size_t i = 0; i < tags.additional_tx_pub_keys.size(); ++i)
+      extra.get_additional_pub_key(i, tags.additional_tx_pub_keys[i]);
+
+    tags.view_tags.clear();
+    tags.view_tags.reserve(tx.vout.size());
+    for (const tx_out &out: tx.vout)
+    {
+      const boost::optional<crypto::view_tag> view_tag = get_output_view_tag(out);
+      if (!view_tag)
+      {
+        // a wallet will have to get the tx to scan it
+        tags.view_tags.clear();
+        break;
+      }
+      tags.view_tags.push_back(*view_tag);
+    }
+  }
+  //---------------------------------------------------------------
   std::string short_hash_str(const crypto::hash& h)
   {
     std::string res = string_tools::pod_to_hex(h);
@@ -1446,6 +1492,13 @@ namespace cryptonote
     return blob;
   }
   //---------------------------------------------------------------
+  size_t get_block_hashing_blob_nonce_offset(const block& b)
+  {
+    // the nonce closes the header, after the varints and the previous block id
+    return tools::get_varint_data(b.major_version).size() + tools::get_varint_data(b.minor_version).size() +
+      tools::get_varint_data(b.timestamp).size() + sizeof(crypto::hash);
+  }
+  //---------------------------------------------------------------
   bool calculate_block_hash(const block& b, crypto::hash& res, const blobdata_ref *blob)
   {
     blobdata bd;
@@ -1597,15 +1650,71 @@ namespace cryptonote
   //---------------------------------------------------------------
   crypto::hash get_tx_tree_hash(const block& b)
   {
-    std::vector<crypto::hash> txs_ids;
-    txs_ids.reserve(1 + b.tx_hashes.size());
     crypto::hash h = null_hash;
     size_t bl_sz = 0;
     CHECK_AND_ASSERT_THROW_MES(get_transaction_hash(b.miner_tx, h, bl_sz), "Failed to calculate transaction hash");
+
+    const bool cacheable = b.tx_hashes.size() >= TX_TREE_HASH_CACHE_MIN_TXES;
+    bool seen = false;
+    if (cacheable)
+    {
+      std::vector<crypto::hash> branch;
+      uint32_t path = 0;
+      {
+        boost::lock_guard<boost::mutex> lock(tx_tree_hash_cache.mutex);
+        seen = tx_tree_hash_cache.tx_hashes == b.tx_hashes;
+        if (seen)
+        {
+          branch = tx_tree_hash_cache.coinbase_branch;
+          path = tx_tree_hash_cache.coinbase_path;
+        }
+      }
+      if (!branch.empty())
+      {
+        crypto::hash root;
+        CHECK_AND_ASSERT_THROW_MES(crypto::tree_branch_hash(h.data, (const char(*)[crypto::HASH_SIZE])branch.data(), branch.size(), path, root.data),
+            "Failed to calculate tx tree hash");
+        return root;
+      }
+    }
+
+    std::vector<crypto::hash> txs_ids;
+    txs_ids.reserve(1 + b.tx_hashes.size());
     txs_ids.push_back(h);
     for(auto& th: b.tx_hashes)
       txs_ids.push_back(th);
-    return get_tx_tree_hash(txs_ids);
+
+    if (!seen)
+    {
+      const crypto::hash root = get_tx_tree_hash(txs_ids);
+      if (cacheable)
+      {
+        boost::lock_guard<boost::mutex> lock(tx_tree_hash_cache.mutex);
+        tx_tree_hash_cache.tx_hashes = b.tx_hashes;
+        tx_tree_hash_cache.coinbase_branch.clear();
+      }
+      return root;
+    }
+
+    // second time we see these txes, keep the coinbase's branch so the next ones are cheap
+    std::vector<crypto::hash> branch(txs_ids.size());
+    size_t depth = 0;
+    uint32_t path = 0;
+    CHECK_AND_ASSERT_THROW_MES(crypto::tree_branch((const char(*)[crypto::HASH_SIZE])txs_ids.data(), txs_ids.size(), h.data,
+        (char(*)[crypto::HASH_SIZE])branch.data(), &depth, &path), "Failed to calculate miner tx branch");
+    branch.resize(depth);
+    crypto::hash root;
+    CHECK_AND_ASSERT_THROW_MES(crypto::tree_branch_hash(h.data, (const char(*)[crypto::HASH_SIZE])branch.data(), branch.size(), path, root.data),
+        "Failed to calculate tx tree hash");
+    {
+      boost::lock_guard<boost::mutex> lock(tx_tree_hash_cache.mutex);
+      if (tx_tree_hash_cache.tx_hashes == b.tx_hashes)
+      {
+        tx_tree_hash_cache.coinbase_branch = std::move(branch);
+        tx_tree_hash_cache.coinbase_path = path;
+      }
+    }
+    return root;
   }
   //---------------------------------------------------------------
   bool is_valid_decomposed_amount(uint64_t amount)
@@ -1623,6 +1732,45 @@ namespace cryptonote
     block_hashes_cached = block_hashes_cached_count;
   }
   //---------------------------------------------------------------
+  // approximate heap usage of a parsed tx: its own size and that of the
+  // vectors it holds, not counting allocator overhead
+  size_t get_transaction_memory_usage(const transaction &tx)
+  {
+    size_t bytes = sizeof(transaction);
+    bytes += tx.vin.capacity() * sizeof(txin_v) + tx.vout.capacity() * sizeof(tx_out) + tx.extra.capacity();
+    for (const txin_v &in: tx.vin)
+      if (in.type() == typeid(txin_to_key))
+        bytes += boost::get<txin_to_key>(in).key_offsets.capacity() * sizeof(uint64_t);
+    bytes += tx.signatures.capacity() * sizeof(std::vector<crypto::signature>);
+    for (const auto &s: tx.signatures)
+      bytes += s.capacity() * sizeof(crypto::signature);
+
+    const rct::rctSig &rv = tx.rct_signatures;
+    bytes += rv.ecdhInfo.capacity() * sizeof(rct::ecdhTuple) + rv.outPk.capacity() * sizeof(rct::ctkey) + rv.pseudoOuts.capacity() * sizeof(rct::key);
+    for (const auto &ring: rv.mixRing)
+      bytes += ring.capacity() * sizeof(rct::ctkey);
+    const rct::rctSigPrunable &p = rv.p;
+    bytes += p.rangeSigs.capacity() * sizeof(rct::rangeSig) + p.pseudoOuts.capacity() * sizeof(rct::key);
+    for (const auto &proof: p.bulletproofs)
+      bytes += sizeof(proof) + (proof.V.capacity() + proof.L.capacity() + proof.R.capacity()) * sizeof(rct::key);
+    for (const auto &proof: p.bulletproofs_plus)
+      bytes += sizeof(proof) + (proof.V.capacity() + proof.L.capacity() + proof.R.capacity()) * sizeof(rct::key);
+    for (const auto &sig: p.CLSAGs)
+      bytes += sizeof(sig) + sig.s.capacity() * sizeof(rct::key);
+    for (const auto &sig: p.MGs)
+    {
+      bytes += sizeof(sig) + sig.II.capacity() * sizeof(rct::key);
+      for (const auto &ss: sig.ss)
+        bytes += ss.capacity() * sizeof(rct::key);
+    }
+    return bytes;
+  }
+  //---------------------------------------------------------------
+  size_t get_block_memory_usage(const block &b)
+  {
+    return sizeof(block) - sizeof(transaction) + get_transaction_memory_usage(b.miner_tx) + b.tx_hashes.capacity() * sizeof(crypto::hash);
+  }
+  //---------------------------------------------------------------
   crypto::secret_key encrypt_key(crypto::secret_key key, const epee::wipeable_string &passphrase)
   {
     crypto::hash hash;
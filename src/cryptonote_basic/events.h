@@ -30,7 +30,9 @@
 #pragma once
 
 #include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/difficulty.h"
 
 namespace cryptonote
 {
@@ -46,4 +48,19 @@ namespace cryptonote
     uint64_t weight;
     bool res; //!< Listeners must ignore `tx` when this is false.
   };
+
+  //! A ready to mine block template, as `get_block_template` would return it
+  struct block_template_event
+  {
+    cryptonote::blobdata blocktemplate_blob;
+    cryptonote::blobdata blockhashing_blob;
+    uint64_t reserved_offset;
+    uint64_t height;
+    uint64_t expected_reward;
+    difficulty_type difficulty;
+    crypto::hash prev_id;
+    uint64_t seed_height;
+    crypto::hash seed_hash;
+    crypto::hash next_seed_hash;
+  };
 }
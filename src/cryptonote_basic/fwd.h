@@ -34,5 +34,6 @@ namespace cryptonote
   struct block;
   class transaction;
   struct txpool_event;
+  struct block_template_event;
   struct tx_block_template_backlog_entry;
 }
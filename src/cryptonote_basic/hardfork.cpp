@@ -27,6 +27,7 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -178,6 +179,12 @@ void HardFork::init()
     last_versions[n] = 0;
   current_fork_index = 0;
 
+  if (restore_voting_window())
+  {
+    MDEBUG("init done, voting window restored");
+    return;
+  }
+
   // restore state from DB
   uint64_t height = db.height();
   if (height > window_size)
@@ -189,6 +196,43 @@ void HardFork::init()
   MDEBUG("init done");
 }
 
+void HardFork::get_block_votes(uint64_t h1, uint64_t h2, std::vector<uint8_t> &votes, std::vector<uint8_t> *block_versions) const
+{
+  votes.clear();
+  if (block_versions)
+    block_versions->clear();
+  if (h1 > h2)
+    return;
+
+  const size_t n = h2 - h1 + 1;
+  votes.resize(n);
+  if (block_versions)
+    block_versions->resize(n);
+
+  // each block lands in its own slot, so the scan can be split across threads
+  std::atomic<size_t> found(0);
+  db.for_blocks_range_parallel(h1, h2, [&](uint64_t height, const crypto::hash&, const cryptonote::block &b) {
+    if (height < h1 || height > h2)
+      return true;
+    votes[height - h1] = ::get_block_vote(b);
+    if (block_versions)
+      (*block_versions)[height - h1] = ::get_block_version(b);
+    ++found;
+    return true;
+  });
+  if (found == n)
+    return;
+
+  // not all dbs support range scans
+  for (uint64_t h = h1; h <= h2; ++h)
+  {
+    const cryptonote::block b = db.get_block_from_height(h);
+    votes[h - h1] = ::get_block_vote(b);
+    if (block_versions)
+      (*block_versions)[h - h1] = ::get_block_version(b);
+  }
+}
+
 uint8_t HardFork::get_block_version(uint64_t height) const
 {
   if (height <= original_version_till_height)
@@ -215,9 +259,14 @@ bool HardFork::reorganize_from_block_height(uint64_t height)
   while (current_fork_index > 0 && heights[current_fork_index].version > start_version) {
     --current_fork_index;
   }
+
+  // read the window and the blocks to replay in one go
+  const uint64_t bc_height = db.height();
+  std::vector<uint8_t> votes, block_versions;
+  get_block_votes(rescan_height, bc_height - 1, votes, &block_versions);
+
   for (uint64_t h = rescan_height; h <= height; ++h) {
-    cryptonote::block b = db.get_block_from_height(h);
-    const uint8_t v = get_effective_version(get_block_vote(b));
+    const uint8_t v = get_effective_version(votes[h - rescan_height]);
     last_versions[v]++;
     versions.push_back(v);
   }
@@ -227,9 +276,8 @@ bool HardFork::reorganize_from_block_height(uint64_t height)
     current_fork_index = voted;
   }
 
-  const uint64_t bc_height = db.height();
   for (uint64_t h = height + 1; h < bc_height; ++h) {
-    add(db.get_block_from_height(h), h);
+    add(block_versions[h - rescan_height], votes[h - rescan_height], h);
   }
 
   if (stop_batch)
@@ -256,13 +304,20 @@ bool HardFork::rescan_from_block_height(uint64_t height)
 
   for (size_t n = 0; n < 256; ++n)
     last_versions[n] = 0;
-  for (uint64_t h = height; h < db.height(); ++h) {
-    cryptonote::block b = db.get_block_from_height(h);
-    const uint8_t v = get_effective_version(get_block_vote(b));
+  std::vector<uint8_t> votes;
+  get_block_votes(height, db.height() - 1, votes);
+  for (const uint8_t vote: votes) {
+    const uint8_t v = get_effective_version(vote);
     last_versions[v]++;
     versions.push_back(v);
   }
 
+  update_current_fork_index();
+  return true;
+}
+
+void HardFork::update_current_fork_index()
+{
   uint8_t lastv = db.get_hard_fork_version(db.height() - 1);
   current_fork_index = 0;
   while (current_fork_index + 1 < heights.size() && heights[current_fork_index].version != lastv)
@@ -272,10 +327,54 @@ bool HardFork::rescan_from_block_height(uint64_t height)
   if (voted > current_fork_index) {
     current_fork_index = voted;
   }
+}
+
+bool HardFork::restore_voting_window()
+{
+  CRITICAL_REGION_LOCAL(lock);
+  db_rtxn_guard rtxn_guard(&db);
+
+  hard_fork_voting_window window;
+  if (!db.get_hard_fork_voting_window(window))
+    return false;
+
+  const uint64_t height = db.height();
+  if (height == 0 || window.height != height || window.top_hash != db.top_block_hash())
+  {
+    MDEBUG("Hard fork voting window snapshot is for another chain state, rescanning");
+    return false;
+  }
+  if (window.window_size != window_size || window.max_version != heights.back().version || window.versions.size() != std::min(window_size, height))
+  {
+    MDEBUG("Hard fork voting window snapshot does not match the fork setup, rescanning");
+    return false;
+  }
+
+  versions.assign(window.versions.begin(), window.versions.end());
+  for (const uint8_t v: versions)
+    last_versions[v]++;
 
+  update_current_fork_index();
   return true;
 }
 
+void HardFork::store_voting_window() const
+{
+  CRITICAL_REGION_LOCAL(lock);
+
+  const uint64_t height = db.height();
+  if (height == 0)
+    return;
+
+  hard_fork_voting_window window;
+  window.height = height;
+  window.top_hash = db.top_block_hash();
+  window.window_size = window_size;
+  window.max_version = heights.empty() ? original_version : heights.back().version;
+  window.versions.assign(versions.begin(), versions.end());
+  db.set_hard_fork_voting_window(window);
+}
+
 bool HardFork::rescan_from_chain_height(uint64_t height)
 {
   if (height == 0)
@@ -88,10 +88,22 @@ namespace cryptonote
     /**
      * @brief initialize the object
      *
-     * Must be done after adding all the required hardforks via add above
+     * Must be done after adding all the required hardforks via add above.
+     * The voting window is restored from the snapshot saved by
+     * store_voting_window if it matches the chain, and read back from
+     * the blocks otherwise.
      */
     void init();
 
+    /**
+     * @brief saves the voting window to the db
+     *
+     * Lets the next init skip reading the last window_size blocks back.
+     * The snapshot is checked against the chain height and top block hash
+     * on load, so storing it is only an optimization.
+     */
+    void store_voting_window() const;
+
     /**
      * @brief check whether a new block would be accepted
      *
@@ -247,6 +259,13 @@ namespace cryptonote
 
     bool rescan_from_block_height(uint64_t height);
     bool rescan_from_chain_height(uint64_t height);
+    bool restore_voting_window();
+    void update_current_fork_index();
+
+    /**
+     * @brief reads the votes (and optionally versions) of blocks [h1, h2] in one pass
+     */
+    void get_block_votes(uint64_t h1, uint64_t h2, std::vector<uint8_t> &votes, std::vector<uint8_t> *block_versions = NULL) const;
 
   private:
 
@@ -32,6 +32,7 @@
 #include "int-util.h"
 #include "crypto/crypto.h"
 #include "common/util.h"
+#include "cryptonote_format_utils.h"
 #include "merge_mining.h"
 
 using namespace epee;
@@ -93,4 +94,59 @@ bool decode_mm_depth(uint32_t depth, uint32_t &n_aux_chains, uint32_t &nonce)
   return true;
 }
 //---------------------------------------------------------------
+bool make_mm_block_template(block b, size_t mm_merkle_tree_depth, mm_block_template &t)
+{
+  // replace any existing tag with a placeholder one, at the end of extra
+  CHECK_AND_ASSERT_MES(remove_field_from_tx_extra(b.miner_tx.extra, typeid(tx_extra_merge_mining_tag)), false, "Error removing existing merkle root");
+  CHECK_AND_ASSERT_MES(add_mm_merkle_root_to_tx_extra(b.miner_tx.extra, crypto::null_hash, mm_merkle_tree_depth), false, "Error adding merkle root");
+  b.invalidate_hashes();
+  b.miner_tx.invalidate_hashes();
+  t.root_extra_offset = b.miner_tx.extra.size() - sizeof(crypto::hash);
+
+  t.block_blob = t_serializable_object_to_blob(b);
+  t.hashing_blob = get_block_hashing_blob(b);
+  const size_t header_size = t_serializable_object_to_blob(static_cast<const block_header&>(b)).size();
+  t.tree_root_offset = header_size;
+
+  // the miner tx follows the header, and its extra closes its prefix,
+  // followed by the rct type (null) from v2
+  const blobdata miner_tx_blob = tx_to_blob(b.miner_tx);
+  const size_t suffix_size = b.miner_tx.version >= 2 ? 1 : 0;
+  CHECK_AND_ASSERT_MES(miner_tx_blob.size() >= suffix_size + b.miner_tx.extra.size(), false, "Unexpected miner tx blob size");
+  t.root_blob_offset = header_size + miner_tx_blob.size() - suffix_size - b.miner_tx.extra.size() + t.root_extra_offset;
+  CHECK_AND_ASSERT_MES(t.root_blob_offset + sizeof(crypto::hash) <= t.block_blob.size()
+      && !memcmp(t.block_blob.data() + t.root_blob_offset, b.miner_tx.extra.data() + t.root_extra_offset, sizeof(crypto::hash)),
+      false, "Failed to locate merge mining merkle root in block blob");
+  CHECK_AND_ASSERT_MES(t.tree_root_offset + sizeof(crypto::hash) <= t.hashing_blob.size(), false, "Unexpected block hashing blob size");
+
+  // the branch only depends on the other txes
+  std::vector<crypto::hash> hashes;
+  hashes.reserve(b.tx_hashes.size() + 1);
+  hashes.push_back(get_transaction_hash(b.miner_tx));
+  hashes.insert(hashes.end(), b.tx_hashes.begin(), b.tx_hashes.end());
+  t.coinbase_branch.resize(hashes.size());
+  size_t depth = 0;
+  CHECK_AND_ASSERT_MES(crypto::tree_branch((const char(*)[crypto::HASH_SIZE])hashes.data(), hashes.size(), hashes[0].data,
+      (char(*)[crypto::HASH_SIZE])t.coinbase_branch.data(), &depth, &t.coinbase_path), false, "Failed to get miner tx branch");
+  t.coinbase_branch.resize(depth);
+
+  t.miner_tx = std::move(b.miner_tx);
+  return true;
+}
+//---------------------------------------------------------------
+bool set_mm_merkle_root(mm_block_template &t, const crypto::hash &mm_merkle_root)
+{
+  CHECK_AND_ASSERT_MES(t.root_extra_offset + sizeof(crypto::hash) <= t.miner_tx.extra.size(), false, "Invalid merge mining template");
+  memcpy(t.miner_tx.extra.data() + t.root_extra_offset, &mm_merkle_root, sizeof(mm_merkle_root));
+  memcpy(&t.block_blob[t.root_blob_offset], &mm_merkle_root, sizeof(mm_merkle_root));
+  t.miner_tx.invalidate_hashes();
+
+  crypto::hash tree_root;
+  const crypto::hash miner_tx_hash = get_transaction_hash(t.miner_tx);
+  CHECK_AND_ASSERT_MES(crypto::tree_branch_hash(miner_tx_hash.data, (const char(*)[crypto::HASH_SIZE])t.coinbase_branch.data(),
+      t.coinbase_branch.size(), t.coinbase_path, tree_root.data), false, "Failed to get tx tree root");
+  memcpy(&t.hashing_blob[t.tree_root_offset], &tree_root, sizeof(tree_root));
+  return true;
+}
+//---------------------------------------------------------------
 }
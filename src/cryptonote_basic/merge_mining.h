@@ -30,7 +30,10 @@
 #pragma once
 
 #include <stdint.h>
+#include <vector>
 #include "crypto/crypto.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "cryptonote_basic/cryptonote_basic.h"
 
 namespace cryptonote
 {
@@ -38,4 +41,21 @@ namespace cryptonote
   uint32_t get_path_from_aux_slot(uint32_t slot, uint32_t n_aux_chains);
   uint32_t encode_mm_depth(uint32_t n_aux_chains, uint32_t nonce);
   bool decode_mm_depth(uint32_t depth, uint32_t &n_aux_chains, uint32_t &nonce);
+
+  // a block template serialized once, so its merge mining merkle root can be
+  // changed by patching the blobs and rehashing the miner tx only
+  struct mm_block_template
+  {
+    blobdata block_blob;
+    blobdata hashing_blob;
+    transaction miner_tx;
+    size_t root_extra_offset; // merge mining merkle root in miner_tx.extra
+    size_t root_blob_offset; // the same, in block_blob
+    size_t tree_root_offset; // tx tree root in hashing_blob
+    std::vector<crypto::hash> coinbase_branch; // from the miner tx hash to the tx tree root
+    uint32_t coinbase_path;
+  };
+
+  bool make_mm_block_template(block b, size_t mm_merkle_tree_depth, mm_block_template &t);
+  bool set_mm_merkle_root(mm_block_template &t, const crypto::hash &mm_merkle_root);
 }
@@ -40,6 +40,7 @@
 #include "common/command_line.h"
 #include "common/util.h"
 #include "string_coding.h"
+#include "int-util.h"
 #include "string_tools.h"
 #include "storages/portable_storage_template_helper.h"
 #include "boost/logic/tribool.hpp"
@@ -54,6 +55,7 @@
   #include <AvailabilityMacros.h>
   #include <TargetConditionals.h>
 #elif defined(__linux__)
+  #include <pthread.h>
   #include <unistd.h>
   #include <sys/resource.h>
   #include <sys/times.h>
@@ -95,6 +97,7 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<bool>        arg_mining_pin_threads =  {"mining-pin-threads", "Pin each mining thread to one CPU", false};
     const command_line::arg_descriptor<bool>        arg_bg_mining_enable =  {"bg-mining-enable", "enable background mining", true, true};
     const command_line::arg_descriptor<bool>        arg_bg_mining_ignore_battery =  {"bg-mining-ignore-battery", "if true, assumes plugged in when unable to query system power status", false, true};    
     const command_line::arg_descriptor<uint64_t>    arg_bg_mining_min_idle_interval_seconds =  {"bg-mining-min-idle-interval", "Specify min lookback interval in seconds for determining idle state", miner::BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS, true};
@@ -103,14 +106,16 @@ namespace cryptonote
   }
 
 
-  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh):m_stop(1),
+  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh, const get_blob_hash_t &gbbh):m_stop(1),
     m_template{},
     m_template_no(0),
     m_diffic(0),
     m_thread_index(0),
     m_phandler(phandler),
     m_gbh(gbh),
+    m_gbbh(gbbh),
     m_height(0),
+    m_seed_hash(crypto::null_hash),
     m_threads_active(0),
     m_pausers_count(0),
     m_threads_total(0),
@@ -120,6 +125,7 @@ namespace cryptonote
     m_total_hashes(0),
     m_do_print_hashrate(false),
     m_do_mining(false),
+    m_pin_threads(false),
     m_current_hash_rate(0),
     m_is_background_mining_enabled(false),
     m_min_idle_seconds(BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS),
@@ -137,12 +143,13 @@ namespace cryptonote
     catch (...) { /* ignore */ }
   }
   //-----------------------------------------------------------------------------------------------------
-  bool miner::set_block_template(const block& bl, const difficulty_type& di, uint64_t height, uint64_t block_reward)
+  bool miner::set_block_template(const block& bl, const difficulty_type& di, uint64_t height, uint64_t block_reward, const crypto::hash &seed_hash)
   {
     CRITICAL_REGION_LOCAL(m_template_lock);
     m_template = bl;
     m_diffic = di;
     m_height = height;
+    m_seed_hash = seed_hash;
     m_block_reward = block_reward;
     ++m_template_no;
     m_starter_nonce = crypto::rand<uint32_t>();
@@ -177,7 +184,7 @@ namespace cryptonote
       LOG_ERROR("Failed to get_block_template(), stopping mining");
       return false;
     }
-    set_block_template(bl, di, height, expected_reward);
+    set_block_template(bl, di, height, expected_reward, seed_hash);
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
@@ -208,9 +215,12 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------------
   void miner::merge_hr()
   {
+    // take the count and the time together, so no hash is counted twice or lost
+    const uint64_t now = misc_utils::get_ns_count();
+    const uint64_t hashes = m_hashes.exchange(0);
     if(m_last_hr_merge_time && is_mining())
     {
-      m_current_hash_rate = m_hashes * 1000 / ((misc_utils::get_tick_count() - m_last_hr_merge_time + 1));
+      m_current_hash_rate = hashes * 1000000000 / (now - m_last_hr_merge_time + 1);
       CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
@@ -224,8 +234,7 @@ namespace cryptonote
         std::cout << "hashrate: " << std::setprecision(4) << std::fixed << hr << std::setiosflags(flags) << std::setprecision(precision) << ENDL;
       }
     }
-    m_last_hr_merge_time = misc_utils::get_tick_count();
-    m_hashes = 0;
+    m_last_hr_merge_time = now;
   }
   //-----------------------------------------------------------------------------------------------------
   void miner::update_autodetection()
@@ -287,6 +296,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_mining_pin_threads);
     command_line::add_arg(desc, arg_bg_mining_enable);
     command_line::add_arg(desc, arg_bg_mining_ignore_battery);    
     command_line::add_arg(desc, arg_bg_mining_min_idle_interval_seconds);
@@ -337,6 +347,8 @@ namespace cryptonote
       }
     }
 
+    m_pin_threads = command_line::get_arg(vm, arg_mining_pin_threads);
+
     // Background mining parameters
     // Let init set all parameters even if background mining is not enabled, they can start later with params set
     if(command_line::has_arg(vm, arg_bg_mining_enable))
@@ -527,11 +539,27 @@ namespace cryptonote
 
     MLOG_SET_THREAD_NAME(std::string("[miner ") + std::to_string(th_local_index) + "]");
     MGINFO("Miner thread was started ["<< th_local_index << "]");
+#ifdef __linux__
+    const unsigned cpus = boost::thread::hardware_concurrency();
+    if (m_pin_threads && cpus)
+    {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(th_local_index % cpus, &cpu_set);
+      const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+      if (err)
+        MWARNING("Failed to pin miner thread " << th_local_index << " to cpu " << th_local_index % cpus << ": " << err);
+    }
+#endif
     uint32_t nonce = m_starter_nonce + th_local_index;
     uint64_t height = 0;
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
+    crypto::hash seed_hash = crypto::null_hash;
     block b;
+    // the hashing blob is made once per template, only the nonce changes after that
+    blobdata hashing_blob;
+    size_t nonce_offset = 0;
     slow_hash_allocate_state();
     ++m_threads_active;
     while(!m_stop)
@@ -561,9 +589,15 @@ namespace cryptonote
         b = m_template;
         local_diff = m_diffic;
         height = m_height;
+        seed_hash = m_seed_hash;
         CRITICAL_REGION_END();
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
+        if (m_gbbh)
+        {
+          hashing_blob = get_block_hashing_blob(b);
+          nonce_offset = get_block_hashing_blob_nonce_offset(b);
+        }
       }
 
       if(!local_template_ver)//no any set_block_template call
@@ -573,13 +607,25 @@ namespace cryptonote
         continue;
       }
 
-      b.nonce = nonce;
       crypto::hash h;
-      m_gbh(b, height, NULL, tools::get_max_concurrency(), h);
+      if (m_gbbh)
+      {
+        const uint32_t le_nonce = SWAP32LE(nonce);
+        memcpy(&hashing_blob[nonce_offset], &le_nonce, sizeof(le_nonce));
+        // with the seed hash from the template, RandomX needs no chain lookup per hash
+        m_gbbh(hashing_blob, b.major_version, height, seed_hash == crypto::null_hash ? NULL : &seed_hash, tools::get_max_concurrency(), h);
+      }
+      else
+      {
+        b.nonce = nonce;
+        m_gbh(b, height, NULL, tools::get_max_concurrency(), h);
+      }
 
       if(check_hash(h, local_diff))
       {
         //we lucky!
+        b.nonce = nonce;
+        b.invalidate_hashes();
         ++m_config.current_extra_message_index;
         MGINFO_GREEN("Found block " << get_block_hash(b) << " at height " << height << " for difficulty: " << local_diff);
         cryptonote::block_verification_context bvc;
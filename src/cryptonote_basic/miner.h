@@ -53,6 +53,8 @@ namespace cryptonote
   };
 
   typedef std::function<bool(const cryptonote::block&, uint64_t, const crypto::hash*, unsigned int, crypto::hash&)> get_block_hash_t;
+  // hashes a block hashing blob, for a block of the given major version and height
+  typedef std::function<bool(const cryptonote::blobdata&, uint8_t, uint64_t, const crypto::hash*, unsigned int, crypto::hash&)> get_blob_hash_t;
 
   /************************************************************************/
   /*                                                                      */
@@ -60,14 +62,15 @@ namespace cryptonote
   class miner
   {
   public: 
-    miner(i_miner_handler* phandler, const get_block_hash_t& gbh);
+    miner(i_miner_handler* phandler, const get_block_hash_t& gbh, const get_blob_hash_t& gbbh = get_blob_hash_t());
     ~miner();
     bool init(const boost::program_options::variables_map& vm, network_type nettype);
     static void init_options(boost::program_options::options_description& desc);
-    bool set_block_template(const block& bl, const difficulty_type& diffic, uint64_t height, uint64_t block_reward);
+    bool set_block_template(const block& bl, const difficulty_type& diffic, uint64_t height, uint64_t block_reward, const crypto::hash &seed_hash = crypto::null_hash);
     bool on_block_chain_update();
     bool start(const account_public_address& adr, size_t threads_count, bool do_background = false, bool ignore_battery = false);
     uint64_t get_speed() const;
+    uint64_t get_total_hashes() const { return m_total_hashes; }
     uint32_t get_threads_count() const;
     void send_stop_signal();
     bool stop();
@@ -125,6 +128,7 @@ namespace cryptonote
     std::atomic<uint32_t> m_starter_nonce;
     difficulty_type m_diffic;
     uint64_t m_height;
+    crypto::hash m_seed_hash;
     std::atomic<uint32_t> m_thread_index;
     volatile uint32_t m_threads_total;
     std::atomic<uint32_t> m_threads_active;
@@ -135,6 +139,7 @@ namespace cryptonote
     epee::critical_section m_threads_lock;
     i_miner_handler* m_phandler;
     get_block_hash_t m_gbh;
+    get_blob_hash_t m_gbbh;
     account_public_address m_mine_address;
     epee::math_helper::once_a_time_seconds<5> m_update_block_template_interval;
     epee::math_helper::once_a_time_seconds<2> m_update_merge_hr_interval;
@@ -150,6 +155,7 @@ namespace cryptonote
     std::list<uint64_t> m_last_hash_rates;
     bool m_do_print_hashrate;
     bool m_do_mining;
+    bool m_pin_threads;
     std::vector<std::pair<uint64_t, uint64_t>> m_threads_autodetect;
     boost::thread::attributes m_attrs;
 
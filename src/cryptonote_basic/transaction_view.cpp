@@ -0,0 +1,474 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "transaction_view.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "common/varint.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/tx_extra.h"
+#include "ringct/rctTypes.h"
+
+namespace
+{
+  // binary_archive variant tags, see cryptonote_basic.h
+  constexpr const std::uint8_t txin_gen_tag = 0xff;
+  constexpr const std::uint8_t txin_to_key_tag = 0x2;
+  constexpr const std::uint8_t txout_to_key_tag = 0x2;
+  constexpr const std::uint8_t txout_to_tagged_key_tag = 0x3;
+
+  struct reader
+  {
+    const std::uint8_t* current;
+    const std::uint8_t* end;
+
+    std::size_t remaining() const noexcept { return end - current; }
+
+    bool varint(std::uint64_t& out) noexcept
+    {
+      return 0 <= tools::read_varint(current, end, out);
+    }
+
+    bool byte(std::uint8_t& out) noexcept
+    {
+      if (current == end)
+        return false;
+      out = *current++;
+      return true;
+    }
+
+    bool skip(const std::size_t count) noexcept
+    {
+      if (remaining() < count)
+        return false;
+      current += count;
+      return true;
+    }
+
+    bool copy(void* const out, const std::size_t count) noexcept
+    {
+      if (remaining() < count)
+        return false;
+      std::memcpy(out, current, count);
+      current += count;
+      return true;
+    }
+
+    //! \return False if `count` items of at least `min_size` bytes can't be left
+    bool fits(const std::uint64_t count, const std::size_t min_size = 1) const noexcept
+    {
+      return count <= remaining() / min_size;
+    }
+  };
+
+  bool add_amount(std::uint64_t& sum, const std::uint64_t amount) noexcept
+  {
+    if (std::numeric_limits<std::uint64_t>::max() - sum < amount)
+      return false;
+    sum += amount;
+    return true;
+  }
+}
+
+namespace cryptonote
+{
+  transaction_view::transaction_view() noexcept
+    : blob_(),
+      version_(0),
+      unlock_time_(0),
+      fee_(0),
+      inputs_(0),
+      outputs_(0),
+      inputs_offset_(0),
+      outputs_offset_(0),
+      prefix_size_(0),
+      unprunable_size_(0),
+      coinbase_(false)
+  {}
+
+  bool transaction_view::parse(const epee::span<const std::uint8_t> blob) noexcept
+  {
+    *this = transaction_view{};
+    reader in{blob.begin(), blob.end()};
+    const auto offset = [&in, &blob] () { return std::size_t(in.current - blob.begin()); };
+
+    if (!in.varint(version_) || version_ == 0 || 2 < version_)
+      return false;
+    if (!in.varint(unlock_time_))
+      return false;
+
+    std::uint64_t count = 0;
+    if (!in.varint(count) || !in.fits(count))
+      return false;
+    inputs_ = count;
+    inputs_offset_ = offset();
+
+    std::uint64_t amount_in = 0;
+    for (std::size_t i = 0; i < inputs_; ++i)
+    {
+      std::uint8_t tag = 0;
+      std::uint64_t value = 0;
+      if (!in.byte(tag))
+        return false;
+      if (tag == txin_gen_tag)
+      {
+        coinbase_ = true;
+        if (!in.varint(value))
+          return false;
+      }
+      else if (tag == txin_to_key_tag)
+      {
+        if (!in.varint(value) || !add_amount(amount_in, value))
+          return false;
+        if (!in.varint(count) || !in.fits(count))
+          return false;
+        for (std::uint64_t j = 0; j < count; ++j)
+        {
+          if (!in.varint(value))
+            return false;
+        }
+        if (!in.skip(sizeof(crypto::key_image)))
+          return false;
+      }
+      else
+        return false;
+    }
+
+    if (!in.varint(count) || !in.fits(count))
+      return false;
+    outputs_ = count;
+    outputs_offset_ = offset();
+
+    std::uint64_t amount_out = 0;
+    for (std::size_t i = 0; i < outputs_; ++i)
+    {
+      std::uint8_t tag = 0;
+      std::uint64_t value = 0;
+      if (!in.varint(value) || !add_amount(amount_out, value) || !in.byte(tag))
+        return false;
+      if (tag == txout_to_key_tag)
+      {
+        if (!in.skip(sizeof(crypto::public_key)))
+          return false;
+      }
+      else if (tag == txout_to_tagged_key_tag)
+      {
+        if (!in.skip(sizeof(crypto::public_key) + sizeof(crypto::view_tag)))
+          return false;
+      }
+      else
+        return false;
+    }
+
+    // extra
+    if (!in.varint(count) || !in.skip(count))
+      return false;
+    prefix_size_ = offset();
+
+    if (version_ == 1)
+    {
+      if (!coinbase_)
+      {
+        if (amount_in < amount_out)
+          return false;
+        fee_ = amount_in - amount_out;
+      }
+      // v1 hashes the whole blob, signatures need not be located
+      unprunable_size_ = blob.size();
+      blob_ = blob;
+      return true;
+    }
+
+    std::uint8_t type = 0;
+    if (!in.byte(type))
+      return false;
+    switch (type)
+    {
+    case rct::RCTTypeNull:
+      unprunable_size_ = offset();
+      if (in.remaining())
+        return false;
+      blob_ = blob;
+      return true;
+    case rct::RCTTypeFull:
+    case rct::RCTTypeSimple:
+    case rct::RCTTypeBulletproof:
+    case rct::RCTTypeBulletproof2:
+    case rct::RCTTypeCLSAG:
+    case rct::RCTTypeBulletproofPlus:
+      break;
+    default:
+      return false;
+    }
+
+    if (!in.varint(fee_))
+      return false;
+    if (type == rct::RCTTypeSimple && (!in.fits(inputs_, sizeof(rct::key)) || !in.skip(inputs_ * sizeof(rct::key))))
+      return false;
+
+    const bool short_ecdh = type == rct::RCTTypeBulletproof2 || type == rct::RCTTypeCLSAG || type == rct::RCTTypeBulletproofPlus;
+    const std::size_t output_size = (short_ecdh ? sizeof(crypto::hash8) : sizeof(rct::ecdhTuple)) + sizeof(rct::key);
+    if (!in.fits(outputs_, output_size) || !in.skip(outputs_ * output_size))
+      return false;
+    unprunable_size_ = offset();
+
+    // pruned blobs have no prunable part to hash
+    if (!in.remaining())
+      return false;
+
+    blob_ = blob;
+    return true;
+  }
+
+  crypto::hash transaction_view::prefix_hash() const noexcept
+  {
+    return crypto::cn_fast_hash(blob_.data(), prefix_size_);
+  }
+
+  crypto::hash transaction_view::hash() const noexcept
+  {
+    if (version_ == 1)
+      return crypto::cn_fast_hash(blob_.data(), blob_.size());
+
+    crypto::hash hashes[3];
+    hashes[0] = prefix_hash();
+    hashes[1] = crypto::cn_fast_hash(blob_.data() + prefix_size_, unprunable_size_ - prefix_size_);
+    if (unprunable_size_ == blob_.size())
+      hashes[2] = crypto::null_hash;
+    else
+      hashes[2] = crypto::cn_fast_hash(blob_.data() + unprunable_size_, blob_.size() - unprunable_size_);
+    return crypto::cn_fast_hash(hashes, sizeof(hashes));
+  }
+
+  bool transaction_view::read_key_image(std::size_t& offset, crypto::key_image& image) const noexcept
+  {
+    reader in{blob_.begin() + offset, blob_.end()};
+    std::uint8_t tag = 0;
+    std::uint64_t value = 0;
+    std::uint64_t count = 0;
+
+    in.byte(tag);
+    const bool is_key = tag == txin_to_key_tag;
+    if (is_key)
+    {
+      in.varint(value);
+      in.varint(count);
+      for (std::uint64_t j = 0; j < count; ++j)
+        in.varint(value);
+      in.copy(std::addressof(image), sizeof(image));
+    }
+    else
+      in.varint(value);
+
+    offset = in.current - blob_.begin();
+    return is_key;
+  }
+
+  void transaction_view::read_output_key(std::size_t& offset, crypto::public_key& key) const noexcept
+  {
+    reader in{blob_.begin() + offset, blob_.end()};
+    std::uint8_t tag = 0;
+    std::uint64_t value = 0;
+
+    in.varint(value);
+    in.byte(tag);
+    in.copy(std::addressof(key), sizeof(key));
+    if (tag == txout_to_tagged_key_tag)
+      in.skip(sizeof(crypto::view_tag));
+
+    offset = in.current - blob_.begin();
+  }
+
+  tx_extra_view::tx_extra_view() noexcept
+    : extra_(),
+      fields_(),
+      count_(0),
+      unindexed_offset_(0)
+  {}
+
+  bool tx_extra_view::parse(const epee::span<const std::uint8_t> extra) noexcept
+  {
+    *this = tx_extra_view{};
+    extra_ = extra;
+
+    std::size_t offset = 0;
+    while (offset < extra_.size())
+    {
+      const std::size_t start = offset;
+      field f{};
+      if (!read_field(offset, f))
+        return false;
+      if (count_ < max_indexed)
+        fields_[count_] = f;
+      else if (count_ == max_indexed)
+        unindexed_offset_ = start;
+      ++count_;
+    }
+    return true;
+  }
+
+  bool tx_extra_view::find(const std::uint8_t tag, field& out, std::size_t index) const noexcept
+  {
+    const std::size_t indexed = std::min(count_, max_indexed);
+    for (std::size_t i = 0; i < indexed; ++i)
+    {
+      if (fields_[i].tag == tag && !index--)
+      {
+        out = fields_[i];
+        return true;
+      }
+    }
+
+    std::size_t offset = unindexed_offset_;
+    for (std::size_t i = indexed; i < count_; ++i)
+    {
+      field f{};
+      read_field(offset, f);
+      if (f.tag == tag && !index--)
+      {
+        out = f;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  epee::span<const std::uint8_t> tx_extra_view::data(const field& f) const noexcept
+  {
+    return {extra_.data() + f.offset, f.size};
+  }
+
+  bool tx_extra_view::get_pub_key(crypto::public_key& key, const std::size_t index) const noexcept
+  {
+    field f{};
+    if (!find(TX_EXTRA_TAG_PUBKEY, f, index))
+      return false;
+    std::memcpy(std::addressof(key), extra_.data() + f.offset, sizeof(key));
+    return true;
+  }
+
+  std::size_t tx_extra_view::additional_pub_key_count() const noexcept
+  {
+    field f{};
+    if (!find(TX_EXTRA_TAG_ADDITIONAL_PUBKEYS, f))
+      return 0;
+    return f.size / sizeof(crypto::public_key);
+  }
+
+  bool tx_extra_view::get_additional_pub_key(const std::size_t index, crypto::public_key& key) const noexcept
+  {
+    field f{};
+    if (!find(TX_EXTRA_TAG_ADDITIONAL_PUBKEYS, f) || f.size / sizeof(crypto::public_key) <= index)
+      return false;
+    std::memcpy(std::addressof(key), extra_.data() + f.offset + index * sizeof(key), sizeof(key));
+    return true;
+  }
+
+  bool tx_extra_view::get_nonce(epee::span<const std::uint8_t>& nonce) const noexcept
+  {
+    field f{};
+    if (!find(TX_EXTRA_NONCE, f))
+      return false;
+    nonce = data(f);
+    return true;
+  }
+
+  bool tx_extra_view::get_payment_id(crypto::hash& payment_id) const noexcept
+  {
+    epee::span<const std::uint8_t> nonce;
+    if (!get_nonce(nonce) || nonce.size() != sizeof(payment_id) + 1 || nonce[0] != TX_EXTRA_NONCE_PAYMENT_ID)
+      return false;
+    std::memcpy(std::addressof(payment_id), nonce.data() + 1, sizeof(payment_id));
+    return true;
+  }
+
+  bool tx_extra_view::get_encrypted_payment_id(crypto::hash8& payment_id) const noexcept
+  {
+    epee::span<const std::uint8_t> nonce;
+    if (!get_nonce(nonce) || nonce.size() != sizeof(payment_id) + 1 || nonce[0] != TX_EXTRA_NONCE_ENCRYPTED_PAYMENT_ID)
+      return false;
+    std::memcpy(std::addressof(payment_id), nonce.data() + 1, sizeof(payment_id));
+    return true;
+  }
+
+  bool tx_extra_view::read_field(std::size_t& offset, field& out) const noexcept
+  {
+    reader in{extra_.begin() + offset, extra_.end()};
+    std::uint64_t size = 0;
+
+    if (!in.byte(out.tag))
+      return false;
+    switch (out.tag)
+    {
+    case TX_EXTRA_TAG_PADDING:
+      // zeros up to the end, the tag counting towards the maximum
+      size = in.remaining();
+      if (TX_EXTRA_PADDING_MAX_COUNT <= size || std::find_if(in.current, in.end, [](const std::uint8_t c) { return c != 0; }) != in.end)
+        return false;
+      break;
+    case TX_EXTRA_TAG_PUBKEY:
+      size = sizeof(crypto::public_key);
+      break;
+    case TX_EXTRA_NONCE:
+      if (!in.varint(size) || TX_EXTRA_NONCE_MAX_COUNT < size)
+        return false;
+      break;
+    case TX_EXTRA_MERGE_MINING_TAG:
+    {
+      // a string holding exactly a varint depth and the merkle root
+      if (!in.varint(size) || !in.fits(size))
+        return false;
+      reader tag{in.current, in.current + size};
+      std::uint64_t depth = 0;
+      if (!tag.varint(depth) || tag.remaining() != sizeof(crypto::hash))
+        return false;
+      break;
+    }
+    case TX_EXTRA_TAG_ADDITIONAL_PUBKEYS:
+      if (!in.varint(size) || !in.fits(size, sizeof(crypto::public_key)))
+        return false;
+      size *= sizeof(crypto::public_key);
+      break;
+    case TX_EXTRA_MYSTERIOUS_MINERGATE_TAG:
+      if (!in.varint(size))
+        return false;
+      break;
+    default:
+      return false;
+    }
+
+    out.offset = in.current - extra_.begin();
+    out.size = size;
+    if (!in.skip(size))
+      return false;
+    offset = in.current - extra_.begin();
+    return true;
+  }
+}
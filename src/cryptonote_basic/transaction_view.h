@@ -0,0 +1,165 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "span.h"
+
+namespace cryptonote
+{
+  /*! Read-only view of a serialized transaction, for callers that only need
+      its hash, fee, key images or output keys. Parsing records where each part
+      of the blob starts instead of building a `transaction`, and allocates
+      nothing. The blob must outlive the view.
+
+      Only full (unpruned) transactions with key inputs/outputs or a coinbase
+      input are understood; `parse` fails on anything else, and the caller
+      should fall back on `parse_and_validate_tx_from_blob`. A successful parse
+      is not validation, the transaction may still be rejected once parsed. */
+  class transaction_view
+  {
+  public:
+    transaction_view() noexcept;
+
+    //! \return False if `blob` is not a transaction this view understands.
+    bool parse(epee::span<const std::uint8_t> blob) noexcept;
+
+    std::uint64_t version() const noexcept { return version_; }
+    std::uint64_t unlock_time() const noexcept { return unlock_time_; }
+    std::size_t blob_size() const noexcept { return blob_.size(); }
+    std::size_t input_count() const noexcept { return inputs_; }
+    std::size_t output_count() const noexcept { return outputs_; }
+    bool is_coinbase() const noexcept { return coinbase_; }
+    std::uint64_t fee() const noexcept { return fee_; }
+
+    crypto::hash prefix_hash() const noexcept;
+    //! \return Same hash as `get_transaction_hash` on the parsed transaction.
+    crypto::hash hash() const noexcept;
+
+    //! Calls `f(const crypto::key_image&)` for each key input, in order.
+    template<typename F>
+    void for_each_key_image(F f) const
+    {
+      crypto::key_image image;
+      std::size_t offset = inputs_offset_;
+      for (std::size_t i = 0; i < inputs_; ++i)
+      {
+        if (read_key_image(offset, image))
+          f(image);
+      }
+    }
+
+    //! Calls `f(const crypto::public_key&)` for each output, in order.
+    template<typename F>
+    void for_each_output_key(F f) const
+    {
+      crypto::public_key key;
+      std::size_t offset = outputs_offset_;
+      for (std::size_t i = 0; i < outputs_; ++i)
+      {
+        read_output_key(offset, key);
+        f(key);
+      }
+    }
+
+  private:
+    //! Reads input at `offset` and moves it to the next. \return False for `txin_gen`.
+    bool read_key_image(std::size_t& offset, crypto::key_image& image) const noexcept;
+    //! Reads output key at `offset` and moves it to the next.
+    void read_output_key(std::size_t& offset, crypto::public_key& key) const noexcept;
+
+    epee::span<const std::uint8_t> blob_;
+    std::uint64_t version_;
+    std::uint64_t unlock_time_;
+    std::uint64_t fee_;
+    std::size_t inputs_;
+    std::size_t outputs_;
+    std::size_t inputs_offset_;
+    std::size_t outputs_offset_;
+    std::size_t prefix_size_;
+    std::size_t unprunable_size_;
+    bool coinbase_;
+  };
+
+  /*! Read-only view of a tx_extra, for callers that only need its tx keys or
+      payment id. Parsing records the tag, offset and size of each field instead
+      of building `tx_extra_field`s, and allocates nothing; fields are then read
+      in place. The extra must outlive the view.
+
+      Fields are accepted exactly as `parse_tx_extra` accepts them, and as with
+      it the fields before a bad one are kept when `parse` fails. */
+  class tx_extra_view
+  {
+  public:
+    struct field
+    {
+      std::uint8_t tag;
+      std::size_t offset; //!< Of the field data, past its tag and size
+      std::size_t size;   //!< Of the field data
+    };
+
+    tx_extra_view() noexcept;
+
+    //! \return False if `extra` did not parse fully.
+    bool parse(epee::span<const std::uint8_t> extra) noexcept;
+
+    std::size_t field_count() const noexcept { return count_; }
+    bool empty() const noexcept { return count_ == 0; }
+
+    //! \return False if there are less than `index + 1` fields with `tag`.
+    bool find(std::uint8_t tag, field& out, std::size_t index = 0) const noexcept;
+    epee::span<const std::uint8_t> data(const field& f) const noexcept;
+
+    bool get_pub_key(crypto::public_key& key, std::size_t index = 0) const noexcept;
+    std::size_t additional_pub_key_count() const noexcept;
+    bool get_additional_pub_key(std::size_t index, crypto::public_key& key) const noexcept;
+    //! \return False if there is no nonce, else the bytes of the first one.
+    bool get_nonce(epee::span<const std::uint8_t>& nonce) const noexcept;
+    //! Same as `get_payment_id_from_tx_extra_nonce` on the first nonce.
+    bool get_payment_id(crypto::hash& payment_id) const noexcept;
+    //! Same as `get_encrypted_payment_id_from_tx_extra_nonce` on the first nonce.
+    bool get_encrypted_payment_id(crypto::hash8& payment_id) const noexcept;
+
+  private:
+    //! Reads the field at `offset` and moves it to the next. \return False if malformed.
+    bool read_field(std::size_t& offset, field& out) const noexcept;
+
+    //! Fields past these are found again by parsing on from `unindexed_offset_`
+    static constexpr std::size_t max_indexed = 8;
+
+    epee::span<const std::uint8_t> extra_;
+    std::array<field, max_indexed> fields_;
+    std::size_t count_;
+    std::size_t unindexed_offset_;
+  };
+}
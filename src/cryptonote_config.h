@@ -107,6 +107,7 @@
 #define CRYPTONOTE_DANDELIONPP_MIN_EPOCH         10 // minutes
 #define CRYPTONOTE_DANDELIONPP_EPOCH_RANGE       30 // seconds
 #define CRYPTONOTE_DANDELIONPP_FLUSH_AVERAGE      5 // seconds average for poisson distributed fluff flush
+#define CRYPTONOTE_DANDELIONPP_FLUSH_MAX_THROTTLE 10 // seconds a fluff flush may be held back while the upload limit is used up
 #define CRYPTONOTE_DANDELIONPP_EMBARGO_AVERAGE   39 // seconds (see tx_pool.cpp for more info)
 
 // see src/cryptonote_protocol/levin_notify.cpp
@@ -117,6 +118,13 @@
 #define CRYPTONOTE_NOISE_BYTES                          3*1024 // 3 KiB
 #define CRYPTONOTE_NOISE_CHANNELS                       2      // Max outgoing connections per zone used for noise/covert sending
 
+// see src/cryptonote_protocol/levin_notify.cpp
+#define CRYPTONOTE_TX_RECONCILIATION_INTERVAL           8      // seconds between reconciliations with an outgoing connection
+#define CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS        4      // Max reconciling outgoing connections still flooded with each tx
+#define CRYPTONOTE_TX_RECONCILIATION_MAX_SET            4096   // Max txes held back for a connection before flooding them
+#define CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS   3072   // ~36 KiB, enough for about 1000 differences
+#define CRYPTONOTE_TXPOOL_COMPLEMENT_SKETCH_CELLS        120    // first txpool complement sketch, ~1.4 KiB for about 30 differences
+
 // Both below are in seconds. The idea is to delay forwarding from i2p/tor
 // to ipv4/6, such that 2+ incoming connections _could_ have sent the tx
 #define CRYPTONOTE_FORWARD_DELAY_BASE (CRYPTONOTE_NOISE_MIN_DELAY + CRYPTONOTE_NOISE_DELAY_RANGE)
@@ -144,6 +152,8 @@
 #define P2P_DEFAULT_WHITELIST_CONNECTIONS_PERCENT       70
 #define P2P_DEFAULT_ANCHOR_CONNECTIONS_COUNT            2
 #define P2P_DEFAULT_SYNC_SEARCH_CONNECTIONS_COUNT       2
+#define P2P_DEFAULT_CONNECT_PARALLELISM                 4
+#define P2P_CONNECT_STAGGER_MS                          250        // delay between starting parallel connection attempts
 #define P2P_DEFAULT_LIMIT_RATE_UP                       2048       // kB/s
 #define P2P_DEFAULT_LIMIT_RATE_DOWN                     8192       // kB/s
 
@@ -153,7 +163,9 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_COMPACT_BLOCKS                 0x02
+#define P2P_SUPPORT_FLAG_TX_RECONCILIATION              0x04
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_COMPACT_BLOCKS | P2P_SUPPORT_FLAG_TX_RECONCILIATION)
 
 #define RPC_IP_FAILS_BEFORE_BLOCK                       3
 
@@ -194,6 +206,7 @@
 #define HASH_OF_HASHES_STEP                     512
 
 #define DEFAULT_TXPOOL_MAX_WEIGHT               648000000ull // 3 days at 300000, in bytes
+#define DEFAULT_TXPOOL_CACHE_MAX_ENTRIES        100000 // per cache, input checks and parsed txes
 
 #define BULLETPROOF_MAX_OUTPUTS                 16
 #define BULLETPROOF_PLUS_MAX_OUTPUTS            16
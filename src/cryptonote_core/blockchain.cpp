@@ -33,6 +33,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
 
 #include "include_base_utils.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
@@ -53,6 +54,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "common/metrics.h"
 #include "common/notify.h"
 #include "common/varint.h"
 #include "common/pruning.h"
@@ -85,19 +87,47 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// enough to keep a whole difficulty window of an alt chain parsed
+#define ALT_BLOCK_CACHE_SIZE (2 * (DIFFICULTY_BLOCKS_COUNT))
+
+#define QUEUED_POW_MAX_BLOCKS 16
+
+#define ALT_BLOCK_POW_CACHE_SIZE 4096
+
+// assembled spans kept for repeated peer and wallet requests, bigger ones are not kept
+#define SPAN_CACHE_MAX_SIZE (64*1024*1024) // 64 MB
+#define SPAN_CACHE_MAX_ENTRY_SIZE (SPAN_CACHE_MAX_SIZE / 4)
+#define SPAN_CACHE_OBJECTS 1
+#define SPAN_CACHE_PRUNED 2
+#define SPAN_CACHE_MINER_TX_HASH 4
+
+namespace
+{
+  tools::metrics::counter blocks_added_metric("monero_blocks_added_total", "Blocks added to the main chain");
+  tools::metrics::counter reorgs_metric("monero_reorganizations_total", "Switches to an alternative chain");
+  tools::metrics::histogram block_processing_metric("monero_block_processing_milliseconds", "Time to verify and store a main chain block");
+  tools::metrics::histogram block_db_add_metric("monero_block_db_add_milliseconds", "Time to write a main chain block to the database");
+  tools::metrics::counter span_cache_hits_metric("monero_span_cache_hits_total", "Block spans served to peers and wallets from the span cache");
+}
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
-  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
-  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
+  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_timestamps_and_difficulties_top_hash(crypto::null_hash), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
+  m_alt_block_cache_max(ALT_BLOCK_CACHE_SIZE), m_span_cache_size(0), m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_max_prepare_historical_blocks_threads(0), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_blocks_hash_check_height(0), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
+  m_fee_estimate_top_hash(crypto::null_hash),
+  m_fee_estimate_grace_blocks(0),
   m_btc_valid(false),
   m_batch_success(true),
-  m_prepare_height(0)
+  m_prepare_height(0),
+  m_prepared_ids_height(0),
+  m_import_stage_times(),
+  m_import_stage_totals()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -128,11 +158,18 @@ bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
   return  m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
+void Blockchain::have_tx_keyimgs_as_spent(const epee::span<const crypto::key_image> key_images, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // same locking rules as have_tx_keyimg_as_spent
+  m_db->have_key_images_batch(key_images, spent);
+}
+//------------------------------------------------------------------
 // This function makes sure that each "input" in an input (mixins) exists
 // and collects the public key for each from the transaction it was included in
 // via the visitor passed to it.
 template <class visitor_t>
-bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height) const
+bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height, const std::vector<output_data_t> *prefetched_outputs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
@@ -152,7 +189,12 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
 
   bool found = false;
   auto it = m_scan_table.find(tx_prefix_hash);
-  if (it != m_scan_table.end())
+  if (prefetched_outputs && prefetched_outputs->size() == absolute_offsets.size())
+  {
+    outputs = *prefetched_outputs;
+    found = true;
+  }
+  else if (it != m_scan_table.end())
   {
     auto its = it->second.find(tx_in_to_key.k_image);
     if (its != it->second.end())
@@ -428,7 +470,6 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   if (num_popped_blocks > 0)
   {
     m_timestamps_and_difficulties_height = 0;
-    m_reset_timestamps_and_difficulties_height = true;
     m_hardfork->reorganize_from_chain_height(get_current_blockchain_height());
     uint64_t top_block_height;
     crypto::hash top_block_hash = get_tail_id(top_block_height);
@@ -512,11 +553,48 @@ bool Blockchain::deinit()
 
   MTRACE("Stopping blockchain read/write activity");
 
+ // wait for any PoW prefetch still running on the threadpool
+  {
+    boost::lock_guard<boost::mutex> lock(m_pow_prefetch_lock);
+    if (m_pow_prefetch_waiter)
+      m_pow_prefetch_waiter->wait();
+    m_pow_prefetch_waiter.reset();
+    m_pow_prefetch.reset();
+  }
+  {
+    boost::lock_guard<boost::mutex> lock(m_queued_pow_lock);
+    for (auto &e: m_queued_pow)
+      e.second->waiter.wait();
+    m_queued_pow.clear();
+  }
+
  // stop async service
   m_async_work_idle.reset();
   m_async_pool.join_all();
   m_async_service.stop();
 
+  try
+  {
+    if (m_db && m_hardfork && !m_db->is_read_only())
+      m_hardfork->store_voting_window();
+  }
+  catch (const std::exception& e)
+  {
+    MWARNING("Failed to save hard fork voting window: " << e.what());
+  }
+  try
+  {
+    if (m_db && m_txpool_store && !m_db->is_read_only())
+    {
+      CRITICAL_REGION_LOCAL(m_tx_pool);
+      const size_t written = flush_txpool_store();
+      MINFO("Saved " << written << " txpool changes");
+    }
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Failed to save the in memory txpool: " << e.what());
+  }
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
   // memory operation), otherwise we may cause a loop.
@@ -559,6 +637,11 @@ void Blockchain::pop_blocks(uint64_t nblocks)
     const uint64_t blockchain_height = m_db->height();
     if (blockchain_height > 0)
       nblocks = std::min(nblocks, blockchain_height - 1);
+    if (nblocks > 1)
+    {
+      pop_blocks_bulk(nblocks);
+      i = nblocks;
+    }
     while (i < nblocks)
     {
       pop_block_from_blockchain();
@@ -593,14 +676,19 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
-
   block popped_block;
   std::vector<transaction> popped_txs;
 
   CHECK_AND_ASSERT_THROW_MES(m_db->height() > 1, "Cannot pop the genesis block");
 
+  // the difficulty and long term weight windows can follow the pop if they
+  // were up to date with the block being popped
+  const crypto::hash old_top_hash = m_db->top_block_hash();
+  const bool move_difficulty_window = m_timestamps_and_difficulties_height == m_db->height() && m_timestamps_and_difficulties_top_hash == old_top_hash;
+  const bool move_long_term_weights = m_long_term_block_weights_cache_tip_hash == old_top_hash;
+  m_timestamps_and_difficulties_height = 0;
+  m_long_term_block_weights_cache_tip_hash = crypto::null_hash;
+
   const uint8_t previous_hf_version = get_current_hard_fork_version();
   try
   {
@@ -622,6 +710,30 @@ block Blockchain::pop_block_from_blockchain()
   // make sure the hard fork object updates its current version
   m_hardfork->on_block_popped(1);
 
+  uint64_t new_top_height;
+  const crypto::hash new_top_hash = m_db->top_block_hash(&new_top_height);
+  const uint64_t new_height = new_top_height + 1;
+  if (move_difficulty_window && !m_timestamps.empty())
+  {
+    m_timestamps.pop_back();
+    m_difficulties.pop_back();
+    if (new_height > static_cast<uint64_t>(DIFFICULTY_BLOCKS_COUNT))
+    {
+      const uint64_t index = new_height - static_cast<uint64_t>(DIFFICULTY_BLOCKS_COUNT);
+      m_timestamps.insert(m_timestamps.begin(), m_db->get_block_timestamp(index));
+      m_difficulties.insert(m_difficulties.begin(), m_db->get_block_cumulative_difficulty(index));
+    }
+    m_timestamps_and_difficulties_height = new_height;
+    m_timestamps_and_difficulties_top_hash = new_top_hash;
+  }
+  // the window ended at the popped block, the block it had pushed out is
+  // the one just before its start
+  if (move_long_term_weights && new_height >= m_long_term_block_weights_window &&
+      m_long_term_block_weights_cache_rolling_median.undo_insert(m_db->get_block_long_term_weight(new_height - m_long_term_block_weights_window)))
+  {
+    m_long_term_block_weights_cache_tip_hash = new_top_hash;
+  }
+
   // return transactions from popped block to the tx_pool
   size_t pruned = 0;
   for (transaction& tx : popped_txs)
@@ -663,6 +775,7 @@ block Blockchain::pop_block_from_blockchain()
   crypto::hash top_block_hash = get_tail_id(top_block_height);
   m_tx_pool.on_blockchain_dec(top_block_height, top_block_hash);
   invalidate_block_template_cache();
+  invalidate_span_cache(m_db->height());
 
   const uint8_t new_hf_version = get_current_hard_fork_version();
   if (new_hf_version != previous_hf_version)
@@ -674,13 +787,99 @@ block Blockchain::pop_block_from_blockchain()
   return popped_block;
 }
 //------------------------------------------------------------------
+void Blockchain::pop_blocks_bulk(uint64_t nblocks, std::list<block> *popped_blocks)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  CHECK_AND_ASSERT_THROW_MES(nblocks < m_db->height(), "Cannot pop the genesis block");
+
+  TIME_MEASURE_START(t);
+  const uint8_t previous_hf_version = get_current_hard_fork_version();
+  m_timestamps_and_difficulties_height = 0;
+  m_long_term_block_weights_cache_tip_hash = crypto::null_hash;
+
+  // popped top first, so the outer vector runs from the newest block down
+  std::vector<std::vector<transaction>> popped_txs(nblocks);
+  for (uint64_t i = 0; i < nblocks; ++i)
+  {
+    block popped_block;
+    try
+    {
+      m_db->pop_block(popped_block, popped_txs[i]);
+      if (popped_blocks)
+        popped_blocks->push_front(std::move(popped_block));
+    }
+    // the caller aborts the batch, leaving the hard fork state untouched
+    // matches the db again
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("Error popping block from blockchain: " << e.what());
+      throw;
+    }
+    catch (...)
+    {
+      LOG_ERROR("Error popping block from blockchain, throwing!");
+      throw;
+    }
+  }
+
+  // make sure the hard fork object updates its current version
+  m_hardfork->on_block_popped(nblocks);
+
+  m_blocks_longhash_table.clear();
+  m_scan_table.clear();
+  m_blocks_txs_check.clear();
+
+  // return transactions from popped blocks to the tx_pool, in chain order,
+  // once the db and hard fork state are at the final height
+  const uint8_t version = get_ideal_hard_fork_version(m_db->height());
+  size_t pruned = 0, returned = 0;
+  for (auto it = popped_txs.rbegin(); it != popped_txs.rend(); ++it)
+  {
+    for (transaction& tx : *it)
+    {
+      if (tx.pruned)
+      {
+        ++pruned;
+        continue;
+      }
+      if (is_coinbase(tx))
+        continue;
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!m_tx_pool.add_tx(tx, tvc, relay_method::block, true, version))
+        LOG_ERROR("Error returning transaction to tx_pool");
+      else
+        ++returned;
+    }
+    it->clear();
+  }
+  if (pruned)
+    MWARNING(pruned << " pruned txes could not be added back to the txpool");
+
+  uint64_t top_block_height;
+  crypto::hash top_block_hash = get_tail_id(top_block_height);
+  m_tx_pool.on_blockchain_dec(top_block_height, top_block_hash);
+  invalidate_block_template_cache();
+  invalidate_span_cache(m_db->height());
+
+  const uint8_t new_hf_version = get_current_hard_fork_version();
+  if (new_hf_version != previous_hf_version)
+  {
+    MINFO("Validating txpool for v" << (unsigned)new_hf_version);
+    m_tx_pool.validate(new_hf_version);
+  }
+  TIME_MEASURE_FINISH(t);
+  MINFO("Popped " << nblocks << " blocks down to height " << m_db->height() << ", " << returned << " txes returned to the pool, in " << t << " ms");
+}
+//------------------------------------------------------------------
 bool Blockchain::reset_and_set_genesis_block(const block& b)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
   invalidate_block_template_cache();
+  invalidate_span_cache(0);
   m_db->reset();
   m_db->drop_alt_blocks();
   m_hardfork->init();
@@ -696,7 +895,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
 crypto::hash Blockchain::get_tail_id(uint64_t& height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   return m_db->top_block_hash(&height);
 }
 //------------------------------------------------------------------
@@ -725,7 +924,7 @@ crypto::hash Blockchain::get_tail_id() const
 bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t i = 0;
   uint64_t current_multiplier = 1;
   uint64_t sz = m_db->height();
@@ -733,7 +932,6 @@ bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
   if(!sz)
     return true;
 
-  db_rtxn_guard rtxn_guard(m_db);
   bool genesis_included = false;
   uint64_t current_back_offset = 1;
   while(current_back_offset < sz)
@@ -801,8 +999,7 @@ crypto::hash Blockchain::get_pending_block_id_by_height(uint64_t height) const
 bool Blockchain::get_block_by_hash(const crypto::hash &h, block &blk, bool *orphan) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   // try to find block in main chain
   try
   {
@@ -892,37 +1089,45 @@ start:
   // 1. Keep a list of the last 735 (or less) blocks that is used to compute difficulty,
   //    then when the next block difficulty is queried, push the latest height data and
   //    pop the oldest one from the list. This only requires 1x read per height instead
-  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT).
-  bool check = false;
-  if (m_reset_timestamps_and_difficulties_height)
-    m_timestamps_and_difficulties_height = 0;
-  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1) && m_timestamps.size() >= DIFFICULTY_BLOCKS_COUNT)
+  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT). pop_block_from_blockchain moves it back
+  //    down the same way, so reorgs do not need a rebuild either. The top hash is what
+  //    says the list is still valid, so a batch abort can't leave it out of step.
+  bool cached = false;
+  if (m_timestamps_and_difficulties_height != 0)
   {
-    uint64_t index = height - 1;
-    m_timestamps.push_back(m_db->get_block_timestamp(index));
-    m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
+    if (m_timestamps_and_difficulties_height == height && m_timestamps_and_difficulties_top_hash == top_hash)
+    {
+      cached = true;
+    }
+    else if (m_timestamps_and_difficulties_height + 1 == height && m_db->get_block_hash_from_height(height - 2) == m_timestamps_and_difficulties_top_hash)
+    {
+      uint64_t index = height - 1;
+      m_timestamps.push_back(m_db->get_block_timestamp(index));
+      m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
 
-    while (m_timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_timestamps.erase(m_timestamps.begin());
-    while (m_difficulties.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_difficulties.erase(m_difficulties.begin());
+      while (m_timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
+        m_timestamps.erase(m_timestamps.begin());
+      while (m_difficulties.size() > DIFFICULTY_BLOCKS_COUNT)
+        m_difficulties.erase(m_difficulties.begin());
 
-    m_timestamps_and_difficulties_height = height;
+      m_timestamps_and_difficulties_height = height;
+      m_timestamps_and_difficulties_top_hash = top_hash;
+      cached = true;
+    }
+  }
+
+  if (cached)
+  {
+    ss << "Using cached window of " << m_timestamps.size() << std::endl;
     timestamps = m_timestamps;
     difficulties = m_difficulties;
-    check = true;
   }
-  //else
-  std::vector<uint64_t> timestamps_from_cache = timestamps;
-  std::vector<difficulty_type> difficulties_from_cache = difficulties;
-
+  else
   {
     uint64_t offset = height - std::min <uint64_t> (height, static_cast<uint64_t>(DIFFICULTY_BLOCKS_COUNT));
     if (offset == 0)
       ++offset;
 
-    timestamps.clear();
-    difficulties.clear();
     if (height > offset)
     {
       timestamps.reserve(height - offset);
@@ -935,29 +1140,8 @@ start:
       difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
     }
 
-    if (check) if (timestamps != timestamps_from_cache || difficulties !=difficulties_from_cache)
-    {
-      ss << "Inconsistency XXX:" << std::endl;
-      ss << "top hash: "<<top_hash << std::endl;
-      ss << "timestamps: " << timestamps_from_cache.size() << " from cache, but " << timestamps.size() << " without" << std::endl;
-      ss << "difficulties: " << difficulties_from_cache.size() << " from cache, but " << difficulties.size() << " without" << std::endl;
-      ss << "timestamps_from_cache:" << std::endl; for (const auto &v :timestamps_from_cache) ss << "  " << v << std::endl;
-      ss << "timestamps:" << std::endl; for (const auto &v :timestamps) ss << "  " << v << std::endl;
-      ss << "difficulties_from_cache:" << std::endl; for (const auto &v :difficulties_from_cache) ss << "  " << v << std::endl;
-      ss << "difficulties:" << std::endl; for (const auto &v :difficulties) ss << "  " << v << std::endl;
-
-      uint64_t dbh = m_db->height();
-      uint64_t sh = dbh < 10000 ? 0 : dbh - 10000;
-      ss << "History from -10k at :" << dbh << ", from " << sh << std::endl;
-      for (uint64_t h = sh; h < dbh; ++h)
-      {
-        uint64_t ts = m_db->get_block_timestamp(h);
-        difficulty_type d = m_db->get_block_cumulative_difficulty(h);
-        ss << "  " << h << " " << ts << " " << d << std::endl;
-      }
-      print = true;
-    }
     m_timestamps_and_difficulties_height = height;
+    m_timestamps_and_difficulties_top_hash = top_hash;
     m_timestamps = timestamps;
     m_difficulties = difficulties;
   }
@@ -1100,7 +1284,7 @@ size_t Blockchain::recalculate_difficulties(boost::optional<uint64_t> start_heig
 //------------------------------------------------------------------
 std::vector<time_t> Blockchain::get_last_block_timestamps(unsigned int blocks) const
 {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t height = m_db->height();
   if (blocks > height)
     blocks = height;
@@ -1124,9 +1308,6 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
     return true;
   }
 
-  m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
-
   // remove blocks from blockchain until we get back to where we should be.
   while (m_db->height() != rollback_height)
   {
@@ -1162,9 +1343,6 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
-
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
 
@@ -1175,9 +1353,30 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
     return false;
   }
 
+  TIME_MEASURE_START(t_reorg);
+
   // pop blocks from the blockchain until the top block is the parent
-  // of the front block of the alt chain.
+  // of the front block of the alt chain, in a single db transaction
   std::list<block> disconnected_chain;
+  const uint64_t depth = m_db->height() - m_db->get_block_height(alt_chain.front().bl.prev_id) - 1;
+  if (depth > 1)
+  {
+    bool stop_batch = m_db->batch_start();
+    try
+    {
+      pop_blocks_bulk(depth, &disconnected_chain);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to pop blocks before switching to alternative blockchain: " << e.what());
+      if (!stop_batch)
+        throw;
+      m_db->batch_abort();
+      return false;
+    }
+    if (stop_batch)
+      m_db->batch_stop();
+  }
   while (m_db->top_block_hash() != alt_chain.front().bl.prev_id)
   {
     block b = pop_block_from_blockchain();
@@ -1193,8 +1392,16 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
     const auto &bei = *alt_ch_iter;
     block_verification_context bvc = {};
 
+    // the PoW was checked when the block was added to its alt chain, against
+    // the same seed it has now, and ring signatures of its txes were cached then
+    const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
+    const auto pow = m_alt_block_pow.find(blkid);
+    if (pow != m_alt_block_pow.end())
+      m_blocks_longhash_table.emplace(blkid, pow->second);
+
     // add block to main chain
-    bool r = handle_block_to_main_chain(bei.bl, bvc, false);
+    bool r = handle_block_to_main_chain(bei.bl, blkid, bvc, false);
+    m_blocks_longhash_table.erase(blkid);
 
     // if adding block to main chain failed, rollback to previous state and
     // return false
@@ -1210,7 +1417,6 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
       // FIXME: Why do we keep invalid blocks around?  Possibly in case we hear
       // about them again so we can immediately dismiss them, but needs some
       // looking into.
-      const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
       add_block_as_invalid(bei, blkid);
       MERROR("The block was inserted as invalid while connecting new alternative chain, block_id: " << blkid);
       m_db->remove_alt_block(blkid);
@@ -1231,6 +1437,8 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
   const size_t discarded_blocks = disconnected_chain.size();
   if(!discard_disconnected_chain)
   {
+    precompute_disconnected_pow(disconnected_chain, split_height);
+
     //pushing old chain as alternative chain
     for (auto& old_ch_ent : disconnected_chain)
     {
@@ -1248,7 +1456,9 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
   //removing alt_chain entries from alternative chains container
   for (const auto &bei: alt_chain)
   {
-    m_db->remove_alt_block(cryptonote::get_block_hash(bei.bl));
+    const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
+    m_db->remove_alt_block(blkid);
+    m_alt_block_pow.erase(blkid);
   }
 
   m_hardfork->reorganize_from_chain_height(split_height);
@@ -1280,10 +1490,56 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
   if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
     rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
 
-  MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
+  reorgs_metric.inc();
+  TIME_MEASURE_FINISH(t_reorg);
+  MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height() << ", " << discarded_blocks << " blocks replaced in " << t_reorg << " ms");
   return true;
 }
 //------------------------------------------------------------------
+// Blocks popped off the main chain are checked again when they are added
+// back as alt blocks, one after the other. The PoW of each only depends on
+// the disconnected chain itself, so it is all computed at once beforehand.
+void Blockchain::precompute_disconnected_pow(const std::list<block> &disconnected_chain, uint64_t split_height)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (disconnected_chain.size() < 2 || m_alt_block_pow.size() + disconnected_chain.size() > ALT_BLOCK_POW_CACHE_SIZE)
+    return;
+
+  std::vector<const block*> blocks;
+  std::vector<crypto::hash> ids;
+  blocks.reserve(disconnected_chain.size());
+  ids.reserve(disconnected_chain.size());
+  for (const block &b: disconnected_chain)
+  {
+    blocks.push_back(&b);
+    ids.push_back(get_block_hash(b));
+  }
+
+  std::vector<crypto::hash> pow(blocks.size(), crypto::null_hash);
+  std::vector<uint8_t> computed(blocks.size(), 0);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    // only the RandomX PoW takes an explicit seed
+    if (blocks[i]->major_version < RX_BLOCK_VERSION || m_alt_block_pow.find(ids[i]) != m_alt_block_pow.end())
+      continue;
+    const uint64_t height = split_height + i;
+    const uint64_t seedheight = crypto::rx_seedheight(height);
+    const crypto::hash seedhash = seedheight >= split_height ? ids[seedheight - split_height] : get_block_id_by_height(seedheight);
+    tpool.submit(&waiter, [&blocks, &pow, &computed, i, seedhash]() {
+      get_altblock_longhash(*blocks[i], pow[i], seedhash);
+      computed[i] = 1;
+    }, true);
+  }
+  if (!waiter.wait())
+    return;
+
+  for (size_t i = 0; i < blocks.size(); ++i)
+    if (computed[i])
+      m_alt_block_pow[ids[i]] = pow[i];
+}
+//------------------------------------------------------------------
 // This function calculates the difficulty target for the block being added to
 // an alternate chain.
 difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std::list<block_extended_info>& alt_chain, block_extended_info& bei) const
@@ -1312,11 +1568,27 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
     if(!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
 
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+    // get difficulties and timestamps from relevant main chain blocks, from
+    // the main chain difficulty window when it covers them, as it usually
+    // does for alt chains branching off near the top
+    bool from_window = false;
+    if (m_timestamps_and_difficulties_height == m_db->height() && m_timestamps_and_difficulties_top_hash == m_db->top_block_hash())
+    {
+      const uint64_t window_start = m_timestamps_and_difficulties_height - m_timestamps.size();
+      if (main_chain_start_offset >= window_start && main_chain_start_offset <= main_chain_stop_offset && main_chain_stop_offset <= m_timestamps_and_difficulties_height)
+      {
+        timestamps.assign(m_timestamps.begin() + (main_chain_start_offset - window_start), m_timestamps.begin() + (main_chain_stop_offset - window_start));
+        cumulative_difficulties.assign(m_difficulties.begin() + (main_chain_start_offset - window_start), m_difficulties.begin() + (main_chain_stop_offset - window_start));
+        from_window = true;
+      }
+    }
+    if (!from_window)
     {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+      {
+        timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
+        cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      }
     }
 
     // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
@@ -1459,7 +1731,7 @@ bool Blockchain::validate_miner_transaction(const block& b, size_t cumulative_bl
 void Blockchain::get_last_n_blocks_weights(std::vector<uint64_t>& weights, size_t count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   auto h = m_db->height();
 
   // this function is meaningless for an empty blockchain...granted it should never be empty
@@ -1510,12 +1782,24 @@ uint64_t Blockchain::get_long_term_block_weight_median(uint64_t start_height, si
     }
   }
 
+  // and after a pop, the window often needs to move one block down, which
+  // the rolling median can undo if it is full
+  if (count == (size_t)m_long_term_block_weights_cache_rolling_median.size() && tip_height + 1 < blockchain_height)
+  {
+    crypto::hash next_tip_hash = m_db->get_block_hash_from_height(tip_height + 1);
+    if (next_tip_hash == m_long_term_block_weights_cache_tip_hash &&
+        m_long_term_block_weights_cache_rolling_median.undo_insert(m_db->get_block_long_term_weight(start_height)))
+    {
+      MTRACE("requesting " << count << " from " << start_height << ", decremental");
+      m_long_term_block_weights_cache_tip_hash = tip_hash;
+      return m_long_term_block_weights_cache_rolling_median.median();
+    }
+  }
+
   MTRACE("requesting " << count << " from " << start_height << ", uncached");
   std::vector<uint64_t> weights = m_db->get_long_term_block_weights(start_height, count);
   m_long_term_block_weights_cache_tip_hash = tip_hash;
-  m_long_term_block_weights_cache_rolling_median.clear();
-  for (uint64_t w: weights)
-    m_long_term_block_weights_cache_rolling_median.insert(w);
+  m_long_term_block_weights_cache_rolling_median.assign(weights.begin(), weights.end());
   return m_long_term_block_weights_cache_rolling_median.median();
 }
 //------------------------------------------------------------------
@@ -1862,25 +2146,192 @@ bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vect
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::set_alt_block_cache_size(size_t max_blocks)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_alt_block_cache_max = max_blocks;
+  while (m_alt_block_cache.size() > m_alt_block_cache_max)
+    m_alt_block_cache.pop_back();
+}
+//------------------------------------------------------------------
+void Blockchain::get_memory_usage(std::vector<tools::memory_usage> &usage) const
+{
+  using namespace tools::memory;
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  uint64_t entries = 0, bytes = 0;
+  for (const auto &e: m_alt_block_cache)
+    bytes += get_block_memory_usage(e.bl) + 4 * sizeof(void*);
+  usage.push_back({"alt_block_cache", m_alt_block_cache.size(), bytes + m_alt_block_cache.get<1>().bucket_count() * sizeof(void*)});
+  {
+    boost::lock_guard<boost::mutex> lock(m_span_cache_lock);
+    usage.push_back({"span_cache", m_span_cache.size(), m_span_cache_size + m_span_cache.get<1>().bucket_count() * sizeof(void*)});
+  }
+
+  bytes = hash_container_bytes(m_invalid_blocks);
+  for (const auto &e: m_invalid_blocks)
+    bytes += get_block_memory_usage(e.second.bl) - sizeof(block);
+  usage.push_back({"invalid_blocks", m_invalid_blocks.size(), bytes});
+
+  bytes = hash_container_bytes(m_scan_table);
+  for (const auto &e: m_scan_table)
+  {
+    entries += e.second.size();
+    bytes += hash_container_bytes(e.second);
+    for (const auto &outputs: e.second)
+      bytes += vector_bytes(outputs.second);
+  }
+  usage.push_back({"scan_table", entries, bytes});
+
+  usage.push_back({"pow_hashes", m_blocks_longhash_table.size(), hash_container_bytes(m_blocks_longhash_table)});
+  usage.push_back({"alt_block_pow", m_alt_block_pow.size(), hash_container_bytes(m_alt_block_pow)});
+  {
+    boost::lock_guard<boost::mutex> lock(m_queued_pow_lock);
+    usage.push_back({"queued_pow", m_queued_pow.size(), hash_container_bytes(m_queued_pow) + m_queued_pow.size() * sizeof(queued_pow_t)});
+  }
+  usage.push_back({"hash_checkpoints", get_compiled_hash_of_hashes_count() + m_blocks_hash_check.size() + m_blocks_txs_check.size(),
+      vector_bytes(m_blocks_hash_check) + vector_bytes(m_blocks_txs_check)});
+  usage.push_back({"prepared_block_ids", m_prepared_ids.size(), vector_bytes(m_prepared_ids)});
+  usage.push_back({"difficulty_window", m_timestamps.size(), vector_bytes(m_timestamps) + vector_bytes(m_difficulties)});
+}
+//------------------------------------------------------------------
+size_t Blockchain::span_cache_key_hash::operator()(const span_cache_key &key) const
+{
+  size_t seed = 0;
+  boost::hash_combine(seed, key.start_height);
+  boost::hash_combine(seed, key.count);
+  boost::hash_combine(seed, key.max_tx_count);
+  boost::hash_combine(seed, key.flags);
+  return seed;
+}
+//------------------------------------------------------------------
+bool Blockchain::find_cached_span(const span_cache_key &key, span_cache_entry &entry) const
+{
+  const uint64_t db_height = m_db->height();
+  boost::lock_guard<boost::mutex> lock(m_span_cache_lock);
+  auto &by_key = m_span_cache.get<1>();
+  auto it = by_key.find(key);
+  if (it == by_key.end())
+    return false;
+  // a span cut short by the top of the chain would have more blocks now, and
+  // one assembled on another snapshot may be on blocks popped since
+  if ((it->chain_height && it->chain_height != db_height) ||
+      (it->end_height && (it->end_height > db_height || m_db->get_block_hash_from_height(it->end_height - 1) != it->top_id)))
+  {
+    m_span_cache_size -= it->bytes;
+    by_key.erase(it);
+    return false;
+  }
+  m_span_cache.relocate(m_span_cache.begin(), m_span_cache.project<0>(it));
+  span_cache_hits_metric.inc();
+  entry = *it;
+  return true;
+}
+//------------------------------------------------------------------
+void Blockchain::cache_span(span_cache_entry &&entry) const
+{
+  entry.bytes = sizeof(entry) + entry.ids.size() * sizeof(crypto::hash);
+  for (const block_complete_entry &e: entry.objects)
+  {
+    entry.bytes += sizeof(e) + e.block.size();
+    for (const tx_blob_entry &tx: e.txs)
+      entry.bytes += sizeof(tx) + tx.blob.size();
+  }
+  for (const auto &e: entry.supplement)
+  {
+    entry.bytes += sizeof(e) + e.first.first.size();
+    for (const auto &tx: e.second)
+      entry.bytes += sizeof(tx) + tx.second.size();
+  }
+  if (entry.bytes > SPAN_CACHE_MAX_ENTRY_SIZE)
+    return;
+  entry.top_id = entry.end_height ? m_db->get_block_hash_from_height(entry.end_height - 1) : crypto::null_hash;
+
+  boost::lock_guard<boost::mutex> lock(m_span_cache_lock);
+  auto &by_key = m_span_cache.get<1>();
+  auto it = by_key.find(entry.key);
+  if (it != by_key.end())
+  {
+    m_span_cache_size -= it->bytes;
+    by_key.erase(it);
+  }
+  m_span_cache_size += entry.bytes;
+  m_span_cache.push_front(std::move(entry));
+  while (m_span_cache_size > SPAN_CACHE_MAX_SIZE)
+  {
+    m_span_cache_size -= m_span_cache.back().bytes;
+    m_span_cache.pop_back();
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::invalidate_span_cache(uint64_t height)
+{
+  boost::lock_guard<boost::mutex> lock(m_span_cache_lock);
+  for (auto it = m_span_cache.begin(); it != m_span_cache.end(); )
+  {
+    if (it->end_height > height)
+    {
+      m_span_cache_size -= it->bytes;
+      it = m_span_cache.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+//------------------------------------------------------------------
+bool Blockchain::get_alt_block_extended_info(const crypto::hash &id, block_extended_info &bei) const
+{
+  // the metadata always comes from the db, which is what says whether the
+  // block is still an alt block
+  cryptonote::alt_block_data_t data;
+  auto &by_id = m_alt_block_cache.get<1>();
+  auto it = by_id.find(id);
+  if (it != by_id.end())
+  {
+    if (!m_db->get_alt_block(id, &data, NULL))
+      return false;
+    bei.bl = it->bl;
+    m_alt_block_cache.relocate(m_alt_block_cache.begin(), m_alt_block_cache.project<0>(it));
+  }
+  else
+  {
+    cryptonote::blobdata blob;
+    if (!m_db->get_alt_block(id, &data, &blob))
+      return false;
+    CHECK_AND_ASSERT_THROW_MES(cryptonote::parse_and_validate_block_from_blob(blob, bei.bl), "Failed to parse alt block");
+    m_alt_block_cache.push_front({id, bei.bl});
+    if (m_alt_block_cache.size() > m_alt_block_cache_max)
+      m_alt_block_cache.pop_back();
+  }
+  bei.height = data.height;
+  bei.block_cumulative_weight = data.cumulative_weight;
+  bei.cumulative_difficulty = data.cumulative_difficulty_high;
+  bei.cumulative_difficulty = (bei.cumulative_difficulty << 64) + data.cumulative_difficulty_low;
+  bei.already_generated_coins = data.already_generated_coins;
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::build_alt_chain(const crypto::hash &prev_id, std::list<block_extended_info>& alt_chain, std::vector<uint64_t> &timestamps, block_verification_context& bvc) const
 {
     //build alternative subchain, front -> mainchain, back -> alternative head
-    cryptonote::alt_block_data_t data;
-    cryptonote::blobdata blob;
-    bool found = m_db->get_alt_block(prev_id, &data, &blob);
     timestamps.clear();
-    while(found)
+    crypto::hash id = prev_id;
+    while(true)
     {
       block_extended_info bei;
-      CHECK_AND_ASSERT_MES(cryptonote::parse_and_validate_block_from_blob(blob, bei.bl), false, "Failed to parse alt block");
-      bei.height = data.height;
-      bei.block_cumulative_weight = data.cumulative_weight;
-      bei.cumulative_difficulty = data.cumulative_difficulty_high;
-      bei.cumulative_difficulty = (bei.cumulative_difficulty << 64) + data.cumulative_difficulty_low;
-      bei.already_generated_coins = data.already_generated_coins;
+      try
+      {
+        if (!get_alt_block_extended_info(id, bei))
+          break;
+      }
+      catch (const std::exception &e)
+      {
+        MERROR(e.what());
+        return false;
+      }
       timestamps.push_back(bei.bl.timestamp);
+      id = bei.bl.prev_id;
       alt_chain.push_front(std::move(bei));
-      found = m_db->get_alt_block(bei.bl.prev_id, &data, &blob);
     }
 
     // if block to be added connects to known blocks that aren't part of the
@@ -1927,8 +2378,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
-  m_reset_timestamps_and_difficulties_height = true;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -2019,7 +2468,12 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
       {
         seedhash = get_block_id_by_height(seedheight);
       }
-      get_altblock_longhash(bei.bl, proof_of_work, seedhash);
+      crypto::hash queued_seedhash;
+      const auto cached_pow = m_alt_block_pow.find(id);
+      if (cached_pow != m_alt_block_pow.end())
+        proof_of_work = cached_pow->second;
+      else if (!take_queued_pow(id, proof_of_work, queued_seedhash) || queued_seedhash != seedhash)
+        get_altblock_longhash(bei.bl, proof_of_work, seedhash);
     } else
     {
       get_block_longhash(this, bei.bl, proof_of_work, bei.height, 0);
@@ -2031,6 +2485,9 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
       bvc.m_bad_pow = true;
       return false;
     }
+    if (m_alt_block_pow.size() >= ALT_BLOCK_POW_CACHE_SIZE)
+      m_alt_block_pow.clear();
+    m_alt_block_pow[id] = proof_of_work;
 
     if(!prevalidate_miner_transaction(b, bei.height, hf_version))
     {
@@ -2102,6 +2559,8 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     data.cumulative_difficulty_high = ((bei.cumulative_difficulty >> 64) & 0xffffffffffffffff).convert_to<uint64_t>();
     data.already_generated_coins = bei.already_generated_coins;
     m_db->add_alt_block(id, data, cryptonote::block_to_blob(bei.bl));
+    if (m_alt_block_cache.push_front({id, bei.bl}).second && m_alt_block_cache.size() > m_alt_block_cache_max)
+      m_alt_block_cache.pop_back();
     alt_chain.push_back(bei);
 
     // FIXME: is it even possible for a checkpoint to show up not on the main chain?
@@ -2150,7 +2609,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks, std::vector<cryptonote::blobdata>& txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   if(start_offset >= m_db->height())
     return false;
 
@@ -2172,7 +2631,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   const uint64_t height = m_db->height();
   if(start_offset >= height)
     return false;
@@ -2203,8 +2662,23 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   db_rtxn_guard rtxn_guard (m_db);
   rsp.current_blockchain_height = get_current_blockchain_height();
+
+  // peers syncing from us ask for the same spans, keyed by where they start
+  span_cache_key key{0, arg.blocks.size(), 0, uint8_t(SPAN_CACHE_OBJECTS | (arg.prune ? SPAN_CACHE_PRUNED : 0))};
+  const bool cacheable = !arg.blocks.empty() && m_db->block_exists(arg.blocks.front(), &key.start_height);
+  if (cacheable)
+  {
+    span_cache_entry entry;
+    if (find_cached_span(key, entry) && entry.ids == arg.blocks)
+    {
+      rsp.blocks = std::move(entry.objects);
+      return true;
+    }
+  }
+
   std::vector<std::pair<cryptonote::blobdata,block>> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
+  uint64_t end_height = 0;
 
   for (size_t i = 0; i < blocks.size(); ++i)
   {
@@ -2241,6 +2715,13 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
     e.block_weight = 0;
     if (arg.prune && m_db->block_exists(arg.blocks[i]))
       e.block_weight = m_db->get_block_weight(m_db->get_block_height(arg.blocks[i]));
+    end_height = std::max(end_height, get_block_height(bl.second) + 1);
+  }
+
+  if (cacheable && rsp.missed_ids.empty())
+  {
+    span_cache_entry entry{key, end_height, crypto::null_hash, 0, 0, arg.blocks, rsp.blocks, {}};
+    cache_span(std::move(entry));
   }
 
   return true;
@@ -2249,8 +2730,7 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
 bool Blockchain::get_alternative_blocks(std::vector<block>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   blocks.reserve(m_db->get_alt_block_count());
   m_db->for_all_alt_blocks([&blocks](const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata_ref *blob) {
     if (!blob)
@@ -2271,7 +2751,7 @@ bool Blockchain::get_alternative_blocks(std::vector<block>& blocks) const
 size_t Blockchain::get_alternative_blocks_count() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   return m_db->get_alt_block_count();
 }
 //------------------------------------------------------------------
@@ -2305,7 +2785,7 @@ crypto::public_key Blockchain::get_output_key(uint64_t amount, uint64_t global_i
 bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMAND_RPC_GET_OUTPUTS_BIN::response& res) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   res.outs.clear();
   res.outs.reserve(req.outputs.size());
@@ -2321,7 +2801,8 @@ bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMA
       amounts.push_back(i.amount);
       offsets.push_back(i.index);
     }
-    m_db->get_output_key(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, data);
+    // one pass over the output amounts table in key order, however the outputs were picked
+    m_db->get_output_keys_batch(amounts, offsets, data);
     if (data.size() != req.outputs.size())
     {
       MERROR("Unexpected output data size: expected " << req.outputs.size() << ", got " << data.size());
@@ -2359,6 +2840,8 @@ void Blockchain::get_output_key_mask_unlocked(const uint64_t& amount, const uint
 //------------------------------------------------------------------
 bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base) const
 {
+  db_rtxn_guard rtxn_guard(m_db);
+
   // rct outputs don't exist before v4
   if (amount == 0)
   {
@@ -2389,12 +2872,8 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
     return false;
   if (amount == 0)
   {
-    std::vector<uint64_t> heights;
-    heights.reserve(to_height + 1 - start_height);
     const uint64_t real_start_height = start_height > 0 ? start_height-1 : start_height;
-    for (uint64_t h = real_start_height; h <= to_height; ++h)
-      heights.push_back(h);
-    distribution = m_db->get_block_cumulative_rct_outputs(heights);
+    distribution = m_db->get_block_cumulative_rct_outputs_range(real_start_height, to_height >= real_start_height ? to_height + 1 - real_start_height : 0);
     if (start_height > 0)
     {
       base = distribution[0];
@@ -2414,8 +2893,7 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   // make sure the request includes at least the genesis block, otherwise
   // how can we expect to sync from the client that the block list came from?
   if(qblock_ids.empty())
@@ -2424,7 +2902,6 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     return false;
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   // make sure that the last block in the request's block list matches
   // the genesis block
   auto gen_hash = m_db->get_block_hash_from_height(0);
@@ -2492,7 +2969,7 @@ template<class t_ids_container, class t_blocks_container, class t_missed_contain
 bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(blocks, block_ids.size());
   for (const auto& block_hash : block_ids)
@@ -2577,7 +3054,7 @@ static bool fill(BlockchainDB *db, const crypto::hash &tx_hash, tx_blob_entry &t
 bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::blobdata>& txs, std::vector<crypto::hash>& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   txs.reserve(txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2601,7 +3078,7 @@ bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids
 bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids, std::vector<tx_blob_entry>& txs, std::vector<crypto::hash>& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   txs.reserve(txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2637,7 +3114,7 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_split_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(txs, txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2671,7 +3148,7 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(txs, txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2707,15 +3184,13 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::vector<crypto::hash>& hashes, std::vector<uint64_t>* weights, uint64_t& start_height, uint64_t& current_height, bool clip_pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   // if we can't find the split point, return false
   if(!find_blockchain_supplement(qblock_ids, start_height))
   {
     return false;
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   current_height = get_current_blockchain_height();
   uint64_t stop_height = current_height;
   if (clip_pruned)
@@ -2746,8 +3221,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   bool result = find_blockchain_supplement(qblock_ids, resp.m_block_ids, &resp.m_block_weights, resp.start_height, resp.total_height, clip_pruned);
   if (result)
   {
@@ -2766,8 +3240,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_block_count, size_t max_tx_count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  db_rtxn_guard rtxn_guard(m_db);
   // if a specific start height has been requested
   if(req_start_block > 0)
   {
@@ -2786,12 +3259,26 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
     }
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   total_height = get_current_blockchain_height();
+
+  // wallets refreshing from the same height ask for the same span
+  const span_cache_key key{start_height, max_block_count, max_tx_count, uint8_t((pruned ? SPAN_CACHE_PRUNED : 0) | (get_miner_tx_hash ? SPAN_CACHE_MINER_TX_HASH : 0))};
+  span_cache_entry entry;
+  if (find_cached_span(key, entry))
+  {
+    blocks.insert(blocks.end(), std::make_move_iterator(entry.supplement.begin()), std::make_move_iterator(entry.supplement.end()));
+    return true;
+  }
+
+  const size_t first = blocks.size();
   blocks.reserve(std::min(std::min(max_block_count, (size_t)10000), (size_t)(total_height - start_height)));
   CHECK_AND_ASSERT_MES(m_db->get_blocks_from(start_height, 3, max_block_count, max_tx_count, FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE, blocks, pruned, true, get_miner_tx_hash),
       false, "Error getting blocks");
 
+  const uint64_t end_height = start_height + (blocks.size() - first);
+  span_cache_entry new_entry{key, end_height, crypto::null_hash, end_height >= total_height ? total_height : 0, 0, {}, {}, {blocks.begin() + first, blocks.end()}};
+  cache_span(std::move(new_entry));
+
   return true;
 }
 //------------------------------------------------------------------
@@ -2944,7 +3431,7 @@ bool Blockchain::check_for_double_spend(const transaction& tx, key_images_contai
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes, std::vector<std::vector<uint64_t>>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -2960,7 +3447,7 @@ bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -2977,7 +3464,7 @@ void Blockchain::on_new_tx_from_block(const cryptonote::transaction &tx)
 {
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size())
+  if (m_db->height() < m_blocks_hash_check_height)
   {
     TIME_MEASURE_START(a);
     m_blocks_txs_check.push_back(get_transaction_hash(tx));
@@ -3006,7 +3493,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
 
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size() && kept_by_block)
+  if (m_db->height() < m_blocks_hash_check_height && kept_by_block)
   {
     max_used_block_id = null_hash;
     max_used_block_height = 0;
@@ -3025,9 +3512,17 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
   if (!res)
     return false;
 
-  CHECK_AND_ASSERT_MES(max_used_block_height < m_db->height(), false,  "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db->height());
-  max_used_block_id = m_db->get_block_hash_from_height(max_used_block_height);
-  return true;
+  CHECK_AND_ASSERT_MES(max_used_block_height < m_db->height(), false,  "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db->height());
+  max_used_block_id = m_db->get_block_hash_from_height(max_used_block_height);
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::check_tx_inputs_deferred(transaction& tx, tx_verification_context &tvc, std::vector<const rct::rctSig*> &ring_sigs) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  return check_tx_inputs(tx, tvc, NULL, &ring_sigs);
 }
 //------------------------------------------------------------------
 bool Blockchain::check_tx_outputs(const transaction& tx, tx_verification_context &tvc) const
@@ -3212,7 +3707,7 @@ bool Blockchain::have_tx_keyimges_as_spent(const transaction &tx) const
 }
 bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_prefix_hash, const std::vector<std::vector<rct::ctkey>> &pubkeys) const
 {
-  PERF_TIMER(expand_transaction_2);
+  PERF_TIMER_AGG(expand_transaction_2);
   CHECK_AND_ASSERT_MES(tx.version == 2, false, "Transaction version is not 2");
 
   rct::rctSig &rv = tx.rct_signatures;
@@ -3303,9 +3798,9 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height) const
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, std::vector<const rct::rctSig*> *deferred_ring_sigs) const
 {
-  PERF_TIMER(check_tx_inputs);
+  PERF_TIMER_AGG(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
   size_t sig_index = 0;
   if(pmax_used_block_height)
@@ -3459,6 +3954,28 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
   uint64_t max_used_block_height = 0;
   if (!pmax_used_block_height)
     pmax_used_block_height = &max_used_block_height;
+
+  // look up all key images, then all ring members, in a single pass each
+  std::vector<crypto::key_image> key_images;
+  key_images.reserve(tx.vin.size());
+  for (const auto& txin : tx.vin)
+    if (txin.type() == typeid(txin_to_key))
+      key_images.push_back(boost::get<txin_to_key>(txin).k_image);
+  std::vector<bool> spent;
+  m_db->have_key_images_batch(epee::to_span(key_images), spent);
+  for (size_t n = 0; n < spent.size(); ++n)
+  {
+    if (spent[n])
+    {
+      MERROR_VER("Key image already spent in blockchain: " << epee::string_tools::pod_to_hex(key_images[n]));
+      tvc.m_double_spend = true;
+      return false;
+    }
+  }
+
+  std::vector<std::vector<output_data_t>> ring_members;
+  const bool ring_members_prefetched = prefetch_tx_ring_members(tx, tx_prefix_hash, ring_members);
+
   for (const auto& txin : tx.vin)
   {
     // make sure output being spent is of type txin_to_key, rather than
@@ -3469,13 +3986,6 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     // make sure tx output has key offset(s) (is signed to be used)
     CHECK_AND_ASSERT_MES(in_to_key.key_offsets.size(), false, "empty in_to_key.key_offsets in transaction with id " << get_transaction_hash(tx));
 
-    if(have_tx_keyimg_as_spent(in_to_key.k_image))
-    {
-      MERROR_VER("Key image already spent in blockchain: " << epee::string_tools::pod_to_hex(in_to_key.k_image));
-      tvc.m_double_spend = true;
-      return false;
-    }
-
     if (tx.version == 1)
     {
       // basically, make sure number of inputs == number of signatures
@@ -3484,7 +3994,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 
     // make sure that output being spent matches up correctly with the
     // signature spending it.
-    if (!check_tx_input(tx.version, in_to_key, tx_prefix_hash, tx.version == 1 ? tx.signatures[sig_index] : std::vector<crypto::signature>(), tx.rct_signatures, pubkeys[sig_index], pmax_used_block_height, hf_version))
+    if (!check_tx_input(tx.version, in_to_key, tx_prefix_hash, tx.version == 1 ? tx.signatures[sig_index] : std::vector<crypto::signature>(), tx.rct_signatures, pubkeys[sig_index], pmax_used_block_height, hf_version, ring_members_prefetched ? &ring_members[sig_index] : NULL))
     {
       MERROR_VER("Failed to check ring signature for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << in_to_key.k_image << "  sig_index: " << sig_index);
       if (pmax_used_block_height) // a default value of NULL is used when called from Blockchain::handle_block_to_main_chain()
@@ -3631,7 +4141,9 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimpleCached(rv))
+      if (deferred_ring_sigs)
+        deferred_ring_sigs->push_back(&rv);
+      else if (!rct::verRctNonSemanticsSimpleCached(rv))
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -3873,6 +4385,16 @@ void Blockchain::get_dynamic_base_fee_estimate_2021_scaling(uint64_t grace_block
 
 void Blockchain::get_dynamic_base_fee_estimate_2021_scaling(uint64_t grace_blocks, std::vector<uint64_t> &fees) const
 {
+  // copying the long term rolling median is expensive, and the estimate only
+  // changes with the top block
+  const crypto::hash top_hash = get_tail_id();
+  CRITICAL_REGION_LOCAL(m_fee_estimate_lock);
+  if (top_hash == m_fee_estimate_top_hash && grace_blocks == m_fee_estimate_grace_blocks && !m_fee_estimate.empty())
+  {
+    fees = m_fee_estimate;
+    return;
+  }
+
   const uint8_t version = get_current_hard_fork_version();
   const uint64_t db_height = m_db->height();
 
@@ -3908,6 +4430,60 @@ void Blockchain::get_dynamic_base_fee_estimate_2021_scaling(uint64_t grace_block
   }
 
   get_dynamic_base_fee_estimate_2021_scaling(grace_blocks, base_reward, Mnw, Mlw_penalty_free_zone_for_wallet, fees);
+
+  m_fee_estimate_top_hash = top_hash;
+  m_fee_estimate_grace_blocks = grace_blocks;
+  m_fee_estimate = fees;
+}
+
+//------------------------------------------------------------------
+void Blockchain::get_recent_fee_rate_quantiles(uint64_t nblocks, const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_recent_fee_rates_lock);
+  db_rtxn_guard rtxn_guard(m_db);
+  const uint64_t db_height = m_db->height();
+  nblocks = std::min(nblocks, db_height);
+
+  std::unordered_map<crypto::hash, std::vector<std::pair<uint64_t, uint64_t>>> recent_fee_rates;
+  std::map<uint64_t, txpool_histo> by_fee_rate;
+  for (uint64_t height = db_height - nblocks; height < db_height; ++height)
+  {
+    const crypto::hash block_id = m_db->get_block_hash_from_height(height);
+    std::vector<std::pair<uint64_t, uint64_t>> &fee_rates = recent_fee_rates[block_id];
+    const auto cached = m_recent_fee_rates.find(block_id);
+    if (cached != m_recent_fee_rates.end())
+    {
+      fee_rates = cached->second;
+    }
+    else
+    {
+      const block b = m_db->get_block_from_height(height);
+      fee_rates.reserve(b.tx_hashes.size());
+      for (const crypto::hash &txid: b.tx_hashes)
+      {
+        cryptonote::blobdata blob;
+        transaction tx;
+        uint64_t fee;
+        if (!m_db->get_pruned_tx_blob(txid, blob) || !parse_and_validate_tx_base_from_blob(blob, tx) || !get_tx_fee(tx, fee))
+        {
+          MERROR("Failed to get fee of tx " << txid << " in block " << block_id);
+          continue;
+        }
+        const uint64_t weight = get_pruned_transaction_weight(tx);
+        fee_rates.emplace_back(fee / std::max<uint64_t>(weight, 1), weight);
+      }
+    }
+    for (const auto &e: fee_rates)
+    {
+      txpool_histo &bucket = by_fee_rate[e.first];
+      bucket.txs++;
+      bucket.bytes += e.second;
+    }
+  }
+  m_recent_fee_rates = std::move(recent_fee_rates);
+
+  get_fee_rate_quantiles(by_fee_rate, percentiles, quantiles);
 }
 
 //------------------------------------------------------------------
@@ -3983,10 +4559,54 @@ bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time, uint8_t hf_versi
   return false;
 }
 //------------------------------------------------------------------
+bool Blockchain::prefetch_tx_ring_members(const transaction &tx, const crypto::hash &tx_prefix_hash, std::vector<std::vector<output_data_t>> &outputs) const
+{
+  outputs.clear();
+  if (m_scan_table.find(tx_prefix_hash) != m_scan_table.end())
+    return false;
+
+  std::vector<uint64_t> amounts, offsets;
+  std::vector<size_t> ring_sizes;
+  ring_sizes.reserve(tx.vin.size());
+  for (const auto &txin: tx.vin)
+  {
+    if (txin.type() != typeid(txin_to_key))
+      return false;
+    const txin_to_key &in_to_key = boost::get<txin_to_key>(txin);
+    const std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+    amounts.insert(amounts.end(), absolute_offsets.size(), in_to_key.amount);
+    offsets.insert(offsets.end(), absolute_offsets.begin(), absolute_offsets.end());
+    ring_sizes.push_back(absolute_offsets.size());
+  }
+
+  std::vector<output_data_t> all_outputs;
+  try
+  {
+    m_db->get_output_keys_batch(amounts, offsets, all_outputs);
+  }
+  catch (const std::exception &e)
+  {
+    // let the per input path find and report the missing output
+    MDEBUG("Failed to prefetch ring members: " << e.what());
+    return false;
+  }
+  if (all_outputs.size() != offsets.size())
+    return false;
+
+  outputs.resize(ring_sizes.size());
+  size_t offset = 0;
+  for (size_t i = 0; i < ring_sizes.size(); ++i)
+  {
+    outputs[i].assign(all_outputs.begin() + offset, all_outputs.begin() + offset + ring_sizes[i]);
+    offset += ring_sizes[i];
+  }
+  return true;
+}
+//------------------------------------------------------------------
 // This function locates all outputs associated with a given input (mixins)
 // and validates that they exist and are usable.  It also checks the ring
 // signature for each input.
-bool Blockchain::check_tx_input(size_t tx_version, const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, const rct::rctSig &rct_signatures, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height, uint8_t hf_version) const
+bool Blockchain::check_tx_input(size_t tx_version, const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, const rct::rctSig &rct_signatures, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height, uint8_t hf_version, const std::vector<output_data_t> *prefetched_outputs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
@@ -4028,7 +4648,7 @@ bool Blockchain::check_tx_input(size_t tx_version, const txin_to_key& txin, cons
 
   // collect output keys
   outputs_visitor vi(output_keys, *this, hf_version);
-  if (!scan_outputkeys_for_indexes(tx_version, txin, vi, tx_prefix_hash, pmax_related_block_height))
+  if (!scan_outputkeys_for_indexes(tx_version, txin, vi, tx_prefix_hash, pmax_related_block_height, prefetched_outputs))
   {
     MERROR_VER("Failed to get output keys for tx with amount = " << print_money(txin.amount) << " and count indexes " << txin.key_offsets.size());
     return false;
@@ -4265,6 +4885,7 @@ leave:
 #if defined(PER_BLOCK_CHECKPOINT)
   if (blockchain_height < m_blocks_hash_check.size())
   {
+    // entries past the vector's end, or null, were not verified yet
     const auto &expected_hash = m_blocks_hash_check[blockchain_height].first;
     if (expected_hash != crypto::null_hash)
     {
@@ -4291,7 +4912,11 @@ leave:
       proof_of_work = it->second;
     }
     else
-      proof_of_work = get_block_longhash(this, bl, blockchain_height, 0);
+    {
+      crypto::hash seed;
+      if (!take_queued_pow(id, proof_of_work, seed) || seed != get_pending_block_id_by_height(rx_seedheight(blockchain_height)))
+        proof_of_work = get_block_longhash(this, bl, blockchain_height, 0);
+    }
 
     // validate proof_of_work versus difficulty target
     if(!check_hash(proof_of_work, current_diffic))
@@ -4345,10 +4970,15 @@ leave:
 
 // XXX old code adds miner tx here
 
+  // ring signatures are verified for the whole block at once, after the loop
+  std::vector<const rct::rctSig*> deferred_ring_sigs;
+  std::vector<crypto::hash> deferred_ring_sig_txids;
+
   size_t tx_index = 0;
   // Iterate over the block's transaction hashes, grabbing each
   // from the tx_pool and validating them.  Each is then added
   // to txs.  Keys spent in each are added to <keys> by the double spend check.
+  // txs must not reallocate, deferred_ring_sigs points into it
   txs.reserve(bl.tx_hashes.size());
   for (const crypto::hash& tx_id : bl.tx_hashes)
   {
@@ -4415,7 +5045,8 @@ leave:
     {
       // validate that transaction inputs and the keys spending them are correct.
       tx_verification_context tvc;
-      if(!check_tx_inputs(tx, tvc))
+      const size_t n_deferred = deferred_ring_sigs.size();
+      if(!check_tx_inputs(tx, tvc, NULL, &deferred_ring_sigs))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -4428,6 +5059,8 @@ leave:
         return_tx_to_pool(txs);
         goto leave;
       }
+      if (deferred_ring_sigs.size() != n_deferred)
+        deferred_ring_sig_txids.push_back(tx_id);
     }
 #if defined(PER_BLOCK_CHECKPOINT)
     else
@@ -4452,6 +5085,25 @@ leave:
     cumulative_block_weight += tx_weight;
   }
 
+  if (!deferred_ring_sigs.empty())
+  {
+    TIME_MEASURE_START(ee);
+    if (!rct::verRctNonSemanticsSimpleCached(deferred_ring_sigs))
+    {
+      // find the culprit(s) for the log, the block is invalid either way
+      for (size_t n = 0; n < deferred_ring_sigs.size(); ++n)
+        if (!rct::verRctNonSemanticsSimple(*deferred_ring_sigs[n]))
+          MERROR_VER("Block with id: " << id << " has at least one transaction (id: " << deferred_ring_sig_txids[n] << ") with wrong ring signatures.");
+      add_block_as_invalid(bl, id);
+      MERROR_VER("Block with id " << id << " added as invalid because of wrong ring signatures in transactions");
+      bvc.m_verifivation_failed = true;
+      return_tx_to_pool(txs);
+      goto leave;
+    }
+    TIME_MEASURE_FINISH(ee);
+    t_checktx += ee;
+  }
+
   // if we were syncing pruned blocks
   if (n_pruned > 0)
   {
@@ -4530,6 +5182,9 @@ leave:
   }
 
   TIME_MEASURE_FINISH(addblock);
+  ++m_import_stage_times.blocks;
+  m_import_stage_times.verify += block_processing_time;
+  m_import_stage_times.add += addblock;
 
   // do this after updating the hard fork state since the weight limit may change due to fork
   if (!update_next_cumulative_weight_limit())
@@ -4547,8 +5202,16 @@ leave:
         << target_calculating_time << "/" << longhash_calculating_time << "/"
         << t1 << "/" << t2 << "/" << t3 << "/" << t_exists << "/" << t_pool
         << "/" << t_checktx << "/" << t_dblspnd << "/" << vmt << "/" << addblock << ")ms");
+    uint64_t tx_hashes_calculated, tx_hashes_cached, block_hashes_calculated, block_hashes_cached;
+    get_hash_stats(tx_hashes_calculated, tx_hashes_cached, block_hashes_calculated, block_hashes_cached);
+    MINFO("Hashes calculated/cached: tx " << tx_hashes_calculated << "/" << tx_hashes_cached
+        << ", block " << block_hashes_calculated << "/" << block_hashes_cached);
   }
 
+  blocks_added_metric.inc();
+  block_processing_metric.observe(block_processing_time);
+  block_db_add_metric.observe(addblock);
+
   bvc.m_added_to_main_chain = true;
   ++m_sync_counter;
 
@@ -4577,8 +5240,17 @@ leave:
     notifier(new_height - 1, {std::addressof(bl), 1});
 
   if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
+  {
     rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
 
+    // the next epoch's seed block is known SEEDHASH_EPOCH_LAG blocks before the
+    // switch, so its cache can be ready by then
+    uint64_t seed_height, next_height;
+    crypto::rx_seedheights(new_height, &seed_height, &next_height);
+    if (next_height != seed_height)
+      rx_set_next_seedhash(get_block_id_by_height(next_height).data);
+  }
+
   return true;
 }
 //------------------------------------------------------------------
@@ -4588,6 +5260,7 @@ bool Blockchain::prune_blockchain(uint32_t pruning_seed)
   epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
+  invalidate_span_cache(0);
   return m_db->prune_blockchain(pruning_seed);
 }
 //------------------------------------------------------------------
@@ -4597,6 +5270,7 @@ bool Blockchain::update_blockchain_pruning()
   epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
+  invalidate_span_cache(0);
   return m_db->update_pruning();
 }
 //------------------------------------------------------------------
@@ -4864,14 +5538,35 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
     if (m_cancel)
        break;
     crypto::hash id = get_block_hash(block);
+    if (m_blocks_longhash_table.find(id) != m_blocks_longhash_table.end())
+    {
+      // already computed by the pipeline while the previous span was added
+      ++height;
+      continue;
+    }
     crypto::hash pow = get_block_longhash(this, block, height++, 0);
     map.emplace(id, pow);
   }
 
-  slow_hash_free_state();
+  // the pool thread keeps its CryptoNight scratchpad for the next
+  // historical span, the first RandomX span releases it with the VM
+  if (blocks.empty() || blocks[blocks.size() - 1].major_version >= RX_BLOCK_VERSION)
+    slow_hash_free_state();
   TIME_MEASURE_FINISH(t);
 }
 
+//------------------------------------------------------------------
+unsigned Blockchain::get_prepare_blocks_threads(uint64_t last_height) const
+{
+  unsigned threads = tools::threadpool::getInstanceForCompute().get_max_concurrency();
+  uint64_t max_threads = m_max_prepare_blocks_threads;
+  if (m_hardfork->get_ideal_version(last_height) < RX_BLOCK_VERSION)
+    max_threads = m_max_prepare_historical_blocks_threads;
+  if (max_threads && threads > max_threads)
+    threads = max_threads;
+  return threads ? threads : 1;
+}
+
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
@@ -4886,11 +5581,6 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
     if (m_batch_success)
     {
       m_db->batch_stop();
-      if (m_reset_timestamps_and_difficulties_height)
-      {
-        m_timestamps_and_difficulties_height = 0;
-        m_reset_timestamps_and_difficulties_height = false;
-      }
     }
     else
       m_db->batch_abort();
@@ -4930,16 +5620,26 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   }
 
   TIME_MEASURE_FINISH(t1);
+  m_import_stage_times.commit += t1;
+  if (m_show_time_stats && m_import_stage_times.blocks > 0)
+  {
+    MINFO("Block import stages for " << m_import_stage_times.blocks << " blocks (" << m_import_stage_times.prefetched << " PoW prefetched): prefetch "
+        << m_import_stage_times.prefetch << " ms, pow " << m_import_stage_times.pow << " ms, scan " << m_import_stage_times.scan
+        << " ms, verify " << m_import_stage_times.verify << " ms, add " << m_import_stage_times.add << " ms, commit " << m_import_stage_times.commit << " ms");
+  }
+  m_import_stage_totals += m_import_stage_times;
+  m_import_stage_times = import_stage_times_t();
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
   m_blocks_txs_check.clear();
 
   // when we're well clear of the precomputed hashes, free the memory
-  if (!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
+  if (m_blocks_hash_check_height > 0 && m_db->height() > m_blocks_hash_check_height + 4096)
   {
-    MINFO("Dumping block hashes, we're now 4k past " << m_blocks_hash_check.size());
+    MINFO("Dumping block hashes, we're now 4k past " << m_blocks_hash_check_height);
     m_blocks_hash_check.clear();
     m_blocks_hash_check.shrink_to_fit();
+    m_blocks_hash_check_height = 0;
   }
 
   CRITICAL_REGION_END();
@@ -4977,11 +5677,12 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // easy case: height >= hashes
-  if (height >= m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP)
+  const size_t n_hash_of_hashes = get_compiled_hash_of_hashes_count();
+  if (height >= n_hash_of_hashes * HASH_OF_HASHES_STEP)
     return hashes.size();
 
   // if we're getting old blocks, we might have jettisoned the hashes already
-  if (m_blocks_hash_check.empty())
+  if (m_blocks_hash_check_height == 0)
     return hashes.size();
 
   // find hashes encompassing those block
@@ -5037,7 +5738,7 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
   uint64_t usable = first_index * HASH_OF_HASHES_STEP - height; // may start negative, but unsigned under/overflow is not UB
   for (size_t n = first_index; n <= last_index; ++n)
   {
-    if (n < m_blocks_hash_of_hashes.size())
+    if (n < n_hash_of_hashes)
     {
       // if the last index isn't fully filled, we can't tell if valid
       if (data_hashes.size() < (n - first_index) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP)
@@ -5045,11 +5746,11 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
 
       crypto::hash hash;
       cn_fast_hash(data_hashes.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
-      bool valid = hash == m_blocks_hash_of_hashes[n].first;
+      bool valid = hash == get_compiled_hash_of_hashes(n, false);
       if (valid && !weights.empty())
       {
         cn_fast_hash(data_weights.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(uint64_t), hash);
-        valid &= hash == m_blocks_hash_of_hashes[n].second;
+        valid &= hash == get_compiled_hash_of_hashes(n, true);
       }
 
       // add to the known hashes array
@@ -5060,6 +5761,8 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
       }
 
       size_t end = n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP;
+      if (m_blocks_hash_check.size() < end)
+        m_blocks_hash_check.resize(end, std::make_pair(crypto::null_hash, 0));
       for (size_t i = n * HASH_OF_HASHES_STEP; i < end; ++i)
       {
         CHECK_AND_ASSERT_MES(m_blocks_hash_check[i].first == crypto::null_hash || m_blocks_hash_check[i].first == data_hashes[i - first_index * HASH_OF_HASHES_STEP],
@@ -5155,19 +5858,17 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_batch_success = true;
 
   const uint64_t height = m_db->height();
-  if ((height + blocks_entry.size()) < m_blocks_hash_check.size())
+  if ((height + blocks_entry.size()) < m_blocks_hash_check_height)
     return true;
 
   bool blocks_exist = false;
   tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
-  unsigned threads = tpool.get_max_concurrency();
+  // limit threads, default limit = 4, or all threads before RandomX
+  unsigned threads = get_prepare_blocks_threads(height + blocks_entry.size() - 1);
   blocks.resize(blocks_entry.size());
 
   if (1)
   {
-    // limit threads, default limit = 4
-    if(threads > m_max_prepare_blocks_threads)
-      threads = m_max_prepare_blocks_threads;
 
     unsigned int batches = blocks_entry.size() / threads;
     unsigned int extra = blocks_entry.size() % threads;
@@ -5221,6 +5922,12 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
     if (!blocks_exist)
     {
       m_blocks_longhash_table.clear();
+      m_prepared_ids_height = height;
+      m_prepared_ids.clear();
+      m_prepared_ids.reserve(blocks.size());
+      for (const block &b: blocks)
+        m_prepared_ids.push_back(get_block_hash(b));
+      m_import_stage_times.prefetched += take_prefetched_pow(height, blocks);
       uint64_t thread_height = height;
       tools::threadpool::waiter waiter(tpool);
       m_prepare_height = height;
@@ -5267,6 +5974,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 
   TIME_MEASURE_FINISH(prepare);
   m_fake_pow_calc_time = prepare / blocks_entry.size();
+  m_import_stage_times.pow += prepare;
 
   if (blocks_entry.size() > 1 && threads > 1 && m_show_time_stats)
     MDEBUG("Prepare blocks took: " << prepare << " ms");
@@ -5444,6 +6152,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   }
 
   TIME_MEASURE_FINISH(scantable);
+  m_import_stage_times.scan += scantable;
   if (total_txs > 0)
   {
     m_fake_scan_time = scantable / total_txs;
@@ -5454,51 +6163,321 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   return true;
 }
 
+//------------------------------------------------------------------
+void Blockchain::pow_prefetch_worker(pow_prefetch_t &prefetch, size_t start, size_t nblocks) const
+{
+  TIME_MEASURE_START(t);
+  slow_hash_allocate_state();
+
+  for (size_t i = start; i < start + nblocks; ++i)
+  {
+    if (m_cancel)
+      break;
+    const block &b = prefetch.blocks[i];
+    if (b.major_version >= RX_BLOCK_VERSION && prefetch.seeds[i] == crypto::null_hash)
+      continue;
+    get_block_longhash(this, b, prefetch.pow[i], prefetch.height + i, &prefetch.seeds[i], 0);
+  }
+
+  // see block_longhash_worker
+  if (nblocks == 0 || prefetch.blocks[start + nblocks - 1].major_version >= RX_BLOCK_VERSION)
+    slow_hash_free_state();
+  TIME_MEASURE_FINISH(t);
+  prefetch.elapsed += t;
+}
+//------------------------------------------------------------------
+bool Blockchain::prefetch_incoming_blocks_pow(uint64_t height, const std::vector<block_complete_entry> &blocks_entry)
+{
+  MTRACE("Blockchain::" << __func__);
+
+  if (blocks_entry.empty() || m_cancel)
+    return false;
+
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  boost::lock_guard<boost::mutex> lock(m_pow_prefetch_lock);
+  if (m_pow_prefetch)
+  {
+    MDEBUG("PoW prefetch already in flight for height " << m_pow_prefetch->height << ", not queuing " << height);
+    return false;
+  }
+
+  // hashes below the precomputed hashes of hashes are not checked anyway
+  if (height + blocks_entry.size() < m_blocks_hash_check_height)
+    return false;
+
+  std::unique_ptr<pow_prefetch_t> prefetch(new pow_prefetch_t());
+  prefetch->height = height;
+  prefetch->elapsed = 0;
+  prefetch->blocks.resize(blocks_entry.size());
+  prefetch->ids.resize(blocks_entry.size());
+  prefetch->seeds.resize(blocks_entry.size(), crypto::null_hash);
+  prefetch->pow.resize(blocks_entry.size(), crypto::null_hash);
+
+  const uint64_t db_height = m_db->height();
+  const uint64_t prepared_ids_height = m_prepared_ids_height;
+  for (size_t i = 0; i < blocks_entry.size(); ++i)
+  {
+    if (!parse_and_validate_block_from_blob(blocks_entry[i].block, prefetch->blocks[i], prefetch->ids[i]))
+      return false;
+    if (i > 0 && prefetch->blocks[i].prev_id != prefetch->ids[i - 1])
+      return false;
+    if (prefetch->blocks[i].major_version < RX_BLOCK_VERSION)
+      continue;
+
+    // the seed block may be in the db, in the span being added, or earlier in this span
+    const uint64_t seed_height = rx_seedheight(height + i);
+    if (seed_height >= height)
+      prefetch->seeds[i] = prefetch->ids[seed_height - height];
+    else if (seed_height >= prepared_ids_height && seed_height - prepared_ids_height < m_prepared_ids.size())
+      prefetch->seeds[i] = m_prepared_ids[seed_height - prepared_ids_height];
+    else if (seed_height < db_height)
+      prefetch->seeds[i] = m_db->get_block_hash_from_height(seed_height);
+  }
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const unsigned threads = get_prepare_blocks_threads(height + blocks_entry.size() - 1);
+
+  m_pow_prefetch = std::move(prefetch);
+  m_pow_prefetch_waiter.reset(new tools::threadpool::waiter(tpool));
+  const size_t nblocks = m_pow_prefetch->blocks.size();
+  const size_t batch = (nblocks + threads - 1) / threads;
+  for (size_t start = 0; start < nblocks; start += batch)
+    tpool.submit(m_pow_prefetch_waiter.get(), boost::bind(&Blockchain::pow_prefetch_worker, this, std::ref(*m_pow_prefetch), start, std::min(batch, nblocks - start)), true);
+
+  MDEBUG("Queued PoW prefetch for blocks " << height << " - " << (height + nblocks - 1));
+  return true;
+}
+//------------------------------------------------------------------
+size_t Blockchain::take_prefetched_pow(uint64_t height, const std::vector<block> &blocks)
+{
+  std::unique_ptr<pow_prefetch_t> prefetch;
+  {
+    boost::lock_guard<boost::mutex> lock(m_pow_prefetch_lock);
+    if (!m_pow_prefetch)
+      return 0;
+    if (m_pow_prefetch_waiter)
+      m_pow_prefetch_waiter->wait();
+    m_pow_prefetch_waiter.reset();
+    prefetch = std::move(m_pow_prefetch);
+  }
+
+  m_import_stage_times.prefetch += prefetch->elapsed;
+  if (prefetch->height != height)
+  {
+    MDEBUG("Prefetched PoW was for height " << prefetch->height << ", not " << height << ", discarding");
+    return 0;
+  }
+
+  // the seed hashes were guessed from blocks which were not yet added when the
+  // span was queued, so only reuse a hash if its seed is now on the chain
+  size_t reused = 0;
+  for (size_t i = 0; i < blocks.size() && i < prefetch->blocks.size(); ++i)
+  {
+    if (prefetch->pow[i] == crypto::null_hash || get_block_hash(blocks[i]) != prefetch->ids[i])
+      continue;
+    if (blocks[i].major_version >= RX_BLOCK_VERSION)
+    {
+      const uint64_t seed_height = rx_seedheight(height + i);
+      const crypto::hash seed = seed_height >= height ? get_block_hash(blocks[seed_height - height]) : get_block_id_by_height(seed_height);
+      if (seed != prefetch->seeds[i])
+        continue;
+    }
+    m_blocks_longhash_table.emplace(prefetch->ids[i], prefetch->pow[i]);
+    ++reused;
+  }
+  MDEBUG("Reused " << reused << "/" << blocks.size() << " prefetched PoW hashes");
+  return reused;
+}
+//------------------------------------------------------------------
+bool Blockchain::queue_block_pow(const block &b)
+{
+  MTRACE("Blockchain::" << __func__);
+
+  if (b.major_version < RX_BLOCK_VERSION || m_cancel)
+    return false;
+
+  const crypto::hash id = get_block_hash(b);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  std::shared_ptr<queued_pow_t> queued = std::make_shared<queued_pow_t>(tpool);
+  queued->pow = crypto::null_hash;
+
+  // no blockchain lock: if the chain changes before the block is added, the
+  // seed hash will not match the one it is checked against, and the PoW is
+  // just computed again
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    uint64_t prev_height;
+    if (!m_db->block_exists(b.prev_id, &prev_height) || m_db->block_exists(id))
+      return false;
+    queued->height = prev_height + 1;
+    // hashes below the precomputed hashes of hashes are not checked anyway
+    if (queued->height < m_blocks_hash_check_height)
+      return false;
+    queued->seed = m_db->get_block_hash_from_height(rx_seedheight(queued->height));
+  }
+
+  {
+    boost::lock_guard<boost::mutex> lock(m_queued_pow_lock);
+    if (m_queued_pow.size() >= QUEUED_POW_MAX_BLOCKS || m_queued_pow.find(id) != m_queued_pow.end())
+      return false;
+    m_queued_pow.emplace(id, queued);
+  }
+
+  // the RandomX VMs are kept by the threadpool threads from one block to the next
+  tpool.submit(&queued->waiter, [this, b, queued]() {
+    get_block_longhash(this, b, queued->pow, queued->height, &queued->seed, 0);
+  }, true);
+
+  MDEBUG("Queued PoW for block " << id << " at height " << queued->height);
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::take_queued_pow(const crypto::hash &id, crypto::hash &pow, crypto::hash &seed)
+{
+  std::shared_ptr<queued_pow_t> queued;
+  {
+    boost::lock_guard<boost::mutex> lock(m_queued_pow_lock);
+    if (m_queued_pow.empty())
+      return false;
+    auto it = m_queued_pow.find(id);
+    if (it != m_queued_pow.end())
+    {
+      queued = std::move(it->second);
+      m_queued_pow.erase(it);
+    }
+    // drop blocks which were never added, they would fill the queue otherwise
+    const uint64_t height = m_db->height();
+    for (it = m_queued_pow.begin(); it != m_queued_pow.end(); )
+    {
+      if (it->second->height + QUEUED_POW_MAX_BLOCKS < height)
+        it = m_queued_pow.erase(it);
+      else
+        ++it;
+    }
+  }
+  if (!queued)
+    return false;
+
+  queued->waiter.wait();
+  if (queued->pow == crypto::null_hash)
+    return false;
+  pow = queued->pow;
+  seed = queued->seed;
+  return true;
+}
+//------------------------------------------------------------------
 void Blockchain::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
 {
+  if (m_txpool_store)
+  {
+    m_txpool_store->add_tx(txid, blob, meta);
+    return;
+  }
   m_db->add_txpool_tx(txid, blob, meta);
 }
 
 void Blockchain::update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
 {
+  if (m_txpool_store)
+  {
+    m_txpool_store->update_tx(txid, meta);
+    return;
+  }
   m_db->update_txpool_tx(txid, meta);
 }
 
 void Blockchain::remove_txpool_tx(const crypto::hash &txid)
 {
+  if (m_txpool_store)
+  {
+    m_txpool_store->remove_tx(txid);
+    return;
+  }
   m_db->remove_txpool_tx(txid);
 }
 
 uint64_t Blockchain::get_txpool_tx_count(bool include_sensitive) const
 {
+  if (m_txpool_store)
+    return m_txpool_store->get_tx_count(include_sensitive ? relay_category::all : relay_category::broadcasted);
   return m_db->get_txpool_tx_count(include_sensitive ? relay_category::all : relay_category::broadcasted);
 }
 
 bool Blockchain::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const
 {
+  if (m_txpool_store)
+    return m_txpool_store->get_tx_meta(txid, meta);
   return m_db->get_txpool_tx_meta(txid, meta);
 }
 
 bool Blockchain::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, relay_category tx_category) const
 {
+  if (m_txpool_store)
+    return m_txpool_store->get_tx_blob(txid, bd, tx_category);
   return m_db->get_txpool_tx_blob(txid, bd, tx_category);
 }
 
 cryptonote::blobdata Blockchain::get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const
 {
+  if (m_txpool_store)
+  {
+    cryptonote::blobdata bd;
+    if (!m_txpool_store->get_tx_blob(txid, bd, tx_category))
+      throw DB_ERROR("Tx not found in txpool: ");
+    return bd;
+  }
   return m_db->get_txpool_tx_blob(txid, tx_category);
 }
 
 bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category tx_category) const
 {
+  if (m_txpool_store)
+    return m_txpool_store->for_all_txes(f, include_blob, tx_category);
   return m_db->for_all_txpool_txes(f, include_blob, tx_category);
 }
 
 bool Blockchain::txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category)
 {
+  if (m_txpool_store)
+  {
+    txpool_tx_meta_t meta{};
+    return m_txpool_store->get_tx_meta(tx_hash, meta) && meta.matches(category);
+  }
   return m_db->txpool_tx_matches_category(tx_hash, category);
 }
 
+void Blockchain::use_txpool_memory_store()
+{
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  m_txpool_store.reset(new txpool_memory_store());
+  const size_t n_txes = m_txpool_store->load(*m_db);
+  MINFO("Keeping the txpool in memory, " << n_txes << " txes loaded");
+}
+
+size_t Blockchain::flush_txpool_store()
+{
+  if (!m_txpool_store)
+    return 0;
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (m_txpool_store->pending_changes() == 0)
+    return 0;
+  const bool stop_batch = m_db->batch_start();
+  try
+  {
+    const size_t written = m_txpool_store->write_snapshot(*m_db);
+    if (stop_batch)
+      m_db->batch_stop();
+    return written;
+  }
+  catch (...)
+  {
+    if (stop_batch)
+      m_db->batch_abort();
+    throw;
+  }
+}
+
 void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold, blockchain_db_sync_mode sync_mode, bool fast_sync)
 {
   if (sync_mode == db_defaultsync)
@@ -5591,19 +6570,16 @@ std::vector<std::pair<Blockchain::block_extended_info,std::vector<crypto::hash>>
     return true;
   }, true);
 
+  // tips are the blocks no other alt block builds on
+  std::unordered_set<crypto::hash> parents;
+  parents.reserve(alt_blocks.size());
+  for (const auto &i: alt_blocks)
+    parents.insert(i.second.bl.prev_id);
+
   for (const auto &i: alt_blocks)
   {
-    const crypto::hash top = cryptonote::get_block_hash(i.second.bl);
-    bool found = false;
-    for (const auto &j: alt_blocks)
-    {
-      if (j.second.bl.prev_id == top)
-      {
-        found = true;
-        break;
-      }
-    }
-    if (!found)
+    const crypto::hash &top = i.first;
+    if (parents.find(top) == parents.end())
     {
       std::vector<crypto::hash> chain;
       auto h = i.second.bl.prev_id;
@@ -5634,9 +6610,27 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
     return;
   }
   const epee::span<const unsigned char> &checkpoints = get_checkpoints(m_nettype);
-  if (!checkpoints.empty())
+  if (checkpoints.size() > 4)
   {
     MINFO("Loading precomputed blocks (" << checkpoints.size() << " bytes)");
+    const unsigned char *p = checkpoints.data();
+    const uint32_t nblocks = *p | ((*(p+1))<<8) | ((*(p+2))<<16) | ((*(p+3))<<24);
+    if (nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(hash))
+    {
+      MERROR("Block hash data is too large");
+      return;
+    }
+    const size_t size_needed = 4 + nblocks * (sizeof(crypto::hash) * 2);
+    if(checkpoints.size() != size_needed)
+    {
+      MERROR("Failed to load hashes - unexpected data size");
+      return;
+    }
+
+    // nothing to do once we are past them, so don't even check them then
+    if (nblocks == 0 || nblocks <= (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP)
+      return;
+
     if (m_nettype == MAINNET)
     {
       // first check hash
@@ -5661,58 +6655,31 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
       }
     }
 
-    if (checkpoints.size() > 4)
-    {
-      const unsigned char *p = checkpoints.data();
-      const uint32_t nblocks = *p | ((*(p+1))<<8) | ((*(p+2))<<16) | ((*(p+3))<<24);
-      if (nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(hash))
-      {
-        MERROR("Block hash data is too large");
-        return;
-      }
-      const size_t size_needed = 4 + nblocks * (sizeof(crypto::hash) * 2);
-      if(checkpoints.size() != size_needed)
-      {
-        MERROR("Failed to load hashes - unexpected data size");
-        return;
-      }
-      else if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP)
-      {
-        p += sizeof(uint32_t);
-        m_blocks_hash_of_hashes.reserve(nblocks);
-        for (uint32_t i = 0; i < nblocks; i++)
-        {
-          crypto::hash hash_hashes, hash_weights;
-          memcpy(hash_hashes.data, p, sizeof(hash_hashes.data));
-          p += sizeof(hash_hashes.data);
-          memcpy(hash_weights.data, p, sizeof(hash_weights.data));
-          p += sizeof(hash_weights.data);
-          m_blocks_hash_of_hashes.push_back(std::make_pair(hash_hashes, hash_weights));
-        }
-        m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, std::make_pair(crypto::null_hash, 0));
-        MINFO(nblocks << " block hashes loaded");
+    // the compiled in data is used in place, the per block hashes are
+    // only allocated as the chunks covering them get verified
+    m_blocks_hash_of_hashes = checkpoints.subspan(sizeof(uint32_t));
+    m_blocks_hash_check_height = uint64_t(nblocks) * HASH_OF_HASHES_STEP;
+    MINFO(nblocks << " block hashes loaded");
 
-        // FIXME: clear tx_pool because the process might have been
-        // terminated and caused it to store txs kept by blocks.
-        // The core will not call check_tx_inputs(..) for these
-        // transactions in this case. Consequently, the sanity check
-        // for tx hashes will fail in handle_block_to_main_chain(..)
-        CRITICAL_REGION_LOCAL(m_tx_pool);
+    // FIXME: clear tx_pool because the process might have been
+    // terminated and caused it to store txs kept by blocks.
+    // The core will not call check_tx_inputs(..) for these
+    // transactions in this case. Consequently, the sanity check
+    // for tx hashes will fail in handle_block_to_main_chain(..)
+    CRITICAL_REGION_LOCAL(m_tx_pool);
 
-        std::vector<transaction> txs;
-        m_tx_pool.get_transactions(txs, true);
+    std::vector<transaction> txs;
+    m_tx_pool.get_transactions(txs, true);
 
-        size_t tx_weight;
-        uint64_t fee;
-        bool relayed, do_not_relay, double_spend_seen, pruned;
-        transaction pool_tx;
-        blobdata txblob;
-        for(const transaction &tx : txs)
-        {
-          crypto::hash tx_hash = get_transaction_hash(tx);
-          m_tx_pool.take_tx(tx_hash, pool_tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen, pruned);
-        }
-      }
+    size_t tx_weight;
+    uint64_t fee;
+    bool relayed, do_not_relay, double_spend_seen, pruned;
+    transaction pool_tx;
+    blobdata txblob;
+    for(const transaction &tx : txs)
+    {
+      crypto::hash tx_hash = get_transaction_hash(tx);
+      m_tx_pool.take_tx(tx_hash, pool_tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen, pruned);
     }
   }
 }
@@ -5721,7 +6688,7 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
 bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 {
 #if defined(PER_BLOCK_CHECKPOINT)
-  return height < m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP;
+  return height < get_compiled_hash_of_hashes_count() * HASH_OF_HASHES_STEP;
 #else
   return false;
 #endif
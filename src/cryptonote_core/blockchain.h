@@ -41,6 +41,7 @@
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
 #include <atomic>
 #include <functional>
 #include <unordered_map>
@@ -53,6 +54,8 @@
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "common/powerof.h"
 #include "common/util.h"
+#include "common/threadpool.h"
+#include "common/memory_usage.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
@@ -62,6 +65,7 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "txpool_memory_store.h"
 
 namespace tools { class Notify; }
 
@@ -86,7 +90,8 @@ namespace cryptonote
    * 
    * @param network network type
    * 
-   * @return checkpoints data, empty span if there ain't any checkpoints for specific network type
+   * @return checkpoints data, empty span if there ain't any checkpoints for specific network type;
+   *         it is used in place, so must outlive the Blockchain
    */
   typedef std::function<const epee::span<const unsigned char>(cryptonote::network_type network)> GetCheckpointsCallback;
 
@@ -111,6 +116,23 @@ namespace cryptonote
       uint64_t already_generated_coins; //!< the total coins minted after that block
     };
 
+    /**
+     * @brief per stage timings of block imports, in milliseconds
+     */
+    struct import_stage_times_t
+    {
+      uint64_t prefetch, pow, scan, verify, add, commit;
+      size_t blocks, prefetched;
+
+      import_stage_times_t& operator+=(const import_stage_times_t &other)
+      {
+        prefetch += other.prefetch; pow += other.pow; scan += other.scan;
+        verify += other.verify; add += other.add; commit += other.commit;
+        blocks += other.blocks; prefetched += other.prefetched;
+        return *this;
+      }
+    };
+
     /**
      * @brief Blockchain constructor
      *
@@ -262,6 +284,38 @@ namespace cryptonote
      */
     bool cleanup_handle_incoming_blocks(bool force_sync = false);
 
+    /**
+     * @brief starts computing the PoW hashes of a span queued behind the one being added
+     *
+     * This is the first stage of the block import pipeline: while the span
+     * handed to prepare_handle_incoming_blocks is being verified and written
+     * to the database, the PoW hashes of the following span are computed on
+     * the compute threadpool. prepare_handle_incoming_blocks picks them up
+     * when that span is added. At most one span is in flight at a time, and
+     * blocks whose RandomX seed hash is not known yet are left to prepare.
+     *
+     * @param height the height of the first block of the span
+     * @param blocks_entry the blocks of the span
+     *
+     * @return true if the span was queued, false if the pipeline is busy or the span unusable
+     */
+    bool prefetch_incoming_blocks_pow(uint64_t height, const std::vector<block_complete_entry> &blocks_entry);
+
+    /**
+     * @brief starts computing the PoW hash of a single block on the compute threadpool
+     *
+     * This is for blocks that arrive outside of a synced span, such as newly
+     * relayed blocks. The caller does not wait: the hash is computed while the
+     * block's transactions are gathered, and picked up when the block is added
+     * to the main chain or to an alternative chain. Only blocks whose parent
+     * is on the main chain are queued, since their seed hash is known now.
+     *
+     * @param b the block
+     *
+     * @return true if the block's PoW hash is being computed
+     */
+    bool queue_block_pow(const block &b);
+
     /**
      * @brief search the blockchain for a transaction by hash
      *
@@ -294,6 +348,16 @@ namespace cryptonote
      */
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im) const;
 
+    /**
+     * @brief check if several key images are already spent on the blockchain
+     *
+     * The lookups are sorted to walk the database once.
+     *
+     * @param key_images the key images to search for
+     * @param spent return-by-reference whether each one is spent, in the order passed
+     */
+    void have_tx_keyimgs_as_spent(const epee::span<const crypto::key_image> key_images, std::vector<bool> &spent) const;
+
     /**
      * @brief get the current height of the blockchain
      *
@@ -614,6 +678,22 @@ namespace cryptonote
      */
     bool check_tx_inputs(transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
+    /**
+     * @brief validates a transaction's inputs, leaving its ring signatures unverified
+     *
+     * Performs the same checks as check_tx_inputs, except the rct ring
+     * signatures are expanded and appended to ring_sigs rather than
+     * verified, so a caller can verify many of them in one batch without
+     * holding the blockchain lock.  ring_sigs points into tx.
+     *
+     * @param tx the transaction to validate
+     * @param tvc returned information about tx verification
+     * @param ring_sigs return-by-reference the rct signatures left to verify
+     *
+     * @return false if any input is invalid, otherwise true
+     */
+    bool check_tx_inputs_deferred(transaction& tx, tx_verification_context &tvc, std::vector<const rct::rctSig*> &ring_sigs) const;
+
     /**
      * @brief get fee quantization mask
      *
@@ -672,6 +752,18 @@ namespace cryptonote
      */
     void get_dynamic_base_fee_estimate_2021_scaling(uint64_t grace_blocks, std::vector<uint64_t> &fees) const;
 
+    /**
+     * @brief get fee per byte quantiles of the transactions in the last blocks
+     *
+     * The fee rates of each block are kept by block hash once read, so
+     * only blocks added since the previous call are read from the db.
+     *
+     * @param nblocks number of blocks to look at, from the top
+     * @param percentiles the percentiles to get, each at most 100
+     * @param quantiles return-by-reference the quantiles over these blocks
+     */
+    void get_recent_fee_rate_quantiles(uint64_t nblocks, const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles) const;
+
     /**
      * @brief validate a transaction's fee
      *
@@ -812,6 +904,17 @@ namespace cryptonote
     void set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold,
         blockchain_db_sync_mode sync_mode, bool fast_sync);
 
+    /**
+     * @brief sets the thread limit for hashing pre-RandomX blocks
+     *
+     * CryptoNight blocks are small and their hashes cheap to spread, so
+     * full verification of the early chain can use more threads than
+     * the RandomX part.
+     *
+     * @param maxthreads max number of threads, 0 for all compute threads
+     */
+    void set_prepare_historical_blocks_threads(uint64_t maxthreads) { m_max_prepare_historical_blocks_threads = maxthreads; }
+
     /**
      * @brief sets a block notify object to call for every new block
      *
@@ -1017,6 +1120,27 @@ namespace cryptonote
       return *m_db;
     }
 
+    /**
+     * @brief get the per stage import timings summed over all batches since init
+     *
+     * @return the accumulated timings of completed batches
+     */
+    import_stage_times_t get_import_stage_totals() const { return m_import_stage_totals; }
+
+    /**
+     * @brief sets how many parsed alt blocks are kept in memory
+     *
+     * @param max_blocks the new limit, least recently used blocks are dropped first
+     */
+    void set_alt_block_cache_size(size_t max_blocks);
+
+    /**
+     * @brief reports the approximate memory held by the in memory caches
+     *
+     * @param usage return-by-reference, one entry per cache is appended
+     */
+    void get_memory_usage(std::vector<tools::memory_usage> &usage) const;
+
     /**
      * @brief get a number of outputs of a specific amount
      *
@@ -1037,6 +1161,62 @@ namespace cryptonote
     void block_longhash_worker(uint64_t height, const epee::span<const block> &blocks,
         std::unordered_map<crypto::hash, crypto::hash> &map) const;
 
+    /**
+     * @brief a span whose PoW hashes are computed ahead of prepare_handle_incoming_blocks
+     */
+    struct pow_prefetch_t
+    {
+      uint64_t height;
+      std::vector<block> blocks;
+      std::vector<crypto::hash> ids;
+      std::vector<crypto::hash> seeds; //!< null_hash if not resolved when the span was queued
+      std::vector<crypto::hash> pow; //!< null_hash if not computed
+      std::atomic<uint64_t> elapsed;
+    };
+
+    /**
+     * @brief computes the PoW hashes for part of a prefetched span
+     *
+     * @param prefetch the span
+     * @param start the index of the first block to hash
+     * @param nblocks the number of blocks to hash
+     */
+    void pow_prefetch_worker(pow_prefetch_t &prefetch, size_t start, size_t nblocks) const;
+
+    /**
+     * @brief picks the number of threads to hash a span of blocks with
+     *
+     * @param last_height the height of the last block of the span
+     *
+     * @return the number of threads, at least 1
+     */
+    unsigned get_prepare_blocks_threads(uint64_t last_height) const;
+
+    /**
+     * @brief a single block's PoW hash queued by queue_block_pow
+     */
+    struct queued_pow_t
+    {
+      queued_pow_t(tools::threadpool &tpool): waiter(tpool) {}
+      uint64_t height;
+      crypto::hash seed;
+      crypto::hash pow; //!< null_hash if not computed
+      tools::threadpool::waiter waiter;
+    };
+
+    /**
+     * @brief takes the PoW hash queued for a block, waiting for it if needed
+     *
+     * The caller must check that the seed hash is the block's.
+     *
+     * @param id the block's hash
+     * @param pow return-by-reference the PoW hash
+     * @param seed return-by-reference the RandomX seed hash it was computed with
+     *
+     * @return true if a hash for this block was queued
+     */
+    bool take_queued_pow(const crypto::hash &id, crypto::hash &pow, crypto::hash &seed);
+
     /**
      * @brief returns a set of known alternate chains
      *
@@ -1054,6 +1234,26 @@ namespace cryptonote
     bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)>, bool include_blob = false, relay_category tx_category = relay_category::broadcasted) const;
     bool txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category);
 
+    /**
+     * @brief keeps the txpool in memory from now on, see txpool_memory_store
+     *
+     * Must be called before the txpool is initialized. The database copy
+     * is only brought up to date by flush_txpool_store.
+     */
+    void use_txpool_memory_store();
+
+    /**
+     * @brief writes changes to the in memory txpool to the database
+     *
+     * The caller must hold the txpool lock.
+     *
+     * @return the number of txes written or removed
+     */
+    size_t flush_txpool_store();
+
+    //! \return true if txpool changes go straight to the database, and need a database transaction
+    bool txpool_in_db() const { return !m_txpool_store; }
+
     bool is_within_compiled_block_hash_area() const { return is_within_compiled_block_hash_area(m_db->height()); }
     uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes, const std::vector<uint64_t> &weights);
     uint32_t get_blockchain_pruning_seed() const { return m_db->get_blockchain_pruning_seed(); }
@@ -1135,8 +1335,13 @@ namespace cryptonote
     BlockchainDB* m_db;
 
     tx_memory_pool& m_tx_pool;
+    std::unique_ptr<txpool_memory_store> m_txpool_store;
 
-    mutable epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+    // taken by everything changing the chain or the in memory state derived
+    // from it. Queries only reading the db do not take it, they run on a db
+    // read snapshot instead, so they do not wait behind each other or behind
+    // block import, and readers never see a partly added or popped block
+    mutable epee::critical_section m_blockchain_lock;
 
     // main chain
     size_t m_current_block_cumul_weight_limit;
@@ -1145,10 +1350,15 @@ namespace cryptonote
     // metadata containers
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    //! PoW of alt blocks which passed their difficulty check, reused if they get on the main chain
+    std::unordered_map<crypto::hash, crypto::hash> m_alt_block_pow;
 
     // Keccak hashes for each block and for fast pow checking
-    std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
+    //! compiled in (hash of hashes, hash of weights) pairs, read in place
+    epee::span<const unsigned char> m_blocks_hash_of_hashes;
+    //! verified hashes and weights, grown a chunk at a time as they get verified
     std::vector<std::pair<crypto::hash, uint64_t>> m_blocks_hash_check;
+    uint64_t m_blocks_hash_check_height; //!< end of the compiled hash area, 0 once dumped
     std::vector<crypto::hash> m_blocks_txs_check;
 
     blockchain_db_sync_mode m_db_sync_mode;
@@ -1158,14 +1368,18 @@ namespace cryptonote
     bool m_db_sync_on_blocks;
     uint64_t m_db_sync_threshold;
     uint64_t m_max_prepare_blocks_threads;
+    uint64_t m_max_prepare_historical_blocks_threads;
     uint64_t m_fake_pow_calc_time;
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
     uint64_t m_bytes_to_sync;
+    // timestamps and cumulative difficulties of the last DIFFICULTY_BLOCKS_COUNT
+    // blocks up to m_timestamps_and_difficulties_top_hash, at chain height
+    // m_timestamps_and_difficulties_height (0 when invalid)
     std::vector<uint64_t> m_timestamps;
     std::vector<difficulty_type> m_difficulties;
     uint64_t m_timestamps_and_difficulties_height;
-    bool m_reset_timestamps_and_difficulties_height;
+    crypto::hash m_timestamps_and_difficulties_top_hash;
     uint64_t m_long_term_block_weights_window;
     uint64_t m_long_term_effective_median_block_weight;
     mutable crypto::hash m_long_term_block_weights_cache_tip_hash;
@@ -1175,6 +1389,18 @@ namespace cryptonote
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
 
+    // the last 2021 scaling fee estimate, valid while the top block is
+    // m_fee_estimate_top_hash
+    mutable epee::critical_section m_fee_estimate_lock;
+    mutable crypto::hash m_fee_estimate_top_hash;
+    mutable uint64_t m_fee_estimate_grace_blocks;
+    mutable std::vector<uint64_t> m_fee_estimate;
+
+    // fee per byte and weight of the txes of the last blocks asked for in
+    // get_recent_fee_rate_quantiles, by block hash
+    mutable epee::critical_section m_recent_fee_rates_lock;
+    mutable std::unordered_map<crypto::hash, std::vector<std::pair<uint64_t, uint64_t>>> m_recent_fee_rates;
+
     boost::asio::io_service m_async_service;
     boost::thread_group m_async_pool;
     std::unique_ptr<boost::asio::io_service::work> m_async_work_idle;
@@ -1182,6 +1408,68 @@ namespace cryptonote
     // some invalid blocks
     blocks_ext_by_hash m_invalid_blocks;     // crypto::hash -> block_extended_info
 
+    // parsed alt blocks, most recently used first, so walking an alt chain
+    // does not deserialize every block again; blocks are keyed by their own
+    // hash, so entries never go stale. Guarded by m_blockchain_lock
+    struct alt_block_cache_entry
+    {
+      crypto::hash id;
+      block bl;
+    };
+    typedef boost::multi_index_container<
+      alt_block_cache_entry,
+      boost::multi_index::indexed_by<
+        boost::multi_index::sequenced<>,
+        boost::multi_index::hashed_unique<boost::multi_index::member<alt_block_cache_entry, crypto::hash, &alt_block_cache_entry::id>>
+      >
+    > alt_block_cache_t;
+    mutable alt_block_cache_t m_alt_block_cache;
+    size_t m_alt_block_cache_max;
+
+    // assembled span responses, most recently used first, so the peers
+    // (handle_get_objects) and wallets (find_blockchain_supplement) asking
+    // for the same range do not each read and copy the blobs from the db
+    // again. Entries ending past the top are dropped when blocks are popped,
+    // and those cut short by the top when the chain grows. Guarded by
+    // m_blockchain_lock
+    struct span_cache_key
+    {
+      uint64_t start_height;
+      uint64_t count;
+      uint64_t max_tx_count;
+      uint8_t flags;
+
+      bool operator==(const span_cache_key &other) const
+      {
+        return start_height == other.start_height && count == other.count && max_tx_count == other.max_tx_count && flags == other.flags;
+      }
+    };
+    struct span_cache_key_hash
+    {
+      size_t operator()(const span_cache_key &key) const;
+    };
+    struct span_cache_entry
+    {
+      span_cache_key key;
+      uint64_t end_height; // one past the highest block in the span
+      crypto::hash top_id; // id of the block at end_height - 1, checked on lookup
+      uint64_t chain_height; // when assembled, 0 if more blocks cannot change the span
+      size_t bytes;
+      std::vector<crypto::hash> ids;
+      std::vector<block_complete_entry> objects;
+      std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>> supplement;
+    };
+    typedef boost::multi_index_container<
+      span_cache_entry,
+      boost::multi_index::indexed_by<
+        boost::multi_index::sequenced<>,
+        boost::multi_index::hashed_unique<boost::multi_index::member<span_cache_entry, span_cache_key, &span_cache_entry::key>, span_cache_key_hash>
+      >
+    > span_cache_t;
+    mutable span_cache_t m_span_cache;
+    mutable size_t m_span_cache_size;
+    mutable boost::mutex m_span_cache_lock; // taken by snapshot readers too
+
 
     checkpoints m_checkpoints;
     bool m_enforce_dns_checkpoints;
@@ -1222,6 +1510,32 @@ namespace cryptonote
     uint64_t m_prepare_nblocks;
     std::vector<block> *m_prepare_blocks;
 
+    // block import pipeline: PoW of the next span, computed while the current one is added
+    boost::mutex m_pow_prefetch_lock;
+    std::unique_ptr<pow_prefetch_t> m_pow_prefetch;
+    std::unique_ptr<tools::threadpool::waiter> m_pow_prefetch_waiter;
+    uint64_t m_prepared_ids_height;
+    std::vector<crypto::hash> m_prepared_ids;
+
+    // PoW of single blocks, computed ahead of adding them
+    mutable boost::mutex m_queued_pow_lock;
+    std::unordered_map<crypto::hash, std::shared_ptr<queued_pow_t>> m_queued_pow;
+
+    // per stage timings for the current batch, reported if m_show_time_stats
+    import_stage_times_t m_import_stage_times;
+    // and their sum over all batches since init
+    import_stage_times_t m_import_stage_totals;
+
+    /**
+     * @brief moves the prefetched PoW hashes matching a span into m_blocks_longhash_table
+     *
+     * @param height the height of the first block of the span
+     * @param blocks the parsed blocks of the span
+     *
+     * @return the number of hashes reused
+     */
+    size_t take_prefetched_pow(uint64_t height, const std::vector<block> &blocks);
+
     /**
      * @brief collects the keys for all outputs being "spent" as an input
      *
@@ -1238,11 +1552,12 @@ namespace cryptonote
      * @param tx_prefix_hash the hash of the associated transaction_prefix
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
      * @param tx_version version of the tx, if > 1 we also get commitments
+     * @param prefetched_outputs if not NULL, the ring members' data, already looked up
      *
      * @return false if any keys are not found or any inputs are not unlocked, otherwise true
      */
     template<class visitor_t>
-    inline bool scan_outputkeys_for_indexes(size_t tx_version, const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height = NULL) const;
+    inline bool scan_outputkeys_for_indexes(size_t tx_version, const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height = NULL, const std::vector<output_data_t> *prefetched_outputs = NULL) const;
 
     /**
      * @brief collect output public keys of a transaction input set
@@ -1262,10 +1577,25 @@ namespace cryptonote
      * @param rct_signatures the ringCT signatures, which are only valid if tx version > 1
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
      * @param hf_version the consensus rules version to use
+     * @param prefetched_outputs if not NULL, the ring members' data, already looked up
      *
      * @return false if any output is not yet unlocked, or is missing, otherwise true
      */
-    bool check_tx_input(size_t tx_version,const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, const rct::rctSig &rct_signatures, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height, uint8_t hf_version) const;
+    bool check_tx_input(size_t tx_version,const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, const rct::rctSig &rct_signatures, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height, uint8_t hf_version, const std::vector<output_data_t> *prefetched_outputs = NULL) const;
+
+    /**
+     * @brief looks up the ring members of all of a transaction's inputs at once
+     *
+     * Nothing is looked up if the transaction's inputs are already in the
+     * scan table built by prepare_handle_incoming_blocks.
+     *
+     * @param tx the transaction
+     * @param tx_prefix_hash the transaction prefix hash
+     * @param outputs return-by-reference the ring members' data, one vector per input
+     *
+     * @return true if the outputs were all found, false if the caller should look them up input by input
+     */
+    bool prefetch_tx_ring_members(const transaction &tx, const crypto::hash &tx_prefix_hash, std::vector<std::vector<output_data_t>> &outputs) const;
 
     /**
      * @brief validate a transaction's inputs and their keys
@@ -1279,15 +1609,18 @@ namespace cryptonote
      * of the most recent block which contains an output used in any input set
      *
      * Currently this function calls ring signature validation for each
-     * transaction.
+     * transaction, unless deferred_ring_sigs is not NULL, in which case
+     * the simple rct ring signatures are appended to it instead, so the
+     * caller can verify a whole block's worth in one batch.
      *
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param deferred_ring_sigs if not NULL, return-by-pointer the rct signatures left to verify
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL) const;
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, std::vector<const rct::rctSig*> *deferred_ring_sigs = NULL) const;
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -1310,6 +1643,30 @@ namespace cryptonote
      */
     block pop_block_from_blockchain();
 
+    /**
+     * @brief removes several blocks from the top of the blockchain at once
+     *
+     * Unlike repeated pop_block_from_blockchain calls, the hard fork state
+     * is rewound once, the difficulty and long term weight caches are
+     * dropped rather than moved block by block, and the popped txes are
+     * returned to the pool, oldest block first, after the last pop.
+     *
+     * @param nblocks number of blocks to remove, less than the chain height
+     * @param popped_blocks if not NULL, receives the popped blocks, oldest first
+     */
+    void pop_blocks_bulk(uint64_t nblocks, std::list<block> *popped_blocks = NULL);
+
+    /**
+     * @brief computes the PoW of blocks popped off the main chain in parallel
+     *
+     * The results are cached so adding the blocks back as alt blocks does
+     * not hash them again one by one.
+     *
+     * @param disconnected_chain the popped blocks, oldest first
+     * @param split_height the height of the oldest popped block
+     */
+    void precompute_disconnected_pow(const std::list<block> &disconnected_chain, uint64_t split_height);
+
     /**
      * @brief validate and add a new block to the end of the blockchain
      *
@@ -1368,6 +1725,18 @@ namespace cryptonote
      */
     bool build_alt_chain(const crypto::hash &prev_id, std::list<block_extended_info>& alt_chain, std::vector<uint64_t> &timestamps, block_verification_context& bvc) const;
 
+    /**
+     * @brief gets an alt block, parsing it only if it is not cached
+     *
+     * The caller must hold m_blockchain_lock.
+     *
+     * @param id the block hash
+     * @param bei return-by-reference the block and its alt chain metadata
+     *
+     * @return true if the block is in the alt blocks storage, false otherwise
+     */
+    bool get_alt_block_extended_info(const crypto::hash &id, block_extended_info &bei) const;
+
     /**
      * @brief gets the difficulty requirement for a new block on an alternate chain
      *
@@ -1574,6 +1943,24 @@ namespace cryptonote
      */
     void load_compiled_in_block_hashes(const GetCheckpointsCallback& get_checkpoints);
 
+    /**
+     * @brief gets the number of compiled in hashes of hashes
+     */
+    size_t get_compiled_hash_of_hashes_count() const { return m_blocks_hash_of_hashes.size() / (2 * sizeof(crypto::hash)); }
+
+    /**
+     * @brief gets a compiled in hash of HASH_OF_HASHES_STEP block hashes, or weights
+     *
+     * @param n the index of the chunk, less than get_compiled_hash_of_hashes_count()
+     * @param weights true for the hash of the weights, false for that of the block hashes
+     */
+    crypto::hash get_compiled_hash_of_hashes(size_t n, bool weights) const
+    {
+      crypto::hash hash;
+      memcpy(hash.data, m_blocks_hash_of_hashes.data() + (2 * n + (weights ? 1 : 0)) * sizeof(crypto::hash), sizeof(hash.data));
+      return hash;
+    }
+
     /**
      * @brief expands v2 transaction data from blockchain
      *
@@ -1583,6 +1970,33 @@ namespace cryptonote
      */
     bool expand_transaction_2(transaction &tx, const crypto::hash &tx_prefix_hash, const std::vector<std::vector<rct::ctkey>> &pubkeys) const;
 
+    /**
+     * @brief looks up an assembled span, moving it to the front of the cache
+     *
+     * The span is checked against the caller's db snapshot, as it may have
+     * been assembled by a reader on another snapshot.
+     *
+     * @param key the span parameters
+     * @param entry return-by-reference a copy of the cached span
+     *
+     * @return false if there is none or it went stale
+     */
+    bool find_cached_span(const span_cache_key &key, span_cache_entry &entry) const;
+
+    /**
+     * @brief stores an assembled span, evicting the least recently used ones
+     *
+     * @param entry the span, with everything but bytes filled in
+     */
+    void cache_span(span_cache_entry &&entry) const;
+
+    /**
+     * @brief drops the cached spans reaching past a height
+     *
+     * @param height the new chain height, 0 drops everything
+     */
+    void invalidate_span_cache(uint64_t height);
+
     /**
      * @brief invalidates any cached block template
      */
@@ -41,7 +41,10 @@ using namespace epee;
 #include "common/download.h"
 #include "common/threadpool.h"
 #include "common/command_line.h"
+#include "common/metrics.h"
+#include "common/perf_timer.h"
 #include "cryptonote_basic/events.h"
+#include "cryptonote_basic/transaction_view.h"
 #include "warnings.h"
 #include "crypto/crypto.h"
 #include "cryptonote_config.h"
@@ -71,6 +74,14 @@ DISABLE_VS_WARNINGS(4355)
 // basically at least how many bytes the block itself serializes to without the miner tx
 #define BLOCK_SIZE_SANITY_LEEWAY 100
 
+namespace
+{
+  tools::metrics::counter txes_added_metric("monero_txpool_added_total", "Transactions added to the pool");
+  tools::metrics::counter txes_rejected_metric("monero_txpool_rejected_total", "Incoming transactions that failed verification");
+  tools::metrics::counter txes_known_metric("monero_txpool_known_total", "Incoming transactions that were already known");
+  tools::metrics::histogram tx_admission_metric("monero_txpool_admission_microseconds", "Time to verify and add a batch of incoming transactions");
+}
+
 namespace cryptonote
 {
   const command_line::arg_descriptor<bool, false> arg_testnet_on  = {
@@ -124,6 +135,11 @@ namespace cryptonote
   , "Set maximum size of block download queue in bytes (0 for default)"
   , 0
   };
+  const command_line::arg_descriptor<size_t> arg_block_download_spill_size  = {
+    "block-download-spill-size"
+  , "Move downloaded blocks past the block download queue size to disk, up to this many bytes (0 to disable)"
+  , 0
+  };
   const command_line::arg_descriptor<bool> arg_sync_pruned_blocks  = {
     "sync-pruned-blocks"
   , "Allow syncing from nodes with only pruned blocks"
@@ -158,6 +174,11 @@ namespace cryptonote
   , "Max number of threads to use when preparing block hashes in groups."
   , 4
   };
+  static const command_line::arg_descriptor<uint64_t> arg_prep_historical_blocks_threads = {
+    "prep-historical-blocks-threads"
+  , "Max number of threads to use when preparing pre-RandomX block hashes, 0 for all."
+  , 0
+  };
   static const command_line::arg_descriptor<uint64_t> arg_show_time_stats  = {
     "show-time-stats"
   , "Show time-stats when processing blocks/txs and disk synchronization."
@@ -188,9 +209,25 @@ namespace cryptonote
   , "Set maximum txpool weight in bytes."
   , DEFAULT_TXPOOL_MAX_WEIGHT
   };
+  static const command_line::arg_descriptor<size_t> arg_txpool_cache_max_entries  = {
+    "txpool-cache-max-entries"
+  , "Set the maximum number of entries in each of the txpool's input check and parsed transaction caches, 0 for no limit"
+  , DEFAULT_TXPOOL_CACHE_MAX_ENTRIES
+  };
+  static const command_line::arg_descriptor<bool> arg_txpool_in_memory  = {
+    "txpool-in-memory"
+  , "Keep the txpool in memory and write it to the database once a minute and on exit, rather than on every change"
+  , false
+  };
+  static const command_line::arg_descriptor<size_t> arg_alt_block_cache_size  = {
+    "alt-block-cache-size"
+  , "Set the number of parsed alternative blocks kept in memory"
+  , 2 * (DIFFICULTY_BLOCKS_COUNT)
+  };
   static const command_line::arg_descriptor<std::string> arg_block_notify = {
     "block-notify"
-  , "Run a program for each new block, '%s' will be replaced by the block hash"
+  , "Run a program for each new block, '%s' will be replaced by the block hash. "
+    "With a 'batch:' prefix, the program is run once and sent a line per block on its input"
   , ""
   };
   static const command_line::arg_descriptor<bool> arg_prune_blockchain  = {
@@ -223,6 +260,16 @@ namespace cryptonote
   , "Keep alternative blocks on restart"
   , false
   };
+  static const command_line::arg_descriptor<bool> arg_output_pubkey_index  = {
+    "output-pubkey-index"
+  , "Build an index of outputs by public key, for lookups through RPC. Once built, it is kept up to date"
+  , false
+  };
+  static const command_line::arg_descriptor<bool> arg_view_tag_index  = {
+    "view-tag-index"
+  , "Build an index of tx public keys and view tags by block, served to wallets through RPC. Once built, it is kept up to date"
+  , false
+  };
 
   //-----------------------------------------------------------------------------------------------
   core::core(i_cryptonote_protocol* pprotocol):
@@ -230,16 +277,24 @@ namespace cryptonote
               m_blockchain_storage(m_mempool),
               m_miner(this, [this](const cryptonote::block &b, uint64_t height, const crypto::hash *seed_hash, unsigned int threads, crypto::hash &hash) {
                 return cryptonote::get_block_longhash(&m_blockchain_storage, b, hash, height, seed_hash, threads);
+              }, [this](const cryptonote::blobdata &bd, uint8_t major_version, uint64_t height, const crypto::hash *seed_hash, unsigned int threads, crypto::hash &hash) {
+                return cryptonote::get_block_longhash(&m_blockchain_storage, bd, hash, height, major_version, seed_hash, threads);
               }),
               m_starter_message_showed(false),
               m_target_blockchain_height(0),
               m_checkpoints_path(""),
               m_last_dns_checkpoints_update(0),
               m_last_json_checkpoints_update(0),
+              m_dns_checkpoints_time(0),
+              m_dns_waiter(tools::threadpool::getInstanceForIO()),
               m_disable_dns_checkpoints(false),
               m_update_download(0),
               m_nettype(UNDEFINED),
-              m_update_available(false)
+              m_update_available(false),
+              m_block_template_reserve_size(0),
+              m_block_template_pending(false),
+              m_block_template_new_block(false),
+              m_block_template_stop(false)
   {
     m_checkpoints_updating.clear();
     set_cryptonote_protocol(pprotocol);
@@ -276,6 +331,123 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
     m_zmq_pub = std::move(zmq_pub);
   }
+  //-----------------------------------------------------------------------------------
+  void core::set_block_template_listener(const account_public_address &address, size_t reserve_size, boost::function<void(const block_template_event&)> listener)
+  {
+    const bool start = listener && !m_block_template_listener;
+    {
+      boost::lock_guard<boost::mutex> lock(m_block_template_mutex);
+      m_block_template_address = address;
+      m_block_template_reserve_size = reserve_size;
+      m_block_template_listener = std::move(listener);
+    }
+    if (!start)
+      return;
+
+    m_blockchain_storage.add_miner_notify([this](uint8_t, uint64_t, const crypto::hash&, const crypto::hash&, difficulty_type, uint64_t, uint64_t, const std::vector<tx_block_template_backlog_entry>&) {
+      notify_block_template_listener(true);
+    });
+    m_block_template_thread = boost::thread(boost::bind(&core::block_template_worker, this));
+    notify_block_template_listener(true);
+  }
+  //-----------------------------------------------------------------------------------
+  void core::notify_block_template_listener(bool new_block)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_block_template_mutex);
+      if (!m_block_template_listener)
+        return;
+      m_block_template_pending = true;
+      m_block_template_new_block |= new_block;
+    }
+    m_block_template_cond.notify_one();
+  }
+  //-----------------------------------------------------------------------------------
+  bool core::make_block_template_event(block_template_event &event)
+  {
+    account_public_address address;
+    size_t reserve_size;
+    {
+      boost::lock_guard<boost::mutex> lock(m_block_template_mutex);
+      address = m_block_template_address;
+      reserve_size = m_block_template_reserve_size;
+    }
+
+    block b;
+    const blobdata extra_nonce(reserve_size, '\0');
+    if (!get_block_template(b, address, event.difficulty, event.height, event.expected_reward, extra_nonce, event.seed_height, event.seed_hash))
+      return false;
+
+    event.prev_id = b.prev_id;
+    event.blocktemplate_blob = block_to_blob(b);
+    event.blockhashing_blob = get_block_hashing_blob(b);
+
+    uint64_t seed_height, next_height;
+    crypto::rx_seedheights(event.height, &seed_height, &next_height);
+    event.next_seed_hash = next_height != seed_height ? get_block_id_by_height(next_height) : event.seed_hash;
+
+    event.reserved_offset = 0;
+    if (reserve_size)
+    {
+      // the extra nonce follows the tx pub key, after its tag and size bytes
+      const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(b.miner_tx);
+      const char *pub_key = reinterpret_cast<const char*>(&tx_pub_key);
+      const auto it = std::search(event.blocktemplate_blob.begin(), event.blocktemplate_blob.end(), pub_key, pub_key + sizeof(tx_pub_key));
+      if (tx_pub_key == crypto::null_pkey || it == event.blocktemplate_blob.end())
+        return false;
+      event.reserved_offset = (it - event.blocktemplate_blob.begin()) + sizeof(tx_pub_key) + 2;
+      if (event.reserved_offset + reserve_size > event.blocktemplate_blob.size())
+        return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  void core::block_template_worker()
+  {
+    MLOG_SET_THREAD_NAME("[block template]");
+    crypto::hash last_prev_id = crypto::null_hash;
+    uint64_t last_expected_reward = 0;
+    for (;;)
+    {
+      boost::function<void(const block_template_event&)> listener;
+      {
+        boost::unique_lock<boost::mutex> lock(m_block_template_mutex);
+        m_block_template_cond.wait(lock, [this]{ return m_block_template_stop || m_block_template_pending; });
+        // txes tend to come in bursts, give them a moment unless there's a new block to mine on
+        if (!m_block_template_stop && !m_block_template_new_block)
+          m_block_template_cond.wait_for(lock, boost::chrono::milliseconds(100), [this]{ return m_block_template_stop || m_block_template_new_block; });
+        if (m_block_template_stop)
+          return;
+        m_block_template_pending = false;
+        m_block_template_new_block = false;
+        listener = m_block_template_listener;
+      }
+      if (!listener || !is_synchronized())
+        continue;
+
+      block_template_event event;
+      try
+      {
+        if (!make_block_template_event(event))
+        {
+          MERROR("Failed to create block template for the block template listener");
+          continue;
+        }
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to create block template for the block template listener: " << e.what());
+        continue;
+      }
+
+      // a pool change is only worth a new template if it pays more
+      if (event.prev_id == last_prev_id && event.expected_reward <= last_expected_reward)
+        continue;
+      last_prev_id = event.prev_id;
+      last_expected_reward = event.expected_reward;
+      listener(event);
+    }
+  }
 
   //-----------------------------------------------------------------------------------------------
   bool core::update_checkpoints(const bool skip_dns /* = false */)
@@ -287,9 +459,21 @@ namespace cryptonote
     bool res = true;
     if (!skip_dns && time(NULL) - m_last_dns_checkpoints_update >= 3600)
     {
-      res = m_blockchain_storage.update_checkpoints(m_checkpoints_path, true);
+      // DNS can take a long time to answer, so the lookup does not hold up
+      // the caller; it applies its checkpoints when it is done
       m_last_dns_checkpoints_update = time(NULL);
       m_last_json_checkpoints_update = time(NULL);
+      tools::threadpool::getInstanceForIO().submit(&m_dns_waiter, [this](){
+        const bool res = m_blockchain_storage.update_checkpoints(m_checkpoints_path, true);
+        m_dns_checkpoints_time = time(NULL);
+        m_checkpoints_updating.clear();
+        if (!res)
+        {
+          MERROR("One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
+          graceful_exit();
+        }
+      });
+      return true;
     }
     else if (time(NULL) - m_last_json_checkpoints_update >= 600)
     {
@@ -336,6 +520,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_fixed_difficulty);
     command_line::add_arg(desc, arg_dns_checkpoints);
     command_line::add_arg(desc, arg_prep_blocks_threads);
+    command_line::add_arg(desc, arg_prep_historical_blocks_threads);
     command_line::add_arg(desc, arg_fast_block_sync);
     command_line::add_arg(desc, arg_show_time_stats);
     command_line::add_arg(desc, arg_block_sync_size);
@@ -346,13 +531,19 @@ namespace cryptonote
     command_line::add_arg(desc, arg_offline);
     command_line::add_arg(desc, arg_disable_dns_checkpoints);
     command_line::add_arg(desc, arg_block_download_max_size);
+    command_line::add_arg(desc, arg_block_download_spill_size);
     command_line::add_arg(desc, arg_sync_pruned_blocks);
     command_line::add_arg(desc, arg_max_txpool_weight);
+    command_line::add_arg(desc, arg_txpool_cache_max_entries);
+    command_line::add_arg(desc, arg_txpool_in_memory);
+    command_line::add_arg(desc, arg_alt_block_cache_size);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
     command_line::add_arg(desc, arg_reorg_notify);
     command_line::add_arg(desc, arg_block_rate_notify);
     command_line::add_arg(desc, arg_keep_alt_blocks);
+    command_line::add_arg(desc, arg_output_pubkey_index);
+    command_line::add_arg(desc, arg_view_tag_index);
 
     miner::init_options(desc);
     BlockchainDB::init_options(desc);
@@ -469,6 +660,16 @@ namespace cryptonote
   {
     start_time = std::time(nullptr);
 
+    // time each phase, so a slow start can be pinned on one of them
+    std::vector<std::pair<const char*, uint64_t>> startup_timings;
+    const uint64_t startup_start = epee::misc_utils::get_ns_count();
+    uint64_t phase_start = startup_start;
+    const auto end_phase = [&startup_timings, &phase_start](const char *name) {
+      const uint64_t now = epee::misc_utils::get_ns_count();
+      startup_timings.emplace_back(name, (now - phase_start) / 1000000);
+      phase_start = now;
+    };
+
     const bool regtest = command_line::get_arg(vm, arg_regtest_on);
     if (test_options != NULL || regtest)
     {
@@ -480,12 +681,17 @@ namespace cryptonote
 
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_compress_prunable = command_line::get_arg(vm, cryptonote::arg_db_compress_prunable) != 0;
+    bool db_key_image_filter = command_line::get_arg(vm, cryptonote::arg_db_key_image_filter) != 0;
+    bool db_read_ahead = command_line::get_arg(vm, cryptonote::arg_db_read_ahead) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, arg_check_updates);
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
     bool prune_blockchain = command_line::get_arg(vm, arg_prune_blockchain);
     bool keep_alt_blocks = command_line::get_arg(vm, arg_keep_alt_blocks);
+    bool output_pubkey_index = command_line::get_arg(vm, arg_output_pubkey_index);
+    bool view_tag_index = command_line::get_arg(vm, arg_view_tag_index);
     bool keep_fakechain = command_line::get_arg(vm, arg_keep_fakechain);
 
     boost::filesystem::path folder(m_config_folder);
@@ -614,10 +820,17 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_compress_prunable)
+        db_flags |= DBF_COMPRESS_PRUNABLE;
+      if (db_key_image_filter)
+        db_flags |= DBF_KEY_IMAGE_FILTER;
+      if (db_read_ahead)
+        db_flags |= DBF_READ_AHEAD;
 
       db->open(filename, db_flags);
       if(!db->m_open)
         return false;
+      end_phase("db open");
     }
     catch (const DB_ERROR& e)
     {
@@ -627,6 +840,7 @@ namespace cryptonote
 
     m_blockchain_storage.set_user_options(blocks_threads,
         sync_on_blocks, sync_threshold, sync_mode, fast_sync);
+    m_blockchain_storage.set_prepare_historical_blocks_threads(command_line::get_arg(vm, arg_prep_historical_blocks_threads));
 
     try
     {
@@ -679,13 +893,24 @@ namespace cryptonote
     const difficulty_type fixed_difficulty = command_line::get_arg(vm, arg_fixed_difficulty);
     r = m_blockchain_storage.init(db.release(), m_nettype, m_offline, regtest ? &regtest_test_options : test_options, fixed_difficulty, get_checkpoints);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
+    end_phase("blockchain");
+
+    if (command_line::get_arg(vm, arg_txpool_in_memory))
+      m_blockchain_storage.use_txpool_memory_store();
 
     r = m_mempool.init(max_txpool_weight, m_nettype == FAKECHAIN);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
+    end_phase("txpool");
+    m_mempool.set_cache_max_entries(command_line::get_arg(vm, arg_txpool_cache_max_entries));
+    m_blockchain_storage.set_alt_block_cache_size(command_line::get_arg(vm, arg_alt_block_cache_size));
 
     // now that we have a valid m_blockchain_storage, we can clean out any
-    // transactions in the pool that do not conform to the current fork
-    m_mempool.validate(m_blockchain_storage.get_current_hard_fork_version());
+    // transactions in the pool that do not conform to the current fork.
+    // Large pools take a while, so this runs in the background: txes not
+    // re-validated yet are kept out of block templates and relay meanwhile
+    const uint8_t txpool_version = m_blockchain_storage.get_current_hard_fork_version();
+    m_txpool_validation_thread = boost::thread([this, txpool_version]() { m_mempool.validate(txpool_version); });
+    end_phase("txpool validation start");
 
     bool show_time_stats = command_line::get_arg(vm, arg_show_time_stats) != 0;
     m_blockchain_storage.set_show_time_stats(show_time_stats);
@@ -701,6 +926,7 @@ namespace cryptonote
     // with respect to what blocks we already have
     const bool skip_dns_checkpoints = !command_line::get_arg(vm, arg_dns_checkpoints);
     CHECK_AND_ASSERT_MES(update_checkpoints(skip_dns_checkpoints), false, "One or more checkpoints loaded from json or dns conflicted with existing checkpoints.");
+    end_phase("checkpoints");
 
    // DNS versions checking
     if (check_updates_string == "disabled" || not allow_dns)
@@ -734,8 +960,28 @@ namespace cryptonote
       {
         CHECK_AND_ASSERT_MES(m_blockchain_storage.update_blockchain_pruning(), false, "Failed to update blockchain pruning");
       }
+      end_phase("pruning");
+    }
+
+    if (output_pubkey_index && !m_blockchain_storage.get_db().has_output_pubkey_index())
+    {
+      CHECK_AND_ASSERT_MES(!m_blockchain_storage.get_db().is_read_only(), false, "Cannot build the output public key index on a read-only database");
+      CHECK_AND_ASSERT_MES(m_blockchain_storage.get_db().build_output_pubkey_index(), false, "Failed to build output public key index");
+      end_phase("output pubkey index");
     }
 
+    if (view_tag_index && !m_blockchain_storage.get_db().has_view_tag_index())
+    {
+      CHECK_AND_ASSERT_MES(!m_blockchain_storage.get_db().is_read_only(), false, "Cannot build the view tag index on a read-only database");
+      CHECK_AND_ASSERT_MES(m_blockchain_storage.get_db().build_view_tag_index(), false, "Failed to build view tag index");
+      end_phase("view tag index");
+    }
+
+    std::string report;
+    for (const auto &phase: startup_timings)
+      report += std::string(report.empty() ? "" : ", ") + phase.first + " " + std::to_string(phase.second) + " ms";
+    MGINFO("Core initialized in " << (epee::misc_utils::get_ns_count() - startup_start) / 1000000 << " ms (" << report << ")");
+
     return load_state_data();
   }
   //-----------------------------------------------------------------------------------------------
@@ -752,6 +998,17 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
     bool core::deinit()
   {
+    {
+      boost::lock_guard<boost::mutex> lock(m_block_template_mutex);
+      m_block_template_stop = true;
+    }
+    m_block_template_cond.notify_one();
+    if (m_block_template_thread.joinable())
+      m_block_template_thread.join();
+    m_dns_waiter.wait();
+    m_mempool.stop_validation();
+    if (m_txpool_validation_thread.joinable())
+      m_txpool_validation_thread.join();
     m_miner.stop();
     m_mempool.deinit();
     m_blockchain_storage.deinit();
@@ -784,7 +1041,7 @@ namespace cryptonote
     return false;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::handle_incoming_tx_pre(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash)
+  bool core::handle_incoming_tx_pre(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, bool &parsed)
   {
     tvc = {};
 
@@ -796,32 +1053,23 @@ namespace cryptonote
       return false;
     }
 
-    tx_hash = crypto::null_hash;
-
-    bool r;
-    if (tx_blob.prunable_hash == crypto::null_hash)
+    // the hash is all we need to drop txes we already have or already rejected,
+    // so only parse the tx in full when a view can't give it
+    uint64_t tx_version;
+    transaction_view view;
+    parsed = tx_blob.prunable_hash != crypto::null_hash || !view.parse(epee::strspan<uint8_t>(tx_blob.blob));
+    if (parsed)
     {
-      r = parse_tx_from_blob(tx, tx_hash, tx_blob.blob);
+      if (!parse_incoming_tx(tx_blob, tvc, tx, tx_hash))
+        return false;
+      tx_version = tx.version;
     }
     else
     {
-      r = parse_and_validate_tx_base_from_blob(tx_blob.blob, tx);
-      if (r)
-      {
-        tx.set_prunable_hash(tx_blob.prunable_hash);
-        tx_hash = cryptonote::get_pruned_transaction_hash(tx, tx_blob.prunable_hash);
-        tx.set_hash(tx_hash);
-      }
+      tx_hash = view.hash();
+      tx_version = view.version();
     }
 
-    if (!r)
-    {
-      LOG_PRINT_L1("WRONG TRANSACTION BLOB, Failed to parse, rejected");
-      tvc.m_verifivation_failed = true;
-      return false;
-    }
-    //std::cout << "!"<< tx.vin.size() << std::endl;
-
     bad_semantics_txes_lock.lock();
     for (int idx = 0; idx < 2; ++idx)
     {
@@ -837,10 +1085,10 @@ namespace cryptonote
 
     uint8_t version = m_blockchain_storage.get_current_hard_fork_version();
     const size_t max_tx_version = version == 1 ? 1 : 2;
-    if (tx.version == 0 || tx.version > max_tx_version)
+    if (tx_version == 0 || tx_version > max_tx_version)
     {
       // v2 is the latest one we know
-      MERROR_VER("Bad tx version (" << tx.version << ", max is " << max_tx_version << ")");
+      MERROR_VER("Bad tx version (" << tx_version << ", max is " << max_tx_version << ")");
       tvc.m_verifivation_failed = true;
       return false;
     }
@@ -848,6 +1096,35 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::parse_incoming_tx(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash)
+  {
+    tx_hash = crypto::null_hash;
+
+    bool r;
+    if (tx_blob.prunable_hash == crypto::null_hash)
+    {
+      r = parse_tx_from_blob(tx, tx_hash, tx_blob.blob);
+    }
+    else
+    {
+      r = parse_and_validate_tx_base_from_blob(tx_blob.blob, tx);
+      if (r)
+      {
+        tx.set_prunable_hash(tx_blob.prunable_hash);
+        tx_hash = cryptonote::get_pruned_transaction_hash(tx, tx_blob.prunable_hash);
+        tx.set_hash(tx_hash);
+      }
+    }
+
+    if (!r)
+    {
+      LOG_PRINT_L1("WRONG TRANSACTION BLOB, Failed to parse, rejected");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_tx_post(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash)
   {
     if(!check_tx_syntax(tx))
@@ -925,14 +1202,7 @@ namespace cryptonote
           tx_info[n].result = false;
           break;
         case rct::RCTTypeSimple:
-          if (!rct::verRctSemanticsSimple(rv))
-          {
-            MERROR_VER("rct signature semantics check failed");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            break;
-          }
+          rvv.push_back(&rv); // delayed batch verification, so all the range sigs are checked in parallel
           break;
         case rct::RCTTypeFull:
           if (!rct::verRct(rv, true))
@@ -985,7 +1255,8 @@ namespace cryptonote
       {
         if (!tx_info[n].result)
           continue;
-        if (tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof2 && tx_info[n].tx->rct_signatures.type != rct::RCTTypeCLSAG && tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproofPlus)
+        const uint8_t type = tx_info[n].tx->rct_signatures.type;
+        if (type != rct::RCTTypeSimple && type != rct::RCTTypeBulletproof && type != rct::RCTTypeBulletproof2 && type != rct::RCTTypeCLSAG && type != rct::RCTTypeBulletproofPlus)
           continue;
         if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures))
         {
@@ -1010,8 +1281,10 @@ namespace cryptonote
     }
 
     std::vector<txpool_event> results(tx_blobs.size());
+    std::vector<uint8_t> parsed(tx_blobs.size(), 1);
 
     CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    tools::PerformanceTimer admission_timer;
 
     tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
     tools::threadpool::waiter waiter(tpool);
@@ -1020,7 +1293,9 @@ namespace cryptonote
       tpool.submit(&waiter, [&, i, it] {
         try
         {
-          results[i].res = handle_incoming_tx_pre(*it, tvc[i], results[i].tx, results[i].hash);
+          bool tx_parsed = true;
+          results[i].res = handle_incoming_tx_pre(*it, tvc[i], results[i].tx, results[i].hash, tx_parsed);
+          parsed[i] = tx_parsed;
         }
         catch (const std::exception &e)
         {
@@ -1047,12 +1322,26 @@ namespace cryptonote
         LOG_PRINT_L2("tx " << results[i].hash << " already have transaction in blockchain");
         already_have[i] = true;
       }
-      else
+
+      // txes from blocks are still needed in full when we already have them
+      if (!already_have[i] || (!parsed[i] && tx_relay == relay_method::block))
       {
         tpool.submit(&waiter, [&, i, it] {
           try
           {
-            results[i].res = handle_incoming_tx_post(*it, tvc[i], results[i].tx, results[i].hash);
+            if (!parsed[i])
+            {
+              const crypto::hash view_hash = results[i].hash;
+              results[i].res = parse_incoming_tx(*it, tvc[i], results[i].tx, results[i].hash);
+              if (results[i].res && results[i].hash != view_hash)
+              {
+                MERROR_VER("Transaction hash mismatch between view and parsed tx " << results[i].hash);
+                tvc[i].m_verifivation_failed = true;
+                results[i].res = false;
+              }
+            }
+            if (results[i].res && !already_have[i])
+              results[i].res = handle_incoming_tx_post(*it, tvc[i], results[i].tx, results[i].hash);
           }
           catch (const std::exception &e)
           {
@@ -1082,34 +1371,44 @@ namespace cryptonote
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
       if (!results[i].res)
       {
+        txes_rejected_metric.inc();
         ok = false;
         continue;
       }
       if (tx_relay == relay_method::block)
         get_blockchain_storage().on_new_tx_from_block(results[i].tx);
       if (already_have[i])
+      {
+        // not new, and possibly never parsed, so not a txpool event
+        txes_known_metric.inc();
+        results[i].res = false;
         continue;
+      }
 
       results[i].blob_size = it->blob.size();
       results[i].weight = results[i].tx.pruned ? get_pruned_transaction_weight(results[i].tx) : get_transaction_weight(results[i].tx, it->blob.size());
       ok &= add_new_tx(results[i].tx, results[i].hash, tx_blobs[i].blob, results[i].weight, tvc[i], tx_relay, relayed);
 
       if(tvc[i].m_verifivation_failed)
-      {MERROR_VER("Transaction verification failed: " << results[i].hash);}
+      {MERROR_VER("Transaction verification failed: " << results[i].hash); txes_rejected_metric.inc();}
       else if(tvc[i].m_verifivation_impossible)
       {MERROR_VER("Transaction verification impossible: " << results[i].hash);}
 
       if(tvc[i].m_added_to_pool)
       {
         MDEBUG("tx added: " << results[i].hash);
+        txes_added_metric.inc();
         valid_events = true;
       }
       else
         results[i].res = false;
     }
+    tx_admission_metric.observe(admission_timer.value() / 1000);
 
     if (valid_events && m_zmq_pub && matches_category(tx_relay, relay_category::legacy))
       m_zmq_pub(std::move(results));
+    if (valid_events)
+      notify_block_template_listener(false);
 
     return ok;
     CATCH_ENTRY_L0("core::handle_incoming_txs()", false);
@@ -1210,11 +1509,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
   {
-    spent.clear();
-    for(auto& ki: key_im)
-    {
-      spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
-    }
+    m_blockchain_storage.have_tx_keyimgs_as_spent(epee::to_span(key_im), spent);
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -1259,11 +1554,11 @@ namespace cryptonote
     return res;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
+  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_txes) const
   {
     spent.clear();
 
-    return m_mempool.check_for_key_images(key_im, spent);
+    return m_mempool.check_for_key_images(key_im, spent, include_sensitive_txes);
   }
   //-----------------------------------------------------------------------------------------------
   std::pair<boost::multiprecision::uint128_t, boost::multiprecision::uint128_t> core::get_coinbase_tx_sum(const uint64_t start_offset, const size_t count)
@@ -1470,6 +1765,8 @@ namespace cryptonote
 
     if (m_zmq_pub && matches_category(tx_relay, relay_category::legacy))
       notify_txpool_event(tx_blobs, epee::to_span(tx_hashes), epee::to_span(txs), just_broadcasted);
+    // txes only go in templates once they're public
+    notify_block_template_listener(false);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, uint64_t &seed_height, crypto::hash &seed_hash)
@@ -1640,6 +1937,34 @@ namespace cryptonote
     return success;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  bool core::prefetch_incoming_blocks_pow(uint64_t height, const std::vector<block_complete_entry> &blocks_entry)
+  {
+    try
+    {
+      return m_blockchain_storage.prefetch_incoming_blocks_pow(height, blocks_entry);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to prefetch PoW for blocks at height " << height << ": " << e.what());
+      return false;
+    }
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  bool core::queue_block_pow(const block &b)
+  {
+    try
+    {
+      return m_blockchain_storage.queue_block_pow(b);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to queue PoW for block " << get_block_hash(b) << ": " << e.what());
+      return false;
+    }
+  }
+
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, const block *b, block_verification_context& bvc, bool update_miner_blocktemplate)
   {
@@ -1707,6 +2032,22 @@ namespace cryptonote
     return m_mempool.get_transactions_count(include_sensitive_txes);
   }
   //-----------------------------------------------------------------------------------------------
+  void core::get_memory_usage(std::vector<tools::memory_usage> &usage) const
+  {
+    m_blockchain_storage.get_memory_usage(usage);
+    m_mempool.get_memory_usage(usage);
+
+    uint64_t caches, cache_bytes, dataset_bytes;
+    crypto::rx_get_memory_usage(&caches, &cache_bytes, &dataset_bytes);
+    usage.push_back({"randomx_caches", caches, cache_bytes});
+    usage.push_back({"randomx_dataset", dataset_bytes ? 1u : 0u, dataset_bytes});
+  }
+  //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pool_cookie() const
+  {
+    return m_mempool.cookie();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block_unlocked(const crypto::hash& id, int *where) const
   {
     return m_blockchain_storage.have_block_unlocked(id, where);
@@ -1739,12 +2080,23 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_pool_transaction_changes(uint64_t since, bool include_sensitive_data, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t& revision) const
+  {
+    return m_mempool.get_transaction_changes(since, include_sensitive_data, added, removed, revision);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_pool_transaction_stats(struct txpool_stats& stats, bool include_sensitive_data) const
   {
     m_mempool.get_transaction_stats(stats, include_sensitive_data);
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_pool_fee_rate_quantiles(const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles, bool include_sensitive_data) const
+  {
+    m_mempool.get_fee_rate_quantiles(percentiles, quantiles, include_sensitive_data);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_pool_transaction(const crypto::hash &id, cryptonote::blobdata& tx, relay_category tx_category) const
   {
     return m_mempool.get_transaction(id, tx, tx_category);
@@ -1818,7 +2170,10 @@ namespace cryptonote
     }
 
     relay_txpool_transactions(); // txpool handles periodic DB checking
-    m_check_updates_interval.do_call(boost::bind(&core::check_updates, this));
+    m_check_updates_interval.do_call([this](){
+      tools::threadpool::getInstanceForIO().submit(&m_dns_waiter, [this](){ check_updates(); });
+      return true;
+    });
     m_check_disk_space_interval.do_call(boost::bind(&core::check_disk_space, this));
     m_block_rate_interval.do_call(boost::bind(&core::check_block_rate, this));
     m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
@@ -33,6 +33,8 @@
 #include <ctime>
 
 #include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 
@@ -70,6 +72,7 @@ namespace cryptonote
   extern const command_line::arg_descriptor<difficulty_type> arg_fixed_difficulty;
   extern const command_line::arg_descriptor<bool> arg_offline;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
+  extern const command_line::arg_descriptor<size_t> arg_block_download_spill_size;
   extern const command_line::arg_descriptor<bool> arg_sync_pruned_blocks;
 
   /************************************************************************/
@@ -194,6 +197,20 @@ namespace cryptonote
       * @note see Blockchain::cleanup_handle_incoming_blocks
       */
      bool cleanup_handle_incoming_blocks(bool force_sync = false);
+
+     /**
+      * @copydoc Blockchain::prefetch_incoming_blocks_pow
+      *
+      * @note see Blockchain::prefetch_incoming_blocks_pow
+      */
+     bool prefetch_incoming_blocks_pow(uint64_t height, const std::vector<block_complete_entry> &blocks_entry);
+
+     /**
+      * @copydoc Blockchain::queue_block_pow
+      *
+      * @note see Blockchain::queue_block_pow
+      */
+     bool queue_block_pow(const block &b);
      	     	
      /**
       * @brief check the size of a block against the current maximum
@@ -471,6 +488,19 @@ namespace cryptonote
       */
      void set_txpool_listener(boost::function<void(std::vector<txpool_event>)> zmq_pub);
 
+     /**
+      * @brief set a listener for new block templates
+      *
+      * A template is built for every new top block, and again when txpool
+      * changes raise its expected reward. This happens on a thread of its
+      * own, not on the block or tx handling path.
+      *
+      * @param address the address the templates pay to
+      * @param reserve_size bytes reserved for the pool in the coinbase extra nonce
+      * @param listener callable to notify, or empty function to disable.
+      */
+     void set_block_template_listener(const account_public_address &address, size_t reserve_size, boost::function<void(const block_template_event&)> listener);
+
      /**
       * @brief set whether or not to enable or disable DNS checkpoints
       *
@@ -509,6 +539,13 @@ namespace cryptonote
       */
      bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_transaction_changes
+      *
+      * @note see tx_memory_pool::get_transaction_changes
+      */
+     bool get_pool_transaction_changes(uint64_t since, bool include_sensitive_txes, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t& revision) const;
+
      /**
       * @copydoc tx_memory_pool::get_transactions
       * @param include_sensitive_txes include private transactions
@@ -517,6 +554,14 @@ namespace cryptonote
       */
      bool get_pool_transaction_stats(struct txpool_stats& stats, bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_fee_rate_quantiles
+      * @param include_sensitive_txes include private transactions
+      *
+      * @note see tx_memory_pool::get_fee_rate_quantiles
+      */
+     bool get_pool_fee_rate_quantiles(const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles, bool include_sensitive_txes = false) const;
+
      /**
       * @copydoc tx_memory_pool::get_transaction
       *
@@ -547,6 +592,21 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count(bool include_sensitive_txes = false) const;
 
+     /**
+      * @brief reports the approximate memory held by the blockchain and pool
+      * caches, and by RandomX
+      *
+      * @param usage return-by-reference, one entry per cache is appended
+      */
+     void get_memory_usage(std::vector<tools::memory_usage> &usage) const;
+
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -729,12 +789,20 @@ namespace cryptonote
       * This function will check if enough time has passed since the last
       * time checkpoints were updated and tell the Blockchain to update
       * its checkpoints if it is time.  If updating checkpoints fails,
-      * the daemon is told to shut down.
+      * the daemon is told to shut down.  DNS checkpoints are fetched in
+      * the background, and applied when the lookup completes.
       *
       * @note see Blockchain::update_checkpoints()
       */
      bool update_checkpoints(const bool skip_dns = false);
 
+     /**
+      * @brief get the time the last DNS checkpoint lookup completed
+      *
+      * @return a unix timestamp, or 0 if no lookup has completed yet
+      */
+     uint64_t get_dns_checkpoints_time() const { return m_dns_checkpoints_time; }
+
      /**
       * @brief tells the daemon to wind down operations and stop running
       *
@@ -774,10 +842,11 @@ namespace cryptonote
       *
       * @param key_im list of key images to check
       * @param spent return-by-reference result for each image checked
+      * @param include_sensitive_txes include private transactions
       *
       * @return true
       */
-     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const;
+     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_txes = false) const;
 
      /**
       * @brief get the number of blocks to sync in one go
@@ -983,7 +1052,13 @@ namespace cryptonote
      bool check_tx_semantic(const transaction& tx, bool keeped_by_block) const;
      void set_semantics_failed(const crypto::hash &tx_hash);
 
-     bool handle_incoming_tx_pre(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash);
+     /**
+      * @brief cheap checks on an incoming tx, which is only parsed if its hash can't be found from a transaction_view
+      *
+      * @param parsed set to whether tx was parsed, parse_incoming_tx must be called before using it otherwise
+      */
+     bool handle_incoming_tx_pre(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, bool &parsed);
+     bool parse_incoming_tx(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash);
      bool handle_incoming_tx_post(const tx_blob_entry& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash);
      struct tx_verification_batch_info { const cryptonote::transaction *tx; crypto::hash tx_hash; tx_verification_context &tvc; bool &result; };
      bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block);
@@ -1116,6 +1191,8 @@ namespace cryptonote
      time_t m_last_json_checkpoints_update; //!< time when json checkpoints were last updated
 
      std::atomic_flag m_checkpoints_updating; //!< set if checkpoints are currently updating to avoid multiple threads attempting to update at once
+     std::atomic<uint64_t> m_dns_checkpoints_time; //!< time when the last background DNS checkpoint lookup finished, 0 if none did
+     tools::threadpool::waiter m_dns_waiter; //!< background DNS checkpoint and update lookups
      bool m_disable_dns_checkpoints;
 
      size_t block_sync_size;
@@ -1145,6 +1222,37 @@ namespace cryptonote
 
      std::shared_ptr<tools::Notify> m_block_rate_notify;
      boost::function<void(std::vector<txpool_event>)> m_zmq_pub;
+
+     /**
+      * @brief wakes the block template thread
+      *
+      * @param new_block true for a new top block, false for a txpool change
+      */
+     void notify_block_template_listener(bool new_block);
+
+     /**
+      * @brief builds templates for the block template listener until stopped
+      */
+     void block_template_worker();
+
+     /**
+      * @brief builds a block template for the block template listener
+      *
+      * @return false if the template or its reserved offset could not be made
+      */
+     bool make_block_template_event(block_template_event &event);
+
+     boost::function<void(const block_template_event&)> m_block_template_listener;
+     account_public_address m_block_template_address;
+     size_t m_block_template_reserve_size;
+     boost::mutex m_block_template_mutex;
+     boost::condition_variable m_block_template_cond;
+     bool m_block_template_pending; //!< a template needs building
+     bool m_block_template_new_block; //!< the pending template is for a new top block
+     bool m_block_template_stop;
+     boost::thread m_block_template_thread;
+
+     boost::thread m_txpool_validation_thread; //!< re-validates the txpool after startup
    };
 }
 
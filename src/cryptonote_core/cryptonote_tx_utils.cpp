@@ -35,6 +35,7 @@
 using namespace epee;
 
 #include "common/apply_permutation.h"
+#include "common/threadpool.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_config.h"
 #include "blockchain.h"
@@ -203,6 +204,24 @@ namespace cryptonote
     return addr.m_view_public_key;
   }
   //---------------------------------------------------------------
+  // runs f on 0..n-1, on the compute threadpool for software devices, since
+  // hardware devices need their calls in order
+  template<typename F>
+  static bool for_each_tx_element(hw::device &hwdev, size_t n, const F &f)
+  {
+    if (hwdev.get_type() != hw::device::device_type::SOFTWARE || n < 4)
+    {
+      for (size_t i = 0; i < n; ++i)
+        f(i);
+      return true;
+    }
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (size_t i = 0; i < n; ++i)
+      tpool.submit(&waiter, [&f, i](){ f(i); }, true);
+    return waiter.wait();
+  }
+  //---------------------------------------------------------------
   bool construct_tx_with_tx_key(const account_keys& sender_account_keys, const std::unordered_map<crypto::public_key, subaddress_index>& subaddresses, std::vector<tx_source_entry>& sources, std::vector<tx_destination_entry>& destinations, const boost::optional<cryptonote::account_public_address>& change_addr, const std::vector<uint8_t> &extra, transaction& tx, uint64_t unlock_time, const crypto::secret_key &tx_key, const std::vector<crypto::secret_key> &additional_tx_keys, bool rct, const rct::RCTConfig &rct_config, bool shuffle_outs, bool use_view_tags)
   {
     hw::device &hwdev = sender_account_keys.get_device();
@@ -306,28 +325,37 @@ namespace cryptonote
     std::vector<input_generation_context_data> in_contexts;
 
     uint64_t summary_inputs_money = 0;
-    //fill inputs
-    int idx = -1;
     for(const tx_source_entry& src_entr:  sources)
     {
-      ++idx;
       if(src_entr.real_output >= src_entr.outputs.size())
       {
         LOG_ERROR("real_output index (" << src_entr.real_output << ")bigger than output_keys.size()=" << src_entr.outputs.size());
         return false;
       }
       summary_inputs_money += src_entr.amount;
+    }
 
-      //key_derivation recv_derivation;
-      in_contexts.push_back(input_generation_context_data());
-      keypair& in_ephemeral = in_contexts.back().in_ephemeral;
-      crypto::key_image img;
+    // key images are independent of each other
+    in_contexts.resize(sources.size());
+    std::vector<crypto::key_image> key_images(sources.size());
+    std::unique_ptr<bool[]> key_image_ok(new bool[sources.size()]());
+    const bool key_images_done = for_each_tx_element(hwdev, sources.size(), [&](size_t i) {
+      const tx_source_entry& src_entr = sources[i];
       const auto& out_key = reinterpret_cast<const crypto::public_key&>(src_entr.outputs[src_entr.real_output].second.dest);
-      if(!generate_key_image_helper(sender_account_keys, subaddresses, out_key, src_entr.real_out_tx_key, src_entr.real_out_additional_tx_keys, src_entr.real_output_in_tx_index, in_ephemeral,img, hwdev))
+      key_image_ok[i] = generate_key_image_helper(sender_account_keys, subaddresses, out_key, src_entr.real_out_tx_key, src_entr.real_out_additional_tx_keys, src_entr.real_output_in_tx_index, in_contexts[i].in_ephemeral, key_images[i], hwdev);
+    });
+
+    //fill inputs
+    int idx = -1;
+    for(const tx_source_entry& src_entr:  sources)
+    {
+      ++idx;
+      if(!key_images_done || !key_image_ok[idx])
       {
         LOG_ERROR("Key image generation failed!");
         return false;
       }
+      const keypair& in_ephemeral = in_contexts[idx].in_ephemeral;
 
       //check that derivated key is equal with real output key
       if(!(in_ephemeral.pub == src_entr.outputs[src_entr.real_output].second.dest) )
@@ -343,7 +371,7 @@ namespace cryptonote
       //put key image into tx input
       txin_to_key input_to_key;
       input_to_key.amount = src_entr.amount;
-      input_to_key.k_image = img;
+      input_to_key.k_image = key_images[idx];
 
       //fill outputs array and use relative offsets
       for(const tx_source_entry::output_entry& out_entry: src_entr.outputs)
@@ -401,25 +429,40 @@ namespace cryptonote
       CHECK_AND_ASSERT_MES(destinations.size() == additional_tx_keys.size(), false, "Wrong amount of additional tx keys");
 
     uint64_t summary_outs_money = 0;
-    //fill outputs
-    size_t output_index = 0;
     for(const tx_destination_entry& dst_entr: destinations)
     {
       CHECK_AND_ASSERT_MES(dst_entr.amount > 0 || tx.version > 1, false, "Destination with wrong amount: " << dst_entr.amount);
+      summary_outs_money += dst_entr.amount;
+    }
+
+    // each output gets its own keys, which are then gathered in output order
+    struct output_generation_context_data
+    {
       crypto::public_key out_eph_public_key;
       crypto::view_tag view_tag;
-
+      std::vector<crypto::public_key> additional_tx_public_keys;
+      std::vector<rct::key> amount_keys;
+    };
+    std::vector<output_generation_context_data> out_contexts(destinations.size());
+    const bool outputs_done = for_each_tx_element(hwdev, destinations.size(), [&](size_t output_index) {
+      output_generation_context_data &ctx = out_contexts[output_index];
       hwdev.generate_output_ephemeral_keys(tx.version,sender_account_keys, txkey_pub, tx_key,
-                                           dst_entr, change_addr, output_index,
+                                           destinations[output_index], change_addr, output_index,
                                            need_additional_txkeys, additional_tx_keys,
-                                           additional_tx_public_keys, amount_keys, out_eph_public_key,
-                                           use_view_tags, view_tag);
+                                           ctx.additional_tx_public_keys, ctx.amount_keys, ctx.out_eph_public_key,
+                                           use_view_tags, ctx.view_tag);
+    });
+    CHECK_AND_ASSERT_MES(outputs_done, false, "Failed to generate output keys");
 
+    //fill outputs
+    for (size_t output_index = 0; output_index < destinations.size(); ++output_index)
+    {
+      output_generation_context_data &ctx = out_contexts[output_index];
       tx_out out;
-      cryptonote::set_tx_out(dst_entr.amount, out_eph_public_key, use_view_tags, view_tag, out);
+      cryptonote::set_tx_out(destinations[output_index].amount, ctx.out_eph_public_key, use_view_tags, ctx.view_tag, out);
       tx.vout.push_back(out);
-      output_index++;
-      summary_outs_money += dst_entr.amount;
+      additional_tx_public_keys.insert(additional_tx_public_keys.end(), ctx.additional_tx_public_keys.begin(), ctx.additional_tx_public_keys.end());
+      amount_keys.insert(amount_keys.end(), ctx.amount_keys.begin(), ctx.amount_keys.end());
     }
     CHECK_AND_ASSERT_MES(additional_tx_public_keys.size() == additional_tx_keys.size(), false, "Internal error creating additional public keys");
 
@@ -44,8 +44,11 @@
 #include "misc_language.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "common/metrics.h"
 #include "crypto/hash.h"
 #include "crypto/duration.h"
+#include "common/threadpool.h"
+#include "ringct/rctSigs.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "txpool"
@@ -95,6 +98,14 @@ namespace cryptonote
 
     constexpr const std::chrono::seconds forward_delay_average{CRYPTONOTE_FORWARD_DELAY_AVERAGE};
 
+    //! Most read index changes kept for get_transaction_changes
+    constexpr const size_t max_pool_changes = 16384;
+
+    tools::metrics::gauge embargoed_metric("monero_txpool_embargoed_transactions", "Stem and forward txes waiting on their relay timer, as of the last relay check", {}, true);
+
+    //! txes re-validated per lock acquisition when validating the pool
+    constexpr const size_t VALIDATE_BATCH_SIZE = 100;
+
     // a kind of increasing backoff within min/max bounds
     uint64_t get_relay_delay(time_t last_relay, time_t received)
     {
@@ -104,6 +115,12 @@ namespace cryptonote
       return d;
     }
 
+    // txes received longer ago than their livetime are removed as stuck
+    time_t get_tx_expiry(time_t receive_time, bool kept_by_block)
+    {
+      return receive_time + (kept_by_block ? CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME : CRYPTONOTE_MEMPOOL_TX_LIVETIME);
+    }
+
     uint64_t template_accept_threshold(uint64_t amount)
     {
       return amount * ACCEPT_THRESHOLD;
@@ -124,11 +141,50 @@ namespace cryptonote
       if (candidate < next_check.load(std::memory_order_relaxed))
         next_check = candidate;
     }
+
+    // for caches which only save work: makes room by dropping an arbitrary entry
+    template<typename M, typename V>
+    void insert_capped(M &cache, size_t max_entries, const crypto::hash &key, V &&value)
+    {
+      if (max_entries && cache.size() >= max_entries && cache.find(key) == cache.end())
+        cache.erase(cache.begin());
+      cache.insert(std::make_pair(key, std::forward<V>(value)));
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void get_fee_rate_quantiles(const std::map<uint64_t, txpool_histo> &by_fee_rate, const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles)
+  {
+    quantiles.txs = 0;
+    quantiles.bytes = 0;
+    for (const auto &e: by_fee_rate)
+    {
+      quantiles.txs += e.second.txs;
+      quantiles.bytes += e.second.bytes;
+    }
+
+    quantiles.fee_rates.clear();
+    quantiles.fee_rates.reserve(percentiles.size());
+    for (const uint32_t percentile: percentiles)
+    {
+      // at least one byte, so the 0th percentile is the lowest fee rate
+      const uint64_t target = std::max<uint64_t>((quantiles.bytes * std::min<uint32_t>(percentile, 100) + 99) / 100, 1);
+      uint64_t cumulative = 0, fee_rate = 0;
+      for (const auto &e: by_fee_rate)
+      {
+        fee_rate = e.first;
+        cumulative += e.second.bytes;
+        if (cumulative >= target)
+          break;
+      }
+      quantiles.fee_rates.push_back(fee_rate);
+    }
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_next_check(std::time(nullptr))
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_validation_stop(false), m_cache_max_entries(DEFAULT_TXPOOL_CACHE_MAX_ENTRIES), m_next_check(std::time(nullptr)), m_pool_revision(0)
   {
+    m_template_candidates_top = crypto::null_hash;
+
     // class code expects unsigned values throughout
     if (m_next_check < time_t(0))
       throw std::runtime_error{"Unexpected time_t (system clock) value"};
@@ -141,7 +197,7 @@ namespace cryptonote
     // this should already be called with that lock, but let's make it explicit for clarity
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
-    PERF_TIMER(add_tx);
+    PERF_TIMER_AGG(add_tx);
     if (tx.version == 0)
     {
       // v0 never accepted
@@ -269,19 +325,21 @@ namespace cryptonote
         meta.double_spend_seen = have_tx_keyimges_as_spent(tx, id);
         meta.pruned = tx.pruned;
         meta.bf_padding = 0;
+        meta.validated_version = 0; // inputs did not check out, so look again next time
         memset(meta.padding, 0, sizeof(meta.padding));
         try
         {
           if (kept_by_block)
-            m_parsed_tx_cache.insert(std::make_pair(id, tx));
+            insert_capped(m_parsed_tx_cache, m_cache_max_entries, id, tx);
           CRITICAL_REGION_LOCAL1(m_blockchain);
-          LockedTXN lock(m_blockchain.get_db());
+          LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
           if (!insert_key_images(tx, id, tx_relay))
             return false;
 
           m_blockchain.add_txpool_tx(id, blob, meta);
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
+          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id, get_tx_expiry(receive_time, true));
           lock.commit();
+          index_tx(id, meta);
         }
         catch (const std::exception &e)
         {
@@ -302,9 +360,9 @@ namespace cryptonote
       try
       {
         if (kept_by_block)
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
+          insert_capped(m_parsed_tx_cache, m_cache_max_entries, id, tx);
         CRITICAL_REGION_LOCAL1(m_blockchain);
-        LockedTXN lock(m_blockchain.get_db());
+        LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
 
         const bool existing_tx = m_blockchain.get_txpool_tx_meta(id, meta);
         if (existing_tx)
@@ -344,6 +402,7 @@ namespace cryptonote
           meta.double_spend_seen = false;
           meta.pruned = tx.pruned;
           meta.bf_padding = 0;
+          meta.validated_version = version;
           memset(meta.padding, 0, sizeof(meta.padding));
 
           if (!insert_key_images(tx, id, tx_relay))
@@ -351,9 +410,10 @@ namespace cryptonote
 
           m_blockchain.remove_txpool_tx(id);
           m_blockchain.add_txpool_tx(id, blob, meta);
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id);
+          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)(tx_weight ? tx_weight : 1), receive_time), id, get_tx_expiry(receive_time, meta.kept_by_block));
         }
         lock.commit();
+        index_tx(id, meta);
       }
       catch (const std::exception &e)
       {
@@ -401,6 +461,45 @@ namespace cryptonote
     m_txpool_max_weight = bytes;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::set_cache_max_entries(size_t entries)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_cache_max_entries = entries;
+    while (m_cache_max_entries && m_input_cache.size() > m_cache_max_entries)
+      m_input_cache.erase(m_input_cache.begin());
+    while (m_cache_max_entries && m_parsed_tx_cache.size() > m_cache_max_entries)
+      m_parsed_tx_cache.erase(m_parsed_tx_cache.begin());
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_memory_usage(std::vector<tools::memory_usage> &usage) const
+  {
+    using namespace tools::memory;
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+
+    uint64_t entries = 0, bytes = hash_container_bytes(m_spent_key_images);
+    for (const auto &e: m_spent_key_images)
+    {
+      entries += e.second.size();
+      bytes += hash_container_bytes(e.second);
+    }
+    usage.push_back({"txpool_spent_key_images", m_spent_key_images.size(), bytes});
+    usage.push_back({"txpool_relay_index", m_tx_relay_index.size(), hash_container_bytes(m_tx_relay_index)});
+    usage.push_back({"txpool_by_fee", m_txs_by_fee_and_receive_time.size(), m_txs_by_fee_and_receive_time.memory_bytes()});
+
+    bytes = hash_container_bytes(m_template_candidates);
+    for (const auto &e: m_template_candidates)
+      bytes += vector_bytes(e.second.key_images);
+    usage.push_back({"txpool_template_candidates", m_template_candidates.size(), bytes});
+
+    usage.push_back({"txpool_timed_out", m_timed_out_transactions.size(), hash_container_bytes(m_timed_out_transactions)});
+    usage.push_back({"txpool_input_cache", m_input_cache.size(), hash_container_bytes(m_input_cache)});
+
+    bytes = hash_container_bytes(m_parsed_tx_cache);
+    for (const auto &e: m_parsed_tx_cache)
+      bytes += get_transaction_memory_usage(e.second) - sizeof(transaction);
+    usage.push_back({"txpool_parsed_tx_cache", m_parsed_tx_cache.size(), bytes});
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::reduce_txpool_weight(size_t weight)
   {
     if (weight > m_txpool_weight)
@@ -420,8 +519,9 @@ namespace cryptonote
     if (bytes == 0)
       bytes = m_txpool_max_weight;
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    LockedTXN lock(m_blockchain.get_db());
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
     bool changed = false;
+    std::vector<crypto::hash> pruned;
 
     // this will never remove the first one, but we don't care
     auto it = --m_txs_by_fee_and_receive_time.end();
@@ -450,29 +550,23 @@ namespace cryptonote
           --it;
           continue;
         }
-        cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
-        cryptonote::transaction_prefix tx;
-        if (!parse_and_validate_tx_prefix_from_blob(txblob, tx))
-        {
-          MERROR("Failed to parse tx from txpool");
-          return;
-        }
-        // remove first, in case this throws, so key images aren't removed
         MINFO("Pruning tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
-        m_blockchain.remove_txpool_tx(txid);
-        reduce_txpool_weight(meta.weight);
-        remove_transaction_keyimages(tx, txid);
+        if (!evict_tx(txid, meta.weight))
+          break;
         MINFO("Pruned tx " << txid << " from txpool: weight: " << meta.weight << ", fee/byte: " << it->first.first);
+        pruned.push_back(txid);
         m_txs_by_fee_and_receive_time.erase(it--);
         changed = true;
       }
       catch (const std::exception &e)
       {
         MERROR("Error while pruning txpool: " << e.what());
-        return;
+        break;
       }
     }
     lock.commit();
+    for (const crypto::hash &txid: pruned)
+      unindex_tx(txid);
     if (changed)
       ++m_cookie;
     if (m_txpool_weight > bytes)
@@ -481,6 +575,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::insert_key_images(const transaction_prefix &tx, const crypto::hash &id, relay_method tx_relay)
   {
+    boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, txin, false);
@@ -514,6 +609,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
     // ND: Speedup
     for(const txin_v& vi: tx.vin)
     {
@@ -549,7 +645,7 @@ namespace cryptonote
 
     try
     {
-      LockedTXN lock(m_blockchain.get_db());
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
       txpool_tx_meta_t meta;
       if (!m_blockchain.get_txpool_tx_meta(id, meta))
       {
@@ -583,6 +679,7 @@ namespace cryptonote
       reduce_txpool_weight(tx_weight);
       remove_transaction_keyimages(tx, id);
       lock.commit();
+      unindex_tx(id);
     }
     catch (const std::exception &e)
     {
@@ -604,7 +701,7 @@ namespace cryptonote
 
     try
     {
-      LockedTXN lock(m_blockchain.get_db());
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
       txpool_tx_meta_t meta;
       if (!m_blockchain.get_txpool_tx_meta(txid, meta))
       {
@@ -685,15 +782,29 @@ namespace cryptonote
   void tx_memory_pool::on_idle()
   {
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
+    if (!m_blockchain.txpool_in_db())
+      m_snapshot_interval.do_call([this](){return store_snapshot();});
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::store_snapshot()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    try
+    {
+      const size_t written = m_blockchain.flush_txpool_store();
+      if (written)
+        MDEBUG("Saved " << written << " txpool changes");
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to save txpool changes: " << e.what());
+    }
+    return true;
   }
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
-    return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
-                       , [&](const sorted_tx_container::value_type& a){
-                         return a.second == id;
-                       }
-    );
+    return m_txs_by_fee_and_receive_time.find(id);
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -701,61 +812,55 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    std::list<std::pair<crypto::hash, uint64_t>> remove;
-    m_blockchain.for_all_txpool_txes([this, &remove](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
-      uint64_t tx_age = time(nullptr) - meta.receive_time;
-
-      if((tx_age > CRYPTONOTE_MEMPOOL_TX_LIVETIME && !meta.kept_by_block) ||
-         (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && meta.kept_by_block) )
-      {
-        LOG_PRINT_L1("Tx " << txid << " removed from tx pool due to outdated, age: " << tx_age );
-        auto sorted_it = find_tx_in_sorted_container(txid);
-        if (sorted_it == m_txs_by_fee_and_receive_time.end())
-        {
-          LOG_PRINT_L1("Removing tx " << txid << " from tx pool, but it was not found in the sorted txs container!");
-        }
-        else
-        {
-          m_txs_by_fee_and_receive_time.erase(sorted_it);
-        }
-        m_timed_out_transactions.insert(txid);
-        remove.push_back(std::make_pair(txid, meta.weight));
-      }
+    const time_t now = time(nullptr);
+    const std::vector<crypto::hash> expired = m_txs_by_fee_and_receive_time.get_expired(now);
+    if (expired.empty())
       return true;
-    }, false, relay_category::all);
 
-    if (!remove.empty())
+    std::vector<crypto::hash> removed;
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
+    for (const crypto::hash &txid: expired)
     {
-      LockedTXN lock(m_blockchain.get_db());
-      for (const std::pair<crypto::hash, uint64_t> &entry: remove)
+      m_txs_by_fee_and_receive_time.erase(txid);
+      m_timed_out_transactions.insert(txid);
+      try
       {
-        const crypto::hash &txid = entry.first;
-        try
-        {
-          cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
-          cryptonote::transaction_prefix tx;
-          if (!parse_and_validate_tx_prefix_from_blob(bd, tx))
-          {
-            MERROR("Failed to parse tx from txpool");
-            // continue
-          }
-          else
-          {
-            // remove first, so we only remove key images if the tx removal succeeds
-            m_blockchain.remove_txpool_tx(txid);
-            reduce_txpool_weight(entry.second);
-            remove_transaction_keyimages(tx, txid);
-          }
-        }
-        catch (const std::exception &e)
+        txpool_tx_meta_t meta;
+        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
         {
-          MWARNING("Failed to remove stuck transaction: " << txid);
-          // ignore error
+          MWARNING("Stuck tx " << txid << " not found in txpool");
+          continue;
         }
+        LOG_PRINT_L1("Tx " << txid << " removed from tx pool due to outdated, age: " << now - meta.receive_time);
+        if (evict_tx(txid, meta.weight))
+          removed.push_back(txid);
+      }
+      catch (const std::exception &e)
+      {
+        MWARNING("Failed to remove stuck transaction: " << txid);
+        // ignore error
       }
-      lock.commit();
-      ++m_cookie;
     }
+    lock.commit();
+    for (const crypto::hash &txid: removed)
+      unindex_tx(txid);
+    ++m_cookie;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::evict_tx(const crypto::hash &txid, uint64_t weight)
+  {
+    cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
+    cryptonote::transaction_prefix tx;
+    if (!parse_and_validate_tx_prefix_from_blob(txblob, tx))
+    {
+      MERROR("Failed to parse tx from txpool");
+      return false;
+    }
+    // remove first, in case this throws, so key images aren't removed
+    m_blockchain.remove_txpool_tx(txid);
+    reduce_txpool_weight(weight);
+    remove_transaction_keyimages(tx, txid);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -770,14 +875,15 @@ namespace cryptonote
 
     uint64_t next_check = clock::to_time_t(clock::from_time_t(time_t(now)) + max_relayable_check);
     std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> change_timestamps;
+    std::size_t embargoed = 0;
 
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    LockedTXN lock(m_blockchain.get_db());
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
     txs.reserve(m_blockchain.get_txpool_tx_count());
-    m_blockchain.for_all_txpool_txes([this, now, &txs, &change_timestamps, &next_check](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *){
-      // 0 fee transactions are never relayed
-      if(!meta.pruned && meta.fee > 0 && !meta.do_not_relay)
+    m_blockchain.for_all_txpool_txes([this, now, &txs, &change_timestamps, &next_check, &embargoed](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *){
+      // 0 fee transactions are never relayed, nor those not re-validated yet
+      if(!meta.pruned && meta.fee > 0 && !meta.do_not_relay && !m_pending_validation.count(txid))
       {
         const relay_method tx_relay = meta.get_relay_method();
         switch (tx_relay)
@@ -787,6 +893,7 @@ namespace cryptonote
             if (meta.last_relayed_time > now)
             {
               next_check = std::min(next_check, meta.last_relayed_time);
+              ++embargoed;
               return true; // continue to next tx
             }
             change_timestamps.emplace_back(txid, meta);
@@ -835,6 +942,7 @@ namespace cryptonote
     }
 
     m_next_check = time_t(next_check);
+    embargoed_metric.set(embargoed);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -846,9 +954,10 @@ namespace cryptonote
     const auto now = std::chrono::system_clock::now();
     uint64_t next_relay = uint64_t{std::numeric_limits<time_t>::max()};
 
+    std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> upgraded;
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    LockedTXN lock(m_blockchain.get_db());
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
     for (const auto& hash : hashes)
     {
       bool was_just_broadcasted = false;
@@ -871,6 +980,7 @@ namespace cryptonote
             meta.last_relayed_time = std::chrono::system_clock::to_time_t(now);
 
           m_blockchain.update_txpool_tx(hash, meta);
+          upgraded.emplace_back(hash, meta);
 
           // wait until db update succeeds to ensure tx is visible in the pool
           was_just_broadcasted = !already_broadcasted && meta.matches(relay_category::broadcasted);
@@ -884,6 +994,8 @@ namespace cryptonote
       just_broadcasted.emplace_back(was_just_broadcasted);
     }
     lock.commit();
+    for (const auto &e: upgraded)
+      index_tx(e.first, e.second);
     set_if_less(m_next_check, time_t(next_relay));
   }
   //---------------------------------------------------------------------------------
@@ -916,14 +1028,12 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
-    txs.reserve(m_blockchain.get_txpool_tx_count(include_sensitive));
-    m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd){
-      txs.push_back(txid);
-      return true;
-    }, false, category);
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    txs.reserve(txs.size() + m_tx_relay_index.size());
+    for (const auto &e: m_tx_relay_index)
+      if (matches_category(e.second.relay, category))
+        txs.push_back(e.first);
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_backlog(std::vector<tx_backlog_entry>& backlog, bool include_sensitive) const
@@ -1002,88 +1112,15 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     const uint64_t now = time(NULL);
-    const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
-    std::map<uint64_t, txpool_histo> agebytes;
-    stats.txs_total = m_blockchain.get_txpool_tx_count(include_sensitive);
-    std::vector<uint32_t> weights;
-    weights.reserve(stats.txs_total);
-    m_blockchain.for_all_txpool_txes([&stats, &weights, now, &agebytes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd){
-      weights.push_back(meta.weight);
-      stats.bytes_total += meta.weight;
-      if (!stats.bytes_min || meta.weight < stats.bytes_min)
-        stats.bytes_min = meta.weight;
-      if (meta.weight > stats.bytes_max)
-        stats.bytes_max = meta.weight;
-      if (!meta.relayed)
-        stats.num_not_relayed++;
-      stats.fee_total += meta.fee;
-      if (!stats.oldest || meta.receive_time < stats.oldest)
-        stats.oldest = meta.receive_time;
-      if (meta.receive_time < now - 600)
-        stats.num_10m++;
-      if (meta.last_failed_height)
-        stats.num_failing++;
-      uint64_t age = now - meta.receive_time + (now == meta.receive_time);
-      agebytes[age].txs++;
-      agebytes[age].bytes += meta.weight;
-      if (meta.double_spend_seen)
-        ++stats.num_double_spends;
-      return true;
-    }, false, category);
-
-    stats.bytes_med = epee::misc_utils::median(weights);
-    if (stats.txs_total > 1)
-    {
-      /* looking for 98th percentile */
-      size_t end = stats.txs_total * 0.02;
-      uint64_t delta, factor;
-      std::map<uint64_t, txpool_histo>::iterator it, i2;
-      if (end)
-      {
-        /* If enough txs, spread the first 98% of results across
-         * the first 9 bins, drop final 2% in last bin.
-         */
-        it = agebytes.end();
-        size_t cumulative_num = 0;
-        /* Since agebytes is not empty and end is nonzero, the
-         * below loop can always run at least once.
-         */
-        do {
-          --it;
-          cumulative_num += it->second.txs;
-        } while (it != agebytes.begin() && cumulative_num < end);
-        stats.histo_98pc = it->first;
-        factor = 9;
-        delta = it->first;
-        stats.histo.resize(10);
-      } else
-      {
-        /* If not enough txs, don't reserve the last slot;
-         * spread evenly across all 10 bins.
-         */
-        stats.histo_98pc = 0;
-        it = agebytes.end();
-        factor = stats.txs_total > 9 ? 10 : stats.txs_total;
-        delta = now - stats.oldest;
-        stats.histo.resize(factor);
-      }
-      if (!delta)
-        delta = 1;
-      for (i2 = agebytes.begin(); i2 != it; i2++)
-      {
-        size_t i = (i2->first * factor - 1) / delta;
-        stats.histo[i].txs += i2->second.txs;
-        stats.histo[i].bytes += i2->second.bytes;
-      }
-      for (; i2 != agebytes.end(); i2++)
-      {
-        stats.histo[factor].txs += i2->second.txs;
-        stats.histo[factor].bytes += i2->second.bytes;
-      }
-    }
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    (include_sensitive ? m_all_totals : m_broadcasted_totals).get(stats, now);
+  }
+  //------------------------------------------------------------------
+  void tx_memory_pool::get_fee_rate_quantiles(const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles, bool include_sensitive) const
+  {
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    cryptonote::get_fee_rate_quantiles((include_sensitive ? m_all_totals : m_broadcasted_totals).get_by_fee_rate(), percentiles, quantiles);
   }
   //------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -1193,12 +1230,13 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const
+  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    const relay_category category = include_sensitive ? relay_category::all : relay_category::broadcasted;
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
 
     spent.clear();
+    spent.reserve(key_images.size());
 
     for (const auto& image : key_images)
     {
@@ -1207,7 +1245,11 @@ namespace cryptonote
       if (found != m_spent_key_images.end())
       {
         for (const crypto::hash& tx_hash : found->second)
-          is_spent |= m_blockchain.txpool_tx_matches_category(tx_hash, relay_category::broadcasted);
+        {
+          // spenders not yet (or no longer) in the index are not committed to the pool
+          const auto relay = m_tx_relay_index.find(tx_hash);
+          is_spent |= relay != m_tx_relay_index.end() && matches_category(relay->second.relay, category);
+        }
       }
       spent.push_back(is_spent);
     }
@@ -1247,9 +1289,281 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const crypto::hash &id, relay_category tx_category) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
-    return m_blockchain.get_db().txpool_has_tx(id, tx_category);
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    const auto it = m_tx_relay_index.find(id);
+    return it != m_tx_relay_index.end() && matches_category(it->second.relay, tx_category);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::index_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
+  {
+    if (m_deferred_index)
+    {
+      (*m_deferred_index)[txid] = meta;
+      return;
+    }
+    const tx_index_entry_t entry{meta.get_relay_method(), uint32_t(meta.weight), meta.fee, meta.receive_time,
+        bool(meta.relayed), meta.last_failed_height != 0, bool(meta.double_spend_seen)};
+    const bool broadcasted = matches_category(entry.relay, relay_category::broadcasted);
+    boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    const auto it = m_tx_relay_index.find(txid);
+    if (it == m_tx_relay_index.end())
+    {
+      m_tx_relay_index.emplace(txid, entry);
+      m_all_totals.add(entry);
+      if (broadcasted)
+        m_broadcasted_totals.add(entry);
+      log_pool_change(txid, true, broadcasted);
+      return;
+    }
+    const bool was_broadcasted = matches_category(it->second.relay, relay_category::broadcasted);
+    // relay methods only upgrade, so a tx can only become public here
+    if (broadcasted && !was_broadcasted)
+      log_pool_change(txid, true, true);
+    m_all_totals.remove(it->second);
+    if (was_broadcasted)
+      m_broadcasted_totals.remove(it->second);
+    it->second = entry;
+    m_all_totals.add(entry);
+    if (broadcasted)
+      m_broadcasted_totals.add(entry);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::unindex_tx(const crypto::hash &txid)
+  {
+    m_template_candidates.erase(txid);
+    if (m_deferred_index)
+    {
+      (*m_deferred_index)[txid] = boost::none;
+      return;
+    }
+    boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    const auto it = m_tx_relay_index.find(txid);
+    if (it == m_tx_relay_index.end())
+      return;
+    const bool broadcasted = matches_category(it->second.relay, relay_category::broadcasted);
+    log_pool_change(txid, false, broadcasted);
+    m_all_totals.remove(it->second);
+    if (broadcasted)
+      m_broadcasted_totals.remove(it->second);
+    m_tx_relay_index.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::apply_deferred_index(bool committed)
+  {
+    std::unique_ptr<std::unordered_map<crypto::hash, boost::optional<txpool_tx_meta_t>>> deferred = std::move(m_deferred_index);
+    if (!deferred || !committed)
+      return;
+    for (const auto &e: *deferred)
+    {
+      if (e.second)
+        index_tx(e.first, *e.second);
+      else
+        unindex_tx(e.first);
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::pool_totals_t::add(const tx_index_entry_t &e)
+  {
+    m_bytes_total += e.weight;
+    m_fee_total += e.fee;
+    m_num_not_relayed += !e.relayed;
+    m_num_failing += e.failing;
+    m_num_double_spends += e.double_spend_seen;
+    txpool_histo &bucket = m_by_receive_time[e.receive_time];
+    bucket.txs++;
+    bucket.bytes += e.weight;
+    txpool_histo &fee_bucket = m_by_fee_rate[e.fee / std::max<uint32_t>(e.weight, 1)];
+    fee_bucket.txs++;
+    fee_bucket.bytes += e.weight;
+
+    // equal weights go after the existing ones, keep m_median at index (size-1)/2
+    const size_t n = m_weights.size();
+    const auto inserted = m_weights.insert(e.weight);
+    if (n == 0)
+      m_median = inserted;
+    else if (e.weight < *m_median)
+    {
+      if (n % 2)
+        --m_median;
+    }
+    else if (n % 2 == 0)
+      ++m_median;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::pool_totals_t::remove(const tx_index_entry_t &e)
+  {
+    m_bytes_total -= e.weight;
+    m_fee_total -= e.fee;
+    m_num_not_relayed -= !e.relayed;
+    m_num_failing -= e.failing;
+    m_num_double_spends -= e.double_spend_seen;
+    const auto bucket = m_by_receive_time.find(e.receive_time);
+    if (bucket != m_by_receive_time.end())
+    {
+      bucket->second.bytes -= e.weight;
+      if (--bucket->second.txs == 0)
+        m_by_receive_time.erase(bucket);
+    }
+    const auto fee_bucket = m_by_fee_rate.find(e.fee / std::max<uint32_t>(e.weight, 1));
+    if (fee_bucket != m_by_fee_rate.end())
+    {
+      fee_bucket->second.bytes -= e.weight;
+      if (--fee_bucket->second.txs == 0)
+        m_by_fee_rate.erase(fee_bucket);
+    }
+
+    const size_t n = m_weights.size();
+    if (n <= 1)
+    {
+      m_weights.clear();
+      m_median = m_weights.end();
+      return;
+    }
+    if (e.weight == *m_median)
+    {
+      const auto erased = m_median;
+      if (n % 2)
+        --m_median;
+      else
+        ++m_median;
+      m_weights.erase(erased);
+      return;
+    }
+    const auto found = m_weights.find(e.weight);
+    if (found == m_weights.end())
+      return;
+    m_weights.erase(found);
+    if (e.weight < *m_median)
+    {
+      if (n % 2 == 0)
+        ++m_median;
+    }
+    else if (n % 2)
+      --m_median;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::pool_totals_t::clear()
+  {
+    m_bytes_total = 0;
+    m_fee_total = 0;
+    m_num_not_relayed = 0;
+    m_num_failing = 0;
+    m_num_double_spends = 0;
+    m_weights.clear();
+    m_median = m_weights.end();
+    m_by_receive_time.clear();
+    m_by_fee_rate.clear();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::pool_totals_t::get(txpool_stats &stats, const uint64_t now) const
+  {
+    stats.txs_total = m_weights.size();
+    stats.bytes_total = m_bytes_total;
+    stats.fee_total = m_fee_total;
+    stats.num_not_relayed = m_num_not_relayed;
+    stats.num_failing = m_num_failing;
+    stats.num_double_spends = m_num_double_spends;
+    if (m_weights.empty())
+      return;
+    stats.bytes_min = *m_weights.begin();
+    stats.bytes_max = *m_weights.rbegin();
+    stats.bytes_med = m_weights.size() % 2 ? *m_median : (*m_median + *std::next(m_median)) / 2;
+    stats.oldest = m_by_receive_time.begin()->first;
+
+    std::map<uint64_t, txpool_histo> agebytes;
+    for (const auto &e: m_by_receive_time)
+    {
+      if (e.first < now - 600)
+        stats.num_10m += e.second.txs;
+      const uint64_t age = now - e.first + (now == e.first);
+      txpool_histo &h = agebytes[age];
+      h.txs += e.second.txs;
+      h.bytes += e.second.bytes;
+    }
+
+    if (stats.txs_total > 1)
+    {
+      /* looking for 98th percentile */
+      size_t end = stats.txs_total * 0.02;
+      uint64_t delta, factor;
+      std::map<uint64_t, txpool_histo>::iterator it, i2;
+      if (end)
+      {
+        /* If enough txs, spread the first 98% of results across
+         * the first 9 bins, drop final 2% in last bin.
+         */
+        it = agebytes.end();
+        size_t cumulative_num = 0;
+        /* Since agebytes is not empty and end is nonzero, the
+         * below loop can always run at least once.
+         */
+        do {
+          --it;
+          cumulative_num += it->second.txs;
+        } while (it != agebytes.begin() && cumulative_num < end);
+        stats.histo_98pc = it->first;
+        factor = 9;
+        delta = it->first;
+        stats.histo.resize(10);
+      } else
+      {
+        /* If not enough txs, don't reserve the last slot;
+         * spread evenly across all 10 bins.
+         */
+        stats.histo_98pc = 0;
+        it = agebytes.end();
+        factor = stats.txs_total > 9 ? 10 : stats.txs_total;
+        delta = now - stats.oldest;
+        stats.histo.resize(factor);
+      }
+      if (!delta)
+        delta = 1;
+      for (i2 = agebytes.begin(); i2 != it; i2++)
+      {
+        size_t i = (i2->first * factor - 1) / delta;
+        stats.histo[i].txs += i2->second.txs;
+        stats.histo[i].bytes += i2->second.bytes;
+      }
+      for (; i2 != agebytes.end(); i2++)
+      {
+        stats.histo[factor].txs += i2->second.txs;
+        stats.histo[factor].bytes += i2->second.bytes;
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::log_pool_change(const crypto::hash &txid, bool added, bool broadcasted)
+  {
+    if (m_pool_changes.size() >= max_pool_changes)
+      m_pool_changes.pop_front();
+    m_pool_changes.push_back({++m_pool_revision, txid, added, broadcasted});
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_transaction_changes(uint64_t since, bool include_sensitive, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t& revision) const
+  {
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    revision = m_pool_revision;
+    const uint64_t oldest = m_pool_changes.empty() ? m_pool_revision : m_pool_changes.front().revision - 1;
+    if (since < oldest || since > m_pool_revision)
+      return false;
+
+    const auto first = std::upper_bound(m_pool_changes.begin(), m_pool_changes.end(), since,
+      [](uint64_t r, const pool_change_t &change) { return r < change.revision; });
+    std::unordered_map<crypto::hash, bool> present;
+    for (auto change = first; change != m_pool_changes.end(); ++change)
+    {
+      if (include_sensitive || change->broadcasted)
+        present[change->txid] = change->added;
+    }
+    for (const auto &e: present)
+      (e.second ? added : removed).push_back(e.first);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::revision() const
+  {
+    boost::shared_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+    return m_pool_revision;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const
@@ -1305,7 +1619,7 @@ namespace cryptonote
     }
     bool ret = m_blockchain.check_tx_inputs(get_tx(), max_used_block_height, max_used_block_id, tvc, kept_by_block);
     if (!kept_by_block)
-      m_input_cache.insert(std::make_pair(txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id)));
+      insert_capped(m_input_cache, m_cache_max_entries, txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id));
     return ret;
   }
   //---------------------------------------------------------------------------------
@@ -1407,8 +1721,8 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    bool changed = false;
-    LockedTXN lock(m_blockchain.get_db());
+    std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> marked;
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, void());
@@ -1428,10 +1742,10 @@ namespace cryptonote
           {
             MDEBUG("Marking " << txid << " as double spending " << itk.k_image);
             meta.double_spend_seen = true;
-            changed = true;
             try
             {
               m_blockchain.update_txpool_tx(txid, meta);
+              marked.emplace_back(txid, meta);
             }
             catch (const std::exception &e)
             {
@@ -1443,7 +1757,9 @@ namespace cryptonote
       }
     }
     lock.commit();
-    if (changed)
+    for (const auto &e: marked)
+      index_tx(e.first, e.second);
+    if (!marked.empty())
       ++m_cookie;
   }
   //---------------------------------------------------------------------------------
@@ -1504,13 +1820,36 @@ namespace cryptonote
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
-    LockedTXN lock(m_blockchain.get_db());
+    // readiness only depends on the chain, so candidates found ready on
+    // this top block stay valid until it changes or they leave the pool
+    const crypto::hash top_hash = m_blockchain.get_tail_id();
+    if (top_hash != m_template_candidates_top)
+    {
+      m_template_candidates.clear();
+      m_template_candidates_top = top_hash;
+    }
+
+    std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> updated;
+    LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
 
     auto sorted_it = m_txs_by_fee_and_receive_time.begin();
     for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
     {
+      if (m_pending_validation.count(sorted_it->second))
+      {
+        LOG_PRINT_L2("  tx " << sorted_it->second << " is pending re-validation");
+        continue;
+      }
+      const auto candidate_it = m_template_candidates.find(sorted_it->second);
+      const bool cached = candidate_it != m_template_candidates.end();
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      if (cached)
+      {
+        // relay methods only ever upgrade, so a cached candidate stays eligible
+        meta.weight = candidate_it->second.weight;
+        meta.fee = candidate_it->second.fee;
+      }
+      else if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
       {
         static bool warned = false;
         if (!warned)
@@ -1518,14 +1857,14 @@ namespace cryptonote
         warned = true;
         continue;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << ", relay method " << (unsigned)meta.get_relay_method());
+      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << (cached ? ", cached" : ""));
 
-      if (!meta.matches(relay_category::legacy) && !(m_mine_stem_txes && meta.get_relay_method() == relay_method::stem))
+      if (!cached && !meta.matches(relay_category::legacy) && !(m_mine_stem_txes && meta.get_relay_method() == relay_method::stem))
       {
         LOG_PRINT_L2("  tx relay method is " << (unsigned)meta.get_relay_method());
         continue;
       }
-      if (meta.pruned)
+      if (!cached && meta.pruned)
       {
         LOG_PRINT_L2("  tx is pruned");
         continue;
@@ -1567,6 +1906,23 @@ namespace cryptonote
         }
       }
 
+      if (cached)
+      {
+        const std::vector<crypto::key_image> &key_images = candidate_it->second.key_images;
+        if (std::any_of(key_images.begin(), key_images.end(), [&k_images](const crypto::key_image &ki) { return k_images.count(ki) != 0; }))
+        {
+          LOG_PRINT_L2("  key images already seen");
+          continue;
+        }
+        bl.tx_hashes.push_back(sorted_it->second);
+        total_weight += meta.weight;
+        fee += meta.fee;
+        best_coinbase = coinbase;
+        k_images.insert(key_images.begin(), key_images.end());
+        LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
+        continue;
+      }
+
       // "local" and "stem" txes are filtered above
       cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second, relay_category::all);
 
@@ -1591,6 +1947,7 @@ namespace cryptonote
         try
 	{
 	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
+	  updated.emplace_back(sorted_it->second, meta);
 	}
         catch (const std::exception &e)
 	{
@@ -1603,6 +1960,15 @@ namespace cryptonote
         LOG_PRINT_L2("  not ready to go");
         continue;
       }
+
+      template_candidate_t &candidate = m_template_candidates[sorted_it->second];
+      candidate.weight = meta.weight;
+      candidate.fee = meta.fee;
+      candidate.key_images.clear();
+      for (const txin_v &in: tx.vin)
+        if (in.type() == typeid(txin_to_key))
+          candidate.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+
       if (have_key_images(k_images, tx))
       {
         LOG_PRINT_L2("  key images already seen");
@@ -1617,6 +1983,8 @@ namespace cryptonote
       LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
     }
     lock.commit();
+    for (const auto &e: updated)
+      index_tx(e.first, e.second);
 
     expected_reward = best_coinbase;
     LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
@@ -1625,14 +1993,56 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  size_t tx_memory_pool::validate(uint8_t version)
+  void tx_memory_pool::prevalidate_ring_signatures(const std::vector<crypto::hash> &txids) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    // txes must not reallocate, ring_sigs points into them
+    std::vector<cryptonote::transaction> txes;
+    txes.reserve(txids.size());
+    std::vector<const rct::rctSig*> ring_sigs;
+    ring_sigs.reserve(txids.size());
+    {
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      CRITICAL_REGION_LOCAL1(m_blockchain);
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
+      for (const crypto::hash &txid: txids)
+      {
+        try
+        {
+          cryptonote::blobdata blob;
+          if (!m_blockchain.get_txpool_tx_blob(txid, blob, relay_category::all))
+            continue;
+          txes.emplace_back();
+          if (!parse_and_validate_tx_from_blob(blob, txes.back()))
+          {
+            txes.pop_back();
+            continue;
+          }
+          cryptonote::tx_verification_context tvc{};
+          const size_t n_ring_sigs = ring_sigs.size();
+          if (!m_blockchain.check_tx_inputs_deferred(txes.back(), tvc, ring_sigs))
+            ring_sigs.resize(n_ring_sigs); // will fail again, and be dropped, when re-added
+        }
+        catch (const std::exception &e)
+        {
+          // ignore, the tx will be dealt with when re-added
+        }
+      }
+    }
 
-    MINFO("Validating txpool contents for v" << (unsigned)version);
+    if (ring_sigs.empty() || rct::verRctNonSemanticsSimpleCached(ring_sigs))
+      return;
 
-    LockedTXN lock(m_blockchain.get_db());
+    // a failed batch caches nothing, so cache the good ones one by one
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (const rct::rctSig *rv: ring_sigs)
+      tpool.submit(&waiter, [rv] { rct::verRctNonSemanticsSimpleCached(*rv); });
+    waiter.wait();
+  }
+  //---------------------------------------------------------------------------------
+  size_t tx_memory_pool::validate(uint8_t version)
+  {
+    MINFO("Validating txpool contents for v" << (unsigned)version);
 
     struct tx_entry_t
     {
@@ -1640,53 +2050,116 @@ namespace cryptonote
       txpool_tx_meta_t meta;
     };
 
-    // get all txids
+    // get all txids, skipping those already validated for this version, as
+    // the rules only change with the version this is usually all of them
     std::vector<tx_entry_t> txes;
-    m_blockchain.for_all_txpool_txes([&txes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
-      if (!meta.pruned) // skip pruned txes
-        txes.push_back({txid, meta});
-      return true;
-    }, false, relay_category::all);
+    {
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      CRITICAL_REGION_LOCAL1(m_blockchain);
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
+      size_t n_txes = 0;
+      m_blockchain.for_all_txpool_txes([&txes, &n_txes, version](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
+        ++n_txes;
+        if (!meta.pruned && meta.validated_version != version) // skip pruned txes
+          txes.push_back({txid, meta});
+        return true;
+      }, false, relay_category::all);
+      MINFO(txes.size() << " of " << n_txes << " txpool txes need re-validation");
+
+      // keep them out of block templates and relay until they are re-validated
+      for (const auto &e: txes)
+        m_pending_validation.insert(e.txid);
+    }
 
-    // take them all out and add them back in, some might fail
-    size_t added = 0;
-    for (auto &e: txes)
+    // take them out and add them back in, a batch at a time, some might fail.
+    // The ring signatures, which are most of the cost, are verified first for
+    // the whole batch without holding the locks, and hit the rct cache on re-adding
+    size_t kept = 0, processed = 0;
+    for (size_t batch_start = 0; batch_start < txes.size(); batch_start += VALIDATE_BATCH_SIZE)
     {
-      try
+      const size_t batch_end = std::min<size_t>(batch_start + VALIDATE_BATCH_SIZE, txes.size());
+
+      std::vector<crypto::hash> txids;
+      txids.reserve(batch_end - batch_start);
+      for (size_t n = batch_start; n < batch_end; ++n)
+        txids.push_back(txes[n].txid);
+      if (!m_validation_stop)
+        prevalidate_ring_signatures(txids);
+
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      CRITICAL_REGION_LOCAL1(m_blockchain);
+
+      // a newer version was validated for while we had the locks released,
+      // or we are shutting down: leave the rest as they are
+      if (m_validation_stop || m_blockchain.get_current_hard_fork_version() != version)
       {
-        size_t weight;
-        uint64_t fee;
-        cryptonote::transaction tx;
-        cryptonote::blobdata blob;
-        bool relayed, do_not_relay, double_spend_seen, pruned;
-        if (!take_tx(e.txid, tx, blob, weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
-          MERROR("Failed to get tx " << e.txid << " from txpool for re-validation");
-
-        cryptonote::tx_verification_context tvc{};
-        relay_method tx_relay = e.meta.get_relay_method();
-        if (!add_tx(tx, e.txid, blob, e.meta.weight, tvc, tx_relay, relayed, version))
+        MINFO("Txpool validation for v" << (unsigned)version << " interrupted, " << txes.size() - batch_start << " txes left");
+        for (size_t n = batch_start; n < txes.size(); ++n)
+          m_pending_validation.erase(txes[n].txid);
+        break;
+      }
+
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
+      // take_tx and add_tx only commit with the batch, hold their index changes until then
+      m_deferred_index.reset(new std::unordered_map<crypto::hash, boost::optional<txpool_tx_meta_t>>());
+      const auto deferred_index_guard = epee::misc_utils::create_scope_leave_handler([this]() { m_deferred_index.reset(); });
+      const size_t batch_kept = kept;
+      for (size_t n = batch_start; n < batch_end; ++n)
+      {
+        tx_entry_t &e = txes[n];
+        m_pending_validation.erase(e.txid);
+        try
+        {
+          size_t weight;
+          uint64_t fee;
+          cryptonote::transaction tx;
+          cryptonote::blobdata blob;
+          bool relayed, do_not_relay, double_spend_seen, pruned;
+          if (!take_tx(e.txid, tx, blob, weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
+          {
+            // it may have been mined, or dropped, while the locks were released
+            MDEBUG("Tx " << e.txid << " left the txpool before re-validation");
+            ++kept;
+            continue;
+          }
+
+          cryptonote::tx_verification_context tvc{};
+          relay_method tx_relay = e.meta.get_relay_method();
+          if (!add_tx(tx, e.txid, blob, e.meta.weight, tvc, tx_relay, relayed, version))
+          {
+            MINFO("Failed to re-validate tx " << e.txid << " for v" << (unsigned)version << ", dropped");
+            continue;
+          }
+          txpool_tx_meta_t added_meta;
+          e.meta.validated_version = m_blockchain.get_txpool_tx_meta(e.txid, added_meta) ? added_meta.validated_version : 0;
+          m_blockchain.update_txpool_tx(e.txid, e.meta);
+          index_tx(e.txid, e.meta);
+          ++kept;
+        }
+        catch (const std::exception &e)
         {
-          MINFO("Failed to re-validate tx " << e.txid << " for v" << (unsigned)version << ", dropped");
+          MERROR("Failed to re-validate tx from pool");
           continue;
         }
-        m_blockchain.update_txpool_tx(e.txid, e.meta);
-        ++added;
-      }
-      catch (const std::exception &e)
-      {
-        MERROR("Failed to re-validate tx from pool");
-        continue;
       }
-    }
+      apply_deferred_index(lock.commit());
+      processed = batch_end;
 
-    lock.commit();
+      // removals are published a batch at a time
+      if (kept - batch_kept < batch_end - batch_start)
+        ++m_cookie;
+    }
 
-    const size_t n_removed = txes.size() - added;
-    if (n_removed > 0)
-      ++m_cookie;
+    const size_t n_removed = processed - kept;
+    MINFO("Txpool validation for v" << (unsigned)version << " done, " << n_removed << " txes dropped");
     return n_removed;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::stop_validation()
+  {
+    m_validation_stop = true;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::init(size_t max_txpool_weight, bool mine_stem_txes)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -1694,7 +2167,14 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
-    m_spent_key_images.clear();
+    m_template_candidates.clear();
+    {
+      boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+      m_spent_key_images.clear();
+      m_tx_relay_index.clear();
+      m_all_totals.clear();
+      m_broadcasted_totals.clear();
+    }
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
 
@@ -1718,8 +2198,9 @@ namespace cryptonote
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid);
+        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid, get_tx_expiry(meta.receive_time, meta.kept_by_block));
         m_txpool_weight += meta.weight;
+        index_tx(txid, meta);
         return true;
       }, true, relay_category::all);
       if (!r)
@@ -1727,7 +2208,7 @@ namespace cryptonote
     }
     if (!remove.empty())
     {
-      LockedTXN lock(m_blockchain.get_db());
+      LockedTXN lock(m_blockchain.get_db(), m_blockchain.txpool_in_db());
       for (const auto &txid: remove)
       {
         try
@@ -1745,6 +2226,11 @@ namespace cryptonote
 
     m_mine_stem_txes = mine_stem_txes;
     m_cookie = 0;
+    {
+      boost::unique_lock<boost::shared_mutex> index_lock(m_read_index_lock);
+      m_pool_changes.clear();
+      m_pool_revision = crypto::rand<uint64_t>() >> 16;
+    }
 
     // Ignore deserialization error
     return true;
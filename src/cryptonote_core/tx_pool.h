@@ -32,13 +32,18 @@
 #include "include_base_utils.h"
 
 #include <atomic>
+#include <cstring>
+#include <deque>
+#include <map>
 #include <set>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <boost/optional.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 #include "span.h"
 #include "string_tools.h"
@@ -49,6 +54,7 @@
 #include "cryptonote_protocol/enums.h"
 #include "blockchain_db/blockchain_db.h"
 #include "crypto/hash.h"
+#include "common/memory_usage.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "rpc/message_data_structs.h"
 
@@ -72,13 +78,138 @@ namespace cryptonote
       else if (a.first.first < b.first.first) return false;
       else if (a.first.second < b.first.second) return true;
       else if (a.first.second > b.first.second) return false;
-      else if (a.second != b.second) return true;
-      else return false;
+      // any strict order will do for the tie break, the set needs one
+      else return memcmp(a.second.data, b.second.data, sizeof(a.second.data)) < 0;
     }
   };
 
-  //! container for sorting transactions by fee per unit size
-  typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> sorted_tx_container;
+  /**
+   * @brief container for sorting transactions by fee per unit size
+   *
+   * Keeps an iterator per txid next to the ordered set, so transactions can
+   * be found, removed or re-prioritized in O(log n) instead of scanning the
+   * whole pool.  A second index orders the transactions by expiry time, so
+   * expired ones can be found without looking at the others.
+   */
+  class sorted_tx_container
+  {
+  public:
+    typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> container_type;
+    typedef container_type::const_iterator iterator;
+
+    iterator begin() const { return m_entries.begin(); }
+    iterator end() const { return m_entries.end(); }
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    void clear() { m_entries.clear(); m_by_txid.clear(); m_by_expiry.clear(); }
+    uint64_t memory_bytes() const { return tools::memory::tree_container_bytes(m_entries) + tools::memory::hash_container_bytes(m_by_txid) + tools::memory::tree_container_bytes(m_by_expiry); }
+
+    /**
+     * @brief add a transaction, replacing its previous entry if any
+     *
+     * @param key fee per weight unit and receive time of the transaction
+     * @param txid the hash of the transaction
+     * @param expiry the time after which the transaction is stuck
+     *
+     * @return an iterator to the new entry
+     */
+    iterator emplace(const std::pair<double, std::time_t> &key, const crypto::hash &txid, std::time_t expiry)
+    {
+      erase(txid);
+      const iterator it = m_entries.emplace(key, txid).first;
+      m_by_txid.emplace(txid, indices{it, expiry});
+      m_by_expiry.emplace(expiry, txid);
+      return it;
+    }
+
+    /**
+     * @brief get the entry for a transaction
+     *
+     * @return an iterator to the entry, or end() if not found
+     */
+    iterator find(const crypto::hash &txid) const
+    {
+      const auto i = m_by_txid.find(txid);
+      return i == m_by_txid.end() ? m_entries.end() : i->second.entry;
+    }
+
+    /**
+     * @brief remove an entry
+     *
+     * @return an iterator to the entry following the removed one
+     */
+    iterator erase(iterator it)
+    {
+      const auto i = m_by_txid.find(it->second);
+      m_by_expiry.erase(std::make_pair(i->second.expiry, i->first));
+      m_by_txid.erase(i);
+      return m_entries.erase(it);
+    }
+
+    /**
+     * @brief remove the entry for a transaction, if any
+     *
+     * @return true if an entry was removed
+     */
+    bool erase(const crypto::hash &txid)
+    {
+      const auto i = m_by_txid.find(txid);
+      if (i == m_by_txid.end())
+        return false;
+      m_entries.erase(i->second.entry);
+      m_by_expiry.erase(std::make_pair(i->second.expiry, txid));
+      m_by_txid.erase(i);
+      return true;
+    }
+
+    /**
+     * @brief get the transactions which expired before a given time
+     *
+     * @param now the current time
+     *
+     * @return the txids, oldest expiry first
+     */
+    std::vector<crypto::hash> get_expired(std::time_t now) const
+    {
+      std::vector<crypto::hash> txids;
+      for (auto it = m_by_expiry.begin(); it != m_by_expiry.end() && it->first < now; ++it)
+        txids.push_back(it->second);
+      return txids;
+    }
+
+  private:
+    struct indices
+    {
+      iterator entry;
+      std::time_t expiry;
+    };
+
+    struct expiry_compare
+    {
+      bool operator()(const std::pair<std::time_t, crypto::hash> &a, const std::pair<std::time_t, crypto::hash> &b) const
+      {
+        if (a.first != b.first)
+          return a.first < b.first;
+        return memcmp(a.second.data, b.second.data, sizeof(a.second.data)) < 0;
+      }
+    };
+
+    container_type m_entries;
+    std::unordered_map<crypto::hash, indices> m_by_txid;
+    std::set<std::pair<std::time_t, crypto::hash>, expiry_compare> m_by_expiry;
+  };
+
+  /**
+   * @brief get fee per byte quantiles, weighted by transaction weight
+   *
+   * A quantile is the lowest fee rate such that the transactions paying
+   * up to it make up at least its percentile of the total weight.
+   *
+   * @param by_fee_rate count and weight of transactions by fee per byte
+   * @param percentiles the percentiles to get, each at most 100
+   * @param quantiles return-by-reference totals and one fee rate per percentile
+   */
+  void get_fee_rate_quantiles(const std::map<uint64_t, txpool_histo> &by_fee_rate, const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles);
 
   /**
    * @brief Transaction pool, handles transactions which are not part of a block
@@ -256,6 +387,31 @@ namespace cryptonote
      */
     void get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive = false) const;
 
+    /**
+     * @brief get the txes that entered or left the pool since a revision
+     *
+     * A tx added and removed again in between is reported as removed, and
+     * a tx can be reported added more than once. Callers should treat
+     * unknown removals as no-ops.
+     *
+     * @param since a revision returned by an earlier call
+     * @param include_sensitive include stempool, anonymity-pool, and unrelayed txes
+     * @param added return-by-reference txes now in the pool
+     * @param removed return-by-reference txes no longer in the pool
+     * @param revision return-by-reference the current revision
+     *
+     * @return false if `since` is older than the change log or unknown,
+     *   the caller should then get all hashes instead
+     */
+    bool get_transaction_changes(uint64_t since, bool include_sensitive, std::vector<crypto::hash>& added, std::vector<crypto::hash>& removed, uint64_t& revision) const;
+
+    /**
+     * @brief get the current change log revision
+     *
+     * @note see tx_memory_pool::get_transaction_changes
+     */
+    uint64_t revision() const;
+
     /**
      * @brief get (weight, fee, receive time) for all transaction in the pool
      *
@@ -281,12 +437,27 @@ namespace cryptonote
     /**
      * @brief get a summary statistics of all transaction hashes in the pool
      *
+     * Served from running totals kept with the read index, without reading
+     * the pool from the db.
+     *
      * @param stats return-by-reference the pool statistics
      * @param include_sensitive return stempool, anonymity-pool, and unrelayed txes
      *
      */
     void get_transaction_stats(struct txpool_stats& stats, bool include_sensitive = false) const;
 
+    /**
+     * @brief get fee per byte quantiles of the pool
+     *
+     * Served from running totals kept with the read index, like
+     * get_transaction_stats.
+     *
+     * @param percentiles the percentiles to get, each at most 100
+     * @param quantiles return-by-reference the pool quantiles
+     * @param include_sensitive include stempool, anonymity-pool, and unrelayed txes
+     */
+    void get_fee_rate_quantiles(const std::vector<uint32_t> &percentiles, fee_rate_quantiles &quantiles, bool include_sensitive = false) const;
+
     /**
      * @brief get information about all transactions and key images in the pool
      *
@@ -318,10 +489,11 @@ namespace cryptonote
      *
      * @param key_images [in] vector of key images to check
      * @param spent [out] vector of bool to return
+     * @param include_sensitive also count stempool, anonymity-pool, and unrelayed spenders
      *
      * @return true
      */
-    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const;
+    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive = false) const;
 
     /**
      * @brief get a specific transaction from the pool
@@ -385,12 +557,22 @@ namespace cryptonote
      * invalid may change.  This function clears those which were received
      * before a version change and no longer conform to requirements.
      *
+     * Transactions are re-checked in batches, with the locks released in
+     * between, and are kept out of block templates and relay until they
+     * have been.  Validation stops early if the hard fork version changes
+     * meanwhile, or stop_validation is called.
+     *
      * @param version the version the transactions must conform to
      *
      * @return the number of transactions removed
      */
     size_t validate(uint8_t version);
 
+    /**
+     * @brief makes any running or future validate call return early
+     */
+    void stop_validation();
+
      /**
       * @brief return the cookie
       *
@@ -412,6 +594,23 @@ namespace cryptonote
      */
     void set_txpool_max_weight(size_t bytes);
 
+    /**
+     * @brief set the max number of entries in each of the input check and parsed tx caches
+     *
+     * Arbitrary entries are dropped when a cache is full, they are only
+     * there to save work and are rebuilt as needed.
+     *
+     * @param entries the limit, 0 for none
+     */
+    void set_cache_max_entries(size_t entries);
+
+    /**
+     * @brief reports the approximate memory held by the in memory containers
+     *
+     * @param usage return-by-reference, one entry per container is appended
+     */
+    void get_memory_usage(std::vector<tools::memory_usage> &usage) const;
+
     /**
      * @brief reduce the cumulative txpool weight by the weight provided
      *
@@ -482,6 +681,43 @@ namespace cryptonote
      */
     bool insert_key_images(const transaction_prefix &tx, const crypto::hash &txid, relay_method tx_relay);
 
+    /**
+     * @brief record a pool transaction's metadata in the read index
+     *
+     * Called with m_transactions_lock held, after the matching db change
+     * has been committed, whenever the relay method or a field counted by
+     * get_transaction_stats changes.
+     *
+     * @param txid the hash of the transaction
+     * @param meta its current metadata
+     */
+    void index_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
+
+    /**
+     * @brief drop a transaction from the read index
+     *
+     * @note see tx_memory_pool::index_tx
+     *
+     * @param txid the hash of the transaction
+     */
+    void unindex_tx(const crypto::hash &txid);
+
+    /**
+     * @brief apply the read index changes held back while m_deferred_index was set
+     *
+     * @param committed whether the batch they were made in committed, they are dropped if not
+     */
+    void apply_deferred_index(bool committed);
+
+    /**
+     * @brief append to the pool change log, m_read_index_lock held exclusively
+     *
+     * @param txid the hash of the transaction
+     * @param added whether it entered or left the read index
+     * @param broadcasted whether it is (or was) visible without sensitive txes
+     */
+    void log_pool_change(const crypto::hash &txid, bool added, bool broadcasted);
+
     /**
      * @brief remove old transactions from the pool
      *
@@ -493,6 +729,28 @@ namespace cryptonote
      */
     bool remove_stuck_transactions();
 
+    /**
+     * @brief remove a transaction and its key images from the pool
+     *
+     * The caller holds the pool lock and a db write transaction, and removes
+     * the tx from m_txs_by_fee_and_receive_time and the read index itself.
+     *
+     * @param txid the hash of the transaction
+     * @param weight the weight of the transaction
+     *
+     * @return false if the transaction blob could not be parsed, otherwise true
+     */
+    bool evict_tx(const crypto::hash &txid, uint64_t weight);
+
+    /**
+     * @brief writes the changes to an in memory txpool to the database
+     *
+     * Bounds what a crash loses when the pool is kept in memory
+     *
+     * @return true
+     */
+    bool store_snapshot();
+
     /**
      * @brief check if a transaction in the pool has a given spent key image
      *
@@ -599,10 +857,114 @@ private:
     //! container for spent key images from the transactions in the pool
     key_images_container m_spent_key_images;  
 
+    //! the part of a pool tx's db metadata the read index mirrors
+    struct tx_index_entry_t
+    {
+      relay_method relay;
+      uint32_t weight;
+      uint64_t fee;
+      uint64_t receive_time;
+      bool relayed;
+      bool failing;
+      bool double_spend_seen;
+    };
+
+    //! relay method and stats fields of each transaction in the pool
+    std::unordered_map<crypto::hash, tx_index_entry_t> m_tx_relay_index;
+
+    //! running totals for get_transaction_stats over one relay category
+    /*! Weights are kept sorted with an iterator to their lower median, and
+     *  counts and weights are bucketed by receive time and by fee per byte,
+     *  so serving stats costs one pass over distinct receive times, and fee
+     *  quantiles one pass over distinct fee rates, rather than a db walk.
+     */
+    class pool_totals_t: boost::noncopyable
+    {
+    public:
+      pool_totals_t() { clear(); }
+
+      void add(const tx_index_entry_t &e);
+      void remove(const tx_index_entry_t &e);
+      void clear();
+
+      //! fill stats as get_transaction_stats used to from the db
+      void get(txpool_stats &stats, uint64_t now) const;
+      const std::map<uint64_t, txpool_histo> &get_by_fee_rate() const { return m_by_fee_rate; }
+
+    private:
+      uint64_t m_bytes_total;
+      uint64_t m_fee_total;
+      uint32_t m_num_not_relayed;
+      uint32_t m_num_failing;
+      uint32_t m_num_double_spends;
+      std::multiset<uint32_t> m_weights;
+      std::multiset<uint32_t>::const_iterator m_median;
+      std::map<uint64_t, txpool_histo> m_by_receive_time;
+      std::map<uint64_t, txpool_histo> m_by_fee_rate;
+    };
+
+    pool_totals_t m_all_totals; //!< over every tx in m_tx_relay_index
+    pool_totals_t m_broadcasted_totals; //!< over the txes visible without sensitive txes
+
+    //! guards m_spent_key_images, m_tx_relay_index and the totals for lock-free readers
+    /*! Writers hold m_transactions_lock and take this exclusively only while
+     *  changing those containers, so have_tx, check_for_key_images and
+     *  get_transaction_hashes can take it shared and never wait behind
+     *  transaction verification or block template creation.
+     */
+    mutable boost::shared_mutex m_read_index_lock;
+
+    //! the latest read index change for each txid, while a batch spanning several pool changes is open
+    /*! index_tx and unindex_tx record here instead of applying while set, so
+     *  lock-free readers neither see a tx leave and come back mid-batch nor
+     *  a change the batch then fails to commit. none means unindex.
+     */
+    std::unique_ptr<std::unordered_map<crypto::hash, boost::optional<txpool_tx_meta_t>>> m_deferred_index;
+
+    //! an entry or exit of m_tx_relay_index, as seen with or without sensitive txes
+    struct pool_change_t
+    {
+      uint64_t revision;
+      crypto::hash txid;
+      bool added;
+      bool broadcasted; //!< tx is (added) or was (removed) visible without sensitive txes
+    };
+
+    //! the latest changes to m_tx_relay_index, guarded by m_read_index_lock
+    /*! Bounded, so a client far behind gets a full hash list instead. The
+     *  revision starts at a random value on each init, so revisions from
+     *  before a restart are rejected rather than misread.
+     */
+    std::deque<pool_change_t> m_pool_changes;
+    uint64_t m_pool_revision;
+
+    //! what fill_block_template needs to know about a tx it found minable
+    struct template_candidate_t
+    {
+      uint64_t weight;
+      uint64_t fee;
+      std::vector<crypto::key_image> key_images;
+    };
+
+    //! txes found ready to go on top of m_template_candidates_top
+    /*! Lets repeated block templates skip the db reads, parsing and input
+     *  checks for txes already vetted against the current chain tip.
+     *  Entries are dropped when their tx leaves the pool, and all of them
+     *  when the tip changes.
+     */
+    std::unordered_map<crypto::hash, template_candidate_t> m_template_candidates;
+    crypto::hash m_template_candidates_top; //!< chain tip m_template_candidates was computed on
+
+    //! txes waiting for re-validation, left out of block templates and relay
+    std::unordered_set<crypto::hash> m_pending_validation;
+
     //TODO: this time should be a named constant somewhere, not hard-coded
     //! interval on which to check for stale/"stuck" transactions
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
+    //! interval on which an in memory txpool is written to the database
+    epee::math_helper::once_a_time_seconds<60> m_snapshot_interval;
+
     //TODO: look into doing this better
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
@@ -621,6 +983,16 @@ private:
     //! cache/call Blockchain::check_tx_inputs results
     bool check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
+    /**
+     * @brief verifies the ring signatures of pool txes as a batch, caching the results
+     *
+     * Only takes the locks to look up the txes and their rings, so the
+     * costly part runs unlocked and the subsequent re-checks hit the cache.
+     *
+     * @param txids the txes to verify
+     */
+    void prevalidate_ring_signatures(const std::vector<crypto::hash> &txids) const;
+
     //! transactions which are unlikely to be included in blocks
     /*! These transactions are kept in RAM in case they *are* included
      *  in a block eventually, but this container is not saved to disk.
@@ -632,11 +1004,14 @@ private:
     size_t m_txpool_max_weight;
     size_t m_txpool_weight;
     bool m_mine_stem_txes;
+    std::atomic<bool> m_validation_stop; //!< set to make validate return early
 
     mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
 
     std::unordered_map<crypto::hash, transaction> m_parsed_tx_cache;
 
+    size_t m_cache_max_entries; //!< limit for m_input_cache and m_parsed_tx_cache, 0 for none
+
     //! Next timestamp that a DB check for relayable txes is allowed
     std::atomic<time_t> m_next_check;
   };
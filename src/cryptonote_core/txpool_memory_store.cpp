@@ -0,0 +1,154 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "txpool_memory_store.h"
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "txpool"
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------------
+  size_t txpool_memory_store::load(const BlockchainDB &db)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_txes.clear();
+    m_changed.clear();
+    m_removed.clear();
+    db.for_all_txpool_txes([this](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref *bd) {
+      m_txes[txid] = {meta, cryptonote::blobdata(bd->data(), bd->size())};
+      return true;
+    }, true, relay_category::all);
+    return m_txes.size();
+  }
+  //---------------------------------------------------------------------------------
+  size_t txpool_memory_store::write_snapshot(BlockchainDB &db)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for (const crypto::hash &txid: m_removed)
+      db.remove_txpool_tx(txid);
+    for (const crypto::hash &txid: m_changed)
+    {
+      const auto i = m_txes.find(txid);
+      if (i == m_txes.end())
+        continue;
+      if (db.txpool_has_tx(txid, relay_category::all))
+        db.update_txpool_tx(txid, i->second.meta);
+      else
+        db.add_txpool_tx(txid, i->second.blob, i->second.meta);
+    }
+    // only forget the changes once they are all in, a throw leaves them for the next try
+    const size_t written = m_removed.size() + m_changed.size();
+    m_removed.clear();
+    m_changed.clear();
+    return written;
+  }
+  //---------------------------------------------------------------------------------
+  size_t txpool_memory_store::pending_changes() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_removed.size() + m_changed.size();
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_memory_store::add_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (!m_txes.emplace(txid, entry{meta, blob}).second)
+      throw DB_ERROR("Attempting to add txpool tx metadata that's already in the db");
+    m_removed.erase(txid);
+    m_changed.insert(txid);
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_memory_store::update_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end())
+      throw DB_ERROR("Error finding txpool tx meta to update");
+    i->second.meta = meta;
+    m_changed.insert(txid);
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_memory_store::remove_tx(const crypto::hash &txid)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (m_txes.erase(txid) == 0)
+      return;
+    m_changed.erase(txid);
+    m_removed.insert(txid);
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t txpool_memory_store::get_tx_count(relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (category == relay_category::all)
+      return m_txes.size();
+    uint64_t n = 0;
+    for (const auto &e: m_txes)
+      if (e.second.meta.matches(category))
+        ++n;
+    return n;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_memory_store::get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end())
+      return false;
+    meta = i->second.meta;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_memory_store::get_tx_blob(const crypto::hash &txid, cryptonote::blobdata &bd, relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end() || !i->second.meta.matches(category))
+      return false;
+    bd = i->second.blob;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_memory_store::for_all_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    for (const auto &e: m_txes)
+    {
+      if (!e.second.meta.matches(category))
+        continue;
+      cryptonote::blobdata_ref bd;
+      if (include_blob)
+        bd = {e.second.blob.data(), e.second.blob.size()};
+      if (!f(e.first, e.second.meta, &bd))
+        return false;
+    }
+    return true;
+  }
+}
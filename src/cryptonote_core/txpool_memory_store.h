@@ -0,0 +1,100 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "syncobj.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief keeps the txpool's metadata and blobs in memory instead of the database
+   *
+   * Writing every pool change to the database serializes pool churn against
+   * block import, since the database has a single writer. This store takes
+   * those changes in memory and remembers which txes changed, so they can be
+   * written to the database in one batch now and then, and the pool survives
+   * a restart minus the changes since the last snapshot.
+   *
+   * Changes are not part of any database transaction, and are not undone if
+   * one is aborted. All callers hold the txpool lock, the store's own lock is
+   * only there to keep its containers consistent.
+   */
+  class txpool_memory_store
+  {
+  public:
+    /**
+     * @brief replaces the contents of the store with the database's txpool
+     *
+     * @return the number of txes loaded
+     */
+    size_t load(const BlockchainDB &db);
+
+    /**
+     * @brief writes the changes since the last snapshot to the database
+     *
+     * The caller is expected to have a batch open, and to hold the locks
+     * needed to write to the database.
+     *
+     * @return the number of txes written or removed
+     */
+    size_t write_snapshot(BlockchainDB &db);
+
+    //! \return the number of txes changed since the last snapshot
+    size_t pending_changes() const;
+
+    // these mirror the BlockchainDB txpool calls, and throw DB_ERROR in the same cases
+    void add_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta);
+    void update_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
+    void remove_tx(const crypto::hash &txid);
+    uint64_t get_tx_count(relay_category category) const;
+    bool get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const;
+    bool get_tx_blob(const crypto::hash &txid, cryptonote::blobdata &bd, relay_category category) const;
+
+    //! f must not change the store, the lock is held while it runs
+    bool for_all_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const;
+
+  private:
+    struct entry
+    {
+      txpool_tx_meta_t meta;
+      cryptonote::blobdata blob;
+    };
+
+    mutable epee::critical_section m_lock;
+    std::unordered_map<crypto::hash, entry> m_txes;
+    std::unordered_set<crypto::hash> m_changed; //!< added or updated since the last snapshot
+    std::unordered_set<crypto::hash> m_removed; //!< removed since the last snapshot
+  };
+}
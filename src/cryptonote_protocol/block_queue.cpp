@@ -28,11 +28,14 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
 #include <vector>
-#include <unordered_map>
+#include <boost/filesystem.hpp>
 #include <boost/uuid/nil_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "string_tools.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
 #include "cryptonote_protocol_defs.h"
 #include "common/pruning.h"
 #include "block_queue.h"
@@ -40,14 +43,13 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "cn.block_queue"
 
-namespace std {
-  static_assert(sizeof(size_t) <= sizeof(boost::uuids::uuid), "boost::uuids::uuid too small");
-  template<> struct hash<boost::uuids::uuid> {
-    std::size_t operator()(const boost::uuids::uuid &_v) const {
-      return reinterpret_cast<const std::size_t &>(_v);
-    }
-  };
-}
+// spans are sized so they take about that long to come back from the peer they're requested from:
+// slow peers then hold fewer blocks the sync is waiting on, and fast or distant ones amortize the
+// request round trip over more blocks
+#define SPAN_TARGET_TIME 4.0f // seconds
+
+// a span is overdue after that many times the usual time the peer takes to send one
+#define SPAN_OVERDUE_FACTOR 3.0f
 
 namespace cryptonote
 {
@@ -57,6 +59,7 @@ void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_comp
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   std::vector<crypto::hash> hashes;
   bool has_hashes = remove_span(height, &hashes);
+  update_peer_stats(connection_id, bcel.size(), rate, size);
   blocks.insert(span(height, std::move(bcel), connection_id, addr, rate, size));
   if (has_hashes)
   {
@@ -67,13 +70,14 @@ void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_comp
     }
     set_span_hashes(height, connection_id, hashes);
   }
+  spill_spans();
 }
 
-void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time)
+void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time, uint64_t expected_weight)
 {
   CHECK_AND_ASSERT_THROW_MES(nblocks > 0, "Empty span");
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  blocks.insert(span(height, nblocks, connection_id, addr, time));
+  blocks.insert(span(height, nblocks, connection_id, addr, time, expected_weight));
 }
 
 void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
@@ -83,11 +87,13 @@ void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
   while (i != blocks.end())
   {
     block_map::iterator j = i++;
-    if (j->connection_id == connection_id && (all || j->blocks.size() == 0))
+    if (j->connection_id == connection_id && (all || !j->filled()))
     {
       erase_block(j);
     }
   }
+  if (all)
+    peers.erase(connection_id);
 }
 
 void block_queue::erase_block(block_map::iterator j)
@@ -98,9 +104,92 @@ void block_queue::erase_block(block_map::iterator j)
     requested_hashes.erase(h);
     have_blocks.erase(h);
   }
+  if (j->spilled)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(get_spill_filename(j->start_block_height), ec);
+    spilled_size -= j->size;
+  }
   blocks.erase(j);
 }
 
+bool block_queue::set_spill(const std::string &dir, size_t max_memory_size, size_t max_spill_size)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  CHECK_AND_ASSERT_MES(spilled_size == 0, false, "Spans are already spilled");
+  spill_dir.clear();
+  if (dir.empty() || max_spill_size == 0)
+    return true;
+
+  // spans do not survive a restart, so anything there is stale
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(dir, ec);
+  if (ec)
+  {
+    MERROR("Failed to create block queue spill directory " << dir << ": " << ec.message());
+    return false;
+  }
+  for (boost::filesystem::directory_iterator i(dir, ec), end; !ec && i != end; i.increment(ec))
+    if (i->path().extension() == ".span")
+      boost::filesystem::remove(i->path(), ec);
+
+  spill_dir = dir;
+  spill_max_memory_size = max_memory_size;
+  spill_max_size = max_spill_size;
+  return true;
+}
+
+std::string block_queue::get_spill_filename(uint64_t start_block_height) const
+{
+  return (boost::filesystem::path(spill_dir) / (std::to_string(start_block_height) + ".span")).string();
+}
+
+void block_queue::spill_spans()
+{
+  if (spill_dir.empty())
+    return;
+
+  // the spans furthest ahead go first, the first one is about to be added
+  size_t size = get_data_size();
+  block_map::iterator i = blocks.end();
+  while (size > spill_max_memory_size && i != blocks.begin())
+  {
+    --i;
+    if (i == blocks.begin())
+      break;
+    if (i->blocks.empty() || spilled_size + i->size > spill_max_size)
+      continue;
+
+    NOTIFY_RESPONSE_GET_OBJECTS::request r;
+    r.blocks = i->blocks;
+    const epee::byte_slice blob = epee::serialization::store_t_to_binary(r);
+    if (blob.empty() || !epee::file_io_utils::save_string_to_file(get_spill_filename(i->start_block_height), std::string((const char*)blob.data(), blob.size())))
+    {
+      MWARNING("Failed to spill span at " << i->start_block_height << " to " << spill_dir);
+      return;
+    }
+    // neither changes sorting
+    std::vector<cryptonote::block_complete_entry>().swap(const_cast<span&>(*i).blocks);
+    const_cast<span&>(*i).spilled = true;
+    spilled_size += i->size;
+    size -= i->size;
+    MDEBUG("Spilled span at " << i->start_block_height << " (" << i->size << " bytes), " << spilled_size << " bytes on disk");
+  }
+}
+
+bool block_queue::load_spilled_span(const span &s, std::vector<cryptonote::block_complete_entry> &bcel) const
+{
+  std::string blob;
+  NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  if (!epee::file_io_utils::load_file_to_string(get_spill_filename(s.start_block_height), blob) || !epee::serialization::load_t_from_binary(r, blob) || r.blocks.size() != s.nblocks)
+  {
+    MERROR("Failed to load spilled span at " << s.start_block_height << " from " << spill_dir);
+    return false;
+  }
+  bcel = std::move(r.blocks);
+  return true;
+}
+
 void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_connections)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -108,11 +197,45 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
   while (i != blocks.end())
   {
     block_map::iterator j = i++;
-    if (j->blocks.empty() && live_connections.find(j->connection_id) == live_connections.end())
+    if (!j->filled() && live_connections.find(j->connection_id) == live_connections.end())
     {
       erase_block(j);
     }
   }
+  for (auto i = peers.begin(); i != peers.end(); )
+  {
+    if (live_connections.find(i->first) == live_connections.end())
+      i = peers.erase(i);
+    else
+      ++i;
+  }
+}
+
+void block_queue::update_peer_stats(const boost::uuids::uuid &connection_id, uint64_t nblocks, float rate, size_t size)
+{
+  if (nblocks == 0 || rate <= 0.0f)
+    return;
+  const float span_time = size / rate;
+  peer_stats &stats = peers[connection_id];
+  // as in get_speed, this gives much more importance to the latest measurements
+  if (stats.nspans == 0)
+  {
+    stats.rate = rate;
+    stats.span_time = span_time;
+  }
+  else
+  {
+    stats.rate = (stats.rate + rate) / 2;
+    stats.span_time = (stats.span_time + span_time) / 2;
+  }
+  ++stats.nspans;
+
+  // scale the size of that span towards the target time, but do not jump too far on one measurement
+  float next_size = nblocks * SPAN_TARGET_TIME / std::max(span_time, 0.001f);
+  next_size = std::min(next_size, nblocks * 2.0f);
+  next_size = std::max(next_size, nblocks / 2.0f);
+  stats.span_size = std::max<uint64_t>(1, next_size);
+  MDEBUG("Peer " << connection_id << ": " << nblocks << " blocks in " << span_time << " seconds, " << rate/1024 << " kB/s, next span size " << stats.span_size);
 }
 
 bool block_queue::remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes)
@@ -168,7 +291,7 @@ uint64_t block_queue::get_next_needed_height(uint64_t blockchain_height) const
   {
     if (span.start_block_height + span.nblocks - 1 < blockchain_height)
       continue;
-    if (span.start_block_height != last_needed_height || (first && span.blocks.empty()))
+    if (span.start_block_height != last_needed_height || (first && !span.filled()))
       return last_needed_height;
     last_needed_height = span.start_block_height + span.nblocks;
     first = false;
@@ -181,7 +304,7 @@ void block_queue::print() const
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   MDEBUG("Block queue has " << blocks.size() << " spans");
   for (const auto &span: blocks)
-    MDEBUG("  " << span.start_block_height << " - " << (span.start_block_height+span.nblocks-1) << " (" << span.nblocks << ") - " << (span.blocks.empty() ? "scheduled" : "filled    ") << "  " << span.connection_id << " (" << ((unsigned)(span.rate*10/1024.f))/10.f << " kB/s)");
+    MDEBUG("  " << span.start_block_height << " - " << (span.start_block_height+span.nblocks-1) << " (" << span.nblocks << ") - " << (!span.filled() ? "scheduled" : span.spilled ? "spilled   " : "filled    ") << "  " << span.connection_id << " (" << ((unsigned)(span.rate*10/1024.f))/10.f << " kB/s)");
 }
 
 std::string block_queue::get_overview(uint64_t blockchain_height) const
@@ -202,7 +325,7 @@ std::string block_queue::get_overview(uint64_t blockchain_height) const
     {
       if (expected < i->start_block_height)
         s += std::string(std::max((uint64_t)1, (i->start_block_height - expected) / (i->nblocks ? i->nblocks : 1)), '_');
-      s += i->blocks.empty() ? "." : i->start_block_height == blockchain_height ? "m" : "o";
+      s += !i->filled() ? "." : i->start_block_height == blockchain_height ? "m" : "o";
       expected = i->start_block_height + i->nblocks;
     }
     ++i;
@@ -228,14 +351,14 @@ bool block_queue::have(const crypto::hash &hash) const
   return have_blocks.find(hash) != have_blocks.end();
 }
 
-std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_height, uint64_t last_block_height, uint64_t max_blocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, bool sync_pruned_blocks, uint32_t local_pruning_seed, uint32_t pruning_seed, uint64_t blockchain_height, const std::vector<std::pair<crypto::hash, uint64_t>> &block_hashes, boost::posix_time::ptime time)
+std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_height, uint64_t last_block_height, uint64_t max_blocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, bool sync_pruned_blocks, uint32_t local_pruning_seed, uint32_t pruning_seed, uint64_t blockchain_height, const std::vector<std::pair<crypto::hash, uint64_t>> &block_hashes, uint64_t max_weight, boost::posix_time::ptime time)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
 
   MDEBUG("reserve_span: first_block_height " << first_block_height << ", last_block_height " << last_block_height
       << ", max " << max_blocks << ", peer seed " << epee::string_tools::to_string_hex(pruning_seed) << ", blockchain_height " <<
       blockchain_height << ", block hashes size " << block_hashes.size() << ", local seed " << epee::string_tools::to_string_hex(local_pruning_seed)
-      << ", sync_pruned_blocks " << sync_pruned_blocks);
+      << ", sync_pruned_blocks " << sync_pruned_blocks << ", max weight " << max_weight);
   if (last_block_height < first_block_height || max_blocks == 0)
   {
     MDEBUG("reserve_span: early out: first_block_height " << first_block_height << ", last_block_height " << last_block_height << ", max_blocks " << max_blocks);
@@ -256,13 +379,15 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     ++span_start_height;
   }
 
+  const uint64_t block_hashes_start_height = last_block_height - block_hashes.size() + 1;
   if (!sync_pruned_blocks)
   {
-    // if the peer's pruned for the starting block and its unpruned stripe comes next, start downloading from there
-    const uint32_t next_unpruned_height = tools::get_next_unpruned_block_height(span_start_height, blockchain_height, pruning_seed);
+    // if the peer's pruned for the starting block, start downloading from where its unpruned
+    // stripe comes next in the hashes it sent, so it fills in a later stripe rather than idling
+    const uint64_t next_unpruned_height = tools::get_next_unpruned_block_height(span_start_height, blockchain_height, pruning_seed);
     MDEBUG("reserve_span: next_unpruned_height " << next_unpruned_height << " from " << span_start_height << " and seed "
-        << epee::string_tools::to_string_hex(pruning_seed) << ", limit " << span_start_height + CRYPTONOTE_PRUNING_STRIPE_SIZE);
-    if (next_unpruned_height > span_start_height && next_unpruned_height < span_start_height + CRYPTONOTE_PRUNING_STRIPE_SIZE)
+        << epee::string_tools::to_string_hex(pruning_seed) << ", limit " << block_hashes_start_height + block_hashes.size());
+    if (next_unpruned_height > span_start_height && next_unpruned_height < block_hashes_start_height + block_hashes.size())
     {
       MDEBUG("We can download from next span: ideal height " << span_start_height << ", next unpruned height " << next_unpruned_height <<
           "(+" << next_unpruned_height - span_start_height << "), current seed " << pruning_seed);
@@ -270,7 +395,6 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     }
   }
   MDEBUG("span_start_height: " <<span_start_height);
-  const uint64_t block_hashes_start_height = last_block_height - block_hashes.size() + 1;
   if (span_start_height >= block_hashes.size() + block_hashes_start_height)
   {
     MDEBUG("Out of hashes, cannot reserve");
@@ -284,7 +408,7 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     ++span_start_height;
   }
 
-  uint64_t span_length = 0;
+  uint64_t span_length = 0, span_weight = 0;
   std::vector<crypto::hash> hashes;
   bool first_is_pruned = sync_pruned_blocks && !tools::has_unpruned_block(span_start_height + span_length, blockchain_height, local_pruning_seed);
   while (i != block_hashes.end() && span_length < max_blocks && (sync_pruned_blocks || tools::has_unpruned_block(span_start_height + span_length, blockchain_height, pruning_seed)))
@@ -295,6 +419,13 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
       MDEBUG("Stopping at " << span_start_height + span_length << " for peer on stripe " << tools::get_pruning_stripe(pruning_seed) << " as we need full data for " << tools::get_pruning_stripe(local_pruning_seed));
       break;
     }
+    // where the block weights are known, stop at what the peer sends in the target time
+    if (max_weight && span_length > 0 && span_weight + (*i).second > max_weight)
+    {
+      MDEBUG("Stopping at " << span_start_height + span_length << " after " << span_weight << " bytes of blocks");
+      break;
+    }
+    span_weight += (*i).second;
     hashes.push_back((*i).first);
     ++i;
     ++span_length;
@@ -305,7 +436,7 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     return std::make_pair(0, 0);
   }
   MDEBUG("Reserving span " << span_start_height << " - " << (span_start_height + span_length - 1) << " for " << connection_id);
-  add_blocks(span_start_height, span_length, connection_id, addr, time);
+  add_blocks(span_start_height, span_length, connection_id, addr, time, max_weight ? span_weight : 0);
   set_span_hashes(span_start_height, connection_id, hashes);
   return std::make_pair(span_start_height, span_length);
 }
@@ -318,7 +449,7 @@ std::pair<uint64_t, uint64_t> block_queue::get_next_span_if_scheduled(std::vecto
   block_map::const_iterator i = blocks.begin();
   if (i == blocks.end())
     return std::make_pair(0, 0);
-  if (!i->blocks.empty())
+  if (i->filled())
     return std::make_pair(0, 0);
   hashes = i->hashes;
   connection_id = i->connection_id;
@@ -332,7 +463,7 @@ void block_queue::reset_next_span_time(boost::posix_time::ptime t)
   CHECK_AND_ASSERT_THROW_MES(!blocks.empty(), "No next span to reset time");
   block_map::iterator i = blocks.begin();
   CHECK_AND_ASSERT_THROW_MES(i != blocks.end(), "No next span to reset time");
-  CHECK_AND_ASSERT_THROW_MES(i->blocks.empty(), "Next span is not empty");
+  CHECK_AND_ASSERT_THROW_MES(!i->filled(), "Next span is not empty");
   (boost::posix_time::ptime&)i->time = t; // sod off, time doesn't influence sorting
 }
 
@@ -344,6 +475,7 @@ void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uui
     if (i->start_block_height == start_height && i->connection_id == connection_id)
     {
       span s = *i;
+      const_cast<span&>(*i).spilled = false; // s keeps the spilled blocks
       erase_block(i);
       s.hashes = std::move(hashes);
       for (const crypto::hash &h: s.hashes)
@@ -354,18 +486,25 @@ void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uui
   }
 }
 
-bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, epee::net_utils::network_address &addr, bool filled) const
+bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, epee::net_utils::network_address &addr, bool filled)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   if (blocks.empty())
     return false;
-  block_map::const_iterator i = blocks.begin();
+  block_map::iterator i = blocks.begin();
   for (; i != blocks.end(); ++i)
   {
-    if (!filled || !i->blocks.empty())
+    if (!filled || i->filled())
     {
+      if (i->spilled && !load_spilled_span(*i, bcel))
+      {
+        // it'll get downloaded again
+        erase_block(i);
+        return false;
+      }
       height = i->start_block_height;
-      bcel = i->blocks;
+      if (!i->spilled)
+        bcel = i->blocks;
       connection_id = i->connection_id;
       addr = i->origin;
       return true;
@@ -374,6 +513,29 @@ bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_
   return false;
 }
 
+bool block_queue::get_filled_span_at(uint64_t height, std::vector<cryptonote::block_complete_entry> &bcel)
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  for (block_map::iterator i = blocks.begin(); i != blocks.end(); ++i)
+  {
+    if (i->start_block_height > height)
+      break;
+    if (i->start_block_height == height && i->filled())
+    {
+      if (!i->spilled)
+      {
+        bcel = i->blocks;
+        return true;
+      }
+      if (load_spilled_span(*i, bcel))
+        return true;
+      erase_block(i);
+      return false;
+    }
+  }
+  return false;
+}
+
 bool block_queue::has_next_span(const boost::uuids::uuid &connection_id, bool &filled, boost::posix_time::ptime &time) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -384,7 +546,7 @@ bool block_queue::has_next_span(const boost::uuids::uuid &connection_id, bool &f
     return false;
   if (i->connection_id != connection_id)
     return false;
-  filled = !i->blocks.empty();
+  filled = i->filled();
   time = i->time;
   return true;
 }
@@ -399,7 +561,7 @@ bool block_queue::has_next_span(uint64_t height, bool &filled, boost::posix_time
     return false;
   if (i->start_block_height > height)
     return false;
-  filled = !i->blocks.empty();
+  filled = i->filled();
   time = i->time;
   connection_id = i->connection_id;
   return true;
@@ -410,10 +572,27 @@ size_t block_queue::get_data_size() const
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   size_t size = 0;
   for (const auto &span: blocks)
-    size += span.size;
+    if (!span.spilled)
+      size += span.size;
   return size;
 }
 
+size_t block_queue::get_spilled_size() const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  return spilled_size;
+}
+
+uint64_t block_queue::get_reserved_weight() const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  uint64_t weight = 0;
+  for (const auto &span: blocks)
+    if (!span.filled())
+      weight += span.expected_weight;
+  return weight;
+}
+
 size_t block_queue::get_num_filled_spans_prefix() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -422,7 +601,7 @@ size_t block_queue::get_num_filled_spans_prefix() const
     return 0;
   block_map::const_iterator i = blocks.begin();
   size_t size = 0;
-  while (i != blocks.end() && !i->blocks.empty())
+  while (i != blocks.end() && i->filled())
   {
     ++i;
     ++size;
@@ -435,7 +614,7 @@ size_t block_queue::get_num_filled_spans() const
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   size_t size = 0;
   for (const auto &span: blocks)
-  if (!span.blocks.empty())
+  if (span.filled())
     ++size;
   return size;
 }
@@ -472,27 +651,13 @@ bool block_queue::has_spans(const boost::uuids::uuid &connection_id) const
 float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  std::unordered_map<boost::uuids::uuid, float> speeds;
-  for (const auto &span: blocks)
-  {
-    if (span.blocks.empty())
-      continue;
-    // note that the average below does not average over the whole set, but over the
-    // previous pseudo average and the latest rate: this gives much more importance
-    // to the latest measurements, which is fine here
-    std::unordered_map<boost::uuids::uuid, float>::iterator i = speeds.find(span.connection_id);
-    if (i == speeds.end())
-      speeds.insert(std::make_pair(span.connection_id, span.rate));
-    else
-      i->second = (i->second + span.rate) / 2;
-  }
   float conn_rate = -1, best_rate = 0;
-  for (const auto &i: speeds)
+  for (const auto &i: peers)
   {
     if (i.first == connection_id)
-      conn_rate = i.second;
-    if (i.second > best_rate)
-      best_rate = i.second;
+      conn_rate = i.second.rate;
+    if (i.second.rate > best_rate)
+      best_rate = i.second.rate;
   }
 
   if (conn_rate <= 0)
@@ -508,28 +673,50 @@ float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 float block_queue::get_download_rate(const boost::uuids::uuid &connection_id) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  float conn_rate = -1.f;
-  for (const auto &span: blocks)
-  {
-    if (span.blocks.empty())
-      continue;
-    if (span.connection_id != connection_id)
-      continue;
-    // note that the average below does not average over the whole set, but over the
-    // previous pseudo average and the latest rate: this gives much more importance
-    // to the latest measurements, which is fine here
-    if (conn_rate < 0.f)
-      conn_rate = span.rate;
-    else
-      conn_rate = (conn_rate + span.rate) / 2;
-  }
-
-  if (conn_rate < 0)
-    conn_rate = 0.0f;
+  const auto i = peers.find(connection_id);
+  const float conn_rate = i == peers.end() ? 0.0f : i->second.rate;
   MTRACE("Download rate for " << connection_id << ": " << conn_rate << " b/s");
   return conn_rate;
 }
 
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end() || i->second.span_size == 0)
+    return std::min(default_blocks, max_blocks);
+  const uint64_t min_blocks = std::max<uint64_t>(1, default_blocks / 4);
+  return std::max(min_blocks, std::min(i->second.span_size, max_blocks));
+}
+
+uint64_t block_queue::get_span_weight(const boost::uuids::uuid &connection_id) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end() || i->second.nspans == 0)
+    return 0;
+  return i->second.rate * SPAN_TARGET_TIME;
+}
+
+bool block_queue::is_span_overdue(const boost::uuids::uuid &connection_id, float elapsed) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end() || i->second.nspans == 0)
+    return false;
+  return elapsed > SPAN_OVERDUE_FACTOR * std::max(i->second.span_time, SPAN_TARGET_TIME);
+}
+
+bool block_queue::get_peer_stats(const boost::uuids::uuid &connection_id, peer_stats &stats) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peers.find(connection_id);
+  if (i == peers.end())
+    return false;
+  stats = i->second;
+  return true;
+}
+
 bool block_queue::foreach(std::function<bool(const span&)> f) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -32,6 +32,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <set>
 #include <unordered_set>
 #include <boost/thread/recursive_mutex.hpp>
@@ -57,21 +58,33 @@ namespace cryptonote
       uint64_t nblocks;
       float rate;
       size_t size;
+      uint64_t expected_weight; // known weight of the blocks of a span not received yet, or 0
       boost::posix_time::ptime time;
       epee::net_utils::network_address origin{};
+      bool spilled; // filled, but the blocks were moved to disk
 
       span(uint64_t start_block_height, std::vector<cryptonote::block_complete_entry> blocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, float rate, size_t size):
-        start_block_height(start_block_height), blocks(std::move(blocks)), connection_id(connection_id), nblocks(this->blocks.size()), rate(rate), size(size), time(boost::date_time::min_date_time), origin(addr) {}
-      span(uint64_t start_block_height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time):
-        start_block_height(start_block_height), connection_id(connection_id), nblocks(nblocks), rate(0.0f), size(0), time(time), origin(addr) {}
+        start_block_height(start_block_height), blocks(std::move(blocks)), connection_id(connection_id), nblocks(this->blocks.size()), rate(rate), size(size), expected_weight(0), time(boost::date_time::min_date_time), origin(addr), spilled(false) {}
+      span(uint64_t start_block_height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time, uint64_t expected_weight = 0):
+        start_block_height(start_block_height), connection_id(connection_id), nblocks(nblocks), rate(0.0f), size(0), expected_weight(expected_weight), time(time), origin(addr), spilled(false) {}
 
+      bool filled() const { return spilled || !blocks.empty(); }
       bool operator<(const span &s) const { return start_block_height < s.start_block_height; }
     };
     typedef std::set<span> block_map;
 
+    // running averages over the spans a peer sent us, kept after these spans get flushed
+    struct peer_stats
+    {
+      float rate; // bytes per second
+      float span_time; // seconds from request to reception of a span
+      uint64_t span_size; // number of blocks to request next time
+      uint64_t nspans;
+    };
+
   public:
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, float rate, size_t size);
-    void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time = boost::date_time::min_date_time);
+    void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, boost::posix_time::ptime time = boost::date_time::min_date_time, uint64_t expected_weight = 0);
     void flush_spans(const boost::uuids::uuid &connection_id, bool all = false);
     void flush_stale_spans(const std::set<boost::uuids::uuid> &live_connections);
     bool remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes = NULL);
@@ -80,33 +93,50 @@ namespace cryptonote
     void print() const;
     std::string get_overview(uint64_t blockchain_height) const;
     bool has_unpruned_height(uint64_t block_height, uint64_t blockchain_height, uint32_t pruning_seed) const;
-    std::pair<uint64_t, uint64_t> reserve_span(uint64_t first_block_height, uint64_t last_block_height, uint64_t max_blocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, bool sync_pruned_blocks, uint32_t local_pruning_seed, uint32_t pruning_seed, uint64_t blockchain_height, const std::vector<std::pair<crypto::hash, uint64_t>> &block_hashes, boost::posix_time::ptime time = boost::posix_time::microsec_clock::universal_time());
+    std::pair<uint64_t, uint64_t> reserve_span(uint64_t first_block_height, uint64_t last_block_height, uint64_t max_blocks, const boost::uuids::uuid &connection_id, const epee::net_utils::network_address &addr, bool sync_pruned_blocks, uint32_t local_pruning_seed, uint32_t pruning_seed, uint64_t blockchain_height, const std::vector<std::pair<crypto::hash, uint64_t>> &block_hashes, uint64_t max_weight = 0, boost::posix_time::ptime time = boost::posix_time::microsec_clock::universal_time());
     uint64_t get_next_needed_height(uint64_t blockchain_height) const;
     std::pair<uint64_t, uint64_t> get_next_span_if_scheduled(std::vector<crypto::hash> &hashes, boost::uuids::uuid &connection_id, boost::posix_time::ptime &time) const;
     void reset_next_span_time(boost::posix_time::ptime t = boost::posix_time::microsec_clock::universal_time());
     void set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::vector<crypto::hash> hashes);
-    bool get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, epee::net_utils::network_address &addr, bool filled = true) const;
+    bool get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, epee::net_utils::network_address &addr, bool filled = true);
+    bool get_filled_span_at(uint64_t height, std::vector<cryptonote::block_complete_entry> &bcel);
     bool has_next_span(const boost::uuids::uuid &connection_id, bool &filled, boost::posix_time::ptime &time) const;
     bool has_next_span(uint64_t height, bool &filled, boost::posix_time::ptime &time, boost::uuids::uuid &connection_id) const;
     size_t get_data_size() const;
+    size_t get_spilled_size() const;
+    bool set_spill(const std::string &dir, size_t max_memory_size, size_t max_spill_size);
+    uint64_t get_reserved_weight() const;
     size_t get_num_filled_spans_prefix() const;
     size_t get_num_filled_spans() const;
     crypto::hash get_last_known_hash(const boost::uuids::uuid &connection_id) const;
     bool has_spans(const boost::uuids::uuid &connection_id) const;
     float get_speed(const boost::uuids::uuid &connection_id) const;
     float get_download_rate(const boost::uuids::uuid &connection_id) const;
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t default_blocks, uint64_t max_blocks) const;
+    uint64_t get_span_weight(const boost::uuids::uuid &connection_id) const;
+    bool is_span_overdue(const boost::uuids::uuid &connection_id, float elapsed) const;
+    bool get_peer_stats(const boost::uuids::uuid &connection_id, peer_stats &stats) const;
     bool foreach(std::function<bool(const span&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
 
   private:
     void erase_block(block_map::iterator j);
+    void update_peer_stats(const boost::uuids::uuid &connection_id, uint64_t nblocks, float rate, size_t size);
     inline bool requested_internal(const crypto::hash &hash) const;
+    std::string get_spill_filename(uint64_t start_block_height) const;
+    void spill_spans();
+    bool load_spilled_span(const span &s, std::vector<cryptonote::block_complete_entry> &bcel) const;
 
   private:
     block_map blocks;
     mutable boost::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    std::map<boost::uuids::uuid, peer_stats> peers;
+    std::string spill_dir;
+    size_t spill_max_memory_size = 0;
+    size_t spill_max_size = 0;
+    size_t spilled_size = 0;
   };
 }
@@ -0,0 +1,136 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <unordered_map>
+#include "int-util.h"
+#include "compact_block.h"
+
+namespace
+{
+  struct short_tx_id_data
+  {
+    uint64_t salt;
+    crypto::hash txid;
+  };
+  static_assert(sizeof(short_tx_id_data) == 8 + sizeof(crypto::hash), "Unexpected padding");
+
+  uint64_t get_short_tx_id(const crypto::hash &h)
+  {
+    uint64_t id = 0;
+    memcpy(&id, h.data, COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+    return SWAP64LE(id);
+  }
+}
+
+namespace cryptonote
+{
+  uint64_t get_short_tx_id(uint64_t salt, const crypto::hash &txid)
+  {
+    const short_tx_id_data data{SWAP64LE(salt), txid};
+    return ::get_short_tx_id(crypto::cn_fast_hash(&data, sizeof(data)));
+  }
+
+  std::vector<uint64_t> get_short_tx_ids(uint64_t salt, const std::vector<crypto::hash> &txids)
+  {
+    // same length inputs, so they can be hashed several at a time
+    std::vector<short_tx_id_data> data(txids.size());
+    std::vector<crypto::hash> hashes(txids.size());
+    std::vector<const void*> in(txids.size());
+    std::vector<char*> out(txids.size());
+    for (size_t i = 0; i < txids.size(); ++i)
+    {
+      data[i] = {SWAP64LE(salt), txids[i]};
+      in[i] = &data[i];
+      out[i] = hashes[i].data;
+    }
+    crypto::cn_fast_hash_multi(in.data(), sizeof(short_tx_id_data), out.data(), txids.size());
+
+    std::vector<uint64_t> short_ids;
+    short_ids.reserve(txids.size());
+    for (const crypto::hash &h: hashes)
+      short_ids.push_back(::get_short_tx_id(h));
+    return short_ids;
+  }
+
+  std::string pack_short_tx_ids(const std::vector<uint64_t> &short_ids)
+  {
+    std::string blob;
+    blob.reserve(short_ids.size() * COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+    for (uint64_t id: short_ids)
+    {
+      id = SWAP64LE(id);
+      blob.append(reinterpret_cast<const char*>(&id), COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+    }
+    return blob;
+  }
+
+  bool unpack_short_tx_ids(const std::string &blob, std::vector<uint64_t> &short_ids)
+  {
+    if (blob.size() % COMPACT_BLOCK_SHORT_TX_ID_SIZE)
+      return false;
+    short_ids.clear();
+    short_ids.reserve(blob.size() / COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+    for (size_t offset = 0; offset < blob.size(); offset += COMPACT_BLOCK_SHORT_TX_ID_SIZE)
+    {
+      uint64_t id = 0;
+      memcpy(&id, blob.data() + offset, COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+      short_ids.push_back(SWAP64LE(id));
+    }
+    return true;
+  }
+
+  size_t match_short_tx_ids(uint64_t salt, const std::vector<uint64_t> &short_ids, const std::vector<crypto::hash> &candidates, std::vector<crypto::hash> &tx_hashes)
+  {
+    tx_hashes.resize(short_ids.size(), crypto::null_hash);
+
+    // index the candidates by short id, with null hashes marking collisions
+    const std::vector<uint64_t> candidate_ids = get_short_tx_ids(salt, candidates);
+    std::unordered_map<uint64_t, crypto::hash> index;
+    index.reserve(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+      const auto res = index.emplace(candidate_ids[i], candidates[i]);
+      if (!res.second && res.first->second != candidates[i])
+        res.first->second = crypto::null_hash;
+    }
+
+    size_t missing = 0;
+    for (size_t i = 0; i < short_ids.size(); ++i)
+    {
+      if (tx_hashes[i] != crypto::null_hash)
+        continue;
+      const auto it = index.find(short_ids[i]);
+      if (it != index.end())
+        tx_hashes[i] = it->second;
+      if (tx_hashes[i] == crypto::null_hash)
+        ++missing;
+    }
+    return missing;
+  }
+}
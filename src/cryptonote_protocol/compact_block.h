@@ -0,0 +1,57 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "crypto/hash.h"
+
+#define COMPACT_BLOCK_SHORT_TX_ID_SIZE 6
+
+namespace cryptonote
+{
+  /*! Short tx ids identify the txes of a compact block: they are the first
+   *  COMPACT_BLOCK_SHORT_TX_ID_SIZE bytes of H(salt || txid), read as a little
+   *  endian integer. The salt is picked by the sender of each block, so that
+   *  nobody can grind txes colliding with others in every block.
+   */
+  uint64_t get_short_tx_id(uint64_t salt, const crypto::hash &txid);
+  std::vector<uint64_t> get_short_tx_ids(uint64_t salt, const std::vector<crypto::hash> &txids);
+
+  std::string pack_short_tx_ids(const std::vector<uint64_t> &short_ids);
+  bool unpack_short_tx_ids(const std::string &blob, std::vector<uint64_t> &short_ids);
+
+  /*! Fills tx_hashes with the candidate txids matching short_ids, in order.
+   *  Entries with no match, or with several, are left as null hashes, and
+   *  entries which are already non null are left untouched.
+   *  Returns the number of null hashes left.
+   */
+  size_t match_short_tx_ids(uint64_t salt, const std::vector<uint64_t> &short_ids, const std::vector<crypto::hash> &candidates, std::vector<crypto::hash> &tx_hashes);
+}
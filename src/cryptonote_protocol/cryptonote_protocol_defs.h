@@ -86,6 +86,12 @@ namespace cryptonote
 
     uint8_t address_type;
 
+    uint64_t txs_flooded;
+    uint64_t txs_reconciled;
+    uint64_t txs_reconciled_known;
+    uint64_t reconciliations;
+    uint64_t reconciliation_failures;
+
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(incoming)
       KV_SERIALIZE(localhost)
@@ -112,6 +118,11 @@ namespace cryptonote
       KV_SERIALIZE(height)
       KV_SERIALIZE(pruning_seed)
       KV_SERIALIZE(address_type)
+      KV_SERIALIZE_OPT(txs_flooded, (uint64_t)0)
+      KV_SERIALIZE_OPT(txs_reconciled, (uint64_t)0)
+      KV_SERIALIZE_OPT(txs_reconciled_known, (uint64_t)0)
+      KV_SERIALIZE_OPT(reconciliations, (uint64_t)0)
+      KV_SERIALIZE_OPT(reconciliation_failures, (uint64_t)0)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -368,12 +379,120 @@ namespace cryptonote
     struct request_t
     {
       std::vector<crypto::hash> hashes;
+      uint64_t salt;
+      std::string sketch; // see tx_sketch.h, replaces hashes when not empty
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_CONTAINER_POD_AS_BLOB(hashes)
+        KV_SERIALIZE_OPT(salt, (uint64_t)0)
+        KV_SERIALIZE_OPT(sketch, std::string())
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request_t
+    {
+      crypto::hash block_hash;
+      blobdata block; // without its tx hashes
+      uint64_t salt;
+      std::string short_tx_ids; // see compact_block.h
+      std::vector<uint64_t> prefilled_tx_indices;
+      std::vector<blobdata> prefilled_txs;
+      uint64_t current_blockchain_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE(block)
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(short_tx_ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(prefilled_tx_indices)
+        KV_SERIALIZE(prefilled_txs)
+        KV_SERIALIZE(current_blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /* Tx reconciliation, see levin_notify.cpp                              */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request_t
+    {
+      uint64_t salt;
+      uint64_t set_size;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(set_size)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  struct NOTIFY_TX_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+
+    struct request_t
+    {
+      std::string sketch; // see tx_sketch.h
+      uint64_t set_size;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(sketch)
+        KV_SERIALIZE(set_size)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  struct NOTIFY_TX_RECONCILIATION_DIFF
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 14;
+
+    struct request_t
+    {
+      bool success;
+      std::string short_tx_ids; // txes requested from the receiver, see compact_block.h
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(success)
+        KV_SERIALIZE(short_tx_ids)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
   };
-    
+
+  /************************************************************************/
+  /* Sent back when a NOTIFY_GET_TXPOOL_COMPLEMENT sketch fails to decode */
+  /************************************************************************/
+  struct NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 15;
+
+    struct request_t
+    {
+      uint64_t set_size;
+      uint64_t cells;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(set_size)
+        KV_SERIALIZE(cells)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
 }
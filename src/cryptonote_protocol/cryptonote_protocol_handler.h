@@ -35,7 +35,16 @@
 #pragma once
 
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "byte_slice.h"
 #include "math_helper.h"
@@ -69,7 +78,6 @@ namespace cryptonote
 			cryptonote_protocol_handler_base();
 			virtual ~cryptonote_protocol_handler_base();
 			void handler_request_blocks_history(std::list<crypto::hash>& ids); // before asking for list of objects, we can change the list still
-			void handler_response_blocks_now(size_t packet_size);
 			
 			virtual double get_avg_block_size() = 0;
 			virtual double estimate_one_block_size() noexcept; // for estimating size of blocks to download
@@ -84,6 +92,7 @@ namespace cryptonote
     typedef CORE_SYNC_DATA payload_type;
 
     t_cryptonote_protocol_handler(t_core& rcore, nodetool::i_p2p_endpoint<connection_context>* p_net_layout, bool offline = false);
+    ~t_cryptonote_protocol_handler();
 
     BEGIN_INVOKE_MAP2(cryptonote_protocol_handler)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_BLOCK, &cryptonote_protocol_handler::handle_notify_new_block)
@@ -95,6 +104,11 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
       HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_COMPLEMENT, &cryptonote_protocol_handler::handle_notify_get_txpool_complement)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TX_SKETCH, &cryptonote_protocol_handler::handle_request_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_SKETCH, &cryptonote_protocol_handler::handle_notify_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_RECONCILIATION_DIFF, &cryptonote_protocol_handler::handle_notify_tx_reconciliation_diff)
+      HANDLE_NOTIFY_T2(NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED, &cryptonote_protocol_handler::handle_notify_txpool_complement_sketch_failed)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -143,17 +157,33 @@ namespace cryptonote
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
     int handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_notify_tx_sketch(int command, NOTIFY_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_notify_tx_reconciliation_diff(int command, NOTIFY_TX_RECONCILIATION_DIFF::request& arg, cryptonote_connection_context& context);
+    int handle_notify_txpool_complement_sketch_failed(int command, NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const boost::uuids::uuid& source, epee::net_utils::zone zone, relay_method tx_relay);
     //----------------------------------------------------------------------------------
+    bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill_txids);
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
+    //! synchronizing peers per pruning stripe, and the stripes the sync still goes through
+    struct pruning_stripe_coverage
+    {
+      uint32_t next_stripe;             //!< stripe of the next height we need, 0 if unpruned
+      uint32_t n_stripes;               //!< stripes from next_stripe on the sync still needs, in order
+      unsigned int n_unpruned;          //!< peers with a full chain, which cover all stripes
+      std::vector<unsigned int> peers;  //!< peers on each stripe, indexed by stripe - 1
+    };
+    pruning_stripe_coverage get_pruning_stripe_coverage() const;
     bool should_drop_connection(cryptonote_connection_context& context, uint32_t next_stripe);
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks, bool force_next_span = false);
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     bool should_download_next_span(cryptonote_connection_context& context, bool standby);
+    size_t get_max_span_requests(const cryptonote_connection_context& context) const;
     bool should_ask_for_pruned_data(cryptonote_connection_context& context, uint64_t first_block_height, uint64_t nblocks, bool check_block_weights) const;
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     void drop_connection_with_score(cryptonote_connection_context &context, unsigned int score, bool flush_all_spans);
@@ -165,7 +195,21 @@ namespace cryptonote
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     size_t skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
     bool request_txpool_complement(cryptonote_connection_context &context);
+    bool request_txpool_complement_sketch(cryptonote_connection_context &context, size_t cells);
+    bool send_txpool_complement_from_sketch(NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context);
     void hit_score(cryptonote_connection_context &context, int32_t score);
+    struct pending_tx
+    {
+      blobdata blob;
+      boost::uuids::uuid source;
+      epee::net_utils::zone zone;
+      relay_method tx_relay;
+    };
+    //! verifies and relays a batch of txes from any number of peers, \return the peers which sent bad ones
+    std::set<boost::uuids::uuid> process_incoming_txs(std::vector<pending_tx>& txes);
+    bool queue_incoming_txs(std::vector<pending_tx>& txes);
+    void tx_verify_worker();
+    void stop_tx_verify_workers();
 
     t_core& m_core;
 
@@ -205,6 +249,12 @@ namespace cryptonote
 
     boost::mutex m_bad_peer_check_lock;
 
+    boost::mutex m_tx_verify_lock;
+    boost::condition_variable m_tx_verify_cond;
+    std::deque<pending_tx> m_tx_verify_queue; //!< relayed txes waiting to be coalesced into a batch
+    std::vector<boost::thread> m_tx_verify_threads;
+    bool m_tx_verify_stop;
+
     template<class t_parameter>
       bool post_notify(typename t_parameter::request& arg, cryptonote_connection_context& context)
       {
@@ -37,11 +37,15 @@
 
 #include <list>
 #include <ctime>
+#include <numeric>
+#include <boost/filesystem/path.hpp>
 
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
 #include "common/pruning.h"
+#include "cryptonote_protocol/compact_block.h"
+#include "cryptonote_protocol/tx_sketch.h"
 #include "common/util.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -65,6 +69,7 @@
 #define BLOCK_QUEUE_NSPANS_THRESHOLD 10 // chunks of N blocks
 #define BLOCK_QUEUE_SIZE_THRESHOLD (100*1024*1024) // MB
 #define BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS 1000
+#define MAX_SPAN_REQUESTS_IN_FLIGHT 3
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD_STANDBY (5 * 1000000) // microseconds
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (30 * 1000000) // microseconds
 #define IDLE_PEER_KICK_TIME (240 * 1000000) // microseconds
@@ -73,6 +78,10 @@
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
 #define DROP_PEERS_ON_SCORE -2
+#define TX_VERIFY_THREADS 2
+#define TX_VERIFY_MAX_PENDING_TXES 4096
+#define TX_ADMISSION_BATCH_SIZE 256
+#define TX_ADMISSION_WINDOW_MS 5
 
 namespace cryptonote
 {
@@ -87,7 +96,8 @@ namespace cryptonote
                                                                                                               m_synchronized(offline),
                                                                                                               m_ask_for_txpool_complement(true),
                                                                                                               m_stopping(false),
-                                                                                                              m_no_sync(false)
+                                                                                                              m_no_sync(false),
+                                                                                                              m_tx_verify_stop(false)
 
   {
     if(!m_p2p)
@@ -95,6 +105,12 @@ namespace cryptonote
   }
   //-----------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  t_cryptonote_protocol_handler<t_core>::~t_cryptonote_protocol_handler()
+  {
+    stop_tx_verify_workers();
+  }
+  //-----------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::init(const boost::program_options::variables_map& vm)
   {
     m_sync_timer.pause();
@@ -111,12 +127,105 @@ namespace cryptonote
     m_block_download_max_size = command_line::get_arg(vm, cryptonote::arg_block_download_max_size);
     m_sync_pruned_blocks = command_line::get_arg(vm, cryptonote::arg_sync_pruned_blocks);
 
+    // spans downloaded past the queue size go to disk rather than waiting to be requested again
+    const size_t spill_size = command_line::get_arg(vm, cryptonote::arg_block_download_spill_size);
+    if (spill_size)
+    {
+      const std::string spill_dir = (boost::filesystem::path(command_line::get_arg(vm, cryptonote::arg_data_dir)) / "block_queue").string();
+      if (!m_block_queue.set_spill(spill_dir, m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD, spill_size))
+        MWARNING("Failed to set up the block queue spill directory, downloaded blocks will stay in memory");
+    }
+
+    // tx batches are verified away from the network threads, so a slow
+    // verification does not stall every connection sharing the io_service
+    boost::unique_lock<boost::mutex> lock(m_tx_verify_lock);
+    m_tx_verify_stop = false;
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(THREAD_STACK_SIZE);
+    for (size_t i = m_tx_verify_threads.size(); i < TX_VERIFY_THREADS; ++i)
+      m_tx_verify_threads.push_back(boost::thread(attrs, boost::bind(&t_cryptonote_protocol_handler<t_core>::tx_verify_worker, this)));
+
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::deinit()
   {
+    stop_tx_verify_workers();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::stop_tx_verify_workers()
+  {
+    std::vector<boost::thread> threads;
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_verify_lock);
+      m_tx_verify_stop = true;
+      m_tx_verify_queue.clear(); // peers will relay those txes again
+      threads.swap(m_tx_verify_threads);
+    }
+    m_tx_verify_cond.notify_all();
+    for (boost::thread &thread: threads)
+    {
+      try { thread.join(); }
+      catch (...) { /* ignore */ }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::tx_verify_worker()
+  {
+    MLOG_SET_THREAD_NAME("[TXV]");
+    boost::unique_lock<boost::mutex> lock(m_tx_verify_lock);
+    while (true)
+    {
+      while (m_tx_verify_queue.empty() && !m_tx_verify_stop)
+        m_tx_verify_cond.wait(lock);
+      if (m_tx_verify_stop)
+        break;
+
+      // peers mostly send one tx at a time, give other peers' txes a moment
+      // to join so they are verified as one batch
+      const auto deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(TX_ADMISSION_WINDOW_MS);
+      while (m_tx_verify_queue.size() < TX_ADMISSION_BATCH_SIZE && !m_tx_verify_stop)
+        if (m_tx_verify_cond.wait_until(lock, deadline) == boost::cv_status::timeout)
+          break;
+      if (m_tx_verify_stop)
+        break;
+      if (m_tx_verify_queue.empty())
+        continue; // the other worker took them
+
+      const size_t n_txes = std::min<size_t>(m_tx_verify_queue.size(), TX_ADMISSION_BATCH_SIZE);
+      std::vector<pending_tx> batch(std::make_move_iterator(m_tx_verify_queue.begin()), std::make_move_iterator(m_tx_verify_queue.begin() + n_txes));
+      m_tx_verify_queue.erase(m_tx_verify_queue.begin(), m_tx_verify_queue.begin() + n_txes);
+      lock.unlock();
+      try
+      {
+        for (const boost::uuids::uuid &source: process_incoming_txs(batch))
+        {
+          m_p2p->for_connection(source, [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t f)->bool{
+            LOG_PRINT_CCONTEXT_L1("Tx verification failed, dropping connection");
+            drop_connection(context, false, false);
+            return true;
+          });
+        }
+      }
+      catch (const std::exception &e) { MERROR("Exception verifying relayed txes: " << e.what()); }
+      lock.lock();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::queue_incoming_txs(std::vector<pending_tx> &txes)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_tx_verify_lock);
+      if (m_tx_verify_threads.empty() || m_tx_verify_stop || m_tx_verify_queue.size() + txes.size() > TX_VERIFY_MAX_PENDING_TXES)
+        return false;
+      m_tx_verify_queue.insert(m_tx_verify_queue.end(), std::make_move_iterator(txes.begin()), std::make_move_iterator(txes.end()));
+    }
+    m_tx_verify_cond.notify_one();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -153,6 +262,7 @@ namespace cryptonote
             context.m_expect_response = 0;
             context.m_expect_height = 0;
             context.m_requested_objects.clear();
+            context.m_span_requests.clear();
             context.m_state = cryptonote_connection_context::state_standby; // we'll go back to adding, then (if we can't), download
           }
           else
@@ -324,6 +434,12 @@ namespace cryptonote
       cnx.pruning_seed = cntxt.m_pruning_seed;
       cnx.address_type = (uint8_t)cntxt.m_remote_address.get_type_id();
 
+      cnx.txs_flooded = cntxt.m_txs_flooded;
+      cnx.txs_reconciled = cntxt.m_txs_reconciled;
+      cnx.txs_reconciled_known = cntxt.m_txs_reconciled_known;
+      cnx.reconciliations = cntxt.m_reconciliations;
+      cnx.reconciliation_failures = cntxt.m_reconciliation_failures;
+
       connections.push_back(cnx);
 
       return true;
@@ -562,6 +678,9 @@ namespace cryptonote
     transaction miner_tx;
     if(parse_and_validate_block_from_blob(arg.b.block, new_block))
     {
+      // hash the block while its transactions are gathered
+      m_core.queue_block_pow(new_block);
+
       // This is a second notification, we must have asked for some missing tx
       if(!context.m_requested_objects.empty())
       {
@@ -598,6 +717,9 @@ namespace cryptonote
       transaction tx;
       crypto::hash tx_hash;
 
+      // the txes we did not have are likely missing from other peers' pools too
+      std::unordered_set<crypto::hash> new_txids;
+
       for(auto& tx_blob: arg.b.txs)
       {
         if(parse_and_validate_tx_from_blob(tx_blob.blob, tx))
@@ -663,6 +785,7 @@ namespace cryptonote
           if(!m_core.pool_has_tx(tx_hash))
           {
             MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+            new_txids.insert(tx_hash);
             cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);                        
             if(!m_core.handle_incoming_tx(tx_blob, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
             {
@@ -806,7 +929,7 @@ namespace cryptonote
           NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
           reg_arg.current_blockchain_height = arg.current_blockchain_height;
           reg_arg.b = b;
-          relay_block(reg_arg, context);
+          relay_block(reg_arg, context, new_txids);
         }
         else if( bvc.m_marked_as_orphaned )
         {
@@ -948,10 +1071,16 @@ namespace cryptonote
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context)
   {
-    MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_COMPLEMENT (" << arg.hashes.size() << " txes)");
+    MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_COMPLEMENT (" << arg.hashes.size() << " txes, " << arg.sketch.size() << " sketch bytes)");
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
+    if (!arg.sketch.empty())
+    {
+      send_txpool_complement_from_sketch(arg, context);
+      return 1;
+    }
+
     std::vector<std::pair<cryptonote::blobdata, block>> local_blocks;
     std::vector<cryptonote::blobdata> local_txs;
 
@@ -976,6 +1105,215 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::send_txpool_complement_from_sketch(NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context)
+  {
+    tx_sketch sketch;
+    if (!sketch.parse(arg.sketch))
+    {
+      LOG_DEBUG_CC(context, "Invalid txpool complement sketch, dropping connection");
+      drop_connection(context, false, false);
+      return false;
+    }
+
+    std::vector<crypto::hash> pool_txids;
+    if (!m_core.get_pool_transaction_hashes(pool_txids, false))
+    {
+      LOG_ERROR_CCONTEXT("failed to get txpool hashes");
+      return false;
+    }
+
+    // ours minus theirs leaves the txes only we have on the local side
+    const std::vector<uint64_t> short_ids = get_short_tx_ids(arg.salt, pool_txids);
+    tx_sketch local(sketch.cells());
+    for (const uint64_t short_id: short_ids)
+      local.add(short_id);
+    std::vector<uint64_t> local_only, remote_only;
+    if (!local.subtract(sketch) || !local.decode(local_only, remote_only))
+    {
+      NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::request failed;
+      failed.set_size = pool_txids.size();
+      failed.cells = sketch.cells();
+      MLOG_P2P_MESSAGE("-->>NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED: set_size=" << failed.set_size << ", cells=" << failed.cells);
+      post_notify<NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED>(failed, context);
+      return true;
+    }
+
+    std::vector<crypto::hash> txids;
+    match_short_tx_ids(arg.salt, local_only, pool_txids, txids);
+
+    NOTIFY_NEW_TRANSACTIONS::request new_txes;
+    for (const crypto::hash &txid: txids)
+    {
+      cryptonote::blobdata blob;
+      if (txid != crypto::null_hash && m_core.get_pool_transaction(txid, blob, relay_category::broadcasted))
+        new_txes.txs.push_back(std::move(blob));
+    }
+    if (new_txes.txs.empty())
+      return true;
+
+    MLOG_P2P_MESSAGE("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << new_txes.txs.size() << " (txpool complement from sketch)");
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(new_txes, context);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_txpool_complement_sketch_failed(int command, NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED (" << arg.set_size << " txes, " << arg.cells << " cells)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    // only a failure of the sketch we sent gets a retry, anything else
+    // would have us send our pool on the peer's say so
+    if (context.m_txpool_complement_sketch_cells == 0 || arg.cells != context.m_txpool_complement_sketch_cells)
+    {
+      LOG_DEBUG_CC(context, "Ignoring NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED for a sketch we did not send");
+      return 1;
+    }
+    context.m_txpool_complement_sketch_cells = 0;
+
+    // retry with a sketch sized for the difference the peer's pool size
+    // suggests, growing each time so this ends with the plain hash list
+    std::vector<crypto::hash> pool_txids;
+    m_core.get_pool_transaction_hashes(pool_txids, false);
+    size_t cells = tx_sketch::get_cell_count(pool_txids.size(), arg.set_size);
+    if (cells <= arg.cells)
+      cells = std::min<uint64_t>(arg.cells * 4, CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS);
+    if (cells <= arg.cells)
+      request_txpool_complement(context);
+    else
+      request_txpool_complement_sketch(context, cells);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_SKETCH (" << arg.set_size << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    m_p2p->on_tx_sketch_request(context, arg.salt, arg.set_size);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_sketch(int command, NOTIFY_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_SKETCH (" << arg.set_size << " txes, " << arg.sketch.size() << " bytes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    m_p2p->on_tx_sketch(context, std::move(arg.sketch));
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_reconciliation_diff(int command, NOTIFY_TX_RECONCILIATION_DIFF::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_RECONCILIATION_DIFF (" << (arg.success ? "" : "failed, ") << arg.short_tx_ids.size() / COMPACT_BLOCK_SHORT_TX_ID_SIZE << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    m_p2p->on_tx_reconciliation_diff(context, arg.success, std::move(arg.short_tx_ids));
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", "
+        << arg.short_tx_ids.size() / COMPACT_BLOCK_SHORT_TX_ID_SIZE << " txes, " << arg.prefilled_txs.size() << " prefilled)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized()) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+    if(m_core.have_block(arg.block_hash))
+      return 1;
+
+    block b;
+    std::vector<uint64_t> short_ids;
+    if(!parse_and_validate_block_from_blob(arg.block, b) || !b.tx_hashes.empty() || !unpack_short_tx_ids(arg.short_tx_ids, short_ids)
+        || arg.prefilled_tx_indices.size() != arg.prefilled_txs.size())
+    {
+      LOG_ERROR_CCONTEXT("sent invalid compact block, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // prefilled txes are known by their contents
+    std::vector<crypto::hash> tx_hashes(short_ids.size(), crypto::null_hash);
+    std::vector<crypto::hash> prefilled_tx_hashes;
+    prefilled_tx_hashes.reserve(arg.prefilled_txs.size());
+    for(size_t i = 0; i < arg.prefilled_txs.size(); ++i)
+    {
+      const uint64_t tx_idx = arg.prefilled_tx_indices[i];
+      transaction tx;
+      crypto::hash tx_hash;
+      if(tx_idx >= tx_hashes.size() || tx_hashes[tx_idx] != crypto::null_hash || !parse_and_validate_tx_from_blob(arg.prefilled_txs[i], tx, tx_hash))
+      {
+        LOG_ERROR_CCONTEXT("sent invalid prefilled tx in compact block, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      tx_hashes[tx_idx] = tx_hash;
+      prefilled_tx_hashes.push_back(tx_hash);
+    }
+
+    // the others should be in our pool
+    std::vector<crypto::hash> pool_txids;
+    m_core.get_pool_transaction_hashes(pool_txids, false);
+    const size_t missing = match_short_tx_ids(arg.salt, short_ids, pool_txids, tx_hashes);
+    MDEBUG(context << " compact block " << arg.block_hash << ": " << short_ids.size() - arg.prefilled_txs.size() - missing
+        << " txes found in pool, " << missing << " missing");
+
+    if(missing == 0)
+    {
+      b.tx_hashes = std::move(tx_hashes);
+      b.invalidate_hashes();
+      if(get_block_hash(b) == arg.block_hash)
+      {
+        // now a fluffy block, with the prefilled txes as the ones which came with it
+        NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+        fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+        fluffy_arg.b.block = block_to_blob(b);
+        fluffy_arg.b.txs.reserve(arg.prefilled_txs.size());
+        for(auto &tx_blob: arg.prefilled_txs)
+          fluffy_arg.b.txs.push_back({std::move(tx_blob), crypto::null_hash});
+        return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_arg, context);
+      }
+
+      // a short id matched another tx, ask for the block with its tx hashes
+      MDEBUG(context << " compact block " << arg.block_hash << " does not match its reconstruction, requesting it");
+      tx_hashes.clear();
+    }
+
+    // keep the prefilled txes so they do not need to be sent again with the missing ones
+    for(size_t i = 0; i < arg.prefilled_txs.size(); ++i)
+    {
+      if(m_core.pool_has_tx(prefilled_tx_hashes[i]))
+        continue;
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if(!m_core.handle_incoming_tx({arg.prefilled_txs[i], crypto::null_hash}, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    for(size_t i = 0; i < tx_hashes.size(); ++i)
+      if(tx_hashes[i] == crypto::null_hash)
+        missing_tx_req.missing_tx_indices.push_back(i);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
@@ -1007,58 +1345,105 @@ namespace cryptonote
     relay_method tx_relay = zone == epee::net_utils::zone::public_ ?
       relay_method::stem : relay_method::forward;
 
-    std::vector<blobdata> stem_txs{};
-    std::vector<blobdata> fluff_txs{};
     if (arg.dandelionpp_fluff)
-    {
       tx_relay = relay_method::fluff;
-      fluff_txs.reserve(arg.txs.size());
-    }
-    else
-      stem_txs.reserve(arg.txs.size());
 
-    for (auto& tx : arg.txs)
+    // Verification goes to the tx workers when they have room, where txes from
+    // all peers are coalesced into batches. Once they fall behind, the txes are
+    // verified inline, which stops reading from this peer until it is done.
+    std::vector<pending_tx> txes;
+    txes.reserve(arg.txs.size());
+    for (blobdata &blob: arg.txs)
+      txes.push_back({std::move(blob), context.m_connection_id, zone, tx_relay});
+    if (!queue_incoming_txs(txes) && !process_incoming_txs(txes).empty())
     {
-      tx_verification_context tvc{};
-      if (!m_core.handle_incoming_tx({tx, crypto::null_hash}, tvc, tx_relay, true))
+      LOG_PRINT_CCONTEXT_L1("Tx verification failed, dropping connection");
+      drop_connection(context, false, false);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  std::set<boost::uuids::uuid> t_cryptonote_protocol_handler<t_core>::process_incoming_txs(std::vector<pending_tx>& txes)
+  {
+    // the same tx often comes from several peers at once, verify it once
+    std::unordered_map<crypto::hash, size_t> unique_ids;
+    std::vector<size_t> unique_of(txes.size());
+    std::vector<size_t> unique;
+    std::set<boost::uuids::uuid> sources;
+    for (size_t i = 0; i < txes.size(); ++i)
+    {
+      sources.insert(txes[i].source);
+      const auto it = unique_ids.emplace(get_blob_hash(txes[i].blob), unique.size());
+      if (it.second)
+        unique.push_back(i);
+      unique_of[i] = it.first->second;
+    }
+
+    // core takes one relay method per call
+    std::vector<tx_verification_context> tvcs(unique.size());
+    for (const relay_method tx_relay: {relay_method::stem, relay_method::forward, relay_method::fluff})
+    {
+      std::vector<tx_blob_entry> blobs;
+      std::vector<size_t> indices;
+      for (size_t u = 0; u < unique.size(); ++u)
       {
-        LOG_PRINT_CCONTEXT_L1("Tx verification failed, dropping connection");
-        drop_connection(context, false, false);
-        return 1;
+        if (txes[unique[u]].tx_relay != tx_relay)
+          continue;
+        blobs.push_back({std::move(txes[unique[u]].blob), crypto::null_hash});
+        indices.push_back(u);
+      }
+      if (blobs.empty())
+        continue;
+      std::vector<tx_verification_context> batch_tvcs(blobs.size());
+      m_core.handle_incoming_txs(blobs, batch_tvcs, tx_relay, true);
+      for (size_t k = 0; k < indices.size(); ++k)
+      {
+        txes[unique[indices[k]]].blob = std::move(blobs[k].blob);
+        tvcs[indices[k]] = batch_tvcs[k];
       }
+    }
+
+    std::set<boost::uuids::uuid> failed;
+    for (size_t i = 0; i < txes.size(); ++i)
+      if (tvcs[unique_of[i]].m_verifivation_failed)
+        failed.insert(txes[i].source);
+    MDEBUG("Verified a batch of " << txes.size() << " relayed txes, " << unique.size() << " unique, from " << sources.size() << " peers");
 
-      switch (tvc.m_relay)
+    // relay new txes on behalf of the first peer which sent them, and
+    // nothing from peers which sent bad ones
+    std::map<std::pair<boost::uuids::uuid, bool>, NOTIFY_NEW_TRANSACTIONS::request> relays;
+    std::map<boost::uuids::uuid, epee::net_utils::zone> zones;
+    for (size_t u = 0; u < unique.size(); ++u)
+    {
+      pending_tx &tx = txes[unique[u]];
+      if (failed.count(tx.source))
+        continue;
+      bool fluff;
+      switch (tvcs[u].m_relay)
       {
         case relay_method::local:
         case relay_method::stem:
-          stem_txs.push_back(std::move(tx));
+          fluff = false;
           break;
         case relay_method::block:
         case relay_method::fluff:
-          fluff_txs.push_back(std::move(tx));
+          fluff = true;
           break;
         default:
         case relay_method::forward: // not supposed to happen here
         case relay_method::none:
-          break;
+          continue;
       }
-    }
-
-    if (!stem_txs.empty())
-    {
+      NOTIFY_NEW_TRANSACTIONS::request &arg = relays[std::make_pair(tx.source, fluff)];
       //TODO: add announce usage here
-      arg.dandelionpp_fluff = false;
-      arg.txs = std::move(stem_txs);
-      relay_transactions(arg, context.m_connection_id, context.m_remote_address.get_zone(), relay_method::stem);
+      arg.dandelionpp_fluff = fluff;
+      arg.txs.push_back(std::move(tx.blob));
+      zones[tx.source] = tx.zone;
     }
-    if (!fluff_txs.empty())
-    {
-      //TODO: add announce usage here
-      arg.dandelionpp_fluff = true;
-      arg.txs = std::move(fluff_txs);
-      relay_transactions(arg, context.m_connection_id, context.m_remote_address.get_zone(), relay_method::fluff);
-    }
-    return 1;
+    for (auto &e: relays)
+      relay_transactions(e.second, e.first.first, zones[e.first.first], e.first.second ? relay_method::fluff : relay_method::stem);
+    return failed;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -1119,7 +1504,8 @@ namespace cryptonote
     MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_GET_OBJECTS (" << arg.blocks.size() << " blocks)");
     MLOG_PEER_STATE("received objects");
 
-    boost::posix_time::ptime request_time = context.m_last_request_time;
+    const boost::posix_time::ptime request_time = context.m_last_request_time;
+    const uint64_t expect_height = context.m_expect_height;
     context.m_last_request_time = boost::date_time::not_a_date_time;
 
     if (context.m_expect_response != NOTIFY_RESPONSE_GET_OBJECTS::ID)
@@ -1128,7 +1514,24 @@ namespace cryptonote
       drop_connection(context, true, false);
       return 1;
     }
-    context.m_expect_response = 0;
+
+    // this answers the oldest span we asked for. If another one is in flight, the
+    // peer starts sending it now, so its timing starts now too
+    size_t expect_nblocks = 0;
+    if (!context.m_span_requests.empty())
+    {
+      expect_nblocks = context.m_span_requests.front().nblocks;
+      context.m_span_requests.pop_front();
+    }
+    if (context.m_span_requests.empty())
+    {
+      context.m_expect_response = 0;
+    }
+    else
+    {
+      context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
+      context.m_expect_height = context.m_span_requests.front().start_height;
+    }
 
     // calculate size of request
     size_t size = 0;
@@ -1216,7 +1619,7 @@ namespace cryptonote
       if (start_height == std::numeric_limits<uint64_t>::max())
       {
         start_height = boost::get<txin_gen>(b.miner_tx.vin[0]).height;
-        if (start_height > context.m_expect_height)
+        if (start_height > expect_height)
         {
           LOG_ERROR_CCONTEXT("sent block ahead of expected height, dropping connection");
           drop_connection(context, false, false);
@@ -1247,7 +1650,7 @@ namespace cryptonote
       block_hashes.push_back(block_hash);
     }
 
-    if(!context.m_requested_objects.empty())
+    if(context.m_span_requests.empty() ? !context.m_requested_objects.empty() : block_hashes.size() != expect_nblocks)
     {
       MERROR(context << "returned not all requested objects (context.m_requested_objects.size()="
         << context.m_requested_objects.size() << "), dropping connection");
@@ -1312,7 +1715,7 @@ namespace cryptonote
       const boost::posix_time::time_duration dt = now - request_time;
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
-      m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, context.m_remote_address, rate, blocks_size);
+      m_block_queue.add_blocks(start_height, std::move(arg.blocks), context.m_connection_id, context.m_remote_address, rate, blocks_size);
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1522,6 +1925,14 @@ namespace cryptonote
             return 1;
           }
 
+          // start hashing the next span while this one is verified and committed
+          if (!pblocks.empty())
+          {
+            std::vector<cryptonote::block_complete_entry> next_blocks;
+            if (m_block_queue.get_filled_span_at(start_height + blocks.size(), next_blocks))
+              m_core.prefetch_incoming_blocks_pow(start_height + blocks.size(), next_blocks);
+          }
+
           uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
           size_t num_txs = 0, blockidx = 0;
           for(const block_complete_entry& block_entry: blocks)
@@ -1880,6 +2291,22 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  size_t t_cryptonote_protocol_handler<t_core>::get_max_span_requests(const cryptonote_connection_context& context) const
+  {
+    // a chain request's answer is small, so it takes about a round trip, while a span takes a
+    // round trip plus its transfer: keep enough spans in flight to cover the round trip
+    block_queue::peer_stats stats;
+    if (context.m_chain_response_time <= 0.0f || !m_block_queue.get_peer_stats(context.m_connection_id, stats) || stats.nspans == 0)
+      return 1;
+    const float rtt = context.m_chain_response_time;
+    const float transfer_time = std::max(stats.span_time - rtt, stats.span_time / 4);
+    if (transfer_time <= 0.0f)
+      return 1;
+    const size_t n = 1 + (size_t)std::ceil(rtt / transfer_time);
+    return std::min<size_t>(n, MAX_SPAN_REQUESTS_IN_FLIGHT);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::should_download_next_span(cryptonote_connection_context& context, bool standby)
   {
     std::vector<crypto::hash> hashes;
@@ -1908,6 +2335,15 @@ skip:
           return true;
         }
 
+        // don't wait for the timeout if the peer which has it is taking a lot longer than it
+        // usually does, and we are faster
+        if (connection_id != context.m_connection_id && m_block_queue.is_span_overdue(connection_id, dt/1e6f)
+            && m_block_queue.get_download_rate(context.m_connection_id) > m_block_queue.get_download_rate(connection_id))
+        {
+          MDEBUG(context << " we should download it as it is overdue from " << connection_id << " after " << dt/1e6);
+          return true;
+        }
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         const double dl_speed = context.m_max_speed_down;
@@ -2014,6 +2450,17 @@ skip:
       // TODO: investigate tallying by zone and comparing to max out peers by zone
       const unsigned int max_out_peers = get_max_out_peers(epee::net_utils::zone::public_);
       const uint32_t distance = (peer_stripe + (1<<CRYPTONOTE_PRUNING_LOG_STRIPES) - next_stripe) % (1<<CRYPTONOTE_PRUNING_LOG_STRIPES);
+      // once the next stripe is covered, keep the only peer on a stripe the sync gets to later,
+      // dropping it would just mean stalling there until another one is found
+      if (n_peers_on_next_stripe > 0)
+      {
+        const pruning_stripe_coverage coverage = get_pruning_stripe_coverage();
+        if (coverage.n_unpruned == 0 && distance < coverage.n_stripes && peer_stripe <= coverage.peers.size() && coverage.peers[peer_stripe - 1] <= 1)
+        {
+          MDEBUG(context << "This peer is our only one on stripe " << peer_stripe << ", which we need " << distance << " stripes after " << next_stripe << ", not dropping");
+          return false;
+        }
+      }
       if ((n_out_peers >= max_out_peers && n_peers_on_next_stripe == 0) || (distance > 1 && n_peers_on_next_stripe <= 2) || distance > 2)
       {
         MDEBUG(context << "we want seed " << next_stripe << ", and either " << n_out_peers << " is at max out peers ("
@@ -2074,6 +2521,10 @@ skip:
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks, bool force_next_span)
   {
+    // the peer already has as many spans to send us as it takes to keep its link busy
+    if (!context.m_span_requests.empty() && (context.m_expect_response != NOTIFY_RESPONSE_GET_OBJECTS::ID || context.m_span_requests.size() >= get_max_span_requests(context)))
+      return true;
+
     // flush stale spans
     std::set<boost::uuids::uuid> live_connections;
     m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
@@ -2096,6 +2547,8 @@ skip:
         const uint32_t peer_stripe = tools::get_pruning_stripe(context.m_pruning_seed);
         const uint32_t local_stripe = tools::get_pruning_stripe(m_core.get_blockchain_pruning_seed());
         const size_t block_queue_size_threshold = m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD;
+        // spans in flight whose weight we know count too, so heavy ones can't pile up past the threshold
+        size += m_block_queue.get_reserved_weight();
         bool queue_proceed = nspans < BLOCK_QUEUE_NSPANS_THRESHOLD || size < block_queue_size_threshold;
         // get rid of blocks we already requested, or already have
         if (skip_unneeded_hashes(context, true) && context.m_needed_objects.empty() && context.m_num_requested == 0)
@@ -2118,7 +2571,10 @@ skip:
         else
           next_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         bool stripe_proceed_main = ((m_sync_pruned_blocks && local_stripe && add_stripe != local_stripe) || add_stripe == 0 || peer_stripe == 0 || add_stripe == peer_stripe) && (next_block_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS || next_needed_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS);
-        bool stripe_proceed_secondary = tools::has_unpruned_block(next_block_height, context.m_remote_blockchain_height, context.m_pruning_seed);
+        // a peer which does not have the next block can still download the first blocks of its own
+        // stripe in the hashes it sent us, reserve_span routes it there
+        const uint64_t last_block_height = context.m_needed_objects.empty() ? next_block_height : context.m_last_response_height;
+        bool stripe_proceed_secondary = tools::get_next_unpruned_block_height(next_block_height, context.m_remote_blockchain_height, context.m_pruning_seed) <= last_block_height;
         bool proceed = stripe_proceed_main || (queue_proceed && stripe_proceed_secondary);
         if (!stripe_proceed_main && !stripe_proceed_secondary && should_drop_connection(context, tools::get_pruning_stripe(next_block_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES)))
         {
@@ -2154,6 +2610,10 @@ skip:
           break;
         }
 
+        // still waiting for a span, we'll be back here when it arrives
+        if (!context.m_span_requests.empty())
+          return true;
+
         // this one triggers if all threads are in standby, which should not happen,
         // but happened at least once, so we unblock at least one thread if so
         boost::unique_lock<boost::mutex> sync{m_sync_lock, boost::try_to_lock};
@@ -2264,7 +2724,20 @@ skip:
         const uint64_t first_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         static const uint64_t bp_fork_height = m_core.get_earliest_ideal_height_for_version(8);
         bool sync_pruned_blocks = m_sync_pruned_blocks && first_block_height >= bp_fork_height && m_core.get_blockchain_pruning_seed();
-        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, count_limit, context.m_connection_id, context.m_remote_address, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
+        // size the span after how fast that peer sent us its previous ones, up to twice the default
+        const size_t max_count = std::max<size_t>(count_limit, std::min<size_t>(2 * count_limit, CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT));
+        const uint64_t span_size = m_block_queue.get_span_size(context.m_connection_id, count_limit, max_count);
+        // the weights the peer sent were checked against the compiled in hashes there, so the
+        // span can be cut to what that peer sends in the target time rather than a block count,
+        // and to a share of the queue, so heavy stretches get split over more peers
+        uint64_t span_weight = 0;
+        if (m_core.is_within_compiled_block_hash_area(first_block_height))
+        {
+          const uint64_t max_span_weight = (m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD) / BLOCK_QUEUE_NSPANS_THRESHOLD;
+          const uint64_t peer_span_weight = m_block_queue.get_span_weight(context.m_connection_id);
+          span_weight = peer_span_weight ? std::min(peer_span_weight, max_span_weight) : max_span_weight;
+        }
+        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, span_size, context.m_connection_id, context.m_remote_address, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects, span_weight);
         MDEBUG(context << " span from " << first_block_height << ": " << span.first << "/" << span.second);
         if (span.second > 0)
         {
@@ -2346,9 +2819,13 @@ skip:
             return false;
           }
         }
-        context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
-        context.m_expect_height = span.first;
+        if (context.m_span_requests.empty())
+        {
+          context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
+          context.m_expect_height = span.first;
+        }
         context.m_expect_response = NOTIFY_RESPONSE_GET_OBJECTS::ID;
+        context.m_span_requests.push_back({span.first, req.blocks.size()});
         MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size()
             << "requested blocks count=" << count << " / " << count_limit << " from " << span.first << ", first hash " << req.blocks.front());
         //epee::net_utils::network_throttle_manager::get_global_throttle_inreq().logger_handle_net("log/dr-monero/net/req-all.data", sec, get_avg_block_size());
@@ -2361,9 +2838,20 @@ skip:
         context.m_num_requested += req.blocks.size();
         post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);
         MLOG_PEER_STATE("requesting objects");
+
+        // on links with a long round trip, ask for the next span before this one comes back
+        if (!context.m_needed_objects.empty() && context.m_span_requests.size() < get_max_span_requests(context))
+        {
+          MDEBUG(context << " pipelining another span request, " << context.m_span_requests.size() << " in flight");
+          return request_missing_objects(context, false, false);
+        }
         return true;
       }
 
+      // nothing more to ask for now, but a span is still on its way
+      if (!context.m_span_requests.empty())
+        return true;
+
       // we can do nothing, so drop this peer to make room for others unless we think we've downloaded all we need
       const uint64_t blockchain_height = m_core.get_current_blockchain_height();
       if (std::max(blockchain_height, m_block_queue.get_next_needed_height(blockchain_height)) >= m_core.get_target_blockchain_height())
@@ -2377,6 +2865,9 @@ skip:
     }
 
 skip:
+    // we can't ask for more hashes before the spans in flight are in
+    if (!context.m_span_requests.empty())
+      return true;
     context.m_needed_objects.clear();
 
     // we might have been called from the "received chain entry" handler, and end up
@@ -2519,7 +3010,10 @@ skip:
           MDEBUG(context << "not ready, ignoring");
           return true;
         }
-        if (!request_txpool_complement(context))
+        const bool requested = support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION ?
+            request_txpool_complement_sketch(context, CRYPTONOTE_TXPOOL_COMPLEMENT_SKETCH_CELLS) :
+            request_txpool_complement(context);
+        if (!requested)
         {
           MERROR(context << "Failed to request txpool complement");
           return true;
@@ -2564,6 +3058,11 @@ skip:
       return 1;
     }
 
+    if (context.m_last_request_time != boost::date_time::not_a_date_time)
+    {
+      const float dt = (boost::posix_time::microsec_clock::universal_time() - context.m_last_request_time).total_microseconds() / 1e6f;
+      context.m_chain_response_time = context.m_chain_response_time > 0.0f ? (context.m_chain_response_time + dt) / 2 : dt;
+    }
     context.m_last_request_time = boost::date_time::not_a_date_time;
 
     m_sync_download_chain_size += arg.m_block_ids.size() * sizeof(crypto::hash);
@@ -2709,6 +3208,12 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, {});
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash> &prefill_txids)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -2716,14 +3221,19 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy ones and others
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       // peer_id also filters out connections before handshake
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT TX IDS");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
@@ -2737,6 +3247,42 @@ skip:
       return true;
     });
 
+    // compact blocks carry short tx ids instead of the tx hashes, and the txes we
+    // expect them not to have, so they can usually be completed from their pool
+    if (!compactConnections.empty())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      block b;
+      if (parse_and_validate_block_from_blob(arg.b.block, b, compact_arg.block_hash))
+      {
+        compact_arg.current_blockchain_height = arg.current_blockchain_height;
+        compact_arg.salt = crypto::rand<uint64_t>();
+        compact_arg.short_tx_ids = pack_short_tx_ids(get_short_tx_ids(compact_arg.salt, b.tx_hashes));
+        if (!prefill_txids.empty() && arg.b.txs.size() == b.tx_hashes.size())
+        {
+          for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+          {
+            if (prefill_txids.find(b.tx_hashes[i]) == prefill_txids.end())
+              continue;
+            compact_arg.prefilled_tx_indices.push_back(i);
+            compact_arg.prefilled_txs.push_back(arg.b.txs[i].blob);
+          }
+        }
+        b.tx_hashes.clear();
+        b.invalidate_hashes();
+        compact_arg.block = block_to_blob(b);
+
+        epee::levin::message_writer compactBlob{8 * 1024};
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob.buffer);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, std::move(compactBlob), std::move(compactConnections));
+      }
+      else
+      {
+        MERROR("Failed to parse block to relay, relaying as fluffy block");
+        fluffyConnections.insert(fluffyConnections.end(), compactConnections.begin(), compactConnections.end());
+      }
+    }
+
     // send fluffy ones first, we want to encourage people to run that
     if (!fluffyConnections.empty())
     {
@@ -2781,6 +3327,32 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::request_txpool_complement_sketch(cryptonote_connection_context &context, size_t cells)
+  {
+    std::vector<crypto::hash> pool_txids;
+    if (!m_core.get_pool_transaction_hashes(pool_txids, false))
+    {
+      MERROR("Failed to get txpool hashes");
+      return false;
+    }
+    // a small pool costs less to list than to sketch
+    if (cells * TX_SKETCH_CELL_SIZE >= pool_txids.size() * sizeof(crypto::hash))
+      return request_txpool_complement(context);
+
+    NOTIFY_GET_TXPOOL_COMPLEMENT::request r = {};
+    r.salt = crypto::rand<uint64_t>();
+    tx_sketch sketch(cells);
+    for (const uint64_t short_id: get_short_tx_ids(r.salt, pool_txids))
+      sketch.add(short_id);
+    r.sketch = sketch.serialize();
+    MLOG_P2P_MESSAGE("-->>NOTIFY_GET_TXPOOL_COMPLEMENT: " << pool_txids.size() << " txes in " << sketch.cells() << " sketch cells");
+    post_notify<NOTIFY_GET_TXPOOL_COMPLEMENT>(r, context);
+    context.m_txpool_complement_sketch_cells = sketch.cells();
+    MLOG_PEER_STATE("requesting txpool complement");
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   void t_cryptonote_protocol_handler<t_core>::hit_score(cryptonote_connection_context &context, int32_t score)
   {
     if (score <= 0)
@@ -2811,8 +3383,9 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
-  std::pair<uint32_t, uint32_t> t_cryptonote_protocol_handler<t_core>::get_next_needed_pruning_stripe() const
+  typename t_cryptonote_protocol_handler<t_core>::pruning_stripe_coverage t_cryptonote_protocol_handler<t_core>::get_pruning_stripe_coverage() const
   {
+    const uint32_t n_total_stripes = 1 << CRYPTONOTE_PRUNING_LOG_STRIPES;
     const uint64_t want_height_from_blockchain = m_core.get_current_blockchain_height();
     const uint64_t want_height_from_block_queue = m_block_queue.get_next_needed_height(want_height_from_blockchain);
     const uint64_t want_height = std::max(want_height_from_blockchain, want_height_from_block_queue);
@@ -2820,33 +3393,70 @@ skip:
     // if we don't know the remote chain size yet, assume infinitely large so we get the right stripe if we're not near the tip
     if (blockchain_height == 0)
       blockchain_height = CRYPTONOTE_MAX_BLOCK_NUMBER;
-    const uint32_t next_pruning_stripe = tools::get_pruning_stripe(want_height, blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES);
-    if (next_pruning_stripe == 0)
-      return std::make_pair(0, 0);
-    // if we already have a few peers on this stripe, but none on next one, try next one
-    unsigned int n_next = 0, n_subsequent = 0, n_others = 0;
-    const uint32_t subsequent_pruning_stripe = 1 + next_pruning_stripe % (1<<CRYPTONOTE_PRUNING_LOG_STRIPES);
+
+    pruning_stripe_coverage coverage;
+    coverage.next_stripe = tools::get_pruning_stripe(want_height, blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES);
+    coverage.n_stripes = 0;
+    if (coverage.next_stripe)
+    {
+      // the last pruned height is below the tip blocks, which every node keeps
+      const uint64_t last_pruned_height = blockchain_height - CRYPTONOTE_PRUNING_TIP_BLOCKS - 1;
+      coverage.n_stripes = std::min<uint64_t>(n_total_stripes, last_pruned_height / CRYPTONOTE_PRUNING_STRIPE_SIZE - want_height / CRYPTONOTE_PRUNING_STRIPE_SIZE + 1);
+    }
+    coverage.n_unpruned = 0;
+    coverage.peers.resize(n_total_stripes, 0);
     m_p2p->for_each_connection([&](const connection_context &context, nodetool::peerid_type peer_id, uint32_t support_flags) {
       if (context.m_state >= cryptonote_connection_context::state_synchronizing)
       {
-        if (context.m_pruning_seed == 0 || tools::get_pruning_stripe(context.m_pruning_seed) == next_pruning_stripe)
-          ++n_next;
-        else if (tools::get_pruning_stripe(context.m_pruning_seed) == subsequent_pruning_stripe)
-          ++n_subsequent;
-        else
-          ++n_others;
+        const uint32_t stripe = tools::get_pruning_stripe(context.m_pruning_seed);
+        if (stripe == 0)
+          ++coverage.n_unpruned;
+        else if (stripe <= n_total_stripes)
+          ++coverage.peers[stripe - 1];
       }
       return true;
     });
+    return coverage;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  std::pair<uint32_t, uint32_t> t_cryptonote_protocol_handler<t_core>::get_next_needed_pruning_stripe() const
+  {
+    const pruning_stripe_coverage coverage = get_pruning_stripe_coverage();
+    const uint32_t next_pruning_stripe = coverage.next_stripe;
+    if (next_pruning_stripe == 0)
+      return std::make_pair(0, 0);
+    const uint32_t n_total_stripes = 1 << CRYPTONOTE_PRUNING_LOG_STRIPES;
+
+    // look for a peer on the first stripe the sync still needs which none of our peers has,
+    // so it is connected by the time we get there, rather than stalling when we do
+    if (coverage.n_unpruned == 0)
+    {
+      for (uint32_t i = 0; i < coverage.n_stripes; ++i)
+      {
+        const uint32_t stripe = 1 + (next_pruning_stripe - 1 + i) % n_total_stripes;
+        if (coverage.peers[stripe - 1] == 0)
+        {
+          MIDEBUG(const std::string po = get_peers_overview(), "get_next_needed_pruning_stripe: stripe " << next_pruning_stripe <<
+              ", no peer on stripe " << stripe << " (+" << i << " of " << coverage.n_stripes << " still needed), current peers " << po);
+          return std::make_pair(next_pruning_stripe, stripe);
+        }
+      }
+    }
+
+    // if we already have a few peers on this stripe, but none on next one, try next one
+    const uint32_t subsequent_pruning_stripe = 1 + next_pruning_stripe % n_total_stripes;
+    const unsigned int n_next = coverage.n_unpruned + coverage.peers[next_pruning_stripe - 1];
+    const unsigned int n_subsequent = coverage.peers[subsequent_pruning_stripe - 1];
+    const unsigned int n_others = std::accumulate(coverage.peers.begin(), coverage.peers.end(), 0u) + coverage.n_unpruned - n_next - n_subsequent;
     // TODO: investigate tallying by zone and comparing to max out peers by zone
     const unsigned int max_out_peers = get_max_out_peers(epee::net_utils::zone::public_);
     const bool use_next = (n_next > max_out_peers / 2 && n_subsequent <= 1) || (n_next > 2 && n_subsequent == 0);
     const uint32_t ret_stripe = use_next ? subsequent_pruning_stripe: next_pruning_stripe;
-    MIDEBUG(const std::string po = get_peers_overview(), "get_next_needed_pruning_stripe: want height " << want_height << " (" <<
-        want_height_from_blockchain << " from blockchain, " << want_height_from_block_queue << " from block queue), stripe " <<
+    MIDEBUG(const std::string po = get_peers_overview(), "get_next_needed_pruning_stripe: stripe " <<
         next_pruning_stripe << " (" << n_next << "/" << max_out_peers << " on it and " << n_subsequent << " on " <<
         subsequent_pruning_stripe << ", " << n_others << " others) -> " << ret_stripe << " (+" <<
-        (ret_stripe - next_pruning_stripe + (1 << CRYPTONOTE_PRUNING_LOG_STRIPES)) % (1 << CRYPTONOTE_PRUNING_LOG_STRIPES) <<
+        (ret_stripe - next_pruning_stripe + n_total_stripes) % n_total_stripes <<
         "), current peers " << po);
     return std::make_pair(next_pruning_stripe, ret_stripe);
   }
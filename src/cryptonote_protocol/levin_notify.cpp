@@ -34,18 +34,24 @@
 #include <chrono>
 #include <deque>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "byte_slice.h"
 #include "common/expect.h"
+#include "common/metrics.h"
 #include "common/varint.h"
 #include "cryptonote_config.h"
 #include "crypto/crypto.h"
 #include "crypto/duration.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_core/i_core_events.h"
+#include "cryptonote_protocol/compact_block.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "cryptonote_protocol/tx_sketch.h"
 #include "net/dandelionpp.h"
+#include "net/network_throttle.hpp"
 #include "p2p/net_node.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -68,6 +74,13 @@ namespace levin
     constexpr const std::chrono::seconds noise_min_delay{CRYPTONOTE_NOISE_MIN_DELAY};
     constexpr const std::chrono::seconds noise_delay_range{CRYPTONOTE_NOISE_DELAY_RANGE};
 
+    constexpr const std::chrono::seconds reconciliation_interval{CRYPTONOTE_TX_RECONCILIATION_INTERVAL};
+
+    tools::metrics::counter stem_txes_metric("monero_dandelionpp_txes_total", "Transactions sent on by Dandelion++, by phase", "phase=\"stem\"");
+    tools::metrics::counter fluff_txes_metric("monero_dandelionpp_txes_total", "Transactions sent on by Dandelion++, by phase", "phase=\"fluff\"");
+    tools::metrics::counter stem_failures_metric("monero_dandelionpp_stem_failures_total", "Dandelion++ stem sends which fell back to fluff");
+    tools::metrics::gauge stem_sources_metric("monero_dandelionpp_stem_sources", "Sources mapped to a Dandelion++ stem in the current epoch", {}, true);
+
     /* A custom duration is used for the poisson distribution because of the
        variance. If 5 seconds is given to `std::poisson_distribution`, 95% of
        the values fall between 1-9s in 1s increments (not granular enough). If
@@ -85,6 +98,25 @@ namespace levin
     using fluff_duration = crypto::random_poisson_subseconds::result_type;
     constexpr const fluff_duration fluff_average_out{fluff_duration{fluff_average_in} / 2};
 
+    constexpr const std::chrono::seconds fluff_max_throttle{CRYPTONOTE_DANDELIONPP_FLUSH_MAX_THROTTLE};
+
+    /*! Fluff flush times are rounded up to a tick. Connections due in the same
+        tick share one timer expiry, and the zone timer is re-armed at most
+        once per tick no matter how many txes arrive. A tick is small next to
+        the 1/4s steps of the poisson delays, so the randomization holds. */
+    constexpr const std::chrono::milliseconds fluff_flush_tick{50};
+
+    tools::metrics::counter fluff_flush_metric("monero_dandelionpp_fluff_flushes_total", "Fluff flush timer expiries");
+    tools::metrics::counter fluff_rearm_metric("monero_dandelionpp_fluff_timer_rearms_total", "Fluff flush timer re-arms");
+
+    //! \return `time` rounded up to the next `fluff_flush_tick` boundary.
+    std::chrono::steady_clock::time_point fluff_flush_slot(const std::chrono::steady_clock::time_point time)
+    {
+      const std::chrono::steady_clock::duration tick = fluff_flush_tick;
+      const auto since = time.time_since_epoch();
+      return std::chrono::steady_clock::time_point{((since + tick - std::chrono::steady_clock::duration{1}) / tick) * tick};
+    }
+
     /*! Select a randomized duration from 0 to `range`. The precision will be to
         the systems `steady_clock`. As an example, supplying 3 seconds to this
         function will select a duration from [0, 3] seconds, and the increments
@@ -206,6 +238,28 @@ namespace levin
       return p2p.send(std::move(blob), destination);
     }
 
+    template<typename T>
+    bool make_payload_send_notify(connections& p2p, const typename T::request& request, const boost::uuids::uuid& destination)
+    {
+      epee::levin::message_writer out;
+      if (!epee::serialization::store_t_to_binary(request, out.buffer))
+        throw std::runtime_error{"Failed to serialize to epee binary format"};
+      return p2p.send(out.finalize_notify(T::ID), destination);
+    }
+
+    //! Updates the relay counters of a connection, reported in `get_connections`.
+    template<typename F>
+    void update_counters(connections& p2p, const boost::uuids::uuid& id, F f)
+    {
+      p2p.for_connection(id, [&f] (detail::p2p_context& context) {
+        f(context);
+        return true;
+      });
+    }
+
+    //! Txes held back for reconciliation, by hash of their blob
+    using tx_set = std::unordered_map<crypto::hash, blobdata>;
+
     /* The current design uses `asio::strand`s. The documentation isn't as clear
        as it should be - a `strand` has an internal `mutex` and `bool`. The
        `mutex` synchronizes thread access and the `bool` is set when a thread is
@@ -269,6 +323,7 @@ namespace levin
           noise(std::move(noise_in)),
           next_epoch(io_service),
           flush_txs(io_service),
+          next_reconciliation(io_service),
           strand(io_service),
           map(),
           channels(),
@@ -276,7 +331,8 @@ namespace levin
           flush_callbacks(0),
           nzone(zone),
           pad_txs(pad_txs),
-          fluffing(false)
+          fluffing(false),
+          epoch_stats()
       {
         for (std::size_t count = 0; !noise.empty() && count < CRYPTONOTE_NOISE_CHANNELS; ++count)
           channels.emplace_back(io_service);
@@ -286,11 +342,17 @@ namespace levin
       const epee::byte_slice noise; //!< `!empty()` means zone is using noise channels
       boost::asio::steady_timer next_epoch;
       boost::asio::steady_timer flush_txs;
+      boost::asio::steady_timer next_reconciliation;
       boost::asio::io_service::strand strand;
       struct context_t {
         std::vector<cryptonote::blobdata> fluff_txs;
         std::chrono::steady_clock::time_point flush_time;
         bool m_is_income;
+        bool reconcile;        //!< Txes are mostly reconciled with this connection instead of flooded
+        bool recon_pending;    //!< A reconciliation round is waiting for the peer
+        std::uint64_t recon_salt;
+        tx_set recon_txs;      //!< Txes for the next reconciliation round
+        tx_set recon_snapshot; //!< Txes for the pending reconciliation round
       };
       boost::unordered_map<boost::uuids::uuid, context_t> contexts;
       net::dandelionpp::connection_map map;//!< Tracks outgoing uuid's for noise channels or Dandelion++ stems
@@ -300,6 +362,12 @@ namespace levin
       const epee::net_utils::zone nzone;         //!< Zone is public ipv4/ipv6 connections, or i2p or tor
       const bool pad_txs;                        //!< Pad txs to the next boundary for privacy
       bool fluffing;                             //!< Zone is in Dandelion++ fluff epoch
+      struct epoch_stats_t {
+        std::chrono::steady_clock::time_point start;
+        std::uint64_t stem_txes;
+        std::uint64_t stem_failures; //!< Stem sends which fell back to fluff
+        std::uint64_t fluff_txes;
+      } epoch_stats;                             //!< Dandelion++ decisions this epoch, only update in strand
     };
   } // detail
 
@@ -340,6 +408,13 @@ namespace levin
     };
 
     //! Sends txs on connections with expired timers, and queues callback for next timer expiration (if any).
+    //! \return Seconds until the upload limit has room again, 0 if it has now.
+    double get_upload_throttle_delay()
+    {
+      CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
+      return epee::net_utils::network_throttle_manager::get_global_throttle_out().get_sleep_time(0);
+    }
+
     struct fluff_flush
     {
       std::shared_ptr<detail::zone> zone_;
@@ -350,6 +425,8 @@ namespace levin
         assert(zone->strand.running_in_this_thread());
 
         detail::zone& this_zone = *zone;
+        if (this_zone.flush_callbacks)
+          fluff_rearm_metric.inc();
         ++this_zone.flush_callbacks;
         this_zone.flush_txs.expires_at(flush_time);
         this_zone.flush_txs.async_wait(this_zone.strand.wrap(fluff_flush{std::move(zone)}));
@@ -367,6 +444,31 @@ namespace levin
           throw boost::system::system_error{error, "fluff_flush timer failed"};
 
         const auto now = std::chrono::steady_clock::now();
+        fluff_flush_metric.inc();
+
+        /* Relayed txes yield to block sync while the upload limit is used up.
+           The flush is held back until the limit has room again, but only for
+           a bounded time so txes still propagate over a saturated link. */
+        if (!timer_error)
+        {
+          const double throttle_delay = get_upload_throttle_delay();
+          if (0 < throttle_delay)
+          {
+            auto oldest = std::chrono::steady_clock::time_point::max();
+            for (auto &e: zone_->contexts)
+            {
+              if (!e.second.fluff_txs.empty())
+                oldest = std::min(oldest, e.second.flush_time);
+            }
+            if (oldest <= now && now - oldest < fluff_max_throttle)
+            {
+              const std::chrono::duration<double> wait{std::min(throttle_delay, 1.0)};
+              fluff_flush::queue(std::move(zone_), fluff_flush_slot(now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait)));
+              return;
+            }
+          }
+        }
+
         auto next_flush = std::chrono::steady_clock::time_point::max();
         std::vector<std::pair<std::vector<blobdata>, boost::uuids::uuid>> connections{};
         for (auto &e: zone_->contexts)
@@ -396,7 +498,9 @@ namespace levin
         for (auto& connection : connections)
         {
           std::sort(connection.first.begin(), connection.first.end()); // don't leak receive order
-          make_payload_send_txs(*zone_->p2p, std::move(connection.first), connection.second, zone_->pad_txs, true);
+          const std::size_t count = connection.first.size();
+          if (make_payload_send_txs(*zone_->p2p, std::move(connection.first), connection.second, zone_->pad_txs, true))
+            update_counters(*zone_->p2p, connection.second, [count] (detail::p2p_context& context) { context.m_txs_flooded += count; });
         }
 
         if (next_flush != std::chrono::steady_clock::time_point::max())
@@ -407,7 +511,13 @@ namespace levin
     /*! The "fluff" portion of the Dandelion++ algorithm. Every tx is queued
         per-connection and flushed with a randomized poisson timer. This
         implementation only has one system timer per-zone, and instead tracks
-        the lowest flush time. */
+        the lowest flush time. Flush times are rounded to `fluff_flush_tick`
+        so connections expiring together are sent in one callback.
+
+        Connections reconciling txes only get them queued for the next
+        reconciliation round, except for a few outgoing ones picked at random
+        for each call. Those keep txes propagating quickly, reconciliation
+        then mostly finds that the other end already has them. */
     struct fluff_notify
     {
       std::shared_ptr<detail::zone> zone_;
@@ -433,16 +543,42 @@ namespace levin
         crypto::random_poisson_subseconds out_duration(fluff_average_out);
 
 
+        std::vector<boost::uuids::uuid> flood;
+        for (auto &e: zone->contexts)
+        {
+          if (e.second.reconcile && !e.second.m_is_income && e.first != source)
+            flood.push_back(e.first);
+        }
+        std::shuffle(flood.begin(), flood.end(), crypto::random_device{});
+        flood.resize(std::min<std::size_t>(flood.size(), CRYPTONOTE_TX_RECONCILIATION_FLOOD_PEERS));
+        std::vector<crypto::hash> hashes;
+        bool reconciling = false;
+
         MDEBUG("Queueing " << txs.size() << " transaction(s) for Dandelion++ fluffing");
         for (auto &e: zone->contexts)
         {
           auto &id = e.first;
           auto &context = e.second;
+          if (context.reconcile && source != id && std::find(flood.begin(), flood.end(), id) == flood.end() &&
+            context.recon_txs.size() + txs.size() <= CRYPTONOTE_TX_RECONCILIATION_MAX_SET)
+          {
+            if (hashes.empty())
+            {
+              hashes.reserve(txs.size());
+              for (const blobdata& tx : txs)
+                hashes.push_back(crypto::cn_fast_hash(tx.data(), tx.size()));
+            }
+            for (std::size_t i = 0; i < txs.size(); ++i)
+              context.recon_txs.emplace(hashes[i], txs[i]);
+            reconciling = true;
+            continue;
+          }
+
           // When i2p/tor, only fluff to outbound connections
           if (source != id && (zone->nzone == epee::net_utils::zone::public_ || !context.m_is_income))
           {
             if (context.fluff_txs.empty())
-              context.flush_time = now + (context.m_is_income ? in_duration() : out_duration());
+              context.flush_time = fluff_flush_slot(now + (context.m_is_income ? in_duration() : out_duration()));
 
             next_flush = std::min(next_flush, context.flush_time);
             context.fluff_txs.reserve(context.fluff_txs.size() + txs.size());
@@ -451,7 +587,10 @@ namespace levin
         }
 
         if (next_flush == std::chrono::steady_clock::time_point::max())
-          MWARNING("Unable to send transaction(s), no available connections");
+        {
+          if (!reconciling)
+            MWARNING("Unable to send transaction(s), no available connections");
+        }
         else if (!zone->flush_callbacks || next_flush < zone->flush_txs.expires_at())
           fluff_flush::queue(std::move(zone), next_flush);
       }
@@ -561,6 +700,9 @@ namespace levin
               /* Source is intentionally omitted in debug log for privacy - a
                  nil uuid indicates source is that node. */
               MDEBUG("Sent " << txs_.size() << " transaction(s) to " << destination << " using Dandelion++ stem");
+              zone_->epoch_stats.stem_txes += txs_.size();
+              stem_txes_metric.inc(txs_.size());
+              stem_sources_metric.set(zone_->map.sources());
               return;
             }
 
@@ -569,8 +711,12 @@ namespace levin
           }
 
           MERROR("Unable to send transaction(s) via Dandelion++ stem");
+          zone_->epoch_stats.stem_failures += txs_.size();
+          stem_failures_metric.inc(txs_.size());
         }
 
+        zone_->epoch_stats.fluff_txes += txs_.size();
+        fluff_txes_metric.inc(txs_.size());
         core_->on_transactions_relayed(epee::to_span(txs_), relay_method::fluff);
         fluff_notify::run(std::move(zone_), epee::to_span(txs_), source_);
       }
@@ -601,11 +747,21 @@ namespace levin
 
         assert(zone_->strand.running_in_this_thread());
 
+        const auto now = std::chrono::steady_clock::now();
         if (zone_->nzone == epee::net_utils::zone::public_)
+        {
+          const detail::zone::epoch_stats_t &stats = zone_->epoch_stats;
+          if (stats.start != std::chrono::steady_clock::time_point{})
+            MDEBUG("Dandelion++ epoch ended after " << std::chrono::duration_cast<std::chrono::seconds>(now - stats.start).count() << " s: "
+              << stats.stem_txes << " transaction(s) stemmed for " << zone_->map.sources() << " source(s), "
+              << stats.stem_failures << " stem failure(s), " << stats.fluff_txes << " fluffed");
           MDEBUG("Starting new Dandelion++ epoch: " << (fluffing_ ? "fluff" : "stem"));
+        }
 
         zone_->map = std::move(map_);
         zone_->fluffing = fluffing_;
+        zone_->epoch_stats = {now, 0, 0, 0};
+        stem_sources_metric.set(0);
         update_channels::post(std::move(zone_));
       }
     };
@@ -711,6 +867,161 @@ namespace levin
         alias.next_epoch.async_wait(start_epoch{std::move(*this)});
       }
     };
+
+    /* Tx reconciliation, for public connections both ends of which support
+       it. Every reconciliation interval (randomized), this node starts a
+       round with each of its outgoing connections:
+       - this node sends `NOTIFY_REQUEST_TX_SKETCH` with a random salt and how
+         many txes it held back for the peer since the last round;
+       - the peer answers with `NOTIFY_TX_SKETCH`, a sketch of the short ids
+         of the txes it held back for this node, sized for the expected
+         difference;
+       - this node subtracts the sketch of its own txes, decodes the ids only
+         one side has, sends the txes the peer lacks and replies with
+         `NOTIFY_TX_RECONCILIATION_DIFF`, the ids it wants from the peer;
+       - the peer sends txes with these ids.
+       If the sketch does not decode, both ends send every tx of the round
+       instead. Since most txes are still flooded through a few connections,
+       most of the held back txes are on both sides of a round, and are then
+       never sent. */
+
+    //! \return Short ids of `txs` for `salt`.
+    std::vector<std::pair<std::uint64_t, const blobdata*>> get_short_ids(const tx_set& txs, const std::uint64_t salt)
+    {
+      std::vector<crypto::hash> hashes;
+      hashes.reserve(txs.size());
+      for (const auto& tx : txs)
+        hashes.push_back(tx.first);
+
+      const std::vector<std::uint64_t> ids = get_short_tx_ids(salt, hashes);
+      std::vector<std::pair<std::uint64_t, const blobdata*>> out;
+      out.reserve(txs.size());
+      auto id = ids.begin();
+      for (const auto& tx : txs)
+        out.emplace_back(*id++, std::addressof(tx.second));
+      return out;
+    }
+
+    //! Moves txes held back for the next round into the pending round, putting back those of an unfinished one.
+    void start_round(detail::zone::context_t& context, const std::uint64_t salt)
+    {
+      context.recon_txs.insert(std::make_move_iterator(context.recon_snapshot.begin()), std::make_move_iterator(context.recon_snapshot.end()));
+      context.recon_snapshot.clear();
+      std::swap(context.recon_snapshot, context.recon_txs);
+      context.recon_salt = salt;
+      context.recon_pending = true;
+    }
+
+    //! Sends the txes of the pending round with short ids in `wanted`, or all of them if `wanted == nullptr`.
+    void finish_round(detail::zone& zone, detail::zone::context_t& context, const boost::uuids::uuid& id, const std::vector<std::uint64_t>* wanted)
+    {
+      const tx_set snapshot = std::move(context.recon_snapshot);
+      context.recon_snapshot.clear();
+      context.recon_pending = false;
+
+      std::vector<blobdata> txs;
+      if (wanted)
+      {
+        const std::unordered_set<std::uint64_t> wanted_set(wanted->begin(), wanted->end());
+        for (const auto& tx : get_short_ids(snapshot, context.recon_salt))
+        {
+          if (wanted_set.count(tx.first))
+            txs.push_back(*tx.second);
+        }
+      }
+      else
+      {
+        txs.reserve(snapshot.size());
+        for (const auto& tx : snapshot)
+          txs.push_back(tx.second);
+      }
+
+      const std::size_t sent = txs.size();
+      const std::size_t known = snapshot.size() - std::min(sent, snapshot.size());
+      MDEBUG("Reconciled " << snapshot.size() << " transaction(s) with " << id << (wanted ? "" : " (failed)") << ", sending " << sent);
+      if (!txs.empty())
+      {
+        std::sort(txs.begin(), txs.end()); // don't leak receive order
+        make_payload_send_txs(*zone.p2p, std::move(txs), id, zone.pad_txs, true);
+      }
+      update_counters(*zone.p2p, id, [sent, known, wanted] (detail::p2p_context& context) {
+        context.m_txs_reconciled += sent;
+        context.m_txs_reconciled_known += known;
+        ++context.m_reconciliations;
+        if (!wanted)
+          ++context.m_reconciliation_failures;
+      });
+    }
+
+    //! Starts a reconciliation round with each of `connections`.
+    struct request_sketches
+    {
+      std::shared_ptr<detail::zone> zone_;
+      std::vector<boost::uuids::uuid> connections_;
+
+      //! \pre Called within `zone_->strand`.
+      void operator()()
+      {
+        if (!zone_ || !zone_->p2p)
+          return;
+
+        assert(zone_->strand.running_in_this_thread());
+
+        for (const boost::uuids::uuid& id : connections_)
+        {
+          const auto context = zone_->contexts.find(id);
+          if (context == zone_->contexts.end())
+            continue;
+
+          context->second.reconcile = true;
+          start_round(context->second, crypto::rand<std::uint64_t>());
+
+          NOTIFY_REQUEST_TX_SKETCH::request request{};
+          request.salt = context->second.recon_salt;
+          request.set_size = context->second.recon_snapshot.size();
+          make_payload_send_notify<NOTIFY_REQUEST_TX_SKETCH>(*zone_->p2p, request, id);
+        }
+      }
+    };
+
+    //! Looks for outgoing connections supporting reconciliation, and sets timer for next round.
+    struct start_reconciliation
+    {
+      std::shared_ptr<detail::zone> zone_;
+
+      static void wait(const std::chrono::steady_clock::time_point start, std::shared_ptr<detail::zone> zone)
+      {
+        if (!zone)
+          return;
+
+        detail::zone& alias = *zone;
+        alias.next_reconciliation.expires_at(start + reconciliation_interval / 2 + random_duration(reconciliation_interval));
+        alias.next_reconciliation.async_wait(start_reconciliation{std::move(zone)});
+      }
+
+      //! \pre Should not be invoked within any strand to prevent blocking.
+      void operator()(const boost::system::error_code error)
+      {
+        if (!zone_ || !zone_->p2p)
+          return;
+
+        if (error && error != boost::system::errc::operation_canceled)
+          throw boost::system::system_error{error, "start_reconciliation timer failed"};
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<boost::uuids::uuid> connections;
+        zone_->p2p->foreach_connection([&connections] (detail::p2p_context& context) {
+          if (!context.m_is_income && context.handshake_complete() && (context.support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+            connections.push_back(context.m_connection_id);
+          return true;
+        });
+
+        if (!connections.empty())
+          zone_->strand.dispatch(request_sketches{zone_, std::move(connections)});
+
+        wait(start, std::move(zone_));
+      }
+    };
   } // anonymous
 
   notify::notify(boost::asio::io_service& service, std::shared_ptr<connections> p2p, epee::byte_slice noise, epee::net_utils::zone zone, const bool pad_txs, i_core_events& core)
@@ -732,6 +1043,9 @@ namespace levin
 
       for (std::size_t channel = 0; channel < zone_->channels.size(); ++channel)
         send_noise::wait(now, zone_, channel, core_);
+
+      if (!noise_enabled)
+        start_reconciliation::wait(now, zone_);
     }
   }
 
@@ -767,6 +1081,11 @@ namespace levin
         .fluff_txs = {},
         .flush_time = std::chrono::steady_clock::time_point::max(),
         .m_is_income = is_income,
+        .reconcile = false,
+        .recon_pending = false,
+        .recon_salt = 0,
+        .recon_txs = {},
+        .recon_snapshot = {},
       };
     });
   }
@@ -782,6 +1101,83 @@ namespace levin
     });
   }
 
+  void notify::on_tx_sketch_request(const boost::uuids::uuid &id, const std::uint64_t salt, const std::uint64_t set_size)
+  {
+    if (!zone_ || !zone_->noise.empty() || zone_->nzone != epee::net_utils::zone::public_)
+      return;
+
+    auto& zone = zone_;
+    zone_->strand.dispatch([zone, id, salt, set_size]{
+      const auto context = zone->contexts.find(id);
+      if (context == zone->contexts.end() || !context->second.m_is_income)
+        return;
+
+      // the peer gets txes through reconciliation from now on
+      context->second.reconcile = true;
+      start_round(context->second, salt);
+
+      const tx_set& snapshot = context->second.recon_snapshot;
+      tx_sketch sketch{tx_sketch::get_cell_count(snapshot.size(), set_size)};
+      for (const auto& tx : get_short_ids(snapshot, salt))
+        sketch.add(tx.first);
+
+      NOTIFY_TX_SKETCH::request response{};
+      response.sketch = sketch.serialize();
+      response.set_size = snapshot.size();
+      make_payload_send_notify<NOTIFY_TX_SKETCH>(*zone->p2p, response, id);
+    });
+  }
+
+  void notify::on_tx_sketch(const boost::uuids::uuid &id, std::string sketch)
+  {
+    if (!zone_)
+      return;
+
+    auto& zone = zone_;
+    zone_->strand.dispatch([zone, id, sketch = std::move(sketch)]{
+      const auto context = zone->contexts.find(id);
+      if (context == zone->contexts.end() || !context->second.recon_pending || context->second.m_is_income)
+        return;
+
+      const auto short_ids = get_short_ids(context->second.recon_snapshot, context->second.recon_salt);
+      std::vector<std::uint64_t> local_only, remote_only;
+      tx_sketch remote;
+      bool success = remote.parse(sketch);
+      if (success)
+      {
+        tx_sketch local{remote.cells()};
+        for (const auto& tx : short_ids)
+          local.add(tx.first);
+        success = local.subtract(remote) && local.decode(local_only, remote_only);
+      }
+
+      NOTIFY_TX_RECONCILIATION_DIFF::request diff{};
+      diff.success = success;
+      if (success)
+        diff.short_tx_ids = pack_short_tx_ids(remote_only);
+      make_payload_send_notify<NOTIFY_TX_RECONCILIATION_DIFF>(*zone->p2p, diff, id);
+
+      finish_round(*zone, context->second, id, success ? std::addressof(local_only) : nullptr);
+    });
+  }
+
+  void notify::on_tx_reconciliation_diff(const boost::uuids::uuid &id, const bool success, std::string short_tx_ids)
+  {
+    if (!zone_)
+      return;
+
+    auto& zone = zone_;
+    zone_->strand.dispatch([zone, id, success, short_tx_ids = std::move(short_tx_ids)]{
+      const auto context = zone->contexts.find(id);
+      if (context == zone->contexts.end() || !context->second.recon_pending || !context->second.m_is_income)
+        return;
+
+      std::vector<std::uint64_t> wanted;
+      const bool decoded = success && unpack_short_tx_ids(short_tx_ids, wanted);
+      finish_round(*zone, context->second, id, decoded ? std::addressof(wanted) : nullptr);
+    });
+  }
+
   void notify::run_epoch()
   {
     if (!zone_)
@@ -805,6 +1201,13 @@ namespace levin
     zone_->flush_txs.cancel();
   }
 
+  void notify::run_reconciliation()
+  {
+    if (!zone_)
+      return;
+    zone_->next_reconciliation.cancel();
+  }
+
   bool notify::send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, relay_method tx_relay)
   {
     if (txs.empty())
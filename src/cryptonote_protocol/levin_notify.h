@@ -30,6 +30,7 @@
 
 #include <boost/asio/io_service.hpp>
 #include <boost/uuid/uuid.hpp>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -104,6 +105,15 @@ namespace levin
     void on_handshake_complete(const boost::uuids::uuid &id, bool is_income);
     void on_connection_close(const boost::uuids::uuid &id);
 
+    //! Answers a peer starting a tx reconciliation round with a sketch of the txes held back for it.
+    void on_tx_sketch_request(const boost::uuids::uuid &id, std::uint64_t salt, std::uint64_t set_size);
+
+    //! Finishes a tx reconciliation round this node started, sending the txes the peer lacks.
+    void on_tx_sketch(const boost::uuids::uuid &id, std::string sketch);
+
+    //! Finishes a tx reconciliation round the peer started, sending the txes it asked for.
+    void on_tx_reconciliation_diff(const boost::uuids::uuid &id, bool success, std::string short_tx_ids);
+
     //! Run the logic for the next epoch immediately. Only use in testing.
     void run_epoch();
 
@@ -113,6 +123,9 @@ namespace levin
     //! Run the logic for flushing all Dandelion++ fluff queued txs. Only use in testing.
     void run_fluff();
 
+    //! Run the logic for the next tx reconciliation round immediately. Only use in testing.
+    void run_reconciliation();
+
     /*! Send txs using `cryptonote_protocol_defs.h` payload format wrapped in a
         levin header. The message will be sent in a "discreet" manner if
         enabled - if `!noise.empty()` then the `command`/`payload` will be
@@ -0,0 +1,195 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstring>
+#include "int-util.h"
+#include "cryptonote_config.h"
+#include "tx_sketch.h"
+
+namespace
+{
+  constexpr const size_t partitions = 3;
+  constexpr const uint64_t max_short_id = (uint64_t(1) << 48) - 1;
+
+  uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+  }
+
+  uint32_t get_check(uint64_t short_id)
+  {
+    return mix(short_id ^ 0xd6e8feb86659fd93) >> 32;
+  }
+}
+
+namespace cryptonote
+{
+  tx_sketch::tx_sketch(size_t cells):
+    m_partition_size(std::max<size_t>(1, (cells + partitions - 1) / partitions)),
+    m_cells(m_partition_size * partitions, cell{0, 0, 0})
+  {
+  }
+
+  size_t tx_sketch::get_cell_count(size_t local_size, size_t remote_size)
+  {
+    // most of both sets are txes both sides got from elsewhere: expect a
+    // quarter of the smaller one to differ, besides the difference in size
+    const size_t difference = std::max(local_size, remote_size) - std::min(local_size, remote_size) + std::min(local_size, remote_size) / 4 + 1;
+    // cells are much smaller than the txes sent when decoding fails: leave
+    // enough slack for about 1 failure in 100, small sketches need the most
+    const size_t cells = partitions * (difference + 8);
+    return std::min<size_t>(cells, CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS);
+  }
+
+  size_t tx_sketch::get_cell(uint64_t short_id, size_t partition) const
+  {
+    return partition * m_partition_size + mix(short_id + (partition + 1) * 0x9e3779b97f4a7c15) % m_partition_size;
+  }
+
+  void tx_sketch::toggle(uint64_t short_id, int16_t count)
+  {
+    if (m_cells.empty())
+      return;
+    const uint32_t check = get_check(short_id);
+    for (size_t p = 0; p < partitions; ++p)
+    {
+      cell &c = m_cells[get_cell(short_id, p)];
+      c.count += count;
+      c.id_sum ^= short_id;
+      c.check_sum ^= check;
+    }
+  }
+
+  void tx_sketch::add(uint64_t short_id)
+  {
+    toggle(short_id, 1);
+  }
+
+  bool tx_sketch::subtract(const tx_sketch &sketch)
+  {
+    if (sketch.m_cells.size() != m_cells.size())
+      return false;
+    for (size_t i = 0; i < m_cells.size(); ++i)
+    {
+      m_cells[i].count -= sketch.m_cells[i].count;
+      m_cells[i].id_sum ^= sketch.m_cells[i].id_sum;
+      m_cells[i].check_sum ^= sketch.m_cells[i].check_sum;
+    }
+    return true;
+  }
+
+  bool tx_sketch::decode(std::vector<uint64_t> &local_only, std::vector<uint64_t> &remote_only) const
+  {
+    local_only.clear();
+    remote_only.clear();
+
+    tx_sketch sketch(*this);
+    const auto is_pure = [&sketch](size_t i) {
+      const cell &c = sketch.m_cells[i];
+      return (c.count == 1 || c.count == -1) && c.id_sum <= max_short_id && get_check(c.id_sum) == c.check_sum;
+    };
+
+    std::vector<size_t> pure;
+    for (size_t i = 0; i < sketch.m_cells.size(); ++i)
+      if (is_pure(i))
+        pure.push_back(i);
+
+    // a legit difference cannot have more ids than cells, this bounds a crafted sketch
+    while (!pure.empty() && local_only.size() + remote_only.size() <= m_cells.size())
+    {
+      const size_t i = pure.back();
+      pure.pop_back();
+      if (!is_pure(i))
+        continue;
+
+      const uint64_t short_id = sketch.m_cells[i].id_sum;
+      const int16_t count = sketch.m_cells[i].count;
+      (count > 0 ? local_only : remote_only).push_back(short_id);
+      sketch.toggle(short_id, -count);
+      for (size_t p = 0; p < partitions; ++p)
+      {
+        const size_t j = sketch.get_cell(short_id, p);
+        if (is_pure(j))
+          pure.push_back(j);
+      }
+    }
+
+    for (const cell &c: sketch.m_cells)
+      if (c.count || c.id_sum || c.check_sum)
+        return false;
+    return true;
+  }
+
+  std::string tx_sketch::serialize() const
+  {
+    std::string blob(m_cells.size() * TX_SKETCH_CELL_SIZE, '\0');
+    char *ptr = &blob[0];
+    for (const cell &c: m_cells)
+    {
+      const uint16_t count = SWAP16LE((uint16_t)c.count);
+      const uint64_t id_sum = SWAP64LE(c.id_sum);
+      const uint32_t check_sum = SWAP32LE(c.check_sum);
+      memcpy(ptr, &count, 2);
+      memcpy(ptr + 2, &id_sum, 6);
+      memcpy(ptr + 8, &check_sum, 4);
+      ptr += TX_SKETCH_CELL_SIZE;
+    }
+    return blob;
+  }
+
+  bool tx_sketch::parse(const std::string &blob)
+  {
+    const size_t cells = blob.size() / TX_SKETCH_CELL_SIZE;
+    if (blob.size() % (partitions * TX_SKETCH_CELL_SIZE) || cells == 0 || cells > CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS)
+      return false;
+
+    m_partition_size = cells / partitions;
+    m_cells.resize(cells);
+    const char *ptr = blob.data();
+    for (cell &c: m_cells)
+    {
+      uint16_t count;
+      uint64_t id_sum = 0;
+      uint32_t check_sum;
+      memcpy(&count, ptr, 2);
+      memcpy(&id_sum, ptr + 2, 6);
+      memcpy(&check_sum, ptr + 8, 4);
+      c.count = (int16_t)SWAP16LE(count);
+      c.id_sum = SWAP64LE(id_sum);
+      c.check_sum = SWAP32LE(check_sum);
+      ptr += TX_SKETCH_CELL_SIZE;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TX_SKETCH_CELL_SIZE 12
+
+namespace cryptonote
+{
+  /*! A sketch of a set of short tx ids (see compact_block.h), as an
+   *  invertible bloom lookup table: each id is added to three cells out of
+   *  three equal partitions. The sketch of a peer's set can be subtracted from
+   *  ours, after which the ids in only one of the two sets can be recovered as
+   *  long as there are enough cells for them, whatever the size of the sets.
+   */
+  class tx_sketch
+  {
+  public:
+    tx_sketch(): m_partition_size(0) {}
+    explicit tx_sketch(size_t cells);
+
+    //! \return A number of cells likely to decode the difference of two sets of these sizes
+    static size_t get_cell_count(size_t local_size, size_t remote_size);
+
+    size_t cells() const { return m_cells.size(); }
+
+    void add(uint64_t short_id);
+
+    //! \pre Both sketches have the same number of cells.
+    bool subtract(const tx_sketch &sketch);
+
+    /*! Recovers the ids added to only one side of a subtraction: ids of the
+     *  sketch subtracted from go to local_only, the others to remote_only.
+     *  \return false if the difference is too large for this sketch.
+     */
+    bool decode(std::vector<uint64_t> &local_only, std::vector<uint64_t> &remote_only) const;
+
+    std::string serialize() const;
+    bool parse(const std::string &blob);
+
+  private:
+    struct cell
+    {
+      int16_t count;
+      uint64_t id_sum;
+      uint32_t check_sum;
+    };
+
+    size_t get_cell(uint64_t short_id, size_t partition) const;
+    void toggle(uint64_t short_id, int16_t count);
+
+    size_t m_partition_size;
+    std::vector<cell> m_cells;
+  };
+}
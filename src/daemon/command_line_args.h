@@ -131,10 +131,25 @@ namespace daemon_args
       return val;
     }
   };
+  const command_line::arg_descriptor<unsigned> arg_zmq_rpc_threads = {
+    "zmq-rpc-threads"
+  , "Number of threads handling ZMQ RPC requests"
+  , 1
+  };
   const command_line::arg_descriptor<std::vector<std::string>> arg_zmq_pub = {
     "zmq-pub"
   , "Address for ZMQ pub - tcp://ip:port or ipc://path"
   };
+  const command_line::arg_descriptor<std::string> arg_zmq_pub_template_address = {
+    "zmq-pub-template-address"
+  , "Publish block templates paying this address on the ZMQ pub block_template topics"
+  , ""
+  };
+  const command_line::arg_descriptor<uint32_t> arg_zmq_pub_template_reserve_size = {
+    "zmq-pub-template-reserve-size"
+  , "Bytes reserved in published block templates for the pool's extra nonce (max 255)"
+  , 0
+  };
 
   const command_line::arg_descriptor<bool> arg_zmq_rpc_disabled = {
     "no-zmq"
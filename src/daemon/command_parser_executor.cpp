@@ -170,6 +170,16 @@ bool t_command_parser_executor::print_net_stats(const std::vector<std::string>&
   return m_executor.print_net_stats();
 }
 
+bool t_command_parser_executor::print_db_stats(const std::vector<std::string>& args)
+{
+  if (!args.empty()) {
+    std::cout << "Invalid syntax: No parameters expected. For more details, use the help command." << std::endl;
+    return true;
+  }
+
+  return m_executor.print_db_stats();
+}
+
 bool t_command_parser_executor::print_blockchain_info(const std::vector<std::string>& args)
 {
   if(!args.size())
@@ -1077,4 +1087,24 @@ show_list:
   return true;
 }
 
+bool t_command_parser_executor::print_perf_stats(const std::vector<std::string>& args)
+{
+  if (args.size() != 0) {
+    std::cout << "Invalid syntax: No parameters expected. For more details, use the help command." << std::endl;
+    return true;
+  }
+
+  return m_executor.print_perf_stats();
+}
+
+bool t_command_parser_executor::print_memory_usage(const std::vector<std::string>& args)
+{
+  if (args.size() != 0) {
+    std::cout << "Invalid syntax: No parameters expected. For more details, use the help command." << std::endl;
+    return true;
+  }
+
+  return m_executor.print_memory_usage();
+}
+
 } // namespace daemonize
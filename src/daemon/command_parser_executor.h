@@ -152,9 +152,15 @@ public:
 
   bool print_net_stats(const std::vector<std::string>& args);
 
+  bool print_db_stats(const std::vector<std::string>& args);
+
   bool set_bootstrap_daemon(const std::vector<std::string>& args);
 
   bool flush_cache(const std::vector<std::string>& args);
+
+  bool print_perf_stats(const std::vector<std::string>& args);
+
+  bool print_memory_usage(const std::vector<std::string>& args);
 };
 
 } // namespace daemonize
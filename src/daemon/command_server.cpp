@@ -89,6 +89,11 @@ t_command_server::t_command_server(
     , std::bind(&t_command_parser_executor::print_net_stats, &m_parser, p::_1)
     , "Print network statistics."
     );
+  m_command_lookup.set_handler(
+      "print_db_stats"
+    , std::bind(&t_command_parser_executor::print_db_stats, &m_parser, p::_1)
+    , "Print database statistics, and access counts per table since the daemon started."
+    );
   m_command_lookup.set_handler(
       "print_bc"
     , std::bind(&t_command_parser_executor::print_blockchain_info, &m_parser, p::_1)
@@ -336,6 +341,16 @@ t_command_server::t_command_server(
     , "flush_cache [bad-txs] [bad-blocks]"
     , "Flush the specified cache(s)."
     );
+    m_command_lookup.set_handler(
+      "print_perf_stats"
+    , std::bind(&t_command_parser_executor::print_perf_stats, &m_parser, p::_1)
+    , "Print the call counts and time percentiles of the always on performance timers."
+    );
+    m_command_lookup.set_handler(
+      "print_memory_usage"
+    , std::bind(&t_command_parser_executor::print_memory_usage, &m_parser, p::_1)
+    , "Print the approximate memory used by the daemon's caches, the database size and the resident set size."
+    );
 }
 
 bool t_command_server::process_command_str(const std::string& cmd)
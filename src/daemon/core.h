@@ -53,15 +53,22 @@ private:
   // TEMPORARY HACK - Yes, this creates a copy, but otherwise the original
   // variable map could go out of scope before the run method is called
   boost::program_options::variables_map const m_vm_HACK;
+  bool m_initialized;
 public:
   t_core(
       boost::program_options::variables_map const & vm
     )
     : m_core{nullptr}
     , m_vm_HACK{vm}
+    , m_initialized{false}
+  {
+  }
+
+  //! Loads the blockchain and txpool, does not need the protocol or p2p objects
+  void init()
   {
-    //initialize core here
     MGINFO("Initializing core...");
+    boost::program_options::variables_map const & vm = m_vm_HACK;
 #if defined(PER_BLOCK_CHECKPOINT)
     const cryptonote::GetCheckpointsCallback& get_checkpoints = blocks::GetCheckpointsData;
 #else
@@ -78,6 +85,7 @@ public:
     {
       throw std::runtime_error("Failed to initialize core");
     }
+    m_initialized = true;
     MGINFO("Core initialized OK");
   }
 
@@ -99,6 +107,8 @@ public:
 
   ~t_core()
   {
+    if (!m_initialized)
+      return;
     MGINFO("Deinitializing core...");
     try {
       m_core.deinit();
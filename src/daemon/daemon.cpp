@@ -28,9 +28,11 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <exception>
 #include <memory>
 #include <stdexcept>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/thread/thread.hpp>
 #include "misc_log_ex.h"
 #include "daemon/daemon.h"
 #include "rpc/daemon_handler.h"
@@ -69,11 +71,42 @@ struct zmq_internals
   cryptonote::rpc::ZmqServer server;
 };
 
+//! Runs `t_core::init` on its own thread, so it overlaps with the p2p setup
+struct t_core_init
+{
+  std::exception_ptr error;
+  boost::thread thread;
+
+  explicit t_core_init(t_core& core)
+    : error{}
+    , thread{[this, &core] {
+        try { core.init(); }
+        catch (...) { error = std::current_exception(); }
+      }}
+  {}
+
+  ~t_core_init()
+  {
+    if (thread.joinable())
+      thread.join();
+  }
+
+  void wait()
+  {
+    thread.join();
+    if (error)
+      std::rethrow_exception(error);
+  }
+};
+
 struct t_internals {
 private:
   t_protocol protocol;
 public:
   t_core core;
+private:
+  t_core_init core_init;
+public:
   t_p2p p2p;
   std::vector<std::unique_ptr<t_rpc>> rpcs;
   std::unique_ptr<zmq_internals> zmq;
@@ -83,9 +116,12 @@ public:
     )
     : core{vm}
     , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline)}
+    , core_init{core}
     , p2p{vm, protocol}
     , zmq{nullptr}
   {
+    core_init.wait();
+
     // Handle circular dependencies
     protocol.set_p2p_endpoint(p2p.get());
     core.set_protocol(protocol.get());
@@ -108,8 +144,9 @@ public:
 
       const std::string zmq_port = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_port);
       const std::string zmq_address = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_ip);
+      const unsigned zmq_threads = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_threads);
 
-      if (!zmq->server.init_rpc(zmq_address, zmq_port))
+      if (!zmq->server.init_rpc(zmq_address, zmq_port, zmq_threads))
         throw std::runtime_error{"Failed to add TCP socket(" + zmq_address + ":" + zmq_port + ") to ZMQ RPC Server"};
 
       std::shared_ptr<cryptonote::listener::zmq_pub> shared;
@@ -122,6 +159,18 @@ public:
         core.get().get_blockchain_storage().add_block_notify(cryptonote::listener::zmq_pub::chain_main{shared});
         core.get().get_blockchain_storage().add_miner_notify(cryptonote::listener::zmq_pub::miner_data{shared});
         core.get().set_txpool_listener(cryptonote::listener::zmq_pub::txpool_add{shared});
+
+        const std::string template_address = command_line::get_arg(vm, daemon_args::arg_zmq_pub_template_address);
+        if (!template_address.empty())
+        {
+          cryptonote::address_parse_info info;
+          if (!cryptonote::get_account_address_from_str(info, core.get().get_nettype(), template_address) || info.is_subaddress)
+            throw std::runtime_error{"Invalid --" + std::string{daemon_args::arg_zmq_pub_template_address.name} + ", a standard address is required"};
+          const uint32_t reserve_size = command_line::get_arg(vm, daemon_args::arg_zmq_pub_template_reserve_size);
+          if (reserve_size > 255)
+            throw std::runtime_error{"Invalid --" + std::string{daemon_args::arg_zmq_pub_template_reserve_size.name} + ", maximum is 255"};
+          core.get().set_block_template_listener(info.address, reserve_size, cryptonote::listener::zmq_pub::block_template{shared});
+        }
       }
     }
   }
@@ -749,6 +749,73 @@ bool t_rpc_command_executor::print_net_stats()
   return true;
 }
 
+static std::string get_latency_percentile(const std::vector<uint64_t> &histogram, uint64_t total, double fraction)
+{
+  // bucket i holds gets under 2^i microseconds, the last one everything slower
+  uint64_t seen = 0;
+  for (size_t i = 0; i < histogram.size(); ++i)
+  {
+    seen += histogram[i];
+    if (seen > 0 && seen >= fraction * total)
+      return i + 1 == histogram.size() ? (boost::format(">%uus") % (1ull << (i - 1))).str() : (boost::format("<%uus") % (1ull << i)).str();
+  }
+  return "-";
+}
+
+bool t_rpc_command_executor::print_db_stats()
+{
+  cryptonote::COMMAND_RPC_GET_DB_STATS::request req;
+  cryptonote::COMMAND_RPC_GET_DB_STATS::response res;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->rpc_request(req, res, "/get_db_stats", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_db_stats(req, res) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  tools::success_msg_writer() << boost::format("Map size %s, %s in use (%u pages of %u bytes), %u/%u readers")
+    % tools::get_human_readable_bytes(res.map_size)
+    % tools::get_human_readable_bytes(res.last_page * res.page_size)
+    % res.last_page
+    % res.page_size
+    % res.num_readers
+    % res.max_readers;
+
+  tools::msg_writer() << boost::format("%-20s %12s %10s %12s %7s %10s %10s %10s %10s %8s %8s")
+    % "table" % "entries" % "pages" % "gets" % "miss" % "puts" % "deletes" % "read" % "written" % "p50" % "p99";
+  for (const auto &t: res.tables)
+  {
+    const uint64_t pages = t.branch_pages + t.leaf_pages + t.overflow_pages;
+    const double miss = t.gets ? 100.0 * t.misses / t.gets : 0.0;
+    tools::msg_writer() << boost::format("%-20s %12u %10u %12u %6.2f%% %10u %10u %10s %10s %8s %8s")
+      % t.name
+      % t.entries
+      % pages
+      % t.gets
+      % miss
+      % t.puts
+      % t.deletes
+      % tools::get_human_readable_bytes(t.bytes_read)
+      % tools::get_human_readable_bytes(t.bytes_written)
+      % get_latency_percentile(t.get_latency_histogram, t.gets, 0.5)
+      % get_latency_percentile(t.get_latency_histogram, t.gets, 0.99);
+  }
+
+  return true;
+}
+
 bool t_rpc_command_executor::print_blockchain_info(int64_t start_block_index, uint64_t end_block_index) {
   cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request req;
   cryptonote::COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response res;
@@ -2285,7 +2352,8 @@ bool t_rpc_command_executor::sync_info()
       tools::success_msg_writer() << address << "  " << p.info.peer_id << "  " <<
           epee::string_tools::pad_string(p.info.state, 16) << "  " <<
           epee::string_tools::pad_string(epee::string_tools::to_string_hex(p.info.pruning_seed), 8) << "  " << p.info.height << "  "  <<
-          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued";
+          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued" <<
+          (p.span_size ? ", spans of " + std::to_string(p.span_size) + " blocks at " + std::to_string(p.download_rate/1000) + " kB/s in " + std::to_string(p.span_time) + " ms" : std::string());
     }
 
     uint64_t total_size = 0;
@@ -2469,6 +2537,84 @@ bool t_rpc_command_executor::flush_cache(bool bad_txs, bool bad_blocks)
     return true;
 }
 
+bool t_rpc_command_executor::print_perf_stats()
+{
+    cryptonote::COMMAND_RPC_GET_PERF_STATS::request req;
+    cryptonote::COMMAND_RPC_GET_PERF_STATS::response res;
+    std::string fail_message = "Unsuccessful";
+    epee::json_rpc::error error_resp;
+
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->json_rpc_request(req, res, "get_perf_stats", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_get_perf_stats(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    // percentiles are bucket upper bounds, so within 2x
+    tools::msg_writer() << boost::format("%-32s %12s %12s %10s %10s %10s")
+        % "Site" % "Calls" % "Total ms" % "p50 us" % "p90 us" % "p99 us";
+    for (const auto &site: res.sites)
+    {
+      tools::msg_writer() << boost::format("%-32s %12u %12u %10u %10u %10u")
+          % site.name % site.count % (site.total_ns / 1000000)
+          % (site.median_ns / 1000) % (site.p90_ns / 1000) % (site.p99_ns / 1000);
+    }
+
+    return true;
+}
+
+bool t_rpc_command_executor::print_memory_usage()
+{
+    cryptonote::COMMAND_RPC_GET_MEMORY_USAGE::request req;
+    cryptonote::COMMAND_RPC_GET_MEMORY_USAGE::response res;
+    std::string fail_message = "Unsuccessful";
+    epee::json_rpc::error error_resp;
+
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->json_rpc_request(req, res, "get_memory_usage", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_get_memory_usage(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    std::sort(res.caches.begin(), res.caches.end(), [](const cryptonote::COMMAND_RPC_GET_MEMORY_USAGE::entry &a, const cryptonote::COMMAND_RPC_GET_MEMORY_USAGE::entry &b) {
+      return a.bytes > b.bytes;
+    });
+
+    // cache sizes are estimates, not allocator measurements
+    uint64_t total = 0;
+    tools::msg_writer() << boost::format("%-32s %12s %12s") % "Cache" % "Entries" % "Size";
+    for (const auto &cache: res.caches)
+    {
+      tools::msg_writer() << boost::format("%-32s %12u %12s") % cache.name % cache.entries % tools::get_human_readable_bytes(cache.bytes);
+      total += cache.bytes;
+    }
+    tools::msg_writer() << boost::format("%-32s %12s %12s") % "Total" % "" % tools::get_human_readable_bytes(total);
+    tools::msg_writer() << "Resident: " << (res.resident_bytes ? tools::get_human_readable_bytes(res.resident_bytes) : std::string("unknown"))
+        << ", database: " << tools::get_human_readable_bytes(res.database_bytes);
+
+    return true;
+}
+
 bool t_rpc_command_executor::rpc_payments()
 {
     cryptonote::COMMAND_RPC_ACCESS_DATA::request req;
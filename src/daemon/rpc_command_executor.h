@@ -162,6 +162,8 @@ public:
 
   bool print_net_stats();
 
+  bool print_db_stats();
+
   bool version();
 
   bool set_bootstrap_daemon(
@@ -173,6 +175,10 @@ public:
   bool rpc_payments();
 
   bool flush_cache(bool bad_txs, bool invalid_blocks);
+
+  bool print_perf_stats();
+
+  bool print_memory_usage();
 };
 
 } // namespace daemonize
@@ -179,6 +179,38 @@ namespace hw {
         virtual bool  generate_key_image(const crypto::public_key &pub, const crypto::secret_key &sec, crypto::key_image &image) = 0;
         virtual bool  derive_view_tag(const crypto::key_derivation &derivation, const std::size_t output_index, crypto::view_tag &view_tag) = 0;
 
+        // batched versions of the above, failing as a whole if any element fails; devices
+        // without a faster way get these one element at a time
+        virtual bool  generate_key_derivations(const epee::span<const crypto::public_key> pubs, const crypto::secret_key &sec, epee::span<crypto::key_derivation> derivations)
+        {
+            if (pubs.size() != derivations.size())
+                return false;
+            for (size_t i = 0; i < pubs.size(); ++i)
+                if (!generate_key_derivation(pubs[i], sec, derivations[i]))
+                    return false;
+            return true;
+        }
+
+        virtual bool  derive_public_keys(const epee::span<const crypto::key_derivation> derivations, const epee::span<const std::size_t> output_indices, const epee::span<const crypto::public_key> pubs, epee::span<crypto::public_key> derived_pubs)
+        {
+            if (derivations.size() != output_indices.size() || derivations.size() != pubs.size() || derivations.size() != derived_pubs.size())
+                return false;
+            for (size_t i = 0; i < derivations.size(); ++i)
+                if (!derive_public_key(derivations[i], output_indices[i], pubs[i], derived_pubs[i]))
+                    return false;
+            return true;
+        }
+
+        virtual bool  generate_key_images(const epee::span<const crypto::public_key> pubs, const epee::span<const crypto::secret_key> secs, epee::span<crypto::key_image> images)
+        {
+            if (pubs.size() != secs.size() || pubs.size() != images.size())
+                return false;
+            for (size_t i = 0; i < pubs.size(); ++i)
+                if (!generate_key_image(pubs[i], secs[i], images[i]))
+                    return false;
+            return true;
+        }
+
         // alternative prototypes available in libringct
         rct::key scalarmultKey(const rct::key &P, const rct::key &a)
         {
@@ -241,6 +273,9 @@ namespace hw {
         virtual bool  has_ki_cold_sync(void) const { return false; }
         virtual bool  has_tx_cold_sign(void) const { return false; }
         virtual bool  has_ki_live_refresh(void) const { return true; }
+        // true if the signing calls keep no state between them, so the inputs
+        // of a tx may be signed concurrently
+        virtual bool  has_parallel_signing(void) const { return false; }
         virtual bool  compute_key_image(const cryptonote::account_keys& ack, const crypto::public_key& out_key, const crypto::key_derivation& recv_derivation, size_t real_output_index, const cryptonote::subaddress_index& received_index, cryptonote::keypair& in_ephemeral, crypto::key_image& ki) { return false; }
         virtual void  computing_key_images(bool started) {};
         virtual void  set_network_type(cryptonote::network_type network_type) { }
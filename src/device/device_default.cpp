@@ -143,8 +143,9 @@ namespace hw {
         std::vector<crypto::public_key>  device_default::get_subaddress_spend_public_keys(const cryptonote::account_keys &keys, uint32_t account, uint32_t begin, uint32_t end) {
             CHECK_AND_ASSERT_THROW_MES(begin <= end, "begin > end");
 
-            std::vector<crypto::public_key> pkeys;
-            pkeys.reserve(end - begin);
+            std::vector<crypto::public_key> pkeys(end - begin);
+            if (pkeys.empty())
+              return pkeys;
             cryptonote::subaddress_index index = {account, begin};
 
             ge_p3 p3;
@@ -153,28 +154,34 @@ namespace hw {
                 "ge_frombytes_vartime failed to convert spend public key");
             ge_p3_to_cached(&cached, &p3);
 
+            // the points are kept projective and encoded together at the end, so the
+            // whole range shares its field inversions instead of paying one per key
+            std::vector<ge_p3> points(end - begin);
             for (uint32_t idx = begin; idx < end; ++idx)
             {
                 index.minor = idx;
                 if (index.is_zero())
                 {
-                    pkeys.push_back(keys.m_account_address.m_spend_public_key);
+                    points[idx - begin] = p3;
                     continue;
                 }
                 crypto::secret_key m = get_subaddress_secret_key(keys.m_view_secret_key, index);
 
                 // M = m*G
-                ge_scalarmult_base(&p3, (const unsigned char*)m.data);
+                ge_p3 M;
+                ge_scalarmult_base(&M, (const unsigned char*)m.data);
 
                 // D = B + M
-                crypto::public_key D;
                 ge_p1p1 p1p1;
-                ge_add(&p1p1, &p3, &cached);
-                ge_p1p1_to_p3(&p3, &p1p1);
-                ge_p3_tobytes((unsigned char*)D.data, &p3);
-
-                pkeys.push_back(D);
+                ge_add(&p1p1, &M, &cached);
+                ge_p1p1_to_p3(&points[idx - begin], &p1p1);
             }
+            static_assert(sizeof(crypto::public_key) == 32, "Unexpected public key size");
+            ge_p3_batch_tobytes((unsigned char*)pkeys.data(), points.data(), points.size());
+
+            // the main address is returned as stored, not re-encoded
+            if (account == 0 && begin == 0)
+              pkeys[0] = keys.m_account_address.m_spend_public_key;
             return pkeys;
         }
 
@@ -268,6 +275,23 @@ namespace hw {
             return true;
         }
 
+        bool device_default::generate_key_derivations(const epee::span<const crypto::public_key> pubs, const crypto::secret_key &sec, epee::span<crypto::key_derivation> derivations) {
+            CHECK_AND_ASSERT_MES(pubs.size() == derivations.size(), false, "Mismatched pubs and derivations sizes");
+            return crypto::wallet::generate_key_derivations(pubs.data(), sec, derivations.data(), pubs.size());
+        }
+
+        bool device_default::derive_public_keys(const epee::span<const crypto::key_derivation> derivations, const epee::span<const std::size_t> output_indices, const epee::span<const crypto::public_key> pubs, epee::span<crypto::public_key> derived_pubs) {
+            CHECK_AND_ASSERT_MES(derivations.size() == output_indices.size() && derivations.size() == pubs.size() && derivations.size() == derived_pubs.size(),
+                false, "Mismatched derivations, output indices, pubs and derived pubs sizes");
+            return crypto::derive_public_keys(derivations.data(), output_indices.data(), pubs.data(), derived_pubs.data(), derivations.size());
+        }
+
+        bool device_default::generate_key_images(const epee::span<const crypto::public_key> pubs, const epee::span<const crypto::secret_key> secs, epee::span<crypto::key_image> images) {
+            CHECK_AND_ASSERT_MES(pubs.size() == secs.size() && pubs.size() == images.size(), false, "Mismatched pubs, secs and images sizes");
+            crypto::generate_key_images(pubs.data(), secs.data(), images.data(), pubs.size());
+            return true;
+        }
+
         bool device_default::conceal_derivation(crypto::key_derivation &derivation, const crypto::public_key &tx_pub_key, const std::vector<crypto::public_key> &additional_tx_pub_keys, const crypto::key_derivation &main_derivation, const std::vector<crypto::key_derivation> &additional_derivations){
             return true;
         }
@@ -102,6 +102,9 @@ namespace hw {
             bool  secret_key_to_public_key(const crypto::secret_key &sec, crypto::public_key &pub) override;
             bool  generate_key_image(const crypto::public_key &pub, const crypto::secret_key &sec, crypto::key_image &image) override;
             bool  derive_view_tag(const crypto::key_derivation &derivation, const std::size_t output_index, crypto::view_tag &view_tag) override;
+            bool  generate_key_derivations(const epee::span<const crypto::public_key> pubs, const crypto::secret_key &sec, epee::span<crypto::key_derivation> derivations) override;
+            bool  derive_public_keys(const epee::span<const crypto::key_derivation> derivations, const epee::span<const std::size_t> output_indices, const epee::span<const crypto::public_key> pubs, epee::span<crypto::public_key> derived_pubs) override;
+            bool  generate_key_images(const epee::span<const crypto::public_key> pubs, const epee::span<const crypto::secret_key> secs, epee::span<crypto::key_image> images) override;
 
 
             /* ======================================================================= */
@@ -141,6 +144,8 @@ namespace hw {
             bool clsag_sign(const rct::key &c, const rct::key &a, const rct::key &p, const rct::key &z, const rct::key &mu_P, const rct::key &mu_C, rct::key &s) override;
 
             bool  close_tx(void) override;
+
+            bool  has_parallel_signing(void) const override { return true; }
         };
 
     }
@@ -33,6 +33,7 @@
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/subaddress_index.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "memwipe.h"
 
 #include <boost/thread/locks.hpp> 
 #include <boost/thread/lock_guard.hpp>
@@ -160,6 +161,37 @@ namespace hw {
       hmacs.clear();
     }
 
+    /* ===================================================================== */
+    /* ===                     DerivationScalarmap                      ==== */
+    /* ===================================================================== */
+
+    #define DERIVATION_SCALAR_MAP_SIZE 256
+
+    bool DerivationScalarmap::find(const crypto::key_derivation &derivation, size_t output_index, crypto::ec_scalar &scalar) const {
+      for (const DerivationScalar &e : scalars) {
+        if (e.output_index == output_index && memcmp(e.derivation.data, derivation.data, 32) == 0) {
+          scalar = e.scalar;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void DerivationScalarmap::add(const crypto::key_derivation &derivation, size_t output_index, const crypto::ec_scalar &scalar) {
+      if (scalars.size() < DERIVATION_SCALAR_MAP_SIZE) {
+        scalars.push_back(DerivationScalar{derivation, output_index, scalar});
+        return;
+      }
+      scalars[next] = DerivationScalar{derivation, output_index, scalar};
+      next = (next + 1) % DERIVATION_SCALAR_MAP_SIZE;
+    }
+
+    void DerivationScalarmap::clear() {
+      memwipe(scalars.data(), scalars.size() * sizeof(DerivationScalar));
+      scalars.clear();
+      next = 0;
+    }
+
     /* ===================================================================== */
     /* ===                        Keymap                                ==== */
     /* ===================================================================== */
@@ -445,6 +477,7 @@ namespace hw {
 
     bool device_ledger::reset() {
       reset_buffer();
+      scalar_map.clear();
       int offset = set_command_header_noopt(INS_RESET);
       const size_t verlen = strlen(MONERO_VERSION);
       ASSERT_X(offset + verlen <= BUFFER_SEND_SIZE, "MONERO_VERSION is too long")
@@ -552,6 +585,7 @@ namespace hw {
     }
 
     bool device_ledger::disconnect() {
+      scalar_map.clear();
       hw_device.disconnect();
       return true;
     }
@@ -580,11 +614,13 @@ namespace hw {
           this->exchange();
 
           this->mode = mode;
+          scalar_map.clear();
           break;
 
         case TRANSACTION_PARSE: 
         case NONE:
           this->mode = mode;
+          scalar_map.clear();
           break;
         default:
            CHECK_AND_ASSERT_THROW_MES(false, " device_ledger::set_mode(unsigned int mode): invalid mode: "<<mode);
@@ -1134,6 +1170,13 @@ namespace hw {
         log_hexbuffer("derivation_to_scalar: [[OUT]] res          ", res_x.data, 32);
         #endif
 
+        if (this->scalar_map.find(derivation, output_index, res)) {
+          #ifdef DEBUG_HWDEVICE
+          hw::ledger::check32("derivation_to_scalar", "res", res_x.data, hw::ledger::decrypt(res).data);
+          #endif
+          return true;
+        }
+
         int offset = set_command_header_noopt(INS_DERIVATION_TO_SCALAR);
         //derivation
         this->send_secret((unsigned char*)derivation.data, offset);
@@ -1152,6 +1195,7 @@ namespace hw {
         //derivation data
         offset = 0;
         this->receive_secret((unsigned char*)res.data, offset);
+        this->scalar_map.add(derivation, output_index, res);
 
         #ifdef DEBUG_HWDEVICE
         crypto::ec_scalar res_clear  = hw::ledger::decrypt(res);
@@ -1439,6 +1483,7 @@ namespace hw {
         this->lock();
         key_map.clear();
         hmac_map.clear();
+        scalar_map.clear();
         this->tx_in_progress = true;
         int offset = set_command_header_noopt(INS_OPEN_TX, 0x01);
 
@@ -2353,6 +2398,7 @@ namespace hw {
         send_simple(INS_CLOSE_TX);
         key_map.clear();
         hmac_map.clear();
+        scalar_map.clear();
         this->tx_in_progress = false;
         this->unlock();
         return true;
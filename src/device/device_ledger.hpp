@@ -134,6 +134,26 @@ namespace hw {
     };
 
 
+    class DerivationScalar {
+    public:
+        crypto::key_derivation derivation;
+        size_t                 output_index;
+        crypto::ec_scalar      scalar;
+    };
+
+    // derivation_to_scalar results already fetched from the device, so asking again for the
+    // same output does not cost another round trip. Bounded, oldest entries are replaced first.
+    class DerivationScalarmap {
+    public:
+        std::vector<DerivationScalar> scalars;
+        size_t next = 0;
+
+        bool find(const crypto::key_derivation &derivation, size_t output_index, crypto::ec_scalar &scalar) const;
+        void add(const crypto::key_derivation &derivation, size_t output_index, const crypto::ec_scalar &scalar);
+        void clear();
+    };
+
+
     #define BUFFER_SEND_SIZE 262
     #define BUFFER_RECV_SIZE 262
 
@@ -171,6 +191,8 @@ namespace hw {
                                      const rct::key &amount_key,  const crypto::public_key &out_eph_public_key);
         //hmac for some encrypted value
         HMACmap hmac_map;
+        // device results are only valid for the session and mode they were obtained in
+        DerivationScalarmap scalar_map;
 
         // To speed up blockchain parsing the view key maybe handle here.
         crypto::secret_key viewkey;
@@ -333,7 +333,7 @@ namespace trezor {
 
       const auto batch_size = 10;
       const auto num_batches = (mtds.size() + batch_size - 1) / batch_size;
-      for(uint64_t cur = 0; cur < num_batches; ++cur){
+      auto make_step_req = [&](uint64_t cur){
         auto step_req = std::make_shared<messages::monero::MoneroKeyImageSyncStepRequest>();
         auto idx_finish = std::min(static_cast<uint64_t>((cur + 1) * batch_size), static_cast<uint64_t>(mtds.size()));
         for(uint64_t idx = cur * batch_size; idx < idx_finish; ++idx){
@@ -341,8 +341,22 @@ namespace trezor {
           CHECK_AND_ASSERT_THROW_MES(idx < mtds.size(), "Invalid transfer detail index");
           *added_tdis = mtds[idx];
         }
+        return step_req;
+      };
+
+      // Next batch is assembled while the device computes key images of the current one
+      std::shared_ptr<messages::monero::MoneroKeyImageSyncStepRequest> step_req;
+      if (num_batches > 0){
+        step_req = make_step_req(0);
+      }
 
-        auto step_ack = this->client_exchange<messages::monero::MoneroKeyImageSyncStepAck>(step_req);
+      for(uint64_t cur = 0; cur < num_batches; ++cur){
+        this->client_write(step_req);
+        if (cur + 1 < num_batches){
+          step_req = make_step_req(cur + 1);
+        }
+
+        auto step_ack = this->client_read<messages::monero::MoneroKeyImageSyncStepAck>();
         auto kis_size = step_ack->kis_size();
         kis.reserve(static_cast<size_t>(kis_size));
         for(int i = 0; i < kis_size; ++i){
@@ -627,9 +641,19 @@ namespace trezor {
       signer->step_init_ack(response);
 
       // Step: Set transaction inputs
+      // Acks only append to the signer state, the next input is serialized while the device works.
+      std::shared_ptr<messages::monero::MoneroTransactionSetInputRequest> src_next;
+      if (num_sources > 0){
+        src_next = signer->step_set_input(0);
+      }
+
       for(size_t cur_src = 0; cur_src < num_sources; ++cur_src){
-        auto src = signer->step_set_input(cur_src);
-        auto ack = this->client_exchange<messages::monero::MoneroTransactionSetInputAck>(src);
+        this->client_write(src_next);
+        if (cur_src + 1 < num_sources){
+          src_next = signer->step_set_input(cur_src + 1);
+        }
+
+        auto ack = this->client_read<messages::monero::MoneroTransactionSetInputAck>();
         signer->step_set_input_ack(ack);
         EVENT_PROGRESS(2, cur_src, num_sources);
       }
@@ -639,9 +663,18 @@ namespace trezor {
       EVENT_PROGRESS(3, 1, 1);
 
       // Step: input_vini
+      std::shared_ptr<messages::monero::MoneroTransactionInputViniRequest> vini_next;
+      if (num_sources > 0){
+        vini_next = signer->step_set_vini_input(0);
+      }
+
       for(size_t cur_src = 0; cur_src < num_sources; ++cur_src){
-        auto src = signer->step_set_vini_input(cur_src);
-        auto ack = this->client_exchange<messages::monero::MoneroTransactionInputViniAck>(src);
+        this->client_write(vini_next);
+        if (cur_src + 1 < num_sources){
+          vini_next = signer->step_set_vini_input(cur_src + 1);
+        }
+
+        auto ack = this->client_read<messages::monero::MoneroTransactionInputViniAck>();
         signer->step_set_vini_input_ack(ack);
         EVENT_PROGRESS(4, cur_src, num_sources);
       }
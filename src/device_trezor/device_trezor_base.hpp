@@ -146,17 +146,11 @@ namespace trezor {
                       const boost::optional<messages::MessageType*> & resp_type_ptr = boost::none,
                       bool open_session = false)
       {
-        // Require strictly protocol buffers response in the template.
-        BOOST_STATIC_ASSERT(boost::is_base_of<google::protobuf::Message, t_message>::value);
         const bool accepting_base = boost::is_same<google::protobuf::Message, t_message>::value;
         if (resp_types && !accepting_base){
           throw std::invalid_argument("Cannot specify list of accepted types and not using generic response");
         }
 
-        // Determine type of expected message response
-        const messages::MessageType required_type = accepting_base ? messages::MessageType_Success :
-                  (resp_type ? resp_type.get() : MessageMapper::get_message_wire_number<t_message>());
-
         // Open session if required
         if (open_session){
           try {
@@ -174,8 +168,44 @@ namespace trezor {
         };
 
         // Write/read the request
+        client_write(req);
+        return client_read<t_message>(resp_type, resp_types, resp_type_ptr);
+      }
+
+      /**
+       * First half of client_exchange, sends the request without waiting for the response.
+       * Lets the caller prepare the next request while the device processes this one.
+       * Has to be followed by client_read before any other communication.
+       */
+      void client_write(const std::shared_ptr<const google::protobuf::Message> &req)
+      {
         CHECK_AND_ASSERT_THROW_MES(req, "Request is null");
-        auto msg_resp = call_raw(req.get());
+        write_raw(req.get());
+      }
+
+      /**
+       * Second half of client_exchange, reads the response of the request sent by client_write.
+       *
+       * @throws UnexpectedMessageException if the response message type is different than expected.
+       */
+      template<class t_message=google::protobuf::Message>
+      std::shared_ptr<t_message>
+      client_read(const boost::optional<messages::MessageType> & resp_type = boost::none,
+                  const boost::optional<std::vector<messages::MessageType>> & resp_types = boost::none,
+                  const boost::optional<messages::MessageType*> & resp_type_ptr = boost::none)
+      {
+        // Require strictly protocol buffers response in the template.
+        BOOST_STATIC_ASSERT(boost::is_base_of<google::protobuf::Message, t_message>::value);
+        const bool accepting_base = boost::is_same<google::protobuf::Message, t_message>::value;
+        if (resp_types && !accepting_base){
+          throw std::invalid_argument("Cannot specify list of accepted types and not using generic response");
+        }
+
+        // Determine type of expected message response
+        const messages::MessageType required_type = accepting_base ? messages::MessageType_Success :
+                  (resp_type ? resp_type.get() : MessageMapper::get_message_wire_number<t_message>());
+
+        auto msg_resp = read_raw();
 
         bool processed = false;
         do {
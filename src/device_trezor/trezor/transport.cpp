@@ -207,25 +207,26 @@ namespace trezor{
   void ProtocolV1::write(Transport & transport, const google::protobuf::Message & req){
     const auto msg_size = message_size(req);
     const auto buff_size = serialize_message_buffer_size(msg_size) + 2;
+    const size_t num_chunks = (buff_size + REPLEN - 2) / (REPLEN - 1);
 
     epee::wipeable_string req_buff;
-    epee::wipeable_string chunk_buff;
+    epee::wipeable_string chunks_buff;
 
     req_buff.resize(buff_size);
-    chunk_buff.resize(REPLEN);
+    chunks_buff.resize(num_chunks * REPLEN);
 
     uint8_t * req_buff_raw = reinterpret_cast<uint8_t *>(req_buff.data());
-    uint8_t * chunk_buff_raw = reinterpret_cast<uint8_t *>(chunk_buff.data());
+    uint8_t * chunks_buff_raw = reinterpret_cast<uint8_t *>(chunks_buff.data());
 
     req_buff_raw[0] = '#';
     req_buff_raw[1] = '#';
 
     serialize_message(req, msg_size, req_buff_raw + 2, buff_size - 2);
 
+    // Assemble all chunks first so the transport can upload them in one go
     size_t offset = 0;
-
-    // Chunk by chunk upload
-    while(offset < buff_size){
+    for(size_t i = 0; i < num_chunks; ++i){
+      uint8_t * chunk_buff_raw = chunks_buff_raw + i * REPLEN;
       auto to_copy = std::min((size_t)(buff_size - offset), (size_t)(REPLEN - 1));
 
       chunk_buff_raw[0] = '?';
@@ -236,9 +237,10 @@ namespace trezor{
         memset(chunk_buff_raw + 1 + to_copy, 0, REPLEN - 1 - to_copy);
       }
 
-      transport.write_chunk(chunk_buff_raw, REPLEN);
       offset += REPLEN - 1;
     }
+
+    transport.write_chunks(chunks_buff_raw, num_chunks * REPLEN);
   }
 
   void ProtocolV1::read(Transport & transport, std::shared_ptr<google::protobuf::Message> & msg, messages::MessageType * msg_type){
@@ -264,14 +266,22 @@ namespace trezor{
     epee::wipeable_string data_acc(chunk_buff_raw + 3 + 6, nread);
     data_acc.reserve(len);
 
-    while(nread < len){
-      const size_t cur = transport.read_chunk(chunk_buff_raw, REPLEN);
-      if (chunk_buff_raw[0] != '?'){
-        throw exc::CommunicationException("Chunk malformed");
-      }
+    if (nread < len){
+      // Length is known from the header, fetch all remaining chunks at once
+      const size_t num_chunks = (len - nread + REPLEN - 2) / (REPLEN - 1);
+      epee::wipeable_string chunks_buff;
+      chunks_buff.resize(num_chunks * REPLEN);
+      char * chunks_buff_raw = chunks_buff.data();
+
+      const size_t cur = transport.read_chunks(chunks_buff_raw, num_chunks * REPLEN);
+      for(size_t i = 0; i + REPLEN <= cur; i += REPLEN){
+        if (chunks_buff_raw[i] != '?'){
+          throw exc::CommunicationException("Chunk malformed");
+        }
 
-      data_acc.append(chunk_buff_raw + 1, cur - 1);
-      nread += cur - 1;
+        data_acc.append(chunks_buff_raw + i + 1, REPLEN - 1);
+        nread += REPLEN - 1;
+      }
     }
 
     if (msg_type){
@@ -299,6 +309,26 @@ namespace trezor{
 
   }
 
+  void Transport::write_chunks(const void * buff, size_t size) {
+    const char * buff_raw = reinterpret_cast<const char *>(buff);
+    for(size_t offset = 0; offset < size; offset += REPLEN){
+      write_chunk(buff_raw + offset, std::min((size_t)REPLEN, size - offset));
+    }
+  }
+
+  size_t Transport::read_chunks(void * buff, size_t size) {
+    char * buff_raw = reinterpret_cast<char *>(buff);
+    size_t nread = 0;
+    while(nread < size){
+      const size_t cur = read_chunk(buff_raw + nread, std::min((size_t)REPLEN, size - nread));
+      if (cur == 0){
+        break;
+      }
+      nread += cur;
+    }
+    return nread;
+  }
+
   bool Transport::pre_open(){
     if (m_open_counter > 0){
       MTRACE("Already opened, count: " << m_open_counter);
@@ -430,6 +460,7 @@ namespace trezor{
     }
 
     MTRACE("Closing Trezor:BridgeTransport");
+    wait_response();
     if (!m_device_path || !m_session){
       throw exc::CommunicationException("Device not open");
     }
@@ -445,7 +476,21 @@ namespace trezor{
     m_session = boost::none;
   }
 
+  void BridgeTransport::wait_response() {
+    if (!m_response_future.valid()){
+      return;
+    }
+
+    // Unclaimed response of the previous call, the http client must be idle before reuse
+    try {
+      m_response_future.get();
+    } catch(const std::exception & e){
+      MDEBUG("Dropping unclaimed bridge response: " << e.what());
+    }
+  }
+
   void BridgeTransport::write(const google::protobuf::Message &req) {
+    wait_response();
     m_response = boost::none;
 
     const auto msg_size = message_size(req);
@@ -458,18 +503,25 @@ namespace trezor{
     serialize_message(req, msg_size, req_buff_raw, buff_size);
 
     std::string uri = "/call/" + m_session.get();
-    epee::wipeable_string res_hex;
     epee::wipeable_string req_hex = epee::to_hex::wipeable_string(epee::span<const std::uint8_t>(req_buff_raw, buff_size));
 
-    bool req_status = invoke_bridge_http(uri, req_hex, res_hex, m_http_client);
-    if (!req_status){
-      throw exc::CommunicationException("Call method failed");
-    }
-
-    m_response = res_hex;
+    // The bridge call returns only once the device responded. Run it in the background
+    // so the caller can prepare the next request meanwhile, read() collects the result.
+    m_response_future = std::async(std::launch::async, [this, uri, req_hex]() {
+      epee::wipeable_string res_hex;
+      bool req_status = invoke_bridge_http(uri, req_hex, res_hex, m_http_client);
+      if (!req_status){
+        throw exc::CommunicationException("Call method failed");
+      }
+      return res_hex;
+    });
   }
 
   void BridgeTransport::read(std::shared_ptr<google::protobuf::Message> & msg, messages::MessageType * msg_type) {
+    if (m_response_future.valid()){
+      m_response = m_response_future.get();
+    }
+
     if (!m_response){
       throw exc::CommunicationException("Could not read, no response stored");
     }
@@ -1148,6 +1200,43 @@ namespace trezor{
     return transferred;
   };
 
+  void WebUsbTransport::write_chunks(const void * buff, size_t size) {
+    require_connected();
+    if (size == 0 || size % REPLEN != 0){
+      throw exc::CommunicationException("Invalid chunks size");
+    }
+
+    // Single transfer, libusb splits it to REPLEN packets on the interrupt endpoint
+    unsigned char endpoint = get_endpoint();
+    endpoint = (endpoint & ~LIBUSB_ENDPOINT_DIR_MASK) | LIBUSB_ENDPOINT_OUT;
+
+    int transferred = 0;
+    int r = libusb_interrupt_transfer(m_usb_device_handle, endpoint, (unsigned char*)buff, (int)size, &transferred, 0);
+    CHECK_AND_ASSERT_THROW_MES(r == 0, "Unable to transfer, r: " << r);
+    if (transferred != (int)size){
+      throw exc::CommunicationException("Could not transfer chunks");
+    }
+  };
+
+  size_t WebUsbTransport::read_chunks(void * buff, size_t size) {
+    require_connected();
+    if (size == 0 || size % REPLEN != 0){
+      throw exc::CommunicationException("Invalid chunks size");
+    }
+
+    unsigned char endpoint = get_endpoint();
+    endpoint = (endpoint & ~LIBUSB_ENDPOINT_DIR_MASK) | LIBUSB_ENDPOINT_IN;
+
+    int transferred = 0;
+    int r = libusb_interrupt_transfer(m_usb_device_handle, endpoint, (unsigned char*)buff, (int)size, &transferred, 0);
+    CHECK_AND_ASSERT_THROW_MES(r == 0, "Unable to transfer, r: " << r);
+    if (transferred != (int)size){
+      throw exc::CommunicationException("Could not read the chunks");
+    }
+
+    return transferred;
+  };
+
   std::ostream& WebUsbTransport::dump(std::ostream& o) const {
     o << "WebUsbTransport<path=" << get_path()
              << ", vendorId=" << (m_usb_device_desc ? std::to_string(m_usb_device_desc->idVendor) : "?")
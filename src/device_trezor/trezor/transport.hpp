@@ -36,6 +36,7 @@
 #include <boost/array.hpp>
 #include <boost/utility/string_ref.hpp>
 
+#include <future>
 #include <typeinfo>
 #include <type_traits>
 #include "net/http_client.h"
@@ -159,6 +160,13 @@ namespace trezor {
 
     virtual void write_chunk(const void * buff, size_t size) { };
     virtual size_t read_chunk(void * buff, size_t size) { return 0; };
+
+    /**
+     * Writes / reads a run of consecutive REPLEN chunks. Transports able to move
+     * several chunks in one transfer override these, default is chunk by chunk.
+     */
+    virtual void write_chunks(const void * buff, size_t size);
+    virtual size_t read_chunks(void * buff, size_t size);
     virtual std::ostream& dump(std::ostream& o) const { return o << "Transport<>"; }
   protected:
     long m_open_counter;
@@ -191,11 +199,14 @@ namespace trezor {
     std::ostream& dump(std::ostream& o) const override;
 
   private:
+    void wait_response();
+
     epee::net_utils::http::http_simple_client m_http_client;
     std::string m_bridge_host;
     boost::optional<std::string> m_device_path;
     boost::optional<std::string> m_session;
     boost::optional<epee::wipeable_string> m_response;
+    std::future<epee::wipeable_string> m_response_future;
     boost::optional<json> m_device_info;
   };
 
@@ -276,6 +287,8 @@ namespace trezor {
 
     void write_chunk(const void * buff, size_t size) override;
     size_t read_chunk(void * buff, size_t size) override;
+    void write_chunks(const void * buff, size_t size) override;
+    size_t read_chunks(void * buff, size_t size) override;
 
     std::ostream& dump(std::ostream& o) const override;
 
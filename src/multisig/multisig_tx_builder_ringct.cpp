@@ -30,6 +30,7 @@
 
 #include "int-util.h"
 #include "memwipe.h"
+#include "common/threadpool.h"
 
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/account.h"
@@ -719,7 +720,9 @@ static bool set_tx_rct_signatures(
   if (not reconstruction)
     cached_w.resize(num_sources);
 
-  for (std::size_t i = 0; i < num_sources; ++i) {
+  // the inputs' CLSAG contexts (ring precomputations, hashes to points) don't depend on each other,
+  // so they are prepared in parallel
+  const auto prepare_input = [&](const std::size_t i) -> bool {
     const std::size_t ring_size = rv.mixRing[i].size();
     const rct::key& I = sources[i].multisig_kLRki.ki;
     const std::size_t l = sources[i].real_output;
@@ -780,7 +783,18 @@ static bool set_tx_rct_signatures(
       sc_mul(cached_w[i].bytes, mu_P.bytes, input_secret_keys[i].bytes);
       sc_muladd(cached_w[i].bytes, mu_C.bytes, z.bytes, cached_w[i].bytes);
     }
-  }
+    return true;
+  };
+
+  std::vector<char> inputs_ready(num_sources, 0);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (std::size_t i = 0; i < num_sources; ++i)
+    tpool.submit(&waiter, [&, i]{ inputs_ready[i] = prepare_input(i); }, true);
+  if (not waiter.wait())
+    return false;
+  if (std::find(inputs_ready.begin(), inputs_ready.end(), 0) != inputs_ready.end())
+    return false;
   unsigned_tx.rct_signatures = std::move(rv);
   return true;
 }
@@ -992,7 +1006,8 @@ bool tx_builder_ringct_t::next_partial_sign(
     return false;
   if (num_sources != s.size())
     return false;
-  for (std::size_t i = 0; i < num_sources; ++i) {
+  // the inputs' challenges and responses don't depend on each other
+  const auto sign_input = [&](const std::size_t i) -> bool {
     rct::key c;
     rct::key alpha_combined;
     auto alpha_combined_wiper = epee::misc_utils::create_scope_leave_handler([&]{
@@ -1022,7 +1037,18 @@ bool tx_builder_ringct_t::next_partial_sign(
     //      s += alpha_combined_local - challenge*[mu_P*(local keys)]
     sc_add(s[i].bytes, s[i].bytes, alpha_combined.bytes);
     sc_mulsub(s[i].bytes, c.bytes, w.bytes, s[i].bytes);
-  }
+    return true;
+  };
+
+  std::vector<char> inputs_signed(num_sources, 0);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (std::size_t i = 0; i < num_sources; ++i)
+    tpool.submit(&waiter, [&, i]{ inputs_signed[i] = sign_input(i); }, true);
+  if (not waiter.wait())
+    return false;
+  if (std::find(inputs_signed.begin(), inputs_signed.end(), 0) != inputs_signed.end())
+    return false;
   return true;
 }
 //----------------------------------------------------------------------------------------------------------------------
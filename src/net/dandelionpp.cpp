@@ -44,22 +44,6 @@ namespace dandelionpp
     {
         constexpr const std::size_t expected_max_channels = CRYPTONOTE_NOISE_CHANNELS;
 
-        // could be in util somewhere
-        struct key_less
-        {
-            template<typename K, typename V>
-            bool operator()(const std::pair<K, V>& left, const K& right) const
-            {
-                return left.first < right;
-            }
-
-            template<typename K, typename V>
-            bool operator()(const K& left, const std::pair<K, V>& right) const
-            {
-                return left < right.first;
-            }
-        };
-
         std::size_t select_stem(epee::span<const std::size_t> usage, epee::span<const boost::uuids::uuid> out_map)
         {
             assert(usage.size() < std::numeric_limits<std::size_t>::max()); // prevented in constructor
@@ -182,14 +166,14 @@ namespace dandelionpp
 
     boost::uuids::uuid connection_map::get_stem(const boost::uuids::uuid& source)
     {
-        auto elem = std::lower_bound(in_mapping_.begin(), in_mapping_.end(), source, key_less{});
-        if (elem == in_mapping_.end() || elem->first != source)
+        auto elem = in_mapping_.find(source);
+        if (elem == in_mapping_.end())
         {
             const std::size_t index = select_stem(epee::to_span(usage_count_), epee::to_span(out_mapping_));
             if (out_mapping_.size() < index)
                 return boost::uuids::nil_uuid();
 
-            elem = in_mapping_.emplace(elem, source, index);
+            elem = in_mapping_.emplace(source, index).first;
             usage_count_[index]++;
         }
         else if (out_mapping_.at(elem->second).is_nil()) // stem connection disconnected after mapping
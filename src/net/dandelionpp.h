@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <cstddef>
 #include <memory>
@@ -45,7 +47,7 @@ namespace dandelionpp
     {
         // Make sure to update clone method if changing members
         std::vector<boost::uuids::uuid> out_mapping_; //<! Current outgoing uuid connection at index.
-        std::vector<std::pair<boost::uuids::uuid, std::size_t>> in_mapping_; //<! uuid source to an `out_mapping_` index.
+        boost::unordered_map<boost::uuids::uuid, std::size_t> in_mapping_; //<! uuid source to an `out_mapping_` index, looked up for every stem tx.
         std::vector<std::size_t> usage_count_;
 
         // Use clone method to prevent "hidden" copies.
@@ -99,6 +101,12 @@ namespace dandelionpp
         //! \return Number of outgoing connections in use.
         std::size_t size() const noexcept;
 
+        //! \return Number of sources mapped to a stem this epoch.
+        std::size_t sources() const noexcept
+        {
+            return in_mapping_.size();
+        }
+
         //! \return Current stem mapping for `source` or `nil_uuid()` if none is possible.
         boost::uuids::uuid get_stem(const boost::uuids::uuid& source);
     };
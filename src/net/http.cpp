@@ -29,6 +29,9 @@
 
 #include "http.h"
 
+#include <chrono>
+#include <memory>
+
 #include "parse.h"
 #include "socks_connect.h"
 
@@ -37,6 +40,16 @@ namespace net
 namespace http
 {
 
+namespace
+{
+  //! Proxy connections raced per connect, the loser is kept as a spare
+  constexpr const unsigned proxy_parallel_connects = 2;
+
+  //! Spares older than this are dropped before the daemon closes them
+  constexpr const std::chrono::seconds proxy_spare_max_idle{30};
+  constexpr const std::size_t proxy_max_spares = 2;
+}
+
 bool client::set_proxy(const std::string &address)
 {
   if (address.empty())
@@ -53,7 +66,9 @@ bool client::set_proxy(const std::string &address)
     }
     else
     {
-      set_connector(net::socks::connector{*endpoint});
+      set_connector(net::socks::connector{
+        *endpoint, proxy_parallel_connects, std::make_shared<net::socks::connection_pool>(proxy_spare_max_idle, proxy_max_spares)
+      });
     }
   }
 
@@ -38,6 +38,9 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_bin_reader.h"
+#include "storages/portable_storage_bin_writer.h"
+#include "storages/portable_storage_json_writer.h"
 #include "string_tools_lexical.h"
 
 namespace net
@@ -120,7 +123,8 @@ namespace net
         return i2p_address{host, porti};
     }
 
-    bool i2p_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    template<typename t_storage>
+    bool i2p_address::load_from(t_storage& src, typename t_storage::hsection hparent)
     {
         i2p_serialized in{};
         if (in._load(src, hparent) && in.host.size() < sizeof(host_) && (in.host == unknown_host || !host_check(in.host).has_error()))
@@ -136,12 +140,43 @@ namespace net
         return false;
     }
 
-    bool i2p_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+    template<typename t_storage>
+    bool i2p_address::store_to(t_storage& dest, typename t_storage::hsection hparent) const
     {
         const i2p_serialized out{std::string{host_}, port_};
         return out.store(dest, hparent);
     }
 
+    bool i2p_address::_load(epee::serialization::portable_storage& src, epee::serialization::section* hparent)
+    {
+        return load_from(src, hparent);
+    }
+
+    bool i2p_address::_load(epee::serialization::binary_reader& src, const epee::serialization::binary_reader_section* hparent)
+    {
+        return load_from(src, hparent);
+    }
+
+    bool i2p_address::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+    {
+        return store_to(dest, hparent);
+    }
+
+    bool i2p_address::store(epee::serialization::binary_writer<epee::byte_stream>& dest, epee::serialization::binary_writer_frame* hparent) const
+    {
+        return store_to(dest, hparent);
+    }
+
+    bool i2p_address::store(epee::serialization::binary_writer<std::string>& dest, epee::serialization::binary_writer_frame* hparent) const
+    {
+        return store_to(dest, hparent);
+    }
+
+    bool i2p_address::store(epee::serialization::json_writer& dest, epee::serialization::json_writer_frame* hparent) const
+    {
+        return store_to(dest, hparent);
+    }
+
     i2p_address::i2p_address(const i2p_address& rhs) noexcept
       : port_(rhs.port_)
     {
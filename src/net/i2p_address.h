@@ -38,10 +38,17 @@
 
 namespace epee
 {
+    class byte_stream;
 namespace serialization
 {
     class portable_storage;
     struct section;
+    class binary_reader;
+    struct binary_reader_section;
+    template<class t_stream> class binary_writer;
+    struct binary_writer_frame;
+    class json_writer;
+    struct json_writer_frame;
 }
 }
 
@@ -56,6 +63,12 @@ namespace net
         //! Keep in private, `host.size()` has no runtime check
         i2p_address(boost::string_ref host, std::uint16_t port) noexcept;
 
+        template<typename t_storage>
+        bool load_from(t_storage& src, typename t_storage::hsection hparent);
+
+        template<typename t_storage>
+        bool store_to(t_storage& dest, typename t_storage::hsection hparent) const;
+
     public:
         //! \return Size of internal buffer for host.
         static constexpr std::size_t buffer_size() noexcept { return sizeof(host_); }
@@ -78,9 +91,13 @@ namespace net
 
         //! Load from epee p2p format, and \return false if not valid tor address
         bool _load(epee::serialization::portable_storage& src, epee::serialization::section* hparent);
+        bool _load(epee::serialization::binary_reader& src, const epee::serialization::binary_reader_section* hparent);
 
         //! Store in epee p2p format
         bool store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const;
+        bool store(epee::serialization::binary_writer<epee::byte_stream>& dest, epee::serialization::binary_writer_frame* hparent) const;
+        bool store(epee::serialization::binary_writer<std::string>& dest, epee::serialization::binary_writer_frame* hparent) const;
+        bool store(epee::serialization::json_writer& dest, epee::serialization::json_writer_frame* hparent) const;
 
         // Moves and copies are currently identical
 
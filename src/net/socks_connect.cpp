@@ -30,9 +30,12 @@
 
 #include <boost/system/error_code.hpp>
 #include <boost/system/system_error.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <system_error>
+#include <vector>
 
 #include "net/error.h"
 #include "net/net_utils_base.h"
@@ -44,45 +47,173 @@ namespace net
 {
 namespace socks
 {
-    boost::unique_future<boost::asio::ip::tcp::socket>
-    connector::operator()(const std::string& remote_host, const std::string& remote_port, boost::asio::steady_timer& timeout) const
+    namespace
     {
+        //! State shared by the proxy connections started for one request
+        struct race
+        {
+            boost::mutex sync;
+            boost::promise<boost::asio::ip::tcp::socket> result;
+            std::vector<std::weak_ptr<client>> clients;
+            std::shared_ptr<connection_pool> pool;
+            std::string host;
+            std::string port;
+            std::size_t remaining;
+            bool done;
+        };
+
         struct future_socket
         {
-            boost::promise<boost::asio::ip::tcp::socket> result_;
+            std::shared_ptr<race> race_;
 
             void operator()(boost::system::error_code error, boost::asio::ip::tcp::socket&& socket)
             {
-                if (error)
-                    result_.set_exception(boost::system::system_error{error});
-                else
-                    result_.set_value(std::move(socket));
+                race& state = *race_;
+                std::vector<std::weak_ptr<client>> losers;
+                {
+                    const boost::lock_guard<boost::mutex> lock{state.sync};
+                    --state.remaining;
+                    if (state.done)
+                    {
+                        if (!error && state.pool)
+                            state.pool->put(state.host, state.port, std::move(socket));
+                        return;
+                    }
+
+                    if (error)
+                    {
+                        if (state.remaining)
+                            return; // another connection may still succeed
+                        state.result.set_exception(boost::system::system_error{error});
+                    }
+                    else
+                    {
+                        state.result.set_value(std::move(socket));
+                        if (!state.pool)
+                            losers = std::move(state.clients);
+                    }
+                    state.done = true;
+                }
+
+                for (const std::weak_ptr<client>& loser : losers)
+                    client::async_close{loser.lock()}();
             }
         };
+    } // anonymous
+
+    connection_pool::connection_pool(const std::chrono::steady_clock::duration max_idle, const std::size_t max_size)
+      : sync_(), spares_(), max_idle_(max_idle), max_size_(max_size)
+    {}
+
+    boost::optional<boost::asio::ip::tcp::socket> connection_pool::take(const std::string& host, const std::string& port)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        for (auto spare = spares_.begin(); spare != spares_.end(); )
+        {
+            if (max_idle_ < now - spare->added)
+            {
+                spare = spares_.erase(spare);
+                continue;
+            }
+            if (spare->host != host || spare->port != port)
+            {
+                ++spare;
+                continue;
+            }
+
+            boost::asio::ip::tcp::socket socket{std::move(spare->socket)};
+            spare = spares_.erase(spare);
 
+            /* A peek that would block means the other end has neither closed
+               the connection nor sent anything, so it is still usable. */
+            std::uint8_t byte = 0;
+            boost::system::error_code error{};
+            socket.non_blocking(true, error);
+            if (!error)
+                socket.receive(boost::asio::buffer(std::addressof(byte), 1), boost::asio::socket_base::message_peek, error);
+            if (error == boost::asio::error::would_block)
+            {
+                socket.non_blocking(false, error);
+                if (!error)
+                    return {std::move(socket)};
+            }
+        }
+        return boost::none;
+    }
+
+    void connection_pool::put(std::string host, std::string port, boost::asio::ip::tcp::socket&& socket)
+    {
+        if (!max_size_ || !socket.is_open())
+            return;
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        if (max_size_ <= spares_.size())
+            spares_.pop_front();
+        spares_.push_back(entry{std::move(host), std::move(port), std::chrono::steady_clock::now(), std::move(socket)});
+    }
+
+    std::size_t connection_pool::size()
+    {
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        return spares_.size();
+    }
+
+    boost::unique_future<boost::asio::ip::tcp::socket>
+    connector::operator()(const std::string& remote_host, const std::string& remote_port, boost::asio::steady_timer& timeout) const
+    {
         boost::unique_future<boost::asio::ip::tcp::socket> out{};
         {
             std::uint16_t port = 0;
             if (!epee::string_tools::get_xtype_from_string(port, remote_port))
                 throw std::system_error{net::error::invalid_port, "Remote port for socks proxy"};
 
-            bool is_set = false;
+            if (pool)
+            {
+                boost::optional<boost::asio::ip::tcp::socket> spare = pool->take(remote_host, remote_port);
+                if (spare)
+                {
+                    boost::promise<boost::asio::ip::tcp::socket> result{};
+                    out = result.get_future();
+                    result.set_value(std::move(*spare));
+                    return out;
+                }
+            }
+
+            const auto state = std::make_shared<race>();
+            state->pool = pool;
+            state->host = remote_host;
+            state->port = remote_port;
+            state->remaining = std::max(1u, parallel);
+            state->done = false;
+            out = state->result.get_future();
+
             std::uint32_t ip_address = 0;
-            boost::promise<boost::asio::ip::tcp::socket> result{};
-            out = result.get_future();
-            const auto proxy = net::socks::make_connect_client(
-                boost::asio::ip::tcp::socket{GET_IO_SERVICE(timeout)}, net::socks::version::v4a, future_socket{std::move(result)}
-            );
+            const bool is_ip = epee::string_tools::get_ip_int32_from_string(ip_address, remote_host);
 
-            if (epee::string_tools::get_ip_int32_from_string(ip_address, remote_host))
-                is_set = proxy->set_connect_command(epee::net_utils::ipv4_network_address{ip_address, port});
-            else
-                is_set = proxy->set_connect_command(remote_host, port);
+            const boost::lock_guard<boost::mutex> lock{state->sync};
+            for (std::size_t i = state->remaining; i; --i)
+            {
+                bool is_set = false;
+                const auto proxy = net::socks::make_connect_client(
+                    boost::asio::ip::tcp::socket{GET_IO_SERVICE(timeout)}, net::socks::version::v4a, future_socket{state}
+                );
+
+                if (is_ip)
+                    is_set = proxy->set_connect_command(epee::net_utils::ipv4_network_address{ip_address, port});
+                else
+                    is_set = proxy->set_connect_command(remote_host, port);
 
-            if (!is_set || !net::socks::client::connect_and_send(proxy, proxy_address))
-                throw std::system_error{net::error::invalid_host, "Address for socks proxy"};
+                if (!is_set || !net::socks::client::connect_and_send(proxy, proxy_address))
+                {
+                    for (const std::weak_ptr<client>& started : state->clients)
+                        client::async_close{started.lock()}();
+                    state->done = true;
+                    throw std::system_error{net::error::invalid_host, "Address for socks proxy"};
+                }
 
-            timeout.async_wait(net::socks::client::async_close{std::move(proxy)});
+                state->clients.push_back(proxy);
+                timeout.async_wait(net::socks::client::async_close{std::move(proxy)});
+            }
         }
 
         return out;
@@ -30,18 +30,68 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/optional/optional.hpp>
 #include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
 #include <string>
 
 namespace net
 {
 namespace socks
 {
+    /*! Connected sockets kept for a later request to the same destination.
+        Every socket must belong to the same `io_service`, so share a pool
+        only between connectors used by one client. Thread-safe. */
+    class connection_pool
+    {
+        struct entry
+        {
+            std::string host;
+            std::string port;
+            std::chrono::steady_clock::time_point added;
+            boost::asio::ip::tcp::socket socket;
+        };
+
+        boost::mutex sync_;
+        std::deque<entry> spares_;
+        const std::chrono::steady_clock::duration max_idle_;
+        const std::size_t max_size_;
+
+    public:
+        /*! \param max_idle Sockets older than this are dropped, servers close
+                idle connections eventually.
+            \param max_size Most spare sockets kept, oldest dropped first. */
+        connection_pool(std::chrono::steady_clock::duration max_idle, std::size_t max_size);
+
+        connection_pool(const connection_pool&) = delete;
+        connection_pool& operator=(const connection_pool&) = delete;
+
+        //! \return A spare socket to `host:port` that is still open, if any.
+        boost::optional<boost::asio::ip::tcp::socket> take(const std::string& host, const std::string& port);
+
+        //! Keep `socket` for a later `take(host, port)`.
+        void put(std::string host, std::string port, boost::asio::ip::tcp::socket&& socket);
+
+        std::size_t size();
+    };
+
     //! Primarily for use with `epee::net_utils::http_client`.
     struct connector
     {
         boost::asio::ip::tcp::endpoint proxy_address;
 
+        /*! Proxy connections started per request. The first one to connect is
+            returned, which hides a slow stream setup behind a faster one. */
+        unsigned parallel = 1;
+
+        /*! If set, a spare socket is handed out before connecting, and
+            connections beaten by a faster one are kept here. */
+        std::shared_ptr<connection_pool> pool;
+
         /*! Creates a new socket, asynchronously connects to `proxy_address`,
             and requests a connection to `remote_host` on `remote_port`. Sets
             socket as closed if `timeout` is reached.
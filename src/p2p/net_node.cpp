@@ -170,6 +170,9 @@ namespace nodetool
       "pad-transactions", "Pad relayed transactions to help defend against traffic volume analysis", false
     };
     const command_line::arg_descriptor<uint32_t> arg_max_connections_per_ip = {"max-connections-per-ip", "Maximum number of connections allowed from the same IP address", 1};
+    const command_line::arg_descriptor<uint32_t> arg_p2p_io_threads = {"p2p-io-threads", "Spread p2p connections over this many io_services with their own threads (0 to share the p2p thread pool)", 0};
+    const command_line::arg_descriptor<bool> arg_p2p_pin_io_threads = {"p2p-pin-io-threads", "Pin the threads of each p2p io_service to one CPU", false};
+    const command_line::arg_descriptor<uint32_t> arg_p2p_connect_parallelism = {"p2p-connect-parallelism", "Number of outgoing connection attempts to run at once", P2P_DEFAULT_CONNECT_PARALLELISM};
 
     boost::optional<std::vector<proxy>> get_proxies(boost::program_options::variables_map const& vm)
     {
@@ -173,6 +173,7 @@ namespace nodetool
           m_proxy_address(),
           m_current_number_of_out_peers(0),
           m_current_number_of_in_peers(0),
+          m_stored_peerlist_version(0),
           m_seed_nodes_lock(),
           m_can_pingback(false),
           m_seed_nodes_initialized(false)
@@ -195,6 +196,7 @@ namespace nodetool
           m_proxy_address(),
           m_current_number_of_out_peers(0),
           m_current_number_of_in_peers(0),
+          m_stored_peerlist_version(0),
           m_seed_nodes_lock(),
           m_can_pingback(false),
           m_seed_nodes_initialized(false)
@@ -216,6 +218,7 @@ namespace nodetool
       boost::asio::ip::tcp::endpoint m_proxy_address;
       std::atomic<unsigned int> m_current_number_of_out_peers;
       std::atomic<unsigned int> m_current_number_of_in_peers;
+      uint64_t m_stored_peerlist_version; // m_peerlist version last written to disk
       boost::shared_mutex m_seed_nodes_lock;
       bool m_can_pingback;
       bool m_seed_nodes_initialized;
@@ -254,6 +257,7 @@ namespace nodetool
         m_igd(no_igd),
         m_offline(false),
         is_closing(false),
+        m_connect_parallelism(P2P_DEFAULT_CONNECT_PARALLELISM),
         m_network_id(),
         m_enable_dns_seed_nodes(true),
         max_connections(1)
@@ -343,6 +347,9 @@ namespace nodetool
     //----------------- i_p2p_endpoint -------------------------------------------------------------
     virtual bool relay_notify_to_list(int command, epee::levin::message_writer message, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections) final;
     virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, cryptonote::relay_method tx_relay);
+    virtual void on_tx_sketch_request(const epee::net_utils::connection_context_base& context, uint64_t salt, uint64_t set_size);
+    virtual void on_tx_sketch(const epee::net_utils::connection_context_base& context, std::string sketch);
+    virtual void on_tx_reconciliation_diff(const epee::net_utils::connection_context_base& context, bool success, std::string short_tx_ids);
     virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context) final;
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context);
     virtual void request_callback(const epee::net_utils::connection_context_base& context);
@@ -371,6 +378,7 @@ namespace nodetool
 
     bool make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist);
     bool make_new_connection_from_peerlist(network_zone& zone, bool use_white_list);
+    bool make_new_connections_from_peerlist(network_zone& zone, bool use_white_list, size_t needed);
     bool try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, PeerType peer_type = white, uint64_t first_seen_stamp = 0);
     size_t get_random_index_with_fixed_probability(size_t max_index);
     bool is_peer_used(const peerlist_entry& peer);
@@ -390,6 +398,10 @@ namespace nodetool
     bool make_expected_connections_count(network_zone& zone, PeerType peer_type, size_t expected_connections);
     void record_addr_failed(const epee::net_utils::network_address& addr);
     bool is_addr_recently_failed(const epee::net_utils::network_address& addr);
+    bool try_mark_dialing(const epee::net_utils::network_address& addr);
+    void unmark_dialing(const epee::net_utils::network_address& addr);
+    void record_peer_latency(const epee::net_utils::network_address& addr, uint64_t ms);
+    bool get_peer_latency(const epee::net_utils::network_address& addr, uint64_t& ms);
     bool is_priority_node(const epee::net_utils::network_address& na);
     std::set<std::string> get_ip_seed_nodes() const;
     std::set<std::string> get_dns_seed_nodes();
@@ -498,6 +510,13 @@ namespace nodetool
     std::map<std::string, time_t> m_conn_fails_cache;
     epee::critical_section m_conn_fails_cache_lock;
 
+    // hosts with an outgoing connection attempt in flight, and the time (ms)
+    // the last successful connect and handshake to an address took
+    epee::critical_section m_dialing_lock;
+    std::set<std::string> m_dialing_hosts;
+    std::map<std::string, uint64_t> m_peer_latency;
+    uint32_t m_connect_parallelism;
+
     epee::critical_section m_blocked_hosts_lock; // for both hosts and subnets
     std::map<std::string, time_t> m_blocked_hosts;
     std::map<epee::net_utils::ipv4_network_subnet, time_t> m_blocked_subnets;
@@ -552,6 +571,9 @@ namespace nodetool
     extern const command_line::arg_descriptor<int64_t> arg_limit_rate;
     extern const command_line::arg_descriptor<bool> arg_pad_transactions;
     extern const command_line::arg_descriptor<uint32_t> arg_max_connections_per_ip;
+    extern const command_line::arg_descriptor<uint32_t> arg_p2p_io_threads;
+    extern const command_line::arg_descriptor<bool> arg_p2p_pin_io_threads;
+    extern const command_line::arg_descriptor<uint32_t> arg_p2p_connect_parallelism;
 }
 
 POP_WARNINGS
@@ -39,6 +39,7 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/algorithm/string.hpp>
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -131,6 +132,9 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate);
     command_line::add_arg(desc, arg_pad_transactions);
     command_line::add_arg(desc, arg_max_connections_per_ip);
+    command_line::add_arg(desc, arg_p2p_io_threads);
+    command_line::add_arg(desc, arg_p2p_pin_io_threads);
+    command_line::add_arg(desc, arg_p2p_connect_parallelism);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -556,6 +560,9 @@ namespace nodetool
     if ( !set_rate_limit(vm, command_line::get_arg(vm, arg_limit_rate) ) )
       return false;
 
+    public_zone.m_net_server.set_io_shards(command_line::get_arg(vm, arg_p2p_io_threads), command_line::get_arg(vm, arg_p2p_pin_io_threads));
+    m_connect_parallelism = std::max<uint32_t>(1, command_line::get_arg(vm, arg_p2p_connect_parallelism));
+
 
     epee::byte_slice noise = nullptr;
     auto proxies = get_proxies(vm);
@@ -1083,6 +1090,19 @@ namespace nodetool
       return false;
     }
 
+    // the peer lists are the only part of the state that changes at runtime,
+    // so skip the rewrite if none of them did since the last save
+    std::vector<std::pair<network_zone*, uint64_t>> versions;
+    versions.reserve(m_network_zones.size());
+    bool changed = false;
+    for (auto& zone : m_network_zones)
+    {
+      versions.emplace_back(std::addressof(zone.second), zone.second.m_peerlist.get_version());
+      changed |= versions.back().second != zone.second.m_stored_peerlist_version;
+    }
+    if (!changed)
+      return true;
+
     peerlist_types active{};
     for (auto& zone : m_network_zones)
       zone.second.m_peerlist.get_peerlist(active);
@@ -1093,6 +1113,9 @@ namespace nodetool
       MWARNING("Failed to save config to file " << state_file_path);
       return false;
     }
+
+    for (const auto& version : versions)
+      version.first->m_stored_peerlist_version = version.second;
     CATCH_ENTRY_L0("node_server::store", false);
     return true;
   }
@@ -1373,6 +1396,7 @@ namespace nodetool
         << (last_seen_stamp ? epee::misc_utils::get_time_interval_string(time(NULL) - last_seen_stamp):"never")
         << ")...");
 
+    const auto dial_start = std::chrono::steady_clock::now();
     auto con = zone.m_connect(zone, na, m_ssl_support);
     if(!con)
     {
@@ -1397,6 +1421,8 @@ namespace nodetool
       return false;
     }
 
+    record_peer_latency(na, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - dial_start).count());
+
     if(just_take_peerlist)
     {
       zone.m_net_server.get_config_object().close(con->m_connection_id);
@@ -1493,6 +1519,47 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::try_mark_dialing(const epee::net_utils::network_address& addr)
+  {
+    CRITICAL_REGION_LOCAL(m_dialing_lock);
+    return m_dialing_hosts.insert(addr.host_str()).second;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::unmark_dialing(const epee::net_utils::network_address& addr)
+  {
+    CRITICAL_REGION_LOCAL(m_dialing_lock);
+    m_dialing_hosts.erase(addr.host_str());
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::record_peer_latency(const epee::net_utils::network_address& addr, uint64_t ms)
+  {
+    CRITICAL_REGION_LOCAL(m_dialing_lock);
+    const std::string key = addr.str();
+    auto it = m_peer_latency.find(key);
+    if (it != m_peer_latency.end())
+    {
+      it->second = (it->second * 3 + ms) / 4;
+      return;
+    }
+    if (m_peer_latency.size() >= P2P_LOCAL_WHITE_PEERLIST_LIMIT)
+      m_peer_latency.erase(m_peer_latency.begin());
+    m_peer_latency.emplace(key, ms);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::get_peer_latency(const epee::net_utils::network_address& addr, uint64_t& ms)
+  {
+    CRITICAL_REGION_LOCAL(m_dialing_lock);
+    const auto it = m_peer_latency.find(addr.str());
+    if (it == m_peer_latency.end())
+      return false;
+    ms = it->second;
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist)
   {
     for (const auto& pe: anchor_peerlist) {
@@ -1646,6 +1713,18 @@ namespace nodetool
       {
         // if using the white list, we first pick in the set of peers we've already been using earlier
         random_index = get_random_index_with_fixed_probability(std::min<uint64_t>(filtered.size() - 1, 20));
+        // draw a second candidate and keep whichever connected faster last time
+        const size_t other_index = get_random_index_with_fixed_probability(std::min<uint64_t>(filtered.size() - 1, 20));
+        if (other_index != random_index)
+        {
+          peerlist_entry first, second;
+          uint64_t first_ms = 0, second_ms = 0;
+          if (zone.m_peerlist.get_white_peer_by_index(first, filtered[random_index]) &&
+              zone.m_peerlist.get_white_peer_by_index(second, filtered[other_index]) &&
+              get_peer_latency(second.adr, second_ms) &&
+              (!get_peer_latency(first.adr, first_ms) || second_ms < first_ms))
+            random_index = other_index;
+        }
         CRITICAL_REGION_LOCAL(m_used_stripe_peers_mutex);
         if (next_needed_pruning_stripe > 0 && next_needed_pruning_stripe <= (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES) && !m_used_stripe_peers[next_needed_pruning_stripe-1].empty())
         {
@@ -1699,6 +1778,11 @@ namespace nodetool
       if(is_addr_recently_failed(pe.adr))
         continue;
 
+      // another dialer is already trying this host
+      if(!try_mark_dialing(pe.adr))
+        continue;
+      epee::misc_utils::auto_scope_leave_caller dialing_guard = epee::misc_utils::create_scope_leave_handler([&](){ unmark_dialing(pe.adr); });
+
       MDEBUG("Selected peer: " << peerid_to_string(pe.id) << " " << pe.adr.str()
                     << ", pruning seed " << epee::string_tools::to_string_hex(pe.pruning_seed) << " "
                     << "[peer_list=" << (use_white_list ? white : gray)
@@ -1715,6 +1799,46 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::make_new_connections_from_peerlist(network_zone& zone, bool use_white_list, size_t needed)
+  {
+    const size_t dialers = std::min<size_t>(needed, m_connect_parallelism);
+    if (dialers <= 1)
+      return make_new_connection_from_peerlist(zone, use_white_list);
+
+    // Each dialer fills one missing slot. The extra ones start staggered, so a
+    // burst of dead peers costs one connection timeout rather than one each,
+    // while a quick first answer does not leave us with more than we need.
+    const size_t target = get_outgoing_connections_count(zone) + needed;
+    std::atomic<bool> connected{false};
+    const auto dial = [this, &zone, use_white_list, &connected]() {
+      try
+      {
+        if (make_new_connection_from_peerlist(zone, use_white_list))
+          connected = true;
+      }
+      catch (const std::exception& e)
+      {
+        MERROR("Exception in parallel dialer: " << e.what());
+      }
+    };
+
+    std::vector<boost::thread> threads;
+    threads.reserve(dialers - 1);
+    for (size_t i = 1; i < dialers; ++i)
+    {
+      threads.emplace_back([this, &zone, &dial, target, i]() {
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(P2P_CONNECT_STAGGER_MS * i));
+        if (!zone.m_net_server.is_stop_signal_sent() && get_outgoing_connections_count(zone) < target)
+          dial();
+      });
+    }
+    dial();
+    for (auto& thread : threads)
+      thread.join();
+    return connected;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::connect_to_seed(epee::net_utils::zone zone)
   {
       network_zone& server = m_network_zones.at(zone);
@@ -1886,11 +2010,11 @@ namespace nodetool
         return false;
       }
 
-      if (peer_type == white && !make_new_connection_from_peerlist(zone, true)) {
+      if (peer_type == white && !make_new_connections_from_peerlist(zone, true, expected_connections - conn_count)) {
         return false;
       }
 
-      if (peer_type == gray && !make_new_connection_from_peerlist(zone, false)) {
+      if (peer_type == gray && !make_new_connections_from_peerlist(zone, false, expected_connections - conn_count)) {
         return false;
       }
     }
@@ -2289,6 +2413,30 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::on_tx_sketch_request(const epee::net_utils::connection_context_base& context, const uint64_t salt, const uint64_t set_size)
+  {
+    const auto zone = m_network_zones.find(context.m_remote_address.get_zone());
+    if (zone != m_network_zones.end())
+      zone->second.m_notifier.on_tx_sketch_request(context.m_connection_id, salt, set_size);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::on_tx_sketch(const epee::net_utils::connection_context_base& context, std::string sketch)
+  {
+    const auto zone = m_network_zones.find(context.m_remote_address.get_zone());
+    if (zone != m_network_zones.end())
+      zone->second.m_notifier.on_tx_sketch(context.m_connection_id, std::move(sketch));
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::on_tx_reconciliation_diff(const epee::net_utils::connection_context_base& context, const bool success, std::string short_tx_ids)
+  {
+    const auto zone = m_network_zones.find(context.m_remote_address.get_zone());
+    if (zone != m_network_zones.end())
+      zone->second.m_notifier.on_tx_reconciliation_diff(context.m_connection_id, success, std::move(short_tx_ids));
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::callback(p2p_connection_context& context)
   {
     m_payload_handler.on_callback(context);
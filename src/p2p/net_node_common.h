@@ -53,6 +53,9 @@ namespace nodetool
   {
     virtual bool relay_notify_to_list(int command, epee::levin::message_writer message, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections)=0;
     virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, cryptonote::relay_method tx_relay)=0;
+    virtual void on_tx_sketch_request(const epee::net_utils::connection_context_base& context, uint64_t salt, uint64_t set_size)=0;
+    virtual void on_tx_sketch(const epee::net_utils::connection_context_base& context, std::string sketch)=0;
+    virtual void on_tx_reconciliation_diff(const epee::net_utils::connection_context_base& context, bool success, std::string short_tx_ids)=0;
     virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context)=0;
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context)=0;
     virtual void request_callback(const epee::net_utils::connection_context_base& context)=0;
@@ -80,6 +83,15 @@ namespace nodetool
     {
       return epee::net_utils::zone::invalid;
     }
+    virtual void on_tx_sketch_request(const epee::net_utils::connection_context_base& context, uint64_t salt, uint64_t set_size)
+    {
+    }
+    virtual void on_tx_sketch(const epee::net_utils::connection_context_base& context, std::string sketch)
+    {
+    }
+    virtual void on_tx_reconciliation_diff(const epee::net_utils::connection_context_base& context, bool success, std::string short_tx_ids)
+    {
+    }
     virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context)
     {
       return true;
@@ -240,12 +240,30 @@ namespace nodetool
 
   bool peerlist_storage::store(const std::string& path, const peerlist_types& other) const
   {
-    std::ofstream dest_file{};
-    dest_file.open( path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
-    if(dest_file.fail())
-      return false;
+    // write next to the old file and swap it in, so a failed or interrupted
+    // save leaves the previous state intact
+    const std::string tmp_path = path + ".tmp";
+    {
+      std::ofstream dest_file{};
+      dest_file.open( tmp_path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
+      if(dest_file.fail())
+        return false;
+
+      if (!store(dest_file, other))
+        return false;
+      dest_file.close();
+      if (dest_file.fail())
+        return false;
+    }
 
-    return store(dest_file, other);
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp_path, path, ec);
+    if (ec)
+    {
+      MWARNING("Failed to rename " << tmp_path << " to " << path << ": " << ec.message());
+      return false;
+    }
+    return true;
   }
 
   peerlist_types peerlist_storage::take_zone(epee::net_utils::zone zone)
@@ -268,6 +286,7 @@ namespace nodetool
     add_peers(m_peers_gray.get<by_addr>(), std::move(peers.gray));
     add_peers(m_peers_anchor.get<by_addr>(), std::move(peers.anchor));
     m_allow_local_ip = allow_local_ip;
+    mark_changed();
     return true;
   }
 
@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <iosfwd>
 #include <iterator>
 #include <list>
@@ -100,8 +101,10 @@ namespace nodetool
   {
   public: 
     bool init(peerlist_types&& peers, bool allow_local_ip);
-    size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
-    size_t get_gray_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_gray.size();}
+    size_t get_white_peers_count() const noexcept { return m_white_count.load(std::memory_order_relaxed); }
+    size_t get_gray_peers_count() const noexcept { return m_gray_count.load(std::memory_order_relaxed); }
+    //! \return Counter bumped on every change of the white, gray or anchor lists
+    uint64_t get_version() const noexcept { return m_version.load(std::memory_order_acquire); }
     bool merge_peerlist(const std::vector<peerlist_entry>& outer_bs, const std::function<bool(const peerlist_entry&)> &f = NULL);
     bool get_peerlist_head(std::vector<peerlist_entry>& bs_head, bool anonymize, uint32_t depth = P2P_DEFAULT_PEERS_IN_HANDSHAKE);
     void get_peerlist(std::vector<peerlist_entry>& pl_gray, std::vector<peerlist_entry>& pl_white);
@@ -185,6 +188,7 @@ namespace nodetool
     void trim_white_peerlist();
     void trim_gray_peerlist();
     static peerlist_entry get_nth_latest_peer(peers_indexed& peerlist, size_t n);
+    void mark_changed() noexcept;
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
@@ -195,6 +199,11 @@ namespace nodetool
     peers_indexed m_peers_gray;
     peers_indexed m_peers_white;
     anchor_peers_indexed m_peers_anchor;
+
+    // updated under m_peerlist_lock, read without it
+    std::atomic<size_t> m_white_count{0};
+    std::atomic<size_t> m_gray_count{0};
+    std::atomic<uint64_t> m_version{0};
   };
   //--------------------------------------------------------------------------------------------------
   inline void peerlist_manager::trim_gray_peerlist()
@@ -215,6 +224,14 @@ namespace nodetool
     }
   }
   //--------------------------------------------------------------------------------------------------
+  inline void peerlist_manager::mark_changed() noexcept
+  {
+    // Is not thread-safe. Call with m_peerlist_lock held, after the change.
+    m_white_count.store(m_peers_white.size(), std::memory_order_relaxed);
+    m_gray_count.store(m_peers_gray.size(), std::memory_order_relaxed);
+    m_version.fetch_add(1, std::memory_order_release);
+  }
+  //--------------------------------------------------------------------------------------------------
   inline
   peerlist_entry peerlist_manager::get_nth_latest_peer(peers_indexed& peerlist, const size_t n)
   {
@@ -236,6 +253,7 @@ namespace nodetool
     }
     // delete extra elements
     trim_gray_peerlist();    
+    mark_changed();
     return true;
   }
   //--------------------------------------------------------------------------------------------------
@@ -377,6 +395,7 @@ namespace nodetool
     {
       m_peers_gray.erase(by_addr_it_gr);
     }
+    mark_changed();
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_white()", false);
   }
@@ -412,6 +431,7 @@ namespace nodetool
       new_ple.last_seen = by_addr_it_gr->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
       m_peers_gray.replace(by_addr_it_gr, new_ple);
     }
+    mark_changed();
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
   }
@@ -427,6 +447,7 @@ namespace nodetool
 
     if(by_addr_it_anchor == m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.insert(ple);
+      mark_changed();
     }
 
     return true;
@@ -464,6 +485,7 @@ namespace nodetool
 
     if (iterator != m_peers_white.get<by_addr>().end()) {
       m_peers_white.erase(iterator);
+      mark_changed();
     }
 
     return true;
@@ -482,6 +504,7 @@ namespace nodetool
 
     if (iterator != m_peers_gray.get<by_addr>().end()) {
       m_peers_gray.erase(iterator);
+      mark_changed();
     }
 
     return true;
@@ -503,7 +526,11 @@ namespace nodetool
       apl.push_back(a);
     });
 
-    m_peers_anchor.get<by_time>().clear();
+    if (!m_peers_anchor.empty())
+    {
+      m_peers_anchor.get<by_time>().clear();
+      mark_changed();
+    }
 
     return true;
 
@@ -521,6 +548,7 @@ namespace nodetool
 
     if (iterator != m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.erase(iterator);
+      mark_changed();
     }
 
     return true;
@@ -545,6 +573,8 @@ namespace nodetool
       else
         ++i;
     }
+    if (filtered)
+      mark_changed();
     CATCH_ENTRY_L0("peerlist_manager::filter()", filtered);
     return filtered;
   }
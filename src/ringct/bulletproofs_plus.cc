@@ -69,6 +69,7 @@ namespace rct
 
     // Cached public generators
     static ge_p3 Hi_p3[maxN*maxM], Gi_p3[maxN*maxM];
+    static ge_p3 G_p3, H_p3;
     static std::shared_ptr<straus_cached_data> straus_HiGi_cache;
     static std::shared_ptr<pippenger_cached_data> pippenger_HiGi_cache;
 
@@ -106,14 +107,12 @@ namespace rct
     }
 
     // Use hashed values to produce indexed public generators
+    // The caller checks they are not the point at infinity
     static ge_p3 get_exponent(const rct::key &base, size_t idx)
     {
         std::string hashed = std::string((const char*)base.bytes, sizeof(base)) + config::HASH_KEY_BULLETPROOF_PLUS_EXPONENT + tools::get_varint_data(idx);
-        rct::key generator;
         ge_p3 generator_p3;
         rct::hash_to_p3(generator_p3, rct::hash2rct(crypto::cn_fast_hash(hashed.data(), hashed.size())));
-        ge_p3_tobytes(generator.bytes, &generator_p3);
-        CHECK_AND_ASSERT_THROW_MES(!(generator == rct::identity()), "Exponent is point at infinity");
         return generator_p3;
     }
 
@@ -138,6 +137,18 @@ namespace rct
             data.push_back({rct::zero(), Hi_p3[i]});
         }
 
+        // Encoding all generators at once shares a single field inversion
+        rct::keyV generators(maxN*maxM);
+        ge_p3_batch_tobytes(generators[0].bytes, Hi_p3, maxN*maxM);
+        for (const rct::key &generator: generators)
+            CHECK_AND_ASSERT_THROW_MES(!(generator == rct::identity()), "Exponent is point at infinity");
+        ge_p3_batch_tobytes(generators[0].bytes, Gi_p3, maxN*maxM);
+        for (const rct::key &generator: generators)
+            CHECK_AND_ASSERT_THROW_MES(!(generator == rct::identity()), "Exponent is point at infinity");
+
+        CHECK_AND_ASSERT_THROW_MES(ge_frombytes_vartime(&G_p3, rct::G.bytes) == 0, "ge_frombytes_vartime failed");
+        CHECK_AND_ASSERT_THROW_MES(ge_frombytes_vartime(&H_p3, rct::H.bytes) == 0, "ge_frombytes_vartime failed");
+
         straus_HiGi_cache = straus_init_cache(data, STRAUS_SIZE_LIMIT);
         pippenger_HiGi_cache = pippenger_init_cache(data, 0, PIPPENGER_SIZE_LIMIT);
 
@@ -203,13 +214,9 @@ namespace rct
         }
 
         sc_mul(multiexp_data[2*size].scalar.bytes, c.bytes, INV_EIGHT.bytes);
-        ge_p3 H_p3;
-        ge_frombytes_vartime(&H_p3, rct::H.bytes);
         multiexp_data[2*size].point = H_p3;
 
         sc_mul(multiexp_data[2*size+1].scalar.bytes, d.bytes, INV_EIGHT.bytes);
-        ge_p3 G_p3;
-        ge_frombytes_vartime(&G_p3, rct::G.bytes);
         multiexp_data[2*size+1].point = G_p3;
 
         return multiexp(multiexp_data, 0);
@@ -730,8 +737,6 @@ try_again:
         A1_data[1].point = Hprime[0];
 
         sc_mul(A1_data[2].scalar.bytes, d_.bytes, INV_EIGHT.bytes);
-        ge_p3 G_p3;
-        ge_frombytes_vartime(&G_p3, rct::G.bytes);
         A1_data[2].point = G_p3;
 
         sc_mul(temp.bytes, r.bytes, y.bytes);
@@ -740,8 +745,6 @@ try_again:
         sc_mul(temp2.bytes, temp2.bytes, aprime[0].bytes);
         sc_add(temp.bytes, temp.bytes, temp2.bytes);
         sc_mul(A1_data[3].scalar.bytes, temp.bytes, INV_EIGHT.bytes);
-        ge_p3 H_p3;
-        ge_frombytes_vartime(&H_p3, rct::H.bytes);
         A1_data[3].point = H_p3;
 
         rct::key A1 = multiexp(A1_data, 0);
@@ -1087,8 +1090,8 @@ try_again:
         }
 
         // Verify all proofs in the weighted batch
-        multiexp_data.emplace_back(G_scalar, rct::G);
-        multiexp_data.emplace_back(H_scalar, rct::H);
+        multiexp_data.emplace_back(G_scalar, G_p3);
+        multiexp_data.emplace_back(H_scalar, H_p3);
         for (size_t i = 0; i < maxMN; ++i)
         {
             multiexp_data[i * 2] = {Gi_scalars[i], Gi_p3[i]};
@@ -36,6 +36,7 @@ extern "C"
 #include "crypto/crypto-ops.h"
 }
 #include "common/aligned.h"
+#include "common/threadpool.h"
 #include "rctOps.h"
 #include "multiexp.h"
 
@@ -46,6 +47,7 @@ extern "C"
 #define MULTIEXP_PERF(x)
 
 #define RAW_MEMORY_BLOCK
+#define PIPPENGER_PARALLEL_MIN_POINTS 1024
 //#define ALTERNATE_LAYOUT
 //#define TRACK_STRAUS_ZERO_IDENTITY
 
@@ -603,7 +605,67 @@ size_t pippenger_get_cache_size(const std::shared_ptr<pippenger_cached_data> &ca
   return cache->size * sizeof(*cache->cached);
 }
 
-rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<pippenger_cached_data> &cache, size_t cache_size, size_t c)
+// sums the buckets of one c bit window of the scalars into sum, returns false if the window is empty
+static bool pippenger_window(const std::vector<MultiexpData> &data, const pippenger_cached_data &cache, const pippenger_cached_data *cache_2, size_t cache_size, size_t c, size_t k, ge_p3 *buckets, ge_p3 &sum)
+{
+  bool buckets_init[1<<9];
+  memset(buckets_init, 0, 1u<<c);
+
+  // partition scalars into buckets
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    unsigned int bucket = 0;
+    for (size_t j = 0; j < c; ++j)
+      if (test(data[i].scalar, k*c+j))
+        bucket |= 1<<j;
+    if (bucket == 0)
+      continue;
+    CHECK_AND_ASSERT_THROW_MES(bucket < (1u<<c), "bucket overflow");
+    if (buckets_init[bucket])
+    {
+      if (i < cache_size)
+        add(buckets[bucket], cache.cached[i]);
+      else
+        add(buckets[bucket], cache_2->cached[i - cache_size]);
+    }
+    else
+    {
+      buckets[bucket] = data[i].point;
+      buckets_init[bucket] = true;
+    }
+  }
+
+  // sum the buckets
+  ge_p3 pail;
+  bool pail_init = false;
+  bool sum_init = false;
+  for (size_t i = (1<<c)-1; i > 0; --i)
+  {
+    if (buckets_init[i])
+    {
+      if (pail_init)
+        add(pail, buckets[i]);
+      else
+      {
+        pail = buckets[i];
+        pail_init = true;
+      }
+    }
+    if (pail_init)
+    {
+      if (sum_init)
+        add(sum, pail);
+      else
+      {
+        sum = pail;
+        sum_init = true;
+      }
+    }
+  }
+  return sum_init;
+}
+
+rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<pippenger_cached_data> &cache, size_t cache_size, size_t c, bool allow_parallel)
 {
   if (cache != NULL && cache_size == 0)
     cache_size = cache->size;
@@ -614,8 +676,6 @@ rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<
 
   ge_p3 result = ge_p3_identity;
   bool result_init = false;
-  std::unique_ptr<ge_p3[]> buckets{new ge_p3[1<<c]};
-  bool buckets_init[1<<9];
   std::shared_ptr<pippenger_cached_data> local_cache = cache == NULL ? pippenger_init_cache(data) : cache;
   std::shared_ptr<pippenger_cached_data> local_cache_2 = data.size() > cache_size ? pippenger_init_cache(data, cache_size) : NULL;
 
@@ -630,6 +690,34 @@ rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<
     ++groups;
   groups = (groups + c - 1) / c;
 
+  // the windows are independent until they are combined, so large
+  // batches sum them on the threadpool, one window per job
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const bool parallel = allow_parallel && data.size() >= PIPPENGER_PARALLEL_MIN_POINTS && groups > 1 && tpool.get_max_concurrency() > 1;
+  std::vector<ge_p3> window_sums(parallel ? groups : 1);
+  std::unique_ptr<bool[]> window_init{new bool[parallel ? groups : 1]};
+  if (parallel)
+  {
+    tools::threadpool::waiter waiter(tpool);
+    std::vector<std::exception_ptr> exceptions(groups);
+    for (size_t k = 0; k < groups; ++k)
+    {
+      tpool.submit(&waiter, [&, k]() {
+        try
+        {
+          std::unique_ptr<ge_p3[]> buckets{new ge_p3[1<<c]};
+          window_init[k] = pippenger_window(data, *local_cache, local_cache_2.get(), cache_size, c, k, buckets.get(), window_sums[k]);
+        }
+        catch (...) { exceptions[k] = std::current_exception(); }
+      });
+    }
+    CHECK_AND_ASSERT_THROW_MES(waiter.wait(), "Pippenger window job failed");
+    for (const std::exception_ptr &e: exceptions)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
+  std::unique_ptr<ge_p3[]> buckets{parallel ? nullptr : new ge_p3[1<<c]};
   for (size_t k = groups; k-- > 0; )
   {
     if (result_init)
@@ -646,56 +734,18 @@ rct::key pippenger(const std::vector<MultiexpData> &data, const std::shared_ptr<
           ge_p1p1_to_p2(&p2, &p1);
       }
     }
-    memset(buckets_init, 0, 1u<<c);
 
-    // partition scalars into buckets
-    for (size_t i = 0; i < data.size(); ++i)
+    const size_t w = parallel ? k : 0;
+    if (!parallel)
+      window_init[0] = pippenger_window(data, *local_cache, local_cache_2.get(), cache_size, c, k, buckets.get(), window_sums[0]);
+    if (window_init[w])
     {
-      unsigned int bucket = 0;
-      for (size_t j = 0; j < c; ++j)
-        if (test(data[i].scalar, k*c+j))
-          bucket |= 1<<j;
-      if (bucket == 0)
-        continue;
-      CHECK_AND_ASSERT_THROW_MES(bucket < (1u<<c), "bucket overflow");
-      if (buckets_init[bucket])
-      {
-        if (i < cache_size)
-          add(buckets[bucket], local_cache->cached[i]);
-        else
-          add(buckets[bucket], local_cache_2->cached[i - cache_size]);
-      }
+      if (result_init)
+        add(result, window_sums[w]);
       else
       {
-        buckets[bucket] = data[i].point;
-        buckets_init[bucket] = true;
-      }
-    }
-
-    // sum the buckets
-    ge_p3 pail;
-    bool pail_init = false;
-    for (size_t i = (1<<c)-1; i > 0; --i)
-    {
-      if (buckets_init[i])
-      {
-        if (pail_init)
-          add(pail, buckets[i]);
-        else
-        {
-          pail = buckets[i];
-          pail_init = true;
-        }
-      }
-      if (pail_init)
-      {
-        if (result_init)
-          add(result, pail);
-        else
-        {
-          result = pail;
-          result_init = true;
-        }
+        result = window_sums[w];
+        result_init = true;
       }
     }
   }
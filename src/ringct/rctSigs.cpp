@@ -28,6 +28,8 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
+
 #include "misc_log_ex.h"
 #include "misc_language.h"
 #include "common/data_cache.h"
@@ -48,6 +50,8 @@ using namespace std;
 
 #define CHECK_AND_ASSERT_MES_L1(expr, ret, message) {if(!(expr)) {MCERROR("verify", message); return ret;}}
 
+#define CLSAG_MEMBER_PRECOMP_CACHE_SIZE 8192 // about 20 MB
+
 namespace
 {
     rct::Bulletproof make_dummy_bulletproof(const std::vector<uint64_t> &outamounts, rct::keyV &C, rct::keyV &masks)
@@ -206,19 +210,23 @@ namespace rct {
     }
     
     //see above.
+    //the 64 rows are independent, so each half is compressed with a single
+    //field inversion (ge_p2_batch_tobytes) instead of one per point
     bool verifyBorromean(const boroSig &bb, const ge_p3 P1[64], const ge_p3 P2[64]) {
-        key64 Lv1; key chash, LL;
+        key64 LL, Lv1; key chash;
+        ge_p2 p2[64];
         int ii = 0;
-        ge_p2 p2;
         for (ii = 0 ; ii < 64 ; ii++) {
-            // equivalent of: addKeys2(LL, bb.s0[ii], bb.ee, P1[ii]);
-            ge_double_scalarmult_base_vartime(&p2, bb.ee.bytes, &P1[ii], bb.s0[ii].bytes);
-            ge_tobytes(LL.bytes, &p2);
-            chash = hash_to_scalar(LL);
+            // equivalent of: addKeys2(LL[ii], bb.s0[ii], bb.ee, P1[ii]);
+            ge_double_scalarmult_base_vartime(&p2[ii], bb.ee.bytes, &P1[ii], bb.s0[ii].bytes);
+        }
+        ge_p2_batch_tobytes(LL[0].bytes, p2, 64);
+        for (ii = 0 ; ii < 64 ; ii++) {
+            chash = hash_to_scalar(LL[ii]);
             // equivalent of: addKeys2(Lv1[ii], bb.s1[ii], chash, P2[ii]);
-            ge_double_scalarmult_base_vartime(&p2, chash.bytes, &P2[ii], bb.s1[ii].bytes);
-            ge_tobytes(Lv1[ii].bytes, &p2);
+            ge_double_scalarmult_base_vartime(&p2[ii], chash.bytes, &P2[ii], bb.s1[ii].bytes);
         }
+        ge_p2_batch_tobytes(Lv1[0].bytes, p2, 64);
         key eeComputed = hash_to_scalar(Lv1); //hash function fine
         return equalKeys(eeComputed, bb.ee);
     }
@@ -567,6 +575,16 @@ namespace rct {
       try
       {
         PERF_TIMER(verRange);
+        // 2^i H never changes, decompress it once rather than for every proof
+        static const std::array<ge_cached, 64> H2_cached = [] {
+          std::array<ge_cached, 64> out;
+          for (size_t i = 0; i < out.size(); ++i) {
+            ge_p3 p3;
+            CHECK_AND_ASSERT_THROW_MES(ge_frombytes_vartime(&p3, H2[i].bytes) == 0, "point conv failed");
+            ge_p3_to_cached(&out[i], &p3);
+          }
+          return out;
+        }();
         ge_p3 CiH[64], asCi[64];
         int i = 0;
         ge_p3 Ctmp_p3 = ge_p3_identity;
@@ -575,12 +593,9 @@ namespace rct {
             // subKeys(CiH[i], as.Ci[i], H2[i]);
             // addKeys(Ctmp, Ctmp, as.Ci[i]);
             ge_cached cached;
-            ge_p3 p3;
             ge_p1p1 p1;
-            CHECK_AND_ASSERT_MES_L1(ge_frombytes_vartime(&p3, H2[i].bytes) == 0, false, "point conv failed");
-            ge_p3_to_cached(&cached, &p3);
             CHECK_AND_ASSERT_MES_L1(ge_frombytes_vartime(&asCi[i], as.Ci[i].bytes) == 0, false, "point conv failed");
-            ge_sub(&p1, &asCi[i], &cached);
+            ge_sub(&p1, &asCi[i], &H2_cached[i]);
             ge_p3_to_cached(&cached, &asCi[i]);
             ge_p1p1_to_p3(&CiH[i], &p1);
             ge_add(&p1, &Ctmp_p3, &cached);
@@ -842,7 +857,7 @@ namespace rct {
     bool verRctMGSimple(const key &message, const mgSig &mg, const ctkeyV & pubs, const key & C) {
         try
         {
-            PERF_TIMER(verRctMGSimple);
+            PERF_TIMER_AGG(verRctMGSimple);
             //setup vars
             size_t rows = 1;
             size_t cols = pubs.size();
@@ -870,10 +885,25 @@ namespace rct {
         catch (...) { return false; }
     }
 
+    // The per ring member tables of a CLSAG verification depend only on the
+    // member's output key, and popular decoys show up in many rings, so they
+    // are kept across verifications (tx pool admission and block import alike)
+    struct clsag_member_precomp
+    {
+        geDsmp P; // P
+        geDsmp H; // 8*hash_to_p3(P)
+    };
+
+    static tools::sharded_lru_cache<key, clsag_member_precomp> &get_clsag_member_precomp_cache()
+    {
+        static tools::sharded_lru_cache<key, clsag_member_precomp> cache(CLSAG_MEMBER_PRECOMP_CACHE_SIZE);
+        return cache;
+    }
+
     bool verRctCLSAGSimple(const key &message, const clsag &sig, const ctkeyV & pubs, const key & C_offset) {
         try
         {
-            PERF_TIMER(verRctCLSAGSimple);
+            PERF_TIMER_AGG(verRctCLSAGSimple);
             const size_t n = pubs.size();
 
             // Check data
@@ -940,11 +970,10 @@ namespace rct {
             key c_new;
             key L;
             key R;
-            geDsmp P_precomp;
+            clsag_member_precomp member_precomp;
             geDsmp C_precomp;
             size_t i = 0;
             ge_p3 hash8_p3;
-            geDsmp hash_precomp;
             ge_p3 temp_p3;
             ge_p1p1 temp_p1;
 
@@ -954,7 +983,13 @@ namespace rct {
                 sc_mul(c_c.bytes,mu_C.bytes,c.bytes);
 
                 // Precompute points for L/R
-                precomp(P_precomp.k,pubs[i].dest);
+                if (!get_clsag_member_precomp_cache().get(pubs[i].dest, member_precomp))
+                {
+                    precomp(member_precomp.P.k,pubs[i].dest);
+                    hash_to_p3(hash8_p3,pubs[i].dest);
+                    ge_dsm_precomp(member_precomp.H.k, &hash8_p3);
+                    get_clsag_member_precomp_cache().add(pubs[i].dest, member_precomp);
+                }
 
                 CHECK_AND_ASSERT_MES(ge_frombytes_vartime(&temp_p3, pubs[i].mask.bytes) == 0, false, "point conv failed");
                 ge_sub(&temp_p1,&temp_p3,&C_offset_cached);
@@ -962,12 +997,10 @@ namespace rct {
                 ge_dsm_precomp(C_precomp.k,&temp_p3);
 
                 // Compute L
-                addKeys_aGbBcC(L,sig.s[i],c_p,P_precomp.k,c_c,C_precomp.k);
+                addKeys_aGbBcC(L,sig.s[i],c_p,member_precomp.P.k,c_c,C_precomp.k);
 
                 // Compute R
-                hash_to_p3(hash8_p3,pubs[i].dest);
-                ge_dsm_precomp(hash_precomp.k, &hash8_p3);
-                addKeys_aAbBcC(R,sig.s[i],hash_precomp.k,c_p,I_precomp.k,c_c,D_precomp.k);
+                addKeys_aAbBcC(R,sig.s[i],member_precomp.H.k,c_p,I_precomp.k,c_c,D_precomp.k);
 
                 c_to_hash[2*n+3] = L;
                 c_to_hash[2*n+4] = R;
@@ -1276,7 +1309,7 @@ namespace rct {
 
         key full_message = get_pre_mlsag_hash(rv,hwdev);
 
-        for (i = 0 ; i < inamounts.size(); i++)
+        const auto sign_input = [&](size_t i)
         {
             if (is_rct_clsag(rv.type))
             {
@@ -1289,6 +1322,31 @@ namespace rct {
             {
                 rv.p.MGs[i] = proveRctMGSimple(full_message, rv.mixRing[i], inSk[i], a[i], pseudoOuts[i], index[i], hwdev);
             }
+        };
+
+        // the signatures all commit to the same message and are otherwise
+        // independent; devices which keep signing state get them in order
+        if (inamounts.size() > 1 && hwdev.has_parallel_signing() && hwdev.get_mode() != hw::device::TRANSACTION_CREATE_FAKE)
+        {
+            tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+            tools::threadpool::waiter waiter(tpool);
+            std::vector<std::exception_ptr> exceptions(inamounts.size());
+            for (i = 0 ; i < inamounts.size(); i++)
+            {
+                tpool.submit(&waiter, [&, i] {
+                    try { sign_input(i); }
+                    catch (...) { exceptions[i] = std::current_exception(); }
+                });
+            }
+            waiter.wait();
+            for (const std::exception_ptr &e: exceptions)
+                if (e)
+                    std::rethrow_exception(e);
+        }
+        else
+        {
+            for (i = 0 ; i < inamounts.size(); i++)
+                sign_input(i);
         }
         return rv;
     }
@@ -1382,7 +1440,7 @@ namespace rct {
     bool verRctSemanticsSimple(const std::vector<const rctSig*> & rvv) {
       try
       {
-        PERF_TIMER(verRctSemanticsSimple);
+        PERF_TIMER_AGG(verRctSemanticsSimple);
 
         tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
         tools::threadpool::waiter waiter(tpool);
@@ -1519,49 +1577,64 @@ namespace rct {
 
     //ver RingCT simple
     //assumes only post-rct style inputs (at least for max anonymity)
-    bool verRctNonSemanticsSimple(const rctSig & rv) {
+    //all inputs of all the signatures are checked in a single threadpool pass
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv) {
       try
       {
-        PERF_TIMER(verRctNonSemanticsSimple);
-
-        CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
-            false, "verRctNonSemanticsSimple called on non simple rctSig");
-        const bool bulletproof = is_rct_bulletproof(rv.type);
-        const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
-        // semantics check is early, and mixRing/MGs aren't resolved yet
-        if (bulletproof || bulletproof_plus)
-          CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
-        else
-          CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-        const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
+        PERF_TIMER_AGG(verRctNonSemanticsSimple);
 
-        std::deque<bool> results(threads);
         tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
         tools::threadpool::waiter waiter(tpool);
 
-        const keyV &pseudoOuts = bulletproof || bulletproof_plus ? rv.p.pseudoOuts : rv.pseudoOuts;
+        size_t n_inputs = 0;
+        keyV messages(rvv.size());
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          const rctSig &rv = *rvv[n];
+          CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
+              false, "verRctNonSemanticsSimple called on non simple rctSig");
+          const bool bulletproof = is_rct_bulletproof(rv.type);
+          const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
+          // semantics check is early, and mixRing/MGs aren't resolved yet
+          if (bulletproof || bulletproof_plus)
+            CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
 
-        const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
+          messages[n] = get_pre_mlsag_hash(rv, hw::get_device("default"));
+          n_inputs += rv.mixRing.size();
+        }
 
-        results.clear();
-        results.resize(rv.mixRing.size());
-        for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
-          tpool.submit(&waiter, [&, i] {
-              if (is_rct_clsag(rv.type))
-                  results[i] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
-              else
-                  results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
-          });
+        std::deque<bool> results(n_inputs);
+        size_t offset = 0;
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          const rctSig &rv = *rvv[n];
+          const keyV &pseudoOuts = is_rct_bulletproof(rv.type) || is_rct_bulletproof_plus(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+          const key &message = messages[n];
+          for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
+            tpool.submit(&waiter, [&, i, offset] {
+                if (is_rct_clsag(rv.type))
+                    results[offset + i] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
+                else
+                    results[offset + i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+            });
+          }
+          offset += rv.mixRing.size();
         }
         if (!waiter.wait())
           return false;
 
-        for (size_t i = 0; i < results.size(); ++i) {
-          if (!results[i]) {
-            LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i);
-            return false;
+        offset = 0;
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          for (size_t i = 0; i < rvv[n]->mixRing.size(); ++i) {
+            if (!results[offset + i]) {
+              LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i << " of signature " << n);
+              return false;
+            }
           }
+          offset += rvv[n]->mixRing.size();
         }
 
         return true;
@@ -1579,40 +1652,91 @@ namespace rct {
       }
     }
 
-    bool verRctNonSemanticsSimpleCached(const rctSig & rv)
+    bool verRctNonSemanticsSimple(const rctSig & rv)
     {
-      // Hello future Monero dev! If you got this assert, read the following carefully:
-      //
-      // RCT cache assumes that this function will serialize and hash all rv's fields used for RingCT verification
-      // If you're about to add a new RCTType here, first you must check that binary_archive serialization writes all rv's fields to the binary blob
-      // If it's not the case, rewrite this function to serialize everything, even some "temporary" fields which are not serialized normally
-      CHECK_AND_ASSERT_MES_L1(rv.type <= RCTTypeBulletproofPlus, false, "Unknown RCT type. Make sure RCT cache works correctly with this type and then enable it in the code here.");
-
-      // Don't cache older (or newer) rctSig types
-      // This cache only makes sense when it caches data from mempool first,
-      // so only "current fork version-enabled" RCT types need to be cached
-      if (rv.type != RCTTypeBulletproofPlus)
-        return verRctNonSemanticsSimple(rv);
-
-      // Get the hash of rv
-      std::stringstream ss;
-      binary_archive<true> ar(ss);
+      return verRctNonSemanticsSimple(std::vector<const rctSig*>(1, &rv));
+    }
 
-      ::do_serialize(ar, const_cast<rctSig&>(rv));
+    // Shared by tx pool admission and block import: a tx verified when it
+    // entered the pool is not verified again when it is mined, as long as
+    // its ring resolves to the same outputs
+    static tools::sharded_data_cache<crypto::hash, 16384> &get_rct_ver_cache()
+    {
+      static tools::sharded_data_cache<crypto::hash, 16384> cache;
+      return cache;
+    }
 
-      crypto::hash h;
-      cryptonote::get_blob_hash(ss.str(), h);
+    void get_rct_ver_cache_stats(uint64_t &hits, uint64_t &misses)
+    {
+      const tools::sharded_data_cache<crypto::hash, 16384> &cache = get_rct_ver_cache();
+      hits = cache.get_hits();
+      misses = cache.get_misses();
+    }
 
-      static tools::data_cache<crypto::hash, 8192> cache;
+    bool verRctNonSemanticsSimpleCached(const std::vector<const rctSig*> & rvv)
+    {
+      std::vector<const rctSig*> uncached;
+      std::vector<crypto::hash> uncached_hashes;
+      uncached.reserve(rvv.size());
+      uncached_hashes.reserve(rvv.size());
+      for (const rctSig *rvp: rvv)
+      {
+        const rctSig &rv = *rvp;
+
+        // Hello future Monero dev! If you got this assert, read the following carefully:
+        //
+        // RCT cache assumes that this function will serialize and hash all rv's fields used for RingCT verification
+        // If you're about to add a new RCTType here, first you must check that binary_archive serialization writes all rv's fields to the binary blob
+        // If it's not the case, rewrite this function to serialize everything, even some "temporary" fields which are not serialized normally
+        CHECK_AND_ASSERT_MES_L1(rv.type <= RCTTypeBulletproofPlus, false, "Unknown RCT type. Make sure RCT cache works correctly with this type and then enable it in the code here.");
+
+        // Don't cache older (or newer) rctSig types
+        // This cache only makes sense when it caches data from mempool first,
+        // so only "current fork version-enabled" RCT types need to be cached
+        if (rv.type != RCTTypeBulletproofPlus)
+        {
+          uncached.push_back(&rv);
+          uncached_hashes.push_back(crypto::null_hash);
+          continue;
+        }
+
+        // Get the hash of rv, and of the ring members it was expanded with,
+        // since those are looked up in the db rather than serialized
+        std::stringstream ss;
+        binary_archive<true> ar(ss);
+
+        ::do_serialize(ar, const_cast<rctSig&>(rv));
+
+        for (const ctkeyV &ring: rv.mixRing)
+          for (const ctkey &member: ring)
+            ss.write((const char*)&member, sizeof(member));
+
+        crypto::hash h;
+        cryptonote::get_blob_hash(ss.str(), h);
+
+        if (get_rct_ver_cache().has(h))
+          continue;
 
-      if (cache.has(h))
+        uncached.push_back(&rv);
+        uncached_hashes.push_back(h);
+      }
+
+      if (uncached.empty())
         return true;
 
-      const bool res = verRctNonSemanticsSimple(rv);
-      if (res)
-        cache.add(h);
+      if (!verRctNonSemanticsSimple(uncached))
+        return false;
+
+      for (const crypto::hash &h: uncached_hashes)
+        if (h != crypto::null_hash)
+          get_rct_ver_cache().add(h);
 
-      return res;
+      return true;
+    }
+
+    bool verRctNonSemanticsSimpleCached(const rctSig & rv)
+    {
+      return verRctNonSemanticsSimpleCached(std::vector<const rctSig*>(1, &rv));
     }
 
     //RingCT protocol
@@ -395,6 +395,29 @@ namespace rct {
           VARINT_FIELD(txnFee)
         END_SERIALIZE()
     };
+
+    //! Serializes the first `n` keys of `v` as array elements with no size prefix
+    template<template <bool> class Archive, bool W>
+    inline bool serialize_key_array(Archive<W> &ar, keyV &v, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        FIELDS(v[i])
+        if (n - i > 1)
+          ar.delimit_array();
+      }
+      return true;
+    }
+
+    //! Binary archives store keys back to back, so the run is one copy
+    template<bool W>
+    inline bool serialize_key_array(binary_archive<W> &ar, keyV &v, size_t n)
+    {
+      if (n)
+        ar.serialize_blob(v.data(), n * sizeof(key));
+      return ar.good();
+    }
+
     struct rctSigPrunable {
         std::vector<rangeSig> rangeSigs;
         std::vector<Bulletproof> bulletproofs;
@@ -492,12 +515,8 @@ namespace rct {
               PREPARE_CUSTOM_VECTOR_SERIALIZATION(mixin + 1, CLSAGs[i].s);
               if (CLSAGs[i].s.size() != mixin + 1)
                 return false;
-              for (size_t j = 0; j <= mixin; ++j)
-              {
-                FIELDS(CLSAGs[i].s[j])
-                if (mixin + 1 - j > 1)
-                  ar.delimit_array();
-              }
+              if (!serialize_key_array(ar, CLSAGs[i].s, mixin + 1))
+                return false;
               ar.end_array();
 
               ar.tag("c1");
@@ -3,6 +3,7 @@
 #include <stdexcept>
 
 #include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_core.h"
@@ -15,6 +16,13 @@
 namespace cryptonote
 {
 
+namespace
+{
+  //! Candidates probed in parallel when picking a new public node
+  constexpr const size_t probe_count = 3;
+  constexpr const std::chrono::seconds probe_timeout{5};
+}
+
   bootstrap_daemon::bootstrap_daemon(
     std::function<std::map<std::string, bool>()> get_public_nodes,
     bool rpc_payment_enabled,
@@ -83,6 +91,23 @@ namespace cryptonote
     return success;
   }
 
+  bool bootstrap_daemon::handle_result(bool success, const std::string &status, std::chrono::steady_clock::time_point start)
+  {
+    const std::string current_address = address();
+    if (!handle_result(success, status))
+    {
+      return false;
+    }
+
+    if (m_selector && status != CORE_RPC_STATUS_PAYMENT_REQUIRED)
+    {
+      const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+      const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
+      m_selector->handle_latency(current_address, latency);
+    }
+    return true;
+  }
+
   void bootstrap_daemon::set_proxy(const std::string &address)
   {
     if (!address.empty() && !net::get_tcp_endpoint(address))
@@ -93,6 +118,7 @@ namespace cryptonote
     {
       throw std::runtime_error("failed to set proxy address");
     }
+    m_proxy = address;
   }
 
   bool bootstrap_daemon::set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials /* = boost::none */)
@@ -115,16 +141,90 @@ namespace cryptonote
       return true;
     }
 
-    boost::optional<bootstrap_node::node_info> node;
+    std::vector<bootstrap_node::node_info> nodes;
     {
       const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
-      node = m_selector->next_node();
+      nodes = m_selector->next_nodes(probe_count);
     }
-    if (node) {
-      return set_server(node->address, node->credentials);
+    if (nodes.empty())
+    {
+      return false;
+    }
+
+    size_t index = 0;
+    if (nodes.size() > 1)
+    {
+      const boost::optional<size_t> fastest = probe(nodes);
+      if (!fastest)
+      {
+        return false;
+      }
+      index = *fastest;
+    }
+
+    return set_server(nodes[index].address, nodes[index].credentials);
+  }
+
+  boost::optional<size_t> bootstrap_daemon::probe(const std::vector<bootstrap_node::node_info> &nodes)
+  {
+    struct probe_result
+    {
+      bool success;
+      std::chrono::milliseconds latency;
+    };
+    std::vector<probe_result> results(nodes.size(), probe_result{false, {}});
+
+    {
+      std::vector<boost::thread> probes;
+      probes.reserve(nodes.size());
+      for (size_t i = 0; i < nodes.size(); ++i)
+      {
+        probes.emplace_back([this, &nodes, &results, i] {
+          try
+          {
+            net::http::client client;
+            if (!client.set_proxy(m_proxy) || !client.set_server(nodes[i].address, nodes[i].credentials))
+            {
+              return;
+            }
+
+            cryptonote::COMMAND_RPC_GET_HEIGHT::request req;
+            cryptonote::COMMAND_RPC_GET_HEIGHT::response res;
+            const auto start = std::chrono::steady_clock::now();
+            results[i].success = epee::net_utils::invoke_http_json("/getheight", req, res, client, probe_timeout) &&
+              res.status == CORE_RPC_STATUS_OK;
+            results[i].latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+          }
+          catch (const std::exception &e)
+          {
+            MDEBUG("Probing bootstrap daemon " << nodes[i].address << " failed: " << e.what());
+          }
+        });
+      }
+      for (boost::thread &probe : probes)
+      {
+        probe.join();
+      }
     }
 
-    return false;
+    boost::optional<size_t> fastest;
+    const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+      if (!results[i].success)
+      {
+        m_selector->handle_result(nodes[i].address, false);
+        continue;
+      }
+
+      MDEBUG("Bootstrap daemon " << nodes[i].address << " answered in " << results[i].latency.count() << " ms");
+      m_selector->handle_latency(nodes[i].address, results[i].latency);
+      if (!fastest || results[i].latency < results[*fastest].latency)
+      {
+        fastest = i;
+      }
+    }
+    return fastest;
   }
 
 }
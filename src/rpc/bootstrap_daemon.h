@@ -1,8 +1,10 @@
 #pragma  once
 
+#include <chrono>
 #include <functional>
 #include <map>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <boost/thread/mutex.hpp>
@@ -32,6 +34,7 @@ namespace cryptonote
     std::string address() const noexcept;
     boost::optional<std::pair<uint64_t, uint64_t>> get_height();
     bool handle_result(bool success, const std::string &status);
+    bool handle_result(bool success, const std::string &status, std::chrono::steady_clock::time_point start);
 
     template <class t_request, class t_response>
     bool invoke_http_json(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct)
@@ -41,8 +44,9 @@ namespace cryptonote
         return false;
       }
 
+      const auto start = std::chrono::steady_clock::now();
       const bool result = epee::net_utils::invoke_http_json(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
+      return handle_result(result, result_struct.status, start);
     }
 
     template <class t_request, class t_response>
@@ -53,8 +57,9 @@ namespace cryptonote
         return false;
       }
 
+      const auto start = std::chrono::steady_clock::now();
       const bool result = epee::net_utils::invoke_http_bin(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
+      return handle_result(result, result_struct.status, start);
     }
 
     template <class t_request, class t_response>
@@ -65,13 +70,14 @@ namespace cryptonote
         return false;
       }
 
+      const auto start = std::chrono::steady_clock::now();
       const bool result = epee::net_utils::invoke_http_json_rpc(
         "/json_rpc",
         std::string(command_name.begin(), command_name.end()),
         out_struct,
         result_struct,
         m_http_client);
-      return handle_result(result, result_struct.status);
+      return handle_result(result, result_struct.status, start);
     }
 
     void set_proxy(const std::string &address);
@@ -79,9 +85,11 @@ namespace cryptonote
   private:
     bool set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials = boost::none);
     bool switch_server_if_needed();
+    boost::optional<size_t> probe(const std::vector<bootstrap_node::node_info> &nodes);
 
   private:
     net::http::client m_http_client;
+    std::string m_proxy;
     const bool m_rpc_payment_enabled;
     const std::unique_ptr<bootstrap_node::selector> m_selector;
     boost::mutex m_selector_mutex;
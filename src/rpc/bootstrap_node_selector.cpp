@@ -29,6 +29,8 @@
 
 #include "bootstrap_node_selector.h"
 
+#include <algorithm>
+
 #include "crypto/crypto.h"
 
 namespace cryptonote
@@ -48,6 +50,16 @@ namespace bootstrap_node
     }
   }
 
+  void selector_auto::node::handle_latency(std::chrono::milliseconds sample)
+  {
+    // weight 1/4, a node turning slow is noticed within a few requests
+    sample = std::max(sample, std::chrono::milliseconds{1});
+    if (latency.count() == 0)
+      latency = sample;
+    else
+      latency = (latency * 3 + sample) / 4;
+  }
+
   void selector_auto::handle_result(const std::string &address, bool success)
   {
     auto &nodes_by_address = m_nodes.get<by_address>();
@@ -60,23 +72,73 @@ namespace bootstrap_node
     }
   }
 
+  void selector_auto::handle_latency(const std::string &address, std::chrono::milliseconds latency)
+  {
+    auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    if (it != nodes_by_address.end())
+    {
+      nodes_by_address.modify(it, [latency](node &entry) {
+        entry.handle_latency(latency);
+      });
+    }
+  }
+
+  std::chrono::milliseconds selector_auto::latency(const std::string &address) const
+  {
+    const auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    return it == nodes_by_address.end() ? std::chrono::milliseconds{} : it->latency;
+  }
+
   boost::optional<node_info> selector_auto::next_node()
+  {
+    std::vector<node_info> nodes = next_nodes(1);
+    if (nodes.empty())
+    {
+      return {};
+    }
+    return {std::move(nodes.front())};
+  }
+
+  std::vector<node_info> selector_auto::next_nodes(size_t count)
   {
     if (!has_at_least_one_good_node())
     {
       append_new_nodes();
     }
 
-    if (m_nodes.empty())
+    std::vector<node_info> out;
+    if (m_nodes.empty() || !count)
     {
-      return {};
+      return out;
     }
 
-    auto node = m_nodes.get<by_fails>().begin();
-    const size_t count = std::distance(node, m_nodes.get<by_fails>().upper_bound(node->fails));
-    std::advance(node, crypto::rand_idx(count));
+    /* Candidates come from the nodes with the fewest fails. Each pick is the
+       faster of two random ones, which favours fast nodes without always
+       hammering the single fastest. */
+    auto first = m_nodes.get<by_fails>().begin();
+    std::vector<const node *> tier;
+    for (auto it = first, end = m_nodes.get<by_fails>().upper_bound(first->fails); it != end; ++it)
+    {
+      tier.push_back(std::addressof(*it));
+    }
+
+    while (out.size() < count && !tier.empty())
+    {
+      size_t pick = crypto::rand_idx(tier.size());
+      const size_t other = crypto::rand_idx(tier.size());
+      if (tier[other]->faster_than(*tier[pick]))
+      {
+        pick = other;
+      }
+
+      out.push_back({tier[pick]->address, {}});
+      tier[pick] = tier.back();
+      tier.pop_back();
+    }
 
-    return {{node->address, {}}};
+    return out;
   }
 
   bool selector_auto::has_at_least_one_good_node() const
@@ -93,7 +155,7 @@ namespace bootstrap_node
       const auto &address = node.first;
       const auto &white = node.second;
       const size_t initial_score = white ? 0 : 1;
-      updated |= m_nodes.get<by_address>().insert({address, initial_score}).second;
+      updated |= m_nodes.get<by_address>().insert({address, initial_score, std::chrono::milliseconds{}}).second;
     }
 
     if (updated)
@@ -29,11 +29,13 @@
 
 #pragma  once
 
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -59,6 +61,19 @@ namespace bootstrap_node
 
     virtual void handle_result(const std::string &address, bool success) = 0;
     virtual boost::optional<node_info> next_node() = 0;
+
+    //! Response time of a successful request to `address`
+    virtual void handle_latency(const std::string &address, std::chrono::milliseconds latency) {}
+
+    //! \return Up to `count` distinct nodes to probe, best first
+    virtual std::vector<node_info> next_nodes(size_t count)
+    {
+      std::vector<node_info> nodes;
+      boost::optional<node_info> node = next_node();
+      if (node && count)
+        nodes.push_back(std::move(*node));
+      return nodes;
+    }
   };
 
   class selector_auto : public selector
@@ -71,6 +86,11 @@ namespace bootstrap_node
 
     void handle_result(const std::string &address, bool success) final;
     boost::optional<node_info> next_node() final;
+    void handle_latency(const std::string &address, std::chrono::milliseconds latency) final;
+    std::vector<node_info> next_nodes(size_t count) final;
+
+    //! \return Smoothed response time of `address`, zero if never measured
+    std::chrono::milliseconds latency(const std::string &address) const;
 
   private:
     bool has_at_least_one_good_node() const;
@@ -82,8 +102,13 @@ namespace bootstrap_node
     {
       std::string address;
       size_t fails;
+      std::chrono::milliseconds latency; //!< EWMA of response times, zero if never measured
 
       void handle_result(bool success);
+      void handle_latency(std::chrono::milliseconds sample);
+
+      //! Unmeasured nodes sort first, so every node gets tried
+      bool faster_than(const node &other) const noexcept { return latency < other.latency; }
     };
 
     struct by_address {};
@@ -31,8 +31,10 @@
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/uuid/nil_generator.hpp>
 #include <boost/filesystem.hpp>
+#include <unordered_set>
 #include "include_base_utils.h"
 #include "string_tools.h"
+#include "wipeable_string.h"
 using namespace epee;
 
 #include "core_rpc_server.h"
@@ -41,12 +43,17 @@ using namespace epee;
 #include "common/download.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "common/metrics.h"
+#include "common/memory_usage.h"
+#include "common/threadpool.h"
 #include "int-util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/merge_mining.h"
+#include "cryptonote_core/gamma_picker.h"
 #include "cryptonote_core/tx_sanity_check.h"
+#include "ringct/rctSigs.h"
 #include "misc_language.h"
 #include "net/local_ip.h"
 #include "net/parse.h"
@@ -65,6 +72,13 @@ using namespace epee;
 
 #define MAX_RESTRICTED_FAKE_OUTS_COUNT 40
 #define MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT 5000
+#define MAX_DECOYS_PER_REQUEST_ENTRY 5000
+
+#define RPC_CHEAP_IO_THREADS 2 // always left for cheap requests, whatever the expensive ones do
+#define DEFAULT_MAX_EXPENSIVE_REQUESTS 1
+#define DEFAULT_MAX_QUEUED_EXPENSIVE_REQUESTS 2
+#define EXPENSIVE_REQUEST_MAX_WAIT 5000 // ms
+#define DEFAULT_FREE_CREDITS_BURST_SECONDS 60
 
 #define OUTPUT_HISTOGRAM_RECENT_CUTOFF_RESTRICTION (3 * 86400) // 3 days max, the wallet requests 1.8 days
 
@@ -74,11 +88,21 @@ using namespace epee;
 #define RESTRICTED_BLOCK_HEADER_RANGE 1000
 #define RESTRICTED_TRANSACTIONS_COUNT 100
 #define RESTRICTED_SPENT_KEY_IMAGES_COUNT 5000
+#define RESTRICTED_OUTPUT_PUBKEYS_COUNT 5000
 #define RESTRICTED_BLOCK_COUNT 1000
 
+#define FEE_QUANTILES_MAX_BLOCKS 100
+#define FEE_QUANTILES_MAX_PERCENTILES 101
+
+#define GET_INFO_CACHE_MAX_AGE 1 // seconds, for the connection counts and the like it reports
+
+#define SCAN_OUTPUTS_MAX_BLOCKS 1000
+#define SCAN_OUTPUTS_MAX_SPEND_KEYS 100000
+
 #define RPC_TRACKER(rpc) \
   PERF_TIMER(rpc); \
-  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc))
+  static tools::metrics::histogram rpc_metric_##rpc("monero_rpc_duration_microseconds", "RPC handler time", "rpc=\"" #rpc "\""); \
+  RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc), &rpc_metric_##rpc)
 
 namespace
 {
@@ -92,9 +116,11 @@ namespace
       uint64_t credits;
     };
 
-    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer): rpc(rpc), timer(timer) {
+    RPCTracker(const char *rpc, tools::LoggingPerformanceTimer &timer, tools::metrics::histogram *metric = nullptr): rpc(rpc), timer(timer), metric(metric) {
     }
     ~RPCTracker() {
+      if (metric)
+        metric->observe(timer.value() / 1000);
       try
       {
         boost::unique_lock<boost::mutex> lock(mutex);
@@ -115,12 +141,51 @@ namespace
   private:
     std::string rpc;
     tools::LoggingPerformanceTimer &timer;
+    tools::metrics::histogram *metric;
     static boost::mutex mutex;
     static std::unordered_map<std::string, entry_t> tracker;
   };
   boost::mutex RPCTracker::mutex;
   std::unordered_map<std::string, RPCTracker::entry_t> RPCTracker::tracker;
 
+  // sampled when /metrics is requested, the rest are updated where they happen
+  tools::metrics::gauge height_metric("monero_height", "Main chain height");
+  tools::metrics::gauge txpool_size_metric("monero_txpool_transactions", "Transactions in the pool, excluding the ones not yet public");
+  tools::metrics::gauge connections_in_metric("monero_p2p_connections", "Public P2P connections", "direction=\"in\"", true);
+  tools::metrics::gauge connections_out_metric("monero_p2p_connections", "Public P2P connections", "direction=\"out\"", true);
+  tools::metrics::counter p2p_bytes_in_metric("monero_p2p_bytes_total", "P2P traffic", "direction=\"in\"", true);
+  tools::metrics::counter p2p_bytes_out_metric("monero_p2p_bytes_total", "P2P traffic", "direction=\"out\"", true);
+  tools::metrics::counter p2p_packets_in_metric("monero_p2p_packets_total", "P2P packets", "direction=\"in\"", true);
+  tools::metrics::counter p2p_packets_out_metric("monero_p2p_packets_total", "P2P packets", "direction=\"out\"", true);
+  tools::metrics::counter miner_hashes_metric("monero_miner_hashes_total", "Hashes computed by the built in miner", {}, true);
+  tools::metrics::gauge miner_hashrate_metric("monero_miner_hashrate", "Built in miner hash rate over the last couple of seconds, in H/s", {}, true);
+
+  struct threadpool_metrics
+  {
+    threadpool_metrics(const std::string &pool):
+      queued("monero_threadpool_queued_tasks", "Tasks waiting in a thread pool", pool),
+      submitted("monero_threadpool_tasks_total", "Tasks given to a thread pool, by where they ran", pool + ",where=\"queued\""),
+      inlined("monero_threadpool_tasks_total", "Tasks given to a thread pool, by where they ran", pool + ",where=\"inline\""),
+      steals("monero_threadpool_steals_total", "Queued tasks taken from another thread's queue", pool),
+      idle("monero_threadpool_idle_milliseconds_total", "Time thread pool workers spent waiting for work", pool)
+    {}
+
+    void update(const tools::threadpool &tpool)
+    {
+      const tools::threadpool::stats stats = tpool.get_stats();
+      queued.set(stats.queue_depth);
+      submitted.set(stats.submitted);
+      inlined.set(stats.inlined);
+      steals.set(stats.steals);
+      idle.set(stats.idle_ns / 1000000);
+    }
+
+    tools::metrics::gauge queued;
+    tools::metrics::counter submitted, inlined, steals, idle;
+  };
+  threadpool_metrics compute_threadpool_metrics("pool=\"compute\"");
+  threadpool_metrics io_threadpool_metrics("pool=\"io\"");
+
   void add_reason(std::string &reasons, const char *reason)
   {
     if (!reasons.empty())
@@ -163,6 +228,12 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_payment_difficulty);
     command_line::add_arg(desc, arg_rpc_payment_credits);
     command_line::add_arg(desc, arg_rpc_payment_allow_free_loopback);
+    command_line::add_arg(desc, arg_rpc_max_expensive_requests);
+    command_line::add_arg(desc, arg_rpc_max_queued_expensive_requests);
+    command_line::add_arg(desc, arg_rpc_free_credits_per_second);
+    command_line::add_arg(desc, arg_rpc_free_credits_burst);
+    command_line::add_arg(desc, arg_rpc_record_file);
+    command_line::add_arg(desc, arg_rpc_record_sample_rate);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -174,6 +245,15 @@ namespace cryptonote
     , m_was_bootstrap_ever_used(false)
     , disable_rpc_ban(false)
     , m_rpc_payment_allow_free_loopback(false)
+    , m_expensive_gate(DEFAULT_MAX_EXPENSIVE_REQUESTS, DEFAULT_MAX_QUEUED_EXPENSIVE_REQUESTS, std::chrono::milliseconds(EXPENSIVE_REQUEST_MAX_WAIT))
+    , m_io_threads_count(RPC_CHEAP_IO_THREADS + DEFAULT_MAX_EXPENSIVE_REQUESTS + DEFAULT_MAX_QUEUED_EXPENSIVE_REQUESTS)
+    , m_response_cache_chain(std::make_shared<std::atomic<uint64_t>>(0))
+    , m_get_info_cache("get_info", std::chrono::seconds(GET_INFO_CACHE_MAX_AGE))
+    , m_fee_estimate_cache("get_fee_estimate")
+    , m_last_block_header_cache("get_last_block_header")
+    , m_block_headers_range_cache("get_block_headers_range")
+    , m_output_distribution_cache("get_output_distribution")
+    , m_output_distribution_bin_cache("get_output_distribution.bin")
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::set_bootstrap_daemon(
@@ -290,6 +370,17 @@ namespace cryptonote
       }
     }
     disable_rpc_ban = rpc_config->disable_rpc_ban;
+
+    const uint64_t max_expensive = command_line::get_arg(vm, arg_rpc_max_expensive_requests);
+    const uint64_t max_queued_expensive = command_line::get_arg(vm, arg_rpc_max_queued_expensive_requests);
+    if (max_expensive == 0)
+    {
+      MERROR("--" << arg_rpc_max_expensive_requests.name << " must be at least 1");
+      return false;
+    }
+    m_expensive_gate.set_limits(max_expensive, max_queued_expensive);
+    // the operator's own unrestricted RPC is never shed, so it keeps the plain io threads
+    m_io_threads_count = RPC_CHEAP_IO_THREADS + (restricted ? max_expensive + max_queued_expensive : 0);
     const std::string data_dir{command_line::get_arg(vm, cryptonote::arg_data_dir)};
     std::string address = command_line::get_arg(vm, arg_rpc_payment_address);
     if (!address.empty() && allow_rpc_payment)
@@ -329,6 +420,23 @@ namespace cryptonote
       bool ok = epee::string_tools::get_ip_int32_from_string(bind_ip, bind_ip_str);
       if (ok & !epee::net_utils::is_ip_loopback(bind_ip))
         MWARNING("The RPC server is accessible from the outside, but no RPC payment was setup. RPC access will be free for all.");
+
+      const uint64_t free_credits = command_line::get_arg(vm, arg_rpc_free_credits_per_second);
+      uint64_t free_burst = command_line::get_arg(vm, arg_rpc_free_credits_burst);
+      if (free_burst == 0)
+        free_burst = free_credits * DEFAULT_FREE_CREDITS_BURST_SECONDS;
+      m_free_quota.set_limits(free_credits, free_burst);
+      if (free_credits)
+        MINFO("Free RPC quota: " << free_credits << " credits per second per client, burst " << free_burst);
+    }
+
+    const std::string record_file = command_line::get_arg(vm, arg_rpc_record_file);
+    if (!record_file.empty())
+    {
+      // each RPC server gets its own file, restricted and unrestricted traffic differ
+      const std::string path = record_file + "." + port;
+      if (!m_request_recorder.open(path, command_line::get_arg(vm, arg_rpc_record_sample_rate)))
+        return false;
     }
 
     if (!set_bootstrap_daemon(
@@ -347,6 +455,11 @@ namespace cryptonote
 
     if (m_rpc_payment)
       m_net_server.add_idle_handler([this](){ return m_rpc_payment->on_idle(); }, 60 * 1000);
+    else if (m_free_quota.enabled())
+      m_net_server.add_idle_handler([this](){ m_free_quota.prune(); return true; }, 60 * 1000);
+
+    std::shared_ptr<std::atomic<uint64_t>> chain = m_response_cache_chain;
+    m_core.get_blockchain_storage().add_block_notify([chain](uint64_t, epee::span<const block>) { ++*chain; });
 
     bool store_ssl_key = !restricted && rpc_config->ssl_options && rpc_config->ssl_options.auth.certificate_path.empty();
     const auto ssl_base_path = (boost::filesystem::path{data_dir} / "rpc_ssl").string();
@@ -422,10 +535,47 @@ namespace cryptonote
     }
     return true;
   }
-#define CHECK_PAYMENT_BASE(req, res, payment, same_ts) do { if (!ctx) break; uint64_t P = (uint64_t)payment; if (P > 0 && !check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::check_free_quota(const connection_context *ctx, uint64_t cost, const std::string &rpc, std::string &message)
+  {
+    if (!ctx || m_rpc_payment || !m_free_quota.enabled() || ctx->m_remote_address.is_loopback())
+      return true;
+
+    // one bucket per /24 or /64, so a client can't get a fresh quota by hopping addresses
+    std::string client;
+    const epee::net_utils::network_address &address = ctx->m_remote_address;
+    switch (address.get_type_id())
+    {
+      case epee::net_utils::address_type::ipv4:
+        client = epee::net_utils::ipv4_network_subnet(address.as<epee::net_utils::ipv4_network_address>().ip(), 24).str();
+        break;
+      case epee::net_utils::address_type::ipv6:
+      {
+        boost::asio::ip::address_v6::bytes_type bytes = address.as<epee::net_utils::ipv6_network_address>().ip().to_bytes();
+        std::fill(bytes.begin() + 8, bytes.end(), 0);
+        client = boost::asio::ip::address_v6(bytes).to_string() + "/64";
+        break;
+      }
+      default:
+        client = address.host_str();
+        break;
+    }
+
+    if (m_free_quota.charge(client, cost))
+      return true;
+    MDEBUG("Shedding " << rpc << " from " << client << ", free RPC quota exhausted");
+    message = CORE_RPC_STATUS_BUSY;
+    return false;
+  }
+#define CHECK_PAYMENT_BASE(req, res, payment, same_ts) do { if (!ctx) break; uint64_t P = (uint64_t)payment; if (P > 0 && !check_free_quota(ctx, P, tracker.rpc_name(), res.status)) return true; if (P > 0 && !check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
 #define CHECK_PAYMENT(req, res, payment) CHECK_PAYMENT_BASE(req, res, payment, false)
 #define CHECK_PAYMENT_SAME_TS(req, res, payment) CHECK_PAYMENT_BASE(req, res, payment, true)
-#define CHECK_PAYMENT_MIN1(req, res, payment, same_ts) do { if (!ctx || (m_rpc_payment_allow_free_loopback && ctx->m_remote_address.is_loopback())) break; uint64_t P = (uint64_t)payment; if (P == 0) P = 1; if(!check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
+#define RPC_EXPENSIVE_BASE(on_shed) \
+  boost::optional<rpc::request_gate::ticket> expensive_ticket; \
+  if (ctx && m_restricted) { expensive_ticket.emplace(m_expensive_gate.enter()); if (!*expensive_ticket) { MDEBUG("Shedding " << tracker.rpc_name() << ", too many expensive requests"); on_shed; } }
+#define RPC_EXPENSIVE(res) RPC_EXPENSIVE_BASE(res.status = CORE_RPC_STATUS_BUSY; return true)
+#define RPC_EXPENSIVE_WE(error_resp) RPC_EXPENSIVE_BASE(error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY; error_resp.message = "Too many expensive requests, try again later"; return false)
+#define CHECK_PAYMENT_MIN1(req, res, payment, same_ts) do { if (!ctx || (m_rpc_payment_allow_free_loopback && ctx->m_remote_address.is_loopback())) break; uint64_t P = (uint64_t)payment; if (P == 0) P = 1; if (!check_free_quota(ctx, P, tracker.rpc_name(), res.status)) return true; if(!check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::check_core_ready()
   {
@@ -471,6 +621,17 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_response_cache_tag(const connection_context *ctx, bool depends_on_pool, rpc::response_cache_tag &tag) const
+  {
+    // local calls see unrestricted data, and paid responses carry the client's credits
+    if (!ctx || m_rpc_payment)
+      return false;
+    tag.chain = m_response_cache_chain->load();
+    tag.height = m_core.get_current_blockchain_height();
+    tag.pool = depends_on_pool ? m_core.get_pool_cookie() : 0;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_info);
@@ -493,6 +654,12 @@ namespace cryptonote
 
     CHECK_PAYMENT_MIN1(req, res, COST_PER_GET_INFO, false);
 
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, true, cache_tag);
+    std::string cache_key = cached ? m_get_info_cache.get_key(req) : std::string();
+    if (cached && m_get_info_cache.get(cache_key, cache_tag, res))
+      return true;
+
     const bool restricted = m_restricted && ctx;
 
     crypto::hash top_hash;
@@ -549,8 +716,18 @@ namespace cryptonote
     res.synchronized = check_core_ready();
     res.busy_syncing = m_p2p.get_payload_object().is_busy_syncing();
     res.restricted = restricted;
+    if (restricted)
+    {
+      res.rct_ver_cache_hits = 0;
+      res.rct_ver_cache_misses = 0;
+    }
+    else
+      rct::get_rct_ver_cache_stats(res.rct_ver_cache_hits, res.rct_ver_cache_misses);
+    res.dns_checkpoints_time = m_core.get_dns_checkpoints_time();
 
     res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_get_info_cache.put(std::move(cache_key), cache_tag, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -571,6 +748,262 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::on_metrics(epee::net_utils::http::http_response_info& response)
+  {
+    RPC_TRACKER(metrics);
+    // No bootstrap daemon check: Only ever get metrics about local server
+    height_metric.set(m_core.get_current_blockchain_height());
+    txpool_size_metric.set(m_core.get_pool_transactions_count(false));
+    compute_threadpool_metrics.update(tools::threadpool::getInstanceForCompute());
+    io_threadpool_metrics.update(tools::threadpool::getInstanceForIO());
+    if (!m_restricted)
+    {
+      const uint64_t connections = m_p2p.get_public_connections_count();
+      const uint64_t outgoing = m_p2p.get_public_outgoing_connections_count();
+      connections_in_metric.set(connections - std::min(connections, outgoing));
+      connections_out_metric.set(outgoing);
+
+      uint64_t packets, bytes;
+      {
+        CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in);
+        epee::net_utils::network_throttle_manager::get_global_throttle_in().get_stats(packets, bytes);
+      }
+      p2p_packets_in_metric.set(packets);
+      p2p_bytes_in_metric.set(bytes);
+      {
+        CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
+        epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(packets, bytes);
+      }
+      p2p_packets_out_metric.set(packets);
+      p2p_bytes_out_metric.set(bytes);
+
+      const cryptonote::miner &miner = m_core.get_miner();
+      miner_hashes_metric.set(miner.get_total_hashes());
+      miner_hashrate_metric.set(miner.get_speed());
+    }
+
+    response.m_body = tools::metrics::render(m_restricted);
+    response.m_mime_tipe = "text/plain; version=0.0.4";
+    response.m_header_info.m_content_type = " text/plain; version=0.0.4";
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_db_stats(const COMMAND_RPC_GET_DB_STATS::request& req, COMMAND_RPC_GET_DB_STATS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_db_stats);
+    // No bootstrap daemon check: Only ever get stats about local server
+    db_stats stats;
+    try
+    {
+      if (!m_core.get_blockchain_storage().get_db().get_db_stats(stats))
+      {
+        res.status = "Database statistics not supported by this database";
+        return true;
+      }
+    }
+    catch (const std::exception &e)
+    {
+      res.status = std::string("Failed to get database statistics: ") + e.what();
+      return true;
+    }
+
+    res.map_size = stats.map_size;
+    res.page_size = stats.page_size;
+    res.last_page = stats.last_page;
+    res.max_readers = stats.max_readers;
+    res.num_readers = stats.num_readers;
+    res.tables.reserve(stats.tables.size());
+    for (const db_table_stats &ts: stats.tables)
+    {
+      COMMAND_RPC_GET_DB_STATS::table_stats t;
+      t.name = ts.name;
+      t.entries = ts.entries;
+      t.depth = ts.depth;
+      t.branch_pages = ts.branch_pages;
+      t.leaf_pages = ts.leaf_pages;
+      t.overflow_pages = ts.overflow_pages;
+      t.gets = ts.gets;
+      t.misses = ts.misses;
+      t.puts = ts.puts;
+      t.deletes = ts.deletes;
+      t.bytes_read = ts.bytes_read;
+      t.bytes_written = ts.bytes_written;
+      t.get_latency_histogram = ts.get_latency_histogram;
+      res.tables.push_back(std::move(t));
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  namespace
+  {
+    struct scanned_output
+    {
+      uint32_t output_index;
+      uint32_t spend_key_index;
+      crypto::public_key tx_pub_key;
+    };
+
+    // finds the outputs of tx sent to any of the given spend keys, checking view tags before deriving output keys
+    void scan_tx_outputs(const cryptonote::transaction &tx, const crypto::secret_key &view_secret_key, const std::unordered_map<crypto::public_key, uint32_t> &spend_keys, std::vector<scanned_output> &outputs)
+    {
+      std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+      if (!cryptonote::parse_tx_extra(tx.extra, tx_extra_fields) && tx_extra_fields.empty())
+        return;
+
+      std::vector<std::pair<crypto::public_key, crypto::key_derivation>> derivations;
+      cryptonote::tx_extra_pub_key pub_key_field;
+      size_t pk_index = 0;
+      while (cryptonote::find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index++))
+      {
+        crypto::key_derivation derivation;
+        if (crypto::generate_key_derivation(pub_key_field.pub_key, view_secret_key, derivation))
+          derivations.push_back({pub_key_field.pub_key, derivation});
+      }
+      std::vector<std::pair<crypto::public_key, crypto::key_derivation>> additional_derivations;
+      cryptonote::tx_extra_additional_pub_keys additional_tx_pub_keys;
+      if (cryptonote::find_tx_extra_field_by_type(tx_extra_fields, additional_tx_pub_keys))
+      {
+        additional_derivations.resize(additional_tx_pub_keys.data.size());
+        for (size_t i = 0; i < additional_tx_pub_keys.data.size(); ++i)
+        {
+          additional_derivations[i].first = additional_tx_pub_keys.data[i];
+          if (!crypto::generate_key_derivation(additional_tx_pub_keys.data[i], view_secret_key, additional_derivations[i].second))
+            additional_derivations[i].second = crypto::key_derivation{};
+        }
+      }
+
+      for (size_t k = 0; k < tx.vout.size(); ++k)
+      {
+        crypto::public_key output_public_key;
+        if (!cryptonote::get_output_public_key(tx.vout[k], output_public_key))
+          continue;
+        const boost::optional<crypto::view_tag> view_tag_opt = cryptonote::get_output_view_tag(tx.vout[k]);
+        auto check = [&](const std::pair<crypto::public_key, crypto::key_derivation> &d) {
+          if (!cryptonote::out_can_be_to_acc(view_tag_opt, d.second, k))
+            return false;
+          crypto::public_key spend_key;
+          if (!crypto::derive_subaddress_public_key(output_public_key, d.second, k, spend_key))
+            return false;
+          const auto it = spend_keys.find(spend_key);
+          if (it == spend_keys.end())
+            return false;
+          outputs.push_back({(uint32_t)k, it->second, d.first});
+          return true;
+        };
+        bool found = false;
+        for (size_t i = 0; i < derivations.size() && !found; ++i)
+          found = check(derivations[i]);
+        if (!found && k < additional_derivations.size())
+          check(additional_derivations[k]);
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_scan_outputs(const COMMAND_RPC_SCAN_OUTPUTS::request& req, COMMAND_RPC_SCAN_OUTPUTS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(scan_outputs);
+    // No bootstrap daemon check: the view key must not leave this daemon
+
+    crypto::secret_key view_secret_key;
+    if (!epee::wipeable_string(req.view_key).hex_to_pod(unwrap(unwrap(view_secret_key))))
+    {
+      res.status = "Failed to parse view key";
+      return true;
+    }
+    if (req.spend_public_keys.empty() || req.spend_public_keys.size() > SCAN_OUTPUTS_MAX_SPEND_KEYS)
+    {
+      res.status = "Between 1 and " + std::to_string(SCAN_OUTPUTS_MAX_SPEND_KEYS) + " spend public keys are needed";
+      return true;
+    }
+    std::unordered_map<crypto::public_key, uint32_t> spend_keys;
+    for (size_t i = 0; i < req.spend_public_keys.size(); ++i)
+    {
+      crypto::public_key pkey;
+      if (!epee::string_tools::hex_to_pod(req.spend_public_keys[i], pkey))
+      {
+        res.status = "Failed to parse spend public key: " + req.spend_public_keys[i];
+        return true;
+      }
+      spend_keys.insert({pkey, (uint32_t)i});
+    }
+
+    const uint64_t count = req.count ? std::min<uint64_t>(req.count, SCAN_OUTPUTS_MAX_BLOCKS) : SCAN_OUTPUTS_MAX_BLOCKS;
+    std::vector<std::pair<cryptonote::blobdata, cryptonote::block>> blocks;
+    if (!m_core.get_blocks(req.start_height, count, blocks))
+    {
+      res.status = "Failed to get blocks";
+      return true;
+    }
+
+    // one flat list of txes, so the threadpool is kept busy whatever the block sizes
+    struct tx_to_scan
+    {
+      uint64_t height;
+      crypto::hash txid;
+      cryptonote::transaction tx;
+      std::vector<scanned_output> outputs;
+    };
+    std::vector<tx_to_scan> txes;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+      const cryptonote::block &b = blocks[i].second;
+      const uint64_t height = req.start_height + i;
+      txes.push_back({height, cryptonote::get_transaction_hash(b.miner_tx), b.miner_tx, {}});
+      if (b.tx_hashes.empty())
+        continue;
+      std::vector<cryptonote::transaction> txs;
+      std::vector<crypto::hash> missed_txs;
+      if (!m_core.get_transactions(b.tx_hashes, txs, missed_txs, true) || !missed_txs.empty() || txs.size() != b.tx_hashes.size())
+      {
+        res.status = "Failed to get transactions for block at height " + std::to_string(height);
+        return true;
+      }
+      for (size_t j = 0; j < txs.size(); ++j)
+        txes.push_back({height, b.tx_hashes[j], std::move(txs[j]), {}});
+    }
+
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    for (tx_to_scan &t: txes)
+      tpool.submit(&waiter, [&t, &view_secret_key, &spend_keys]() { scan_tx_outputs(t.tx, view_secret_key, spend_keys, t.outputs); }, true);
+    if (!waiter.wait())
+    {
+      res.status = "Failed to scan outputs";
+      return true;
+    }
+
+    for (const tx_to_scan &t: txes)
+    {
+      if (t.outputs.empty())
+        continue;
+      std::vector<uint64_t> global_indices;
+      if (!m_core.get_tx_outputs_gindexs(t.txid, global_indices) || global_indices.size() != t.tx.vout.size())
+      {
+        res.status = "Failed to get output indices for tx " + epee::string_tools::pod_to_hex(t.txid);
+        return true;
+      }
+      const bool coinbase = cryptonote::is_coinbase(t.tx);
+      for (const scanned_output &o: t.outputs)
+      {
+        COMMAND_RPC_SCAN_OUTPUTS::output_entry e;
+        e.height = t.height;
+        e.tx_hash = epee::string_tools::pod_to_hex(t.txid);
+        e.tx_pub_key = epee::string_tools::pod_to_hex(o.tx_pub_key);
+        e.output_index = o.output_index;
+        e.global_index = global_indices[o.output_index];
+        e.amount = t.tx.vout[o.output_index].amount;
+        e.spend_key_index = o.spend_key_index;
+        e.coinbase = coinbase;
+        res.outputs.push_back(std::move(e));
+      }
+    }
+
+    res.next_height = req.start_height + blocks.size();
+    res.last_block_hash = blocks.empty() ? std::string() : epee::string_tools::pod_to_hex(cryptonote::get_block_hash(blocks.back().second));
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   class pruned_transaction {
     transaction& tx;
   public:
@@ -643,8 +1076,8 @@ namespace cryptonote
     {
       res.blocks.resize(res.blocks.size()+1);
       res.blocks.back().pruned = req.prune;
-      res.blocks.back().block = bd.first.first;
       size += bd.first.first.size();
+      res.blocks.back().block = std::move(bd.first.first);
       res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
       ntxes += bd.second.size();
       res.output_indices.back().indices.reserve(1 + bd.second.size());
@@ -782,29 +1215,106 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS_BIN>(invoke_http_mode::BIN, "/get_outs.bin", req, res, r))
       return r;
 
-    CHECK_PAYMENT_MIN1(req, res, req.outputs.size() * COST_PER_OUT, false);
+    uint64_t num_outs = req.outputs.size();
+    for (const auto &d: req.decoys)
+    {
+      if (d.count > MAX_DECOYS_PER_REQUEST_ENTRY)
+      {
+        res.status = "Too many decoys requested";
+        return true;
+      }
+      num_outs += d.count;
+    }
+
+    CHECK_PAYMENT_MIN1(req, res, num_outs * COST_PER_OUT, false);
 
     res.status = "Failed";
 
     const bool restricted = m_restricted && ctx;
     if (restricted)
     {
-      if (req.outputs.size() > MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT)
+      if (num_outs > MAX_RESTRICTED_GLOBAL_FAKE_OUTS_COUNT)
       {
         res.status = "Too many outs requested";
         return true;
       }
     }
 
-    if(!m_core.get_outs(req, res))
+    if (req.decoys.empty())
     {
-      return true;
+      if(!m_core.get_outs(req, res))
+      {
+        return true;
+      }
+    }
+    else
+    {
+      // decoys are looked up along with the explicit outputs, in the same sorted pass
+      COMMAND_RPC_GET_OUTPUTS_BIN::request sampled = req;
+      sampled.outputs.reserve(num_outs);
+      res.decoy_indices.reserve(num_outs - req.outputs.size());
+      if (!sample_decoys(req.decoys, sampled.outputs, res.decoy_indices))
+      {
+        res.status = "Failed to sample decoys";
+        return true;
+      }
+      if(!m_core.get_outs(sampled, res))
+      {
+        return true;
+      }
     }
 
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::sample_decoys(const std::vector<get_outputs_decoys> &decoys, std::vector<get_outputs_out> &outputs, std::vector<uint64_t> &indices)
+  {
+    const uint64_t chain_height = m_core.get_current_blockchain_height();
+    uint64_t rct_to_height = 0;
+    boost::optional<rpc::output_distribution_data> rct_distribution;
+    std::unique_ptr<gamma_picker> gamma;
+    std::unordered_set<uint64_t> picked;
+    try
+    {
+      for (const auto &d: decoys)
+      {
+        // 0 is placeholder for the whole chain, like for get_output_distribution
+        const uint64_t to_height = d.to_height ? std::min(d.to_height, chain_height - 1) : chain_height - 1;
+        if (!gamma || to_height != rct_to_height)
+        {
+          gamma.reset();
+          rct_distribution = rpc::RpcHandler::get_output_distribution([this](uint64_t amount, uint64_t from, uint64_t to, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base) { return m_core.get_output_distribution(amount, from, to, start_height, distribution, base); }, 0, 0, to_height, [this](uint64_t height) { return m_core.get_blockchain_storage().get_db().get_block_hash_from_height(height); }, true, chain_height);
+          if (!rct_distribution)
+            return false;
+          gamma.reset(new gamma_picker(rct_distribution->distribution));
+          rct_to_height = to_height;
+        }
+
+        picked.clear();
+        const uint64_t num_rct_outs = rct_distribution->distribution.empty() ? 0 : rct_distribution->distribution.back();
+        CHECK_AND_ASSERT_MES(d.count <= num_rct_outs, false, "Not enough rct outputs for " << d.count << " decoys");
+        // bad picks and repeats are retried, but with a bound so a skewed distribution can't spin forever
+        for (uint64_t attempts = 0; picked.size() < d.count; ++attempts)
+        {
+          CHECK_AND_ASSERT_MES(attempts < d.count * 100 + 100, false, "Failed to pick " << d.count << " distinct decoys");
+          const uint64_t i = gamma->pick();
+          if (i != std::numeric_limits<uint64_t>::max() && picked.insert(i).second)
+          {
+            outputs.push_back({0, i});
+            indices.push_back(i);
+          }
+        }
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to sample decoys: " << e.what());
+      return false;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_outs(const COMMAND_RPC_GET_OUTPUTS::request& req, COMMAND_RPC_GET_OUTPUTS::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_outs);
@@ -1166,54 +1676,169 @@ namespace cryptonote
       if(b.size() != sizeof(crypto::key_image))
       {
         res.status = "Failed, size of data mismatch";
+        return true;
       }
       key_images.push_back(*reinterpret_cast<const crypto::key_image*>(b.data()));
     }
-    std::vector<bool> spent_status;
-    bool r = m_core.are_key_images_spent(key_images, spent_status);
-    if(!r)
+    if (!get_key_images_spent_status(key_images, !request_has_rpc_origin || !restricted, res.spent_status))
     {
       res.status = "Failed";
       return true;
     }
-    res.spent_status.clear();
-    for (size_t n = 0; n < spent_status.size(); ++n)
-      res.spent_status.push_back(spent_status[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
 
-    // check the pool too
-    std::vector<cryptonote::tx_info> txs;
-    std::vector<cryptonote::spent_key_image_info> ki;
-    r = m_core.get_pool_transactions_and_spent_keys_info(txs, ki, !request_has_rpc_origin || !restricted);
-    if(!r)
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(is_key_image_spent_bin);
+    bool ok;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN>(invoke_http_mode::BIN, "/is_key_image_spent.bin", req, res, ok))
+      return ok;
+
+    const bool restricted = m_restricted && ctx;
+    const bool request_has_rpc_origin = ctx != NULL;
+
+    if (restricted && req.key_images.size() > RESTRICTED_SPENT_KEY_IMAGES_COUNT)
+    {
+      res.status = "Too many key images queried in restricted mode";
+      return true;
+    }
+
+    CHECK_PAYMENT_MIN1(req, res, req.key_images.size() * COST_PER_KEY_IMAGE, false);
+
+    if (!get_key_images_spent_status(req.key_images, !request_has_rpc_origin || !restricted, res.spent_status))
     {
       res.status = "Failed";
       return true;
     }
-    for (std::vector<cryptonote::spent_key_image_info>::const_iterator i = ki.begin(); i != ki.end(); ++i)
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_key_images_spent_status(const std::vector<crypto::key_image>& key_images, const bool allow_sensitive, std::vector<int>& spent_status)
+  {
+    std::vector<bool> spent;
+    if (!m_core.are_key_images_spent(key_images, spent))
+      return false;
+
+    // only the ones not on chain go to the pool
+    std::vector<crypto::key_image> unspent;
+    for (size_t n = 0; n < spent.size(); ++n)
+      if (!spent[n])
+        unspent.push_back(key_images[n]);
+
+    std::vector<bool> in_pool;
+    if (!unspent.empty() && !m_core.are_key_images_spent_in_pool(unspent, in_pool, allow_sensitive))
+      return false;
+
+    spent_status.clear();
+    spent_status.reserve(spent.size());
+    size_t next_unspent = 0;
+    for (size_t n = 0; n < spent.size(); ++n)
     {
-      crypto::hash hash;
-      crypto::key_image spent_key_image;
-      if (parse_hash256(i->id_hash, hash))
+      if (spent[n])
+        spent_status.push_back(COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN);
+      else
+        spent_status.push_back(in_pool[next_unspent++] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_outputs_by_pubkey(const COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY::request& req, COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_outputs_by_pubkey);
+    bool ok;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY>(invoke_http_mode::JON, "/get_outputs_by_pubkey", req, res, ok))
+      return ok;
+
+    const bool restricted = m_restricted && ctx;
+    if (restricted && req.keys.size() > RESTRICTED_OUTPUT_PUBKEYS_COUNT)
+    {
+      res.status = "Too many keys queried in restricted mode";
+      return true;
+    }
+
+    CHECK_PAYMENT_MIN1(req, res, req.keys.size() * COST_PER_OUTPUT_PUBKEY, false);
+
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    if (!db.has_output_pubkey_index())
+    {
+      res.status = "Output public key index not available, restart the daemon with --output-pubkey-index";
+      return true;
+    }
+
+    res.outputs.clear();
+    res.outputs.reserve(req.keys.size());
+    try
+    {
+      for (const auto &key_hex_str: req.keys)
       {
-        memcpy(&spent_key_image, &hash, sizeof(hash)); // a bit dodgy, should be other parse functions somewhere
-        for (size_t n = 0; n < res.spent_status.size(); ++n)
+        crypto::public_key pubkey;
+        if (!epee::string_tools::hex_to_pod(key_hex_str, pubkey))
         {
-          if (res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT)
-          {
-            if (key_images[n] == spent_key_image)
-            {
-              res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
-              break;
-            }
-          }
+          res.status = "Failed to parse hex representation of output public key";
+          return true;
         }
+        COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY::entry e{};
+        e.found = db.get_output_index_by_pubkey(pubkey, e.amount, e.index);
+        res.outputs.push_back(e);
       }
     }
+    catch (const std::exception &e)
+    {
+      res.status = std::string("Failed to look up outputs: ") + e.what();
+      return true;
+    }
 
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_view_tags(const COMMAND_RPC_GET_VIEW_TAGS::request& req, COMMAND_RPC_GET_VIEW_TAGS::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_view_tags);
+    bool ok;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_VIEW_TAGS>(invoke_http_mode::BIN, "/get_view_tags.bin", req, res, ok))
+      return ok;
+
+    const bool restricted = m_restricted && ctx;
+    if (restricted && req.count > RESTRICTED_BLOCK_COUNT)
+    {
+      res.status = "Too many blocks requested in restricted mode";
+      return true;
+    }
+
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    if (!db.has_view_tag_index())
+    {
+      res.status = "View tag index not available, restart the daemon with --view-tag-index";
+      return true;
+    }
+
+    const uint64_t height = db.height();
+    const uint64_t count = req.start_height < height ? std::min<uint64_t>(req.count, height - req.start_height) : 0;
+    CHECK_PAYMENT_MIN1(req, res, count * COST_PER_BLOCK_VIEW_TAGS, false);
+
+    res.blocks.clear();
+    try
+    {
+      db.get_blocks_view_tags(req.start_height, count, res.blocks);
+    }
+    catch (const std::exception &e)
+    {
+      res.status = std::string("Failed to get view tags: ") + e.what();
+      return true;
+    }
+
+    res.start_height = req.start_height;
+    res.current_height = height;
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(send_raw_tx);
@@ -1572,6 +2197,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL>(invoke_http_mode::JON, "/get_transaction_pool", req, res, r))
       return r;
 
+    RPC_EXPENSIVE(res);
+
     CHECK_PAYMENT(req, res, 1);
 
     const bool restricted = m_restricted && ctx;
@@ -1593,7 +2220,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool_hashes_bin(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response& res, const connection_context *ctx)
   {
-    RPC_TRACKER(get_transaction_pool_hashes);
+    RPC_TRACKER(get_transaction_pool_hashes_bin);
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN>(invoke_http_mode::JON, "/get_transaction_pool_hashes.bin", req, res, r))
       return r;
@@ -1615,6 +2242,41 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_transaction_pool_changes_bin(const COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::response& res, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_transaction_pool_changes_bin);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES>(invoke_http_mode::BIN, "/get_transaction_pool_changes.bin", req, res, r))
+      return r;
+
+    CHECK_PAYMENT(req, res, 1);
+
+    const bool restricted = m_restricted && ctx;
+    const bool request_has_rpc_origin = ctx != NULL;
+    const bool allow_sensitive = !request_has_rpc_origin || !restricted;
+
+    // the revision is read before a full list so no change can be missed
+    res.full = !m_core.get_pool_transaction_changes(req.since_revision, allow_sensitive, res.added, res.removed, res.revision);
+    if (res.full)
+    {
+      res.added.clear();
+      res.removed.clear();
+      size_t n_txes = m_core.get_pool_transactions_count(allow_sensitive);
+      if (n_txes > 0)
+      {
+        CHECK_PAYMENT_SAME_TS(req, res, n_txes * COST_PER_POOL_HASH);
+        m_core.get_pool_transaction_hashes(res.added, allow_sensitive);
+      }
+    }
+    else if (!res.added.empty() || !res.removed.empty())
+    {
+      CHECK_PAYMENT_SAME_TS(req, res, (res.added.size() + res.removed.size()) * COST_PER_POOL_HASH);
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool_hashes(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_transaction_pool_hashes);
@@ -1650,6 +2312,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_STATS>(invoke_http_mode::JON, "/get_transaction_pool_stats", req, res, r))
       return r;
 
+    RPC_EXPENSIVE(res);
+
     CHECK_PAYMENT_MIN1(req, res, COST_PER_TX_POOL_STATS, false);
 
     const bool restricted = m_restricted && ctx;
@@ -2068,26 +2732,20 @@ namespace cryptonote
       return false;
     }
 
-    if (!remove_field_from_tx_extra(b.miner_tx.extra, typeid(cryptonote::tx_extra_merge_mining_tag)))
-    {
-      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
-      error_resp.message = "Error removing existing merkle root";
-      return false;
-    }
-    if (!add_mm_merkle_root_to_tx_extra(b.miner_tx.extra, merkle_root, merkle_tree_depth))
+    cryptonote::mm_block_template mm_template;
+    if (!cryptonote::make_mm_block_template(std::move(b), merkle_tree_depth, mm_template) || !cryptonote::set_mm_merkle_root(mm_template, merkle_root))
     {
       error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
       error_resp.message = "Error adding merkle root";
       return false;
     }
-    b.invalidate_hashes();
-    b.miner_tx.invalidate_hashes();
-
-    const blobdata block_blob = t_serializable_object_to_blob(b);
-    const blobdata hashing_blob = get_block_hashing_blob(b);
 
-    res.blocktemplate_blob = string_tools::buff_to_hex_nodelimer(block_blob);
-    res.blockhashing_blob = string_tools::buff_to_hex_nodelimer(hashing_blob);
+    res.blocktemplate_blob = string_tools::buff_to_hex_nodelimer(mm_template.block_blob);
+    res.blockhashing_blob = string_tools::buff_to_hex_nodelimer(mm_template.hashing_blob);
+    res.coinbase_branch.reserve(mm_template.coinbase_branch.size());
+    for (const crypto::hash &h: mm_template.coinbase_branch)
+      res.coinbase_branch.push_back(epee::string_tools::pod_to_hex(h));
+    res.coinbase_path = mm_template.coinbase_path;
     res.aux_pow = req.aux_pow;
     res.status = CORE_RPC_STATUS_OK;
     return true;
@@ -2358,6 +3016,13 @@ namespace cryptonote
 
     CHECK_CORE_READY();
     CHECK_PAYMENT_MIN1(req, res, COST_PER_BLOCK_HEADER, false);
+
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, false, cache_tag);
+    std::string cache_key = cached ? m_last_block_header_cache.get_key(req) : std::string();
+    if (cached && m_last_block_header_cache.get(cache_key, cache_tag, res))
+      return true;
+
     uint64_t last_block_height;
     crypto::hash last_block_hash;
     m_core.get_blockchain_top(last_block_height, last_block_hash);
@@ -2378,6 +3043,8 @@ namespace cryptonote
       return false;
     }
     res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_last_block_header_cache.put(std::move(cache_key), cache_tag, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2473,6 +3140,13 @@ namespace cryptonote
     }
 
     CHECK_PAYMENT_MIN1(req, res, (req.end_height - req.start_height + 1) * COST_PER_BLOCK_HEADER, false);
+
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, false, cache_tag);
+    std::string cache_key = cached ? m_block_headers_range_cache.get_key(req) : std::string();
+    if (cached && m_block_headers_range_cache.get(cache_key, cache_tag, res))
+      return true;
+
     for (uint64_t h = req.start_height; h <= req.end_height; ++h)
     {
       crypto::hash block_hash = m_core.get_block_id_by_height(h);
@@ -2507,6 +3181,8 @@ namespace cryptonote
       }
     }
     res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_block_headers_range_cache.put(std::move(cache_key), cache_tag, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2822,6 +3498,8 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUT_HISTOGRAM>(invoke_http_mode::JON_RPC, "get_output_histogram", req, res, r))
       return r;
 
+    RPC_EXPENSIVE_WE(error_resp);
+
     const bool restricted = m_restricted && ctx;
     size_t amounts = req.amounts.size();
     if (restricted && amounts == 0)
@@ -2882,6 +3560,7 @@ namespace cryptonote
   bool core_rpc_server::on_get_coinbase_tx_sum(const COMMAND_RPC_GET_COINBASE_TX_SUM::request& req, COMMAND_RPC_GET_COINBASE_TX_SUM::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(get_coinbase_tx_sum);
+    RPC_EXPENSIVE_WE(error_resp);
     const uint64_t bc_height = m_core.get_current_blockchain_height();
     if (req.height >= bc_height || req.count > bc_height)
     {
@@ -2905,6 +3584,12 @@ namespace cryptonote
 
     CHECK_PAYMENT(req, res, COST_PER_FEE_ESTIMATE);
 
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, false, cache_tag);
+    std::string cache_key = cached ? m_fee_estimate_cache.get_key(req) : std::string();
+    if (cached && m_fee_estimate_cache.get(cache_key, cache_tag, res))
+      return true;
+
     const uint8_t version = m_core.get_blockchain_storage().get_current_hard_fork_version();
     if (version >= HF_VERSION_2021_SCALING)
     {
@@ -2917,12 +3602,59 @@ namespace cryptonote
     }
     res.quantization_mask = Blockchain::get_fee_quantization_mask();
     res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_fee_estimate_cache.put(std::move(cache_key), cache_tag, res);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_fee_quantiles(const COMMAND_RPC_GET_FEE_QUANTILES::request& req, COMMAND_RPC_GET_FEE_QUANTILES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_fee_quantiles);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_FEE_QUANTILES>(invoke_http_mode::JON_RPC, "get_fee_quantiles", req, res, r))
+      return r;
+
+    CHECK_PAYMENT(req, res, COST_PER_FEE_QUANTILES);
+
+    if (req.blocks > FEE_QUANTILES_MAX_BLOCKS)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "Too many blocks requested";
+      return false;
+    }
+    if (req.percentiles.size() > FEE_QUANTILES_MAX_PERCENTILES)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "Too many percentiles requested";
+      return false;
+    }
+    res.percentiles = req.percentiles;
+    if (res.percentiles.empty())
+      res.percentiles = {10, 25, 50, 75, 90};
+    for (const uint32_t percentile: res.percentiles)
+    {
+      if (percentile > 100)
+      {
+        error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+        error_resp.message = "Percentiles must be at most 100";
+        return false;
+      }
+    }
+
+    const bool restricted = m_restricted && ctx;
+    const bool request_has_rpc_origin = ctx != NULL;
+    res.height = m_core.get_current_blockchain_height();
+    m_core.get_pool_fee_rate_quantiles(res.percentiles, res.pool, !request_has_rpc_origin || !restricted);
+    m_core.get_blockchain_storage().get_recent_fee_rate_quantiles(req.blocks, res.percentiles, res.recent_blocks);
+    res.blocks = std::min(req.blocks, res.height);
+    res.status = CORE_RPC_STATUS_OK;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_alternate_chains(const COMMAND_RPC_GET_ALTERNATE_CHAINS::request& req, COMMAND_RPC_GET_ALTERNATE_CHAINS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(get_alternate_chains);
+    RPC_EXPENSIVE_WE(error_resp);
     try
     {
       std::vector<std::pair<Blockchain::block_extended_info, std::vector<crypto::hash>>> chains = m_core.get_blockchain_storage().get_alternative_chains();
@@ -3204,9 +3936,19 @@ namespace cryptonote
     res.target_height = m_p2p.get_payload_object().is_synchronized() ? 0 : m_core.get_target_blockchain_height();
     res.next_needed_pruning_seed = m_p2p.get_payload_object().get_next_needed_pruning_stripe().second;
 
+    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
     for (const auto &c: m_p2p.get_payload_object().get_connections())
+    {
       res.peers.push_back({c});
-    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+      boost::uuids::uuid connection_id;
+      cryptonote::block_queue::peer_stats stats;
+      if (epee::string_tools::hex_to_pod(c.connection_id, connection_id) && block_queue.get_peer_stats(connection_id, stats))
+      {
+        res.peers.back().download_rate = (uint32_t)(stats.rate + 0.5f);
+        res.peers.back().span_time = (uint32_t)(stats.span_time * 1000.0f + 0.5f); // milliseconds
+        res.peers.back().span_size = stats.span_size;
+      }
+    }
     block_queue.foreach([&](const cryptonote::block_queue::span &span) {
       const std::string span_connection_id = epee::string_tools::pod_to_hex(span.connection_id);
       uint32_t speed = (uint32_t)(100.0f * block_queue.get_speed(span.connection_id) + 0.5f);
@@ -3225,6 +3967,8 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG>(invoke_http_mode::JON_RPC, "get_txpool_backlog", req, res, r))
       return r;
+
+    RPC_EXPENSIVE_WE(error_resp);
     size_t n_txes = m_core.get_pool_transactions_count();
     CHECK_PAYMENT_MIN1(req, res, COST_PER_TX_POOL_STATS * n_txes, false);
 
@@ -3259,6 +4003,15 @@ namespace cryptonote
       if (amount) ++n_non0; else ++n_0;
     CHECK_PAYMENT_MIN1(req, res, n_0 * COST_PER_OUTPUT_DISTRIBUTION_0 + n_non0 * COST_PER_OUTPUT_DISTRIBUTION, false);
 
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, false, cache_tag);
+    std::string cache_key = cached ? m_output_distribution_cache.get_key(req) : std::string();
+    if (cached && m_output_distribution_cache.get(cache_key, cache_tag, res))
+      return true;
+
+    // cache hits are cheap, only computing a distribution counts as expensive
+    RPC_EXPENSIVE_WE(error_resp);
+
     try
     {
       // 0 is placeholder for the whole chain
@@ -3284,6 +4037,8 @@ namespace cryptonote
     }
 
     res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_output_distribution_cache.put(std::move(cache_key), cache_tag, res);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3307,6 +4062,14 @@ namespace cryptonote
       if (amount) ++n_non0; else ++n_0;
     CHECK_PAYMENT_MIN1(req, res, n_0 * COST_PER_OUTPUT_DISTRIBUTION_0 + n_non0 * COST_PER_OUTPUT_DISTRIBUTION, false);
 
+    rpc::response_cache_tag cache_tag;
+    const bool cached = get_response_cache_tag(ctx, false, cache_tag);
+    std::string cache_key = cached ? m_output_distribution_bin_cache.get_key(req) : std::string();
+    if (cached && m_output_distribution_bin_cache.get(cache_key, cache_tag, res))
+      return true;
+
+    RPC_EXPENSIVE(res);
+
     res.status = "Failed";
 
     if (!req.binary)
@@ -3336,6 +4099,63 @@ namespace cryptonote
       return true;
     }
 
+    res.status = CORE_RPC_STATUS_OK;
+    if (cached)
+      m_output_distribution_bin_cache.put(std::move(cache_key), cache_tag, res);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_response_cache_stats(const COMMAND_RPC_GET_RESPONSE_CACHE_STATS::request& req, COMMAND_RPC_GET_RESPONSE_CACHE_STATS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_response_cache_stats);
+
+    const rpc::response_cache_stats stats[] = {
+      m_get_info_cache.get_stats(),
+      m_fee_estimate_cache.get_stats(),
+      m_last_block_header_cache.get_stats(),
+      m_block_headers_range_cache.get_stats(),
+      m_output_distribution_cache.get_stats(),
+      m_output_distribution_bin_cache.get_stats(),
+    };
+    for (const rpc::response_cache_stats &s: stats)
+      res.endpoints.push_back({s.name, s.hits, s.misses, s.entries});
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_perf_stats(const COMMAND_RPC_GET_PERF_STATS::request& req, COMMAND_RPC_GET_PERF_STATS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_perf_stats);
+
+    for (const tools::aggregate_performance_stats &s: tools::get_aggregate_performance_stats())
+      res.sites.push_back({s.name, s.count, s.total_ns, s.median_ns, s.p90_ns, s.p99_ns});
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_memory_usage(const COMMAND_RPC_GET_MEMORY_USAGE::request& req, COMMAND_RPC_GET_MEMORY_USAGE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_memory_usage);
+
+    std::vector<tools::memory_usage> usage;
+    m_core.get_memory_usage(usage);
+
+    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+    uint64_t spans = 0;
+    block_queue.foreach([&spans](const cryptonote::block_queue::span&) { ++spans; return true; });
+    usage.push_back({"block_queue", spans, block_queue.get_data_size()});
+
+    // the peerlists are multi_index containers with two ordered indices each
+    const uint64_t peers = m_p2p.get_public_white_peers_count() + m_p2p.get_public_gray_peers_count();
+    usage.push_back({"peerlist", peers, peers * (sizeof(nodetool::peerlist_entry) + 8 * sizeof(void*))});
+
+    for (const tools::memory_usage &u: usage)
+      res.caches.push_back({u.name, u.entries, u.bytes});
+    res.resident_bytes = tools::get_resident_memory();
+    res.database_bytes = m_core.get_blockchain_storage().get_db().get_database_size();
+
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -3683,4 +4503,40 @@ namespace cryptonote
     , "Allow free access from the loopback address (ie, the local host)"
     , false
     };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_max_expensive_requests = {
+      "rpc-max-expensive-requests"
+    , "Max number of expensive restricted RPC requests (histograms, distributions, txpool dumps...) served at once"
+    , DEFAULT_MAX_EXPENSIVE_REQUESTS
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_max_queued_expensive_requests = {
+      "rpc-max-queued-expensive-requests"
+    , "Max number of expensive restricted RPC requests waiting for a slot before more are rejected as busy"
+    , DEFAULT_MAX_QUEUED_EXPENSIVE_REQUESTS
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_free_credits_per_second = {
+      "rpc-free-credits-per-second"
+    , "Without RPC payment, rate in RPC payment credits at which each client subnet may make calls (0 for no limit)"
+    , 0
+    };
+
+  const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_rpc_free_credits_burst = {
+      "rpc-free-credits-burst"
+    , "Credits a client subnet may spend at once before --rpc-free-credits-per-second applies (0 for " BOOST_PP_STRINGIZE(DEFAULT_FREE_CREDITS_BURST_SECONDS) " seconds' worth)"
+    , 0
+    };
+
+  const command_line::arg_descriptor<std::string> core_rpc_server::arg_rpc_record_file = {
+      "rpc-record-file"
+    , "Append a sample of incoming RPC requests to this file, suffixed with the RPC port, for replay with monero-rpc-bench"
+    , ""
+    };
+
+  const command_line::arg_descriptor<double> core_rpc_server::arg_rpc_record_sample_rate = {
+      "rpc-record-sample-rate"
+    , "Fraction of RPC requests written to --rpc-record-file, in (0, 1]"
+    , 0.01
+    };
 }  // namespace cryptonote
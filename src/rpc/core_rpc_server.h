@@ -30,6 +30,8 @@
 
 #pragma  once 
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 
 #include <boost/program_options/options_description.hpp>
@@ -42,7 +44,11 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "rpc_client_quota.h"
 #include "rpc_payment.h"
+#include "rpc_request_gate.h"
+#include "rpc_request_recorder.h"
+#include "rpc_response_cache.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -73,6 +79,12 @@ namespace cryptonote
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_difficulty;
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_credits;
     static const command_line::arg_descriptor<bool> arg_rpc_payment_allow_free_loopback;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_max_expensive_requests;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_max_queued_expensive_requests;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_free_credits_per_second;
+    static const command_line::arg_descriptor<uint64_t> arg_rpc_free_credits_burst;
+    static const command_line::arg_descriptor<std::string> arg_rpc_record_file;
+    static const command_line::arg_descriptor<double> arg_rpc_record_sample_rate;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -91,8 +103,34 @@ namespace cryptonote
         const std::string& proxy = {}
       );
     network_type nettype() const { return m_core.get_nettype(); }
+    //! io threads to run with, enough that expensive requests can't hold all of them
+    size_t get_io_threads_count() const { return m_io_threads_count; }
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //! forwards http requests to the uri map, as CHAIN_HTTP_TO_MAP2 does, and samples them for replay
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info,
+        epee::net_utils::http::http_response_info& response,
+        connection_context& m_conn_context)
+    {
+      MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+      const auto start = std::chrono::steady_clock::now();
+      response.m_response_code = 200;
+      response.m_response_comment = "Ok";
+      try
+      {
+        if(!handle_http_request_map(query_info, response, m_conn_context))
+        {response.m_response_code = 404;response.m_response_comment = "Not found";}
+      }
+      catch (const std::exception &e)
+      {
+        MERROR(m_conn_context << "Exception in handle_http_request_map: " << e.what());
+        response.m_response_code = 500;
+        response.m_response_comment = "Internal Server Error";
+      }
+      if (m_request_recorder.enabled())
+        m_request_recorder.record(query_info.m_http_method_str, query_info.m_URI,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), query_info.m_body);
+      return true;
+    }
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/get_height", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -109,6 +147,9 @@ namespace cryptonote
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/get_alt_blocks_hashes", on_get_alt_blocks_hashes, COMMAND_RPC_GET_ALT_BLOCKS_HASHES)
       MAP_URI_AUTO_JON2("/is_key_image_spent", on_is_key_image_spent, COMMAND_RPC_IS_KEY_IMAGE_SPENT)
+      MAP_URI_AUTO_BIN2("/is_key_image_spent.bin", on_is_key_image_spent_bin, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN)
+      MAP_URI_AUTO_JON2("/get_outputs_by_pubkey", on_get_outputs_by_pubkey, COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY)
+      MAP_URI_AUTO_BIN2("/get_view_tags.bin", on_get_view_tags, COMMAND_RPC_GET_VIEW_TAGS)
       MAP_URI_AUTO_JON2("/send_raw_transaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2_IF("/start_mining", on_start_mining, COMMAND_RPC_START_MINING, !m_restricted)
@@ -123,12 +164,20 @@ namespace cryptonote
       MAP_URI_AUTO_JON2("/get_transaction_pool", on_get_transaction_pool, COMMAND_RPC_GET_TRANSACTION_POOL)
       MAP_URI_AUTO_JON2("/get_transaction_pool_hashes.bin", on_get_transaction_pool_hashes_bin, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN)
       MAP_URI_AUTO_JON2("/get_transaction_pool_hashes", on_get_transaction_pool_hashes, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES)
+      MAP_URI_AUTO_BIN2("/get_transaction_pool_changes.bin", on_get_transaction_pool_changes_bin, COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES)
       MAP_URI_AUTO_JON2("/get_transaction_pool_stats", on_get_transaction_pool_stats, COMMAND_RPC_GET_TRANSACTION_POOL_STATS)
       MAP_URI_AUTO_JON2_IF("/set_bootstrap_daemon", on_set_bootstrap_daemon, COMMAND_RPC_SET_BOOTSTRAP_DAEMON, !m_restricted)
       MAP_URI_AUTO_JON2_IF("/stop_daemon", on_stop_daemon, COMMAND_RPC_STOP_DAEMON, !m_restricted)
       MAP_URI_AUTO_JON2("/get_info", on_get_info, COMMAND_RPC_GET_INFO)
       MAP_URI_AUTO_JON2("/getinfo", on_get_info, COMMAND_RPC_GET_INFO)
       MAP_URI_AUTO_JON2_IF("/get_net_stats", on_get_net_stats, COMMAND_RPC_GET_NET_STATS, !m_restricted)
+      else if(query_info.m_URI == "/metrics")
+      {
+        handled = true;
+        on_metrics(response_info);
+      }
+      MAP_URI_AUTO_JON2_IF("/get_db_stats", on_get_db_stats, COMMAND_RPC_GET_DB_STATS, !m_restricted)
+      MAP_URI_AUTO_JON2_IF("/scan_outputs", on_scan_outputs, COMMAND_RPC_SCAN_OUTPUTS, !m_restricted)
       MAP_URI_AUTO_JON2("/get_limit", on_get_limit, COMMAND_RPC_GET_LIMIT)
       MAP_URI_AUTO_JON2_IF("/set_limit", on_set_limit, COMMAND_RPC_SET_LIMIT, !m_restricted)
       MAP_URI_AUTO_JON2_IF("/out_peers", on_out_peers, COMMAND_RPC_OUT_PEERS, !m_restricted)
@@ -171,6 +220,7 @@ namespace cryptonote
         MAP_JON_RPC_WE("get_version",            on_get_version,                COMMAND_RPC_GET_VERSION)
         MAP_JON_RPC_WE_IF("get_coinbase_tx_sum", on_get_coinbase_tx_sum,        COMMAND_RPC_GET_COINBASE_TX_SUM, !m_restricted)
         MAP_JON_RPC_WE("get_fee_estimate",       on_get_base_fee_estimate,      COMMAND_RPC_GET_BASE_FEE_ESTIMATE)
+        MAP_JON_RPC_WE("get_fee_quantiles",      on_get_fee_quantiles,          COMMAND_RPC_GET_FEE_QUANTILES)
         MAP_JON_RPC_WE_IF("get_alternate_chains",on_get_alternate_chains,       COMMAND_RPC_GET_ALTERNATE_CHAINS, !m_restricted)
         MAP_JON_RPC_WE_IF("relay_tx",            on_relay_tx,                   COMMAND_RPC_RELAY_TX, !m_restricted)
         MAP_JON_RPC_WE_IF("sync_info",           on_sync_info,                  COMMAND_RPC_SYNC_INFO, !m_restricted)
@@ -178,6 +228,9 @@ namespace cryptonote
         MAP_JON_RPC_WE("get_output_distribution", on_get_output_distribution, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION)
         MAP_JON_RPC_WE_IF("prune_blockchain",    on_prune_blockchain,           COMMAND_RPC_PRUNE_BLOCKCHAIN, !m_restricted)
         MAP_JON_RPC_WE_IF("flush_cache",         on_flush_cache,                COMMAND_RPC_FLUSH_CACHE, !m_restricted)
+        MAP_JON_RPC_WE_IF("get_response_cache_stats", on_get_response_cache_stats, COMMAND_RPC_GET_RESPONSE_CACHE_STATS, !m_restricted)
+        MAP_JON_RPC_WE_IF("get_perf_stats",      on_get_perf_stats,             COMMAND_RPC_GET_PERF_STATS, !m_restricted)
+        MAP_JON_RPC_WE_IF("get_memory_usage",    on_get_memory_usage,           COMMAND_RPC_GET_MEMORY_USAGE, !m_restricted)
         MAP_JON_RPC_WE("rpc_access_info",        on_rpc_access_info,            COMMAND_RPC_ACCESS_INFO)
         MAP_JON_RPC_WE("rpc_access_submit_nonce",on_rpc_access_submit_nonce,    COMMAND_RPC_ACCESS_SUBMIT_NONCE)
         MAP_JON_RPC_WE("rpc_access_pay",         on_rpc_access_pay,             COMMAND_RPC_ACCESS_PAY)
@@ -194,6 +247,9 @@ namespace cryptonote
     bool on_get_hashes(const COMMAND_RPC_GET_HASHES_FAST::request& req, COMMAND_RPC_GET_HASHES_FAST::response& res, const connection_context *ctx = NULL);
     bool on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request& req, COMMAND_RPC_GET_TRANSACTIONS::response& res, const connection_context *ctx = NULL);
     bool on_is_key_image_spent(const COMMAND_RPC_IS_KEY_IMAGE_SPENT::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT::response& res, const connection_context *ctx = NULL);
+    bool on_is_key_image_spent_bin(const COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request& req, COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response& res, const connection_context *ctx = NULL);
+    bool on_get_outputs_by_pubkey(const COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY::request& req, COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY::response& res, const connection_context *ctx = NULL);
+    bool on_get_view_tags(const COMMAND_RPC_GET_VIEW_TAGS::request& req, COMMAND_RPC_GET_VIEW_TAGS::response& res, const connection_context *ctx = NULL);
     bool on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res, const connection_context *ctx = NULL);
     bool on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res, const connection_context *ctx = NULL);
     bool on_start_mining(const COMMAND_RPC_START_MINING::request& req, COMMAND_RPC_START_MINING::response& res, const connection_context *ctx = NULL);
@@ -203,6 +259,10 @@ namespace cryptonote
     bool on_get_outs(const COMMAND_RPC_GET_OUTPUTS::request& req, COMMAND_RPC_GET_OUTPUTS::response& res, const connection_context *ctx = NULL);
     bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, const connection_context *ctx = NULL);
     bool on_get_net_stats(const COMMAND_RPC_GET_NET_STATS::request& req, COMMAND_RPC_GET_NET_STATS::response& res, const connection_context *ctx = NULL);
+    //! Prometheus text exposition of tools::metrics, restricted metrics left out on a restricted RPC
+    void on_metrics(epee::net_utils::http::http_response_info& response);
+    bool on_get_db_stats(const COMMAND_RPC_GET_DB_STATS::request& req, COMMAND_RPC_GET_DB_STATS::response& res, const connection_context *ctx = NULL);
+    bool on_scan_outputs(const COMMAND_RPC_SCAN_OUTPUTS::request& req, COMMAND_RPC_SCAN_OUTPUTS::response& res, const connection_context *ctx = NULL);
     bool on_save_bc(const COMMAND_RPC_SAVE_BC::request& req, COMMAND_RPC_SAVE_BC::response& res, const connection_context *ctx = NULL);
     bool on_get_peer_list(const COMMAND_RPC_GET_PEER_LIST::request& req, COMMAND_RPC_GET_PEER_LIST::response& res, const connection_context *ctx = NULL);
     bool on_get_public_nodes(const COMMAND_RPC_GET_PUBLIC_NODES::request& req, COMMAND_RPC_GET_PUBLIC_NODES::response& res, const connection_context *ctx = NULL);
@@ -212,6 +272,7 @@ namespace cryptonote
     bool on_get_transaction_pool(const COMMAND_RPC_GET_TRANSACTION_POOL::request& req, COMMAND_RPC_GET_TRANSACTION_POOL::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool_hashes_bin(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool_hashes(const COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_HASHES::response& res, const connection_context *ctx = NULL);
+    bool on_get_transaction_pool_changes_bin(const COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::response& res, const connection_context *ctx = NULL);
     bool on_get_transaction_pool_stats(const COMMAND_RPC_GET_TRANSACTION_POOL_STATS::request& req, COMMAND_RPC_GET_TRANSACTION_POOL_STATS::response& res, const connection_context *ctx = NULL);
     bool on_set_bootstrap_daemon(const COMMAND_RPC_SET_BOOTSTRAP_DAEMON::request& req, COMMAND_RPC_SET_BOOTSTRAP_DAEMON::response& res, const connection_context *ctx = NULL);
     bool on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res, const connection_context *ctx = NULL);
@@ -248,6 +309,7 @@ namespace cryptonote
     bool on_get_version(const COMMAND_RPC_GET_VERSION::request& req, COMMAND_RPC_GET_VERSION::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_coinbase_tx_sum(const COMMAND_RPC_GET_COINBASE_TX_SUM::request& req, COMMAND_RPC_GET_COINBASE_TX_SUM::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_base_fee_estimate(const COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request& req, COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_get_fee_quantiles(const COMMAND_RPC_GET_FEE_QUANTILES::request& req, COMMAND_RPC_GET_FEE_QUANTILES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_alternate_chains(const COMMAND_RPC_GET_ALTERNATE_CHAINS::request& req, COMMAND_RPC_GET_ALTERNATE_CHAINS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_relay_tx(const COMMAND_RPC_RELAY_TX::request& req, COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_sync_info(const COMMAND_RPC_SYNC_INFO::request& req, COMMAND_RPC_SYNC_INFO::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
@@ -255,6 +317,9 @@ namespace cryptonote
     bool on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_prune_blockchain(const COMMAND_RPC_PRUNE_BLOCKCHAIN::request& req, COMMAND_RPC_PRUNE_BLOCKCHAIN::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_flush_cache(const COMMAND_RPC_FLUSH_CACHE::request& req, COMMAND_RPC_FLUSH_CACHE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_get_response_cache_stats(const COMMAND_RPC_GET_RESPONSE_CACHE_STATS::request& req, COMMAND_RPC_GET_RESPONSE_CACHE_STATS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_get_perf_stats(const COMMAND_RPC_GET_PERF_STATS::request& req, COMMAND_RPC_GET_PERF_STATS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_get_memory_usage(const COMMAND_RPC_GET_MEMORY_USAGE::request& req, COMMAND_RPC_GET_MEMORY_USAGE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_info(const COMMAND_RPC_ACCESS_INFO::request& req, COMMAND_RPC_ACCESS_INFO::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_submit_nonce(const COMMAND_RPC_ACCESS_SUBMIT_NONCE::request& req, COMMAND_RPC_ACCESS_SUBMIT_NONCE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_rpc_access_pay(const COMMAND_RPC_ACCESS_PAY::request& req, COMMAND_RPC_ACCESS_PAY::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
@@ -272,6 +337,7 @@ private:
     uint64_t get_block_reward(const block& blk);
     bool fill_block_header_response(const block& blk, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response, bool fill_pow_hash);
     std::map<std::string, bool> get_public_nodes(uint32_t credits_per_hash_threshold = 0);
+    bool get_key_images_spent_status(const std::vector<crypto::key_image>& key_images, bool allow_sensitive, std::vector<int>& spent_status);
     bool set_bootstrap_daemon(
       const std::string &address,
       const std::string &username_password,
@@ -285,6 +351,12 @@ private:
     bool use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r);
     bool get_block_template(const account_public_address &address, const crypto::hash *prev_block, const cryptonote::blobdata &extra_nonce, size_t &reserved_offset, cryptonote::difficulty_type &difficulty, uint64_t &height, uint64_t &expected_reward, block &b, uint64_t &seed_height, crypto::hash &seed_hash, crypto::hash &next_seed_hash, epee::json_rpc::error &error_resp);
     bool check_payment(const std::string &client, uint64_t payment, const std::string &rpc, bool same_ts, std::string &message, uint64_t &credits, std::string &top_hash);
+    //! charges cost to the caller's free tier quota when no payment is set up, false if the call must be shed
+    bool check_free_quota(const connection_context *ctx, uint64_t cost, const std::string &rpc, std::string &message);
+    //! \return false if responses to this caller must not be cached
+    bool get_response_cache_tag(const connection_context *ctx, bool depends_on_pool, rpc::response_cache_tag &tag) const;
+    //! appends the rct outputs picked for each decoy request to outputs, and their indices to indices
+    bool sample_decoys(const std::vector<get_outputs_decoys> &decoys, std::vector<get_outputs_out> &outputs, std::vector<uint64_t> &indices);
     
     core& m_core;
     nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
@@ -300,6 +372,19 @@ private:
     std::unique_ptr<rpc_payment> m_rpc_payment;
     bool disable_rpc_ban;
     bool m_rpc_payment_allow_free_loopback;
+    rpc::request_gate m_expensive_gate;
+    rpc::client_quota m_free_quota;
+    rpc::request_recorder m_request_recorder;
+    size_t m_io_threads_count;
+
+    // shared with the block notifier, which may outlive us
+    std::shared_ptr<std::atomic<uint64_t>> m_response_cache_chain;
+    rpc::response_cache<COMMAND_RPC_GET_INFO> m_get_info_cache;
+    rpc::response_cache<COMMAND_RPC_GET_BASE_FEE_ESTIMATE> m_fee_estimate_cache;
+    rpc::response_cache<COMMAND_RPC_GET_LAST_BLOCK_HEADER> m_last_block_header_cache;
+    rpc::response_cache<COMMAND_RPC_GET_BLOCK_HEADERS_RANGE> m_block_headers_range_cache;
+    rpc::response_cache<COMMAND_RPC_GET_OUTPUT_DISTRIBUTION> m_output_distribution_cache;
+    rpc::response_cache<COMMAND_RPC_GET_OUTPUT_DISTRIBUTION> m_output_distribution_bin_cache;
   };
 }
 
@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 11
+#define CORE_RPC_VERSION_MINOR 26
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -436,6 +436,103 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  //-----------------------------------------------
+  struct COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      std::vector<crypto::key_image> key_images;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_access_response_base
+    {
+      std::vector<int> spent_status; // COMMAND_RPC_IS_KEY_IMAGE_SPENT::STATUS
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(spent_status)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
+  //-----------------------------------------------
+  struct COMMAND_RPC_GET_OUTPUTS_BY_PUBKEY
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      std::vector<std::string> keys;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE(keys)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct entry
+    {
+      bool found;
+      uint64_t amount;
+      uint64_t index;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(found)
+        KV_SERIALIZE(amount)
+        KV_SERIALIZE(index)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_access_response_base
+    {
+      std::vector<entry> outputs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(outputs)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
+  //-----------------------------------------------
+  struct COMMAND_RPC_GET_VIEW_TAGS
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      uint64_t start_height;
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_access_response_base
+    {
+      uint64_t start_height;
+      uint64_t current_height;
+      std::vector<std::string> blocks; // serialized block_view_tags, empty for blocks before view tags
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(current_height)
+        KV_SERIALIZE(blocks)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   //-----------------------------------------------
   struct COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES
   {
@@ -473,17 +570,31 @@ namespace cryptonote
     END_KV_SERIALIZE_MAP()
   };
 
+  // rct decoys the daemon picks itself from the gamma distribution, for one real output
+  struct get_outputs_decoys
+  {
+    uint64_t count;
+    uint64_t to_height;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(count)
+      KV_SERIALIZE_OPT(to_height, (uint64_t)0)
+    END_KV_SERIALIZE_MAP()
+  };
+
   struct COMMAND_RPC_GET_OUTPUTS_BIN
   {
     struct request_t: public rpc_access_request_base
     {
       std::vector<get_outputs_out> outputs;
       bool get_txid;
+      std::vector<get_outputs_decoys> decoys;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_request_base)
         KV_SERIALIZE(outputs)
         KV_SERIALIZE_OPT(get_txid, true)
+        KV_SERIALIZE(decoys)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -508,10 +619,12 @@ namespace cryptonote
     struct response_t: public rpc_access_response_base
     {
       std::vector<outkey> outs;
+      std::vector<uint64_t> decoy_indices;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_response_base)
         KV_SERIALIZE(outs)
+        KV_SERIALIZE(decoy_indices)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -690,6 +803,9 @@ namespace cryptonote
       std::string version;
       bool synchronized;
       bool restricted;
+      uint64_t rct_ver_cache_hits;
+      uint64_t rct_ver_cache_misses;
+      uint64_t dns_checkpoints_time;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_response_base)
@@ -732,6 +848,9 @@ namespace cryptonote
         KV_SERIALIZE(version)
         KV_SERIALIZE(synchronized)
         KV_SERIALIZE(restricted)
+        KV_SERIALIZE_OPT(rct_ver_cache_hits, (uint64_t)0)
+        KV_SERIALIZE_OPT(rct_ver_cache_misses, (uint64_t)0)
+        KV_SERIALIZE_OPT(dns_checkpoints_time, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -770,6 +889,131 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  //-----------------------------------------------
+  struct COMMAND_RPC_GET_DB_STATS
+  {
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct table_stats
+    {
+      std::string name;
+      uint64_t entries;
+      uint64_t depth;
+      uint64_t branch_pages;
+      uint64_t leaf_pages;
+      uint64_t overflow_pages;
+      uint64_t gets;
+      uint64_t misses;
+      uint64_t puts;
+      uint64_t deletes;
+      uint64_t bytes_read;
+      uint64_t bytes_written;
+      std::vector<uint64_t> get_latency_histogram;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(entries)
+        KV_SERIALIZE(depth)
+        KV_SERIALIZE(branch_pages)
+        KV_SERIALIZE(leaf_pages)
+        KV_SERIALIZE(overflow_pages)
+        KV_SERIALIZE(gets)
+        KV_SERIALIZE(misses)
+        KV_SERIALIZE(puts)
+        KV_SERIALIZE(deletes)
+        KV_SERIALIZE(bytes_read)
+        KV_SERIALIZE(bytes_written)
+        KV_SERIALIZE(get_latency_histogram)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_response_base
+    {
+      uint64_t map_size;
+      uint64_t page_size;
+      uint64_t last_page;
+      uint64_t max_readers;
+      uint64_t num_readers;
+      std::vector<table_stats> tables;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(map_size)
+        KV_SERIALIZE(page_size)
+        KV_SERIALIZE(last_page)
+        KV_SERIALIZE(max_readers)
+        KV_SERIALIZE(num_readers)
+        KV_SERIALIZE(tables)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
+  //-----------------------------------------------
+  struct COMMAND_RPC_SCAN_OUTPUTS
+  {
+    struct request_t: public rpc_request_base
+    {
+      std::string view_key;
+      std::vector<std::string> spend_public_keys;
+      uint64_t start_height;
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+        KV_SERIALIZE(view_key)
+        KV_SERIALIZE(spend_public_keys)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE_OPT(count, (uint64_t)0)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct output_entry
+    {
+      uint64_t height;
+      std::string tx_hash;
+      std::string tx_pub_key;
+      uint32_t output_index;
+      uint64_t global_index;
+      uint64_t amount;
+      uint32_t spend_key_index;
+      bool coinbase;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(tx_hash)
+        KV_SERIALIZE(tx_pub_key)
+        KV_SERIALIZE(output_index)
+        KV_SERIALIZE(global_index)
+        KV_SERIALIZE(amount)
+        KV_SERIALIZE(spend_key_index)
+        KV_SERIALIZE(coinbase)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_response_base
+    {
+      std::vector<output_entry> outputs;
+      uint64_t next_height;
+      std::string last_block_hash;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(outputs)
+        KV_SERIALIZE(next_height)
+        KV_SERIALIZE(last_block_hash)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   //-----------------------------------------------
   struct COMMAND_RPC_STOP_MINING
   {
@@ -1047,6 +1291,8 @@ namespace cryptonote
       std::string merkle_root;
       uint32_t merkle_tree_depth;
       std::vector<aux_pow_t> aux_pow;
+      std::vector<std::string> coinbase_branch;
+      uint32_t coinbase_path;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
@@ -1055,6 +1301,8 @@ namespace cryptonote
         KV_SERIALIZE(merkle_root)
         KV_SERIALIZE(merkle_tree_depth)
         KV_SERIALIZE(aux_pow)
+        KV_SERIALIZE(coinbase_branch)
+        KV_SERIALIZE(coinbase_path)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1558,6 +1806,37 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      uint64_t since_revision;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE_OPT(since_revision, (uint64_t)0)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_access_response_base
+    {
+      uint64_t revision;
+      bool full; // added lists the whole pool, since_revision was too old or unknown
+      std::vector<crypto::hash> added;
+      std::vector<crypto::hash> removed;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(revision)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(added)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(removed)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_GET_TRANSACTION_POOL_HASHES
   {
     struct request_t: public rpc_access_request_base
@@ -1655,6 +1934,21 @@ namespace cryptonote
     END_KV_SERIALIZE_MAP()
   };
 
+  struct fee_rate_quantiles
+  {
+    uint32_t txs;
+    uint64_t bytes;
+    std::vector<uint64_t> fee_rates;
+
+    fee_rate_quantiles(): txs(0), bytes(0) {}
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(txs)
+      KV_SERIALIZE(bytes)
+      KV_SERIALIZE(fee_rates)
+    END_KV_SERIALIZE_MAP()
+  };
+
   struct COMMAND_RPC_GET_TRANSACTION_POOL_STATS
   {
     struct request_t: public rpc_access_request_base
@@ -2222,6 +2516,41 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_FEE_QUANTILES
+  {
+    struct request_t: public rpc_access_request_base
+    {
+      std::vector<uint32_t> percentiles;
+      uint64_t blocks;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_request_base)
+        KV_SERIALIZE(percentiles)
+        KV_SERIALIZE_OPT(blocks, (uint64_t)10)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_access_response_base
+    {
+      uint64_t height;
+      std::vector<uint32_t> percentiles;
+      fee_rate_quantiles pool;
+      uint64_t blocks;
+      fee_rate_quantiles recent_blocks;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_access_response_base)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(percentiles)
+        KV_SERIALIZE(pool)
+        KV_SERIALIZE(blocks)
+        KV_SERIALIZE(recent_blocks)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_GET_ALTERNATE_CHAINS
   {
     struct request_t: public rpc_request_base
@@ -2339,9 +2668,15 @@ namespace cryptonote
     struct peer
     {
       connection_info info;
+      uint32_t download_rate;
+      uint32_t span_time;
+      uint64_t span_size;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(info)
+        KV_SERIALIZE_OPT(download_rate, (uint32_t)0)
+        KV_SERIALIZE_OPT(span_time, (uint32_t)0)
+        KV_SERIALIZE_OPT(span_size, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2741,4 +3076,121 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_RESPONSE_CACHE_STATS
+  {
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct endpoint_stats
+    {
+      std::string name;
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t entries;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(hits)
+        KV_SERIALIZE(misses)
+        KV_SERIALIZE(entries)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_response_base
+    {
+      std::vector<endpoint_stats> endpoints;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(endpoints)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
+  struct COMMAND_RPC_GET_PERF_STATS
+  {
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct site_stats
+    {
+      std::string name;
+      uint64_t count;
+      uint64_t total_ns;
+      uint64_t median_ns;
+      uint64_t p90_ns;
+      uint64_t p99_ns;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(count)
+        KV_SERIALIZE(total_ns)
+        KV_SERIALIZE(median_ns)
+        KV_SERIALIZE(p90_ns)
+        KV_SERIALIZE(p99_ns)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_response_base
+    {
+      std::vector<site_stats> sites;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(sites)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
+  struct COMMAND_RPC_GET_MEMORY_USAGE
+  {
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct entry
+    {
+      std::string name;
+      uint64_t entries;
+      uint64_t bytes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(entries)
+        KV_SERIALIZE(bytes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t: public rpc_response_base
+    {
+      std::vector<entry> caches;
+      uint64_t resident_bytes;
+      uint64_t database_bytes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(caches)
+        KV_SERIALIZE(resident_bytes)
+        KV_SERIALIZE(database_bytes)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
 }
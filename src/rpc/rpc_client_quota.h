@@ -0,0 +1,140 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace cryptonote
+{
+namespace rpc
+{
+  struct client_quota_stats
+  {
+    uint64_t admitted;
+    uint64_t shed;
+    std::size_t clients;
+  };
+
+  /*! Free tier counterpart of rpc_payment: every client (usually a subnet) has
+   *  a token bucket of credits, refilled at a fixed rate up to a burst size,
+   *  and each call takes its rpc_payment_costs.h cost out of it. A call is
+   *  admitted as long as the bucket is not in debt, so calls costing more than
+   *  the burst still go through, and the client then waits for the debt to be
+   *  refilled. A rate of 0 disables the quota.
+   */
+  class client_quota
+  {
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    client_quota() : m_rate(0), m_burst(0), m_admitted(0), m_shed(0) {}
+
+    void set_limits(uint64_t credits_per_second, uint64_t burst)
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      m_burst = burst;
+      m_buckets.clear();
+      m_rate = credits_per_second;
+    }
+
+    bool enabled() const noexcept { return m_rate.load(std::memory_order_relaxed) != 0; }
+
+    //! Takes cost credits from client's bucket, false if the call should be shed
+    bool charge(const std::string &client, uint64_t cost, clock::time_point now = clock::now())
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      if (!m_rate)
+        return true;
+      auto it = m_buckets.find(client);
+      if (it == m_buckets.end())
+        it = m_buckets.emplace(client, bucket{double(m_burst), now}).first;
+      bucket &b = it->second;
+      refill(b, now);
+      if (b.credits < 0)
+      {
+        ++m_shed;
+        return false;
+      }
+      b.credits -= cost;
+      ++m_admitted;
+      return true;
+    }
+
+    //! Forgets clients whose bucket has refilled, they start full again anyway
+    void prune(clock::time_point now = clock::now())
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      for (auto it = m_buckets.begin(); it != m_buckets.end(); )
+      {
+        refill(it->second, now);
+        if (it->second.credits >= m_burst)
+          it = m_buckets.erase(it);
+        else
+          ++it;
+      }
+    }
+
+    client_quota_stats get_stats() const
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      return {m_admitted, m_shed, m_buckets.size()};
+    }
+
+  private:
+    struct bucket
+    {
+      double credits;
+      clock::time_point last;
+    };
+
+    void refill(bucket &b, clock::time_point now) const
+    {
+      if (now <= b.last)
+        return;
+      const double elapsed = std::chrono::duration<double>(now - b.last).count();
+      b.credits = std::min(double(m_burst), b.credits + elapsed * m_rate);
+      b.last = now;
+    }
+
+    mutable boost::mutex m_mutex;
+    std::atomic<uint64_t> m_rate;
+    uint64_t m_burst;
+    std::unordered_map<std::string, bucket> m_buckets;
+    uint64_t m_admitted;
+    uint64_t m_shed;
+  };
+}
+}
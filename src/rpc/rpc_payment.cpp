@@ -31,6 +31,7 @@
 #include "cryptonote_config.h"
 #include "include_base_utils.h"
 #include "string_tools.h"
+#include "misc_language.h"
 #include "file_io_utils.h"
 #include "int-util.h"
 #include "common/util.h"
@@ -53,6 +54,10 @@
 #define DEFAULT_FLUSH_AGE (3600 * 24 * 180) // half a year
 #define DEFAULT_ZERO_FLUSH_AGE (60 * 2) // 2 minutes
 
+// nonces are hashed outside the lock, at most this many at a time per core
+// so RPC threads are left for actual queries
+#define MAX_VERIFICATIONS_PER_THREAD 0.5
+
 namespace cryptonote
 {
   rpc_payment::client_info::client_info():
@@ -85,7 +90,9 @@ namespace cryptonote
     m_nonces_good(0),
     m_nonces_stale(0),
     m_nonces_bad(0),
-    m_nonces_dupe(0)
+    m_nonces_dupe(0),
+    m_verifications(0),
+    m_max_verifications(std::max<unsigned>(1, tools::get_max_concurrency() * MAX_VERIFICATIONS_PER_THREAD))
   {
   }
 
@@ -182,61 +189,79 @@ namespace cryptonote
 
   bool rpc_payment::submit_nonce(const crypto::public_key &client, uint32_t nonce, const crypto::hash &top, int64_t &error_code, std::string &error_message, uint64_t &credits, crypto::hash &hash, cryptonote::block &block, uint32_t cookie, bool &stale)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    client_info &info = m_client_info[client]; // creates if not found
-    if (cookie != info.cookie && cookie != info.cookie - 1)
-    {
-      MWARNING("Very stale nonce");
-      ++m_nonces_stale;
-      ++info.nonces_stale;
-      sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
-      error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
-      error_message = "Very stale payment";
-      return false;
-    }
-    const bool is_current = cookie == info.cookie;
-    MINFO("client " << client << " sends nonce: " << nonce << ", " << (is_current ? "current" : "stale"));
-    std::unordered_set<uint64_t> &payments = is_current ? info.payments : info.previous_payments;
-    if (!payments.insert(nonce).second)
+    // a busy node turns payments away rather than spend all its RPC threads hashing
+    if (++m_verifications > m_max_verifications)
     {
-      MWARNING("Duplicate nonce " << nonce << " from " << (is_current ? "current" : "previous"));
-      ++m_nonces_dupe;
-      ++info.nonces_dupe;
-      sub64clamp(&info.credits, PENALTY_FOR_DUPLICATE * m_credits_per_hash_found);
-      error_code = CORE_RPC_ERROR_CODE_DUPLICATE_PAYMENT;
-      error_message = "Duplicate payment";
+      --m_verifications;
+      error_code = CORE_RPC_ERROR_CODE_CORE_BUSY;
+      error_message = "Too many payments being verified, try again later";
       return false;
     }
+    auto verifications = epee::misc_utils::create_scope_leave_handler([this](){ --m_verifications; });
 
-    const uint64_t now = time(NULL);
-    if (!is_current)
+    // stale and duplicate nonces are rejected, and this one reserved, before
+    // hashing, which is done without holding the lock
+    bool is_current;
+    cryptonote::blobdata hashing_blob;
+    crypto::hash seed_hash;
     {
-      if (now > info.update_time + STALE_THRESHOLD)
+      boost::lock_guard<boost::mutex> lock(mutex);
+      client_info &info = m_client_info[client]; // creates if not found
+      if (cookie != info.cookie && cookie != info.cookie - 1)
       {
-        MWARNING("Nonce is stale (top " << top << ", should be " << info.top << " or within " << STALE_THRESHOLD << " seconds");
+        MWARNING("Very stale nonce");
         ++m_nonces_stale;
         ++info.nonces_stale;
         sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
         error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
-        error_message = "stale payment";
+        error_message = "Very stale payment";
+        return false;
+      }
+      is_current = cookie == info.cookie;
+      MINFO("client " << client << " sends nonce: " << nonce << ", " << (is_current ? "current" : "stale"));
+      std::unordered_set<uint64_t> &payments = is_current ? info.payments : info.previous_payments;
+      if (!payments.insert(nonce).second)
+      {
+        MWARNING("Duplicate nonce " << nonce << " from " << (is_current ? "current" : "previous"));
+        ++m_nonces_dupe;
+        ++info.nonces_dupe;
+        sub64clamp(&info.credits, PENALTY_FOR_DUPLICATE * m_credits_per_hash_found);
+        error_code = CORE_RPC_ERROR_CODE_DUPLICATE_PAYMENT;
+        error_message = "Duplicate payment";
         return false;
       }
-    }
 
-    cryptonote::blobdata hashing_blob = is_current ? info.hashing_blob : info.previous_hashing_blob;
-    if (hashing_blob.size() < 43)
-    {
-      // not initialized ?
-      error_code = CORE_RPC_ERROR_CODE_WRONG_BLOCKBLOB;
-      error_message = "not initialized";
-      return false;
+      const uint64_t now = time(NULL);
+      if (!is_current)
+      {
+        if (now > info.update_time + STALE_THRESHOLD)
+        {
+          MWARNING("Nonce is stale (top " << top << ", should be " << info.top << " or within " << STALE_THRESHOLD << " seconds");
+          ++m_nonces_stale;
+          ++info.nonces_stale;
+          sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
+          error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
+          error_message = "stale payment";
+          return false;
+        }
+      }
+
+      hashing_blob = is_current ? info.hashing_blob : info.previous_hashing_blob;
+      if (hashing_blob.size() < 43)
+      {
+        // not initialized ?
+        error_code = CORE_RPC_ERROR_CODE_WRONG_BLOCKBLOB;
+        error_message = "not initialized";
+        return false;
+      }
+
+      block = is_current ? info.block : info.previous_block;
+      seed_hash = is_current ? info.seed_hash : info.previous_seed_hash;
     }
 
-    block = is_current ? info.block : info.previous_block;
     *(uint32_t*)(hashing_blob.data() + 39) = SWAP32LE(nonce);
     if (block.major_version >= RX_BLOCK_VERSION)
     {
-      const crypto::hash &seed_hash = is_current ? info.seed_hash : info.previous_seed_hash;
       crypto::rx_slow_hash(seed_hash.data, hashing_blob.data(), hashing_blob.size(), hash.data);
     }
     else
@@ -244,7 +269,12 @@ namespace cryptonote
       const int cn_variant = hashing_blob[0] >= 7 ? hashing_blob[0] - 6 : 0;
       crypto::cn_slow_hash(hashing_blob.data(), hashing_blob.size(), hash, cn_variant, cryptonote::get_block_height(block));
     }
-    if (!check_hash(hash, m_diff))
+    const bool good = check_hash(hash, m_diff);
+
+    // the client's entry may have been updated while we were hashing
+    boost::lock_guard<boost::mutex> lock(mutex);
+    client_info &info = m_client_info[client];
+    if (!good)
     {
       MWARNING("Payment too low");
       ++m_nonces_bad;
@@ -258,7 +288,7 @@ namespace cryptonote
     add64clamp(&info.credits, m_credits_per_hash_found);
     MINFO("client " << client << " credited for " << m_credits_per_hash_found << ", now " << info.credits << (is_current ? "" : " (close)"));
 
-    m_hashrate[now] += m_diff;
+    m_hashrate[time(NULL)] += m_diff;
     add64clamp(&m_credits_total, m_credits_per_hash_found);
     add64clamp(&info.credits_total, m_credits_per_hash_found);
     ++m_nonces_good;
@@ -28,6 +28,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
@@ -186,6 +187,8 @@ namespace cryptonote
     uint64_t m_nonces_stale;
     uint64_t m_nonces_bad;
     uint64_t m_nonces_dupe;
+    std::atomic<unsigned> m_verifications;
+    const unsigned m_max_verifications;
     mutable boost::mutex mutex;
   };
 }
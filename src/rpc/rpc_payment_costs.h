@@ -34,6 +34,8 @@
 #define COST_PER_OUTPUT_INDEXES 1
 #define COST_PER_TX 0.5
 #define COST_PER_KEY_IMAGE 0.01
+#define COST_PER_OUTPUT_PUBKEY 0.01
+#define COST_PER_BLOCK_VIEW_TAGS 0.01
 #define COST_PER_POOL_HASH 0.01
 #define COST_PER_TX_POOL_STATS 0.2
 #define COST_PER_BLOCK_HEADER 0.1
@@ -45,6 +47,7 @@
 #define COST_PER_COINBASE_TX_SUM_BLOCK 2
 #define COST_PER_BLOCK_HASH 0.002
 #define COST_PER_FEE_ESTIMATE 1
+#define COST_PER_FEE_QUANTILES 1
 #define COST_PER_SYNC_INFO 2
 #define COST_PER_HARD_FORK_INFO 1
 #define COST_PER_PEER_LIST 2
@@ -0,0 +1,136 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace cryptonote
+{
+namespace rpc
+{
+  struct request_gate_stats
+  {
+    uint64_t admitted;
+    uint64_t shed;
+    std::size_t running;
+    std::size_t queued;
+  };
+
+  /*! Bounds how many requests of one class run at once. Requests over the
+   *  limit wait in a bounded queue for a slot and are shed once the queue is
+   *  full, or when no slot frees up within max_wait, so a burst of expensive
+   *  calls cannot take over every RPC thread.
+   */
+  class request_gate
+  {
+  public:
+    //! Holds a slot for as long as it lives, evaluates to false if the request was shed
+    class ticket
+    {
+    public:
+      ticket(ticket &&other) noexcept : m_gate(other.m_gate) { other.m_gate = nullptr; }
+      ticket(const ticket&) = delete;
+      ticket &operator=(const ticket&) = delete;
+      ~ticket() { if (m_gate) m_gate->leave(); }
+
+      explicit operator bool() const noexcept { return m_gate != nullptr; }
+
+    private:
+      friend class request_gate;
+      explicit ticket(request_gate *gate) noexcept : m_gate(gate) {}
+      request_gate *m_gate;
+    };
+
+    request_gate(std::size_t max_running, std::size_t max_queued, std::chrono::milliseconds max_wait)
+      : m_max_running(max_running), m_max_queued(max_queued), m_max_wait(max_wait), m_running(0), m_queued(0), m_admitted(0), m_shed(0)
+    {}
+
+    void set_limits(std::size_t max_running, std::size_t max_queued)
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      m_max_running = max_running;
+      m_max_queued = max_queued;
+      m_slot_freed.notify_all();
+    }
+
+    ticket enter()
+    {
+      boost::unique_lock<boost::mutex> lock{m_mutex};
+      if (m_running >= m_max_running)
+      {
+        if (m_queued >= m_max_queued)
+        {
+          ++m_shed;
+          return ticket{nullptr};
+        }
+        ++m_queued;
+        const bool got_slot = m_slot_freed.wait_for(lock, boost::chrono::milliseconds(m_max_wait.count()), [this]{ return m_running < m_max_running; });
+        --m_queued;
+        if (!got_slot)
+        {
+          ++m_shed;
+          return ticket{nullptr};
+        }
+      }
+      ++m_running;
+      ++m_admitted;
+      return ticket{this};
+    }
+
+    request_gate_stats get_stats() const
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      return {m_admitted, m_shed, m_running, m_queued};
+    }
+
+  private:
+    void leave()
+    {
+      const boost::lock_guard<boost::mutex> lock{m_mutex};
+      --m_running;
+      m_slot_freed.notify_one();
+    }
+
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_slot_freed;
+    std::size_t m_max_running;
+    std::size_t m_max_queued;
+    const std::chrono::milliseconds m_max_wait;
+    std::size_t m_running;
+    std::size_t m_queued;
+    uint64_t m_admitted;
+    uint64_t m_shed;
+  };
+}
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rpc_request_recorder.h"
+
+#include <cmath>
+#include "misc_log_ex.h"
+#include "string_tools.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
+
+namespace cryptonote
+{
+namespace rpc
+{
+  bool request_recorder::open(const std::string &path, double sample_rate)
+  {
+    if (!(sample_rate > 0 && sample_rate <= 1))
+    {
+      MERROR("RPC request sample rate must be in (0, 1], got " << sample_rate);
+      return false;
+    }
+    m_file.open(path, std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+    if (!m_file.good())
+    {
+      MERROR("Failed to open RPC request record file " << path);
+      return false;
+    }
+    m_sample_rate = sample_rate;
+    MINFO("Recording " << sample_rate * 100 << "% of RPC requests to " << path);
+    return true;
+  }
+
+  void request_recorder::record(const std::string &method, const std::string &uri, uint64_t handling_us, const std::string &body)
+  {
+    if (!enabled())
+      return;
+    // record the nth request whenever n * rate crosses an integer
+    const uint64_t n = m_seen++;
+    if (std::floor((n + 1) * m_sample_rate) == std::floor(n * m_sample_rate))
+      return;
+    const std::string hex = epee::string_tools::buff_to_hex_nodelimer(body);
+    const boost::lock_guard<boost::mutex> lock{m_mutex};
+    m_file << method << ' ' << uri << ' ' << handling_us << ' ' << (hex.empty() ? "-" : hex) << '\n';
+    m_file.flush();
+  }
+}
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include "byte_slice.h"
+#include "storages/portable_storage_template_helper.h"
+
+#define RPC_RESPONSE_CACHE_MAX_ENTRIES 256
+
+namespace cryptonote
+{
+namespace rpc
+{
+  //! The state of the chain and txpool a cached response was computed from
+  struct response_cache_tag
+  {
+    uint64_t chain; //!< bumped on each new block
+    uint64_t height; //!< catches blocks being popped, which are not notified
+    uint64_t pool; //!< txpool cookie, 0 for responses which do not depend on it
+
+    bool operator==(const response_cache_tag &other) const noexcept
+    {
+      return chain == other.chain && height == other.height && pool == other.pool;
+    }
+  };
+
+  struct response_cache_stats
+  {
+    std::string name;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+  };
+
+  /*! Caches the responses of one RPC command, keyed by the request serialized
+   *  to epee binary, so equal requests share an entry whatever their JSON
+   *  layout. An entry is good for as long as the tag it was stored with
+   *  matches, and optionally no longer than max_age. Responses are kept as
+   *  objects rather than serialized: a JSON-RPC reply embeds the id of the
+   *  request it answers.
+   */
+  template<typename t_command>
+  class response_cache
+  {
+  public:
+    typedef typename t_command::request request;
+    typedef typename t_command::response response;
+
+    explicit response_cache(std::string name, std::chrono::steady_clock::duration max_age = std::chrono::steady_clock::duration::zero())
+      : m_name(std::move(name)), m_max_age(max_age), m_hits(0), m_misses(0)
+    {}
+
+    static std::string get_key(const request &req)
+    {
+      epee::byte_slice blob;
+      if (!epee::serialization::store_t_to_binary(req, blob))
+        return {};
+      return std::string(reinterpret_cast<const char*>(blob.data()), blob.size());
+    }
+
+    //! \return True if res was filled from a response cached for key and tag
+    bool get(const std::string &key, const response_cache_tag &tag, response &res)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      const auto it = key.empty() ? m_entries.end() : m_entries.find(key);
+      if (it == m_entries.end() || !is_fresh(it->second, tag, now))
+      {
+        ++m_misses;
+        return false;
+      }
+      ++m_hits;
+      res = it->second.res;
+      return true;
+    }
+
+    void put(std::string key, const response_cache_tag &tag, const response &res)
+    {
+      if (key.empty())
+        return;
+      const auto now = std::chrono::steady_clock::now();
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      if (m_entries.size() >= RPC_RESPONSE_CACHE_MAX_ENTRIES && !m_entries.count(key))
+      {
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+          if (is_fresh(it->second, tag, now))
+            ++it;
+          else
+            it = m_entries.erase(it);
+        }
+        if (m_entries.size() >= RPC_RESPONSE_CACHE_MAX_ENTRIES)
+          m_entries.clear();
+      }
+      entry &e = m_entries[std::move(key)];
+      e.tag = tag;
+      e.time = now;
+      e.res = res;
+    }
+
+    response_cache_stats get_stats() const
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      return {m_name, m_hits, m_misses, m_entries.size()};
+    }
+
+  private:
+    struct entry
+    {
+      response_cache_tag tag;
+      std::chrono::steady_clock::time_point time;
+      response res;
+    };
+
+    bool is_fresh(const entry &e, const response_cache_tag &tag, std::chrono::steady_clock::time_point now) const
+    {
+      return e.tag == tag && (m_max_age == std::chrono::steady_clock::duration::zero() || now - e.time < m_max_age);
+    }
+
+    const std::string m_name;
+    const std::chrono::steady_clock::duration m_max_age;
+    mutable boost::mutex m_lock;
+    std::unordered_map<std::string, entry> m_entries;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
+}
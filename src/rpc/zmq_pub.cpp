@@ -48,7 +48,10 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/events.h"
 #include "misc_log_ex.h"
+#include "string_tools.h"
 #include "serialization/json_object.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_bin_writer.h"
 #include "ringct/rctTypes.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 
@@ -58,10 +61,17 @@
 namespace
 {
   constexpr const char txpool_signal[] = "tx_signal";
+  constexpr const char replay_prefix[] = "replay:";
+
+  //! Number of most recent main chain blocks kept for replay requests
+  constexpr const std::size_t chain_history_max = 100;
+  //! Number of most recent txpool transactions kept for replay requests
+  constexpr const std::size_t txpool_history_max = 1000;
 
   using chain_writer =  void(epee::byte_stream&, std::uint64_t, epee::span<const cryptonote::block>);
   using miner_writer =  void(epee::byte_stream&, uint8_t, uint64_t, const crypto::hash&, const crypto::hash&, cryptonote::difficulty_type, uint64_t, uint64_t, const std::vector<cryptonote::tx_block_template_backlog_entry>&);
-  using txpool_writer = void(epee::byte_stream&, epee::span<const cryptonote::txpool_event>);
+  using txpool_writer = void(epee::byte_stream&, std::uint64_t, epee::span<const cryptonote::txpool_event>);
+  using template_writer = void(epee::byte_stream&, const cryptonote::block_template_event&);
 
   template<typename F>
   struct context
@@ -178,6 +188,22 @@ namespace
     dest.EndObject();
   }
 
+  void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const cryptonote::block_template_event& self)
+  {
+    dest.StartObject();
+    INSERT_INTO_JSON_OBJECT(dest, blocktemplate_blob, epee::string_tools::buff_to_hex_nodelimer(self.blocktemplate_blob));
+    INSERT_INTO_JSON_OBJECT(dest, blockhashing_blob, epee::string_tools::buff_to_hex_nodelimer(self.blockhashing_blob));
+    INSERT_INTO_JSON_OBJECT(dest, reserved_offset, self.reserved_offset);
+    INSERT_INTO_JSON_OBJECT(dest, height, self.height);
+    INSERT_INTO_JSON_OBJECT(dest, expected_reward, self.expected_reward);
+    INSERT_INTO_JSON_OBJECT(dest, difficulty, cryptonote::hex(self.difficulty));
+    INSERT_INTO_JSON_OBJECT(dest, prev_hash, self.prev_id);
+    INSERT_INTO_JSON_OBJECT(dest, seed_height, self.seed_height);
+    INSERT_INTO_JSON_OBJECT(dest, seed_hash, self.seed_hash);
+    INSERT_INTO_JSON_OBJECT(dest, next_seed_hash, self.next_seed_hash);
+    dest.EndObject();
+  }
+
   void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const minimal_txpool& self)
   {
     dest.StartObject();
@@ -188,6 +214,110 @@ namespace
     dest.EndObject();
   }
 
+  //! Object for "bin-full" block serialization, blocks are cryptonote blobs
+  struct bin_chain
+  {
+    std::uint64_t first_height;
+    std::vector<cryptonote::blobdata> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(first_height)
+      KV_SERIALIZE(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Object for one "bin-full" tx, the tx is a cryptonote blob
+  struct bin_txpool_entry
+  {
+    crypto::hash id;
+    cryptonote::blobdata blob;
+    std::uint64_t weight;
+    std::uint64_t fee;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB(id)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(weight)
+      KV_SERIALIZE(fee)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_txpool
+  {
+    std::uint64_t sequence;
+    std::vector<bin_txpool_entry> txes;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(sequence)
+      KV_SERIALIZE(txes)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Object for "bin-full" block template serialization, blobs are cryptonote blobs
+  struct bin_block_template
+  {
+    cryptonote::blobdata blocktemplate_blob;
+    cryptonote::blobdata blockhashing_blob;
+    std::uint64_t reserved_offset;
+    std::uint64_t height;
+    std::uint64_t expected_reward;
+    std::string difficulty;
+    crypto::hash prev_hash;
+    std::uint64_t seed_height;
+    crypto::hash seed_hash;
+    crypto::hash next_seed_hash;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocktemplate_blob)
+      KV_SERIALIZE(blockhashing_blob)
+      KV_SERIALIZE(reserved_offset)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(expected_reward)
+      KV_SERIALIZE(difficulty)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(prev_hash)
+      KV_SERIALIZE(seed_height)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(seed_hash)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(next_seed_hash)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! \return `name:...` where `...` is epee binary, for consumers that would rather not parse JSON
+  template<typename T>
+  void bin_pub(epee::byte_stream& buf, const T& value)
+  {
+    if (!epee::serialization::write_t_to_binary(value, buf))
+      MERROR("ZMQ/Pub failure: write_t_to_binary");
+  }
+
+  void bin_full_chain(epee::byte_stream& buf, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
+  {
+    bin_chain chain{height, {}};
+    chain.blocks.reserve(blocks.size());
+    for (const cryptonote::block& bl : blocks)
+      chain.blocks.push_back(cryptonote::block_to_blob(bl));
+    bin_pub(buf, chain);
+  }
+
+  void bin_full_txpool(epee::byte_stream& buf, const std::uint64_t sequence, epee::span<const cryptonote::txpool_event> txes)
+  {
+    bin_txpool pool{sequence, {}};
+    pool.txes.reserve(txes.size());
+    for (const cryptonote::txpool_event& event : txes)
+    {
+      if (is_valid{}(event))
+        pool.txes.push_back({event.hash, cryptonote::tx_to_blob(event.tx), event.weight, cryptonote::get_tx_fee(event.tx)});
+    }
+    bin_pub(buf, pool);
+  }
+
+  void bin_full_block_template(epee::byte_stream& buf, const cryptonote::block_template_event& event)
+  {
+    bin_pub(buf, bin_block_template{
+      event.blocktemplate_blob, event.blockhashing_blob, event.reserved_offset, event.height, event.expected_reward,
+      cryptonote::hex(event.difficulty), event.prev_id, event.seed_height, event.seed_hash, event.next_seed_hash
+    });
+  }
+
   void json_full_chain(epee::byte_stream& buf, const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
   {
     json_pub(buf, blocks);
@@ -203,10 +333,15 @@ namespace
     json_pub(buf, miner_data{major_version, height, prev_id, seed_hash, diff, median_weight, already_generated_coins, tx_backlog});
   }
 
+  void json_full_block_template(epee::byte_stream& buf, const cryptonote::block_template_event& event)
+  {
+    json_pub(buf, event);
+  }
+
   // boost::adaptors are in place "views" - no copy/move takes place
   // moving transactions (via sort, etc.), is expensive!
 
-  void json_full_txpool(epee::byte_stream& buf, epee::span<const cryptonote::txpool_event> txes)
+  void json_full_txpool(epee::byte_stream& buf, std::uint64_t, epee::span<const cryptonote::txpool_event> txes)
   {
     namespace adapt = boost::adaptors;
     const auto to_full_tx = [](const cryptonote::txpool_event& event)
@@ -216,7 +351,7 @@ namespace
     json_pub(buf, (txes | adapt::filtered(is_valid{}) | adapt::transformed(to_full_tx)));
   }
 
-  void json_minimal_txpool(epee::byte_stream& buf, epee::span<const cryptonote::txpool_event> txes)
+  void json_minimal_txpool(epee::byte_stream& buf, std::uint64_t, epee::span<const cryptonote::txpool_event> txes)
   {
     namespace adapt = boost::adaptors;
     const auto to_minimal_tx = [](const cryptonote::txpool_event& event)
@@ -226,8 +361,9 @@ namespace
     json_pub(buf, (txes | adapt::filtered(is_valid{}) | adapt::transformed(to_minimal_tx)));
   }
 
-  constexpr const std::array<context<chain_writer>, 2> chain_contexts =
+  constexpr const std::array<context<chain_writer>, 3> chain_contexts =
   {{
+    {u8"bin-full-chain_main", bin_full_chain},
     {u8"json-full-chain_main", json_full_chain},
     {u8"json-minimal-chain_main", json_minimal_chain}
   }};
@@ -237,12 +373,19 @@ namespace
     {u8"json-full-miner_data", json_miner_data},
   }};
 
-  constexpr const std::array<context<txpool_writer>, 2> txpool_contexts =
+  constexpr const std::array<context<txpool_writer>, 3> txpool_contexts =
   {{
+    {u8"bin-full-txpool_add", bin_full_txpool},
     {u8"json-full-txpool_add", json_full_txpool},
     {u8"json-minimal-txpool_add", json_minimal_txpool}
   }};
 
+  constexpr const std::array<context<template_writer>, 2> template_contexts =
+  {{
+    {u8"bin-full-block_template", bin_full_block_template},
+    {u8"json-full-block_template", json_full_block_template}
+  }};
+
   template<typename T, std::size_t N>
   epee::span<const context<T>> get_range(const std::array<context<T>, N>& contexts, const boost::string_ref value)
   {
@@ -256,6 +399,17 @@ namespace
     return {lower, std::size_t(upper - lower)};
   }
 
+  template<typename T, std::size_t N>
+  std::size_t find_context(const std::array<context<T>, N>& contexts, const boost::string_ref name) noexcept
+  {
+    for (std::size_t i = 0; i < N; ++i)
+    {
+      if (name == contexts[i].name)
+        return i;
+    }
+    return N;
+  }
+
   template<std::size_t N, typename T>
   void add_subscriptions(std::array<std::size_t, N>& subs, const epee::span<const context<T>> range, context<T> const* const first)
   {
@@ -362,6 +516,12 @@ zmq_pub::zmq_pub(void* context)
     chain_subs_{{0}},
     miner_subs_{{0}},
     txpool_subs_{{0}},
+    template_subs_{{0}},
+    chain_history_(),
+    chain_history_height_(0),
+    txpool_history_(),
+    txpool_history_count_(0),
+    txpool_sequence_(0),
     sync_()
 {
   if (!context)
@@ -370,6 +530,7 @@ zmq_pub::zmq_pub(void* context)
   verify_sorted(chain_contexts, "chain_contexts");
   verify_sorted(miner_contexts, "miner_contexts");
   verify_sorted(txpool_contexts, "txpool_contexts");
+  verify_sorted(template_contexts, "template_contexts");
 
   relay_.reset(zmq_socket(context, ZMQ_PAIR));
   if (!relay_)
@@ -388,14 +549,25 @@ bool zmq_pub::sub_request(boost::string_ref message)
     const char tag = message[0];
     message.remove_prefix(1);
 
+    if (message.starts_with(replay_prefix))
+    {
+      // the subscription itself never matches a published message
+      message.remove_prefix(sizeof(replay_prefix) - 1);
+      if (tag != 1)
+        return tag == 0;
+      return replay_request(message);
+    }
+
     const auto chain_range = get_range(chain_contexts, message);
     const auto miner_range = get_range(miner_contexts, message);
     const auto txpool_range = get_range(txpool_contexts, message);
+    const auto template_range = get_range(template_contexts, message);
 
-    if (!chain_range.empty() || !miner_range.empty() || !txpool_range.empty())
+    if (!chain_range.empty() || !miner_range.empty() || !txpool_range.empty() || !template_range.empty())
     {
       MDEBUG("Client " << (tag ? "subscribed" : "unsubscribed") << " to " <<
-             chain_range.size() << " chain topic(s), " << miner_range.size() << " miner topic(s) and " << txpool_range.size() << " txpool topic(s)");
+             chain_range.size() << " chain topic(s), " << miner_range.size() << " miner topic(s), " << txpool_range.size() << " txpool topic(s) and " <<
+             template_range.size() << " block template topic(s)");
 
       const boost::lock_guard<boost::mutex> lock{sync_};
       switch (tag)
@@ -404,11 +576,13 @@ bool zmq_pub::sub_request(boost::string_ref message)
         remove_subscriptions(chain_subs_, chain_range, chain_contexts.begin());
         remove_subscriptions(miner_subs_, miner_range, miner_contexts.begin());
         remove_subscriptions(txpool_subs_, txpool_range, txpool_contexts.begin());
+        remove_subscriptions(template_subs_, template_range, template_contexts.begin());
         return true;
       case 1:
         add_subscriptions(chain_subs_, chain_range, chain_contexts.begin());
         add_subscriptions(miner_subs_, miner_range, miner_contexts.begin());
         add_subscriptions(txpool_subs_, txpool_range, txpool_contexts.begin());
+        add_subscriptions(template_subs_, template_range, template_contexts.begin());
         return true;
       default:
         break;
@@ -430,20 +604,23 @@ bool zmq_pub::relay_to_pub(void* const relay, void* const pub)
 
   if (!*relayed)
   {
-    std::array<std::size_t, 2> subs;
-    std::vector<cryptonote::txpool_event> events;
+    decltype(txpool_subs_) subs;
+    txpool_batch batch{};
     {
       const boost::lock_guard<boost::mutex> lock{sync_};
       if (txes_.empty())
         return false;
 
       subs = txpool_subs_;
-      events = std::move(txes_.front());
+      batch = std::move(txes_.front());
       txes_.pop_front();
     }
-    auto messages = make_pubs(subs, txpool_contexts, epee::to_span(events));
+    auto messages = make_pubs(subs, txpool_contexts, batch.sequence, epee::to_span(batch.events));
     send_messages(pub, messages);
     MDEBUG("Sent txpool ZMQ/Pub");
+
+    const boost::lock_guard<boost::mutex> lock{sync_};
+    add_txpool_history(std::move(batch));
   }
   else
     MDEBUG("Sent chain_main ZMQ/Pub");
@@ -451,6 +628,103 @@ bool zmq_pub::relay_to_pub(void* const relay, void* const pub)
   return true;
 }
 
+void zmq_pub::add_chain_history(const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
+{
+  // a notification below the tip is a reorg, replace the blocks it popped
+  if (height < chain_history_height_ || chain_history_height_ + chain_history_.size() < height)
+  {
+    chain_history_.clear();
+    chain_history_height_ = height;
+  }
+  chain_history_.resize(height - chain_history_height_);
+  chain_history_.insert(chain_history_.end(), blocks.begin(), blocks.end());
+
+  if (chain_history_max < chain_history_.size())
+  {
+    const std::size_t excess = chain_history_.size() - chain_history_max;
+    chain_history_.erase(chain_history_.begin(), chain_history_.begin() + excess);
+    chain_history_height_ += excess;
+  }
+}
+
+void zmq_pub::add_txpool_history(txpool_batch batch)
+{
+  txpool_history_count_ += batch.events.size();
+  txpool_history_.push_back(std::move(batch));
+  while (txpool_history_max < txpool_history_count_ && 1 < txpool_history_.size())
+  {
+    txpool_history_count_ -= txpool_history_.front().events.size();
+    txpool_history_.pop_front();
+  }
+}
+
+bool zmq_pub::replay_request(const boost::string_ref message)
+{
+  const std::size_t split = message.rfind(':');
+  std::uint64_t start = 0;
+  if (split == boost::string_ref::npos || !epee::string_tools::get_xtype_from_string(start, std::string{message.substr(split + 1)}))
+  {
+    MERROR("Invalid ZMQ/Sub replay request");
+    return false;
+  }
+
+  const boost::string_ref topic = message.substr(0, split);
+  const std::size_t chain_index = find_context(chain_contexts, topic);
+  const std::size_t txpool_index = find_context(txpool_contexts, topic);
+
+  std::size_t sent = 0;
+  if (chain_index < chain_contexts.size())
+  {
+    std::uint64_t height = 0;
+    std::vector<cryptonote::block> blocks;
+    {
+      const boost::lock_guard<boost::mutex> lock{sync_};
+      height = std::max(start, chain_history_height_);
+      const std::uint64_t end = chain_history_height_ + chain_history_.size();
+      if (height < end)
+        blocks.assign(chain_history_.begin() + (height - chain_history_height_), chain_history_.end());
+    }
+
+    if (!blocks.empty())
+    {
+      decltype(chain_subs_) subs{{}};
+      subs[chain_index] = 1;
+      auto messages = make_pubs(subs, chain_contexts, height, epee::to_span(blocks));
+      const boost::lock_guard<boost::mutex> lock{sync_};
+      sent = send_messages(relay_.get(), messages);
+    }
+  }
+  else if (txpool_index < txpool_contexts.size())
+  {
+    std::vector<txpool_batch> batches;
+    {
+      const boost::lock_guard<boost::mutex> lock{sync_};
+      for (const txpool_batch& batch : txpool_history_)
+      {
+        if (start <= batch.sequence)
+          batches.push_back(batch);
+      }
+    }
+
+    decltype(txpool_subs_) subs{{}};
+    subs[txpool_index] = 1;
+    for (const txpool_batch& batch : batches)
+    {
+      auto messages = make_pubs(subs, txpool_contexts, batch.sequence, epee::to_span(batch.events));
+      const boost::lock_guard<boost::mutex> lock{sync_};
+      sent += send_messages(relay_.get(), messages);
+    }
+  }
+  else
+  {
+    MERROR("Invalid ZMQ/Sub replay topic");
+    return false;
+  }
+
+  MDEBUG("Replaying " << sent << " ZMQ/Pub message(s) for " << topic << " from " << start);
+  return true;
+}
+
 std::size_t zmq_pub::send_chain_main(const std::uint64_t height, const epee::span<const cryptonote::block> blocks)
 {
   if (blocks.empty())
@@ -461,6 +735,7 @@ std::size_t zmq_pub::send_chain_main(const std::uint64_t height, const epee::spa
 
   boost::unique_lock<boost::mutex> guard{sync_};
 
+  add_chain_history(height, blocks);
   const auto subs_copy = chain_subs_;
   guard.unlock();
 
@@ -499,24 +774,50 @@ std::size_t zmq_pub::send_miner_data(uint8_t major_version, uint64_t height, con
   return 0;
 }
 
+std::size_t zmq_pub::send_block_template(const block_template_event& event)
+{
+  boost::unique_lock<boost::mutex> guard{sync_};
+
+  const auto subs_copy = template_subs_;
+  guard.unlock();
+
+  for (const std::size_t sub : subs_copy)
+  {
+    if (sub)
+    {
+        auto messages = make_pubs(subs_copy, template_contexts, event);
+        guard.lock();
+        return send_messages(relay_.get(), messages);
+    }
+  }
+  return 0;
+}
+
 std::size_t zmq_pub::send_txpool_add(std::vector<txpool_event> txes)
 {
   if (txes.empty())
     return 0;
 
   const boost::lock_guard<boost::mutex> lock{sync_};
+  txpool_batch batch{++txpool_sequence_, std::move(txes)};
   for (const std::size_t sub : txpool_subs_)
   {
     if (sub)
     {
       const expect<void> sent = net::zmq::retry_op(zmq_send_const, relay_.get(), txpool_signal, sizeof(txpool_signal) - 1, ZMQ_DONTWAIT);
       if (sent)
-        txes_.emplace_back(std::move(txes));
+        txes_.emplace_back(std::move(batch));
       else
+      {
         MERROR("ZMQ/Pub failure, relay queue error: " << sent.error().message());
+        add_txpool_history(std::move(batch));
+      }
       return bool(sent);
     }
   }
+
+  // nobody is listening, but a reconnecting subscriber can still replay it
+  add_txpool_history(std::move(batch));
   return 0;
 }
 
@@ -538,6 +839,15 @@ void zmq_pub::miner_data::operator()(uint8_t major_version, uint64_t height, con
     MERROR("Unable to send ZMQ/Pub - ZMQ server destroyed");
 }
 
+void zmq_pub::block_template::operator()(const block_template_event& event) const
+{
+  const std::shared_ptr<zmq_pub> self = self_.lock();
+  if (self)
+    self->send_block_template(event);
+  else
+    MERROR("Unable to send ZMQ/Pub - ZMQ server destroyed");
+}
+
 void zmq_pub::txpool_add::operator()(std::vector<cryptonote::txpool_event> txes) const
 {
   const std::shared_ptr<zmq_pub> self = self_.lock();
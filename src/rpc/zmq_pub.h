@@ -51,19 +51,48 @@ namespace cryptonote { namespace listener
     order. An external lock **must** be held by clients during the entire
     txpool check and notification sequence and (a possibly second) lock is held
     during the entire block check and notification sequence. Otherwise, events
-    could be sent in a different order than processed. */
+    could be sent in a different order than processed.
+
+    The most recent blocks and txpool additions are kept so that a subscriber
+    that reconnects can catch up. Subscribing to `replay:<topic>:<start>`
+    publishes the history from block height (chain topics) or txpool sequence
+    number (txpool topics) `<start>` again on `<topic>`, to every subscriber of
+    that topic. The `bin-full` topics carry the height or sequence number; the
+    replay subscription must be removed before it can be sent again. */
 class zmq_pub
 {
   /* Each socket has its own internal queue. So we can only use one socket, else
      the messages being published are not guaranteed to be in the same order
      pushed. */
 
+    //! Txpool events from one notification, with their sequence number
+    struct txpool_batch
+    {
+      std::uint64_t sequence;
+      std::vector<txpool_event> events;
+    };
+
     net::zmq::socket relay_;
-    std::deque<std::vector<txpool_event>> txes_;
-    std::array<std::size_t, 2> chain_subs_;
+    std::deque<txpool_batch> txes_;
+    std::array<std::size_t, 3> chain_subs_;
     std::array<std::size_t, 1> miner_subs_;
-    std::array<std::size_t, 2> txpool_subs_;
-    boost::mutex sync_; //!< Synchronizes counts in `*_subs_` arrays.
+    std::array<std::size_t, 3> txpool_subs_;
+    std::array<std::size_t, 2> template_subs_;
+    std::vector<cryptonote::block> chain_history_;
+    std::uint64_t chain_history_height_; //!< Height of `chain_history_.front()`
+    std::deque<txpool_batch> txpool_history_;
+    std::size_t txpool_history_count_; //!< Total events in `txpool_history_`
+    std::uint64_t txpool_sequence_; //!< Last sequence number given to a txpool batch
+    boost::mutex sync_; //!< Synchronizes counts in `*_subs_` arrays, history and sequence.
+
+    //! Record `blocks` starting at `height`, dropping any blocks they replace. `sync_` must be held.
+    void add_chain_history(std::uint64_t height, epee::span<const cryptonote::block> blocks);
+
+    //! Record `batch`, dropping the oldest batches over the limit. `sync_` must be held.
+    void add_txpool_history(txpool_batch batch);
+
+    //! Re-publish history for `<topic>:<start>` through the relay socket.
+    bool replay_request(boost::string_ref message);
 
   public:
     //! \return Name of ZMQ_PAIR endpoint for pub notifications
@@ -96,6 +125,11 @@ class zmq_pub
         \return Number of ZMQ messages sent to relay. */
     std::size_t send_miner_data(uint8_t major_version, uint64_t height, const crypto::hash& prev_id, const crypto::hash& seed_hash, difficulty_type diff, uint64_t median_weight, uint64_t already_generated_coins, const std::vector<tx_block_template_backlog_entry>& tx_backlog);
 
+    /*! Send a `ZMQ_PUB` notification for a new block template, built by core
+        for a pool address. Thread-safe.
+        \return Number of ZMQ messages sent to relay. */
+    std::size_t send_block_template(const block_template_event& event);
+
     /*! Send a `ZMQ_PUB` notification for new tx(es) being added to the local
         pool. Thread-safe.
         \return Number of ZMQ messages sent to relay. */
@@ -115,6 +149,13 @@ class zmq_pub
       void operator()(uint8_t major_version, uint64_t height, const crypto::hash& prev_id, const crypto::hash& seed_hash, difficulty_type diff, uint64_t median_weight, uint64_t already_generated_coins, const std::vector<tx_block_template_backlog_entry>& tx_backlog) const;
     };
 
+    //! Callable for `send_block_template` with weak ownership to `zmq_pub` object.
+    struct block_template
+    {
+      std::weak_ptr<zmq_pub> self_;
+      void operator()(const block_template_event& event) const;
+    };
+
     //! Callable for `send_txpool_add` with weak ownership to `zmq_pub` object.
     struct txpool_add
     {
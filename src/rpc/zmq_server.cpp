@@ -28,13 +28,16 @@
 
 #include "zmq_server.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <deque>
 #include <utility>
 #include <stdexcept>
 #include <system_error>
 
 #include "byte_slice.h"
+#include "common/metrics.h"
 #include "rpc/zmq_pub.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -48,6 +51,49 @@ namespace
   constexpr const int num_zmq_threads = 1;
   constexpr const std::int64_t max_message_size = 10 * 1024 * 1024; // 10 MiB
   constexpr const std::chrono::seconds linger_timeout{2}; // wait period for pending out messages
+  constexpr const char worker_endpoint[] = "inproc://monero_zmq_rpc_workers";
+  constexpr const char worker_ready[] = "READY";
+  constexpr const unsigned max_worker_threads = 64;
+
+  tools::metrics::histogram zmq_rpc_duration("monero_zmq_rpc_duration_microseconds", "ZMQ RPC handler time");
+
+  //! \return Every part of the next message on `socket`, one string per part
+  expect<std::vector<std::string>> receive_parts(void* const socket, const int flags)
+  {
+    std::vector<std::string> parts{};
+    for (bool more = true; more; )
+    {
+      zmq_msg_t part;
+      zmq_msg_init(std::addressof(part));
+      const expect<void> read = net::zmq::retry_op(zmq_msg_recv, std::addressof(part), socket, flags);
+      if (read)
+      {
+        parts.emplace_back(static_cast<const char*>(zmq_msg_data(std::addressof(part))), zmq_msg_size(std::addressof(part)));
+        more = zmq_msg_more(std::addressof(part));
+      }
+      zmq_msg_close(std::addressof(part));
+      if (!read)
+        return read.error();
+    }
+    return {std::move(parts)};
+  }
+
+  //! Sends `parts` as one message, the last part with `last_flags`
+  expect<void> send_parts(epee::span<const std::string> parts, void* const socket, const int last_flags = 0)
+  {
+    for (std::size_t i = 0; i < parts.size(); ++i)
+    {
+      const int flags = i + 1 < parts.size() ? ZMQ_SNDMORE : last_flags;
+      MONERO_CHECK(net::zmq::send(epee::strspan<std::uint8_t>(parts[i]), socket, flags));
+    }
+    return success();
+  }
+
+  //! \return End of the routing envelope (the empty delimiter part) in `parts`
+  std::vector<std::string>::iterator find_delimiter(std::vector<std::string>& parts)
+  {
+    return std::find_if(parts.begin(), parts.end(), [] (const std::string& part) { return part.empty(); });
+  }
 
   net::zmq::socket init_socket(void* context, int type, epee::span<const std::string> addresses)
   {
@@ -95,7 +141,9 @@ namespace rpc
 ZmqServer::ZmqServer(RpcHandler& h) :
     handler(h),
     context(zmq_init(num_zmq_threads)),
+    worker_count(1),
     rep_socket(nullptr),
+    worker_socket(nullptr),
     pub_socket(nullptr),
     relay_socket(nullptr),
     shared_state(nullptr)
@@ -114,12 +162,13 @@ void ZmqServer::serve()
   {
     // socket must close before `zmq_term` will exit.
     const net::zmq::socket rep = std::move(rep_socket);
+    const net::zmq::socket workers = std::move(worker_socket);
     const net::zmq::socket pub = std::move(pub_socket);
     const net::zmq::socket relay = std::move(relay_socket);
     const std::shared_ptr<listener::zmq_pub> state = std::move(shared_state);
 
     const unsigned init_count = unsigned(bool(pub)) + bool(relay) + bool(state);
-    if (!rep || (init_count && init_count != 3))
+    if (!rep || !workers || (init_count && init_count != 3))
     {
       MERROR("ZMQ RPC server socket is null");
       return;
@@ -127,13 +176,14 @@ void ZmqServer::serve()
 
     MINFO("ZMQ Server started");
 
-    const int read_flags = pub ? ZMQ_DONTWAIT : 0;
-    std::array<zmq_pollitem_t, 3> sockets =
+    std::array<zmq_pollitem_t, 4> sockets =
     {{
+      {workers.get(), 0, ZMQ_POLLIN, 0},
+      {rep.get(), 0, ZMQ_POLLIN, 0},
       {relay.get(), 0, ZMQ_POLLIN, 0},
-      {pub.get(), 0, ZMQ_POLLIN, 0},
-      {rep.get(), 0, ZMQ_POLLIN, 0}
+      {pub.get(), 0, ZMQ_POLLIN, 0}
     }};
+    const std::size_t poll_count = pub ? sockets.size() : 2;
 
     /* This uses XPUB to watch for subscribers, to reduce CPU cycles for
        serialization when the data will be dropped. This is important for block
@@ -143,29 +193,50 @@ void ZmqServer::serve()
        XPUB sockets are not thread-safe, so the p2p thread cannot write into
        the socket while we read here for subscribers. A ZMQ_PAIR socket is
        used for inproc notification. No data is every copied to kernel, it is
-       all userspace messaging. */
+       all userspace messaging.
+
+       RPC requests arrive on a ZMQ_ROUTER and are handed to worker ZMQ_REQ
+       sockets through a second ZMQ_ROUTER. A worker announces itself as idle
+       with its first message and with every reply, and a request is only
+       read from clients while some worker is idle. So a slow request only
+       holds its own thread, and pending requests queue in the client facing
+       socket (bounded by its high water mark) instead of behind it. */
 
+    std::deque<std::string> idle{};
     while (1)
     {
-      if (pub)
-        MONERO_UNWRAP(net::zmq::retry_op(zmq_poll, sockets.data(), sockets.size(), -1));
+      sockets[1].events = idle.empty() ? 0 : ZMQ_POLLIN;
+      MONERO_UNWRAP(net::zmq::retry_op(zmq_poll, sockets.data(), poll_count, -1));
 
       if (sockets[0].revents)
-        state->relay_to_pub(relay.get(), pub.get());
+      {
+        // [worker, "", READY] or [worker, "", client envelope..., "", reply]
+        std::vector<std::string> parts = MONERO_UNWRAP(receive_parts(workers.get(), ZMQ_DONTWAIT));
+        if (parts.size() < 3)
+          throw std::logic_error{"Unexpected message from ZMQ RPC worker"};
+        idle.push_back(std::move(parts[0]));
+        if (parts.size() > 3)
+          MONERO_UNWRAP(send_parts({parts.data() + 2, parts.size() - 2}, rep.get()));
+      }
 
       if (sockets[1].revents)
-        state->sub_request(MONERO_UNWRAP(net::zmq::receive(pub.get(), ZMQ_DONTWAIT)));
-
-      if (!pub || sockets[2].revents)
       {
-        std::string message = MONERO_UNWRAP(net::zmq::receive(rep.get(), read_flags));
-        MDEBUG("Received RPC request: \"" << message << "\"");
-        epee::byte_slice response = handler.handle(std::move(message));
-
-        const boost::string_ref response_view{reinterpret_cast<const char*>(response.data()), response.size()};
-        MDEBUG("Sending RPC reply: \"" << response_view << "\"");
-        MONERO_UNWRAP(net::zmq::send(std::move(response), rep.get()));
+        std::vector<std::string> parts = MONERO_UNWRAP(receive_parts(rep.get(), ZMQ_DONTWAIT));
+        if (find_delimiter(parts) == parts.end())
+          MWARNING("Dropping ZMQ RPC request without envelope");
+        else
+        {
+          parts.insert(parts.begin(), {std::move(idle.front()), std::string{}});
+          idle.pop_front();
+          MONERO_UNWRAP(send_parts(epee::to_span(parts), workers.get()));
+        }
       }
+
+      if (sockets[2].revents)
+        state->relay_to_pub(relay.get(), pub.get());
+
+      if (sockets[3].revents)
+        state->sub_request(MONERO_UNWRAP(net::zmq::receive(pub.get(), ZMQ_DONTWAIT)));
     }
   }
   catch (const std::system_error& e)
@@ -183,7 +254,56 @@ void ZmqServer::serve()
   }
 }
 
-void* ZmqServer::init_rpc(boost::string_ref address, boost::string_ref port)
+void ZmqServer::work(void* const ctx)
+{
+  try
+  {
+    const net::zmq::socket worker{zmq_socket(ctx, ZMQ_REQ)};
+    if (!worker)
+      MONERO_ZMQ_THROW("Failed to create ZMQ RPC worker socket");
+    if (zmq_connect(worker.get(), worker_endpoint) != 0)
+      MONERO_ZMQ_THROW("Failed to connect ZMQ RPC worker");
+
+    MONERO_UNWRAP(net::zmq::send(epee::strspan<std::uint8_t>(boost::string_ref{worker_ready}), worker.get()));
+    while (1)
+    {
+      // [client envelope..., "", request...], checked by `serve`
+      std::vector<std::string> parts = MONERO_UNWRAP(receive_parts(worker.get(), 0));
+      const auto delimiter = find_delimiter(parts);
+
+      std::string message{};
+      for (auto part = delimiter + 1; part != parts.end(); ++part)
+        message.append(*part);
+      parts.erase(delimiter + 1, parts.end());
+
+      MDEBUG("Received RPC request: \"" << message << "\"");
+      const auto start = std::chrono::steady_clock::now();
+      epee::byte_slice response = handler.handle(std::move(message));
+      const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+      zmq_rpc_duration.observe(elapsed.count());
+
+      const boost::string_ref response_view{reinterpret_cast<const char*>(response.data()), response.size()};
+      MDEBUG("Sending RPC reply after " << elapsed.count() << " us: \"" << response_view << "\"");
+      MONERO_UNWRAP(send_parts(epee::to_span(parts), worker.get(), ZMQ_SNDMORE));
+      MONERO_UNWRAP(net::zmq::send(std::move(response), worker.get()));
+    }
+  }
+  catch (const std::system_error& e)
+  {
+    if (e.code() != net::zmq::make_error_code(ETERM))
+      MERROR("ZMQ RPC worker error: " << e.what());
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("ZMQ RPC worker error: " << e.what());
+  }
+  catch (...)
+  {
+    MERROR("Unknown error in ZMQ RPC worker");
+  }
+}
+
+void* ZmqServer::init_rpc(boost::string_ref address, boost::string_ref port, const unsigned threads)
 {
   if (!context)
   {
@@ -201,8 +321,17 @@ void* ZmqServer::init_rpc(boost::string_ref address, boost::string_ref port)
   bind_address += ":";
   bind_address.append(port.data(), port.size());
 
-  rep_socket = init_socket(context.get(), ZMQ_REP, {std::addressof(bind_address), 1});
-  return bool(rep_socket) ? context.get() : nullptr;
+  if (threads == 0 || max_worker_threads < threads)
+  {
+    MERROR("ZMQ RPC Server needs between 1 and " << max_worker_threads << " threads");
+    return nullptr;
+  }
+  worker_count = threads;
+
+  const std::string worker_address[] = {worker_endpoint};
+  worker_socket = init_socket(context.get(), ZMQ_ROUTER, worker_address);
+  rep_socket = init_socket(context.get(), ZMQ_ROUTER, {std::addressof(bind_address), 1});
+  return bool(rep_socket) && bool(worker_socket) ? context.get() : nullptr;
 }
 
 std::shared_ptr<listener::zmq_pub> ZmqServer::init_pub(epee::span<const std::string> addresses)
@@ -234,6 +363,8 @@ std::shared_ptr<listener::zmq_pub> ZmqServer::init_pub(epee::span<const std::str
 void ZmqServer::run()
 {
   run_thread = boost::thread(boost::bind(&ZmqServer::serve, this));
+  for (unsigned i = 0; i < worker_count; ++i)
+    worker_threads.emplace_back(boost::bind(&ZmqServer::work, this, context.get()));
 }
 
 void ZmqServer::stop()
@@ -243,6 +374,9 @@ void ZmqServer::stop()
 
   context.reset(); // destroying context terminates all calls
   run_thread.join();
+  for (boost::thread& worker : worker_threads)
+    worker.join();
+  worker_threads.clear();
 }
 
 }  // namespace cryptonote
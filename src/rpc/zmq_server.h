@@ -33,6 +33,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "common/command_line.h"
 #include "cryptonote_basic/fwd.h"
@@ -57,8 +58,11 @@ class ZmqServer final
 
     void serve();
 
-    //! \return ZMQ context on success, `nullptr` on failure
-    void* init_rpc(boost::string_ref address, boost::string_ref port);
+    /*! Binds the RPC socket. Requests are handed to `threads` worker
+        threads, each running one `RpcHandler::handle` at a time.
+
+        \return ZMQ context on success, `nullptr` on failure */
+    void* init_rpc(boost::string_ref address, boost::string_ref port, unsigned threads = 1);
 
     //! \return `nullptr` on errors.
     std::shared_ptr<listener::zmq_pub> init_pub(epee::span<const std::string> addresses);
@@ -67,13 +71,19 @@ class ZmqServer final
     void stop();
 
   private:
+    //! Runs requests handed out by `serve` until `context` is terminated.
+    void work(void* ctx);
+
     RpcHandler& handler;
 
     net::zmq::context context;
 
     boost::thread run_thread;
+    std::vector<boost::thread> worker_threads;
+    unsigned worker_count;
 
     net::zmq::socket rep_socket;
+    net::zmq::socket worker_socket;
     net::zmq::socket pub_socket;
     net::zmq::socket relay_socket;
     std::shared_ptr<listener::zmq_pub> shared_state;
@@ -36,6 +36,7 @@
 #include <cassert>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <boost/endian/conversion.hpp>
 #include <boost/type_traits/make_unsigned.hpp>
 
@@ -143,6 +144,16 @@ struct binary_archive<false> : public binary_archive_base<false>
   template <class T>
   void serialize_uvarint(T &v)
   {
+    // most varints in a tx (versions, counts, ring offsets, zero amounts)
+    // fit in one byte, which cannot overflow or be non canonical
+    static_assert(std::numeric_limits<T>::digits >= 7, "varint type too small");
+    if (!bytes_.empty() && bytes_[0] < 0x80)
+    {
+      v = bytes_[0];
+      bytes_.remove_prefix(1);
+      return;
+    }
+
     auto current = bytes_.cbegin();
     auto end = bytes_.cend();
     good_ &= (0 <= tools::read_varint(current, end, v));
@@ -59,6 +59,10 @@ namespace serialization
 
     template <typename C>
     void do_reserve(C &c, size_t N) {}
+
+    //! \return True if all N elements were read at once, false to read them one by one
+    template <typename Archive, typename C>
+    bool do_read_blobs(Archive &ar, C &c, size_t N) { return false; }
   }
 }
 
@@ -77,6 +81,12 @@ bool do_serialize_container(Archive<false> &ar, C &v)
     return false;
   }
 
+  if (::serialization::detail::do_read_blobs(ar, v, cnt))
+  {
+    ar.end_array();
+    return ar.good();
+  }
+
   ::serialization::detail::do_reserve(v, cnt);
 
   for (size_t i = 0; i < cnt; i++) {
@@ -36,8 +36,11 @@
 #include <map>
 #include <unordered_set>
 #include <set>
+#include <type_traits>
 #include "serialization.h"
 
+template <bool W> struct binary_archive;
+
 template <template <bool> class Archive, class T> bool do_serialize(Archive<false> &ar, std::vector<T> &v);
 template <template <bool> class Archive, class T> bool do_serialize(Archive<true> &ar, std::vector<T> &v);
 
@@ -88,6 +91,22 @@ namespace serialization
   namespace detail
   {
     template <typename T> void do_reserve(std::vector<T> &c, size_t N) { c.reserve(N); }
+
+    // keys, hashes and signatures are stored back to back, so copy them in one go
+    template <template <bool> class Archive, typename T>
+    typename std::enable_if<is_blob_type<T>::type::value && std::is_same<Archive<false>, binary_archive<false>>::value, bool>::type
+    do_read_blobs(Archive<false> &ar, std::vector<T> &c, size_t N)
+    {
+      if (ar.remaining_bytes() / sizeof(T) < N)
+      {
+        ar.set_fail();
+        return true;
+      }
+      c.resize(N);
+      if (N)
+        ar.serialize_blob(c.data(), N * sizeof(T));
+      return true;
+    }
     template <typename T> void do_add(std::vector<T> &c, T &&e) { c.emplace_back(std::forward<T>(e)); }
 
     template <typename T> void do_add(std::deque<T> &c, T &&e) { c.emplace_back(std::forward<T>(e)); }
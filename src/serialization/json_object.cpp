@@ -129,6 +129,27 @@ void read_hex(const rapidjson::Value& val, epee::span<std::uint8_t> dest)
   }
 }
 
+void write_hex(rapidjson::Writer<epee::byte_stream>& dest, const epee::span<const std::uint8_t> src)
+{
+  // hex never needs escaping, so emit it as a raw string and skip the per-character scan of Writer::String
+  static constexpr const std::size_t max_stack = 128;
+  char stack_buffer[max_stack * 2 + 2];
+  std::string heap_buffer;
+
+  char* out = stack_buffer;
+  if (max_stack < src.size())
+  {
+    heap_buffer.resize(src.size() * 2 + 2);
+    out = &heap_buffer[0];
+  }
+
+  const std::size_t size = src.size() * 2 + 2;
+  out[0] = '"';
+  epee::to_hex::buffer({out + 1, src.size() * 2}, src);
+  out[size - 1] = '"';
+  dest.RawValue(out, size, rapidjson::kStringType);
+}
+
 void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const rapidjson::Value& src)
 {
   src.Accept(dest);
@@ -151,8 +172,7 @@ void fromJsonValue(const rapidjson::Value& val, std::string& str)
 
 void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const std::vector<std::uint8_t>& src)
 {
-  const std::string hex = epee::to_hex::string(epee::to_span(src));
-  dest.String(hex.data(), hex.size());
+  json::write_hex(dest, epee::to_span(src));
 }
 
 void fromJsonValue(const rapidjson::Value& val, std::vector<std::uint8_t>& dest)
@@ -121,6 +121,7 @@ inline constexpr bool is_to_hex()
 }
 
 void read_hex(const rapidjson::Value& val, epee::span<std::uint8_t> dest);
+void write_hex(rapidjson::Writer<epee::byte_stream>& dest, epee::span<const std::uint8_t> src);
 
 // POD to json key
 template <class Type>
@@ -134,8 +135,7 @@ inline typename std::enable_if<is_to_hex<Type>()>::type toJsonKey(rapidjson::Wri
 template <class Type>
 inline typename std::enable_if<is_to_hex<Type>()>::type toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const Type& pod)
 {
-  const auto hex = epee::to_hex::array(pod);
-  dest.String(hex.data(), hex.size());
+  json::write_hex(dest, epee::as_byte_span(pod));
 }
 
 template <class Type>
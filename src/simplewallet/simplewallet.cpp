@@ -141,6 +141,7 @@ typedef cryptonote::simple_wallet sw;
 #define MAX_PAYMENT_DIFF 10000
 #define MIN_PAYMENT_RATE 0.01f // per hash
 #define MAX_MNEW_ADDRESSES 1000
+#define TRANSFERS_PAGE_SIZE 1000 // confirmed transfers fetched from the history index at a time
 
 #define CHECK_MULTISIG_ENABLED() \
   do \
@@ -237,7 +238,7 @@ namespace
   const char* USAGE_VERIFY("verify <filename> <address> <signature>");
   const char* USAGE_EXPORT_KEY_IMAGES("export_key_images [all] <filename>");
   const char* USAGE_IMPORT_KEY_IMAGES("import_key_images <filename>");
-  const char* USAGE_HW_KEY_IMAGES_SYNC("hw_key_images_sync");
+  const char* USAGE_HW_KEY_IMAGES_SYNC("hw_key_images_sync [all]");
   const char* USAGE_HW_RECONNECT("hw_reconnect");
   const char* USAGE_EXPORT_OUTPUTS("export_outputs [all] <filename>");
   const char* USAGE_IMPORT_OUTPUTS("import_outputs <filename>");
@@ -3125,6 +3126,25 @@ bool simple_wallet::set_enable_multisig(const std::vector<std::string> &args/* =
   return true;
 }
 
+bool simple_wallet::set_compress_cache(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  if (args.size() < 2)
+  {
+    fail_msg_writer() << tr("Value not specified");
+    return true;
+  }
+
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->compress_cache(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
 bool simple_wallet::help(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
   if(args.empty())
@@ -3443,6 +3463,8 @@ simple_wallet::simple_wallet()
                                   "  Set this if you would like to display the wallet name when locked.\n "
                                   "enable-multisig-experimental <1|0>\n "
                                   "  Set this to allow multisig commands. Multisig may currently be exploitable if parties do not trust each other.\n "
+                                  "compress-cache <1|0>\n "
+                                  "  Set this to compress the wallet cache when it is saved. A compressed cache can only be opened by versions supporting it.\n "
                                   "inactivity-lock-timeout <unsigned int>\n "
                                   "  How many seconds to wait before locking the wallet (0 to disable)."));
   m_cmd_binder.set_handler("encrypted_seed",
@@ -3554,7 +3576,7 @@ simple_wallet::simple_wallet()
   m_cmd_binder.set_handler("hw_key_images_sync",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::hw_key_images_sync, _1),
                            tr(USAGE_HW_KEY_IMAGES_SYNC),
-                           tr("Synchronizes key images with the hw wallet."));
+                           tr("Synchronizes key images with the hw wallet. Only transfers without a key image from the device are sent, unless \"all\" is passed."));
   m_cmd_binder.set_handler("hw_reconnect",
                            boost::bind(&simple_wallet::on_command, this, &simple_wallet::hw_reconnect, _1),
                            tr(USAGE_HW_RECONNECT),
@@ -3859,6 +3881,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "credits-target = " << m_wallet->credits_target();
     success_msg_writer() << "load-deprecated-formats = " << m_wallet->load_deprecated_formats();
     success_msg_writer() << "enable-multisig-experimental = " << m_wallet->is_multisig_enabled();
+    success_msg_writer() << "compress-cache = " << m_wallet->compress_cache();
     return true;
   }
   else
@@ -3926,6 +3949,7 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("auto-mine-for-rpc-payment-threshold", set_auto_mine_for_rpc_payment_threshold, tr("floating point >= 0"));
     CHECK_SIMPLE_VARIABLE("credits-target", set_credits_target, tr("unsigned integer"));
     CHECK_SIMPLE_VARIABLE("enable-multisig-experimental", set_enable_multisig, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("compress-cache", set_compress_cache, tr("0 or 1"));
   }
   fail_msg_writer() << tr("set: unrecognized argument(s)");
   return true;
@@ -8601,7 +8625,7 @@ static std::string get_human_readable_timespan(uint64_t seconds)
 }
 //----------------------------------------------------------------------------------------------------
 // mutates local_args as it parses and consumes arguments
-bool simple_wallet::get_transfers(std::vector<std::string>& local_args, std::vector<transfer_view>& transfers)
+bool simple_wallet::get_transfers(std::vector<std::string>& local_args, const std::function<void(const transfer_view&)> &f)
 {
   bool in = true;
   bool out = true;
@@ -8679,89 +8703,108 @@ bool simple_wallet::get_transfers(std::vector<std::string>& local_args, std::vec
 
   const uint64_t last_block_height = m_wallet->get_blockchain_current_height();
 
-  if (in || coinbase) {
-    std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-    m_wallet->get_payments(payments, min_height, max_height, m_current_subaddress_account, subaddr_indices);
-    for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
-      const tools::wallet2::payment_details &pd = i->second;
-      if (!pd.m_coinbase && !in)
-        continue;
-      std::string payment_id = string_tools::pod_to_hex(i->first);
-      if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-        payment_id = payment_id.substr(0,16);
-      std::string note = m_wallet->get_tx_note(pd.m_tx_hash);
-      std::string destination = m_wallet->get_subaddress_as_str({m_current_subaddress_account, pd.m_subaddr_index.minor});
-      const std::string type = pd.m_coinbase ? tr("block") : tr("in");
-      const bool unlocked = m_wallet->is_transfer_unlocked(pd.m_unlock_time, pd.m_block_height);
-      std::string locked_msg = "unlocked";
-      if (!unlocked)
-      {
-        locked_msg = "locked";
-        if (pd.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER)
-        {
-          uint64_t bh = std::max(pd.m_unlock_time, pd.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE);
-          if (bh >= last_block_height)
-            locked_msg = std::to_string(bh - last_block_height) + " blks";
+  auto in_view = [&](const std::pair<crypto::hash, tools::wallet2::payment_details> &payment) -> transfer_view {
+    const tools::wallet2::payment_details &pd = payment.second;
+    std::string payment_id = string_tools::pod_to_hex(payment.first);
+    if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
+      payment_id = payment_id.substr(0,16);
+    std::string note = m_wallet->get_tx_note(pd.m_tx_hash);
+    std::string destination = m_wallet->get_subaddress_as_str({m_current_subaddress_account, pd.m_subaddr_index.minor});
+    const std::string type = pd.m_coinbase ? tr("block") : tr("in");
+    const bool unlocked = m_wallet->is_transfer_unlocked(pd.m_unlock_time, pd.m_block_height);
+    std::string locked_msg = "unlocked";
+    if (!unlocked)
+    {
+      locked_msg = "locked";
+      if (pd.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER)
+      {
+        uint64_t bh = std::max(pd.m_unlock_time, pd.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE);
+        if (bh >= last_block_height)
+          locked_msg = std::to_string(bh - last_block_height) + " blks";
+      }
+      else
+      {
+        const uint64_t adjusted_time = m_wallet->get_daemon_adjusted_time();
+        uint64_t threshold = adjusted_time + (m_wallet->use_fork_rules(2, 0) ? CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2 : CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V1);
+        if (threshold < pd.m_unlock_time)
+          locked_msg = get_human_readable_timespan(std::chrono::seconds(pd.m_unlock_time - threshold));
+      }
+    }
+    return {
+      type,
+      pd.m_block_height,
+      pd.m_timestamp,
+      type,
+      true,
+      pd.m_amount,
+      pd.m_tx_hash,
+      payment_id,
+      0,
+      {{destination, pd.m_amount}},
+      {pd.m_subaddr_index.minor},
+      note,
+      locked_msg
+    };
+  };
+
+  auto out_view = [&](const std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details> &payment) -> transfer_view {
+    const tools::wallet2::confirmed_transfer_details &pd = payment.second;
+    uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
+    uint64_t fee = pd.m_amount_in - pd.m_amount_out;
+    std::vector<std::pair<std::string, uint64_t>> destinations;
+    for (const auto &d: pd.m_dests) {
+      destinations.push_back({d.address(m_wallet->nettype(), pd.m_payment_id), d.amount});
+    }
+    std::string payment_id = string_tools::pod_to_hex(pd.m_payment_id);
+    if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
+      payment_id = payment_id.substr(0,16);
+    std::string note = m_wallet->get_tx_note(payment.first);
+    return {
+      "out",
+      pd.m_block_height,
+      pd.m_timestamp,
+      "out",
+      true,
+      pd.m_amount_in - change - fee,
+      payment.first,
+      payment_id,
+      fee,
+      destinations,
+      pd.m_subaddr_indices,
+      note,
+      "-"
+    };
+  };
+
+  // confirmed transfers come from the wallet's history index a page at a time, already
+  // in height order, so memory use does not grow with the size of the history
+  if (in || coinbase || out) {
+    tools::wallet2::transfer_history_cursor cursor{0, 0, 0};
+    tools::wallet2::transfer_history_page page;
+    do {
+      m_wallet->get_transfer_history(cursor, TRANSFERS_PAGE_SIZE, in || coinbase, out, min_height, max_height, m_current_subaddress_account, subaddr_indices, page);
+      if (page.reset) {
+        fail_msg_writer() << tr("the transfer history changed while being listed");
+        return false;
+      }
+      cursor = page.next;
+      size_t i = 0, o = 0;
+      while (i < page.in.size() || o < page.out.size()) {
+        if (o == page.out.size() || (i < page.in.size() &&
+            std::make_pair(page.in[i].second.m_block_height, page.in[i].second.m_timestamp) <= std::make_pair(page.out[o].second.m_block_height, page.out[o].second.m_timestamp))) {
+          const auto &payment = page.in[i++];
+          if (payment.second.m_coinbase || in)
+            f(in_view(payment));
         }
-        else
-        {
-          const uint64_t adjusted_time = m_wallet->get_daemon_adjusted_time();
-          uint64_t threshold = adjusted_time + (m_wallet->use_fork_rules(2, 0) ? CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2 : CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V1);
-          if (threshold < pd.m_unlock_time)
-            locked_msg = get_human_readable_timespan(std::chrono::seconds(pd.m_unlock_time - threshold));
+        else {
+          f(out_view(page.out[o++]));
         }
       }
-      transfers.push_back({
-        type,
-        pd.m_block_height,
-        pd.m_timestamp,
-        type,
-        true,
-        pd.m_amount,
-        pd.m_tx_hash,
-        payment_id,
-        0,
-        {{destination, pd.m_amount}},
-        {pd.m_subaddr_index.minor},
-        note,
-        locked_msg
-      });
-    }
-  }
-
-  if (out) {
-    std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-    m_wallet->get_payments_out(payments, min_height, max_height, m_current_subaddress_account, subaddr_indices);
-    for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
-      const tools::wallet2::confirmed_transfer_details &pd = i->second;
-      uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
-      uint64_t fee = pd.m_amount_in - pd.m_amount_out;
-      std::vector<std::pair<std::string, uint64_t>> destinations;
-      for (const auto &d: pd.m_dests) {
-        destinations.push_back({d.address(m_wallet->nettype(), pd.m_payment_id), d.amount});
-      }
-      std::string payment_id = string_tools::pod_to_hex(i->second.m_payment_id);
-      if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-        payment_id = payment_id.substr(0,16);
-      std::string note = m_wallet->get_tx_note(i->first);
-      transfers.push_back({
-        "out",
-        pd.m_block_height,
-        pd.m_timestamp,
-        "out",
-        true,
-        pd.m_amount_in - change - fee,
-        i->first,
-        payment_id,
-        fee,
-        destinations,
-        pd.m_subaddr_indices,
-        note,
-        "-"
-      });
-    }
+    } while (page.more);
   }
 
+  // unconfirmed transfers are few, and printed last
+  std::vector<transfer_view> transfers;
   if (pool) {
     try
     {
@@ -8808,7 +8851,6 @@ bool simple_wallet::get_transfers(std::vector<std::string>& local_args, std::vec
     }
   }
 
-  // print unconfirmed last
   if (pending || failed) {
     std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
     m_wallet->get_unconfirmed_payments_out(upayments, m_current_subaddress_account, subaddr_indices);
@@ -8844,14 +8886,14 @@ bool simple_wallet::get_transfers(std::vector<std::string>& local_args, std::vec
       }
     }
   }
-  // sort by block, then by timestamp (unconfirmed last)
+  // sort by block, then by timestamp
   std::sort(transfers.begin(), transfers.end(), [](const transfer_view& a, const transfer_view& b) -> bool {
-    if (a.confirmed && !b.confirmed)
-      return true;
     if (a.block == b.block)
       return a.timestamp < b.timestamp;
     return a.block < b.block;
   });
+  for (const transfer_view &transfer: transfers)
+    f(transfer);
 
   return true;
 }
@@ -8867,14 +8909,9 @@ bool simple_wallet::show_transfers(const std::vector<std::string> &args_)
 
   LOCK_IDLE_SCOPE();
 
-  std::vector<transfer_view> all_transfers;
-
-  if (!get_transfers(local_args, all_transfers))
-    return true;
-
   PAUSE_READLINE();
 
-  for (const auto& transfer : all_transfers)
+  get_transfers(local_args, [this](const transfer_view &transfer)
   {
     const auto color = transfer.type == "failed" ? console_color_red : transfer.confirmed ? ((transfer.direction == "in" || transfer.direction == "block") ? console_color_green : console_color_magenta) : console_color_default;
 
@@ -8904,7 +8941,7 @@ bool simple_wallet::show_transfers(const std::vector<std::string> &args_)
       % destinations
       % boost::algorithm::join(transfer.index | boost::adaptors::transformed([](uint32_t i) { return std::to_string(i); }), ", ")
       % transfer.note;
-  }
+  });
 
   return true;
 }
@@ -8918,25 +8955,20 @@ bool simple_wallet::export_transfers(const std::vector<std::string>& args_)
     return true;
   }
 
-  std::vector<transfer_view> all_transfers;
-
-  // might consumes arguments in local_args
-  if (!get_transfers(local_args, all_transfers))
-    return true;
-
-  // output filename
-  std::string filename = (boost::format("output%u.csv") % m_current_subaddress_account).str();
-  if (local_args.size() > 0 && local_args[0].substr(0, 7) == "output=")
-  {
-    filename = local_args[0].substr(7, -1);
-    local_args.erase(local_args.begin());
-  }
+  // the output options come last, after the ones get_transfers consumes
   // check for export with tx keys
   bool export_keys = false;
-  if (local_args.size() > 0 && local_args[0].substr(0, 7) == "option=")
+  if (local_args.size() > 0 && local_args.back().substr(0, 7) == "option=")
   {
-    export_keys = local_args[0].substr(7, -1) == "with_keys";
-    local_args.erase(local_args.begin());
+    export_keys = local_args.back().substr(7, -1) == "with_keys";
+    local_args.pop_back();
+  }
+  // output filename
+  std::string filename = (boost::format("output%u.csv") % m_current_subaddress_account).str();
+  if (local_args.size() > 0 && local_args.back().substr(0, 7) == "output=")
+  {
+    filename = local_args.back().substr(7, -1);
+    local_args.pop_back();
   }
   if (export_keys)
   {
@@ -8951,19 +8983,27 @@ bool simple_wallet::export_transfers(const std::vector<std::string>& args_)
     LOCK_IDLE_SCOPE();
   }
 
-  std::ofstream file(filename);
-
-  // header
-  file <<
-      boost::format("%8.8s,%9.9s,%8.8s,%25.25s,%20.20s,%20.20s,%64.64s,%16.16s,%14.14s,%106.106s,%20.20s,%s,%s,%s") %
-      tr("block") % tr("direction") % tr("unlocked") % tr("timestamp") % tr("amount") % tr("running balance") % tr("hash") % tr("payment ID") % tr("fee") % tr("destination") % tr("amount") % tr("index") % tr("note") % tr("tx key")
-      << std::endl;
+  // transfers are written as they come, and the file is only created once
+  // the arguments are known to be good
+  std::ofstream file;
+  auto open_file = [&]()
+  {
+    if (file.is_open())
+      return;
+    file.open(filename);
+    // header
+    file <<
+        boost::format("%8.8s,%9.9s,%8.8s,%25.25s,%20.20s,%20.20s,%64.64s,%16.16s,%14.14s,%106.106s,%20.20s,%s,%s,%s") %
+        tr("block") % tr("direction") % tr("unlocked") % tr("timestamp") % tr("amount") % tr("running balance") % tr("hash") % tr("payment ID") % tr("fee") % tr("destination") % tr("amount") % tr("index") % tr("note") % tr("tx key")
+        << std::endl;
+  };
 
   uint64_t running_balance = 0;
   auto formatter = boost::format("%8.8llu,%9.9s,%8.8s,%25.25s,%20.20s,%20.20s,%64.64s,%16.16s,%14.14s,%106.106s,%20.20s,\"%s\",%s,%s");
 
-  for (const auto& transfer : all_transfers)
+  const bool r = get_transfers(local_args, [&](const transfer_view &transfer)
   {
+    open_file();
     // ignore unconfirmed transfers in running balance
     if (transfer.confirmed)
     {
@@ -9018,7 +9058,10 @@ bool simple_wallet::export_transfers(const std::vector<std::string>& args_)
         % ""
         << std::endl;
     }
-  }
+  });
+  if (!r)
+    return true;
+  open_file();
   file.close();
 
   success_msg_writer() << tr("CSV exported to ") << filename;
@@ -10280,18 +10323,27 @@ bool simple_wallet::hw_key_images_sync(const std::vector<std::string> &args)
     return true;
   }
 
+  bool all = false;
+  if (args.size() == 1 && args[0] == "all")
+    all = true;
+  else if (!args.empty())
+  {
+    PRINT_USAGE(USAGE_HW_KEY_IMAGES_SYNC);
+    return true;
+  }
+
   LOCK_IDLE_SCOPE();
-  key_images_sync_intern();
+  key_images_sync_intern(all);
   return true;
 }
 //----------------------------------------------------------------------------------------------------
-void simple_wallet::key_images_sync_intern(){
+void simple_wallet::key_images_sync_intern(bool all){
   try
   {
     message_writer(console_color_white, false) << tr("Please confirm the key image sync on the device");
 
     uint64_t spent = 0, unspent = 0;
-    uint64_t height = m_wallet->cold_key_image_sync(spent, unspent);
+    uint64_t height = m_wallet->cold_key_image_sync(spent, unspent, all);
     if (height > 0)
     {
       success_msg_writer() << tr("Key images synchronized to height ") << height;
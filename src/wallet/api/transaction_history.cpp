@@ -44,11 +44,78 @@ using namespace epee;
 
 namespace Monero {
 
+namespace {
+    std::string short_payment_id(const crypto::hash &id)
+    {
+        std::string payment_id = string_tools::pod_to_hex(id);
+        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
+            payment_id = payment_id.substr(0,16);
+        return payment_id;
+    }
+}
+
+// payments are "input transactions";
+// one input transaction contains only one transfer. e.g. <transaction_id> - <100XMR>
+TransactionInfoImpl *TransactionHistoryImpl::makeIn(const tools::wallet2 &w, const crypto::hash &id, const tools::wallet2::payment_details &pd, uint64_t wallet_height)
+{
+    TransactionInfoImpl * ti = new TransactionInfoImpl();
+    ti->m_paymentid = short_payment_id(id);
+    ti->m_coinbase = pd.m_coinbase;
+    ti->m_amount    = pd.m_amount;
+    ti->m_fee       = pd.m_fee;
+    ti->m_direction = TransactionInfo::Direction_In;
+    ti->m_hash      = string_tools::pod_to_hex(pd.m_tx_hash);
+    ti->m_blockheight = pd.m_block_height;
+    ti->m_description = w.get_tx_note(pd.m_tx_hash);
+    ti->m_subaddrIndex = { pd.m_subaddr_index.minor };
+    ti->m_subaddrAccount = pd.m_subaddr_index.major;
+    ti->m_label     = w.get_subaddress_label(pd.m_subaddr_index);
+    ti->m_timestamp = pd.m_timestamp;
+    ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
+    ti->m_unlock_time = pd.m_unlock_time;
+    return ti;
+}
+
+// confirmed output transactions
+// one output transaction may contain more than one money transfer, e.g.
+// <transaction_id>:
+//    transfer1: 100XMR to <address_1>
+//    transfer2: 50XMR  to <address_2>
+//    fee: fee charged per transaction
+//
+TransactionInfoImpl *TransactionHistoryImpl::makeOut(const tools::wallet2 &w, const crypto::hash &hash, const tools::wallet2::confirmed_transfer_details &pd, uint64_t wallet_height)
+{
+    uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
+    uint64_t fee = pd.m_amount_in - pd.m_amount_out;
+
+    TransactionInfoImpl * ti = new TransactionInfoImpl();
+    ti->m_paymentid = short_payment_id(pd.m_payment_id);
+    ti->m_amount = pd.m_amount_in - change - fee;
+    ti->m_fee    = fee;
+    ti->m_direction = TransactionInfo::Direction_Out;
+    ti->m_hash = string_tools::pod_to_hex(hash);
+    ti->m_blockheight = pd.m_block_height;
+    ti->m_description = w.get_tx_note(hash);
+    ti->m_subaddrIndex = pd.m_subaddr_indices;
+    ti->m_subaddrAccount = pd.m_subaddr_account;
+    ti->m_label = pd.m_subaddr_indices.size() == 1 ? w.get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
+    ti->m_timestamp = pd.m_timestamp;
+    ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
+
+    // single output transaction might contain multiple transfers
+    for (const auto &d: pd.m_dests) {
+        ti->m_transfers.push_back({d.amount, d.address(w.nettype(), pd.m_payment_id)});
+    }
+    return ti;
+}
+
 TransactionHistory::~TransactionHistory() {}
 
 
 TransactionHistoryImpl::TransactionHistoryImpl(WalletImpl *wallet)
     : m_wallet(wallet)
+    , m_pendingCount(0)
+    , m_cursor{0, 0, 0}
 {
 
 }
@@ -100,169 +167,134 @@ void TransactionHistoryImpl::setTxNote(const std::string &txid, const std::strin
     const crypto::hash htxid = *reinterpret_cast<const crypto::hash*>(txid_data.data());
 
     m_wallet->m_wallet->set_tx_note(htxid, note);
+    {
+        // confirmed entries are kept across refreshes, so update them in place
+        boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
+        for (auto t : m_history)
+            if (t->hash() == txid)
+                static_cast<TransactionInfoImpl*>(t)->m_description = note;
+    }
     refresh();
 }
 
 void TransactionHistoryImpl::refresh()
 {
-    // multithreaded access:
-    // boost::lock_guard<boost::mutex> guarg(m_historyMutex);
-    // for "write" access, locking exclusively
-    boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
-
-    // TODO: configurable values;
-    uint64_t min_height = 0;
-    uint64_t max_height = (uint64_t)-1;
+    // wallet2 is read between refresh chunks, and new entries are built
+    // without the history lock so readers only wait for the update
+    boost::lock_guard<boost::recursive_mutex> refresh_lock(m_wallet->m_refreshMutex2);
+    const tools::wallet2 &w = *m_wallet->m_wallet;
     uint64_t wallet_height = m_wallet->blockChainHeight();
 
-    // delete old transactions;
-    for (auto t : m_history)
-        delete t;
-    m_history.clear();
-
     // transactions are stored in wallet2:
     // - confirmed_transfer_details   - out transfers
     // - unconfirmed_transfer_details - pending out transfers
     // - payment_details              - input transfers
-
-    // payments are "input transactions";
-    // one input transaction contains only one transfer. e.g. <transaction_id> - <100XMR>
-
-    std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> in_payments;
-    m_wallet->m_wallet->get_payments(in_payments, min_height, max_height);
-    for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = in_payments.begin(); i != in_payments.end(); ++i) {
-        const tools::wallet2::payment_details &pd = i->second;
-        std::string payment_id = string_tools::pod_to_hex(i->first);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
-        ti->m_coinbase = pd.m_coinbase;
-        ti->m_amount    = pd.m_amount;
-        ti->m_fee       = pd.m_fee;
-        ti->m_direction = TransactionInfo::Direction_In;
-        ti->m_hash      = string_tools::pod_to_hex(pd.m_tx_hash);
-        ti->m_blockheight = pd.m_block_height;
-        ti->m_description = m_wallet->m_wallet->get_tx_note(pd.m_tx_hash);
-        ti->m_subaddrIndex = { pd.m_subaddr_index.minor };
-        ti->m_subaddrAccount = pd.m_subaddr_index.major;
-        ti->m_label     = m_wallet->m_wallet->get_subaddress_label(pd.m_subaddr_index);
-        ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
-        ti->m_unlock_time = pd.m_unlock_time;
-        m_history.push_back(ti);
-
-    }
-
-    // confirmed output transactions
-    // one output transaction may contain more than one money transfer, e.g.
-    // <transaction_id>:
-    //    transfer1: 100XMR to <address_1>
-    //    transfer2: 50XMR  to <address_2>
-    //    fee: fee charged per transaction
     //
-
-    std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> out_payments;
-    m_wallet->m_wallet->get_payments_out(out_payments, min_height, max_height);
-
-    for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = out_payments.begin();
-         i != out_payments.end(); ++i) {
-        
-        const crypto::hash &hash = i->first;
-        const tools::wallet2::confirmed_transfer_details &pd = i->second;
-        
-        uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
-        uint64_t fee = pd.m_amount_in - pd.m_amount_out;
-        
-
-        std::string payment_id = string_tools::pod_to_hex(i->second.m_payment_id);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
-
-
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
-        ti->m_amount = pd.m_amount_in - change - fee;
-        ti->m_fee    = fee;
-        ti->m_direction = TransactionInfo::Direction_Out;
-        ti->m_hash = string_tools::pod_to_hex(hash);
-        ti->m_blockheight = pd.m_block_height;
-        ti->m_description = m_wallet->m_wallet->get_tx_note(hash);
-        ti->m_subaddrIndex = pd.m_subaddr_indices;
-        ti->m_subaddrAccount = pd.m_subaddr_account;
-        ti->m_label = pd.m_subaddr_indices.size() == 1 ? m_wallet->m_wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
-        ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
-
-        // single output transaction might contain multiple transfers
-        for (const auto &d: pd.m_dests) {
-            ti->m_transfers.push_back({d.amount, d.address(m_wallet->m_wallet->nettype(), pd.m_payment_id)});
+    // confirmed ones are only fetched past the cursor of the last refresh;
+    // a cursor from another generation of wallet2's history (reorg, rescan)
+    // gets everything, and replaces what we had
+    tools::wallet2::transfer_history_page page;
+    w.get_transfer_history(m_cursor, 0, true, true, 0, (uint64_t)-1, boost::none, {}, page);
+    const bool rebuild = page.next.generation != m_cursor.generation;
+
+    // both lists are in height order, keep that across them
+    std::vector<TransactionInfo*> confirmed;
+    confirmed.reserve(page.in.size() + page.out.size());
+    auto in = page.in.begin();
+    auto out = page.out.begin();
+    while (in != page.in.end() || out != page.out.end())
+    {
+        if (out == page.out.end() || (in != page.in.end() && in->second.m_block_height <= out->second.m_block_height))
+        {
+            confirmed.push_back(makeIn(w, in->first, in->second, wallet_height));
+            ++in;
+        }
+        else
+        {
+            confirmed.push_back(makeOut(w, out->first, out->second, wallet_height));
+            ++out;
         }
-
-        m_history.push_back(ti);
     }
 
+    // pending entries are few and change state, so they are rebuilt each time
+    std::vector<TransactionInfo*> pending;
+
     // unconfirmed output transactions
     std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments_out;
-    m_wallet->m_wallet->get_unconfirmed_payments_out(upayments_out);
+    w.get_unconfirmed_payments_out(upayments_out);
     for (std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>>::const_iterator i = upayments_out.begin(); i != upayments_out.end(); ++i) {
         const tools::wallet2::unconfirmed_transfer_details &pd = i->second;
         const crypto::hash &hash = i->first;
         uint64_t amount = pd.m_amount_in;
         uint64_t fee = amount - pd.m_amount_out;
-        std::string payment_id = string_tools::pod_to_hex(i->second.m_payment_id);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
         bool is_failed = pd.m_state == tools::wallet2::unconfirmed_transfer_details::failed;
 
         TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        ti->m_paymentid = short_payment_id(pd.m_payment_id);
         ti->m_amount = amount - pd.m_change - fee;
         ti->m_fee    = fee;
         ti->m_direction = TransactionInfo::Direction_Out;
         ti->m_failed = is_failed;
         ti->m_pending = true;
         ti->m_hash = string_tools::pod_to_hex(hash);
-        ti->m_description = m_wallet->m_wallet->get_tx_note(hash);
+        ti->m_description = w.get_tx_note(hash);
         ti->m_subaddrIndex = pd.m_subaddr_indices;
         ti->m_subaddrAccount = pd.m_subaddr_account;
-        ti->m_label = pd.m_subaddr_indices.size() == 1 ? m_wallet->m_wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
+        ti->m_label = pd.m_subaddr_indices.size() == 1 ? w.get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
         ti->m_timestamp = pd.m_timestamp;
         ti->m_confirmations = 0;
         for (const auto &d : pd.m_dests)
         {
-            ti->m_transfers.push_back({d.amount, d.address(m_wallet->m_wallet->nettype(), pd.m_payment_id)});
-        }        
-        m_history.push_back(ti);
+            ti->m_transfers.push_back({d.amount, d.address(w.nettype(), pd.m_payment_id)});
+        }
+        pending.push_back(ti);
     }
-    
-    
+
     // unconfirmed payments (tx pool)
     std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> upayments;
-    m_wallet->m_wallet->get_unconfirmed_payments(upayments);
+    w.get_unconfirmed_payments(upayments);
     for (std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>>::const_iterator i = upayments.begin(); i != upayments.end(); ++i) {
         const tools::wallet2::payment_details &pd = i->second.m_pd;
-        std::string payment_id = string_tools::pod_to_hex(i->first);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
         TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        ti->m_paymentid = short_payment_id(i->first);
         ti->m_amount    = pd.m_amount;
         ti->m_direction = TransactionInfo::Direction_In;
         ti->m_hash      = string_tools::pod_to_hex(pd.m_tx_hash);
         ti->m_blockheight = pd.m_block_height;
-        ti->m_description = m_wallet->m_wallet->get_tx_note(pd.m_tx_hash);
+        ti->m_description = w.get_tx_note(pd.m_tx_hash);
         ti->m_pending = true;
         ti->m_subaddrIndex = { pd.m_subaddr_index.minor };
         ti->m_subaddrAccount = pd.m_subaddr_index.major;
-        ti->m_label     = m_wallet->m_wallet->get_subaddress_label(pd.m_subaddr_index);
+        ti->m_label     = w.get_subaddress_label(pd.m_subaddr_index);
         ti->m_timestamp = pd.m_timestamp;
         ti->m_confirmations = 0;
-        m_history.push_back(ti);
-        
+        pending.push_back(ti);
+
         LOG_PRINT_L1(__FUNCTION__ << ": Unconfirmed payment found " << pd.m_amount);
     }
-     
+
+    // confirmed entries first, in wallet2 history order, then m_pendingCount pending ones
+    std::vector<TransactionInfo*> dropped;
+    {
+        // for "write" access, locking exclusively
+        boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
+        const size_t kept = rebuild ? 0 : m_history.size() - m_pendingCount;
+        dropped.assign(m_history.begin() + kept, m_history.end());
+        m_history.resize(kept);
+        for (auto t : m_history)
+        {
+            TransactionInfoImpl *ti = static_cast<TransactionInfoImpl*>(t);
+            ti->m_confirmations = (wallet_height > ti->m_blockheight) ? wallet_height - ti->m_blockheight : 0;
+        }
+        m_history.insert(m_history.end(), confirmed.begin(), confirmed.end());
+        m_history.insert(m_history.end(), pending.begin(), pending.end());
+        m_pendingCount = pending.size();
+    }
+    m_cursor = page.next;
+
+    // delete old transactions;
+    for (auto t : dropped)
+        delete t;
 }
 
 } // namespace
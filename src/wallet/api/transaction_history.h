@@ -29,11 +29,13 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include "wallet/api/wallet2_api.h"
+#include "wallet/wallet2.h"
 #include <boost/thread/shared_mutex.hpp>
 
 namespace Monero {
 
 class WalletImpl;
+class TransactionInfoImpl;
 
 class TransactionHistoryImpl : public TransactionHistory
 {
@@ -48,10 +50,16 @@ public:
     virtual void setTxNote(const std::string &txid, const std::string &note);
 
 private:
+    static TransactionInfoImpl *makeIn(const tools::wallet2 &w, const crypto::hash &id, const tools::wallet2::payment_details &pd, uint64_t wallet_height);
+    static TransactionInfoImpl *makeOut(const tools::wallet2 &w, const crypto::hash &hash, const tools::wallet2::confirmed_transfer_details &pd, uint64_t wallet_height);
 
     // TransactionHistory is responsible of memory management
+    // confirmed transfers in wallet2 history order, then m_pendingCount pending/pool ones
     std::vector<TransactionInfo*> m_history;
     WalletImpl *m_wallet;
+    size_t m_pendingCount;
+    // where the confirmed part of m_history ends in wallet2's transfer history
+    tools::wallet2::transfer_history_cursor m_cursor;
     mutable boost::shared_mutex   m_historyMutex;
 };
 
@@ -65,6 +65,8 @@ namespace {
     static const int    DEFAULT_REMOTE_NODE_REFRESH_INTERVAL_MILLIS = 1000 * 10;
     // Connection timeout 20 sec
     static const int    DEFAULT_CONNECTION_TIMEOUT_MILLIS = 1000 * 20;
+    // blocks per refresh step, the wallet is unlocked between steps
+    static const uint64_t REFRESH_CHUNK_BLOCKS = 256;
 
     std::string get_default_ringdb_path(cryptonote::network_type nettype)
     {
@@ -433,6 +435,7 @@ WalletImpl::WalletImpl(NetworkType nettype, uint64_t kdf_rounds)
     m_wallet->callback(m_wallet2Callback.get());
     m_refreshThreadDone = false;
     m_refreshEnabled = false;
+    m_refreshing = false;
     m_addressBook.reset(new AddressBookImpl(this));
     m_subaddress.reset(new SubaddressImpl(this));
     m_subaddressAccount.reset(new SubaddressAccountImpl(this));
@@ -1008,11 +1011,23 @@ void WalletImpl::setSubaddressLookahead(uint32_t major, uint32_t minor)
 
 uint64_t WalletImpl::balance(uint32_t accountIndex) const
 {
+    if (m_refreshing)
+    {
+        boost::lock_guard<boost::mutex> lock(m_balanceMutex);
+        if (accountIndex < m_balanceSnapshot.size())
+            return m_balanceSnapshot[accountIndex].first;
+    }
     return m_wallet->balance(accountIndex, false);
 }
 
 uint64_t WalletImpl::unlockedBalance(uint32_t accountIndex) const
 {
+    if (m_refreshing)
+    {
+        boost::lock_guard<boost::mutex> lock(m_balanceMutex);
+        if (accountIndex < m_balanceSnapshot.size())
+            return m_balanceSnapshot[accountIndex].second;
+    }
     return m_wallet->unlocked_balance(accountIndex, false);
 }
 
@@ -2272,7 +2287,9 @@ void WalletImpl::doRefresh()
 {
     bool rescan = m_refreshShouldRescan.exchange(false);
     // synchronizing async and sync refresh calls
-    boost::lock_guard<boost::mutex> guarg(m_refreshMutex2);
+    boost::unique_lock<boost::recursive_mutex> guarg(m_refreshMutex2);
+    // the background thread stops early when paused or stopped, a sync refresh runs to the end
+    const bool background = boost::this_thread::get_id() == m_refreshThread.get_id();
     do try {
         LOG_PRINT_L3(__FUNCTION__ << ": doRefresh, rescan = "<<rescan);
         // Syncing daemon and refreshing wallet simultaneously is very resource intensive.
@@ -2280,8 +2297,29 @@ void WalletImpl::doRefresh()
         if (m_wallet->light_wallet() || daemonSynced()) {
             if(rescan)
                 m_wallet->rescan_blockchain(false);
-            m_wallet->refresh(trustedDaemon());
-            if (!m_synchronized) {
+            // refresh in steps, letting history refreshes and pauseRefresh in between,
+            // while balance queries are served from the last step's snapshot
+            updateBalanceSnapshot();
+            m_refreshing = true;
+            auto refreshing = epee::misc_utils::create_scope_leave_handler([this](){ m_refreshing = false; });
+            uint64_t blocks_fetched = 0;
+            bool received_money = false;
+            while (true)
+            {
+                m_wallet->refresh(trustedDaemon(), 0, blocks_fetched, received_money, true, REFRESH_CHUNK_BLOCKS);
+                if (blocks_fetched < REFRESH_CHUNK_BLOCKS)
+                    break;
+                updateBalanceSnapshot();
+                guarg.unlock();
+                boost::this_thread::yield();
+                guarg.lock();
+                if (background && (!m_refreshEnabled || m_refreshThreadDone))
+                {
+                    LOG_PRINT_L3(__FUNCTION__ << ": refresh paused between steps");
+                    break;
+                }
+            }
+            if (!m_synchronized && blocks_fetched < REFRESH_CHUNK_BLOCKS) {
                 m_synchronized = true;
             }
             // assuming if we have empty history, it wasn't initialized yet
@@ -2304,6 +2342,15 @@ void WalletImpl::doRefresh()
     }
 }
 
+void WalletImpl::updateBalanceSnapshot()
+{
+    std::vector<std::pair<uint64_t, uint64_t>> snapshot(m_wallet->get_num_subaddress_accounts());
+    for (uint32_t i = 0; i < snapshot.size(); ++i)
+        snapshot[i] = std::make_pair(m_wallet->balance(i, false), m_wallet->unlocked_balance(i, false));
+    boost::lock_guard<boost::mutex> lock(m_balanceMutex);
+    m_balanceSnapshot.swap(snapshot);
+}
+
 
 void WalletImpl::startRefresh()
 {
@@ -2329,9 +2376,10 @@ void WalletImpl::stopRefresh()
 void WalletImpl::pauseRefresh()
 {
     LOG_PRINT_L2(__FUNCTION__ << ": refresh paused...");
-    // TODO synchronize access
     if (!m_refreshThreadDone) {
         m_refreshEnabled = false;
+        // wait for a running refresh to finish its step and see the flag
+        boost::lock_guard<boost::recursive_mutex> lock(m_refreshMutex2);
     }
 }
 
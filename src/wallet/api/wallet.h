@@ -36,6 +36,7 @@
 
 #include <string>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/condition_variable.hpp>
 
@@ -235,6 +236,7 @@ private:
     void setStatus(int status, const std::string& message) const;
     void refreshThreadFunc();
     void doRefresh();
+    void updateBalanceSnapshot();
     bool daemonSynced() const;
     void stopRefresh();
     bool isNewWallet() const;
@@ -270,8 +272,9 @@ private:
     // synchronizing  refresh loop;
     boost::mutex        m_refreshMutex;
 
-    // synchronizing  sync and async refresh
-    boost::mutex        m_refreshMutex2;
+    // synchronizing  sync and async refresh, and history refresh; released
+    // between refresh chunks
+    boost::recursive_mutex m_refreshMutex2;
     boost::condition_variable m_refreshCV;
     boost::thread       m_refreshThread;
     // flag indicating wallet is recovering from seed
@@ -280,6 +283,11 @@ private:
     std::atomic<bool>   m_recoveringFromSeed;
     std::atomic<bool>   m_recoveringFromDevice;
     std::atomic<bool>   m_synchronized;
+    // per account (balance, unlocked balance) as of the last refresh chunk,
+    // served instead of reading wallet2 while a refresh is running
+    mutable boost::mutex m_balanceMutex;
+    std::vector<std::pair<uint64_t, uint64_t>> m_balanceSnapshot;
+    std::atomic<bool>   m_refreshing;
     std::atomic<bool>   m_rebuildWalletCache;
     // cache connection status to avoid unnecessary RPC calls
     mutable std::atomic<bool>   m_is_connected;
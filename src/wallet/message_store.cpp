@@ -35,11 +35,13 @@
 #include <boost/filesystem.hpp>
 #include <fstream>
 #include <sstream>
+#include <unordered_set>
 #include "file_io_utils.h"
 #include "storages/http_abstract_invoke.h"
 #include "wallet_errors.h"
 #include "serialization/binary_utils.h"
 #include "common/base58.h"
+#include "common/threadpool.h"
 #include "common/util.h"
 #include "common/utf8.h"
 #include "string_tools.h"
@@ -654,18 +656,6 @@ bool message_store::any_message_of_type(message_type type, message_direction dir
   return false;
 }
 
-bool message_store::any_message_with_hash(const crypto::hash &hash) const
-{
-  for (size_t i = 0; i < m_messages.size(); ++i)
-  {
-    if (m_messages[i].hash == hash)
-    {
-      return true;
-    }
-  }
-  return false;
-}
-
 // Count the ids in the vector that are set i.e. not 0, while ignoring index 0
 // Mostly used to check whether we have a message for each authorized signer except me,
 // with the signer index used as index into 'ids'; the element at index 0, for me,
@@ -1346,11 +1336,29 @@ bool message_store::check_for_messages(const multisig_wallet_state &state, std::
     return false;
   }
 
-  bool new_messages = false;
+  // Incoming messages are checked and decrypted in parallel, and then added in the
+  // order they were received
+  struct incoming_message
+  {
+    const transport_message *rm;
+    uint32_t sender_index;
+    crypto::secret_key decrypt_key;
+    bool hash_valid;
+    bool signature_valid;
+    bool decrypted;
+    std::string plaintext;
+  };
+  std::vector<incoming_message> incoming;
+
+  std::unordered_set<crypto::hash> known_hashes;
+  for (const message &m: m_messages)
+  {
+    known_hashes.insert(m.hash);
+  }
   for (size_t i = 0; i < transport_messages.size(); ++i)
   {
     transport_message &rm = transport_messages[i];
-    if (any_message_with_hash(rm.hash))
+    if (known_hashes.find(rm.hash) != known_hashes.end())
     {
       // Already seen, do not take again
     }
@@ -1396,26 +1404,53 @@ bool message_store::check_for_messages(const multisig_wallet_state &state, std::
       }
       if (take)
       {
-        crypto::hash actual_hash = crypto::cn_fast_hash(rm.content.data(), rm.content.size());
-        THROW_WALLET_EXCEPTION_IF(actual_hash != rm.hash, tools::error::wallet_internal_error, "Message hash mismatch");
-
-        bool signature_valid = crypto::check_signature(actual_hash, rm.source_monero_address.m_view_public_key, rm.signature);
-        THROW_WALLET_EXCEPTION_IF(!signature_valid, tools::error::wallet_internal_error, "Message signature not valid");
-
-        std::string plaintext;
-        decrypt(rm.content, rm.encryption_public_key, rm.iv, decrypt_key, plaintext);
-        size_t index = add_message(state, sender_index, (message_type)rm.type, message_direction::in, plaintext);
-        message &m = m_messages[index];
-        m.hash = rm.hash;
-        m.transport_id = rm.transport_id;
-        m.sent = rm.timestamp;
-        m.round = rm.round;
-        m.signature_count = rm.signature_count;
-        messages.push_back(m);
-        new_messages = true;
+        incoming.push_back({&rm, sender_index, decrypt_key, false, false, false, std::string()});
+        known_hashes.insert(rm.hash);
       }
     }
   }
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (incoming_message &im: incoming)
+  {
+    tpool.submit(&waiter, [this, &im]() {
+      const transport_message &rm = *im.rm;
+      crypto::hash actual_hash = crypto::cn_fast_hash(rm.content.data(), rm.content.size());
+      im.hash_valid = actual_hash == rm.hash;
+      if (!im.hash_valid)
+        return;
+      im.signature_valid = crypto::check_signature(actual_hash, rm.source_monero_address.m_view_public_key, rm.signature);
+      if (!im.signature_valid)
+        return;
+      try
+      {
+        decrypt(rm.content, rm.encryption_public_key, rm.iv, im.decrypt_key, im.plaintext);
+        im.decrypted = true;
+      }
+      catch (const std::exception &e) {}
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), tools::error::wallet_internal_error, "Failed to check messages");
+
+  bool new_messages = false;
+  for (incoming_message &im: incoming)
+  {
+    const transport_message &rm = *im.rm;
+    THROW_WALLET_EXCEPTION_IF(!im.hash_valid, tools::error::wallet_internal_error, "Message hash mismatch");
+    THROW_WALLET_EXCEPTION_IF(!im.signature_valid, tools::error::wallet_internal_error, "Message signature not valid");
+    THROW_WALLET_EXCEPTION_IF(!im.decrypted, tools::error::wallet_internal_error, "Failed to generate key derivation for message decryption");
+
+    size_t index = add_message(state, im.sender_index, (message_type)rm.type, message_direction::in, im.plaintext);
+    message &m = m_messages[index];
+    m.hash = rm.hash;
+    m.transport_id = rm.transport_id;
+    m.sent = rm.timestamp;
+    m.round = rm.round;
+    m.signature_count = rm.signature_count;
+    messages.push_back(m);
+    new_messages = true;
+  }
   return new_messages;
 }
 
@@ -399,7 +399,6 @@ namespace mms
     size_t get_message_index_by_id(uint32_t id) const;
     message& get_message_ref_by_id(uint32_t id);
     bool any_message_of_type(message_type type, message_direction direction) const;
-    bool any_message_with_hash(const crypto::hash &hash) const;
     size_t get_other_signers_id_count(const std::vector<uint32_t> &ids) const;
     bool message_ids_complete(const std::vector<uint32_t> &ids) const;
     void encrypt(crypto::public_key public_key, const std::string &plaintext,
@@ -127,6 +127,10 @@ bool message_transporter::receive_messages(const std::vector<std::string> &desti
   size_t size = bitmessage_res.inboxMessages.size();
   messages.clear();
 
+  // Only messages that arrived since the last call get decoded, the inbox is polled
+  // regularly and otherwise would be decoded again and again completely
+  std::unordered_map<std::string, boost::optional<transport_message>> decoded_messages;
+  decoded_messages.reserve(size);
   for (size_t i = 0; i < size; ++i)
   {
     if (!m_run.load(std::memory_order_relaxed))
@@ -135,10 +139,19 @@ bool message_transporter::receive_messages(const std::vector<std::string> &desti
       return false;
     }
     const bitmessage_rpc::message_info &message_info = bitmessage_res.inboxMessages[i];
-    if (std::find(destination_transport_addresses.begin(), destination_transport_addresses.end(), message_info.toAddress) != destination_transport_addresses.end())
+    if (std::find(destination_transport_addresses.begin(), destination_transport_addresses.end(), message_info.toAddress) == destination_transport_addresses.end())
+    {
+      continue;
+    }
+    boost::optional<transport_message> &decoded = decoded_messages[message_info.msgid];
+    const auto cached = m_decoded_messages.find(message_info.msgid);
+    if (cached != m_decoded_messages.end())
+    {
+      decoded = cached->second;
+    }
+    else
     {
       transport_message message;
-      bool is_mms_message = false;
       try
       {
         // First Base64-decoding: The message body is Base64 in the Bitmessage API
@@ -148,18 +161,21 @@ bool message_transporter::receive_messages(const std::vector<std::string> &desti
         if (!epee::serialization::load_t_from_json(message, json))
           MERROR("Failed to deserialize message");
         else
-          is_mms_message = true;
+        {
+          message.transport_id = message_info.msgid;
+          decoded = std::move(message);
+        }
       }
       catch(const std::exception& e)
       {
       }
-      if (is_mms_message)
-      {
-        message.transport_id = message_info.msgid;
-        messages.push_back(message);
-      }
+    }
+    if (decoded)
+    {
+      messages.push_back(*decoded);
     }
   }
+  m_decoded_messages = std::move(decoded_messages);
 
   return true;
 }
@@ -37,6 +37,8 @@
 #include "net/abstract_http_client.h"
 #include "common/util.h"
 #include "wipeable_string.h"
+#include <boost/optional/optional.hpp>
+#include <unordered_map>
 #include <vector>
 
 namespace mms
@@ -98,6 +100,9 @@ private:
   std::string m_bitmessage_url;
   epee::wipeable_string m_bitmessage_login;
   std::atomic<bool> m_run;
+  // Inbox messages already decoded, by Bitmessage message id, none if not an MMS message;
+  // only messages still in the inbox are kept
+  std::unordered_map<std::string, boost::optional<transport_message>> m_decoded_messages;
 
   bool post_request(const std::string &request, std::string &answer);
   static std::string get_str_between_tags(const std::string &s, const std::string &start_delim, const std::string &stop_delim);
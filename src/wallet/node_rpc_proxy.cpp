@@ -33,6 +33,7 @@
 #include "storages/http_abstract_invoke.h"
 
 #include <boost/thread.hpp>
+#include <map>
 
 #define RETURN_ON_RPC_RESPONSE_ERROR(r, error, res, method) \
   do { \
@@ -53,6 +54,90 @@ namespace tools
 
 static const std::chrono::seconds rpc_timeout = std::chrono::minutes(3) + std::chrono::seconds(30);
 
+namespace
+{
+  /*! Daemon answers shared by every proxy in the process, so wallets talking
+      to the same daemon make one call per refresh instead of one each. A
+      caller asking for a key while another one fetches it waits for that
+      answer. If the fetch fails, each waiter tries on its own so errors are
+      still reported per wallet. */
+  template<typename T>
+  class single_flight_cache
+  {
+    struct entry
+    {
+      boost::optional<T> value;
+      bool in_flight = false;
+    };
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    std::map<std::string, entry> m_entries;
+
+  public:
+    template<typename P, typename F>
+    boost::optional<std::string> get(const std::string &key, const P &fresh, const F &fetch, T &out)
+    {
+      boost::unique_lock<boost::mutex> lock{m_mutex};
+      entry &e = m_entries[key];
+      while (!e.value || !fresh(*e.value))
+      {
+        if (!e.in_flight)
+        {
+          e.in_flight = true;
+          lock.unlock();
+
+          T value{};
+          boost::optional<std::string> error;
+          try
+          {
+            error = fetch(value);
+          }
+          catch (...)
+          {
+            lock.lock();
+            e.in_flight = false;
+            m_cond.notify_all();
+            throw;
+          }
+
+          lock.lock();
+          e.in_flight = false;
+          m_cond.notify_all();
+          if (error)
+            return error;
+          e.value = value;
+          out = std::move(value);
+          return boost::none;
+        }
+        m_cond.wait(lock);
+      }
+      out = *e.value;
+      return boost::none;
+    }
+  };
+
+  struct info_snapshot
+  {
+    uint64_t height;
+    uint64_t target_height;
+    uint64_t block_weight_limit;
+    uint64_t adjusted_time;
+    time_t time;
+  };
+
+  struct fee_snapshot
+  {
+    uint64_t height;
+    uint64_t fee;
+    std::vector<uint64_t> fees;
+    uint64_t quantization_mask;
+  };
+
+  single_flight_cache<info_snapshot> shared_info;
+  single_flight_cache<fee_snapshot> shared_fees;
+}
+
 NodeRPCProxy::NodeRPCProxy(epee::net_utils::http::abstract_http_client &http_client, rpc_payment_state_t &rpc_payment_state, boost::recursive_mutex &mutex)
   : m_http_client(http_client)
   , m_rpc_payment_state(rpc_payment_state)
@@ -62,6 +147,11 @@ NodeRPCProxy::NodeRPCProxy(epee::net_utils::http::abstract_http_client &http_cli
   invalidate();
 }
 
+void NodeRPCProxy::set_daemon_address(std::string address)
+{
+  m_daemon_address = std::move(address);
+}
+
 void NodeRPCProxy::invalidate()
 {
   m_height = 0;
@@ -142,27 +232,86 @@ boost::optional<std::string> NodeRPCProxy::get_info()
   const time_t now = time(NULL);
   if (now >= m_get_info_time + 30) // re-cache every 30 seconds
   {
-    cryptonote::COMMAND_RPC_GET_INFO::request req_t = AUTO_VAL_INIT(req_t);
-    cryptonote::COMMAND_RPC_GET_INFO::response resp_t = AUTO_VAL_INIT(resp_t);
+    const auto fetch = [this, now](info_snapshot &info) -> boost::optional<std::string> {
+      cryptonote::COMMAND_RPC_GET_INFO::request req_t = AUTO_VAL_INIT(req_t);
+      cryptonote::COMMAND_RPC_GET_INFO::response resp_t = AUTO_VAL_INIT(resp_t);
+
+      {
+        const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+        uint64_t pre_call_credits = m_rpc_payment_state.credits;
+        req_t.client = cryptonote::make_rpc_payment_signature(m_client_id_secret_key);
+        bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_info", req_t, resp_t, m_http_client, rpc_timeout);
+        RETURN_ON_RPC_RESPONSE_ERROR(r, epee::json_rpc::error{}, resp_t, "get_info");
+        check_rpc_cost(m_rpc_payment_state, "get_info", resp_t.credits, pre_call_credits, COST_PER_GET_INFO);
+      }
+
+      info.height = resp_t.height;
+      info.target_height = resp_t.target_height;
+      info.block_weight_limit = resp_t.block_weight_limit ? resp_t.block_weight_limit : resp_t.block_size_limit;
+      info.adjusted_time = resp_t.adjusted_time;
+      info.time = now;
+      return boost::none;
+    };
+
+    info_snapshot info{};
+    boost::optional<std::string> error;
+    if (m_daemon_address.empty())
+      error = fetch(info);
+    else
+      error = shared_info.get(m_daemon_address, [now](const info_snapshot &cached) { return now < cached.time + 30; }, fetch, info);
+    if (error)
+      return error;
+
+    m_height = info.height;
+    m_target_height = info.target_height;
+    m_block_weight_limit = info.block_weight_limit;
+    m_adjusted_time = info.adjusted_time;
+    m_get_info_time = info.time;
+    m_height_time = info.time;
+    m_target_height_time = info.time;
+  }
+  return boost::optional<std::string>();
+}
+
+boost::optional<std::string> NodeRPCProxy::get_fee_estimate(uint64_t height, uint64_t grace_blocks)
+{
+  const auto fetch = [this, height, grace_blocks](fee_snapshot &estimate) -> boost::optional<std::string> {
+    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request req_t = AUTO_VAL_INIT(req_t);
+    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response resp_t = AUTO_VAL_INIT(resp_t);
+    req_t.grace_blocks = grace_blocks;
 
     {
       const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
       uint64_t pre_call_credits = m_rpc_payment_state.credits;
       req_t.client = cryptonote::make_rpc_payment_signature(m_client_id_secret_key);
-      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_info", req_t, resp_t, m_http_client, rpc_timeout);
-      RETURN_ON_RPC_RESPONSE_ERROR(r, epee::json_rpc::error{}, resp_t, "get_info");
-      check_rpc_cost(m_rpc_payment_state, "get_info", resp_t.credits, pre_call_credits, COST_PER_GET_INFO);
+      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_fee_estimate", req_t, resp_t, m_http_client, rpc_timeout);
+      RETURN_ON_RPC_RESPONSE_ERROR(r, epee::json_rpc::error{}, resp_t, "get_fee_estimate");
+      check_rpc_cost(m_rpc_payment_state, "get_fee_estimate", resp_t.credits, pre_call_credits, COST_PER_FEE_ESTIMATE);
     }
 
-    m_height = resp_t.height;
-    m_target_height = resp_t.target_height;
-    m_block_weight_limit = resp_t.block_weight_limit ? resp_t.block_weight_limit : resp_t.block_size_limit;
-    m_adjusted_time = resp_t.adjusted_time;
-    m_get_info_time = now;
-    m_height_time = now;
-    m_target_height_time = now;
-  }
-  return boost::optional<std::string>();
+    estimate.height = height;
+    estimate.fee = resp_t.fee;
+    estimate.fees = !resp_t.fees.empty() ? std::move(resp_t.fees) : std::vector<uint64_t>{resp_t.fee};
+    estimate.quantization_mask = resp_t.quantization_mask;
+    return boost::none;
+  };
+
+  fee_snapshot estimate{};
+  boost::optional<std::string> error;
+  if (m_daemon_address.empty())
+    error = fetch(estimate);
+  else
+    error = shared_fees.get(m_daemon_address + "/" + std::to_string(grace_blocks),
+      [height](const fee_snapshot &cached) { return cached.height == height; }, fetch, estimate);
+  if (error)
+    return error;
+
+  m_dynamic_base_fee_estimate = estimate.fee;
+  m_dynamic_base_fee_estimate_cached_height = height;
+  m_dynamic_base_fee_estimate_grace_blocks = grace_blocks;
+  m_dynamic_base_fee_estimate_vector = std::move(estimate.fees);
+  m_fee_quantization_mask = estimate.quantization_mask;
+  return boost::none;
 }
 
 boost::optional<std::string> NodeRPCProxy::get_height(uint64_t &height)
@@ -253,24 +402,9 @@ boost::optional<std::string> NodeRPCProxy::get_dynamic_base_fee_estimate_2021_sc
     return boost::optional<std::string>("offline");
   if (m_dynamic_base_fee_estimate_cached_height != height || m_dynamic_base_fee_estimate_grace_blocks != grace_blocks)
   {
-    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request req_t = AUTO_VAL_INIT(req_t);
-    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response resp_t = AUTO_VAL_INIT(resp_t);
-    req_t.grace_blocks = grace_blocks;
-
-    {
-      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-      uint64_t pre_call_credits = m_rpc_payment_state.credits;
-      req_t.client = cryptonote::make_rpc_payment_signature(m_client_id_secret_key);
-      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_fee_estimate", req_t, resp_t, m_http_client, rpc_timeout);
-      RETURN_ON_RPC_RESPONSE_ERROR(r, epee::json_rpc::error{}, resp_t, "get_fee_estimate");
-      check_rpc_cost(m_rpc_payment_state, "get_fee_estimate", resp_t.credits, pre_call_credits, COST_PER_FEE_ESTIMATE);
-    }
-
-    m_dynamic_base_fee_estimate = resp_t.fee;
-    m_dynamic_base_fee_estimate_cached_height = height;
-    m_dynamic_base_fee_estimate_grace_blocks = grace_blocks;
-    m_dynamic_base_fee_estimate_vector = !resp_t.fees.empty() ? std::move(resp_t.fees) : std::vector<uint64_t>{m_dynamic_base_fee_estimate};
-    m_fee_quantization_mask = resp_t.quantization_mask;
+    result = get_fee_estimate(height, grace_blocks);
+    if (result)
+      return result;
   }
 
   fees = m_dynamic_base_fee_estimate_vector;
@@ -299,22 +433,9 @@ boost::optional<std::string> NodeRPCProxy::get_fee_quantization_mask(uint64_t &f
     return boost::optional<std::string>("offline");
   if (m_dynamic_base_fee_estimate_cached_height != height)
   {
-    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request req_t = AUTO_VAL_INIT(req_t);
-    cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response resp_t = AUTO_VAL_INIT(resp_t);
-    req_t.grace_blocks = m_dynamic_base_fee_estimate_grace_blocks;
-
-    {
-      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-      uint64_t pre_call_credits = m_rpc_payment_state.credits;
-      req_t.client = cryptonote::make_rpc_payment_signature(m_client_id_secret_key);
-      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_fee_estimate", req_t, resp_t, m_http_client, rpc_timeout);
-      RETURN_ON_RPC_RESPONSE_ERROR(r, epee::json_rpc::error{}, resp_t, "get_fee_estimate");
-      check_rpc_cost(m_rpc_payment_state, "get_fee_estimate", resp_t.credits, pre_call_credits, COST_PER_FEE_ESTIMATE);
-    }
-
-    m_dynamic_base_fee_estimate = resp_t.fee;
-    m_dynamic_base_fee_estimate_cached_height = height;
-    m_fee_quantization_mask = resp_t.quantization_mask;
+    result = get_fee_estimate(height, m_dynamic_base_fee_estimate_grace_blocks);
+    if (result)
+      return result;
   }
 
   fee_quantization_mask = m_fee_quantization_mask;
@@ -45,6 +45,8 @@ public:
   NodeRPCProxy(epee::net_utils::http::abstract_http_client &http_client, rpc_payment_state_t &rpc_payment_state, boost::recursive_mutex &mutex);
 
   void set_client_secret_key(const crypto::secret_key &skey) { m_client_id_secret_key = skey; }
+  //! Proxies with the same non-empty daemon address share get_info and fee estimates
+  void set_daemon_address(std::string address);
   void invalidate();
   void set_offline(bool offline) { m_offline = offline; }
 
@@ -74,12 +76,14 @@ private:
 
 private:
   boost::optional<std::string> get_info();
+  boost::optional<std::string> get_fee_estimate(uint64_t height, uint64_t grace_blocks);
 
   epee::net_utils::http::abstract_http_client &m_http_client;
   rpc_payment_state_t &m_rpc_payment_state;
   boost::recursive_mutex &m_daemon_rpc_mutex;
   crypto::secret_key m_client_id_secret_key;
   bool m_offline;
+  std::string m_daemon_address;
 
   uint64_t m_height;
   uint64_t m_earliest_height[256];
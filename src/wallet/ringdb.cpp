@@ -143,20 +143,28 @@ static std::string decrypt(const std::string &ciphertext, const crypto::key_imag
   return plaintext;
 }
 
-static void store_relative_ring(MDB_txn *txn, MDB_dbi &dbi, const crypto::key_image &key_image, const std::vector<uint64_t> &relative_ring, const crypto::chacha_key &chacha_key)
+static std::pair<std::string, std::string> encrypt_relative_ring(const crypto::key_image &key_image, const std::vector<uint64_t> &relative_ring, const crypto::chacha_key &chacha_key)
 {
-  MDB_val key, data;
-  std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
-  key.mv_data = (void*)key_ciphertext.data();
-  key.mv_size = key_ciphertext.size();
   std::string compressed_ring = compress_ring(relative_ring, V1TAG);
-  std::string data_ciphertext = encrypt(compressed_ring, key_image, chacha_key, 1);
-  data.mv_size = data_ciphertext.size();
-  data.mv_data = (void*)data_ciphertext.c_str();
+  return std::make_pair(encrypt(key_image, chacha_key, 0), encrypt(compressed_ring, key_image, chacha_key, 1));
+}
+
+static void store_encrypted_ring(MDB_txn *txn, MDB_dbi &dbi, const std::pair<std::string, std::string> &ring)
+{
+  MDB_val key, data;
+  key.mv_data = (void*)ring.first.data();
+  key.mv_size = ring.first.size();
+  data.mv_size = ring.second.size();
+  data.mv_data = (void*)ring.second.data();
   int dbr = mdb_put(txn, dbi, &key, &data, 0);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set ring for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
 }
 
+static void store_relative_ring(MDB_txn *txn, MDB_dbi &dbi, const crypto::key_image &key_image, const std::vector<uint64_t> &relative_ring, const crypto::chacha_key &chacha_key)
+{
+  store_encrypted_ring(txn, dbi, encrypt_relative_ring(key_image, relative_ring, chacha_key));
+}
+
 static int resize_env(MDB_env *env, const char *db_path, size_t needed)
 {
   MDB_envinfo mei;
@@ -423,8 +431,18 @@ bool ringdb::set_rings(const crypto::chacha_key &chacha_key, const std::vector<s
   epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
   tx_active = true;
 
+  // encrypt first, then write in key order, so a large import walks the tree once instead of
+  // jumping to a random leaf for every ring
+  std::vector<std::pair<std::string, std::string>> encrypted_rings;
+  encrypted_rings.reserve(rings.size());
   for (const auto &e: rings)
-    store_relative_ring(txn, dbi_rings, e.first, relative ? e.second : cryptonote::absolute_output_offsets_to_relative(e.second), chacha_key);
+    encrypted_rings.push_back(encrypt_relative_ring(e.first, relative ? e.second : cryptonote::absolute_output_offsets_to_relative(e.second), chacha_key));
+  std::sort(encrypted_rings.begin(), encrypted_rings.end(), [](const std::pair<std::string, std::string> &a, const std::pair<std::string, std::string> &b) {
+    MDB_val ka{a.first.size(), (void*)a.first.data()}, kb{b.first.size(), (void*)b.first.data()};
+    return compare_hash32(&ka, &kb) < 0;
+  });
+  for (const auto &e: encrypted_rings)
+    store_encrypted_ring(txn, dbi_rings, e);
 
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn setting ring to database: " + std::string(mdb_strerror(dbr)));
@@ -460,7 +478,28 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create cursor for blackballs table: " + std::string(mdb_strerror(dbr)));
 
   MDB_val key, data;
-  for (const std::pair<uint64_t, uint64_t> &output: outputs)
+
+  // bulk blackballing: sorted and deduplicated, outputs past the last one in the table can be
+  // appended, which is the common case when importing a blockchain_blackball run
+  std::vector<std::pair<uint64_t, uint64_t>> sorted_outputs;
+  bool have_last = false;
+  std::pair<uint64_t, uint64_t> last;
+  if (op == BLACKBALL_BLACKBALL && outputs.size() > 1)
+  {
+    sorted_outputs = outputs;
+    std::sort(sorted_outputs.begin(), sorted_outputs.end());
+    sorted_outputs.erase(std::unique(sorted_outputs.begin(), sorted_outputs.end()), sorted_outputs.end());
+
+    dbr = mdb_cursor_get(cursor, &key, &data, MDB_LAST);
+    THROW_WALLET_EXCEPTION_IF(dbr && dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to lookup in blackballs table: " + std::string(mdb_strerror(dbr)));
+    if (dbr == 0)
+    {
+      last = std::make_pair(*(const uint64_t*)key.mv_data, *(const uint64_t*)data.mv_data);
+      have_last = true;
+    }
+  }
+
+  for (const std::pair<uint64_t, uint64_t> &output: sorted_outputs.empty() ? outputs : sorted_outputs)
   {
     key.mv_data = (void*)&output.first;
     key.mv_size = sizeof(output.first);
@@ -471,7 +510,14 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
     {
       case BLACKBALL_BLACKBALL:
         MDEBUG("Marking output " << output.first << "/" << output.second << " as spent");
-        dbr = mdb_cursor_put(cursor, &key, &data, MDB_NODUPDATA);
+        if (!sorted_outputs.empty() && (!have_last || output > last))
+        {
+          dbr = mdb_cursor_put(cursor, &key, &data, have_last && output.first == last.first ? MDB_APPENDDUP : MDB_APPEND);
+          last = output;
+          have_last = true;
+        }
+        else
+          dbr = mdb_cursor_put(cursor, &key, &data, MDB_NODUPDATA);
         if (dbr == MDB_KEYEXIST)
           dbr = 0;
         break;
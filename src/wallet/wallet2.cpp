@@ -32,6 +32,8 @@
 #include <numeric>
 #include <tuple>
 #include <queue>
+#include <deque>
+#include <chrono>
 #include <boost/format.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -42,9 +44,14 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <openssl/evp.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include "include_base_utils.h"
 using namespace epee;
 
@@ -113,6 +120,8 @@ using namespace cryptonote;
 #define TX_WEIGHT_TARGET(bytes) (bytes*2/3)
 
 #define UNSIGNED_TX_PREFIX "Monero unsigned tx set\005"
+#define COMPRESSED_CACHE_MAGIC "monero compressed wallet cache"
+#define COMPRESSED_CACHE_ZSTD_LEVEL 3
 #define SIGNED_TX_PREFIX "Monero signed tx set\005"
 #define MULTISIG_UNSIGNED_TX_PREFIX "Monero multisig unsigned tx set\001"
 
@@ -127,6 +136,10 @@ using namespace cryptonote;
 
 #define SUBADDRESS_LOOKAHEAD_MAJOR 50
 #define SUBADDRESS_LOOKAHEAD_MINOR 200
+#define SUBADDRESS_STR_CACHE_SIZE 65536
+
+// below this many keys, a single device call beats spreading over the threadpool
+#define SUBADDRESS_PARALLEL_KEYS_MIN 256
 
 #define KEY_IMAGE_EXPORT_FILE_MAGIC "Monero key image export\003"
 
@@ -141,9 +154,6 @@ using namespace cryptonote;
 
 #define FIRST_REFRESH_GRANULARITY     1024
 
-#define GAMMA_SHAPE 19.28
-#define GAMMA_SCALE (1/1.61)
-
 #define DEFAULT_MIN_OUTPUT_COUNT 5
 #define DEFAULT_MIN_OUTPUT_VALUE (2*COIN)
 
@@ -151,8 +161,16 @@ using namespace cryptonote;
 
 #define IGNORE_LONG_PAYMENT_ID_FROM_BLOCK_VERSION 12
 
-#define DEFAULT_UNLOCK_TIME (CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE * DIFFICULTY_TARGET_V2)
-#define RECENT_SPEND_WINDOW (15 * DIFFICULTY_TARGET_V2)
+#define RCT_DISTRIBUTION_REFRESH_BLOCKS 100 // refetch that many cached blocks when topping up, to follow reorgs
+#define MAX_VALID_PUBLIC_KEYS_CACHE_SIZE 262144
+
+#define DAEMON_PROBE_TIMEOUT std::chrono::seconds(10)
+#define DAEMON_FAILURE_BACKOFF 120 // seconds before a failed daemon is tried again
+#define DAEMON_REPROBE_INTERVAL 600 // seconds between latency checks of the daemon set
+#define DAEMON_SWITCH_LATENCY_RATIO 2 // a working daemon is only left for one that many times faster
+
+#define REFRESH_PREFETCH_MAX_REQUESTS 4 // block pulls in flight ahead of the batch being processed
+#define REFRESH_PREFETCH_MAX_BYTES (128 * 1024 * 1024) // cap on the blocks pulled ahead
 
 static const std::string MULTISIG_SIGNATURE_MAGIC = "SigMultisigPkV1";
 
@@ -241,6 +259,7 @@ namespace
 // Create on-demand to prevent static initialization order fiasco issues.
 struct options {
   const command_line::arg_descriptor<std::string> daemon_address = {"daemon-address", tools::wallet2::tr("Use daemon instance at <host>:<port>"), ""};
+  const command_line::arg_descriptor<std::vector<std::string>> daemon_fallback = {"daemon-fallback", tools::wallet2::tr("Fall back on daemon instance at <host>:<port> when the main one fails, may be repeated")};
   const command_line::arg_descriptor<std::string> daemon_host = {"daemon-host", tools::wallet2::tr("Use daemon instance at host <arg> instead of localhost"), ""};
   const command_line::arg_descriptor<std::string> proxy = {"proxy", tools::wallet2::tr("[<ip>:]<port> socks proxy to use for daemon connections"), {}, true};
   const command_line::arg_descriptor<bool> trusted_daemon = {"trusted-daemon", tools::wallet2::tr("Enable commands which rely on a trusted daemon"), false};
@@ -273,7 +292,7 @@ struct options {
   const command_line::arg_descriptor<uint64_t> kdf_rounds = {"kdf-rounds", tools::wallet2::tr("Number of rounds for the key derivation function"), 1};
   const command_line::arg_descriptor<std::string> hw_device = {"hw-device", tools::wallet2::tr("HW device to use"), ""};
   const command_line::arg_descriptor<std::string> hw_device_derivation_path = {"hw-device-deriv-path", tools::wallet2::tr("HW device wallet derivation path (e.g., SLIP-10)"), ""};
-  const command_line::arg_descriptor<std::string> tx_notify = { "tx-notify" , "Run a program for each new incoming transaction, '%s' will be replaced by the transaction hash" , "" };
+  const command_line::arg_descriptor<std::string> tx_notify = { "tx-notify" , "Run a program for each new incoming transaction, '%s' will be replaced by the transaction hash. With a 'batch:' prefix, the program is run once and sent a line per transaction on its input" , "" };
   const command_line::arg_descriptor<bool> no_dns = {"no-dns", tools::wallet2::tr("Do not use DNS"), false};
   const command_line::arg_descriptor<bool> offline = {"offline", tools::wallet2::tr("Do not connect to a daemon, nor use DNS"), false};
   const command_line::arg_descriptor<std::string> extra_entropy = {"extra-entropy", tools::wallet2::tr("File containing extra entropy to initialize the PRNG (any data, aim for 256 bits of entropy to be useful, which typically means more than 256 bits of data)")};
@@ -466,6 +485,7 @@ std::unique_ptr<tools::wallet2> make_basic(const boost::program_options::variabl
   {
     THROW_WALLET_EXCEPTION(tools::error::wallet_internal_error, tools::wallet2::tr("failed to initialize the wallet"));
   }
+  wallet->set_daemon_fallbacks(command_line::get_arg(vm, opts.daemon_fallback));
   boost::filesystem::path ringdb_path = command_line::get_arg(vm, opts.shared_ringdb_dir);
   wallet->set_ring_database(ringdb_path.string());
   wallet->get_message_store().set_options(vm);
@@ -788,6 +808,31 @@ void drop_from_short_history(std::list<crypto::hash> &short_chain_history, size_
   }
 }
 
+void erase_index_entry(std::multimap<uint64_t, size_t> &index, uint64_t height, size_t idx)
+{
+  const auto range = index.equal_range(height);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second == idx)
+    {
+      index.erase(it);
+      break;
+    }
+  }
+}
+
+void advance_short_history(std::list<crypto::hash> &short_chain_history, const std::vector<tools::wallet2::parsed_block> &prev_parsed_blocks)
+{
+  drop_from_short_history(short_chain_history, 3);
+
+  // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
+  auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
+  for (; s != prev_parsed_blocks.end(); ++s)
+  {
+    short_chain_history.push_front(s->hash);
+  }
+}
+
 size_t estimate_rct_tx_size(int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof, bool clsag, bool bulletproof_plus, bool use_view_tags)
 {
   size_t size = 0;
@@ -947,6 +992,28 @@ uint32_t get_subaddress_clamped_sum(uint32_t idx, uint32_t extra)
   return idx + extra;
 }
 
+// opening a kex message checks its signature, and the messages don't depend on each other, so
+// they are opened in parallel; the first bad message's error is rethrown as is
+std::vector<multisig::multisig_kex_msg> open_kex_msgs(const std::vector<std::string> &msgs)
+{
+  std::vector<multisig::multisig_kex_msg> expanded_msgs(msgs.size());
+  std::vector<std::exception_ptr> errors(msgs.size());
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < msgs.size(); ++i)
+  {
+    tpool.submit(&waiter, [&, i](){
+      try { expanded_msgs[i] = multisig::multisig_kex_msg{msgs[i]}; }
+      catch (...) { errors[i] = std::current_exception(); }
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), tools::error::wallet_internal_error, "Failed to open multisig kex messages");
+  for (const std::exception_ptr &e: errors)
+    if (e)
+      std::rethrow_exception(e);
+  return expanded_msgs;
+}
+
 static void setup_shim(hw::wallet_shim * shim, tools::wallet2 * wallet)
 {
   shim->get_tx_pub_key_from_received_outs = std::bind(&tools::wallet2::get_tx_pub_key_from_received_outs, wallet, std::placeholders::_1);
@@ -989,6 +1056,122 @@ bool get_pruned_tx(const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry &entry,
   return false;
 }
 
+// appends everything written to it to a string, encrypted on the fly
+class chacha20_back_insert_device
+{
+public:
+  typedef char char_type;
+  typedef boost::iostreams::sink_tag category;
+
+  chacha20_back_insert_device(std::string &s, crypto::chacha20_stream &cipher): s(s), cipher(cipher) {}
+
+  std::streamsize write(const char *data, std::streamsize n)
+  {
+    const size_t offset = s.size();
+    s.resize(offset + n);
+    cipher.update(data, n, &s[offset]);
+    return n;
+  }
+
+private:
+  std::string &s;
+  crypto::chacha20_stream &cipher;
+};
+
+#ifdef HAVE_ZSTD
+struct zstd_cstream_deleter { void operator()(ZSTD_CStream *zcs) const { ZSTD_freeCStream(zcs); } };
+struct zstd_dstream_deleter { void operator()(ZSTD_DStream *zds) const { ZSTD_freeDStream(zds); } };
+
+// compresses everything written to it, and passes the compressed data on to the cipher
+class zstd_cache_compressor
+{
+public:
+  zstd_cache_compressor(chacha20_back_insert_device &out): out(out), zcs(ZSTD_createCStream()), buffer(ZSTD_CStreamOutSize(), 0)
+  {
+    if (!zcs)
+      throw std::runtime_error("Failed to create zstd stream");
+    const size_t r = ZSTD_initCStream(zcs.get(), COMPRESSED_CACHE_ZSTD_LEVEL);
+    if (ZSTD_isError(r))
+      throw std::runtime_error(std::string("Failed to initialize zstd stream: ") + ZSTD_getErrorName(r));
+  }
+
+  void write(const char *data, size_t n)
+  {
+    ZSTD_inBuffer in = { data, n, 0 };
+    while (in.pos < in.size)
+    {
+      ZSTD_outBuffer o = { &buffer[0], buffer.size(), 0 };
+      const size_t r = ZSTD_compressStream(zcs.get(), &o, &in);
+      if (ZSTD_isError(r))
+        throw std::runtime_error(std::string("Failed to compress wallet cache: ") + ZSTD_getErrorName(r));
+      out.write(buffer.data(), o.pos);
+    }
+  }
+
+  void finish()
+  {
+    size_t r;
+    do
+    {
+      ZSTD_outBuffer o = { &buffer[0], buffer.size(), 0 };
+      r = ZSTD_endStream(zcs.get(), &o);
+      if (ZSTD_isError(r))
+        throw std::runtime_error(std::string("Failed to compress wallet cache: ") + ZSTD_getErrorName(r));
+      out.write(buffer.data(), o.pos);
+    } while (r > 0);
+  }
+
+private:
+  chacha20_back_insert_device &out;
+  std::unique_ptr<ZSTD_CStream, zstd_cstream_deleter> zcs;
+  std::string buffer;
+};
+
+class zstd_cache_compress_device
+{
+public:
+  typedef char char_type;
+  typedef boost::iostreams::sink_tag category;
+
+  zstd_cache_compress_device(zstd_cache_compressor &compressor): compressor(compressor) {}
+
+  std::streamsize write(const char *data, std::streamsize n)
+  {
+    compressor.write(data, n);
+    return n;
+  }
+
+private:
+  zstd_cache_compressor &compressor;
+};
+
+bool decompress_cache(const char *data, size_t size, std::string &out)
+{
+  std::unique_ptr<ZSTD_DStream, zstd_dstream_deleter> zds(ZSTD_createDStream());
+  if (!zds || ZSTD_isError(ZSTD_initDStream(zds.get())))
+    return false;
+  const size_t chunk = ZSTD_DStreamOutSize();
+  ZSTD_inBuffer in = { data, size, 0 };
+  size_t r = 1;
+  out.clear();
+  while (in.pos < in.size || r > 0)
+  {
+    const size_t offset = out.size();
+    out.resize(offset + chunk);
+    ZSTD_outBuffer o = { &out[offset], chunk, 0 };
+    const size_t prev_in = in.pos;
+    r = ZSTD_decompressStream(zds.get(), &o, &in);
+    out.resize(offset + o.pos);
+    if (ZSTD_isError(r))
+      return false;
+    // a truncated frame leaves data pending with no more input to make progress
+    if (r > 0 && o.pos == 0 && in.pos == prev_in)
+      return false;
+  }
+  return true;
+}
+#endif
+
   //-----------------------------------------------------------------
 } //namespace
 
@@ -997,72 +1180,6 @@ namespace tools
 constexpr const std::chrono::seconds wallet2::rpc_timeout;
 const char* wallet2::tr(const char* str) { return i18n_translate(str, "tools::wallet2"); }
 
-gamma_picker::gamma_picker(const std::vector<uint64_t> &rct_offsets, double shape, double scale):
-    rct_offsets(rct_offsets)
-{
-  gamma = std::gamma_distribution<double>(shape, scale);
-  THROW_WALLET_EXCEPTION_IF(rct_offsets.size() <= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, error::wallet_internal_error, "Bad offset calculation");
-  const size_t blocks_in_a_year = 86400 * 365 / DIFFICULTY_TARGET_V2;
-  const size_t blocks_to_consider = std::min<size_t>(rct_offsets.size(), blocks_in_a_year);
-  const size_t outputs_to_consider = rct_offsets.back() - (blocks_to_consider < rct_offsets.size() ? rct_offsets[rct_offsets.size() - blocks_to_consider - 1] : 0);
-  begin = rct_offsets.data();
-  end = rct_offsets.data() + rct_offsets.size() - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
-  num_rct_outputs = *(end - 1);
-  THROW_WALLET_EXCEPTION_IF(num_rct_outputs == 0, error::wallet_internal_error, "No rct outputs");
-  average_output_time = DIFFICULTY_TARGET_V2 * blocks_to_consider / static_cast<double>(outputs_to_consider); // this assumes constant target over the whole rct range
-};
-
-gamma_picker::gamma_picker(const std::vector<uint64_t> &rct_offsets): gamma_picker(rct_offsets, GAMMA_SHAPE, GAMMA_SCALE) {}
-
-uint64_t gamma_picker::pick()
-{
-  double x = gamma(engine);
-  x = exp(x);
-
-  if (x > DEFAULT_UNLOCK_TIME) 
-  {
-    // We are trying to select an output from the chain that appeared 'x' seconds before the
-    // current chain tip, where 'x' is selected from the gamma distribution recommended in Miller et al.
-    // (https://arxiv.org/pdf/1704.04299/).
-    // Our method is to get the average time delta between outputs in the recent past, estimate the number of
-    // outputs 'n' that would have appeared between 'chain_tip - x' and 'chain_tip', select the real output at
-    // 'current_num_outputs - n', then randomly select an output from the block where that output appears.
-    // Source code to paper: https://github.com/maltemoeser/moneropaper
-    //
-    // Due to the 'default spendable age' mechanic in Monero, 'current_num_outputs' only contains
-    // currently *unlocked* outputs, which means the earliest output that can be selected is not at the chain tip!
-    // Therefore, we must offset 'x' so it matches up with the timing of the outputs being considered. We do
-    // this by saying if 'x` equals the expected age of the first unlocked output (compared to the current
-    // chain tip - i.e. DEFAULT_UNLOCK_TIME), then select the first unlocked output.
-    x -= DEFAULT_UNLOCK_TIME;
-  }
-  else 
-  {
-    // If the spent time suggested by the gamma is less than the unlock time, that means the gamma is suggesting an output
-    // that is no longer feasible to be spent (possible since the gamma was constructed when consensus rules did not enforce the
-    // lock time). The assumption made in this code is that an output expected spent quicker than the unlock time would likely
-    // be spent within RECENT_SPEND_WINDOW after allowed. So it returns an output that falls between 0 and the RECENT_SPEND_WINDOW.
-    // The RECENT_SPEND_WINDOW was determined with empirical analysis of observed data.
-    x = crypto::rand_idx(static_cast<uint64_t>(RECENT_SPEND_WINDOW));
-  }
-
-  uint64_t output_index = x / average_output_time;
-  if (output_index >= num_rct_outputs)
-    return std::numeric_limits<uint64_t>::max(); // bad pick
-  output_index = num_rct_outputs - 1 - output_index;
-
-  const uint64_t *it = std::lower_bound(begin, end, output_index);
-  THROW_WALLET_EXCEPTION_IF(it == end, error::wallet_internal_error, "output_index not found");
-  uint64_t index = std::distance(begin, it);
-
-  const uint64_t first_rct = index == 0 ? 0 : rct_offsets[index - 1];
-  const uint64_t n_rct = rct_offsets[index] - first_rct;
-  if (n_rct == 0)
-    return std::numeric_limits<uint64_t>::max(); // bad pick
-  MTRACE("Picking 1/" << n_rct << " in block " << index);
-  return first_rct + crypto::rand_idx(n_rct);
-};
-
 boost::mutex wallet_keys_unlocker::lockers_lock;
 unsigned int wallet_keys_unlocker::lockers = 0;
 wallet_keys_unlocker::wallet_keys_unlocker(wallet2 &w, const boost::optional<tools::password_container> &password):
@@ -1151,12 +1268,95 @@ void wallet_device_callback::on_progress(const hw::device_progress& event)
     wallet->on_device_progress(event);
 }
 
+namespace
+{
+  // Block batches pulled and parsed by the wallets in this process. When several
+  // wallets refresh in step from the same daemon, each batch is downloaded and
+  // parsed once rather than once per wallet. Batches are only kept while more
+  // than one wallet exists, and only for a short while, so a reorg can't leave
+  // a stale batch around for long.
+  struct shared_block_batch
+  {
+    std::string daemon_address;
+    bool no_miner_tx;
+    uint64_t start_height;
+    std::list<crypto::hash> short_chain_history;
+    std::chrono::steady_clock::time_point added;
+    uint64_t blocks_start_height;
+    uint64_t current_height;
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<wallet2::parsed_block> parsed_blocks;
+  };
+  const size_t SHARED_BLOCK_BATCHES = 4;
+  const std::chrono::seconds SHARED_BLOCK_BATCH_LIFETIME(30);
+  boost::mutex shared_block_batches_lock;
+  std::deque<std::shared_ptr<const shared_block_batch>> shared_block_batches;
+  std::atomic<unsigned int> num_wallets(0);
+
+  std::shared_ptr<const shared_block_batch> find_shared_block_batch(const std::string &daemon_address, bool no_miner_tx, uint64_t start_height, const std::list<crypto::hash> &short_chain_history)
+  {
+    const auto now = std::chrono::steady_clock::now();
+    boost::unique_lock<boost::mutex> lock(shared_block_batches_lock);
+    while (!shared_block_batches.empty() && now - shared_block_batches.front()->added > SHARED_BLOCK_BATCH_LIFETIME)
+      shared_block_batches.pop_front();
+    for (const auto &batch: shared_block_batches)
+      if (batch->start_height == start_height && batch->no_miner_tx == no_miner_tx && batch->daemon_address == daemon_address && batch->short_chain_history == short_chain_history)
+        return batch;
+    return nullptr;
+  }
+
+  void add_shared_block_batch(std::shared_ptr<const shared_block_batch> batch)
+  {
+    boost::unique_lock<boost::mutex> lock(shared_block_batches_lock);
+    shared_block_batches.push_back(std::move(batch));
+    while (shared_block_batches.size() > SHARED_BLOCK_BATCHES)
+      shared_block_batches.pop_front();
+  }
+
+  // A span of blocks pulled by height, ahead of the batch being processed. The
+  // daemon does not tell us where a batch will end, so spans start where the
+  // last batch size says the one before should end, and a span is only used if
+  // it covers the next height and its first block there links up with ours.
+  struct prefetched_blocks
+  {
+    prefetched_blocks(tools::threadpool &tpool, uint64_t start_height, size_t connection):
+      start_height(start_height), connection(connection), blocks_start_height(0), current_height(0),
+      error(false), duration_us(0), waiter(tpool) {}
+    uint64_t start_height;
+    size_t connection;
+    uint64_t blocks_start_height;
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<wallet2::parsed_block> parsed_blocks;
+    uint64_t current_height;
+    bool error;
+    uint64_t duration_us;
+    tools::threadpool::waiter waiter;
+  };
+
+  size_t get_blocks_size(const std::vector<cryptonote::block_complete_entry> &blocks)
+  {
+    size_t bytes = 0;
+    for (const auto &bce: blocks)
+    {
+      bytes += bce.block.size();
+      for (const auto &tx: bce.txs)
+        bytes += tx.blob.size();
+    }
+    return bytes;
+  }
+}
+
 wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std::unique_ptr<epee::net_utils::http::http_client_factory> http_client_factory):
   m_http_client(http_client_factory->create()),
+  m_blocks_http_client(http_client_factory->create()),
+  m_daemon_probe_client(http_client_factory->create()),
+  m_daemon_ssl_options(epee::net_utils::ssl_support_t::e_ssl_support_autodetect),
+  m_daemon_probe_time(0),
   m_multisig_rescan_info(NULL),
   m_multisig_rescan_k(NULL),
   m_upper_transaction_weight_limit(0),
   m_run(true),
+  m_parallel_daemon_rpc(false),
   m_callback(0),
   m_trusted_daemon(false),
   m_nettype(nettype),
@@ -1221,19 +1421,39 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_use_dns(true),
   m_offline(false),
   m_rpc_version(0),
+  m_pool_revision(0),
   m_export_format(ExportFormat::Binary),
   m_load_deprecated_formats(false),
+  m_compress_cache(false),
   m_credits_target(0),
   m_enable_multisig(false),
   m_has_ever_refreshed_from_node(false),
-  m_allow_mismatched_daemon_version(false)
+  m_allow_mismatched_daemon_version(false),
+  m_rct_distribution_start_height(0),
+  m_transfer_history_valid(false),
+  m_transfer_history_generation(0),
+  m_transfer_history_next_seq(0),
+  m_transfer_history_top_height(0),
+  m_reorg_index_valid(false)
 {
+  for (size_t i = 0; i < REFRESH_PREFETCH_MAX_REQUESTS; ++i)
+  {
+    m_prefetch_connections.emplace_back(new prefetch_connection());
+    m_prefetch_connections.back()->client = http_client_factory->create();
+  }
+  m_subaddress_str_cache.set_max_size(SUBADDRESS_STR_CACHE_SIZE);
   set_rpc_client_secret_key(rct::rct2sk(rct::skGen()));
+  ++num_wallets;
 }
 
 wallet2::~wallet2()
 {
   deinit();
+  if (--num_wallets <= 1)
+  {
+    boost::unique_lock<boost::mutex> lock(shared_block_batches_lock);
+    shared_block_batches.clear();
+  }
 }
 
 bool wallet2::has_testnet_option(const boost::program_options::variables_map& vm)
@@ -1260,6 +1480,7 @@ void wallet2::init_options(boost::program_options::options_description& desc_par
 {
   const options opts{};
   command_line::add_arg(desc_params, opts.daemon_address);
+  command_line::add_arg(desc_params, opts.daemon_fallback);
   command_line::add_arg(desc_params, opts.daemon_host);
   command_line::add_arg(desc_params, opts.proxy);
   command_line::add_arg(desc_params, opts.trusted_daemon);
@@ -1333,9 +1554,18 @@ std::unique_ptr<wallet2> wallet2::make_dummy(const boost::program_options::varia
 bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_utils::http::login> daemon_login, bool trusted_daemon, epee::net_utils::ssl_options_t ssl_options)
 {
   boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
+  boost::lock_guard<boost::recursive_mutex> blocks_lock(m_daemon_blocks_rpc_mutex);
 
   if(m_http_client->is_connected())
     m_http_client->disconnect();
+  if(m_blocks_http_client->is_connected())
+    m_blocks_http_client->disconnect();
+  for (const auto &c: m_prefetch_connections)
+  {
+    const boost::lock_guard<boost::mutex> prefetch_lock{c->mutex};
+    if (c->client->is_connected())
+      c->client->disconnect();
+  }
   const bool changed = m_daemon_address != daemon_address;
   m_daemon_address = std::move(daemon_address);
   m_daemon_login = std::move(daemon_login);
@@ -1348,12 +1578,24 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
     m_rpc_payment_state.expected_spent = 0;
     m_rpc_payment_state.discrepancy = 0;
     m_rpc_version = 0;
+    m_pool_revision = 0;
     m_node_rpc_proxy.invalidate();
+    m_rct_distribution.clear();
   }
 
+  m_daemon_ssl_options = ssl_options;
+  m_daemon_fallbacks.erase(std::remove(m_daemon_fallbacks.begin(), m_daemon_fallbacks.end(), m_daemon_address), m_daemon_fallbacks.end());
+
   const std::string address = get_daemon_address();
   MINFO("setting daemon to " << address);
-  bool ret =  m_http_client->set_server(address, get_daemon_login(), std::move(ssl_options));
+  bool ret = m_blocks_http_client->set_server(address, get_daemon_login(), ssl_options);
+  for (const auto &c: m_prefetch_connections)
+  {
+    const boost::lock_guard<boost::mutex> prefetch_lock{c->mutex};
+    ret = ret && c->client->set_server(address, get_daemon_login(), ssl_options);
+  }
+  ret = ret && m_http_client->set_server(address, get_daemon_login(), std::move(ssl_options));
+  m_node_rpc_proxy.set_daemon_address(ret ? address : std::string());
   if (ret)
   {
     CRITICAL_REGION_LOCAL(default_daemon_address_lock);
@@ -1362,9 +1604,127 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
   return ret;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::set_daemon_fallbacks(std::vector<std::string> addresses)
+{
+  boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
+  m_daemon_fallbacks.clear();
+  for (std::string &address: addresses)
+  {
+    if (address != m_daemon_address && std::find(m_daemon_fallbacks.begin(), m_daemon_fallbacks.end(), address) == m_daemon_fallbacks.end())
+      m_daemon_fallbacks.push_back(std::move(address));
+  }
+  m_daemon_health.clear();
+  m_daemon_probe_time = 0;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::probe_daemon(const std::string &address, daemon_health &health)
+{
+  health.reachable = false;
+  health.consistent = false;
+  m_daemon_probe_client->disconnect();
+  auto disconnect = epee::misc_utils::create_scope_leave_handler([this](){ m_daemon_probe_client->disconnect(); });
+  if (!m_daemon_probe_client->set_server(address, m_daemon_login, m_daemon_ssl_options))
+    return false;
+  if (!m_daemon_probe_client->connect(DAEMON_PROBE_TIMEOUT))
+    return false;
+
+  cryptonote::COMMAND_RPC_GET_INFO::request req = AUTO_VAL_INIT(req);
+  cryptonote::COMMAND_RPC_GET_INFO::response res = AUTO_VAL_INIT(res);
+  const auto start = std::chrono::steady_clock::now();
+  if (!epee::net_utils::invoke_http_json("/get_info", req, res, *m_daemon_probe_client, DAEMON_PROBE_TIMEOUT) || res.status != CORE_RPC_STATUS_OK)
+    return false;
+  health.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  if (res.mainnet != (m_nettype == MAINNET) || res.testnet != (m_nettype == TESTNET) || res.stagenet != (m_nettype == STAGENET))
+  {
+    MWARNING("Daemon " << address << " is on another network, ignoring it");
+    return false;
+  }
+  health.reachable = true;
+
+  // a daemon which does not have our top block may be on another fork, or behind
+  const uint64_t top = m_blockchain.size() - 1;
+  if (m_blockchain.size() <= m_blockchain.offset() || top == 0)
+  {
+    health.consistent = true;
+    return true;
+  }
+  if (res.height <= top)
+    return true;
+  cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request hreq = AUTO_VAL_INIT(hreq);
+  cryptonote::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response hres = AUTO_VAL_INIT(hres);
+  hreq.height = top;
+  crypto::hash hash;
+  if (epee::net_utils::invoke_http_json_rpc("/json_rpc", "getblockheaderbyheight", hreq, hres, *m_daemon_probe_client, DAEMON_PROBE_TIMEOUT)
+      && hres.status == CORE_RPC_STATUS_OK && epee::string_tools::hex_to_pod(hres.block_header.hash, hash))
+    health.consistent = hash == m_blockchain[top];
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::select_daemon(bool current_failed)
+{
+  boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
+  if (m_daemon_fallbacks.empty() || m_offline || m_light_wallet)
+    return false;
+
+  const time_t now = time(NULL);
+  if (current_failed)
+  {
+    m_daemon_health[m_daemon_address].reachable = false;
+    m_daemon_health[m_daemon_address].down_until = now + DAEMON_FAILURE_BACKOFF;
+  }
+  else
+  {
+    if (now < m_daemon_probe_time + DAEMON_REPROBE_INTERVAL)
+      return false;
+    m_daemon_probe_time = now;
+    daemon_health &health = m_daemon_health[m_daemon_address];
+    if (!probe_daemon(m_daemon_address, health))
+      health.down_until = now + DAEMON_FAILURE_BACKOFF;
+  }
+
+  // prefer daemons on our chain, so the refresh carries on from the last block we have,
+  // then the fastest; a working current daemon is only left for a much faster one
+  const daemon_health &current = m_daemon_health[m_daemon_address];
+  const std::string *best = NULL;
+  daemon_health best_health;
+  for (const std::string &address: m_daemon_fallbacks)
+  {
+    daemon_health &health = m_daemon_health[address];
+    if (health.down_until > now)
+      continue;
+    if (!probe_daemon(address, health))
+    {
+      MINFO("Daemon " << address << " is not usable");
+      health.down_until = now + DAEMON_FAILURE_BACKOFF;
+      continue;
+    }
+    if (!best || (health.consistent && !best_health.consistent) || (health.consistent == best_health.consistent && health.latency_us < best_health.latency_us))
+    {
+      best = &address;
+      best_health = health;
+    }
+  }
+  if (!best)
+    return false;
+  if (current.reachable && (!best_health.consistent || (current.consistent && best_health.latency_us * DAEMON_SWITCH_LATENCY_RATIO > current.latency_us)))
+    return false;
+
+  const std::string address = *best;
+  MINFO((current_failed ? "Failing over" : "Moving") << " from daemon " << m_daemon_address << " to " << address << (best_health.consistent ? "" : ", which does not have our top block"));
+  m_daemon_fallbacks.erase(std::find(m_daemon_fallbacks.begin(), m_daemon_fallbacks.end(), address));
+  m_daemon_fallbacks.push_back(m_daemon_address);
+  return set_daemon(address, m_daemon_login, m_trusted_daemon, m_daemon_ssl_options);
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::set_proxy(const std::string &address)
 {
-  return m_http_client->set_proxy(address);
+  bool ret = m_http_client->set_proxy(address) && m_blocks_http_client->set_proxy(address);
+  for (const auto &c: m_prefetch_connections)
+  {
+    const boost::lock_guard<boost::mutex> lock{c->mutex};
+    ret = ret && c->client->set_proxy(address);
+  }
+  return ret;
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::init(std::string daemon_address, boost::optional<epee::net_utils::http::login> daemon_login, const std::string &proxy_address, uint64_t upper_transaction_weight_limit, bool trusted_daemon, epee::net_utils::ssl_options_t ssl_options)
@@ -1533,10 +1893,75 @@ crypto::public_key wallet2::get_subaddress_spend_public_key(const cryptonote::su
   return hwdev.get_subaddress_spend_public_key(m_account.get_keys(), index);
 }
 //----------------------------------------------------------------------------------------------------
+std::vector<crypto::public_key> wallet2::get_subaddress_spend_public_keys(uint32_t account, uint32_t begin, uint32_t end) const
+{
+  hw::device &hwdev = m_account.get_device();
+  const cryptonote::account_keys &keys = m_account.get_keys();
+  if (hwdev.get_type() != hw::device::device_type::SOFTWARE || end - begin < SUBADDRESS_PARALLEL_KEYS_MIN)
+    return hwdev.get_subaddress_spend_public_keys(keys, account, begin, end);
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const uint32_t chunk = std::max<uint32_t>(SUBADDRESS_PARALLEL_KEYS_MIN / 4, (end - begin + threads - 1) / threads);
+  std::vector<std::vector<crypto::public_key>> chunks((end - begin + chunk - 1) / chunk);
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    const uint32_t chunk_begin = begin + i * chunk;
+    const uint32_t chunk_end = chunk_begin + std::min(chunk, end - chunk_begin);
+    tpool.submit(&waiter, [&hwdev, &keys, &chunks, i, account, chunk_begin, chunk_end](){
+      chunks[i] = hwdev.get_subaddress_spend_public_keys(keys, account, chunk_begin, chunk_end);
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Failed to compute subaddress keys");
+
+  std::vector<crypto::public_key> pkeys;
+  pkeys.reserve(end - begin);
+  for (const auto &c: chunks)
+    pkeys.insert(pkeys.end(), c.begin(), c.end());
+  return pkeys;
+}
+//----------------------------------------------------------------------------------------------------
 std::string wallet2::get_subaddress_as_str(const cryptonote::subaddress_index& index) const
 {
+  std::string str;
+  if (m_subaddress_str_cache.get(index, str))
+    return str;
   cryptonote::account_public_address address = get_subaddress(index);
-  return cryptonote::get_account_address_as_str(m_nettype, !index.is_zero(), address);
+  str = cryptonote::get_account_address_as_str(m_nettype, !index.is_zero(), address);
+  m_subaddress_str_cache.add(index, str);
+  return str;
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<std::string> wallet2::get_subaddresses_as_str(uint32_t account, const std::vector<uint32_t> &minor_indices) const
+{
+  std::vector<std::string> addresses(minor_indices.size());
+
+  // hardware devices take one request at a time
+  hw::device &hwdev = m_account.get_device();
+  if (hwdev.get_type() != hw::device::device_type::SOFTWARE || minor_indices.size() < 2)
+  {
+    for (size_t i = 0; i < minor_indices.size(); ++i)
+      addresses[i] = get_subaddress_as_str({account, minor_indices[i]});
+    return addresses;
+  }
+
+  // the two scalar multiplications per address dwarf the encoding, so the
+  // whole address is computed per job, in chunks to keep jobs worthwhile
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const size_t chunk = std::max<size_t>(16, (minor_indices.size() + threads - 1) / threads);
+  for (size_t start = 0; start < minor_indices.size(); start += chunk)
+  {
+    const size_t end = std::min(minor_indices.size(), start + chunk);
+    tpool.submit(&waiter, [this, account, start, end, &minor_indices, &addresses](){
+      for (size_t i = start; i < end; ++i)
+        addresses[i] = get_subaddress_as_str({account, minor_indices[i]});
+    }, true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Failed to compute subaddresses");
+  return addresses;
 }
 //----------------------------------------------------------------------------------------------------
 std::string wallet2::get_integrated_address_as_str(const crypto::hash8& payment_id) const
@@ -1552,11 +1977,20 @@ void wallet2::add_subaddress_account(const std::string& label)
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::add_subaddress(uint32_t index_major, const std::string& label)
+{
+  add_subaddresses(index_major, 1, label);
+}
+//----------------------------------------------------------------------------------------------------
+uint32_t wallet2::add_subaddresses(uint32_t index_major, uint32_t count, const std::string& label)
 {
   THROW_WALLET_EXCEPTION_IF(index_major >= m_subaddress_labels.size(), error::account_index_outofbound);
-  uint32_t index_minor = (uint32_t)get_num_subaddresses(index_major);
-  expand_subaddresses({index_major, index_minor});
-  m_subaddress_labels[index_major][index_minor] = label;
+  THROW_WALLET_EXCEPTION_IF(count == 0, error::wallet_internal_error, "No subaddresses to add");
+  const uint32_t first_minor = (uint32_t)get_num_subaddresses(index_major);
+  THROW_WALLET_EXCEPTION_IF(count - 1 > std::numeric_limits<uint32_t>::max() - first_minor, error::address_index_outofbound);
+  expand_subaddresses({index_major, first_minor + (count - 1)});
+  for (uint32_t i = 0; i < count; ++i)
+    m_subaddress_labels[index_major][first_minor + i] = label;
+  return first_minor;
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::should_expand(const cryptonote::subaddress_index &index) const
@@ -1573,16 +2007,16 @@ bool wallet2::should_expand(const cryptonote::subaddress_index &index) const
 //----------------------------------------------------------------------------------------------------
 void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
 {
-  hw::device &hwdev = m_account.get_device();
   if (m_subaddress_labels.size() <= index.major)
   {
     // add new accounts
     cryptonote::subaddress_index index2;
     const uint32_t major_end = get_subaddress_clamped_sum(index.major, m_subaddress_lookahead_major);
+    m_subaddresses.reserve(m_subaddresses.size() + (size_t)(major_end - m_subaddress_labels.size()) * m_subaddress_lookahead_minor + index.minor);
     for (index2.major = m_subaddress_labels.size(); index2.major < major_end; ++index2.major)
     {
       const uint32_t end = get_subaddress_clamped_sum((index2.major == index.major ? index.minor : 0), m_subaddress_lookahead_minor);
-      const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, 0, end);
+      const std::vector<crypto::public_key> pkeys = get_subaddress_spend_public_keys(index2.major, 0, end);
       for (index2.minor = 0; index2.minor < end; ++index2.minor)
       {
          const crypto::public_key &D = pkeys[index2.minor];
@@ -1599,7 +2033,8 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
     const uint32_t end = get_subaddress_clamped_sum(index.minor, m_subaddress_lookahead_minor);
     const uint32_t begin = m_subaddress_labels[index.major].size();
     cryptonote::subaddress_index index2 = {index.major, begin};
-    const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, index2.minor, end);
+    const std::vector<crypto::public_key> pkeys = get_subaddress_spend_public_keys(index2.major, index2.minor, end);
+    m_subaddresses.reserve(m_subaddresses.size() + pkeys.size());
     for (; index2.minor < end; ++index2.minor)
     {
        const crypto::public_key &D = pkeys[index2.minor - begin];
@@ -1627,11 +2062,9 @@ std::string wallet2::get_subaddress_label(const cryptonote::subaddress_index& in
 //----------------------------------------------------------------------------------------------------
 void wallet2::scan_tx(const std::vector<crypto::hash> &txids)
 {
-  // Get the transactions from daemon in batches and add them to a priority queue ordered in chronological order
-  auto cmp_tx_entry = [](const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry& l, const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry& r)
-  { return l.block_height > r.block_height; };
-
-  std::priority_queue<cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry, std::vector<COMMAND_RPC_GET_TRANSACTIONS::entry>, decltype(cmp_tx_entry)> txq(cmp_tx_entry);
+  // Get the transactions from daemon in batches, to be processed in chronological order
+  std::vector<cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry> entries;
+  entries.reserve(txids.size());
   const size_t SLICE_SIZE =  100; // RESTRICTED_TRANSACTIONS_COUNT as defined in rpc/core_rpc_server.cpp, hardcoded in daemon code
   for(size_t slice = 0; slice < txids.size(); slice += SLICE_SIZE) {
     cryptonote::COMMAND_RPC_GET_TRANSACTIONS::request req = AUTO_VAL_INIT(req);
@@ -1652,17 +2085,27 @@ void wallet2::scan_tx(const std::vector<crypto::hash> &txids)
     }
 
     for (auto& tx_info : res.txs)
-      txq.push(tx_info);
+      entries.push_back(std::move(tx_info));
   }
+  std::stable_sort(entries.begin(), entries.end(), [](const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry& l, const cryptonote::COMMAND_RPC_GET_TRANSACTIONS::entry& r)
+  { return l.block_height < r.block_height; });
+
+  // decoding does not depend on wallet state, so it can run ahead in parallel
+  std::vector<cryptonote::transaction> txs(entries.size());
+  std::vector<crypto::hash> tx_hashes(entries.size());
+  std::unique_ptr<bool[]> parsed(new bool[entries.size()]);
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  for (size_t i = 0; i < entries.size(); ++i)
+    tpool.submit(&waiter, [&, i](){ parsed[i] = get_pruned_tx(entries[i], txs[i], tx_hashes[i]); }, true);
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Failed to decode transactions from daemon");
 
   // Process the transactions in chronologically ascending order
-  while(!txq.empty()) {
-    auto& tx_info = txq.top();
-    cryptonote::transaction tx;
-    crypto::hash tx_hash;
-    THROW_WALLET_EXCEPTION_IF(!get_pruned_tx(tx_info, tx, tx_hash), error::wallet_internal_error, "Failed to get transaction from daemon (2)");
-    process_new_transaction(tx_hash, tx, tx_info.output_indices, tx_info.block_height, 0, tx_info.block_timestamp, false, tx_info.in_pool, tx_info.double_spend_seen, {}, {});
-    txq.pop();
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    const auto& tx_info = entries[i];
+    THROW_WALLET_EXCEPTION_IF(!parsed[i], error::wallet_internal_error, "Failed to get transaction from daemon (2)");
+    process_new_transaction(tx_hashes[i], txs[i], tx_info.output_indices, tx_info.block_height, 0, tx_info.block_timestamp, false, tx_info.in_pool, tx_info.double_spend_seen, {}, {});
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -1696,6 +2139,12 @@ void wallet2::set_spent(size_t idx, uint64_t height)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid index");
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
+  if (m_reorg_index_valid)
+  {
+    if (td.m_spent)
+      erase_index_entry(m_spent_index, td.m_spent_height, idx);
+    m_spent_index.emplace(height, idx);
+  }
   td.m_spent = true;
   td.m_spent_height = height;
 }
@@ -1705,6 +2154,8 @@ void wallet2::set_unspent(size_t idx)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid index");
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
+  if (m_reorg_index_valid && td.m_spent)
+    erase_index_entry(m_spent_index, td.m_spent_height, idx);
   td.m_spent = false;
   td.m_spent_height = 0;
 }
@@ -1915,11 +2366,12 @@ void wallet2::scan_output(const cryptonote::transaction &tx, bool miner_tx, cons
 //----------------------------------------------------------------------------------------------------
 void wallet2::cache_tx_data(const cryptonote::transaction& tx, const crypto::hash &txid, tx_cache_data &tx_cache_data) const
 {
-  if(!parse_tx_extra(tx.extra, tx_cache_data.tx_extra_fields))
+  PERF_TIMER_AGG(cache_tx_data);
+  if(!tx_cache_data.tx_extra.parse(epee::to_span(tx.extra)))
   {
-    // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
+    // Extra may only be partially parsed, it's OK if tx_extra contains public key
     LOG_PRINT_L0("Transaction extra has unsupported format: " << txid);
-    if (tx_cache_data.tx_extra_fields.empty())
+    if (tx_cache_data.tx_extra.empty())
       return;
   }
 
@@ -1933,17 +2385,17 @@ void wallet2::cache_tx_data(const cryptonote::transaction& tx, const crypto::has
       // if tx.vout is not empty, we loop through all tx pubkeys
       const std::vector<boost::optional<cryptonote::subaddress_receive_info>> rec(rec_size, boost::none);
 
-      tx_extra_pub_key pub_key_field;
+      crypto::public_key pub_key;
       size_t pk_index = 0;
-      while (find_tx_extra_field_by_type(tx_cache_data.tx_extra_fields, pub_key_field, pk_index++))
-        tx_cache_data.primary.push_back({pub_key_field.pub_key, {}, rec});
+      while (tx_cache_data.tx_extra.get_pub_key(pub_key, pk_index++))
+        tx_cache_data.primary.push_back({pub_key, {}, rec});
 
       // additional tx pubkeys and derivations for multi-destination transfers involving one or more subaddresses
-      tx_extra_additional_pub_keys additional_tx_pub_keys;
-      if (find_tx_extra_field_by_type(tx_cache_data.tx_extra_fields, additional_tx_pub_keys))
+      const size_t num_additional = tx_cache_data.tx_extra.additional_pub_key_count();
+      for (size_t i = 0; i < num_additional; ++i)
       {
-        for (size_t i = 0; i < additional_tx_pub_keys.data.size(); ++i)
-          tx_cache_data.additional.push_back({additional_tx_pub_keys.data[i], {}, {}});
+        tx_cache_data.tx_extra.get_additional_pub_key(i, pub_key);
+        tx_cache_data.additional.push_back({pub_key, {}, {}});
       }
     }
   }
@@ -1965,7 +2417,7 @@ bool wallet2::spends_one_of_ours(const cryptonote::transaction &tx) const
 //----------------------------------------------------------------------------------------------------
 void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote::transaction& tx, const std::vector<uint64_t> &o_indices, uint64_t height, uint8_t block_version, uint64_t ts, bool miner_tx, bool pool, bool double_spend_seen, const tx_cache_data &tx_cache_data, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
-  PERF_TIMER(process_new_transaction);
+  PERF_TIMER_AGG(process_new_transaction);
   // In this function, tx (probably) only contains the base information
   // (that is, the prunable stuff may or may not be included)
   if (!miner_tx && !pool)
@@ -1978,16 +2430,16 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
   crypto::public_key tx_pub_key = null_pkey;
   bool notify = false;
 
-  std::vector<tx_extra_field> local_tx_extra_fields;
-  if (tx_cache_data.tx_extra_fields.empty())
+  tx_extra_view local_tx_extra;
+  if (tx_cache_data.tx_extra.empty())
   {
-    if(!parse_tx_extra(tx.extra, local_tx_extra_fields))
+    if(!local_tx_extra.parse(epee::to_span(tx.extra)))
     {
-      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
+      // Extra may only be partially parsed, it's OK if tx_extra contains public key
       LOG_PRINT_L0("Transaction extra has unsupported format: " << txid);
     }
   }
-  const std::vector<tx_extra_field> &tx_extra_fields = tx_cache_data.tx_extra_fields.empty() ? local_tx_extra_fields : tx_cache_data.tx_extra_fields;
+  const tx_extra_view &tx_extra = tx_cache_data.tx_extra.empty() ? local_tx_extra : tx_cache_data.tx_extra;
 
   // Don't try to extract tx public key if tx has no ouputs
   size_t pk_index = 0;
@@ -1999,8 +2451,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
     std::vector<size_t> outs;
     // if tx.vout is not empty, we loop through all tx pubkeys
 
-    tx_extra_pub_key pub_key_field;
-    if(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index++))
+    crypto::public_key pub_key;
+    if(!tx_extra.get_pub_key(pub_key, pk_index++))
     {
       if (pk_index > 1)
         break;
@@ -2011,12 +2463,12 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
     }
     if (!tx_cache_data.primary.empty())
     {
-      THROW_WALLET_EXCEPTION_IF(tx_cache_data.primary.size() < pk_index || pub_key_field.pub_key != tx_cache_data.primary[pk_index - 1].pkey,
+      THROW_WALLET_EXCEPTION_IF(tx_cache_data.primary.size() < pk_index || pub_key != tx_cache_data.primary[pk_index - 1].pkey,
           error::wallet_internal_error, "tx_cache_data is out of sync");
     }
 
     int num_vouts_received = 0;
-    tx_pub_key = pub_key_field.pub_key;
+    tx_pub_key = pub_key;
     const cryptonote::account_keys& keys = m_account.get_keys();
     crypto::key_derivation derivation;
 
@@ -2040,16 +2492,15 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
       if (pk_index == 1)
       {
         // additional tx pubkeys and derivations for multi-destination transfers involving one or more subaddresses
-        if (find_tx_extra_field_by_type(tx_extra_fields, additional_tx_pub_keys))
+        additional_tx_pub_keys.data.resize(tx_extra.additional_pub_key_count());
+        for (size_t i = 0; i < additional_tx_pub_keys.data.size(); ++i)
         {
-          for (size_t i = 0; i < additional_tx_pub_keys.data.size(); ++i)
+          tx_extra.get_additional_pub_key(i, additional_tx_pub_keys.data[i]);
+          additional_derivations.push_back({});
+          if (!hwdev.generate_key_derivation(additional_tx_pub_keys.data[i], keys.m_view_secret_key, additional_derivations.back()))
           {
-            additional_derivations.push_back({});
-            if (!hwdev.generate_key_derivation(additional_tx_pub_keys.data[i], keys.m_view_secret_key, additional_derivations.back()))
-            {
-              MWARNING("Failed to generate key derivation from additional tx pubkey in " << txid << ", skipping");
-              memcpy(&additional_derivations.back(), rct::identity().bytes, sizeof(crypto::key_derivation));
-            }
+            MWARNING("Failed to generate key derivation from additional tx pubkey in " << txid << ", skipping");
+            memcpy(&additional_derivations.back(), rct::identity().bytes, sizeof(crypto::key_derivation));
           }
         }
       }
@@ -2357,7 +2808,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 
     if (!pool && m_track_uses)
     {
-      PERF_TIMER(track_uses);
+      PERF_TIMER_AGG(track_uses);
       const uint64_t amount = in_to_key.amount;
       std::vector<uint64_t> offsets = cryptonote::relative_output_offsets_to_absolute(in_to_key.key_offsets);
       if (output_tracker_cache)
@@ -2370,16 +2821,25 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             size_t idx = i->second;
             THROW_WALLET_EXCEPTION_IF(idx >= m_transfers.size(), error::wallet_internal_error, "Output tracker cache index out of range");
             m_transfers[idx].m_uses.push_back(std::make_pair(height, txid));
+            if (m_reorg_index_valid)
+              m_uses_index.emplace(height, idx);
           }
         }
       }
-      else for (transfer_details &td: m_transfers)
+      else for (size_t idx = 0; idx < m_transfers.size(); ++idx)
       {
+        transfer_details &td = m_transfers[idx];
         if (amount != in_to_key.amount)
           continue;
         for (uint64_t offset: offsets)
+        {
           if (offset == td.m_global_output_index)
+          {
             td.m_uses.push_back(std::make_pair(height, txid));
+            if (m_reorg_index_valid)
+              m_uses_index.emplace(height, idx);
+          }
+        }
       }
     }
   }
@@ -2421,12 +2881,10 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
   // create payment_details for each incoming transfer to a subaddress index
   if (tx_money_got_in_outs.size() > 0)
   {
-    tx_extra_nonce extra_nonce;
     crypto::hash payment_id = null_hash;
-    if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
     {
       crypto::hash8 payment_id8 = null_hash8;
-      if(get_encrypted_payment_id_from_tx_extra_nonce(extra_nonce.nonce, payment_id8))
+      if(tx_extra.get_encrypted_payment_id(payment_id8))
       {
         // We got a payment ID to go with this tx
         LOG_PRINT_L2("Found encrypted payment ID: " << payment_id8);
@@ -2451,7 +2909,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           LOG_PRINT_L1("No public key found in tx, unable to decrypt payment id");
         }
       }
-      else if (get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, payment_id))
+      else if (tx_extra.get_payment_id(payment_id))
       {
         bool ignore = block_version >= IGNORE_LONG_PAYMENT_ID_FROM_BLOCK_VERSION;
         if (ignore)
@@ -2502,7 +2960,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+        add_to_transfer_history(*m_payments.emplace(payment_id, payment));
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2528,7 +2986,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
   if(unconf_it != m_unconfirmed_txs.end()) {
     if (store_tx_info()) {
       try {
-        m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        const auto entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        if (entry.second)
+          add_to_transfer_history(*entry.first);
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2542,6 +3002,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
   std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
+  // an entry already indexed under another height has to move
+  if (!entry.second && entry.first->second.m_block_height != height)
+    invalidate_transfer_history();
   // fill with the info we know, some info might already be there
   if (entry.second)
   {
@@ -2555,14 +3018,10 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
       entry.first->second.m_amount_out = spent - tx.rct_signatures.txnFee;
     entry.first->second.m_change = received;
 
-    std::vector<tx_extra_field> tx_extra_fields;
-    parse_tx_extra(tx.extra, tx_extra_fields); // ok if partially parsed
-    tx_extra_nonce extra_nonce;
-    if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
-    {
-      // we do not care about failure here
-      get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, entry.first->second.m_payment_id);
-    }
+    tx_extra_view tx_extra;
+    tx_extra.parse(epee::to_span(tx.extra)); // ok if partially parsed
+    // we do not care about failure here
+    tx_extra.get_payment_id(entry.first->second.m_payment_id);
     entry.first->second.m_subaddr_account = subaddr_account;
     entry.first->second.m_subaddr_indices = subaddr_indices;
   }
@@ -2578,6 +3037,8 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
   entry.first->second.m_block_height = height;
   entry.first->second.m_timestamp = ts;
   entry.first->second.m_unlock_time = tx.unlock_time;
+  if (entry.second)
+    add_to_transfer_history(*entry.first);
 
   add_rings(tx);
 }
@@ -2676,6 +3137,17 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   req.start_height = start_height;
   req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
 
+  if (m_parallel_daemon_rpc)
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_blocks_rpc_mutex};
+    req.client = get_client_signature();
+    bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *m_blocks_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "getblocks.bin", error::get_blocks_error, get_rpc_status(res.status));
+    THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.output_indices.size(), error::wallet_internal_error,
+        "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and output_indices (" +
+        boost::lexical_cast<std::string>(res.output_indices.size()) + ") sizes from daemon");
+  }
+  else
   {
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     uint64_t pre_call_credits = m_rpc_payment_state.credits;
@@ -2705,6 +3177,14 @@ void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height,
 
   req.start_height = start_height;
 
+  if (m_parallel_daemon_rpc)
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_blocks_rpc_mutex};
+    req.client = get_client_signature();
+    bool r = net_utils::invoke_http_bin("/gethashes.bin", req, res, *m_blocks_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "gethashes.bin", error::get_hashes_error, get_rpc_status(res.status));
+  }
+  else
   {
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     req.client = get_client_signature();
@@ -2734,27 +3214,6 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   for (size_t i = 0; i < blocks.size(); ++i)
     num_txes += 1 + parsed_blocks[i].txes.size();
   tx_cache_data.resize(num_txes);
-  size_t txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
-  {
-    THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
-        error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
-    if (should_skip_block(parsed_blocks[i].block, start_height + i))
-    {
-      txidx += 1 + parsed_blocks[i].block.tx_hashes.size();
-      continue;
-    }
-    if (m_refresh_type != RefreshNoCoinbase)
-      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); });
-    ++txidx;
-    for (size_t idx = 0; idx < parsed_blocks[i].txes.size(); ++idx)
-    {
-      tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); });
-      ++txidx;
-    }
-  }
-  THROW_WALLET_EXCEPTION_IF(txidx != num_txes, error::wallet_internal_error, "txidx does not match tx_cache_data size");
-  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
   hw::device &hwdev =  m_account.get_device();
   hw::reset_mode rst(hwdev);
@@ -2770,107 +3229,164 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     }
   };
 
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
-  {
-    if (tx_cache_data[i].empty())
-      continue;
-    tpool.submit(&waiter, [&gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      for (auto &iod: slot.primary)
-        gender(iod);
-      for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
-  }
-  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-
+  static const std::vector<crypto::key_derivation> no_additional_derivations;
   auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
+    const auto &primary = tx_cache_data[txidx].primary;
+    std::vector<crypto::key_derivation> additional_derivations;
+    additional_derivations.reserve(tx_cache_data[txidx].additional.size());
+    for (const auto &iod: tx_cache_data[txidx].additional)
+      additional_derivations.push_back(iod.derivation);
     for (size_t k = 0; k < n_vouts; ++k)
     {
       const auto &o = tx.vout[k];
+      const boost::optional<crypto::view_tag> view_tag_opt = get_output_view_tag(o);
+
+      // Check the view tag against every derivation first, so outputs which are
+      // not ours (all but about 1 in 256 once view tags are in) are ruled out
+      // before deriving any output public key
+      if (view_tag_opt)
+      {
+        bool candidate = false;
+        for (size_t l = 0; l < primary.size() && !candidate; ++l)
+          candidate = out_can_be_to_acc(view_tag_opt, primary[l].derivation, k, &hwdev);
+        if (!candidate && !primary.empty() && k < additional_derivations.size())
+          candidate = out_can_be_to_acc(view_tag_opt, additional_derivations[k], k, &hwdev);
+        if (!candidate)
+          continue;
+      }
+
       crypto::public_key output_public_key;
       if (get_output_public_key(o, output_public_key))
       {
-        std::vector<crypto::key_derivation> additional_derivations;
-        additional_derivations.reserve(tx_cache_data[txidx].additional.size());
-        for (const auto &iod: tx_cache_data[txidx].additional)
-          additional_derivations.push_back(iod.derivation);
-        for (size_t l = 0; l < tx_cache_data[txidx].primary.size(); ++l)
+        // additional derivations are only tried along with the first tx pubkey
+        for (size_t l = 0; l < primary.size(); ++l)
         {
-          THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
+          THROW_WALLET_EXCEPTION_IF(primary[l].received.size() != n_vouts,
               error::wallet_internal_error, "Unexpected received array size");
-          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(m_subaddresses, output_public_key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev, get_output_view_tag(o));
-          additional_derivations.clear();
+          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(m_subaddresses, output_public_key, primary[l].derivation,
+              l == 0 ? additional_derivations : no_additional_derivations, k, hwdev, view_tag_opt);
         }
       }
     }
   };
-  struct geniod_params
+
+  // Each tx is scanned start to finish by a single task: parsing the extra, generating the
+  // derivations and checking the outputs. Txes are grouped into consecutive chunks of about
+  // the same estimated cost, and the workers pull the next chunk off a shared counter as they
+  // go, so a few large txes don't leave the other threads idle waiting on a phase barrier.
+  // Outputs before view tags need a full key derivation each, which dwarfs the cost of
+  // parsing the tx, while view tag outputs are mostly a hash.
+  static constexpr uint64_t SCAN_TX_WEIGHT = 8;
+  static constexpr uint64_t SCAN_OUTPUT_WEIGHT = 8;
+  static constexpr uint64_t SCAN_VIEW_TAG_OUTPUT_WEIGHT = 1;
+  static constexpr uint64_t SCAN_CHUNKS_PER_THREAD = 8;
+  struct scan_unit
   {
     const cryptonote::transaction &tx;
-    size_t n_outs;
+    crypto::hash txid;
+    size_t n_vouts;
     size_t txidx;
+    uint64_t weight;
   };
-  std::vector<geniod_params> geniods;
-  geniods.reserve(num_txes);
+  std::vector<scan_unit> units;
+  units.reserve(num_txes);
+  uint64_t total_weight = 0;
 
-  txidx = 0;
-  uint8_t hf_version_view_tags = get_view_tag_fork();
+  size_t txidx = 0;
+  const uint8_t hf_version_view_tags = get_view_tag_fork();
   for (size_t i = 0; i < blocks.size(); ++i)
   {
+    THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
+        error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
     if (should_skip_block(parsed_blocks[i].block, start_height + i))
     {
       txidx += 1 + parsed_blocks[i].block.tx_hashes.size();
       continue;
     }
 
+    const uint64_t output_weight = parsed_blocks[i].block.major_version >= hf_version_view_tags ? SCAN_VIEW_TAG_OUTPUT_WEIGHT : SCAN_OUTPUT_WEIGHT;
     if (m_refresh_type != RefreshType::RefreshNoCoinbase)
     {
-      THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
       const cryptonote::transaction& tx = parsed_blocks[i].block.miner_tx;
       const size_t n_vouts = (m_refresh_type == RefreshType::RefreshOptimizeCoinbase && tx.version < 2) ? 1 : tx.vout.size();
-      if (parsed_blocks[i].block.major_version >= hf_version_view_tags)
-        geniods.push_back(geniod_params{ tx, n_vouts, txidx });
-      else
-        tpool.submit(&waiter, [&, n_vouts, txidx](){ geniod(tx, n_vouts, txidx); }, true);
+      units.push_back(scan_unit{ tx, get_transaction_hash(tx), n_vouts, txidx, SCAN_TX_WEIGHT + n_vouts * output_weight });
+      total_weight += units.back().weight;
     }
     ++txidx;
     for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
     {
-      THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
-      if (parsed_blocks[i].block.major_version >= hf_version_view_tags)
-        geniods.push_back(geniod_params{ parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx });
-      else
-        tpool.submit(&waiter, [&, i, j, txidx](){ geniod(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx); }, true);
+      const cryptonote::transaction& tx = parsed_blocks[i].txes[j];
+      units.push_back(scan_unit{ tx, parsed_blocks[i].block.tx_hashes[j], tx.vout.size(), txidx, SCAN_TX_WEIGHT + tx.vout.size() * output_weight });
+      total_weight += units.back().weight;
       ++txidx;
     }
   }
-  THROW_WALLET_EXCEPTION_IF(txidx != tx_cache_data.size(), error::wallet_internal_error, "txidx did not reach expected value");
+  THROW_WALLET_EXCEPTION_IF(txidx != num_txes, error::wallet_internal_error, "txidx does not match tx_cache_data size");
 
-  // View tags significantly speed up the geniod function that determines if an output belongs to the account.
-  // Because the speedup is so large, the overhead from submitting individual geniods to the thread pool eats into
-  // the benefit of executing in parallel. So to maximize the benefit from threads when view tags are enabled,
-  // the wallet starts submitting geniod function calls to the thread pool in batches of size GENIOD_BATCH_SIZE.
-  if (geniods.size())
+  if (!units.empty())
   {
-    size_t GENIOD_BATCH_SIZE = 100;
-    size_t num_batch_txes = 0;
-    size_t batch_start = 0;
-    while (batch_start < geniods.size())
+    const uint64_t threads = std::max(1u, tpool.get_max_concurrency());
+    const uint64_t chunk_weight = std::max<uint64_t>(1, total_weight / (threads * SCAN_CHUNKS_PER_THREAD));
+    std::vector<size_t> chunk_starts;
+    uint64_t weight = chunk_weight;
+    for (size_t u = 0; u < units.size(); ++u)
+    {
+      if (weight >= chunk_weight)
+      {
+        chunk_starts.push_back(u);
+        weight = 0;
+      }
+      weight += units[u].weight;
+    }
+    chunk_starts.push_back(units.size());
+    const size_t num_chunks = chunk_starts.size() - 1;
+
+    std::atomic<size_t> next_chunk(0);
+    const size_t num_workers = std::min<uint64_t>(threads, num_chunks);
+    for (size_t w = 0; w < num_workers; ++w)
     {
-      size_t batch_end = std::min(batch_start + GENIOD_BATCH_SIZE, geniods.size());
-      THROW_WALLET_EXCEPTION_IF(batch_end < batch_start, error::wallet_internal_error, "Thread batch end overflow");
-      tpool.submit(&waiter, [&geniods, &geniod, batch_start, batch_end]() {
-        for (size_t i = batch_start; i < batch_end; ++i)
+      tpool.submit(&waiter, [&]() {
+        std::vector<wallet2::is_out_data*> iods;
+        std::vector<crypto::public_key> pkeys;
+        std::vector<crypto::key_derivation> derivations;
+        for (size_t c = next_chunk++; c < num_chunks; c = next_chunk++)
         {
-          const geniod_params &gp = geniods[i];
-          geniod(gp.tx, gp.n_outs, gp.txidx);
+          // the derivations of the whole chunk are generated in a single device call
+          iods.clear();
+          for (size_t u = chunk_starts[c]; u < chunk_starts[c + 1]; ++u)
+          {
+            const scan_unit &su = units[u];
+            auto &slot = tx_cache_data[su.txidx];
+            cache_tx_data(su.tx, su.txid, slot);
+            for (auto &iod: slot.primary)
+              iods.push_back(&iod);
+            for (auto &iod: slot.additional)
+              iods.push_back(&iod);
+          }
+          pkeys.resize(iods.size());
+          derivations.resize(iods.size());
+          for (size_t k = 0; k < iods.size(); ++k)
+            pkeys[k] = iods[k]->pkey;
+          if (hwdev.generate_key_derivations(epee::to_span(pkeys), keys.m_view_secret_key, epee::to_mut_span(derivations)))
+          {
+            for (size_t k = 0; k < iods.size(); ++k)
+              iods[k]->derivation = derivations[k];
+          }
+          else
+          {
+            // some tx pubkey is invalid, find out which one by going one at a time
+            for (wallet2::is_out_data *iod: iods)
+              gender(*iod);
+          }
+          for (size_t u = chunk_starts[c]; u < chunk_starts[c + 1]; ++u)
+          {
+            const scan_unit &su = units[u];
+            if (!tx_cache_data[su.txidx].empty())
+              geniod(su.tx, su.n_vouts, su.txidx);
+          }
         }
       }, true);
-      num_batch_txes += batch_end - batch_start;
-      batch_start = batch_end;
     }
-    THROW_WALLET_EXCEPTION_IF(num_batch_txes != geniods.size(), error::wallet_internal_error, "txes batched for thread pool did not reach expected value");
   }
   THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
@@ -2944,7 +3460,65 @@ void check_block_hard_fork_version(cryptonote::network_type nettype, uint8_t hf_
   daemon_is_outdated = height < start_height || height >= end_height;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
+void wallet2::parse_pulled_blocks(uint64_t blocks_start_height, const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<parsed_block> &parsed_blocks, bool &error)
+{
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  tools::threadpool::waiter waiter(tpool);
+  parsed_blocks.resize(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
+      std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    if (parsed_blocks[i].error)
+    {
+      error = true;
+      break;
+    }
+
+    if (!m_allow_mismatched_daemon_version)
+    {
+      // make sure block's hard fork version is expected at the block's height
+      uint8_t hf_version = parsed_blocks[i].block.major_version;
+      uint64_t height = blocks_start_height + i;
+      bool wallet_is_outdated = false;
+      bool daemon_is_outdated = false;
+      check_block_hard_fork_version(m_nettype, hf_version, height, wallet_is_outdated, daemon_is_outdated);
+      THROW_WALLET_EXCEPTION_IF(wallet_is_outdated || daemon_is_outdated, error::incorrect_fork_version,
+        "Unexpected hard fork version v" + std::to_string(hf_version) + " at height " + std::to_string(height) + ". " +
+        (wallet_is_outdated
+          ? "Make sure your wallet is up to date"
+          : "Make sure the node you are connected to is running the latest version")
+      );
+    }
+
+    parsed_blocks[i].o_indices = std::move(o_indices[i]);
+  }
+
+  boost::mutex error_lock;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    parsed_blocks[i].txes.resize(blocks[i].txs.size());
+    for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+    {
+      tpool.submit(&waiter, [&, i, j](){
+        if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j].blob, parsed_blocks[i].txes[j]))
+        {
+          boost::unique_lock<boost::mutex> lock(error_lock);
+          error = true;
+        }
+      }, true);
+    }
+  }
+  THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t &current_height, bool &last, bool &error, std::exception_ptr &exception)
 {
   error = false;
   last = false;
@@ -2952,81 +3526,88 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
 
   try
   {
-    drop_from_short_history(short_chain_history, 3);
-
     THROW_WALLET_EXCEPTION_IF(prev_blocks.size() != prev_parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
 
-    // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-    auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
-    for (; s != prev_parsed_blocks.end(); ++s)
+    advance_short_history(short_chain_history, prev_parsed_blocks);
+
+    // another wallet may just have pulled the same blocks from the same daemon
+    const bool share_blocks = num_wallets > 1;
+    const bool no_miner_tx = m_refresh_type == RefreshNoCoinbase;
+    if (share_blocks)
     {
-      short_chain_history.push_front(s->hash);
+      std::shared_ptr<const shared_block_batch> batch = find_shared_block_batch(m_daemon_address, no_miner_tx, start_height, short_chain_history);
+      if (batch)
+      {
+        MDEBUG("Using blocks already pulled by another wallet: blocks_start_height " << batch->blocks_start_height << ", count " << batch->blocks.size());
+        blocks_start_height = batch->blocks_start_height;
+        blocks = batch->blocks;
+        parsed_blocks = batch->parsed_blocks;
+        current_height = batch->current_height;
+        last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == batch->current_height;
+        return;
+      }
     }
 
     // pull the new blocks
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
-    uint64_t current_height;
     pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, current_height);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+    parse_pulled_blocks(blocks_start_height, blocks, o_indices, parsed_blocks, error);
+    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
 
-    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
-    tools::threadpool::waiter waiter(tpool);
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
+    if (share_blocks && !error && !blocks.empty())
     {
-      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
-        std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+      auto batch = std::make_shared<shared_block_batch>();
+      batch->daemon_address = m_daemon_address;
+      batch->no_miner_tx = no_miner_tx;
+      batch->start_height = start_height;
+      batch->short_chain_history = short_chain_history;
+      batch->added = std::chrono::steady_clock::now();
+      batch->blocks_start_height = blocks_start_height;
+      batch->current_height = current_height;
+      batch->blocks = blocks;
+      batch->parsed_blocks = parsed_blocks;
+      add_shared_block_batch(std::move(batch));
     }
-    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-      if (parsed_blocks[i].error)
-      {
-        error = true;
-        break;
-      }
-
-      if (!m_allow_mismatched_daemon_version)
-      {
-        // make sure block's hard fork version is expected at the block's height
-        uint8_t hf_version = parsed_blocks[i].block.major_version;
-        uint64_t height = blocks_start_height + i;
-        bool wallet_is_outdated = false;
-        bool daemon_is_outdated = false;
-        check_block_hard_fork_version(m_nettype, hf_version, height, wallet_is_outdated, daemon_is_outdated);
-        THROW_WALLET_EXCEPTION_IF(wallet_is_outdated || daemon_is_outdated, error::incorrect_fork_version,
-          "Unexpected hard fork version v" + std::to_string(hf_version) + " at height " + std::to_string(height) + ". " +
-          (wallet_is_outdated
-            ? "Make sure your wallet is up to date"
-            : "Make sure the node you are connected to is running the latest version")
-        );
-      }
+  }
+  catch(...)
+  {
+    error = true;
+    exception = std::current_exception();
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_and_parse_blocks_at(uint64_t start_height, size_t connection, uint64_t &blocks_start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t &current_height, bool &error)
+{
+  error = false;
 
-      parsed_blocks[i].o_indices = std::move(o_indices[i]);
-    }
+  try
+  {
+    // a start height makes the daemon ignore the chain history, so none is sent
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+    req.prune = true;
+    req.start_height = start_height;
+    req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
 
-    boost::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
     {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
-      {
-        tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j].blob, parsed_blocks[i].txes[j]))
-          {
-            boost::unique_lock<boost::mutex> lock(error_lock);
-            error = true;
-          }
-        }, true);
-      }
+      prefetch_connection &c = *m_prefetch_connections[connection];
+      const boost::lock_guard<boost::mutex> lock{c.mutex};
+      req.client = get_client_signature();
+      bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *c.client, rpc_timeout);
+      THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "getblocks.bin", error::get_blocks_error, get_rpc_status(res.status));
     }
-    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
-    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
+
+    blocks_start_height = res.start_height;
+    blocks = std::move(res.blocks);
+    current_height = res.current_height;
+    MDEBUG("Prefetched blocks: blocks_start_height " << blocks_start_height << ", count " << blocks.size() << ", node height " << current_height);
+
+    parse_pulled_blocks(blocks_start_height, blocks, res.output_indices, parsed_blocks, error);
   }
-  catch(...)
+  catch (const std::exception &e)
   {
+    MDEBUG("Failed to prefetch blocks from height " << start_height << ": " << e.what());
     error = true;
-    exception = std::current_exception();
   }
 }
 
@@ -3058,26 +3639,58 @@ void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashe
 }
 
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> &process_txs, bool refreshed)
+std::vector<crypto::hash> wallet2::get_pool_hashes()
 {
-  MTRACE("update_pool_state start");
-
-  auto keys_reencryptor = epee::misc_utils::create_scope_leave_handler([&, this]() {
-    m_encrypt_keys_after_refresh.reset();
-  });
-
-  // get the pool state
-  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
-  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
-
+  // daemons from before the pool change log only give the whole list
+  if (m_rpc_version < MAKE_CORE_RPC_VERSION(3, 22))
   {
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::request req;
+    cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_HASHES_BIN::response res;
+
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     uint64_t pre_call_credits = m_rpc_payment_state.credits;
     req.client = get_client_signature();
     bool r = epee::net_utils::invoke_http_json("/get_transaction_pool_hashes.bin", req, res, *m_http_client, rpc_timeout);
     THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_transaction_pool_hashes.bin", error::get_tx_pool_error);
     check_rpc_cost("/get_transaction_pool_hashes.bin", res.credits, pre_call_credits, 1 + res.tx_hashes.size() * COST_PER_POOL_HASH);
+    m_pool_revision = 0;
+    return std::move(res.tx_hashes);
+  }
+
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::request req;
+  cryptonote::COMMAND_RPC_GET_TRANSACTION_POOL_CHANGES::response res;
+
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+    uint64_t pre_call_credits = m_rpc_payment_state.credits;
+    req.client = get_client_signature();
+    req.since_revision = m_pool_revision;
+    bool r = epee::net_utils::invoke_http_bin("/get_transaction_pool_changes.bin", req, res, *m_http_client, rpc_timeout);
+    THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "get_transaction_pool_changes.bin", error::get_tx_pool_error);
+    check_rpc_cost("/get_transaction_pool_changes.bin", res.credits, pre_call_credits, 1 + (res.added.size() + res.removed.size()) * COST_PER_POOL_HASH);
   }
+
+  if (res.full)
+    m_pool_hashes.clear();
+  for (const crypto::hash &txid: res.removed)
+    m_pool_hashes.erase(txid);
+  m_pool_hashes.insert(res.added.begin(), res.added.end());
+  m_pool_revision = res.revision;
+  MDEBUG("Pool changes since last refresh: " << res.added.size() << " added, " << res.removed.size() << " removed" << (res.full ? " (full list)" : ""));
+
+  return std::vector<crypto::hash>(m_pool_hashes.begin(), m_pool_hashes.end());
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> &process_txs, bool refreshed)
+{
+  MTRACE("update_pool_state start");
+
+  auto keys_reencryptor = epee::misc_utils::create_scope_leave_handler([&, this]() {
+    m_encrypt_keys_after_refresh.reset();
+  });
+
+  // get the pool state
+  const std::vector<crypto::hash> pool_hashes = get_pool_hashes();
   MTRACE("update_pool_state got pool");
 
   // remove any pending tx that's not in the pool
@@ -3088,15 +3701,7 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
   while (it != m_unconfirmed_txs.end())
   {
     const crypto::hash &txid = it->first;
-    bool found = false;
-    for (const auto &it2: res.tx_hashes)
-    {
-      if (it2 == txid)
-      {
-        found = true;
-        break;
-      }
-    }
+    const bool found = m_pool_revision ? m_pool_hashes.count(txid) != 0 : std::find(pool_hashes.begin(), pool_hashes.end(), txid) != pool_hashes.end();
     auto pit = it++;
     if (!found)
     {
@@ -3146,13 +3751,13 @@ void wallet2::update_pool_state(std::vector<std::tuple<cryptonote::transaction,
   // the in transfers list instead (or nowhere if it just
   // disappeared without being mined)
   if (refreshed)
-    remove_obsolete_pool_txs(res.tx_hashes);
+    remove_obsolete_pool_txs(pool_hashes);
 
   MTRACE("update_pool_state done second loop");
 
   // gather txids of new pool txes to us
   std::vector<std::pair<crypto::hash, bool>> txids;
-  for (const auto &txid: res.tx_hashes)
+  for (const auto &txid: pool_hashes)
   {
     bool txid_found_in_up = false;
     for (const auto &up: m_unconfirmed_payments)
@@ -3460,6 +4065,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
     // Lighwallet refresh done
     return;
   }
+  select_daemon(false);
   received_money = false;
   blocks_fetched = 0;
   uint64_t added_blocks = 0;
@@ -3479,6 +4085,11 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
 
+  // credits are reconciled by comparing balances around each call, so calls
+  // to a paid daemon must go one at a time on the main connection
+  m_parallel_daemon_rpc = !daemon_requires_payment();
+  auto parallel_daemon_rpc_reset = epee::misc_utils::create_scope_leave_handler([this](){ m_parallel_daemon_rpc = false; });
+
   // pull the first set of blocks
   get_short_chain_history(short_chain_history, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
   m_run.store(true, std::memory_order_relaxed);
@@ -3512,7 +4123,53 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   // leak allowing a passive adversary with traffic analysis capability to
   // infer when we get an incoming output
   std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> process_pool_txs;
-  update_pool_state(process_pool_txs, true);
+  std::exception_ptr pool_exception;
+  bool pool_state_updated = false;
+  if (!m_parallel_daemon_rpc)
+  {
+    update_pool_state(process_pool_txs, true);
+    pool_state_updated = true;
+  }
+
+  // Pulls are chained by chain history, so only one can be in flight. When the
+  // daemon's replies take longer than processing them (remote nodes, Tor...),
+  // spans are also pulled by height on their own connections, as many as it
+  // takes to keep processing busy. They are used in order if they link up with
+  // the blocks before them, else dropped in favour of the usual pull.
+  tools::threadpool& io_tpool = tools::threadpool::getInstanceForIO();
+  std::deque<std::unique_ptr<prefetched_blocks>> prefetch;
+  size_t prefetch_window = 1;
+  uint64_t prefetch_fetch_us = 0, prefetch_process_us = 0;
+  uint64_t node_height = 0;
+  const auto drop_prefetch = [&]() {
+    for (const auto &p: prefetch)
+      p->waiter.wait();
+    prefetch.clear();
+  };
+  auto prefetch_dropper = epee::misc_utils::create_scope_leave_handler(drop_prefetch);
+  const auto top_up_prefetch = [&]() {
+    if (!m_parallel_daemon_rpc || last || blocks.empty())
+      return;
+    // spans may overlap a bit, they can't have a gap
+    const uint64_t span = std::max<uint64_t>(1, blocks.size() * 9 / 10);
+    const size_t bytes = get_blocks_size(blocks);
+    uint64_t start = prefetch.empty() ? blocks_start_height + blocks.size() : prefetch.back()->start_height + span;
+    while (prefetch.size() < prefetch_window && start < node_height
+        && (prefetch.empty() || (prefetch.size() + 1) * bytes <= REFRESH_PREFETCH_MAX_BYTES))
+    {
+      size_t connection = 0;
+      while (std::any_of(prefetch.begin(), prefetch.end(), [connection](const std::unique_ptr<prefetched_blocks> &p){ return p->connection == connection; }))
+        ++connection;
+      prefetch.emplace_back(new prefetched_blocks(io_tpool, start, connection));
+      prefetched_blocks *p = prefetch.back().get();
+      io_tpool.submit(&p->waiter, [this, p]() {
+        const auto t0 = std::chrono::steady_clock::now();
+        pull_and_parse_blocks_at(p->start_height, p->connection, p->blocks_start_height, p->blocks, p->parsed_blocks, p->current_height, p->error);
+        p->duration_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+      });
+      start += span;
+    }
+  };
 
   bool first = true, last = false;
   while(m_run.load(std::memory_order_relaxed) && blocks_fetched < max_blocks)
@@ -3522,6 +4179,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
     std::vector<parsed_block> next_parsed_blocks;
     bool error;
     std::exception_ptr exception;
+    bool use_prefetch = false;
     try
     {
       // pull the next set of blocks while we're processing the current one
@@ -3537,13 +4195,31 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         break;
       }
       if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
+      {
+        use_prefetch = !first && !prefetch.empty() && prefetch.front()->start_height <= blocks_start_height + blocks.size();
+        if (!use_prefetch)
+        {
+          drop_prefetch();
+          tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, node_height, last, error, exception);});
+        }
+      }
+
+      if (!pool_state_updated)
+      {
+        // the first blocks pull is on the second connection meanwhile
+        pool_state_updated = true;
+        try { update_pool_state(process_pool_txs, true); }
+        catch (...) { pool_exception = std::current_exception(); }
+      }
 
       if (!first)
       {
         try
         {
+          const auto t0 = std::chrono::steady_clock::now();
           process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
+          const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+          prefetch_process_us = prefetch_process_us ? (prefetch_process_us * 3 + us) / 4 : us;
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
         {
@@ -3577,6 +4253,38 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       }
       THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
+      if (use_prefetch && !error)
+      {
+        std::unique_ptr<prefetched_blocks> p = std::move(prefetch.front());
+        prefetch.pop_front();
+        p->waiter.wait();
+        const uint64_t next_height = blocks_start_height + blocks.size();
+        const bool linked = !p->error && p->blocks_start_height <= next_height && p->blocks_start_height + p->blocks.size() > next_height
+            && p->parsed_blocks[next_height - p->blocks_start_height].block.prev_id == parsed_blocks.back().hash;
+        if (linked)
+        {
+          const size_t skip = next_height - p->blocks_start_height;
+          p->blocks.erase(p->blocks.begin(), p->blocks.begin() + skip);
+          p->parsed_blocks.erase(p->parsed_blocks.begin(), p->parsed_blocks.begin() + skip);
+          advance_short_history(short_chain_history, parsed_blocks);
+          next_blocks_start_height = next_height;
+          next_blocks = std::move(p->blocks);
+          next_parsed_blocks = std::move(p->parsed_blocks);
+          node_height = p->current_height;
+          last = next_height + next_blocks.size() == node_height;
+
+          // keep as many pulls in flight as it takes one to come back per batch processed
+          prefetch_fetch_us = prefetch_fetch_us ? (prefetch_fetch_us * 3 + p->duration_us) / 4 : p->duration_us;
+          prefetch_window = std::max<size_t>(1, std::min<size_t>(REFRESH_PREFETCH_MAX_REQUESTS, (prefetch_fetch_us + prefetch_process_us - 1) / std::max<uint64_t>(1, prefetch_process_us)));
+        }
+        else
+        {
+          MDEBUG("Prefetched blocks from height " << p->start_height << " do not follow on from height " << next_height << ", pulling by chain history");
+          drop_prefetch();
+          pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, node_height, last, error, exception);
+        }
+      }
+
       // handle error from async fetching thread
       if (error)
       {
@@ -3606,6 +4314,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       blocks_start_height = next_blocks_start_height;
       blocks = std::move(next_blocks);
       parsed_blocks = std::move(next_parsed_blocks);
+      top_up_prefetch();
     }
     catch (const tools::error::password_needed&)
     {
@@ -3633,9 +4342,14 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
     {
       blocks_fetched += added_blocks;
       THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
+      drop_prefetch();
       if(try_count < 3)
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
+        // the retry carries on from the last block we processed, and the usual
+        // hash checks against m_blockchain catch a new daemon on another fork
+        if (select_daemon(true))
+          m_parallel_daemon_rpc = !daemon_requires_payment();
         first = true;
         start_height = 0;
         blocks.clear();
@@ -3650,7 +4364,11 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         throw;
       }
     }
+    // a failed pool query still ends the refresh before any block is processed
+    if (pool_exception)
+      std::rethrow_exception(pool_exception);
   }
+  drop_prefetch();
   if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_txid : null_hash))
     received_money = true;
 
@@ -3684,14 +4402,12 @@ bool wallet2::refresh(bool trusted_daemon, uint64_t & blocks_fetched, bool& rece
   return ok;
 }
 //----------------------------------------------------------------------------------------------------
-bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+bool wallet2::fetch_rct_distribution(uint64_t from_height, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base)
 {
-  MDEBUG("Requesting rct distribution");
-
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
   req.amounts.push_back(0);
-  req.from_height = 0;
+  req.from_height = from_height;
   req.cumulative = false;
   req.binary = true;
   req.compress = true;
@@ -3720,6 +4436,9 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     MWARNING("Failed to request output distribution: results are not for amount 0");
     return false;
   }
+  base = res.distributions[0].data.base;
+  if (!res.distributions[0].data.distribution.empty())
+    res.distributions[0].data.distribution[0] += base;
   for (size_t i = 1; i < res.distributions[0].data.distribution.size(); ++i)
     res.distributions[0].data.distribution[i] += res.distributions[0].data.distribution[i-1];
   start_height = res.distributions[0].data.start_height;
@@ -3727,6 +4446,50 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
   return true;
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+{
+  // top up the cached distribution if we have one, refetching the last few
+  // blocks in case they were reorged; the cumulative count just below the
+  // refetched range has to match what we have, or we start over
+  const uint64_t cached_top = m_rct_distribution_start_height + m_rct_distribution.size();
+  if (m_rct_distribution.size() > RCT_DISTRIBUTION_REFRESH_BLOCKS)
+  {
+    const uint64_t from_height = cached_top - RCT_DISTRIBUTION_REFRESH_BLOCKS;
+    MDEBUG("Requesting rct distribution from height " << from_height);
+    uint64_t new_start_height, base;
+    std::vector<uint64_t> new_distribution;
+    if (fetch_rct_distribution(from_height, new_start_height, new_distribution, base) &&
+        new_start_height == from_height && !new_distribution.empty() &&
+        m_rct_distribution[from_height - m_rct_distribution_start_height - 1] == base)
+    {
+      m_rct_distribution.resize(from_height - m_rct_distribution_start_height);
+      m_rct_distribution.insert(m_rct_distribution.end(), new_distribution.begin(), new_distribution.end());
+      start_height = m_rct_distribution_start_height;
+      distribution = m_rct_distribution;
+      return true;
+    }
+    MDEBUG("Cached rct distribution does not match the daemon's, requesting it in full");
+  }
+
+  MDEBUG("Requesting rct distribution");
+  m_rct_distribution.clear();
+  uint64_t base;
+  if (!fetch_rct_distribution(0, start_height, distribution, base))
+    return false;
+  m_rct_distribution_start_height = start_height;
+  m_rct_distribution = distribution;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+std::unordered_set<crypto::public_key> &wallet2::get_valid_public_keys_cache()
+{
+  // whether a key is in the main subgroup never changes, so the cache only
+  // needs bounding, not invalidating
+  if (m_valid_public_keys_cache.size() > MAX_VALID_PUBLIC_KEYS_CACHE_SIZE)
+    m_valid_public_keys_cache.clear();
+  return m_valid_public_keys_cache;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
   LOG_PRINT_L0("Detaching blockchain on height " << height);
@@ -3739,29 +4502,44 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
 
   size_t transfers_detached = 0;
 
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  if (!m_reorg_index_valid)
+    rebuild_reorg_index();
+
+  for (auto it = m_spent_index.lower_bound(height); it != m_spent_index.end(); )
   {
-    wallet2::transfer_details &td = m_transfers[i];
-    if (td.m_spent && td.m_spent_height >= height)
-    {
-      LOG_PRINT_L1("Resetting spent/frozen status for output " << i << ": " << td.m_key_image);
-      set_unspent(i);
-      thaw(i);
-    }
+    // set_unspent drops the entry
+    const size_t i = (it++)->second;
+    THROW_WALLET_EXCEPTION_IF(i >= m_transfers.size(), error::wallet_internal_error, "Spent index out of range");
+    LOG_PRINT_L1("Resetting spent/frozen status for output " << i << ": " << m_transfers[i].m_key_image);
+    set_unspent(i);
+    thaw(i);
   }
 
-  for (transfer_details &td: m_transfers)
+  const auto uses_start = m_uses_index.lower_bound(height);
+  for (auto it = uses_start; it != m_uses_index.end(); ++it)
   {
+    THROW_WALLET_EXCEPTION_IF(it->second >= m_transfers.size(), error::wallet_internal_error, "Uses index out of range");
+    transfer_details &td = m_transfers[it->second];
     while (!td.m_uses.empty() && td.m_uses.back().first >= height)
       td.m_uses.pop_back();
   }
+  m_uses_index.erase(uses_start, m_uses_index.end());
 
-  if (output_tracker_cache)
-    output_tracker_cache->clear();
-
+  // scan_tx appends transfers from old blocks at the end, so m_transfers is not
+  // in block order: everything from the first detached transfer on goes
   auto it = std::find_if(m_transfers.begin(), m_transfers.end(), [&](const transfer_details& td){return td.m_block_height >= height;});
   size_t i_start = it - m_transfers.begin();
 
+  // transfers below the split height can be dropped with it, along with their index entries
+  for(size_t i = i_start; i!= m_transfers.size();i++)
+  {
+    const transfer_details &td = m_transfers[i];
+    if (td.m_spent)
+      erase_index_entry(m_spent_index, td.m_spent_height, i);
+    for (const auto &use: td.m_uses)
+      erase_index_entry(m_uses_index, use.first, i);
+  }
+
   for(size_t i = i_start; i!= m_transfers.size();i++)
   {
     if (!m_transfers[i].m_key_image_known || m_transfers[i].m_key_image_partial)
@@ -3773,31 +4551,64 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
 
   for(size_t i = i_start; i!= m_transfers.size();i++)
   {
-    auto it_pk = m_pub_keys.find(m_transfers[i].get_public_key());
-    THROW_WALLET_EXCEPTION_IF(it_pk == m_pub_keys.end(), error::wallet_internal_error, "public key not found");
-    m_pub_keys.erase(it_pk);
+    auto it_pk = m_pub_keys.find(m_transfers[i].get_public_key());
+    THROW_WALLET_EXCEPTION_IF(it_pk == m_pub_keys.end(), error::wallet_internal_error, "public key not found");
+    m_pub_keys.erase(it_pk);
+  }
+
+  if (output_tracker_cache)
+  {
+    for(size_t i = i_start; i!= m_transfers.size();i++)
+    {
+      const transfer_details &td = m_transfers[i];
+      auto it_ot = output_tracker_cache->find(std::make_pair(td.is_rct() ? 0 : td.amount(), td.m_global_output_index));
+      if (it_ot != output_tracker_cache->end() && it_ot->second >= i_start)
+        output_tracker_cache->erase(it_ot);
+    }
   }
-  transfers_detached = std::distance(it, m_transfers.end());
-  m_transfers.erase(it, m_transfers.end());
+
+  transfers_detached = m_transfers.size() - i_start;
+  m_transfers.erase(m_transfers.begin() + i_start, m_transfers.end());
 
   size_t blocks_detached = m_blockchain.size() - height;
   m_blockchain.crop(height);
 
-  for (auto it = m_payments.begin(); it != m_payments.end(); )
-  {
-    if(height <= it->second.m_block_height)
-      it = m_payments.erase(it);
-    else
-      ++it;
-  }
-
-  for (auto it = m_confirmed_txs.begin(); it != m_confirmed_txs.end(); )
+  // the transfer history has payments and confirmed txes in height order
+  if (!m_transfer_history_valid)
+    rebuild_transfer_history();
+  m_transfer_history_top_height = 0;
+  for (auto &e: m_transfer_history)
   {
-    if(height <= it->second.m_block_height)
-      it = m_confirmed_txs.erase(it);
-    else
-      ++it;
+    transfer_history_index &index = e.second;
+    const auto first = index.lower_bound(std::make_pair(height, (uint64_t)0));
+    for (auto it = first; it != index.end(); ++it)
+    {
+      if (it->second.in)
+      {
+        const auto range = m_payments.equal_range(it->second.in->first);
+        for (auto j = range.first; j != range.second; ++j)
+        {
+          if (&*j == it->second.in)
+          {
+            m_payments.erase(j);
+            break;
+          }
+        }
+      }
+      else
+      {
+        const crypto::hash txid = it->second.out->first;
+        m_confirmed_txs.erase(txid);
+      }
+    }
+    index.erase(first, index.end());
+    if (!index.empty())
+      m_transfer_history_top_height = std::max(m_transfer_history_top_height, index.rbegin()->first.first);
   }
+  // cursors past the split could skip the entries that will replace the detached ones
+  do
+    m_transfer_history_generation = crypto::rand<uint64_t>();
+  while (m_transfer_history_generation == 0);
 
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
 }
@@ -3824,11 +4635,14 @@ bool wallet2::clear()
   m_additional_tx_keys.clear();
   m_confirmed_txs.clear();
   m_unconfirmed_payments.clear();
+  invalidate_transfer_history();
+  invalidate_reorg_index();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
   m_address_book.clear();
   m_subaddresses.clear();
   m_subaddress_labels.clear();
+  m_subaddress_str_cache.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
   return true;
@@ -3845,6 +4659,8 @@ void wallet2::clear_soft(bool keep_key_images)
   m_payments.clear();
   m_confirmed_txs.clear();
   m_unconfirmed_payments.clear();
+  invalidate_transfer_history();
+  invalidate_reorg_index();
   m_scanned_pool_txs[0].clear();
   m_scanned_pool_txs[1].clear();
 
@@ -4090,6 +4906,9 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee:
   value2.SetInt(m_enable_multisig ? 1 : 0);
   json.AddMember("enable_multisig", value2, json.GetAllocator());
 
+  value2.SetInt(m_compress_cache ? 1 : 0);
+  json.AddMember("compress_cache", value2, json.GetAllocator());
+
   // Serialize the JSON object
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -4239,6 +5058,7 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_auto_mine_for_rpc_payment_threshold = -1.0f;
     m_credits_target = 0;
     m_enable_multisig = false;
+    m_compress_cache = false;
     m_allow_mismatched_daemon_version = false;
   }
   else if(json.IsObject())
@@ -4474,6 +5294,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_credits_target = field_credits_target;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, enable_multisig, int, Int, false, false);
     m_enable_multisig = field_enable_multisig;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, compress_cache, int, Int, false, false);
+    m_compress_cache = field_compress_cache;
   }
   else
   {
@@ -5050,27 +5872,24 @@ std::string wallet2::make_multisig(const epee::wipeable_string &password,
     };
 
   // open initial kex messages, validate them, extract signers
-  std::vector<multisig::multisig_kex_msg> expanded_msgs;
+  const std::vector<multisig::multisig_kex_msg> expanded_msgs = open_kex_msgs(initial_kex_msgs);
   std::vector<crypto::public_key> signers;
-  expanded_msgs.reserve(initial_kex_msgs.size());
   signers.reserve(initial_kex_msgs.size() + 1);
 
-  for (const auto &msg : initial_kex_msgs)
+  for (const auto &expanded_msg : expanded_msgs)
   {
-    expanded_msgs.emplace_back(msg);
-
     // validate each message
     // 1. must be 'round 1'
-    CHECK_AND_ASSERT_THROW_MES(expanded_msgs.back().get_round() == 1,
+    CHECK_AND_ASSERT_THROW_MES(expanded_msg.get_round() == 1,
       "Trying to make multisig with message that has invalid multisig kex round (should be '1').");
 
     // 2. duplicate signers not allowed
-    CHECK_AND_ASSERT_THROW_MES(std::find(signers.begin(), signers.end(), expanded_msgs.back().get_signing_pubkey()) == signers.end(),
+    CHECK_AND_ASSERT_THROW_MES(std::find(signers.begin(), signers.end(), expanded_msg.get_signing_pubkey()) == signers.end(),
       "Duplicate signers not allowed when converting a wallet to multisig.");
 
     // add signer (skip self for now)
-    if (expanded_msgs.back().get_signing_pubkey() != multisig_account.get_base_pubkey())
-      signers.push_back(expanded_msgs.back().get_signing_pubkey());
+    if (expanded_msg.get_signing_pubkey() != multisig_account.get_base_pubkey())
+      signers.push_back(expanded_msg.get_signing_pubkey());
   }
 
   // add self to signers
@@ -5186,11 +6005,7 @@ std::string wallet2::exchange_multisig_keys(const epee::wipeable_string &passwor
   }
 
   // open kex messages
-  std::vector<multisig::multisig_kex_msg> expanded_msgs;
-  expanded_msgs.reserve(kex_messages.size());
-
-  for (const auto &msg : kex_messages)
-    expanded_msgs.emplace_back(msg);
+  const std::vector<multisig::multisig_kex_msg> expanded_msgs = open_kex_msgs(kex_messages);
 
   // update multisig kex
   multisig_account.kex_update(expanded_msgs, force_update_use_with_caution);
@@ -5237,6 +6052,7 @@ std::string wallet2::exchange_multisig_keys(const epee::wipeable_string &passwor
 
     m_subaddresses.clear();
     m_subaddress_labels.clear();
+    m_subaddress_str_cache.clear();
     add_subaddress_account(tr("Primary account"));
 
     if (!m_wallet_file.empty())
@@ -5419,6 +6235,7 @@ bool wallet2::check_connection(uint32_t *version, bool *ssl, uint32_t timeout, b
     if(!m_http_client->is_connected(ssl))
     {
       m_rpc_version = 0;
+      m_pool_revision = 0;
       m_node_rpc_proxy.invalidate();
       if (!m_http_client->connect(std::chrono::milliseconds(timeout)))
         return false;
@@ -5529,11 +6346,23 @@ void wallet2::set_offline(bool offline)
   m_offline = offline;
   m_node_rpc_proxy.set_offline(offline);
   m_http_client->set_auto_connect(!offline);
+  m_blocks_http_client->set_auto_connect(!offline);
+  for (const auto &c: m_prefetch_connections)
+    c->client->set_auto_connect(!offline);
   if (offline)
   {
     boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
     if(m_http_client->is_connected())
       m_http_client->disconnect();
+    boost::lock_guard<boost::recursive_mutex> blocks_lock(m_daemon_blocks_rpc_mutex);
+    if(m_blocks_http_client->is_connected())
+      m_blocks_http_client->disconnect();
+    for (const auto &c: m_prefetch_connections)
+    {
+      const boost::lock_guard<boost::mutex> prefetch_lock{c->mutex};
+      if (c->client->is_connected())
+        c->client->disconnect();
+    }
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -5607,10 +6436,34 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
 
       r = ::serialization::parse_binary(use_fs ? cache_file_buf : cache_buf, cache_file_data);
       THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + m_wallet_file + '\"');
+      // the raw file is only needed again if this turns out not to be an encrypted
+      // cache, so don't keep it around next to the ciphertext and the plaintext
+      if (use_fs)
+      {
+        cache_file_buf.clear();
+        cache_file_buf.shrink_to_fit();
+      }
       std::string cache_data;
       cache_data.resize(cache_file_data.cache_data.size());
       crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), m_cache_key, cache_file_data.iv, &cache_data[0]);
 
+      static const size_t compressed_magic_size = strlen(COMPRESSED_CACHE_MAGIC);
+      if (cache_data.size() >= compressed_magic_size && !memcmp(cache_data.data(), COMPRESSED_CACHE_MAGIC, compressed_magic_size))
+      {
+#ifdef HAVE_ZSTD
+        std::string decompressed;
+        if (!decompress_cache(cache_data.data() + compressed_magic_size, cache_data.size() - compressed_magic_size, decompressed))
+        {
+          MERROR("Failed to decompress wallet cache");
+          THROW_WALLET_EXCEPTION(error::wallet_internal_error, "Failed to decompress wallet cache");
+        }
+        cache_data.swap(decompressed);
+#else
+        MERROR("The wallet cache is compressed, but this build does not have zstd support");
+        THROW_WALLET_EXCEPTION(error::wallet_internal_error, "The wallet cache is compressed, but this build does not have zstd support");
+#endif
+      }
+
       try {
         bool loaded = false;
 
@@ -5677,6 +6530,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
     catch (...)
     {
       LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
+      if (use_fs && cache_file_buf.empty())
+        load_from_file(m_wallet_file, cache_file_buf, std::numeric_limits<size_t>::max());
       try {
         std::stringstream iss;
         iss << cache_file_buf;
@@ -5700,6 +6555,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
   }
 
+  rebuild_key_indexes();
+
   if (!m_persistent_rpc_client_id)
     set_rpc_client_secret_key(rct::rct2sk(rct::skGen()));
 
@@ -5742,6 +6599,23 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_key_indexes()
+{
+  THROW_WALLET_EXCEPTION_IF(m_transfers.size() >= decltype(m_pub_keys)::npos, error::wallet_internal_error, "Too many transfers");
+  m_key_images.clear();
+  m_pub_keys.clear();
+  m_key_images.reserve(m_transfers.size());
+  m_pub_keys.reserve(m_transfers.size());
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    const transfer_details &td = m_transfers[i];
+    // light wallet transfers are indexed by key image as they are added, known or not
+    if (td.m_key_image_known || m_light_wallet)
+      m_key_images[td.m_key_image] = i;
+    m_pub_keys[td.get_public_key()] = i;
+  }
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::trim_hashchain()
 {
   uint64_t height = m_checkpoints.get_max_height();
@@ -5750,6 +6624,13 @@ void wallet2::trim_hashchain()
     if (td.m_block_height < height)
       height = td.m_block_height;
 
+  // Only multisig info import detaches back to the height of a past transfer.
+  // Otherwise the only detach is a reorg, which may not go deeper than
+  // m_max_reorg_depth, so hashes older than that window are not needed
+  const uint64_t blockchain_height = m_blockchain.size();
+  if (!m_multisig && blockchain_height > 0 && m_max_reorg_depth < blockchain_height - 1)
+    height = std::max<uint64_t>(height, blockchain_height - 1 - m_max_reorg_depth);
+
   if (!m_blockchain.empty() && m_blockchain.size() == m_blockchain.offset())
   {
     MINFO("Fixing empty hashchain");
@@ -5888,12 +6769,19 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     // save to new file
 #ifdef WIN32
     // On Windows avoid using std::ofstream which does not work with UTF-8 filenames
-    // The price to pay is temporary higher memory consumption for string stream + binary archive
-    std::ostringstream oss;
-    binary_archive<true> oar(oss);
-    bool success = ::serialization::serialize(oar, cache_file_data.get());
+    // The price to pay is temporary higher memory consumption for the serialized buffer
+    std::string buf;
+    bool success;
+    {
+      boost::iostreams::stream<boost::iostreams::back_insert_device<std::string>> oss(buf);
+      binary_archive<true> oar(oss);
+      success = ::serialization::serialize(oar, cache_file_data.get());
+      oss.flush();
+      success = success && oss.good();
+    }
+    cache_file_data = boost::none;
     if (success) {
-        success = save_to_file(new_file, oss.str());
+        success = save_to_file(new_file, buf);
     }
     THROW_WALLET_EXCEPTION_IF(!success, error::file_save_error, new_file);
 #else
@@ -5923,18 +6811,44 @@ boost::optional<wallet2::cache_file_data> wallet2::get_cache_file_data(const epe
   trim_hashchain();
   try
   {
-    std::stringstream oss;
-    binary_archive<true> ar(oss);
-    if (!::serialization::serialize(ar, *this))
-      return boost::none;
-
+    // serialize straight into the cache data, encrypting each chunk as the stream
+    // flushes it: with large wallets, the stream buffer, its copy and a separate
+    // cipher buffer used to keep several copies of the whole cache alive at once,
+    // and a second pass over the whole plaintext to encrypt it
     boost::optional<wallet2::cache_file_data> cache_file_data = (wallet2::cache_file_data) {};
-    cache_file_data.get().cache_data = oss.str();
-    std::string cipher;
-    cipher.resize(cache_file_data.get().cache_data.size());
+    std::string &cache_data = cache_file_data.get().cache_data;
     cache_file_data.get().iv = crypto::rand<crypto::chacha_iv>();
-    crypto::chacha20(cache_file_data.get().cache_data.data(), cache_file_data.get().cache_data.size(), m_cache_key, cache_file_data.get().iv, &cipher[0]);
-    cache_file_data.get().cache_data = cipher;
+    {
+      crypto::chacha20_stream cipher(m_cache_key, cache_file_data.get().iv);
+      chacha20_back_insert_device device(cache_data, cipher);
+#ifdef HAVE_ZSTD
+      if (m_compress_cache)
+      {
+        // the magic stays uncompressed so loading can tell both encodings apart
+        device.write(COMPRESSED_CACHE_MAGIC, strlen(COMPRESSED_CACHE_MAGIC));
+        zstd_cache_compressor compressor(device);
+        boost::iostreams::stream<zstd_cache_compress_device> oss{zstd_cache_compress_device(compressor)};
+        binary_archive<true> ar(oss);
+        if (!::serialization::serialize(ar, *this))
+          return boost::none;
+        oss.flush();
+        if (!oss.good())
+          return boost::none;
+        compressor.finish();
+        return cache_file_data;
+      }
+#else
+      if (m_compress_cache)
+        MWARNING("This build does not have zstd support, the wallet cache will not be compressed");
+#endif
+      boost::iostreams::stream<chacha20_back_insert_device> oss(device);
+      binary_archive<true> ar(oss);
+      if (!::serialization::serialize(ar, *this))
+        return boost::none;
+      oss.flush();
+      if (!oss.good())
+        return boost::none;
+    }
     return cache_file_data;
   }
   catch(...)
@@ -6158,45 +7072,245 @@ void wallet2::get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2:
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::add_to_transfer_history(const std::pair<const crypto::hash, payment_details> &payment)
+{
+  if (!m_transfer_history_valid)
+    return;
+  const uint64_t height = payment.second.m_block_height;
+  // an entry behind the top could land before cursors already handed out
+  if (height < m_transfer_history_top_height)
+  {
+    invalidate_transfer_history();
+    return;
+  }
+  m_transfer_history_top_height = height;
+  m_transfer_history[payment.second.m_subaddr_index.major].emplace_hint(m_transfer_history[payment.second.m_subaddr_index.major].end(),
+    std::make_pair(height, m_transfer_history_next_seq++), transfer_history_entry{&payment, NULL});
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_to_transfer_history(const std::pair<const crypto::hash, confirmed_transfer_details> &payment)
+{
+  if (!m_transfer_history_valid)
+    return;
+  const uint64_t height = payment.second.m_block_height;
+  if (height < m_transfer_history_top_height)
+  {
+    invalidate_transfer_history();
+    return;
+  }
+  m_transfer_history_top_height = height;
+  m_transfer_history[payment.second.m_subaddr_account].emplace_hint(m_transfer_history[payment.second.m_subaddr_account].end(),
+    std::make_pair(height, m_transfer_history_next_seq++), transfer_history_entry{NULL, &payment});
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::invalidate_transfer_history()
+{
+  m_transfer_history_valid = false;
+  m_transfer_history.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_history() const
+{
+  std::vector<std::pair<uint64_t, transfer_history_entry>> entries;
+  entries.reserve(m_payments.size() + m_confirmed_txs.size());
+  for (const auto &p: m_payments)
+    entries.push_back(std::make_pair(p.second.m_block_height, transfer_history_entry{&p, NULL}));
+  for (const auto &p: m_confirmed_txs)
+    entries.push_back(std::make_pair(p.second.m_block_height, transfer_history_entry{NULL, &p}));
+  std::stable_sort(entries.begin(), entries.end(), [](const std::pair<uint64_t, transfer_history_entry> &e0, const std::pair<uint64_t, transfer_history_entry> &e1) {
+    return e0.first < e1.first;
+  });
+
+  m_transfer_history.clear();
+  uint64_t seq = 0;
+  for (const auto &e: entries)
+  {
+    const uint32_t account = e.second.in ? e.second.in->second.m_subaddr_index.major : e.second.out->second.m_subaddr_account;
+    transfer_history_index &index = m_transfer_history[account];
+    index.emplace_hint(index.end(), std::make_pair(e.first, seq++), e.second);
+  }
+  m_transfer_history_next_seq = seq;
+  m_transfer_history_top_height = entries.empty() ? 0 : entries.back().first;
+  // cursors from before the rebuild must not match, including across wallet reloads
+  do
+    m_transfer_history_generation = crypto::rand<uint64_t>();
+  while (m_transfer_history_generation == 0);
+  m_transfer_history_valid = true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::invalidate_reorg_index()
+{
+  m_reorg_index_valid = false;
+  m_spent_index.clear();
+  m_uses_index.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_reorg_index()
+{
+  m_spent_index.clear();
+  m_uses_index.clear();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    const transfer_details &td = m_transfers[i];
+    if (td.m_spent)
+      m_spent_index.emplace(td.m_spent_height, i);
+    for (const auto &use: td.m_uses)
+      m_uses_index.emplace(use.first, i);
+  }
+  m_reorg_index_valid = true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::get_transfer_history(const transfer_history_cursor &cursor, size_t limit, bool in, bool out,
+    uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, transfer_history_page &page) const
+{
+  if (!m_transfer_history_valid)
+    rebuild_transfer_history();
+
+  page.in.clear();
+  page.out.clear();
+  page.more = false;
+  page.reset = cursor.generation != 0 && cursor.generation != m_transfer_history_generation;
+  const bool resume = cursor.generation == m_transfer_history_generation;
+
+  // the last key of the whole history, or of the height range if that ends earlier
+  std::pair<uint64_t, uint64_t> next(0, 0);
+  if (m_transfer_history_next_seq > 0)
+    next = std::min(std::make_pair(m_transfer_history_top_height, m_transfer_history_next_seq - 1), std::make_pair(max_height, std::numeric_limits<uint64_t>::max() - 1));
+  if (resume)
+    next = std::max(next, std::make_pair(cursor.height, cursor.seq));
+  page.next = {m_transfer_history_generation, next.first, next.second};
+
+  // min_height is exclusive and max_height inclusive, as in get_payments
+  if (min_height >= max_height)
+    return;
+  std::pair<uint64_t, uint64_t> start(min_height + 1, 0);
+  if (resume)
+    start = std::max(start, std::make_pair(cursor.height, cursor.seq + 1));
+
+  // merge the per account indices in key order
+  std::vector<std::pair<transfer_history_index::const_iterator, transfer_history_index::const_iterator>> ranges;
+  for (const auto &index: m_transfer_history)
+    if (!subaddr_account || *subaddr_account == index.first)
+      ranges.push_back(std::make_pair(index.second.lower_bound(start), index.second.end()));
+
+  size_t count = 0;
+  std::pair<uint64_t, uint64_t> last;
+  while (true)
+  {
+    std::pair<transfer_history_index::const_iterator, transfer_history_index::const_iterator> *best = NULL;
+    for (auto &r: ranges)
+      if (r.first != r.second && (!best || r.first->first < best->first->first))
+        best = &r;
+    if (!best || best->first->first.first > max_height)
+      break;
+    if (limit && count == limit)
+    {
+      page.more = true;
+      break;
+    }
+
+    const transfer_history_entry &e = best->first->second;
+    bool added = false;
+    if (e.in)
+    {
+      if (in && (subaddr_indices.empty() || subaddr_indices.count(e.in->second.m_subaddr_index.minor) == 1))
+      {
+        page.in.push_back(*e.in);
+        added = true;
+      }
+    }
+    else if (out)
+    {
+      const std::set<uint32_t> &indices = e.out->second.m_subaddr_indices;
+      if (subaddr_indices.empty() || std::any_of(indices.begin(), indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }))
+      {
+        page.out.push_back(*e.out);
+        added = true;
+      }
+    }
+    if (added)
+    {
+      ++count;
+      last = best->first->first;
+    }
+    ++best->first;
+  }
+  if (page.more)
+  {
+    page.next.height = last.first;
+    page.next.seq = last.second;
+  }
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::rescan_spent()
 {
+  // a view wallet may not know about key images
+  std::vector<size_t> indices;
+  indices.reserve(m_transfers.size());
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    if (m_transfers[i].m_key_image_known && !m_transfers[i].m_key_image_partial)
+      indices.push_back(i);
+
+  // daemons from before the binary endpoint only take hex key images
+  const bool binary = m_rpc_version >= MAKE_CORE_RPC_VERSION(3, 23);
+
   // This is RPC call that can take a long time if there are many outputs,
-  // so we call it several times, in stripes, so we don't time out spuriously
+  // so we call it several times, in stripes, so we don't time out spuriously.
+  // The binary call is served from sorted db lookups, so its stripes can be
+  // as large as RESTRICTED_SPENT_KEY_IMAGES_COUNT in rpc/core_rpc_server.cpp
   std::vector<int> spent_status;
-  spent_status.reserve(m_transfers.size());
-  const size_t chunk_size = 1000;
-  for (size_t start_offset = 0; start_offset < m_transfers.size(); start_offset += chunk_size)
+  spent_status.reserve(indices.size());
+  const size_t chunk_size = binary ? 5000 : 1000;
+  for (size_t start_offset = 0; start_offset < indices.size(); start_offset += chunk_size)
   {
-    const size_t n_outputs = std::min<size_t>(chunk_size, m_transfers.size() - start_offset);
-    MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << m_transfers.size());
-    COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
-    COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
-    for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
-      req.key_images.push_back(string_tools::pod_to_hex(m_transfers[n].m_key_image));
+    const size_t n_outputs = std::min<size_t>(chunk_size, indices.size() - start_offset);
+    MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << indices.size());
+    std::vector<int> chunk_status;
+    if (binary)
+    {
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT_BIN::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
+      req.key_images.reserve(n_outputs);
+      for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
+        req.key_images.push_back(m_transfers[indices[n]].m_key_image);
 
+      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+      uint64_t pre_call_credits = m_rpc_payment_state.credits;
+      req.client = get_client_signature();
+      bool r = epee::net_utils::invoke_http_bin("/is_key_image_spent.bin", req, daemon_resp, *m_http_client, rpc_timeout);
+      THROW_ON_RPC_RESPONSE_ERROR(r, {}, daemon_resp, "is_key_image_spent.bin", error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
+      check_rpc_cost("/is_key_image_spent.bin", daemon_resp.credits, pre_call_credits, n_outputs * COST_PER_KEY_IMAGE);
+      chunk_status = std::move(daemon_resp.spent_status);
+    }
+    else
     {
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
+      COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
+      req.key_images.reserve(n_outputs);
+      for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
+        req.key_images.push_back(string_tools::pod_to_hex(m_transfers[indices[n]].m_key_image));
+
       const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
       uint64_t pre_call_credits = m_rpc_payment_state.credits;
       req.client = get_client_signature();
       bool r = epee::net_utils::invoke_http_json("/is_key_image_spent", req, daemon_resp, *m_http_client, rpc_timeout);
       THROW_ON_RPC_RESPONSE_ERROR(r, {}, daemon_resp, "is_key_image_spent", error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
-      THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
-        "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
-        std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
       check_rpc_cost("/is_key_image_spent", daemon_resp.credits, pre_call_credits, n_outputs * COST_PER_KEY_IMAGE);
+      chunk_status = std::move(daemon_resp.spent_status);
     }
+    THROW_WALLET_EXCEPTION_IF(chunk_status.size() != n_outputs, error::wallet_internal_error,
+      "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
+      std::to_string(chunk_status.size()) + ", expected " +  std::to_string(n_outputs));
 
-    std::copy(daemon_resp.spent_status.begin(), daemon_resp.spent_status.end(), std::back_inserter(spent_status));
+    std::copy(chunk_status.begin(), chunk_status.end(), std::back_inserter(spent_status));
   }
 
   // update spent status
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t k = 0; k < indices.size(); ++k)
   {
+    const size_t i = indices[k];
     transfer_details& td = m_transfers[i];
-    // a view wallet may not know about key images
-    if (!td.m_key_image_known || td.m_key_image_partial)
-      continue;
-    if (td.m_spent != (spent_status[i] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT))
+    if (td.m_spent != (spent_status[k] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT))
     {
       if (td.m_spent)
       {
@@ -8063,7 +9177,7 @@ void wallet2::light_wallet_get_outs(std::vector<std::vector<tools::wallet2::get_
 
   MDEBUG("selected transfers size: " << selected_transfers.size());
 
-  std::unordered_set<crypto::public_key> valid_public_keys_cache;
+  std::unordered_set<crypto::public_key> &valid_public_keys_cache = get_valid_public_keys_cache();
   for(size_t idx: selected_transfers)
   { 
     // Create new index
@@ -9337,17 +10451,30 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
 
   LOG_PRINT_L2("pick_preferred_rct_inputs: needed_money " << print_money(needed_money));
 
-  // try to find a rct input of enough size
+  // filter the usable outputs once, rather than checking the whole of m_transfers
+  // again (including the unlock state, which may need the daemon's time) for
+  // every output we consider pairing
+  std::vector<size_t> candidates;
   for (size_t i = 0; i < m_transfers.size(); ++i)
   {
     const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    if (!is_spent(td, false) && !td.m_frozen && td.is_rct() && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1 && is_transfer_unlocked(td))
     {
       if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
       {
         MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
         continue;
       }
+      candidates.push_back(i);
+    }
+  }
+
+  // try to find a rct input of enough size
+  for (size_t i: candidates)
+  {
+    const transfer_details& td = m_transfers[i];
+    if (td.amount() >= needed_money)
+    {
       LOG_PRINT_L2("We can use " << i << " alone: " << print_money(td.amount()));
       picks.push_back(i);
       return picks;
@@ -9358,45 +10485,43 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   // this could be made better by picking one of the outputs to be a small one, since those
   // are less useful since often below the needed money, so if one can be used in a pair,
   // it gets rid of it for the future
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  // Both outputs must come from the same subaddress, so pairs are only looked for within
+  // each subaddress' outputs, still in m_transfers order
+  std::unordered_map<uint32_t, std::vector<size_t>> candidates_per_subaddr;
+  for (size_t i: candidates)
+    if (!m_transfers[i].m_key_image_partial)
+      candidates_per_subaddr[m_transfers[i].m_subaddr_index.minor].push_back(i);
+  std::unordered_map<uint32_t, size_t> next_in_subaddr;
+  for (size_t i: candidates)
   {
     const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
-    {
-      if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
-      {
-        MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
-        continue;
-      }
-      LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
-      for (size_t j = i + 1; j < m_transfers.size(); ++j)
-      {
-        const transfer_details& td2 = m_transfers[j];
-        if (td2.amount() > m_ignore_outputs_above || td2.amount() < m_ignore_outputs_below)
-        {
-          MDEBUG("Ignoring output " << j << " of amount " << print_money(td2.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
-          continue;
-        }
-        if (!is_spent(td2, false) && !td2.m_frozen && !td2.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
+    if (td.m_key_image_partial)
+      continue;
+    LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
+    const std::vector<size_t> &same_subaddr = candidates_per_subaddr[td.m_subaddr_index.minor];
+    for (size_t n = ++next_in_subaddr[td.m_subaddr_index.minor]; n < same_subaddr.size(); ++n)
+    {
+      const size_t j = same_subaddr[n];
+      const transfer_details& td2 = m_transfers[j];
+      if (td.amount() + td2.amount() >= needed_money)
+      {
+        // update our picks if those outputs are less related than any we
+        // already found. If the same, don't update, and oldest suitable outputs
+        // will be used in preference.
+        float relatedness = get_output_relatedness(td, td2);
+        LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
+        if (relatedness < current_output_relatdness)
         {
-          // update our picks if those outputs are less related than any we
-          // already found. If the same, don't update, and oldest suitable outputs
-          // will be used in preference.
-          float relatedness = get_output_relatedness(td, td2);
-          LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
-          if (relatedness < current_output_relatdness)
-          {
-            // reset the current picks with those, and return them directly
-            // if they're unrelated. If they are related, we'll end up returning
-            // them if we find nothing better
-            picks.clear();
-            picks.push_back(i);
-            picks.push_back(j);
-            LOG_PRINT_L0("we could use " << i << " and " << j);
-            if (relatedness == 0.0f)
-              return picks;
-            current_output_relatdness = relatedness;
-          }
+          // reset the current picks with those, and return them directly
+          // if they're unrelated. If they are related, we'll end up returning
+          // them if we find nothing better
+          picks.clear();
+          picks.push_back(i);
+          picks.push_back(j);
+          LOG_PRINT_L0("we could use " << i << " and " << j);
+          if (relatedness == 0.0f)
+            return picks;
+          current_output_relatdness = relatedness;
         }
       }
     }
@@ -9540,6 +10665,7 @@ void wallet2::light_wallet_get_unspent_outs()
   
   // Clear old outputs
   m_transfers.clear();
+  invalidate_reorg_index();
   
   for (const auto &o: ores.outputs) {
     bool spent = false;
@@ -9779,7 +10905,7 @@ void wallet2::light_wallet_get_address_txs()
         }
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
-          m_payments.emplace(tx_hash, payment);
+          add_to_transfer_history(*m_payments.emplace(tx_hash, payment));
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -9827,7 +10953,7 @@ void wallet2::light_wallet_get_address_txs()
             ctd.m_payment_id = payment_id;
             ctd.m_block_height = t.height;
             ctd.m_timestamp = t.timestamp;
-            m_confirmed_txs.emplace(tx_hash,ctd);
+            add_to_transfer_history(*m_confirmed_txs.emplace(tx_hash,ctd).first);
           }
           if (0 != m_callback)
           {
@@ -10021,7 +11147,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
     bulletproof_plus ? 4 : 3
   };
   const bool use_view_tags = use_fork_rules(get_view_tag_fork(), 0);
-  std::unordered_set<crypto::public_key> valid_public_keys_cache;
+  std::unordered_set<crypto::public_key> &valid_public_keys_cache = get_valid_public_keys_cache();
 
   const uint64_t base_fee  = get_base_fee(priority);
   const uint64_t fee_quantization_mask = get_fee_quantization_mask();
@@ -10479,9 +11605,8 @@ skip_tx:
     " total fee, " << print_money(accumulated_change) << " total change");
 
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
+  auto construct_final_tx = [&](TX &tx)
   {
-    TX &tx = *i;
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
     if (use_rct) {
@@ -10516,6 +11641,36 @@ skip_tx:
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.weight = get_transaction_weight(test_tx, txBlob.size());
+  };
+
+  // the decoys for every tx were already fetched while sizing them, so the final
+  // construction is pure proving and signing, and the txes are independent of
+  // each other; hardware devices and multisig keep their state across calls, so
+  // those stay serial
+  const bool parallel_construction = txes.size() > 1 && !m_multisig &&
+    hwdev.has_parallel_signing() &&
+    std::all_of(txes.begin(), txes.end(), [](const TX &tx) { return !tx.outs.empty(); });
+  if (parallel_construction)
+  {
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    std::vector<std::exception_ptr> exceptions(txes.size());
+    for (size_t i = 0; i < txes.size(); ++i)
+    {
+      tpool.submit(&waiter, [&, i]() {
+        try { construct_final_tx(txes[i]); }
+        catch (...) { exceptions[i] = std::current_exception(); }
+      });
+    }
+    waiter.wait();
+    for (const std::exception_ptr &e: exceptions)
+      if (e)
+        std::rethrow_exception(e);
+  }
+  else
+  {
+    for (TX &tx: txes)
+      construct_final_tx(tx);
   }
 
   std::vector<wallet2::pending_tx> ptx_vector;
@@ -10620,7 +11775,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(uint64_t below
   THROW_WALLET_EXCEPTION_IF(tx_weight_one_ring > tx_weight_two_rings, error::wallet_internal_error, "Estimated tx weight with 1 input is larger than with 2 inputs!");
   const size_t tx_weight_per_ring = tx_weight_two_rings - tx_weight_one_ring;
   const uint64_t fractional_threshold = (base_fee * tx_weight_per_ring) / (use_per_byte_fee ? 1 : 1024);
-  std::unordered_set<crypto::public_key> valid_public_keys_cache;
+  std::unordered_set<crypto::public_key> &valid_public_keys_cache = get_valid_public_keys_cache();
 
   THROW_WALLET_EXCEPTION_IF(unlocked_balance(subaddr_account, false) == 0, error::wallet_internal_error, "No unlocked balance in the specified account");
 
@@ -10702,7 +11857,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
   hw::device &hwdev = m_account.get_device();
   boost::unique_lock<hw::device> hwdev_lock (hwdev);
   hw::reset_mode rst(hwdev);  
-  std::unordered_set<crypto::public_key> valid_public_keys_cache;
+  std::unordered_set<crypto::public_key> &valid_public_keys_cache = get_valid_public_keys_cache();
 
   uint64_t accumulated_fee, accumulated_outputs, accumulated_change;
   struct TX {
@@ -10875,9 +12030,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     " total fee, " << print_money(accumulated_change) << " total change");
  
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
+  auto construct_final_tx = [&](TX &tx)
   {
-    TX &tx = *i;
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
     if (use_rct) {
@@ -10891,6 +12045,36 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.weight = get_transaction_weight(test_tx, txBlob.size());
+  };
+
+  // the decoys for every tx were already fetched while sizing them, so the final
+  // construction is pure proving and signing, and the txes are independent of
+  // each other; hardware devices and multisig keep their state across calls, so
+  // those stay serial
+  const bool parallel_construction = txes.size() > 1 && !m_multisig &&
+    hwdev.has_parallel_signing() &&
+    std::all_of(txes.begin(), txes.end(), [](const TX &tx) { return !tx.outs.empty(); });
+  if (parallel_construction)
+  {
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    std::vector<std::exception_ptr> exceptions(txes.size());
+    for (size_t i = 0; i < txes.size(); ++i)
+    {
+      tpool.submit(&waiter, [&, i]() {
+        try { construct_final_tx(txes[i]); }
+        catch (...) { exceptions[i] = std::current_exception(); }
+      });
+    }
+    waiter.wait();
+    for (const std::exception_ptr &e: exceptions)
+      if (e)
+        std::rethrow_exception(e);
+  }
+  else
+  {
+    for (TX &tx: txes)
+      construct_final_tx(tx);
   }
 
   std::vector<wallet2::pending_tx> ptx_vector;
@@ -10963,21 +12147,42 @@ void wallet2::cold_sign_tx(const std::vector<pending_tx>& ptx_vector, signed_tx_
   for (auto &c_ptx: exported_txs.ptx) LOG_PRINT_L0(cryptonote::obj_to_json_str(c_ptx.tx));
 }
 //----------------------------------------------------------------------------------------------------
-uint64_t wallet2::cold_key_image_sync(uint64_t &spent, uint64_t &unspent) {
+uint64_t wallet2::cold_key_image_sync(uint64_t &spent, uint64_t &unspent, bool all) {
   auto & hwdev = get_account().get_device();
   CHECK_AND_ASSERT_THROW_MES(hwdev.has_ki_cold_sync(), "Device does not support cold ki sync protocol");
 
   auto dev_cold = dynamic_cast<::hw::device_cold*>(&hwdev);
   CHECK_AND_ASSERT_THROW_MES(dev_cold, "Device does not implement cold signing interface");
 
+  // key images already obtained from the device are kept with the transfers, so unless asked for
+  // all of them, only the transfers from the first one without a full key image on are sent
+  size_t offset = 0;
+  if (!all)
+  {
+    while (offset < m_transfers.size() && m_transfers[offset].m_key_image_known && !m_transfers[offset].m_key_image_partial)
+      ++offset;
+  }
+  MDEBUG("Syncing key images with the device from transfer " << offset << "/" << m_transfers.size());
+
   std::vector<std::pair<crypto::key_image, crypto::signature>> ski;
-  hw::wallet_shim wallet_shim;
-  setup_shim(&wallet_shim, this);
+  if (offset < m_transfers.size() || offset == 0)
+  {
+    hw::wallet_shim wallet_shim;
+    setup_shim(&wallet_shim, this);
 
-  dev_cold->ki_sync(&wallet_shim, m_transfers, ski);
+    if (offset == 0)
+    {
+      dev_cold->ki_sync(&wallet_shim, m_transfers, ski);
+    }
+    else
+    {
+      const std::vector<transfer_details> transfers(m_transfers.begin() + offset, m_transfers.end());
+      dev_cold->ki_sync(&wallet_shim, transfers, ski);
+    }
+  }
 
   // Call COMMAND_RPC_IS_KEY_IMAGE_SPENT only if daemon is trusted.
-  uint64_t import_res = import_key_images(ski, 0, spent, unspent, is_trusted_daemon());
+  uint64_t import_res = import_key_images(ski, offset, spent, unspent, is_trusted_daemon() && !ski.empty());
   m_device_last_key_image_sync = time(NULL);
 
   return import_res;
@@ -11023,6 +12228,8 @@ bool wallet2::use_fork_rules(uint8_t version, int64_t early_blocks)
   if(m_light_wallet)
     return true;
   uint64_t height, earliest_height;
+  // the proxy caches are not synchronized, and txes may be constructed concurrently
+  const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
   boost::optional<std::string> result = m_node_rpc_proxy.get_height(height);
   THROW_WALLET_EXCEPTION_IF(result, error::wallet_internal_error, "Failed to get height");
   result = m_node_rpc_proxy.get_earliest_height(version, earliest_height);
@@ -12344,12 +13551,16 @@ bool wallet2::check_reserve_proof(const cryptonote::account_public_address &addr
   }
 
   // check signatures for all subaddress spend keys
+  std::vector<crypto::public_key> spendkeys;
+  std::vector<crypto::signature> spendkey_sigs;
+  spendkeys.reserve(subaddr_spendkeys.size());
+  spendkey_sigs.reserve(subaddr_spendkeys.size());
   for (const auto &i : subaddr_spendkeys)
   {
-    if (!crypto::check_signature(prefix_hash, i.first, i.second))
-      return false;
+    spendkeys.push_back(i.first);
+    spendkey_sigs.push_back(i.second);
   }
-  return true;
+  return crypto::check_signatures(prefix_hash, spendkeys.data(), spendkey_sigs.data(), spendkeys.size());
 }
 
 std::string wallet2::get_wallet_file() const
@@ -12732,7 +13943,13 @@ crypto::public_key wallet2::get_tx_pub_key_from_received_outs(const tools::walle
 bool wallet2::export_key_images(const std::string &filename, bool all) const
 {
   PERF_TIMER(export_key_images);
-  std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = export_key_images(all);
+  return save_to_file(filename, export_key_images_to_str(all));
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::export_key_images_to_str(bool all, uint32_t start, uint32_t count) const
+{
+  PERF_TIMER(export_key_images_to_str);
+  std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = export_key_images(all, start, count);
   std::string magic(KEY_IMAGE_EXPORT_FILE_MAGIC, strlen(KEY_IMAGE_EXPORT_FILE_MAGIC));
   const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
   const uint32_t offset = ski.first;
@@ -12755,24 +13972,29 @@ bool wallet2::export_key_images(const std::string &filename, bool all) const
   // encrypt data, keep magic plaintext
   PERF_TIMER(export_key_images_encrypt);
   std::string ciphertext = encrypt_with_view_secret_key(data);
-  return save_to_file(filename, magic + ciphertext);
+  return magic + ciphertext;
 }
 
 //----------------------------------------------------------------------------------------------------
-std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::export_key_images(bool all) const
+std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> wallet2::export_key_images(bool all, uint32_t start, uint32_t count) const
 {
   PERF_TIMER(export_key_images_raw);
   std::vector<std::pair<crypto::key_image, crypto::signature>> ski;
 
+  // same modes as export_outputs: all is subject to start/count, incremental to count only
+  THROW_WALLET_EXCEPTION_IF(!all && start > 0, error::wallet_internal_error, "Incremental mode is incompatible with non-zero start");
+
   size_t offset = 0;
   if (!all)
   {
     while (offset < m_transfers.size() && !m_transfers[offset].m_key_image_request)
       ++offset;
   }
+  else
+    offset = start;
 
-  ski.reserve(m_transfers.size() - offset);
-  for (size_t n = offset; n < m_transfers.size(); ++n)
+  ski.reserve(std::min<size_t>(count, m_transfers.size() - std::min(offset, m_transfers.size())));
+  for (size_t n = offset; n < m_transfers.size() && n - offset < count; ++n)
   {
     const transfer_details &td = m_transfers[n];
 
@@ -12780,12 +14002,6 @@ std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>
     const crypto::public_key pkey = td.get_public_key();
 
     // get tx pub key
-    std::vector<tx_extra_field> tx_extra_fields;
-    if(!parse_tx_extra(td.m_tx.extra, tx_extra_fields))
-    {
-      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-    }
-
     crypto::public_key tx_pub_key = get_tx_pub_key_from_received_outs(td);
     const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
 
@@ -12820,37 +14036,45 @@ uint64_t wallet2::import_key_images(const std::string &filename, uint64_t &spent
 
   THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, std::string(tr("failed to read file ")) + filename);
 
+  return import_key_images_from_str(data, spent, unspent);
+}
+
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::import_key_images_from_str(const std::string &key_images_st, uint64_t &spent, uint64_t &unspent)
+{
+  PERF_TIMER(import_key_images_from_str);
   const size_t magiclen = strlen(KEY_IMAGE_EXPORT_FILE_MAGIC);
-  if (data.size() < magiclen || memcmp(data.data(), KEY_IMAGE_EXPORT_FILE_MAGIC, magiclen))
+  if (key_images_st.size() < magiclen || memcmp(key_images_st.data(), KEY_IMAGE_EXPORT_FILE_MAGIC, magiclen))
   {
-    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Bad key image export file magic in ") + filename);
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Bad key image export magic"));
   }
 
+  std::string data;
   try
   {
     PERF_TIMER(import_key_images_decrypt);
-    data = decrypt_with_view_secret_key(std::string(data, magiclen));
+    data = decrypt_with_view_secret_key(std::string(key_images_st, magiclen));
   }
   catch (const std::exception &e)
   {
-    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt ") + filename + ": " + e.what());
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to decrypt key images: ") + e.what());
   }
 
   const size_t headerlen = 4 + 2 * sizeof(crypto::public_key);
-  THROW_WALLET_EXCEPTION_IF(data.size() < headerlen, error::wallet_internal_error, std::string("Bad data size from file ") + filename);
+  THROW_WALLET_EXCEPTION_IF(data.size() < headerlen, error::wallet_internal_error, std::string("Bad data size for key images"));
   const uint32_t offset = (uint8_t)data[0] | (((uint8_t)data[1]) << 8) | (((uint8_t)data[2]) << 16) | (((uint8_t)data[3]) << 24);
   const crypto::public_key &public_spend_key = *(const crypto::public_key*)&data[4];
   const crypto::public_key &public_view_key = *(const crypto::public_key*)&data[4 + sizeof(crypto::public_key)];
   const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
   if (public_spend_key != keys.m_spend_public_key || public_view_key != keys.m_view_public_key)
   {
-    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string( "Key images from ") + filename + " are for a different account");
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Key images are for a different account"));
   }
   THROW_WALLET_EXCEPTION_IF(offset > m_transfers.size(), error::wallet_internal_error, "Offset larger than known outputs");
 
   const size_t record_size = sizeof(crypto::key_image) + sizeof(crypto::signature);
   THROW_WALLET_EXCEPTION_IF((data.size() - headerlen) % record_size,
-      error::wallet_internal_error, std::string("Bad data size from file ") + filename);
+      error::wallet_internal_error, std::string("Bad data size for key images"));
   size_t nki = (data.size() - headerlen) / record_size;
 
   std::vector<std::pair<crypto::key_image, crypto::signature>> ski;
@@ -12944,6 +14168,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       transfer_details &td = m_transfers[n + offset];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
     }
+    invalidate_reorg_index();
   }
   spent = 0;
   unspent = 0;
@@ -13142,6 +14367,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
     }
     PERF_TIMER_STOP(import_key_images_G);
+    invalidate_transfer_history();
   }
 
   // this can be 0 if we do not know the height
@@ -13206,6 +14432,7 @@ void wallet2::import_payments(const payment_container &payments)
   {
     m_payments.emplace(p);
   }
+  invalidate_transfer_history();
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
@@ -13214,6 +14441,7 @@ void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2
   {
     m_confirmed_txs.emplace(p);
   }
+  invalidate_transfer_history();
 }
 
 std::tuple<size_t,crypto::hash,std::vector<crypto::hash>> wallet2::export_blockchain() const
@@ -13269,7 +14497,7 @@ std::tuple<uint64_t, uint64_t, std::vector<tools::wallet2::exported_transfer_det
   else
     offset = start;
 
-  outs.reserve(m_transfers.size() - offset);
+  outs.reserve(std::min<size_t>(count, m_transfers.size() - std::min(offset, m_transfers.size())));
   for (size_t n = offset; n < m_transfers.size() && n - offset < count; ++n)
   {
     const transfer_details &td = m_transfers[n];
@@ -13339,6 +14567,7 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
     m_transfers.resize(offset + output_array.size());
   else if (num_outputs < m_transfers.size())
     m_transfers.resize(num_outputs);
+  invalidate_reorg_index();
 
   for (size_t i = 0; i < output_array.size(); ++i)
   {
@@ -13419,6 +14648,7 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
     m_transfers.resize(offset + output_array.size());
   else if (num_outputs < m_transfers.size())
     m_transfers.resize(num_outputs);
+  invalidate_reorg_index();
 
   for (size_t i = 0; i < output_array.size(); ++i)
   {
@@ -13679,14 +14909,21 @@ crypto::key_image wallet2::get_multisig_composite_key_image(size_t n) const
 {
   CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad output index");
 
+  std::vector<crypto::key_image> pkis;
+  for (const auto &info: m_transfers[n].m_multisig_info)
+    for (const auto &pki: info.m_partial_key_images)
+      pkis.push_back(pki);
+  return get_multisig_composite_key_image(n, pkis);
+}
+//----------------------------------------------------------------------------------------------------
+crypto::key_image wallet2::get_multisig_composite_key_image(size_t n, const std::vector<crypto::key_image> &pkis) const
+{
+  CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad output index");
+
   const transfer_details &td = m_transfers[n];
   const crypto::public_key tx_key = get_tx_pub_key_from_received_outs(td);
   const std::vector<crypto::public_key> additional_tx_keys = cryptonote::get_additional_tx_pub_keys_from_extra(td.m_tx);
   crypto::key_image ki;
-  std::vector<crypto::key_image> pkis;
-  for (const auto &info: td.m_multisig_info)
-    for (const auto &pki: info.m_partial_key_images)
-      pkis.push_back(pki);
   bool r = multisig::generate_multisig_composite_key_image(get_account().get_keys(), m_subaddresses, td.get_public_key(), tx_key, additional_tx_keys, td.m_internal_output_index, pkis, ki);
   THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
   return ki;
@@ -13760,12 +14997,31 @@ cryptonote::blobdata wallet2::export_multisig()
   return MULTISIG_EXPORT_FILE_MAGIC + ciphertext;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n)
+bool wallet2::multisig_key_image_needs_update(const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n) const
+{
+  CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad index in multisig_key_image_needs_update");
+
+  // the composite key image only depends on the partial key images, which
+  // stay the same over signing rounds while the nonces change
+  const transfer_details &td = m_transfers[n];
+  if (!td.m_key_image_known || td.m_key_image_partial || td.m_multisig_info.size() != info.size())
+    return true;
+  for (size_t i = 0; i < info.size(); ++i)
+  {
+    CHECK_AND_ASSERT_THROW_MES(n < info[i].size(), "Bad pi size");
+    if (td.m_multisig_info[i].m_signer != info[i][n].m_signer || td.m_multisig_info[i].m_partial_key_images != info[i][n].m_partial_key_images)
+      return true;
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n, const crypto::key_image *composite_key_image)
 {
   CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad index in update_multisig_info");
   CHECK_AND_ASSERT_THROW_MES(multisig_k.size() >= m_transfers.size(), "Mismatched sizes of multisig_k and info");
 
   MDEBUG("update_multisig_rescan_info: updating index " << n);
+  const bool compose = composite_key_image || multisig_key_image_needs_update(info, n);
   transfer_details &td = m_transfers[n];
   td.m_multisig_info.clear();
   for (const auto &pi: info)
@@ -13773,13 +15029,16 @@ void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key
     CHECK_AND_ASSERT_THROW_MES(n < pi.size(), "Bad pi size");
     td.m_multisig_info.push_back(pi[n]);
   }
-  m_key_images.erase(td.m_key_image);
-  td.m_key_image = get_multisig_composite_key_image(n);
+  if (compose)
+  {
+    m_key_images.erase(td.m_key_image);
+    td.m_key_image = composite_key_image ? *composite_key_image : get_multisig_composite_key_image(n);
+    m_key_images[td.m_key_image] = n;
+  }
   td.m_key_image_known = true;
   td.m_key_image_request = false;
   td.m_key_image_partial = false;
   td.m_multisig_k = multisig_k[n];
-  m_key_images[td.m_key_image] = n;
 }
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_multisig(std::vector<cryptonote::blobdata> blobs)
@@ -13902,9 +15161,48 @@ size_t wallet2::import_multisig(std::vector<cryptonote::blobdata> blobs)
     break;
   }
 
-  for (size_t n = 0; n < n_outputs && n < m_transfers.size(); ++n)
+  // composing key images is the expensive part, and only needed for outputs
+  // whose partial key images changed, so those are composed up front in parallel
+  const size_t n_update = std::min(n_outputs, m_transfers.size());
+  std::vector<size_t> to_compose;
+  for (size_t n = 0; n < n_update; ++n)
+    if (multisig_key_image_needs_update(info, n))
+      to_compose.push_back(n);
+  MINFO(to_compose.size() << "/" << n_update << " multisig key images to compose");
+
+  std::vector<crypto::key_image> composite_key_images(n_update);
+  std::vector<uint8_t> composed(n_update, 0);
+  hw::device &hwdev = m_account.get_device();
+  if (hwdev.get_type() == hw::device::device_type::SOFTWARE && to_compose.size() > 1)
+  {
+    tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+    tools::threadpool::waiter waiter(tpool);
+    const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+    const size_t chunk = std::max<size_t>(4, (to_compose.size() + threads - 1) / threads);
+    for (size_t start = 0; start < to_compose.size(); start += chunk)
+    {
+      const size_t end = std::min(to_compose.size(), start + chunk);
+      tpool.submit(&waiter, [this, start, end, &to_compose, &info, &composite_key_images](){
+        std::vector<crypto::key_image> pkis;
+        for (size_t i = start; i < end; ++i)
+        {
+          const size_t n = to_compose[i];
+          pkis.clear();
+          for (const auto &pi: info)
+            for (const auto &pki: pi[n].m_partial_key_images)
+              pkis.push_back(pki);
+          composite_key_images[n] = get_multisig_composite_key_image(n, pkis);
+        }
+      }, true);
+    }
+    THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Failed to compose multisig key images");
+    for (size_t n: to_compose)
+      composed[n] = 1;
+  }
+
+  for (size_t n = 0; n < n_update; ++n)
   {
-    update_multisig_rescan_info(k, info, n);
+    update_multisig_rescan_info(k, info, n, composed[n] ? &composite_key_images[n] : NULL);
   }
 
   m_multisig_rescan_k = &k;
@@ -52,7 +52,11 @@
 #include "storages/http_abstract_invoke.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/transaction_view.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_core/gamma_picker.h"
+#include "common/data_cache.h"
+#include "common/flat_index_map.h"
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/util.h"
 #include "crypto/chacha.h"
@@ -95,29 +99,7 @@ namespace tools
   class wallet2;
   class Notify;
 
-  class gamma_picker
-  {
-  public:
-    uint64_t pick();
-    gamma_picker(const std::vector<uint64_t> &rct_offsets);
-    gamma_picker(const std::vector<uint64_t> &rct_offsets, double shape, double scale);
-
-  private:
-    struct gamma_engine
-    {
-      typedef uint64_t result_type;
-      static constexpr result_type min() { return 0; }
-      static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
-      result_type operator()() { return crypto::rand<result_type>(); }
-    } engine;
-
-private:
-    std::gamma_distribution<double> gamma;
-    const std::vector<uint64_t> &rct_offsets;
-    const uint64_t *begin, *end;
-    uint64_t num_rct_outputs;
-    double average_output_time;
-  };
+  using cryptonote::gamma_picker;
 
   class wallet_keys_unlocker
   {
@@ -809,11 +791,11 @@ private:
 
     struct tx_cache_data
     {
-      std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+      cryptonote::tx_extra_view tx_extra; // of the tx this was cached for
       std::vector<is_out_data> primary;
       std::vector<is_out_data> additional;
 
-      bool empty() const { return tx_extra_fields.empty() && primary.empty() && additional.empty(); }
+      bool empty() const { return tx_extra.empty() && primary.empty() && additional.empty(); }
     };
 
     /*!
@@ -965,6 +947,13 @@ private:
     bool set_daemon(std::string daemon_address = "http://localhost:8080",
       boost::optional<epee::net_utils::http::login> daemon_login = boost::none, bool trusted_daemon = true,
       epee::net_utils::ssl_options_t ssl_options = epee::net_utils::ssl_support_t::e_ssl_support_autodetect);
+    /*!
+     * \brief Sets other daemons to fall back on when the current one fails, or
+     *        to move to when they answer much faster. They share the login, SSL
+     *        options and trust setting of the current daemon.
+     */
+    void set_daemon_fallbacks(std::vector<std::string> addresses);
+    const std::vector<std::string> &get_daemon_fallbacks() const { return m_daemon_fallbacks; }
     bool set_proxy(const std::string &address);
 
     void stop() { m_run.store(false, std::memory_order_relaxed); m_message_store.stop(); }
@@ -1005,12 +994,22 @@ private:
     crypto::public_key get_subaddress_spend_public_key(const cryptonote::subaddress_index& index) const;
     std::vector<crypto::public_key> get_subaddress_spend_public_keys(uint32_t account, uint32_t begin, uint32_t end) const;
     std::string get_subaddress_as_str(const cryptonote::subaddress_index& index) const;
+    /*!
+     * \brief get_subaddress_as_str for many subaddresses of an account,
+     *        computed in parallel with a software device
+     */
+    std::vector<std::string> get_subaddresses_as_str(uint32_t account, const std::vector<uint32_t> &minor_indices) const;
     std::string get_address_as_str() const { return get_subaddress_as_str({0, 0}); }
     std::string get_integrated_address_as_str(const crypto::hash8& payment_id) const;
     void add_subaddress_account(const std::string& label);
     size_t get_num_subaddress_accounts() const { return m_subaddress_labels.size(); }
     size_t get_num_subaddresses(uint32_t index_major) const { return index_major < m_subaddress_labels.size() ? m_subaddress_labels[index_major].size() : 0; }
     void add_subaddress(uint32_t index_major, const std::string& label); // throws when index is out of bound
+    /*!
+     * \brief add count subaddresses to an account with a single lookahead expansion
+     * \return the minor index of the first subaddress added
+     */
+    uint32_t add_subaddresses(uint32_t index_major, uint32_t count, const std::string& label);
     void expand_subaddresses(const cryptonote::subaddress_index& index);
     void create_one_off_subaddress(const cryptonote::subaddress_index& index);
     std::string get_subaddress_label(const cryptonote::subaddress_index& index) const;
@@ -1083,7 +1082,7 @@ private:
     bool sanity_check(const std::vector<wallet2::pending_tx> &ptx_vector, std::vector<cryptonote::tx_destination_entry> dsts) const;
     void cold_tx_aux_import(const std::vector<pending_tx>& ptx, const std::vector<std::string>& tx_device_aux);
     void cold_sign_tx(const std::vector<pending_tx>& ptx_vector, signed_tx_set &exported_txs, std::vector<cryptonote::address_parse_info> &dsts_info, std::vector<std::string> & tx_device_aux);
-    uint64_t cold_key_image_sync(uint64_t &spent, uint64_t &unspent);
+    uint64_t cold_key_image_sync(uint64_t &spent, uint64_t &unspent, bool all = false);
     void device_show_address(uint32_t account_index, uint32_t address_index, const boost::optional<crypto::hash8> &payment_id);
     bool parse_multisig_tx_from_str(std::string multisig_tx_st, multisig_tx_set &exported_txs) const;
     bool load_multisig_tx(cryptonote::blobdata blob, multisig_tx_set &exported_txs, std::function<bool(const multisig_tx_set&)> accept_func = NULL);
@@ -1104,6 +1103,29 @@ private:
     void get_unconfirmed_payments_out(std::list<std::pair<crypto::hash,wallet2::unconfirmed_transfer_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
     void get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2::pool_payment_details>>& unconfirmed_payments, const boost::optional<uint32_t>& subaddr_account = boost::none, const std::set<uint32_t>& subaddr_indices = {}) const;
 
+    // position in the transfer history, ordered by height; a generation
+    // of 0 means the start, and any other generation not matching the
+    // current one means the history was rewritten (reorg, rescan, import)
+    struct transfer_history_cursor
+    {
+      uint64_t generation;
+      uint64_t height;
+      uint64_t seq;
+    };
+    struct transfer_history_page
+    {
+      std::vector<std::pair<crypto::hash, payment_details>> in;
+      std::vector<std::pair<crypto::hash, confirmed_transfer_details>> out;
+      transfer_history_cursor next; // resume point, also valid once the history is exhausted
+      bool more;                    // the limit was hit before the end
+      bool reset;                   // the cursor was stale and the page starts over
+    };
+    // confirmed in/out transfers after the cursor, in height order, with the same
+    // height and subaddress semantics as get_payments/get_payments_out; at most
+    // limit entries (0 for no limit), costing O(log n + entries scanned)
+    void get_transfer_history(const transfer_history_cursor &cursor, size_t limit, bool in, bool out,
+      uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices, transfer_history_page &page) const;
+
     uint64_t get_blockchain_current_height() const { return m_light_wallet_blockchain_height ? m_light_wallet_blockchain_height : m_blockchain.size(); }
     void rescan_spent();
     void rescan_blockchain(bool hard, bool refresh = true, bool keep_key_images = false);
@@ -1135,9 +1157,12 @@ private:
       {
         a & m_blockchain;
       }
+      // the key image and public key indexes are rebuilt from m_transfers
+      std::unordered_map<crypto::key_image, size_t> dummy_key_images;
+      std::unordered_map<crypto::public_key, size_t> dummy_pub_keys;
       a & m_transfers;
       a & m_account_public_address;
-      a & m_key_images.parent();
+      a & dummy_key_images;
       if(ver < 6)
         return;
       a & m_unconfirmed_txs.parent();
@@ -1170,17 +1195,8 @@ private:
       if(ver < 14)
         return;
       if(ver < 15)
-      {
-        // we're loading an older wallet without a pubkey map, rebuild it
-        m_pub_keys.clear();
-        for (size_t i = 0; i < m_transfers.size(); ++i)
-        {
-          const transfer_details &td = m_transfers[i];
-          m_pub_keys.emplace(td.get_public_key(), i);
-        }
         return;
-      }
-      a & m_pub_keys.parent();
+      a & dummy_pub_keys;
       if(ver < 16)
         return;
       a & m_address_book;
@@ -1243,18 +1259,27 @@ private:
 
     BEGIN_SERIALIZE_OBJECT()
       MAGIC_FIELD("monero wallet cache")
-      VERSION_FIELD(1)
+      VERSION_FIELD(2)
       FIELD(m_blockchain)
       FIELD(m_transfers)
       FIELD(m_account_public_address)
-      FIELD(m_key_images)
+      // the key image and public key indexes are rebuilt from m_transfers
+      if (version < 2)
+      {
+        serializable_unordered_map<crypto::key_image, size_t> dummy_key_images;
+        FIELD_N("m_key_images", dummy_key_images)
+      }
       FIELD(m_unconfirmed_txs)
       FIELD(m_payments)
       FIELD(m_tx_keys)
       FIELD(m_confirmed_txs)
       FIELD(m_tx_notes)
       FIELD(m_unconfirmed_payments)
-      FIELD(m_pub_keys)
+      if (version < 2)
+      {
+        serializable_unordered_map<crypto::public_key, size_t> dummy_pub_keys;
+        FIELD_N("m_pub_keys", dummy_pub_keys)
+      }
       FIELD(m_address_book)
       FIELD(m_scanned_pool_txs[0])
       FIELD(m_scanned_pool_txs[1])
@@ -1362,6 +1387,8 @@ private:
     void credits_target(uint64_t threshold) { m_credits_target = threshold; }
     bool is_multisig_enabled() const { return m_enable_multisig; }
     void enable_multisig(bool enable) { m_enable_multisig = enable; }
+    bool compress_cache() const { return m_compress_cache; }
+    void compress_cache(bool compress) { m_compress_cache = compress; }
     bool is_mismatched_daemon_version_allowed() const { return m_allow_mismatched_daemon_version; }
     void allow_mismatched_daemon_version(bool allow_mismatch) { m_allow_mismatched_daemon_version = allow_mismatch; }
 
@@ -1499,9 +1526,11 @@ private:
     std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> export_blockchain() const;
     void import_blockchain(const std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> &bc);
     bool export_key_images(const std::string &filename, bool all = false) const;
-    std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> export_key_images(bool all = false) const;
+    std::string export_key_images_to_str(bool all = false, uint32_t start = 0, uint32_t count = 0xffffffff) const;
+    std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> export_key_images(bool all = false, uint32_t start = 0, uint32_t count = 0xffffffff) const;
     uint64_t import_key_images(const std::vector<std::pair<crypto::key_image, crypto::signature>> &signed_key_images, size_t offset, uint64_t &spent, uint64_t &unspent, bool check_spent = true);
     uint64_t import_key_images(const std::string &filename, uint64_t &spent, uint64_t &unspent);
+    uint64_t import_key_images_from_str(const std::string &data, uint64_t &spent, uint64_t &unspent);
     bool import_key_images(std::vector<crypto::key_image> key_images, size_t offset=0, boost::optional<std::unordered_set<size_t>> selected_transfers=boost::none);
     bool import_key_images(signed_tx_set & signed_tx, size_t offset=0, bool only_selected_transfers=false);
     crypto::public_key get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td) const;
@@ -1509,6 +1538,7 @@ private:
     void update_pool_state(std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> &process_txs, bool refreshed = false);
     void process_pool_state(const std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> &txs);
     void remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashes);
+    std::vector<crypto::hash> get_pool_hashes();
 
     std::string encrypt(const char *plaintext, size_t len, const crypto::secret_key &skey, bool authenticated = true) const;
     std::string encrypt(const epee::span<char> &span, const crypto::secret_key &skey, bool authenticated = true) const;
@@ -1709,12 +1739,20 @@ private:
     void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t &current_height);
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
+    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t &current_height, bool &last, bool &error, std::exception_ptr &exception);
+    void pull_and_parse_blocks_at(uint64_t start_height, size_t connection, uint64_t &blocks_start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, uint64_t &current_height, bool &error);
+    void parse_pulled_blocks(uint64_t blocks_start_height, const std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<parsed_block> &parsed_blocks, bool &error);
     void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height);
     void process_outgoing(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices);
+    void add_to_transfer_history(const std::pair<const crypto::hash, payment_details> &payment);
+    void add_to_transfer_history(const std::pair<const crypto::hash, confirmed_transfer_details> &payment);
+    void invalidate_transfer_history();
+    void rebuild_transfer_history() const;
+    void invalidate_reorg_index();
+    void rebuild_reorg_index();
     void add_unconfirmed_tx(const cryptonote::transaction& tx, uint64_t amount_in, const std::vector<cryptonote::tx_destination_entry> &dests, const crypto::hash &payment_id, uint64_t change_amount, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices);
     void generate_genesis(cryptonote::block& b) const;
     void check_genesis(const crypto::hash& genesis_hash) const; //throws
@@ -1741,11 +1779,14 @@ private:
     std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t i, tx_scan_info_t &tx_scan_info, int &num_vouts_received, std::unordered_map<cryptonote::subaddress_index, uint64_t> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool);
     void trim_hashchain();
+    void rebuild_key_indexes();
     crypto::key_image get_multisig_composite_key_image(size_t n) const;
+    crypto::key_image get_multisig_composite_key_image(size_t n, const std::vector<crypto::key_image> &pkis) const;
+    bool multisig_key_image_needs_update(const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n) const;
     rct::multisig_kLRki get_multisig_composite_kLRki(size_t n,  const std::unordered_set<crypto::public_key> &ignore_set, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
     rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
     void get_multisig_k(size_t idx, const std::unordered_set<rct::key> &used_L, rct::key &nonce);
-    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n);
+    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<tools::wallet2::multisig_info>> &info, size_t n, const crypto::key_image *composite_key_image = NULL);
     bool add_rings(const crypto::chacha_key &key, const cryptonote::transaction_prefix &tx);
     bool add_rings(const cryptonote::transaction_prefix &tx);
     bool remove_rings(const cryptonote::transaction_prefix &tx);
@@ -1758,6 +1799,8 @@ private:
     hw::device& lookup_device(const std::string & device_descriptor);
 
     bool get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution);
+    bool fetch_rct_distribution(uint64_t from_height, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base);
+    std::unordered_set<crypto::public_key> &get_valid_public_keys_cache();
 
     uint64_t get_segregation_fork_height() const;
 
@@ -1781,6 +1824,15 @@ private:
     std::string get_client_signature() const;
     void check_rpc_cost(const char *call, uint64_t post_call_credits, uint64_t pre_credits, double expected_cost);
 
+    struct daemon_health
+    {
+      bool reachable = false;
+      bool consistent = false; //!< has our top block, so can carry on from where we are
+      uint64_t latency_us = 0;
+      time_t down_until = 0;
+    };
+    bool probe_daemon(const std::string &address, daemon_health &health);
+    bool select_daemon(bool current_failed);
     bool should_expand(const cryptonote::subaddress_index &index) const;
     bool spends_one_of_ours(const cryptonote::transaction &tx) const;
 
@@ -1791,6 +1843,21 @@ private:
     std::string m_keys_file;
     std::string m_mms_file;
     const std::unique_ptr<epee::net_utils::http::abstract_http_client> m_http_client;
+    //! second persistent connection, so block pulls can overlap the other daemon queries
+    const std::unique_ptr<epee::net_utils::http::abstract_http_client> m_blocks_http_client;
+    //! health checks of the daemon set, kept off the connections in use
+    const std::unique_ptr<epee::net_utils::http::abstract_http_client> m_daemon_probe_client;
+    struct prefetch_connection
+    {
+      std::unique_ptr<epee::net_utils::http::abstract_http_client> client;
+      boost::mutex mutex;
+    };
+    //! one connection per block pull prefetched ahead of the batch being processed
+    std::vector<std::unique_ptr<prefetch_connection>> m_prefetch_connections;
+    epee::net_utils::ssl_options_t m_daemon_ssl_options;
+    std::vector<std::string> m_daemon_fallbacks;
+    std::unordered_map<std::string, daemon_health> m_daemon_health;
+    time_t m_daemon_probe_time;
     hashchain m_blockchain;
     serializable_unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
     serializable_unordered_map<crypto::hash, confirmed_transfer_details> m_confirmed_txs;
@@ -1801,8 +1868,8 @@ private:
 
     transfer_container m_transfers;
     payment_container m_payments;
-    serializable_unordered_map<crypto::key_image, size_t> m_key_images;
-    serializable_unordered_map<crypto::public_key, size_t> m_pub_keys;
+    tools::flat_index_map<crypto::key_image> m_key_images; //!< not stored, rebuilt from m_transfers on load
+    tools::flat_index_map<crypto::public_key> m_pub_keys; //!< not stored, rebuilt from m_transfers on load
     cryptonote::account_public_address m_account_public_address;
     serializable_unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
     std::vector<std::vector<std::string>> m_subaddress_labels;
@@ -1818,6 +1885,8 @@ private:
     std::atomic<bool> m_run;
 
     boost::recursive_mutex m_daemon_rpc_mutex;
+    boost::recursive_mutex m_daemon_blocks_rpc_mutex;
+    std::atomic<bool> m_parallel_daemon_rpc;
 
     bool m_trusted_daemon;
     i_wallet2_callback* m_callback;
@@ -1871,18 +1940,51 @@ private:
     NodeRPCProxy m_node_rpc_proxy;
     std::unordered_set<crypto::hash> m_scanned_pool_txs[2];
     size_t m_subaddress_lookahead_major, m_subaddress_lookahead_minor;
+    mutable tools::sharded_lru_cache<cryptonote::subaddress_index, std::string> m_subaddress_str_cache; //!< encoded subaddresses
     std::string m_device_name;
     std::string m_device_derivation_path;
     uint64_t m_device_last_key_image_sync;
     bool m_use_dns;
     bool m_offline;
     uint32_t m_rpc_version;
+    std::unordered_set<crypto::hash> m_pool_hashes; //!< daemon pool as of m_pool_revision
+    uint64_t m_pool_revision; //!< daemon pool change log revision, 0 if m_pool_hashes is out of sync
     crypto::secret_key m_rpc_client_secret_key;
     rpc_payment_state_t m_rpc_payment_state;
     uint64_t m_credits_target;
     bool m_enable_multisig;
     bool m_allow_mismatched_daemon_version;
 
+    // chain data kept across tx constructions: the cumulative rct output
+    // distribution (topped up from the daemon as the chain grows) and the
+    // ring member keys already checked to be in the main subgroup
+    std::vector<uint64_t> m_rct_distribution;
+    uint64_t m_rct_distribution_start_height;
+    std::unordered_set<crypto::public_key> m_valid_public_keys_cache;
+
+    // per account index of m_payments and m_confirmed_txs keyed by (height, seq),
+    // built on first use and extended as transfers are added; anything that
+    // removes or moves entries drops it so the next use rebuilds it
+    struct transfer_history_entry
+    {
+      const std::pair<const crypto::hash, payment_details> *in;
+      const std::pair<const crypto::hash, confirmed_transfer_details> *out;
+    };
+    typedef std::map<std::pair<uint64_t, uint64_t>, transfer_history_entry> transfer_history_index;
+    mutable std::unordered_map<uint32_t, transfer_history_index> m_transfer_history;
+    mutable bool m_transfer_history_valid;
+    mutable uint64_t m_transfer_history_generation;
+    mutable uint64_t m_transfer_history_next_seq;
+    mutable uint64_t m_transfer_history_top_height;
+
+    // m_transfers indices by the height they were spent at and by the heights
+    // they were used as ring members at, so a reorg only visits the transfers
+    // it touches; built on first detach and kept up to date by set_spent,
+    // set_unspent and use tracking, anything else touching them drops it
+    std::multimap<uint64_t, size_t> m_spent_index;
+    std::multimap<uint64_t, size_t> m_uses_index;
+    bool m_reorg_index_valid;
+
     // Aux transaction data from device
     serializable_unordered_map<crypto::hash, std::string> m_tx_device;
 
@@ -1924,6 +2026,7 @@ private:
 
     ExportFormat m_export_format;
     bool m_load_deprecated_formats;
+    bool m_compress_cache;
 
     bool m_has_ever_refreshed_from_node;
 
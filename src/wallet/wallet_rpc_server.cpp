@@ -33,6 +33,8 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <cstdint>
+#include <cinttypes>
+#include <unordered_set>
 #include "include_base_utils.h"
 using namespace epee;
 
@@ -41,6 +43,7 @@ using namespace epee;
 #include "wallet/wallet_args.h"
 #include "common/command_line.h"
 #include "common/i18n.h"
+#include "common/perf_timer.h"
 #include "common/scoped_message_writer.h"
 #include "cryptonote_config.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
@@ -61,6 +64,8 @@ using namespace epee;
 
 #define DEFAULT_AUTO_REFRESH_PERIOD 20 // seconds
 #define REFRESH_INFICATIVE_BLOCK_CHUNK_SIZE 256    // just to split refresh in separate calls to play nicer with other threads
+#define MAX_WALLET_EVENTS 10000
+#define MAX_CREATE_ADDRESS_COUNT 65536
 
 #define CHECK_MULTISIG_ENABLED() \
   do \
@@ -118,6 +123,22 @@ namespace
         entry.suggested_confirmations_threshold = std::max(entry.suggested_confirmations_threshold, (unlock_time - now + DIFFICULTY_TARGET_V2 - 1) / DIFFICULTY_TARGET_V2);
     }
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string format_transfer_history_cursor(const tools::wallet2::transfer_history_cursor &cursor)
+  {
+    return std::to_string(cursor.generation) + ":" + std::to_string(cursor.height) + ":" + std::to_string(cursor.seq);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool parse_transfer_history_cursor(const std::string &s, tools::wallet2::transfer_history_cursor &cursor)
+  {
+    cursor = {0, 0, 0};
+    if (s.empty())
+      return true;
+    int consumed = 0;
+    if (sscanf(s.c_str(), "%" SCNu64 ":%" SCNu64 ":%" SCNu64 "%n", &cursor.generation, &cursor.height, &cursor.seq, &consumed) != 3)
+      return false;
+    return consumed == (int)s.size();
+  }
 }
 
 namespace tools
@@ -128,7 +149,7 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_restricted(false), m_vm(NULL), m_events_next_seq(0)
   {
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -141,6 +162,11 @@ namespace tools
   void wallet_rpc_server::set_wallet(wallet2 *cr)
   {
     m_wallet = cr;
+    // events from the previous wallet are meaningless now, but keep numbering
+    // so a client still on the old sequence sees it missed something
+    m_events.clear();
+    if (m_wallet)
+      m_wallet->callback(this);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::run()
@@ -534,18 +560,28 @@ namespace tools
       {
         req_address_index = req.address_index;
       }
+      const uint32_t num_subaddresses = m_wallet->get_num_subaddresses(req.account_index);
+      for (uint32_t i : req_address_index)
+        THROW_WALLET_EXCEPTION_IF(i >= num_subaddresses, error::address_index_outofbound);
+
       tools::wallet2::transfer_container transfers;
       m_wallet->get_transfers(transfers);
-      for (uint32_t i : req_address_index)
+      std::unordered_set<uint32_t> used;
+      for (const tools::wallet2::transfer_details& td : transfers)
+        if (td.m_subaddr_index.major == req.account_index)
+          used.insert(td.m_subaddr_index.minor);
+
+      const std::vector<std::string> addresses = m_wallet->get_subaddresses_as_str(req.account_index, req_address_index);
+      res.addresses.reserve(req_address_index.size());
+      for (size_t n = 0; n < req_address_index.size(); ++n)
       {
-        THROW_WALLET_EXCEPTION_IF(i >= m_wallet->get_num_subaddresses(req.account_index), error::address_index_outofbound);
         res.addresses.resize(res.addresses.size() + 1);
         auto& info = res.addresses.back();
-        const cryptonote::subaddress_index index = {req.account_index, i};
-        info.address = m_wallet->get_subaddress_as_str(index);
+        const cryptonote::subaddress_index index = {req.account_index, req_address_index[n]};
+        info.address = addresses[n];
         info.label = m_wallet->get_subaddress_label(index);
         info.address_index = index.minor;
-        info.used = std::find_if(transfers.begin(), transfers.end(), [&](const tools::wallet2::transfer_details& td) { return td.m_subaddr_index == index; }) != transfers.end();
+        info.used = used.count(index.minor) != 0;
       }
       res.address = m_wallet->get_subaddress_as_str({req.account_index, 0});
     }
@@ -583,24 +619,18 @@ namespace tools
     if (!m_wallet) return not_open(er);
     try
     {
-      if (req.count < 1 || req.count > 64) {
+      if (req.count < 1 || req.count > MAX_CREATE_ADDRESS_COUNT) {
         er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
-        er.message = "Count must be between 1 and 64.";
+        er.message = "Count must be between 1 and " + std::to_string(MAX_CREATE_ADDRESS_COUNT) + ".";
         return false;
       }
 
-      std::vector<std::string> addresses;
-      std::vector<uint32_t>    address_indices;
-
-      addresses.reserve(req.count);
-      address_indices.reserve(req.count);
-
-      for (uint32_t i = 0; i < req.count; i++) {
-        m_wallet->add_subaddress(req.account_index, req.label);
-        uint32_t new_address_index = m_wallet->get_num_subaddresses(req.account_index) - 1;
-        address_indices.push_back(new_address_index);
-        addresses.push_back(m_wallet->get_subaddress_as_str({req.account_index, new_address_index}));
-      }
+      // one lookahead expansion for the whole batch
+      const uint32_t first_index = m_wallet->add_subaddresses(req.account_index, req.count, req.label);
+      std::vector<uint32_t> address_indices(req.count);
+      for (uint32_t i = 0; i < req.count; i++)
+        address_indices[i] = first_index + i;
+      std::vector<std::string> addresses = m_wallet->get_subaddresses_as_str(req.account_index, address_indices);
 
       res.address = addresses[0];
       res.address_index = address_indices[0];
@@ -2635,25 +2665,29 @@ namespace tools
       subaddr_indices.clear();
     }
 
-    if (req.in)
+    tools::wallet2::transfer_history_cursor cursor;
+    if (!parse_transfer_history_cursor(req.cursor, cursor))
     {
-      std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-      m_wallet->get_payments(payments, min_height, max_height, account_index, subaddr_indices);
-      for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
-        res.in.push_back(wallet_rpc::transfer_entry());
-        fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
-      }
+      er.code = WALLET_RPC_ERROR_CODE_WRONG_CURSOR;
+      er.message = "Invalid cursor: " + req.cursor;
+      return false;
     }
 
-    if (req.out)
+    tools::wallet2::transfer_history_page page;
+    m_wallet->get_transfer_history(cursor, req.limit, req.in, req.out, min_height, max_height, account_index, subaddr_indices, page);
+    for (const auto &p: page.in)
     {
-      std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-      m_wallet->get_payments_out(payments, min_height, max_height, account_index, subaddr_indices);
-      for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
-        res.out.push_back(wallet_rpc::transfer_entry());
-        fill_transfer_entry(res.out.back(), i->first, i->second);
-      }
+      res.in.push_back(wallet_rpc::transfer_entry());
+      fill_transfer_entry(res.in.back(), p.second.m_tx_hash, p.first, p.second);
     }
+    for (const auto &p: page.out)
+    {
+      res.out.push_back(wallet_rpc::transfer_entry());
+      fill_transfer_entry(res.out.back(), p.first, p.second);
+    }
+    res.next_cursor = format_transfer_history_cursor(page.next);
+    res.more = page.more;
+    res.reset = page.reset;
 
     if (req.pending || req.failed) {
       std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
@@ -2780,6 +2814,63 @@ namespace tools
     return false;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_get_events(const wallet_rpc::COMMAND_RPC_GET_EVENTS::request& req, wallet_rpc::COMMAND_RPC_GET_EVENTS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (!m_wallet) return not_open(er);
+    if (m_restricted)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_DENIED;
+      er.message = "Command unavailable in restricted mode.";
+      return false;
+    }
+
+    const uint64_t first = m_events.empty() ? m_events_next_seq : m_events.front().seq;
+    res.missed = req.start < first;
+    const uint64_t start = std::min(std::max(req.start, first), m_events_next_seq);
+    auto it = m_events.begin() + (start - first);
+    const size_t count = req.limit ? std::min<size_t>(req.limit, std::distance(it, m_events.end())) : std::distance(it, m_events.end());
+    res.events.assign(it, it + count);
+    res.next = start + count;
+    res.height = m_wallet->get_blockchain_current_height();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::push_event(const char *type, uint64_t height, const crypto::hash &txid, uint64_t amount, const cryptonote::subaddress_index& subaddr_index, uint64_t unlock_time, bool is_change)
+  {
+    if (m_events.size() >= MAX_WALLET_EVENTS)
+      m_events.pop_front();
+    m_events.push_back(wallet_rpc::wallet_event());
+    wallet_rpc::wallet_event &e = m_events.back();
+    e.seq = m_events_next_seq++;
+    e.type = type;
+    e.height = height;
+    e.txid = epee::string_tools::pod_to_hex(txid);
+    e.amount = amount;
+    e.subaddr_index = subaddr_index;
+    e.unlock_time = unlock_time;
+    e.is_change = is_change;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::on_money_received(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t amount, uint64_t burnt, const cryptonote::subaddress_index& subaddr_index, bool is_change, uint64_t unlock_time)
+  {
+    push_event("in", height, txid, amount, subaddr_index, unlock_time, is_change);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::on_unconfirmed_money_received(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t amount, const cryptonote::subaddress_index& subaddr_index)
+  {
+    push_event("pool_in", height, txid, amount, subaddr_index, tx.unlock_time, false);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::on_money_spent(uint64_t height, const crypto::hash &txid, const cryptonote::transaction& in_tx, uint64_t amount, const cryptonote::transaction& spend_tx, const cryptonote::subaddress_index& subaddr_index)
+  {
+    push_event("out", height, txid, amount, subaddr_index, spend_tx.unlock_time, false);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::on_pool_tx_removed(const crypto::hash &txid)
+  {
+    push_event("pool_removed", 0, txid, 0, {0, 0}, 0, false);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_export_outputs(const wallet_rpc::COMMAND_RPC_EXPORT_OUTPUTS::request& req, wallet_rpc::COMMAND_RPC_EXPORT_OUTPUTS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
     if (!m_wallet) return not_open(er);
@@ -2851,7 +2942,7 @@ namespace tools
     if (!m_wallet) return not_open(er);
     try
     {
-      std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = m_wallet->export_key_images(req.all);
+      std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>> ski = m_wallet->export_key_images(req.all, req.start, req.count);
       res.offset = ski.first;
       res.signed_key_images.resize(ski.second.size());
       for (size_t n = 0; n < ski.second.size(); ++n)
@@ -3366,7 +3457,7 @@ namespace tools
       }
       delete m_wallet;
     }
-    m_wallet = wal.release();
+    set_wallet(wal.release());
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3437,7 +3528,7 @@ namespace tools
 
     if (m_wallet)
       delete m_wallet;
-    m_wallet = wal.release();
+    set_wallet(wal.release());
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -3750,7 +3841,7 @@ namespace tools
 
     if (m_wallet)
       delete m_wallet;
-    m_wallet = wal.release();
+    set_wallet(wal.release());
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     return true;
   }
@@ -3933,7 +4024,7 @@ namespace tools
 
     if (m_wallet)
       delete m_wallet;
-    m_wallet = wal.release();
+    set_wallet(wal.release());
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     res.info = "Wallet has been restored successfully.";
     return true;
@@ -4486,6 +4577,20 @@ namespace tools
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_get_perf_stats(const wallet_rpc::COMMAND_RPC_GET_PERF_STATS::request& req, wallet_rpc::COMMAND_RPC_GET_PERF_STATS::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (m_restricted)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_DENIED;
+      er.message = "Command unavailable in restricted mode.";
+      return false;
+    }
+
+    for (const tools::aggregate_performance_stats &s: tools::get_aggregate_performance_stats())
+      res.sites.push_back({s.name, s.count, s.total_ns, s.median_ns, s.p90_ns, s.p99_ns});
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 }
 
 class t_daemon
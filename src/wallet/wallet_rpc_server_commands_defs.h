@@ -47,7 +47,7 @@
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define WALLET_RPC_VERSION_MAJOR 1
-#define WALLET_RPC_VERSION_MINOR 26
+#define WALLET_RPC_VERSION_MINOR 30
 #define MAKE_WALLET_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define WALLET_RPC_VERSION MAKE_WALLET_RPC_VERSION(WALLET_RPC_VERSION_MAJOR, WALLET_RPC_VERSION_MINOR)
 namespace tools
@@ -1655,6 +1655,8 @@ namespace wallet_rpc
       uint32_t account_index;
       std::set<uint32_t> subaddr_indices;
       bool all_accounts;
+      std::string cursor; // next_cursor of a previous call, to get only what came after
+      uint32_t limit; // max number of in + out entries, 0 for all
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(in);
@@ -1668,6 +1670,8 @@ namespace wallet_rpc
         KV_SERIALIZE(account_index);
         KV_SERIALIZE(subaddr_indices);
         KV_SERIALIZE_OPT(all_accounts, false);
+        KV_SERIALIZE_OPT(cursor, std::string());
+        KV_SERIALIZE_OPT(limit, (uint32_t)0);
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -1679,6 +1683,9 @@ namespace wallet_rpc
       std::list<transfer_entry> pending;
       std::list<transfer_entry> failed;
       std::list<transfer_entry> pool;
+      std::string next_cursor;
+      bool more; // limit was hit, call again with next_cursor for the rest
+      bool reset; // cursor was stale (reorg, rescan), in/out start over from the beginning
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(in);
@@ -1686,6 +1693,9 @@ namespace wallet_rpc
         KV_SERIALIZE(pending);
         KV_SERIALIZE(failed);
         KV_SERIALIZE(pool);
+        KV_SERIALIZE(next_cursor);
+        KV_SERIALIZE(more);
+        KV_SERIALIZE(reset);
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1718,6 +1728,60 @@ namespace wallet_rpc
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct wallet_event
+  {
+    uint64_t seq;
+    std::string type; // "in", "out" (one of our outputs spent), "pool_in", "pool_removed"
+    uint64_t height;
+    std::string txid;
+    uint64_t amount;
+    cryptonote::subaddress_index subaddr_index;
+    uint64_t unlock_time;
+    bool is_change;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(seq);
+      KV_SERIALIZE(type);
+      KV_SERIALIZE(height);
+      KV_SERIALIZE(txid);
+      KV_SERIALIZE(amount);
+      KV_SERIALIZE(subaddr_index);
+      KV_SERIALIZE(unlock_time);
+      KV_SERIALIZE(is_change);
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_EVENTS
+  {
+    struct request_t
+    {
+      uint64_t start; // next of a previous call, 0 for everything still kept
+      uint32_t limit; // 0 for no limit
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_OPT(start, (uint64_t)0);
+        KV_SERIALIZE_OPT(limit, (uint32_t)0);
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t
+    {
+      std::vector<wallet_event> events;
+      uint64_t next;
+      bool missed; // events between start and the first one returned were dropped, resync with get_transfers
+      uint64_t height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(events);
+        KV_SERIALIZE(next);
+        KV_SERIALIZE(missed);
+        KV_SERIALIZE(height);
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_SIGN
   {
     struct request_t
@@ -1835,9 +1899,13 @@ namespace wallet_rpc
     struct request_t
     {
       bool all;
+      uint32_t start; // with all, chunks are [start, start + count)
+      uint32_t count;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_OPT(all, false);
+        KV_SERIALIZE_OPT(start, 0u)
+        KV_SERIALIZE_OPT(count, 0xffffffffu)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -2628,6 +2696,45 @@ namespace wallet_rpc
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_PERF_STATS
+  {
+    struct request_t
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct site_stats
+    {
+      std::string name;
+      uint64_t count;
+      uint64_t total_ns;
+      uint64_t median_ns;
+      uint64_t p90_ns;
+      uint64_t p99_ns;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(count)
+        KV_SERIALIZE(total_ns)
+        KV_SERIALIZE(median_ns)
+        KV_SERIALIZE(p90_ns)
+        KV_SERIALIZE(p99_ns)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t
+    {
+      std::vector<site_stats> sites;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(sites)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_VALIDATE_ADDRESS
   {
     struct request_t
@@ -79,3 +79,4 @@
 #define WALLET_RPC_ERROR_CODE_ZERO_AMOUNT            -46
 #define WALLET_RPC_ERROR_CODE_INVALID_SIGNATURE_TYPE -47
 #define WALLET_RPC_ERROR_CODE_DISABLED               -48
+#define WALLET_RPC_ERROR_CODE_WRONG_CURSOR           -49
@@ -0,0 +1,98 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "chaingen.h"
+#include "chain_switch_deep.h"
+#include "time_helper.h"
+
+using namespace epee;
+using namespace cryptonote;
+
+
+gen_chain_switch_deep_base::gen_chain_switch_deep_base(size_t depth)
+  : m_depth(depth)
+  , m_switch_start(0)
+{
+  REGISTER_CALLBACK("mark_before_switch", gen_chain_switch_deep_base::mark_before_switch);
+  REGISTER_CALLBACK("check_switched", gen_chain_switch_deep_base::check_switched);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_deep_base::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(1 )-...-(n )                 <- main chain, until n+1 isn't connected
+     \ |-(1')-...-(n )-(n+1)|        <- alt chain, mined to another account
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+  GENERATE_ACCOUNT(alt_miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  REWIND_BLOCKS_N(events, blk_main, blk_0, miner_account, m_depth);
+  REWIND_BLOCKS_N(events, blk_alt, blk_0, alt_miner_account, m_depth);
+  DO_CALLBACK(events, "mark_before_switch");
+  MAKE_NEXT_BLOCK(events, blk_switch, blk_alt, alt_miner_account);
+  DO_CALLBACK(events, "check_switched");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_deep_base::mark_before_switch(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_chain_switch_deep_base::mark_before_switch");
+
+  CHECK_EQ(1 + m_depth, c.get_current_blockchain_height());
+  CHECK_EQ(m_depth, c.get_alternative_blocks_count());
+
+  m_switch_start = misc_utils::get_tick_count();
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_deep_base::check_switched(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  DEFINE_TESTS_ERROR_CONTEXT("gen_chain_switch_deep_base::check_switched");
+
+  const uint64_t switch_time = misc_utils::get_tick_count() - m_switch_start;
+
+  std::vector<block> blocks;
+  bool r = c.get_blocks(0, 10000, blocks);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(2 + m_depth, blocks.size());
+  CHECK_TEST_CONDITION(blocks.back() == boost::get<block>(events[ev_index - 1]));  // blk_switch
+
+  // the old main chain is kept as an alt chain
+  CHECK_EQ(m_depth, c.get_alternative_blocks_count());
+
+  MGINFO("Switched away from " << m_depth << " blocks in " << switch_time << " ms");
+  return true;
+}
@@ -35,6 +35,7 @@
 #include "block_validation.h"
 #include "chain_split_1.h"
 #include "chain_switch_1.h"
+#include "chain_switch_deep.h"
 #include "double_spend.h"
 #include "integer_overflow.h"
 #include "ring_signature_1.h"
@@ -0,0 +1,402 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmarks BlockchainDB read paths against an existing, synced database, with
+// random, recent-heavy and sequential key distributions and several reader thread
+// counts. Reports throughput and p50/p99 latency for each combination. A second
+// database, such as a copy with compressed prunable data, can be run alongside it
+// with the same keys.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include "common/command_line.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_db/blockchain_db.h"
+#include "version.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "tests.db_bench"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace
+{
+  enum distribution_t { random_keys, recent_keys, sequential_keys };
+  const char *const distribution_names[] = { "random", "recent", "sequential" };
+
+  // draws indices in [0, n) following one of the distributions, one per reader thread
+  class key_generator
+  {
+  public:
+    key_generator(distribution_t distribution, uint64_t n, uint64_t seed):
+      distribution(distribution), n(std::max<uint64_t>(n, 1)), rng(seed), next(std::uniform_int_distribution<uint64_t>(0, this->n - 1)(rng))
+    {}
+
+    uint64_t operator()()
+    {
+      switch (distribution)
+      {
+        case random_keys:
+          return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng);
+        case recent_keys:
+        {
+          // exponential falloff from the tip, most draws fall in the last few percent
+          const double back = std::exponential_distribution<double>(1.0)(rng) * std::max<uint64_t>(n / 64, 1);
+          return back >= n ? 0 : n - 1 - (uint64_t)back;
+        }
+        case sequential_keys:
+        default:
+          return next++ % n;
+      }
+    }
+
+  private:
+    distribution_t distribution;
+    uint64_t n;
+    std::mt19937_64 rng;
+    uint64_t next;
+  };
+
+  // txids and key images from blocks picked with the key distribution, gathered before timing
+  struct sample_pool
+  {
+    std::vector<crypto::hash> txids;
+    std::vector<crypto::key_image> key_images;
+  };
+
+  sample_pool make_sample_pool(const BlockchainDB &db, distribution_t distribution, uint64_t seed)
+  {
+    static const size_t num_blocks = 1024;
+    sample_pool pool;
+    key_generator heights(distribution, db.height(), seed);
+    for (size_t i = 0; i < num_blocks; ++i)
+    {
+      const block b = db.get_block_from_height(heights());
+      for (const crypto::hash &txid: b.tx_hashes)
+      {
+        cryptonote::blobdata bd;
+        cryptonote::transaction tx;
+        if (!db.get_pruned_tx_blob(txid, bd) || !cryptonote::parse_and_validate_tx_base_from_blob(bd, tx))
+          continue;
+        pool.txids.push_back(txid);
+        for (const auto &in: tx.vin)
+          if (in.type() == typeid(txin_to_key))
+            pool.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+      }
+    }
+    if (pool.txids.empty())
+      pool.txids.push_back(crypto::null_hash);
+    if (pool.key_images.empty())
+      pool.key_images.push_back(crypto::key_image{});
+    return pool;
+  }
+
+  struct bench_context
+  {
+    const BlockchainDB &db;
+    uint64_t height;
+    uint64_t num_rct_outputs;
+    const sample_pool &pool;
+  };
+
+  typedef std::function<void(const bench_context&, key_generator &heights, key_generator &outputs, std::mt19937_64&)> bench_op;
+
+  struct bench_test
+  {
+    const char *name;
+    bench_op op;
+    // slow ops run fewer iterations
+    unsigned ops_divisor;
+  };
+
+  // the pool was drawn with the key distribution, picking from it is uniform
+  template<typename T>
+  const T &pick(const std::vector<T> &v, std::mt19937_64 &rng)
+  {
+    return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(rng)];
+  }
+
+  const bench_test tests[] = {
+    { "get_output_key", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        ctx.db.get_output_key(0, outputs());
+      }, 1 },
+    { "get_outs", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        // a ring's worth of outputs in one call, as get_outs does
+        std::vector<uint64_t> offsets(16);
+        for (uint64_t &offset: offsets)
+          offset = outputs();
+        std::sort(offsets.begin(), offsets.end());
+        const uint64_t amount = 0;
+        std::vector<output_data_t> data;
+        ctx.db.get_output_key(epee::span<const uint64_t>(&amount, 1), offsets, data, true);
+      }, 1 },
+    { "has_key_image", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        // half of the lookups are for spent key images, half for unknown ones
+        if (rng() & 1)
+        {
+          ctx.db.has_key_image(pick(ctx.pool.key_images, rng));
+        }
+        else
+        {
+          crypto::key_image ki;
+          for (size_t i = 0; i < sizeof(ki.data); ++i)
+            ki.data[i] = rng();
+          ctx.db.has_key_image(ki);
+        }
+      }, 1 },
+    { "get_tx_blob", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        cryptonote::blobdata bd;
+        ctx.db.get_tx_blob(pick(ctx.pool.txids, rng), bd);
+      }, 1 },
+    { "get_prunable_tx_blob", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        cryptonote::blobdata bd;
+        ctx.db.get_prunable_tx_blob(pick(ctx.pool.txids, rng), bd);
+      }, 1 },
+    { "get_output_distribution", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        std::vector<uint64_t> distribution;
+        uint64_t base;
+        ctx.db.get_output_distribution(0, heights(), ctx.height - 1, distribution, base);
+      }, 100 },
+    { "get_blocks_from", [](const bench_context &ctx, key_generator &heights, key_generator &outputs, std::mt19937_64 &rng) {
+        // the shape of a sync request from a peer
+        std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>> blocks;
+        ctx.db.get_blocks_from(heights(), 1, 20, 1000, 1024 * 1024, blocks, true, false, false);
+      }, 10 },
+  };
+
+  struct bench_result
+  {
+    double ops_per_second;
+    double p50_us, p99_us;
+  };
+
+  bench_result run_test(const bench_test &test, const bench_context &ctx, distribution_t distribution, unsigned threads, uint64_t ops, uint64_t seed)
+  {
+    ops = std::max<uint64_t>(ops / test.ops_divisor, 1);
+    std::vector<std::vector<uint64_t>> latencies(threads);
+    std::vector<std::thread> workers;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+      workers.emplace_back([&, t]() {
+        key_generator heights(distribution, ctx.height, seed + t);
+        key_generator outputs(distribution, ctx.num_rct_outputs, seed + t);
+        std::mt19937_64 rng(seed ^ (t + 1));
+        latencies[t].reserve(ops);
+        for (uint64_t i = 0; i < ops; ++i)
+        {
+          const auto op0 = std::chrono::steady_clock::now();
+          test.op(ctx, heights, outputs, rng);
+          latencies[t].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - op0).count());
+        }
+      });
+    }
+    for (std::thread &worker: workers)
+      worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::vector<uint64_t> all;
+    for (const auto &v: latencies)
+      all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    bench_result result;
+    result.ops_per_second = seconds > 0 ? all.size() / seconds : 0.0;
+    result.p50_us = all[all.size() / 2] / 1000.0;
+    result.p99_us = all[std::min(all.size() - 1, all.size() * 99 / 100)] / 1000.0;
+    return result;
+  }
+
+  std::unique_ptr<BlockchainDB> open_db(const std::string &data_dir, std::string &filename)
+  {
+    std::unique_ptr<BlockchainDB> db(new_db());
+    if (!db)
+    {
+      std::cerr << "Failed to initialize a database" << std::endl;
+      return nullptr;
+    }
+    filename = (boost::filesystem::path(data_dir) / db->get_db_name()).string();
+    try
+    {
+      db->open(filename, DBF_RDONLY);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Error opening database " << filename << ": " << e.what() << std::endl;
+      return nullptr;
+    }
+    if (db->height() < 2)
+    {
+      std::cerr << "Database at " << filename << " is empty" << std::endl;
+      return nullptr;
+    }
+    return db;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  tools::on_startup();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_filter  = {"filter", "Only run tests whose name contains this", ""};
+  const command_line::arg_descriptor<std::string> arg_threads  = {"threads", "Comma separated reader thread counts", "1,2,4,8"};
+  const command_line::arg_descriptor<uint64_t> arg_ops  = {"ops", "Operations per reader thread for each test", 10000};
+  const command_line::arg_descriptor<uint64_t> arg_seed  = {"seed", "Seed for the key distributions", 0};
+  const command_line::arg_descriptor<std::string> arg_compare_data_dir  = {"compare-data-dir", "Also run each test against the database in this directory, with the same keys", ""};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_stagenet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_filter);
+  command_line::add_arg(desc_cmd_sett, arg_threads);
+  command_line::add_arg(desc_cmd_sett, arg_ops);
+  command_line::add_arg(desc_cmd_sett, arg_seed);
+  command_line::add_arg(desc_cmd_sett, arg_compare_data_dir);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Monero '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure("", true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log("0");
+
+  const std::string filter = command_line::get_arg(vm, arg_filter);
+  const uint64_t ops = command_line::get_arg(vm, arg_ops);
+  const uint64_t seed = command_line::get_arg(vm, arg_seed);
+  std::vector<std::string> thread_strings;
+  std::vector<unsigned> thread_counts;
+  boost::split(thread_strings, command_line::get_arg(vm, arg_threads), boost::is_any_of(","));
+  for (const std::string &s: thread_strings)
+  {
+    const unsigned threads = strtoul(s.c_str(), NULL, 10);
+    if (threads == 0)
+    {
+      std::cerr << "Invalid thread count: " << s << std::endl;
+      return 1;
+    }
+    thread_counts.push_back(threads);
+  }
+
+  std::string filename;
+  std::unique_ptr<BlockchainDB> db = open_db(command_line::get_arg(vm, cryptonote::arg_data_dir), filename);
+  if (!db)
+    return 1;
+  const uint64_t height = db->height();
+  const uint64_t num_rct_outputs = db->get_num_outputs(0);
+  std::cout << "Database " << filename << ": height " << height << ", " << num_rct_outputs << " RingCT outputs" << std::endl;
+
+  // keys are drawn from the first database, the second one should hold the same chain
+  std::unique_ptr<BlockchainDB> compare_db;
+  if (!command_line::is_arg_defaulted(vm, arg_compare_data_dir))
+  {
+    std::string compare_filename;
+    compare_db = open_db(command_line::get_arg(vm, arg_compare_data_dir), compare_filename);
+    if (!compare_db)
+      return 1;
+    if (compare_db->height() < height || compare_db->get_block_hash_from_height(height - 1) != db->get_block_hash_from_height(height - 1))
+    {
+      std::cerr << "Database at " << compare_filename << " does not hold the same chain" << std::endl;
+      return 1;
+    }
+    std::cout << "Comparing with " << compare_filename << std::endl;
+  }
+
+  std::cout << std::setw(24) << std::left << "test" << std::setw(12) << "keys";
+  if (compare_db)
+    std::cout << std::setw(10) << "db";
+  std::cout << std::setw(10) << std::right << "threads"
+      << std::setw(14) << "ops/s" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::endl;
+  for (int d = random_keys; d <= sequential_keys; ++d)
+  {
+    const distribution_t distribution = (distribution_t)d;
+    const sample_pool pool = make_sample_pool(*db, distribution, seed);
+    for (const bench_test &test: tests)
+    {
+      if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos)
+        continue;
+      for (unsigned threads: thread_counts)
+      {
+        for (const BlockchainDB *bench_db: {db.get(), compare_db.get()})
+        {
+          if (!bench_db)
+            continue;
+          const bench_context ctx{*bench_db, height, num_rct_outputs, pool};
+          const bench_result result = run_test(test, ctx, distribution, threads, ops, seed);
+          std::cout << std::setw(24) << std::left << test.name << std::setw(12) << distribution_names[d];
+          if (compare_db)
+            std::cout << std::setw(10) << (bench_db == db.get() ? "base" : "compare");
+          std::cout << std::setw(10) << std::right << threads
+              << std::setw(14) << std::fixed << std::setprecision(0) << result.ops_per_second
+              << std::setw(12) << std::setprecision(1) << result.p50_us << std::setw(12) << result.p99_us << std::endl;
+        }
+      }
+    }
+  }
+
+  if (compare_db)
+    compare_db->close();
+  db->close();
+  return 0;
+
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -26,6 +26,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include "include_base_utils.h"
 #include "string_tools.h"
@@ -46,6 +50,81 @@ static int __AFL_LOOP(int)
 }
 #endif
 
+// counts allocations so --perf can report them per input byte
+static std::atomic<uint64_t> num_allocations(0);
+
+void *operator new(size_t size)
+{
+  ++num_allocations;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+// runs each input once, reporting parse time and allocations per byte, and flags
+// (and optionally copies into slow_dir) inputs over the time budget
+static int run_perf(const std::vector<std::string> &inputs, uint64_t budget_ms, const std::string &slow_dir, Fuzzer &fuzzer)
+{
+  std::vector<std::string> filenames;
+  for (const std::string &input: inputs)
+  {
+    if (boost::filesystem::is_directory(input))
+    {
+      for (boost::filesystem::directory_iterator i(input); i != boost::filesystem::directory_iterator(); ++i)
+        if (boost::filesystem::is_regular_file(i->status()))
+          filenames.push_back(i->path().string());
+    }
+    else
+      filenames.push_back(input);
+  }
+  std::sort(filenames.begin(), filenames.end());
+
+  size_t num_slow = 0;
+  for (const std::string &filename: filenames)
+  {
+    boost::system::error_code ec;
+    const uint64_t size = boost::filesystem::file_size(filename, ec);
+    if (ec)
+    {
+      std::cout << "Error: failed to stat " << filename << std::endl;
+      return 1;
+    }
+
+    const uint64_t allocations0 = num_allocations;
+    const auto t0 = std::chrono::steady_clock::now();
+    int ret = fuzzer.run(filename);
+    const auto t1 = std::chrono::steady_clock::now();
+    const uint64_t allocations = num_allocations - allocations0;
+    if (ret)
+      return ret;
+
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    const bool slow = budget_ms && ns > budget_ms * 1000000;
+    std::cout << filename << "\t" << size << " bytes\t" << ns / 1000 << " us\t" << ns / (double)std::max<uint64_t>(size, 1) << " ns/byte\t"
+        << allocations / (double)std::max<uint64_t>(size, 1) << " allocs/byte" << (slow ? "\tSLOW" : "") << std::endl;
+    if (slow)
+    {
+      ++num_slow;
+      if (!slow_dir.empty())
+      {
+        boost::filesystem::create_directories(slow_dir, ec);
+        boost::filesystem::copy_file(filename, boost::filesystem::path(slow_dir) / boost::filesystem::path(filename).filename(), boost::filesystem::copy_option::overwrite_if_exists, ec);
+        if (ec)
+          std::cout << "Error: failed to copy " << filename << " to " << slow_dir << ": " << ec.message() << std::endl;
+      }
+    }
+  }
+
+  std::cout << filenames.size() << " input(s), " << num_slow << " over budget" << std::endl;
+  return num_slow ? 2 : 0;
+}
+
 int run_fuzzer(int argc, const char **argv, Fuzzer &fuzzer)
 {
   TRY_ENTRY();
@@ -53,9 +132,30 @@ int run_fuzzer(int argc, const char **argv, Fuzzer &fuzzer)
   if (argc < 2)
   {
     std::cout << "usage: " << argv[0] << " " << "<filename>" << std::endl;
+    std::cout << "       " << argv[0] << " " << "--perf [--budget-ms <ms>] [--slow-dir <dir>] <filename|dir>..." << std::endl;
     return 1;
   }
 
+  if (!strcmp(argv[1], "--perf"))
+  {
+    uint64_t budget_ms = 0;
+    std::string slow_dir;
+    std::vector<std::string> inputs;
+    for (int i = 2; i < argc; ++i)
+    {
+      if (!strcmp(argv[i], "--budget-ms") && i + 1 < argc)
+        budget_ms = strtoull(argv[++i], NULL, 10);
+      else if (!strcmp(argv[i], "--slow-dir") && i + 1 < argc)
+        slow_dir = argv[++i];
+      else
+        inputs.push_back(argv[i]);
+    }
+    int ret = fuzzer.init();
+    if (ret)
+      return ret;
+    return run_perf(inputs, budget_ms, slow_dir, fuzzer);
+  }
+
 #ifdef __AFL_HAVE_MANUAL_CONTROL
   __AFL_INIT();
 #endif
@@ -0,0 +1,476 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Load generator for a running daemon's P2P port. It opens a number of peer
+// connections, handshakes on each, then keeps one request in flight per peer, drawn
+// from a weighted mix of chain requests, block fetches and timed syncs, as syncing
+// peers do. It reports per message latency and, given the daemon's pid on Linux,
+// the daemon's CPU time per message and resident memory.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <boost/algorithm/string.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+#include "include_base_utils.h"
+#include "misc_log_ex.h"
+#include "net/levin_protocol_handler_async.h"
+#include "net/abstract_tcp_server2.h"
+#include "storages/levin_abstract_invoke2.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "crypto/crypto.h"
+#include "cryptonote_config.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "p2p/p2p_protocol_defs.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "tests.p2p_load"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  struct load_connection_context : epee::net_utils::connection_context_base
+  {
+    load_connection_context(): epee::net_utils::connection_context_base(boost::uuids::nil_uuid(), {}, false, false) {}
+    static constexpr int handshake_command() noexcept { return nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA>::ID; }
+    static constexpr bool handshake_complete() noexcept { return true; }
+    size_t get_max_bytes(int command) const { return LEVIN_DEFAULT_MAX_PACKET_SIZE; }
+  };
+
+  typedef epee::levin::async_protocol_handler<load_connection_context> load_protocol_handler;
+  typedef epee::levin::async_protocol_handler_config<load_connection_context> load_protocol_handler_config;
+  typedef epee::net_utils::boosted_tcp_server<load_protocol_handler> load_tcp_server;
+
+  typedef nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA> COMMAND_HANDSHAKE;
+  typedef nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA> COMMAND_TIMED_SYNC;
+
+  enum message_t { msg_chain, msg_objects, msg_timed_sync, num_message_types };
+  const char *const message_names[num_message_types] = { "chain", "objects", "timed_sync" };
+
+  struct message_stats
+  {
+    std::vector<uint64_t> latencies_ns;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+  };
+
+  // reads utime + stime (in ms) and VmRSS (in kB) of a process, Linux only
+  bool get_process_usage(uint64_t pid, uint64_t &cpu_ms, uint64_t &rss_kb)
+  {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line))
+      return false;
+    // the command name may contain spaces, fields are counted from after it
+    const size_t paren = line.rfind(')');
+    if (paren == std::string::npos)
+      return false;
+    std::vector<std::string> fields;
+    boost::split(fields, line.substr(paren + 2), boost::is_any_of(" "));
+    if (fields.size() < 13)
+      return false;
+    const long ticks = sysconf(_SC_CLK_TCK);
+    cpu_ms = (std::stoull(fields[11]) + std::stoull(fields[12])) * 1000 / (ticks > 0 ? ticks : 100);
+
+    rss_kb = 0;
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    while (std::getline(status, line))
+      if (boost::starts_with(line, "VmRSS:"))
+        rss_kb = std::stoull(line.substr(6));
+    return true;
+  }
+
+  class load_generator : public epee::levin::levin_commands_handler<load_connection_context>
+  {
+  public:
+    load_generator(load_tcp_server &server, const cryptonote::CORE_SYNC_DATA &sync_data, const std::vector<unsigned> &mix, uint64_t seed):
+      m_server(server), m_sync_data(sync_data), m_mix(mix.begin(), mix.end()), m_rng(seed), m_stop(false), m_in_flight(0), m_objects_per_request(20)
+    {}
+
+    void start(const load_connection_context &context)
+    {
+      ++m_in_flight;
+      send_next(context);
+    }
+
+    void stop() { m_stop = true; }
+    uint64_t in_flight() const { return m_in_flight; }
+
+    std::vector<message_stats> get_stats()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_stats;
+    }
+
+    virtual int invoke(int command, const epee::span<const uint8_t> in_buff, epee::byte_stream& buff_out, load_connection_context& context) override
+    {
+      // answer the daemon's own timed syncs so it keeps the connection
+      if (command == COMMAND_TIMED_SYNC::ID)
+      {
+        return epee::net_utils::buff_to_t_adapter<load_generator, COMMAND_TIMED_SYNC::request, COMMAND_TIMED_SYNC::response>(command, in_buff, buff_out,
+          [this](int, COMMAND_TIMED_SYNC::request&, COMMAND_TIMED_SYNC::response &rsp, load_connection_context&) {
+            rsp.payload_data = m_sync_data;
+            return 1;
+          }, context);
+      }
+      return LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
+    }
+
+    virtual int notify(int command, const epee::span<const uint8_t> in_buff, load_connection_context& context) override
+    {
+      if (command == cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::ID)
+      {
+        epee::net_utils::buff_to_t_adapter<load_generator, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request>(this, command, in_buff,
+          [this](int, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request &arg, load_connection_context&) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_known_blocks.empty())
+              m_known_blocks = std::move(arg.m_block_ids);
+            return 1;
+          }, context);
+        on_response(context, msg_chain, in_buff.size(), false);
+      }
+      else if (command == cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID)
+      {
+        on_response(context, msg_objects, in_buff.size(), false);
+      }
+      // relayed txes and blocks are ignored
+      return 1;
+    }
+
+    virtual void callback(load_connection_context& context) override {}
+    virtual void on_connection_new(load_connection_context& context) override {}
+    virtual void on_connection_close(load_connection_context& context) override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_pending.erase(context.m_connection_id))
+        --m_in_flight;
+    }
+
+  private:
+    struct pending_request
+    {
+      message_t type;
+      std::chrono::steady_clock::time_point sent;
+    };
+
+    void on_response(const load_connection_context &context, message_t type, size_t bytes, bool error)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto i = m_pending.find(context.m_connection_id);
+        if (i == m_pending.end() || i->second.type != type)
+          return;
+        message_stats &stats = m_stats[type];
+        stats.latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - i->second.sent).count());
+        stats.bytes += bytes;
+        stats.errors += error;
+        m_pending.erase(i);
+      }
+      send_next(context);
+    }
+
+    void send_next(const load_connection_context &context)
+    {
+      message_t type;
+      std::vector<crypto::hash> objects;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop)
+        {
+          --m_in_flight;
+          return;
+        }
+        type = (message_t)m_mix(m_rng);
+        if (type == msg_objects)
+        {
+          if (m_known_blocks.empty())
+            type = msg_chain;
+          else
+          {
+            std::uniform_int_distribution<size_t> start(0, m_known_blocks.size() - 1);
+            const size_t first = start(m_rng);
+            const size_t last = std::min(first + m_objects_per_request, m_known_blocks.size());
+            objects.assign(m_known_blocks.begin() + first, m_known_blocks.begin() + last);
+          }
+        }
+        m_pending[context.m_connection_id] = {type, std::chrono::steady_clock::now()};
+      }
+
+      bool r = false;
+      switch (type)
+      {
+        case msg_chain:
+        {
+          cryptonote::NOTIFY_REQUEST_CHAIN::request req;
+          req.block_ids.push_back(m_sync_data.top_id);
+          req.prune = true;
+          r = epee::net_utils::notify_remote_command2(context, cryptonote::NOTIFY_REQUEST_CHAIN::ID, req, m_server.get_config_object());
+          break;
+        }
+        case msg_objects:
+        {
+          cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request req;
+          req.blocks = std::move(objects);
+          req.prune = true;
+          r = epee::net_utils::notify_remote_command2(context, cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID, req, m_server.get_config_object());
+          break;
+        }
+        case msg_timed_sync:
+        default:
+        {
+          COMMAND_TIMED_SYNC::request req;
+          req.payload_data = m_sync_data;
+          r = epee::net_utils::async_invoke_remote_command2<COMMAND_TIMED_SYNC::response>(context, COMMAND_TIMED_SYNC::ID, req, m_server.get_config_object(),
+            [this](int code, const COMMAND_TIMED_SYNC::response&, load_connection_context &context) {
+              on_response(context, msg_timed_sync, 0, code <= 0);
+            });
+          break;
+        }
+      }
+      if (!r)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats[type].errors;
+        if (m_pending.erase(context.m_connection_id))
+          --m_in_flight;
+      }
+    }
+
+    load_tcp_server &m_server;
+    const cryptonote::CORE_SYNC_DATA m_sync_data;
+    std::discrete_distribution<unsigned> m_mix;
+    std::mt19937_64 m_rng;
+    std::mutex m_mutex;
+    std::atomic<bool> m_stop;
+    std::atomic<uint64_t> m_in_flight;
+    const size_t m_objects_per_request;
+    std::map<boost::uuids::uuid, pending_request> m_pending;
+    std::vector<crypto::hash> m_known_blocks;
+    std::vector<message_stats> m_stats{num_message_types};
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  tools::on_startup();
+
+  po::options_description desc_options("Allowed options");
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_address  = {"address", "Daemon P2P address", "127.0.0.1"};
+  const command_line::arg_descriptor<uint16_t> arg_port  = {"port", "Daemon P2P port, the network default if 0", 0};
+  const command_line::arg_descriptor<bool> arg_testnet  = {"testnet", "Use the testnet network id", false};
+  const command_line::arg_descriptor<bool> arg_stagenet  = {"stagenet", "Use the stagenet network id", false};
+  const command_line::arg_descriptor<unsigned> arg_peers  = {"peers", "Number of peer connections", 8};
+  const command_line::arg_descriptor<std::string> arg_mix  = {"mix", "Relative weights of chain, objects and timed_sync requests", "chain=1,objects=4,timed_sync=1"};
+  const command_line::arg_descriptor<unsigned> arg_duration  = {"duration", "Seconds to run for", 30};
+  const command_line::arg_descriptor<uint64_t> arg_pid  = {"pid", "Daemon process id, to report its CPU and memory use (Linux)", 0};
+  command_line::add_arg(desc_options, arg_log_level);
+  command_line::add_arg(desc_options, arg_address);
+  command_line::add_arg(desc_options, arg_port);
+  command_line::add_arg(desc_options, arg_testnet);
+  command_line::add_arg(desc_options, arg_stagenet);
+  command_line::add_arg(desc_options, arg_peers);
+  command_line::add_arg(desc_options, arg_mix);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_pid);
+  command_line::add_arg(desc_options, command_line::arg_help);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure("", true);
+  mlog_set_log(command_line::is_arg_defaulted(vm, arg_log_level) ? "0" : command_line::get_arg(vm, arg_log_level).c_str());
+
+  const cryptonote::network_type nettype = command_line::get_arg(vm, arg_testnet) ? cryptonote::TESTNET :
+      command_line::get_arg(vm, arg_stagenet) ? cryptonote::STAGENET : cryptonote::MAINNET;
+  const cryptonote::config_t &config = cryptonote::get_config(nettype);
+  const std::string address = command_line::get_arg(vm, arg_address);
+  const std::string port = std::to_string(command_line::get_arg(vm, arg_port) ? command_line::get_arg(vm, arg_port) : config.P2P_DEFAULT_PORT);
+  const unsigned peers = command_line::get_arg(vm, arg_peers);
+  const unsigned duration = command_line::get_arg(vm, arg_duration);
+  const uint64_t pid = command_line::get_arg(vm, arg_pid);
+
+  std::vector<unsigned> mix(num_message_types, 0);
+  std::vector<std::string> mix_entries;
+  boost::split(mix_entries, command_line::get_arg(vm, arg_mix), boost::is_any_of(","));
+  for (const std::string &entry: mix_entries)
+  {
+    std::vector<std::string> kv;
+    boost::split(kv, entry, boost::is_any_of("="));
+    const auto name = kv.size() == 2 ? std::find(std::begin(message_names), std::end(message_names), kv[0]) : std::end(message_names);
+    if (name == std::end(message_names))
+    {
+      std::cerr << "Invalid mix entry: " << entry << std::endl;
+      return 1;
+    }
+    mix[name - std::begin(message_names)] = std::stoul(kv[1]);
+  }
+  if (std::all_of(mix.begin(), mix.end(), [](unsigned w) { return w == 0; }))
+  {
+    std::cerr << "The message mix is empty" << std::endl;
+    return 1;
+  }
+
+  // we present as a fresh node at the genesis block, so the daemon serves us and never syncs from us
+  cryptonote::block genesis;
+  if (!cryptonote::generate_genesis_block(genesis, config.GENESIS_TX, config.GENESIS_NONCE))
+  {
+    std::cerr << "Failed to generate genesis block" << std::endl;
+    return 1;
+  }
+  cryptonote::CORE_SYNC_DATA sync_data{};
+  sync_data.current_height = 1;
+  sync_data.cumulative_difficulty = 1;
+  sync_data.cumulative_difficulty_top64 = 0;
+  sync_data.top_id = cryptonote::get_block_hash(genesis);
+  sync_data.top_version = genesis.major_version;
+  sync_data.pruning_seed = 0;
+
+  // RPC disables the network throttle, as for the other load tests
+  load_tcp_server server(epee::net_utils::e_connection_type_RPC);
+  load_generator generator(server, sync_data, mix, std::random_device{}());
+  server.get_config_object().set_handler(&generator);
+  if (!server.init_server(0, "127.0.0.1") || !server.run_server(std::max(2u, std::thread::hardware_concurrency()), false))
+  {
+    std::cerr << "Failed to start the network threads" << std::endl;
+    return 1;
+  }
+
+  std::vector<load_connection_context> contexts;
+  for (unsigned i = 0; i < peers; ++i)
+  {
+    load_connection_context context;
+    if (!server.connect(address, port, 10000, context, "0.0.0.0", epee::net_utils::ssl_support_t::e_ssl_support_disabled))
+    {
+      std::cerr << "Failed to connect to " << address << ":" << port << std::endl;
+      continue;
+    }
+    COMMAND_HANDSHAKE::request req;
+    req.node_data.network_id = config.NETWORK_ID;
+    req.node_data.my_port = 0;
+    req.node_data.rpc_port = 0;
+    req.node_data.rpc_credits_per_hash = 0;
+    req.node_data.peer_id = crypto::rand<nodetool::peerid_type>();
+    req.node_data.support_flags = P2P_SUPPORT_FLAG_FLUFFY_BLOCKS;
+    req.payload_data = sync_data;
+    std::atomic<int> handshake_result(0);
+    epee::net_utils::async_invoke_remote_command2<COMMAND_HANDSHAKE::response>(context, COMMAND_HANDSHAKE::ID, req, server.get_config_object(),
+      [&handshake_result](int code, const COMMAND_HANDSHAKE::response&, load_connection_context&) {
+        handshake_result = code > 0 ? 1 : -1;
+      }, P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT);
+    while (handshake_result == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (handshake_result < 0)
+    {
+      std::cerr << "Handshake failed on peer " << i << std::endl;
+      server.get_config_object().close(context.m_connection_id);
+      continue;
+    }
+    contexts.push_back(context);
+  }
+  if (contexts.empty())
+  {
+    std::cerr << "No peer connections" << std::endl;
+    return 1;
+  }
+  std::cout << contexts.size() << " peer(s) connected to " << address << ":" << port << ", running for " << duration << " seconds" << std::endl;
+
+  uint64_t cpu0 = 0, rss0 = 0, cpu1 = 0, rss1 = 0;
+  const bool have_usage = pid && get_process_usage(pid, cpu0, rss0);
+  const auto t0 = std::chrono::steady_clock::now();
+  for (const load_connection_context &context: contexts)
+    generator.start(context);
+  std::this_thread::sleep_for(std::chrono::seconds(duration));
+  generator.stop();
+  for (int i = 0; i < 100 && generator.in_flight(); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (have_usage)
+    get_process_usage(pid, cpu1, rss1);
+
+  for (const load_connection_context &context: contexts)
+    server.get_config_object().close(context.m_connection_id);
+  server.send_stop_signal();
+  server.timed_wait_server_stop(5000);
+  server.deinit_server();
+
+  uint64_t total = 0;
+  std::cout << std::setw(12) << std::left << "message" << std::setw(10) << std::right << "count" << std::setw(8) << "errors" << std::setw(12) << "msgs/s"
+      << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms" << std::setw(14) << "avg bytes" << std::endl;
+  const std::vector<message_stats> stats = generator.get_stats();
+  for (size_t type = 0; type < stats.size(); ++type)
+  {
+    std::vector<uint64_t> latencies = stats[type].latencies_ns;
+    if (latencies.empty() && !stats[type].errors)
+      continue;
+    std::sort(latencies.begin(), latencies.end());
+    const size_t n = latencies.size();
+    total += n;
+    std::cout << std::setw(12) << std::left << message_names[type] << std::setw(10) << std::right << n << std::setw(8) << stats[type].errors
+        << std::setw(12) << std::fixed << std::setprecision(1) << n / seconds
+        << std::setw(12) << std::setprecision(2) << (n ? latencies[n / 2] / 1e6 : 0.0)
+        << std::setw(12) << (n ? latencies[std::min(n - 1, n * 99 / 100)] / 1e6 : 0.0)
+        << std::setw(14) << std::setprecision(0) << (n ? stats[type].bytes / (double)n : 0.0) << std::endl;
+  }
+  std::cout << "Total: " << total << " messages, " << std::setprecision(1) << total / seconds << " msgs/s" << std::endl;
+  if (have_usage)
+  {
+    std::cout << "Daemon CPU: " << cpu1 - cpu0 << " ms, " << std::setprecision(3) << (total ? (cpu1 - cpu0) / (double)total : 0.0) << " ms/message" << std::endl;
+    std::cout << "Daemon RSS: " << rss0 << " kB before, " << rss1 << " kB after" << std::endl;
+  }
+  return 0;
+
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -55,3 +55,34 @@ public:
 private:
   std::array<uint8_t, bytes> m_data;
 };
+
+template<size_t bytes>
+class test_cn_fast_hash_multi
+{
+public:
+  static const size_t count = 8;
+  static const size_t loop_count = (bytes < 256 ? 100000 : bytes < 4096 ? 10000 : 1000) / count;
+
+  bool init()
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      crypto::rand(bytes, m_data[i].data());
+      m_in[i] = m_data[i].data();
+      m_out[i] = m_hashes[i].data;
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    crypto::cn_fast_hash_multi(m_in, bytes, m_out, count);
+    return true;
+  }
+
+private:
+  std::array<uint8_t, bytes> m_data[count];
+  crypto::hash m_hashes[count];
+  const void *m_in[count];
+  char *m_out[count];
+};
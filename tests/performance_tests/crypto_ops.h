@@ -49,6 +49,9 @@ enum test_op
   op_scalarmultH,
   op_scalarmult8,
   op_scalarmult8_p3,
+  op_ge_frombytes_vartime,
+  op_ge_p3_tobytes,
+  op_ge_scalarmult,
   op_ge_dsm_precomp,
   op_ge_double_scalarmult_base_vartime,
   op_ge_triple_scalarmult_base_vartime,
@@ -97,6 +100,7 @@ public:
     ge_cached tmp_cached;
     ge_p1p1 tmp_p1p1;
     ge_p2 tmp_p2;
+    ge_p3 tmp_p3;
     ge_dsmp dsmp;
     switch (op)
     {
@@ -116,6 +120,9 @@ public:
       case op_scalarmultH: rct::scalarmultH(scalar0); break;
       case op_scalarmult8: rct::scalarmult8(point0); break;
       case op_scalarmult8_p3: rct::scalarmult8(p3_0,point0); break;
+      case op_ge_frombytes_vartime: ge_frombytes_vartime(&tmp_p3, point0.bytes); break;
+      case op_ge_p3_tobytes: ge_p3_tobytes(key.bytes, &p3_0); break;
+      case op_ge_scalarmult: ge_scalarmult(&tmp_p2, scalar0.bytes, &p3_0); break;
       case op_ge_dsm_precomp: ge_dsm_precomp(dsmp, &p3_0); break;
       case op_ge_double_scalarmult_base_vartime: ge_double_scalarmult_base_vartime(&tmp_p2, scalar0.bytes, &p3_0, scalar1.bytes); break;
       case op_ge_triple_scalarmult_base_vartime: ge_triple_scalarmult_base_vartime(&tmp_p2, scalar0.bytes, scalar1.bytes, precomp1, scalar2.bytes, precomp2); break;
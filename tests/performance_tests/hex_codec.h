@@ -0,0 +1,83 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "hex.h"
+
+template<size_t bytes>
+class test_hex_encode
+{
+public:
+  static const size_t loop_count = bytes < 256 ? 1000000 : bytes < 65536 ? 10000 : 100;
+
+  bool init()
+  {
+    m_data.resize(bytes);
+    crypto::rand(bytes, m_data.data());
+    return true;
+  }
+
+  bool test()
+  {
+    const std::string hex = epee::to_hex::string(epee::to_span(m_data));
+    return hex.size() == bytes * 2;
+  }
+
+private:
+  std::vector<uint8_t> m_data;
+};
+
+template<size_t bytes>
+class test_hex_decode
+{
+public:
+  static const size_t loop_count = bytes < 256 ? 1000000 : bytes < 65536 ? 10000 : 100;
+
+  bool init()
+  {
+    std::vector<uint8_t> data(bytes);
+    crypto::rand(bytes, data.data());
+    m_hex = epee::to_hex::string(epee::to_span(data));
+    m_data.resize(bytes);
+    return true;
+  }
+
+  bool test()
+  {
+    return epee::from_hex::to_buffer(epee::to_mut_span(m_data), m_hex);
+  }
+
+private:
+  std::string m_hex;
+  std::vector<uint8_t> m_data;
+};
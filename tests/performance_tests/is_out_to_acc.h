@@ -33,6 +33,7 @@
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctOps.h"
 
 #include "single_tx_test_base.h"
 
@@ -74,3 +75,51 @@ public:
 private:
   crypto::key_derivation m_derivation;
 };
+
+// scans a tx's worth of outputs which are not ours, the common case when refreshing:
+// one derivation per tx, then a view tag check before deriving each output's public key
+template<size_t n_outputs, bool use_view_tags>
+class test_is_out_to_acc_precomp_scan : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+    m_subaddresses[m_bob.get_keys().m_account_address.m_spend_public_key] = {0,0};
+    m_output_keys.resize(n_outputs);
+    m_view_tags.resize(n_outputs);
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      m_output_keys[i] = rct::rct2pk(rct::pkGen());
+      if (use_view_tags)
+        m_view_tags[i] = crypto::rand<crypto::view_tag>();
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    hw::device &hwdev = hw::get_device("default");
+    crypto::key_derivation derivation;
+    if (!crypto::generate_key_derivation(m_tx_pub_key, m_bob.get_keys().m_view_secret_key, derivation))
+      return false;
+    const std::vector<crypto::key_derivation> additional_derivations;
+    size_t found = 0;
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      if (!cryptonote::out_can_be_to_acc(m_view_tags[i], derivation, i, &hwdev))
+        continue;
+      if (cryptonote::is_out_to_acc_precomp(m_subaddresses, m_output_keys[i], derivation, additional_derivations, i, hwdev, m_view_tags[i]))
+        ++found;
+    }
+    return found == 0;
+  }
+
+private:
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+  std::vector<crypto::public_key> m_output_keys;
+  std::vector<boost::optional<crypto::view_tag>> m_view_tags;
+};
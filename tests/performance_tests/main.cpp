@@ -38,6 +38,7 @@
 // tests
 #include "construct_tx.h"
 #include "check_tx_signature.h"
+#include "parse_tx.h"
 #include "check_hash.h"
 #include "cn_slow_hash.h"
 #include "derive_public_key.h"
@@ -53,6 +54,7 @@
 #include "is_out_to_acc.h"
 #include "out_can_be_to_acc.h"
 #include "subaddress_expand.h"
+#include "wallet_scale.h"
 #include "sc_reduce32.h"
 #include "sc_check.h"
 #include "cn_fast_hash.h"
@@ -65,6 +67,8 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "rolling_median_fill.h"
+#include "hex_codec.h"
 
 namespace po = boost::program_options;
 
@@ -186,6 +190,11 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 2, 2, 56, 16);
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 10, 2, 56, 16);
 
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 16, 2, false);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 16, 2, true);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 16, 16, false);
+  TEST_PERFORMANCE3(filter, p, test_parse_tx, 16, 16, true);
+
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 1, 0, 1);
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 0xffffffffffffffff, 0, 0xffffffffffffffff);
   TEST_PERFORMANCE4(filter, p, test_check_hash, 0, 0xffffffffffffffff, 0, 1);
@@ -196,6 +205,8 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc);
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc_precomp);
+  TEST_PERFORMANCE2(filter, p, test_is_out_to_acc_precomp_scan, 16, false); // no view tags
+  TEST_PERFORMANCE2(filter, p, test_is_out_to_acc_precomp_scan, 16, true); // view tags
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, false, true); // no view tag, owned
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, false); // use view tag, not owned
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, true); // use view tag, owned
@@ -215,12 +226,39 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
 
+  TEST_PERFORMANCE4(filter, p, test_wallet_scan, 1000, 10, 1, 1000);
+  TEST_PERFORMANCE4(filter, p, test_wallet_scan, 1000, 10, 10, 1000);
+  TEST_PERFORMANCE4(filter, p, test_wallet_scan, 1000, 10, 100, 1000);
+  TEST_PERFORMANCE4(filter, p, test_wallet_scan, 1000, 10, 10, 50000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_store, 10000, 1000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_store, 100000, 50000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_load, 10000, 1000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_load, 100000, 50000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_balance, 1000, 1000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_balance, 10000, 1000);
+  TEST_PERFORMANCE2(filter, p, test_wallet_balance, 100000, 50000);
+
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 0);
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 1);
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 2);
   TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, 4);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
+  TEST_PERFORMANCE1(filter, p, test_cn_fast_hash_multi, 32);
+  TEST_PERFORMANCE1(filter, p, test_cn_fast_hash_multi, 64);
+  TEST_PERFORMANCE1(filter, p, test_cn_fast_hash_multi, 16384);
+
+  TEST_PERFORMANCE2(filter, p, test_rolling_median_fill, 1000, false);
+  TEST_PERFORMANCE2(filter, p, test_rolling_median_fill, 1000, true);
+  TEST_PERFORMANCE2(filter, p, test_rolling_median_fill, 100000, false);
+  TEST_PERFORMANCE2(filter, p, test_rolling_median_fill, 100000, true);
+
+  TEST_PERFORMANCE1(filter, p, test_hex_encode, 32);
+  TEST_PERFORMANCE1(filter, p, test_hex_encode, 2048);
+  TEST_PERFORMANCE1(filter, p, test_hex_encode, 1048576);
+  TEST_PERFORMANCE1(filter, p, test_hex_decode, 32);
+  TEST_PERFORMANCE1(filter, p, test_hex_decode, 2048);
+  TEST_PERFORMANCE1(filter, p, test_hex_decode, 1048576);
 
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 4, 2, 2); // MLSAG verification
   TEST_PERFORMANCE3(filter, p, test_sig_mlsag, 8, 2, 2);
@@ -299,6 +337,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_scalarmultH);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_scalarmult8);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_scalarmult8_p3);
+  TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_frombytes_vartime);
+  TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_p3_tobytes);
+  TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_scalarmult);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_dsm_precomp);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_double_scalarmult_base_vartime);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_ge_triple_scalarmult_base_vartime);
@@ -366,6 +407,12 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger, 1024, 7);
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger, 2048, 8);
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger, 4096, 9);
+
+  // the pippenger runs above sum windows in parallel from 1024 points
+  TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_single_threaded, 1024, 7);
+  TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_single_threaded, 2048, 8);
+  TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_single_threaded, 4096, 9);
+
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_cached, 2, 1);
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_cached, 4, 2);
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger_cached, 8, 2);
@@ -42,6 +42,7 @@ enum test_multiexp_algorithm
   multiexp_straus_cached,
   multiexp_pippenger,
   multiexp_pippenger_cached,
+  multiexp_pippenger_single_threaded,
 };
 
 template<test_multiexp_algorithm algorithm, size_t npoints, size_t c=0>
@@ -82,6 +83,8 @@ public:
         return res == pippenger(data, NULL, 0, c);
       case multiexp_pippenger_cached:
         return res == pippenger(data, pippenger_cache, 0, c);
+      case multiexp_pippenger_single_threaded:
+        return res == pippenger(data, NULL, 0, c, false);
       default:
         return false;
     }
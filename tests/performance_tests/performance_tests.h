@@ -40,6 +40,7 @@
 #include "stats.h"
 #include "common/perf_timer.h"
 #include "common/timings.h"
+#include "performance_utils.h"
 
 class performance_timer
 {
@@ -176,6 +177,7 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
       std::cout << test_name << " - OK:\n";
       std::cout << "  loop count:    " << T::loop_count * params.loop_multiplier << '\n';
       std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
+      std::cout << "  peak RSS:      " << get_peak_rss_kb() << " kB\n";
       if (params.stats)
       {
         std::cout << "  min:       " << runner.get_min() << " ns\n";
@@ -31,11 +31,14 @@
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
 
 #include <boost/config.hpp>
 
 #ifdef BOOST_WINDOWS
 #include <windows.h>
+#else
+#include <sys/resource.h>
 #endif
 
 void set_process_affinity(int core)
@@ -83,3 +86,20 @@ void set_thread_high_priority()
   ::pthread_attr_destroy(&attr);
 #endif
 }
+
+// peak resident set size of the process so far, in kB, or 0 if unknown
+uint64_t get_peak_rss_kb()
+{
+#if defined(BOOST_WINDOWS)
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
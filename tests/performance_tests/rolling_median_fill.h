@@ -0,0 +1,64 @@
+// Copyright (c) 2014-2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#pragma once
+
+#include <vector>
+#include "crypto/crypto.h"
+#include "rolling_median.h"
+
+// filling a rolling median window from scratch, as on a long term weight cache miss
+template<size_t window, bool bulk>
+class test_rolling_median_fill
+{
+public:
+  static const size_t loop_count = window >= 10000 ? 20 : 1000;
+
+  bool init()
+  {
+    m_weights.reserve(window);
+    for (size_t i = 0; i < window; ++i)
+      m_weights.push_back(crypto::rand<uint64_t>() % 1000000);
+    return true;
+  }
+
+  bool test()
+  {
+    epee::misc_utils::rolling_median_t<uint64_t> m(window);
+    if (bulk)
+      m.assign(m_weights.begin(), m_weights.end());
+    else
+      for (uint64_t w: m_weights)
+        m.insert(w);
+    return m.median() < 1000000;
+  }
+
+private:
+  std::vector<uint64_t> m_weights;
+};
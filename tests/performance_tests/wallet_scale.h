@@ -0,0 +1,340 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <ctime>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+// gives the wallet tests access to the block processing wallet2 does on refresh
+class wallet_accessor_test
+{
+public:
+  static void process_parsed_blocks(tools::wallet2 &wallet, uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks,
+      const std::vector<tools::wallet2::parsed_block> &parsed_blocks)
+  {
+    uint64_t blocks_added;
+    wallet.process_parsed_blocks(start_height, blocks, parsed_blocks, blocks_added);
+  }
+
+  static void detach_blockchain(tools::wallet2 &wallet, uint64_t height)
+  {
+    wallet.detach_blockchain(height);
+  }
+};
+
+// A wallet with Subaddresses subaddresses, and a synthetic chain of view tag
+// era blocks to feed it. Txes have 16 member rings and two outputs, and one
+// in a hundred of them, times OwnedPercent, pays the wallet's main address
+// or one of its subaddresses. Nothing is proven, the rct data only carries
+// what the wallet decodes.
+template<size_t Subaddresses>
+class wallet_scale_test_base
+{
+public:
+  static const size_t blocks_per_chunk = 1000;
+
+protected:
+  struct chunk_t
+  {
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<tools::wallet2::parsed_block> parsed_blocks;
+  };
+
+  bool init_wallet(const std::string &path = std::string())
+  {
+    m_wallet.set_subaddress_lookahead(1, Subaddresses);
+    m_wallet.generate(path, "", rct::rct2sk(rct::skGen()), true, false);
+    m_wallet.set_refresh_from_block_height(0);
+    return true;
+  }
+
+  void generate_chain(size_t n_blocks, size_t txes_per_block, size_t owned_percent)
+  {
+    const uint64_t now = time(NULL);
+    const cryptonote::account_public_address address = m_wallet.get_account().get_keys().m_account_address;
+    size_t n_txes = 0;
+    for (size_t b = 0; b < n_blocks; ++b)
+    {
+      if (m_chunks.empty() || m_chunks.back().blocks.size() >= blocks_per_chunk)
+        m_chunks.emplace_back();
+      chunk_t &chunk = m_chunks.back();
+
+      tools::wallet2::parsed_block pb;
+      pb.error = false;
+      pb.hash = crypto::rand<crypto::hash>();
+      pb.block.major_version = HF_VERSION_VIEW_TAGS + 1;
+      pb.block.minor_version = HF_VERSION_VIEW_TAGS + 1;
+      pb.block.timestamp = now;
+      pb.block.prev_id = crypto::rand<crypto::hash>();
+      pb.block.miner_tx = make_miner_tx(m_height);
+      pb.o_indices.indices.push_back({{m_global_index++}});
+
+      cryptonote::block_complete_entry bce;
+      bce.pruned = false;
+      bce.block_weight = 0;
+      for (size_t t = 0; t < txes_per_block; ++t, ++n_txes)
+      {
+        const bool owned = (n_txes * owned_percent) / 100 != ((n_txes + 1) * owned_percent) / 100;
+        const uint32_t minor = owned && Subaddresses > 1 ? m_owned % Subaddresses : 0;
+        if (owned)
+          ++m_owned;
+        const cryptonote::account_public_address destination = minor ? m_wallet.get_subaddress({0, minor}) : address;
+        pb.txes.push_back(make_tx(owned ? &destination : nullptr, minor != 0));
+        pb.block.tx_hashes.push_back(crypto::rand<crypto::hash>());
+        pb.o_indices.indices.push_back({{m_global_index, m_global_index + 1}});
+        m_global_index += 2;
+        bce.txs.push_back({cryptonote::blobdata(), crypto::null_hash});
+      }
+      chunk.blocks.push_back(std::move(bce));
+      chunk.parsed_blocks.push_back(std::move(pb));
+      ++m_height;
+    }
+  }
+
+  bool scan()
+  {
+    uint64_t height = 1;
+    for (const auto &chunk: m_chunks)
+    {
+      wallet_accessor_test::process_parsed_blocks(m_wallet, height, chunk.blocks, chunk.parsed_blocks);
+      height += chunk.blocks.size();
+    }
+    return m_wallet.get_num_transfer_details() == m_owned;
+  }
+
+  void rewind()
+  {
+    wallet_accessor_test::detach_blockchain(m_wallet, 1);
+  }
+
+private:
+  cryptonote::transaction make_miner_tx(uint64_t height)
+  {
+    cryptonote::transaction tx;
+    tx.version = 2;
+    tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    tx.vin.push_back(cryptonote::txin_gen{height});
+    cryptonote::txout_to_tagged_key tk;
+    tk.key = rct::rct2pk(rct::pkGen());
+    tk.view_tag.data = crypto::rand<char>();
+    tx.vout.push_back({600000000000, tk});
+    cryptonote::add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::pkGen()));
+    tx.rct_signatures.type = rct::RCTTypeNull;
+    return tx;
+  }
+
+  cryptonote::transaction make_tx(const cryptonote::account_public_address *destination, bool subaddress)
+  {
+    static const uint64_t amount = 1000000000;
+    cryptonote::transaction tx;
+    tx.version = 2;
+    tx.unlock_time = 0;
+    cryptonote::txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.assign(16, 1);
+    in.k_image = rct::rct2ki(rct::pkGen());
+    tx.vin.push_back(in);
+
+    const crypto::secret_key r = rct::rct2sk(rct::skGen());
+    crypto::key_derivation derivation;
+    crypto::public_key tx_pub_key;
+    if (destination)
+    {
+      tx_pub_key = subaddress
+          ? rct::rct2pk(rct::scalarmultKey(rct::pk2rct(destination->m_spend_public_key), rct::sk2rct(r)))
+          : rct::rct2pk(rct::scalarmultBase(rct::sk2rct(r)));
+      crypto::generate_key_derivation(destination->m_view_public_key, r, derivation);
+    }
+    else
+    {
+      tx_pub_key = rct::rct2pk(rct::pkGen());
+    }
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_pub_key);
+
+    tx.rct_signatures.type = rct::RCTTypeBulletproofPlus;
+    tx.rct_signatures.txnFee = 30000000;
+    for (size_t i = 0; i < 2; ++i)
+    {
+      cryptonote::txout_to_tagged_key tk;
+      rct::key shared_secret;
+      if (destination && i == 0)
+      {
+        crypto::secret_key scalar;
+        crypto::derivation_to_scalar(derivation, i, scalar);
+        shared_secret = rct::sk2rct(scalar);
+        crypto::derive_public_key(derivation, i, destination->m_spend_public_key, tk.key);
+        crypto::derive_view_tag(derivation, i, tk.view_tag);
+      }
+      else
+      {
+        shared_secret = rct::skGen();
+        tk.key = rct::rct2pk(rct::pkGen());
+        tk.view_tag.data = crypto::rand<char>();
+      }
+      tx.vout.push_back({0, tk});
+
+      rct::ecdhTuple ecdh;
+      ecdh.mask = rct::zero();
+      ecdh.amount = rct::d2h(amount);
+      rct::ecdhEncode(ecdh, shared_secret, true);
+      tx.rct_signatures.ecdhInfo.push_back(ecdh);
+      tx.rct_signatures.outPk.push_back({rct::pk2rct(tk.key), rct::commit(amount, rct::genCommitmentMask(shared_secret))});
+    }
+    return tx;
+  }
+
+protected:
+  tools::wallet2 m_wallet;
+  std::vector<chunk_t> m_chunks;
+  size_t m_owned = 0;
+
+private:
+  uint64_t m_height = 1;
+  uint64_t m_global_index = 0;
+};
+
+// Scan rate: the block processing done by wallet2::refresh, without the
+// daemon round trips, from a rewound wallet
+template<size_t Blocks, size_t TxesPerBlock, size_t OwnedPercent, size_t Subaddresses>
+class test_wallet_scan : public wallet_scale_test_base<Subaddresses>
+{
+public:
+  static const size_t loop_count = 3;
+
+  bool init()
+  {
+    if (!this->init_wallet())
+      return false;
+    this->generate_chain(Blocks, TxesPerBlock, OwnedPercent);
+    // the first scan also expands the subaddress table as outputs are found
+    return this->scan();
+  }
+
+  bool test()
+  {
+    this->rewind();
+    return this->scan();
+  }
+};
+
+// A wallet file with Transfers received outputs, stored to and loaded from a temporary directory
+template<size_t Transfers, size_t Subaddresses>
+class wallet_file_test_base : public wallet_scale_test_base<Subaddresses>
+{
+public:
+  ~wallet_file_test_base()
+  {
+    if (!m_dir.empty())
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+  }
+
+protected:
+  bool init_wallet_file()
+  {
+    boost::system::error_code ec;
+    m_dir = boost::filesystem::temp_directory_path(ec) / boost::filesystem::unique_path("monero-wallet-perf-%%%%-%%%%");
+    if (!boost::filesystem::create_directories(m_dir, ec))
+      return false;
+    m_path = (m_dir / "wallet").string();
+    if (!this->init_wallet(m_path))
+      return false;
+    this->generate_chain((Transfers + 9) / 10, 10, 100);
+    if (!this->scan())
+      return false;
+    this->m_wallet.store();
+    return true;
+  }
+
+  boost::filesystem::path m_dir;
+  std::string m_path;
+};
+
+template<size_t Transfers, size_t Subaddresses>
+class test_wallet_store : public wallet_file_test_base<Transfers, Subaddresses>
+{
+public:
+  static const size_t loop_count = 5;
+
+  bool init() { return this->init_wallet_file(); }
+
+  bool test()
+  {
+    this->m_wallet.store();
+    return true;
+  }
+};
+
+template<size_t Transfers, size_t Subaddresses>
+class test_wallet_load : public wallet_file_test_base<Transfers, Subaddresses>
+{
+public:
+  static const size_t loop_count = 5;
+
+  bool init() { return this->init_wallet_file(); }
+
+  bool test()
+  {
+    tools::wallet2 wallet;
+    wallet.load(this->m_path, "");
+    return wallet.get_num_transfer_details() == Transfers;
+  }
+};
+
+// create_transactions_2 needs a daemon for fees and decoys, so this times the
+// part of it that scales with the transfer count: the per subaddress balances
+template<size_t Transfers, size_t Subaddresses>
+class test_wallet_balance : public wallet_scale_test_base<Subaddresses>
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    if (!this->init_wallet())
+      return false;
+    this->generate_chain((Transfers + 9) / 10, 10, 100);
+    return this->scan();
+  }
+
+  bool test()
+  {
+    const auto balances = this->m_wallet.balance_per_subaddress(0, false);
+    return !balances.empty() && this->m_wallet.balance_all(false) > 0;
+  }
+};
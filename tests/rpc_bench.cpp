@@ -0,0 +1,342 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Replays RPC requests recorded by monerod's --rpc-record-file against a daemon,
+// at several concurrency levels. Reports throughput for each level, which traces
+// where the daemon saturates, and the latency distribution of each endpoint.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <boost/algorithm/string.hpp>
+#include <rapidjson/document.h>
+#include "common/command_line.h"
+#include "common/util.h"
+#include "net/http_client.h"
+#include "string_tools.h"
+#include "version.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "tests.rpc_bench"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  // calls which change the target's state, only replayed with --replay-writes
+  const char *const write_endpoints[] = {
+    "/stop_daemon", "/send_raw_transaction", "/sendrawtransaction", "/start_mining", "/stop_mining",
+    "/set_bootstrap_daemon", "/set_log_hash_rate", "/set_log_level", "/set_log_categories", "/set_limit",
+    "/save_bc", "/update", "/pop_blocks", "/in_peers", "/out_peers",
+    "json_rpc/submitblock", "json_rpc/submit_block", "json_rpc/generateblocks", "json_rpc/flush_txpool",
+    "json_rpc/set_bans", "json_rpc/relay_tx", "json_rpc/prune_blockchain", "json_rpc/flush_cache",
+    "json_rpc/rpc_access_pay", "json_rpc/rpc_access_submit_nonce",
+  };
+
+  struct recorded_request
+  {
+    std::string method;
+    std::string uri;
+    std::string body;
+    size_t endpoint;
+  };
+
+  // json_rpc calls are told apart by their method
+  std::string get_endpoint_name(const std::string &uri, const std::string &body)
+  {
+    if (uri != "/json_rpc")
+      return uri;
+    rapidjson::Document doc;
+    if (doc.Parse(body.data(), body.size()).HasParseError() || !doc.IsObject())
+      return "json_rpc/?";
+    const auto method = doc.FindMember("method");
+    if (method == doc.MemberEnd() || !method->value.IsString())
+      return "json_rpc/?";
+    return std::string("json_rpc/") + method->value.GetString();
+  }
+
+  bool load_requests(const std::string &filename, bool replay_writes, std::vector<recorded_request> &requests, std::vector<std::string> &endpoints)
+  {
+    std::ifstream f(filename);
+    if (!f.good())
+    {
+      std::cerr << "Failed to open " << filename << std::endl;
+      return false;
+    }
+    std::map<std::string, size_t> endpoint_ids;
+    std::string line;
+    size_t line_number = 0, skipped = 0;
+    while (std::getline(f, line))
+    {
+      ++line_number;
+      std::vector<std::string> fields;
+      boost::split(fields, line, boost::is_any_of(" "));
+      recorded_request request;
+      if (fields.size() != 4 || (fields[3] != "-" && !epee::string_tools::parse_hexstr_to_binbuff(fields[3], request.body)))
+      {
+        std::cerr << filename << ":" << line_number << ": malformed record" << std::endl;
+        return false;
+      }
+      request.method = std::move(fields[0]);
+      request.uri = std::move(fields[1]);
+      const std::string name = get_endpoint_name(request.uri, request.body);
+      if (!replay_writes && std::find(std::begin(write_endpoints), std::end(write_endpoints), name) != std::end(write_endpoints))
+      {
+        ++skipped;
+        continue;
+      }
+      const auto it = endpoint_ids.emplace(name, endpoints.size());
+      if (it.second)
+        endpoints.push_back(name);
+      request.endpoint = it.first->second;
+      requests.push_back(std::move(request));
+    }
+    if (skipped)
+      std::cout << "Skipped " << skipped << " state changing requests, see --replay-writes" << std::endl;
+    return true;
+  }
+
+  struct latency_summary
+  {
+    size_t count;
+    double p50_us, p90_us, p99_us, max_us;
+  };
+
+  latency_summary summarize(std::vector<uint64_t> &latencies)
+  {
+    latency_summary summary{latencies.size(), 0, 0, 0, 0};
+    if (latencies.empty())
+      return summary;
+    std::sort(latencies.begin(), latencies.end());
+    const auto at = [&](size_t percent) { return latencies[std::min(latencies.size() - 1, latencies.size() * percent / 100)] / 1000.0; };
+    summary.p50_us = at(50);
+    summary.p90_us = at(90);
+    summary.p99_us = at(99);
+    summary.max_us = latencies.back() / 1000.0;
+    return summary;
+  }
+
+  struct level_result
+  {
+    double requests_per_second;
+    uint64_t errors;
+    latency_summary all;
+    std::vector<latency_summary> endpoints;
+  };
+
+  level_result run_level(const std::vector<recorded_request> &requests, size_t num_endpoints, unsigned concurrency, uint64_t total,
+      const std::string &address, const boost::optional<epee::net_utils::http::login> &login, std::chrono::milliseconds timeout)
+  {
+    // latencies[thread][endpoint], in ns
+    std::vector<std::vector<std::vector<uint64_t>>> latencies(concurrency, std::vector<std::vector<uint64_t>>(num_endpoints));
+    std::atomic<uint64_t> next{0}, errors{0};
+    std::vector<std::thread> workers;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < concurrency; ++t)
+    {
+      workers.emplace_back([&, t]() {
+        epee::net_utils::http::http_simple_client client;
+        client.set_server(address, login, epee::net_utils::ssl_support_t::e_ssl_support_disabled);
+        for (uint64_t i = next++; i < total; i = next++)
+        {
+          const recorded_request &request = requests[i % requests.size()];
+          const epee::net_utils::http::http_response_info *info = NULL;
+          const auto op0 = std::chrono::steady_clock::now();
+          const bool r = client.invoke(request.uri, request.method, request.body, timeout, &info);
+          const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - op0).count();
+          if (!r || !info || info->m_response_code != 200)
+          {
+            // busy or failed responses would skew the latencies, count them apart
+            ++errors;
+            continue;
+          }
+          latencies[t][request.endpoint].push_back(elapsed);
+        }
+      });
+    }
+    for (std::thread &worker: workers)
+      worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    level_result result;
+    result.errors = errors;
+    std::vector<uint64_t> all;
+    for (size_t e = 0; e < num_endpoints; ++e)
+    {
+      std::vector<uint64_t> endpoint;
+      for (auto &thread_latencies: latencies)
+        endpoint.insert(endpoint.end(), thread_latencies[e].begin(), thread_latencies[e].end());
+      all.insert(all.end(), endpoint.begin(), endpoint.end());
+      result.endpoints.push_back(summarize(endpoint));
+    }
+    result.requests_per_second = seconds > 0 ? all.size() / seconds : 0.0;
+    result.all = summarize(all);
+    return result;
+  }
+
+  void print_summary(const std::string &name, const latency_summary &summary)
+  {
+    std::cout << std::setw(36) << std::left << name << std::setw(10) << std::right << summary.count << std::fixed << std::setprecision(0)
+        << std::setw(12) << summary.p50_us << std::setw(12) << summary.p90_us << std::setw(12) << summary.p99_us << std::setw(12) << summary.max_us << std::endl;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  tools::on_startup();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_record_file  = {"record-file", "File written by monerod --rpc-record-file", ""};
+  const command_line::arg_descriptor<std::string> arg_daemon_address  = {"daemon-address", "Daemon to replay the requests against", "127.0.0.1:18081"};
+  const command_line::arg_descriptor<std::string> arg_rpc_login  = {"rpc-login", "Daemon RPC login, as username:password", ""};
+  const command_line::arg_descriptor<std::string> arg_concurrency  = {"concurrency", "Comma separated numbers of requests in flight", "1,2,4,8,16,32"};
+  const command_line::arg_descriptor<uint64_t> arg_requests  = {"requests", "Requests sent at each concurrency level, cycling through the record (0 for one pass)", 0};
+  const command_line::arg_descriptor<uint64_t> arg_timeout  = {"timeout-ms", "Timeout for each request", 30000};
+  const command_line::arg_descriptor<bool> arg_replay_writes  = {"replay-writes", "Also replay requests which change the daemon's state, such as transaction submission", false};
+  const command_line::arg_descriptor<bool> arg_per_endpoint  = {"per-endpoint", "Print the latency distribution of each endpoint at each concurrency level", false};
+
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_record_file);
+  command_line::add_arg(desc_cmd_sett, arg_daemon_address);
+  command_line::add_arg(desc_cmd_sett, arg_rpc_login);
+  command_line::add_arg(desc_cmd_sett, arg_concurrency);
+  command_line::add_arg(desc_cmd_sett, arg_requests);
+  command_line::add_arg(desc_cmd_sett, arg_timeout);
+  command_line::add_arg(desc_cmd_sett, arg_replay_writes);
+  command_line::add_arg(desc_cmd_sett, arg_per_endpoint);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help) || command_line::is_arg_defaulted(vm, arg_record_file))
+  {
+    std::cout << "Monero '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure("", true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log("0");
+
+  std::vector<std::string> concurrency_strings;
+  std::vector<unsigned> concurrency_levels;
+  boost::split(concurrency_strings, command_line::get_arg(vm, arg_concurrency), boost::is_any_of(","));
+  for (const std::string &s: concurrency_strings)
+  {
+    const unsigned concurrency = strtoul(s.c_str(), NULL, 10);
+    if (concurrency == 0)
+    {
+      std::cerr << "Invalid concurrency: " << s << std::endl;
+      return 1;
+    }
+    concurrency_levels.push_back(concurrency);
+  }
+
+  boost::optional<epee::net_utils::http::login> login;
+  const std::string rpc_login = command_line::get_arg(vm, arg_rpc_login);
+  if (!rpc_login.empty())
+  {
+    const size_t colon = rpc_login.find(':');
+    if (colon == std::string::npos)
+    {
+      std::cerr << "--" << arg_rpc_login.name << " must be username:password" << std::endl;
+      return 1;
+    }
+    login.emplace(rpc_login.substr(0, colon), epee::wipeable_string(rpc_login.substr(colon + 1)));
+  }
+
+  std::vector<recorded_request> requests;
+  std::vector<std::string> endpoints;
+  if (!load_requests(command_line::get_arg(vm, arg_record_file), command_line::get_arg(vm, arg_replay_writes), requests, endpoints))
+    return 1;
+  if (requests.empty())
+  {
+    std::cerr << "No requests to replay" << std::endl;
+    return 1;
+  }
+  uint64_t total = command_line::get_arg(vm, arg_requests);
+  if (total == 0)
+    total = requests.size();
+  const std::string address = command_line::get_arg(vm, arg_daemon_address);
+  const std::chrono::milliseconds timeout(command_line::get_arg(vm, arg_timeout));
+  const bool per_endpoint = command_line::get_arg(vm, arg_per_endpoint);
+  std::cout << "Replaying " << requests.size() << " requests to " << endpoints.size() << " endpoints against " << address << std::endl;
+
+  std::vector<level_result> results;
+  std::cout << std::setw(12) << std::left << "in flight" << std::setw(12) << std::right << "req/s" << std::setw(10) << "errors"
+      << std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+  for (unsigned concurrency: concurrency_levels)
+  {
+    results.push_back(run_level(requests, endpoints.size(), concurrency, total, address, login, timeout));
+    const level_result &result = results.back();
+    std::cout << std::setw(12) << std::left << concurrency << std::setw(12) << std::right << std::fixed << std::setprecision(0) << result.requests_per_second
+        << std::setw(10) << result.errors << std::setw(12) << result.all.p50_us << std::setw(12) << result.all.p90_us
+        << std::setw(12) << result.all.p99_us << std::setw(12) << result.all.max_us << std::endl;
+  }
+
+  for (size_t level = 0; level < results.size(); ++level)
+  {
+    if (!per_endpoint && level + 1 < results.size())
+      continue;
+    std::cout << std::endl << "Endpoints at " << concurrency_levels[level] << " in flight" << std::endl;
+    std::cout << std::setw(36) << std::left << "endpoint" << std::setw(10) << std::right << "count"
+        << std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    for (size_t e = 0; e < endpoints.size(); ++e)
+      print_summary(endpoints[e], results[level].endpoints[e]);
+  }
+
+  return 0;
+
+  CATCH_ENTRY_L0("main", 1);
+}
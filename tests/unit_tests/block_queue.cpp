@@ -26,11 +26,13 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/filesystem.hpp>
 #include <boost/uuid/uuid.hpp>
 #include "gtest/gtest.h"
 #include "crypto/crypto.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "cryptonote_protocol/block_queue.h"
+#include "common/pruning.h"
 
 static const boost::uuids::uuid &uuid1()
 {
@@ -87,3 +89,146 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1(), na);
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, adaptive_span_size)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+
+  // nothing known yet
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 100), 20);
+  ASSERT_FALSE(bq.is_span_overdue(uuid1(), 1000.0f));
+
+  // fast peer, 1 second for a span: grow, but at most twice at once
+  bq.add_blocks(0, std::vector<cryptonote::block_complete_entry>(20), uuid1(), na, 1000.0f, 1000);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 100), 40);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 30), 30);
+
+  // slow peer, 20 seconds for a span: shrink, but at most by half at once
+  bq.add_blocks(20, std::vector<cryptonote::block_complete_entry>(20), uuid2(), na, 100.0f, 2000);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 100), 10);
+  bq.add_blocks(30, std::vector<cryptonote::block_complete_entry>(10), uuid2(), na, 100.0f, 2000);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 100), 5);
+  // never below a quarter of the default
+  bq.add_blocks(40, std::vector<cryptonote::block_complete_entry>(5), uuid2(), na, 100.0f, 2000);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 100), 5);
+
+  ASSERT_EQ(bq.get_download_rate(uuid1()), 1000.0f);
+  ASSERT_EQ(bq.get_download_rate(uuid2()), 100.0f);
+  ASSERT_FLOAT_EQ(bq.get_speed(uuid2()), 0.1f);
+
+  ASSERT_FALSE(bq.is_span_overdue(uuid1(), 10.0f));
+  ASSERT_TRUE(bq.is_span_overdue(uuid1(), 13.0f));
+  ASSERT_FALSE(bq.is_span_overdue(uuid2(), 40.0f));
+  ASSERT_TRUE(bq.is_span_overdue(uuid2(), 61.0f));
+
+  // stats survive the spans being used, but not the connection going away
+  bq.remove_spans(uuid1(), 0);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 100), 40);
+  bq.flush_spans(uuid1(), true);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 20, 100), 20);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 100), 5);
+  bq.flush_stale_spans({});
+  ASSERT_EQ(bq.get_span_size(uuid2(), 20, 100), 20);
+}
+
+TEST(block_queue, span_by_weight)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+
+  // nothing known about that peer's rate yet
+  ASSERT_EQ(bq.get_span_weight(uuid1()), 0);
+
+  // 1000 bytes per second, so it sends about 4000 bytes of blocks in the target time
+  bq.add_blocks(0, std::vector<cryptonote::block_complete_entry>(20), uuid1(), na, 1000.0f, 1000);
+  ASSERT_EQ(bq.get_span_weight(uuid1()), 4000);
+
+  std::vector<std::pair<crypto::hash, uint64_t>> block_hashes;
+  for (size_t n = 0; n < 10; ++n)
+    block_hashes.push_back(std::make_pair(crypto::rand<crypto::hash>(), 1500));
+
+  // known weights cut the span short, but it always gets one block
+  std::pair<uint64_t, uint64_t> span = bq.reserve_span(100, 109, 10, uuid1(), na, false, 0, 0, 200, block_hashes, bq.get_span_weight(uuid1()));
+  ASSERT_EQ(span.first, 100);
+  ASSERT_EQ(span.second, 2);
+  span = bq.reserve_span(100, 109, 10, uuid1(), na, false, 0, 0, 200, block_hashes, 1000);
+  ASSERT_EQ(span.first, 102);
+  ASSERT_EQ(span.second, 1);
+  ASSERT_EQ(bq.get_reserved_weight(), 4500);
+
+  // unknown weights, or no limit, only go by the block count
+  for (auto &e: block_hashes)
+    e.second = 0;
+  span = bq.reserve_span(100, 109, 10, uuid1(), na, false, 0, 0, 200, block_hashes, 4000);
+  ASSERT_EQ(span.first, 103);
+  ASSERT_EQ(span.second, 7);
+  ASSERT_EQ(bq.get_reserved_weight(), 4500);
+
+  // once received, a span's data counts instead
+  bq.add_blocks(100, std::vector<cryptonote::block_complete_entry>(2), uuid1(), na, 1000.0f, 3000);
+  ASSERT_EQ(bq.get_reserved_weight(), 1500);
+}
+
+TEST(block_queue, reserve_span_pruned_peer)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+
+  // hashes from height 1000 into the third stripe
+  std::vector<std::pair<crypto::hash, uint64_t>> block_hashes;
+  for (size_t n = 0; n < 8000; ++n)
+    block_hashes.push_back(std::make_pair(crypto::rand<crypto::hash>(), 0));
+
+  // a peer on a later stripe is routed to the start of its stripe, more than a stripe ahead
+  std::pair<uint64_t, uint64_t> span = bq.reserve_span(1000, 8999, 100, uuid1(), na, false, 0, tools::make_pruning_seed(3, CRYPTONOTE_PRUNING_LOG_STRIPES), 100000, block_hashes, 0);
+  ASSERT_EQ(span.first, 2 * CRYPTONOTE_PRUNING_STRIPE_SIZE);
+  ASSERT_EQ(span.second, 100);
+
+  // a peer whose stripe is past the hashes has nothing to send
+  span = bq.reserve_span(1000, 8999, 100, uuid1(), na, false, 0, tools::make_pruning_seed(5, CRYPTONOTE_PRUNING_LOG_STRIPES), 100000, block_hashes, 0);
+  ASSERT_EQ(span.second, 0);
+}
+
+TEST(block_queue, spill)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(bq.set_spill(dir.string(), 1500, 10000));
+
+  for (uint64_t height = 0; height < 30; height += 10)
+  {
+    std::vector<cryptonote::block_complete_entry> bcel(10);
+    for (size_t i = 0; i < bcel.size(); ++i)
+      bcel[i].block = std::to_string(height + i);
+    bq.add_blocks(height, std::move(bcel), uuid1(), na, 1000.0f, 1000);
+  }
+
+  // the furthest spans went to disk, the next one needed stayed in memory
+  ASSERT_EQ(bq.get_data_size(), 1000);
+  ASSERT_EQ(bq.get_spilled_size(), 2000);
+  ASSERT_EQ(bq.get_num_filled_spans(), 3);
+  ASSERT_EQ(bq.get_next_needed_height(0), 30);
+
+  std::vector<cryptonote::block_complete_entry> bcel;
+  ASSERT_TRUE(bq.get_filled_span_at(10, bcel));
+  ASSERT_EQ(bcel.size(), 10);
+  for (size_t i = 0; i < bcel.size(); ++i)
+    ASSERT_EQ(bcel[i].block, std::to_string(10 + i));
+
+  // spans leaving the queue take their file with them
+  bq.remove_spans(uuid1(), 0);
+  bq.remove_spans(uuid1(), 10);
+  ASSERT_EQ(bq.get_spilled_size(), 1000);
+  uint64_t height;
+  boost::uuids::uuid connection_id;
+  ASSERT_TRUE(bq.get_next_span(height, bcel, connection_id, na));
+  ASSERT_EQ(height, 20);
+  ASSERT_EQ(bcel.size(), 10);
+  ASSERT_EQ(bcel[0].block, "20");
+  bq.flush_spans(uuid1(), true);
+  ASSERT_EQ(bq.get_spilled_size(), 0);
+  ASSERT_TRUE(boost::filesystem::is_empty(dir));
+  boost::filesystem::remove_all(dir);
+}
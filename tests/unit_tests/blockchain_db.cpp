@@ -28,10 +28,12 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <mutex>
 
 #include "gtest/gtest.h"
 
@@ -341,4 +343,487 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, BatchLookups)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  db_wtxn_guard guard(this->m_db);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // every output of every amount, looked up backwards
+  std::vector<uint64_t> amounts, offsets;
+  for (const auto &b: this->m_blocks)
+  {
+    for (const auto &out: b.first.miner_tx.vout)
+    {
+      if (std::find(amounts.begin(), amounts.end(), out.amount) != amounts.end())
+        continue;
+      const uint64_t n_outputs = this->m_db->get_num_outputs(out.amount);
+      for (uint64_t i = 0; i < n_outputs; ++i)
+      {
+        amounts.push_back(out.amount);
+        offsets.push_back(i);
+      }
+    }
+  }
+  std::reverse(amounts.begin(), amounts.end());
+  std::reverse(offsets.begin(), offsets.end());
+  ASSERT_FALSE(offsets.empty());
+
+  std::vector<output_data_t> outputs;
+  ASSERT_NO_THROW(this->m_db->get_output_keys_batch(amounts, offsets, outputs));
+  ASSERT_EQ(offsets.size(), outputs.size());
+  for (size_t i = 0; i < offsets.size(); ++i)
+  {
+    const output_data_t od = this->m_db->get_output_key(amounts[i], offsets[i], true);
+    ASSERT_EQ(od.pubkey, outputs[i].pubkey);
+    ASSERT_EQ(od.height, outputs[i].height);
+  }
+
+  amounts.push_back(amounts.back());
+  offsets.push_back(1000000);
+  ASSERT_THROW(this->m_db->get_output_keys_batch(amounts, offsets, outputs), OUTPUT_DNE);
+
+  // spent key images and unknown ones, interleaved
+  std::vector<crypto::key_image> key_images;
+  std::vector<bool> expected;
+  for (const auto &txs: this->m_txs)
+  {
+    for (const auto &tx: txs)
+    {
+      for (const auto &in: tx.first.vin)
+      {
+        if (in.type() != typeid(txin_to_key))
+          continue;
+        key_images.push_back(boost::get<txin_to_key>(in).k_image);
+        expected.push_back(true);
+        key_images.push_back(crypto::key_image{});
+        expected.push_back(false);
+      }
+    }
+  }
+
+  std::vector<bool> spent;
+  ASSERT_NO_THROW(this->m_db->have_key_images_batch(epee::to_span(key_images), spent));
+  ASSERT_EQ(expected, spent);
+  for (size_t i = 0; i < key_images.size(); ++i)
+    ASSERT_EQ(this->m_db->has_key_image(key_images[i]), spent[i]);
+}
+
+TYPED_TEST(BlockchainDBTest, CumulativeRctOutputsRange)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  db_wtxn_guard guard(this->m_db);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  const std::vector<uint64_t> expected = this->m_db->get_block_cumulative_rct_outputs({0, 1});
+  ASSERT_EQ(expected, this->m_db->get_block_cumulative_rct_outputs_range(0, 2));
+  ASSERT_EQ(std::vector<uint64_t>{expected[1]}, this->m_db->get_block_cumulative_rct_outputs_range(1, 1));
+  ASSERT_TRUE(this->m_db->get_block_cumulative_rct_outputs_range(0, 0).empty());
+  ASSERT_THROW(this->m_db->get_block_cumulative_rct_outputs_range(1, 2), BLOCK_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, CumulativeRctColumnFollowsCommits)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // loads the column
+  const std::vector<uint64_t> expected = this->m_db->get_block_cumulative_rct_outputs({0, 1});
+  ASSERT_EQ(expected, this->m_db->get_block_cumulative_rct_outputs_range(0, 2));
+
+  block b;
+  std::vector<transaction> txs;
+
+  // an aborted pop and re-add leaves the column as committed
+  ASSERT_TRUE(this->m_db->batch_start());
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  this->m_db->batch_abort();
+  ASSERT_EQ(2, this->m_db->height());
+  ASSERT_EQ(expected, this->m_db->get_block_cumulative_rct_outputs_range(0, 2));
+
+  // a committed pop shrinks it
+  ASSERT_TRUE(this->m_db->batch_start());
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  this->m_db->batch_stop();
+  ASSERT_EQ(std::vector<uint64_t>{expected[0]}, this->m_db->get_block_cumulative_rct_outputs_range(0, 1));
+  ASSERT_THROW(this->m_db->get_block_cumulative_rct_outputs_range(0, 2), BLOCK_DNE);
+
+  // and a committed add grows it back
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+  ASSERT_EQ(expected, this->m_db->get_block_cumulative_rct_outputs_range(0, 2));
+}
+
+TYPED_TEST(BlockchainDBTest, OutputPubkeyIndex)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_FALSE(this->m_db->has_output_pubkey_index());
+  ASSERT_TRUE(this->m_db->build_output_pubkey_index());
+  ASSERT_TRUE(this->m_db->has_output_pubkey_index());
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  crypto::public_key pk0, pk1;
+  ASSERT_TRUE(get_output_public_key(this->m_blocks[0].first.miner_tx.vout[0], pk0));
+  ASSERT_TRUE(get_output_public_key(this->m_blocks[1].first.miner_tx.vout[0], pk1));
+
+  uint64_t amount, amount_index;
+  ASSERT_TRUE(this->m_db->get_output_index_by_pubkey(pk1, amount, amount_index));
+  ASSERT_EQ(this->m_blocks[1].first.miner_tx.vout[0].amount, amount);
+  ASSERT_EQ(pk1, this->m_db->get_output_key(amount, amount_index, false).pubkey);
+
+  {
+    // pop_block runs its own write txn
+    block b;
+    std::vector<transaction> txs;
+    ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  }
+
+  ASSERT_FALSE(this->m_db->get_output_index_by_pubkey(pk1, amount, amount_index));
+  ASSERT_TRUE(this->m_db->get_output_index_by_pubkey(pk0, amount, amount_index));
+  ASSERT_EQ(pk0, this->m_db->get_output_key(amount, amount_index, false).pubkey);
+}
+
+TYPED_TEST(BlockchainDBTest, ViewTagIndex)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_FALSE(this->m_db->has_view_tag_index());
+  ASSERT_TRUE(this->m_db->build_view_tag_index());
+  ASSERT_TRUE(this->m_db->has_view_tag_index());
+
+  // only blocks from the view tag fork on get an entry
+  std::pair<block, blobdata> blk1 = this->m_blocks[1];
+  blk1.first.major_version = HF_VERSION_VIEW_TAGS;
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(blk1, t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  std::vector<blobdata> blobs;
+  ASSERT_NO_THROW(this->m_db->get_blocks_view_tags(0, 5, blobs));
+  ASSERT_EQ(2, blobs.size());
+  ASSERT_TRUE(blobs[0].empty());
+  ASSERT_FALSE(blobs[1].empty());
+
+  block_view_tags tags;
+  ASSERT_TRUE(t_serializable_object_from_blob(tags, blobs[1]));
+  ASSERT_EQ(1 + this->m_txs[1].size(), tags.txes.size());
+  ASSERT_EQ(get_transaction_hash(blk1.first.miner_tx), tags.txes[0].tx_hash);
+  ASSERT_EQ(1, tags.txes[0].tx_pub_keys.size());
+  ASSERT_EQ(get_tx_pub_key_from_extra(blk1.first.miner_tx), tags.txes[0].tx_pub_keys[0]);
+
+  {
+    // pop_block runs its own write txn
+    block b;
+    std::vector<transaction> txs;
+    ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  }
+
+  ASSERT_NO_THROW(this->m_db->get_blocks_view_tags(0, 5, blobs));
+  ASSERT_EQ(1, blobs.size());
+  ASSERT_TRUE(blobs[0].empty());
+}
+
+TYPED_TEST(BlockchainDBTest, CompressedPrunableData)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // the first block goes in before compression is enabled, so it gets converted on reopen
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+  this->m_db->close();
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_COMPRESS_PRUNABLE));
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  for (size_t i = 0; i < 2; ++i)
+  {
+    for (const auto &tx: this->m_txs[i])
+    {
+      const crypto::hash h = get_transaction_hash(tx.first);
+      cryptonote::blobdata bd, pruned, prunable;
+      ASSERT_TRUE(this->m_db->get_tx_blob(h, bd));
+      ASSERT_EQ(tx.second, bd);
+      ASSERT_TRUE(this->m_db->get_pruned_tx_blob(h, pruned));
+      ASSERT_TRUE(this->m_db->get_prunable_tx_blob(h, prunable));
+      ASSERT_EQ(tx.second, pruned + prunable);
+    }
+  }
+}
+
+TYPED_TEST(BlockchainDBTest, TableStats)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+
+  ASSERT_TRUE(this->m_db->tx_exists(get_transaction_hash(this->m_blocks[0].first.miner_tx)));
+  ASSERT_FALSE(this->m_db->has_key_image(crypto::key_image{}));
+
+  db_stats stats;
+  ASSERT_TRUE(this->m_db->get_db_stats(stats));
+  ASSERT_GT(stats.page_size, 0);
+  ASSERT_GT(stats.last_page, 0);
+
+  auto find_table = [&stats](const char *name) {
+    return std::find_if(stats.tables.begin(), stats.tables.end(), [name](const db_table_stats &t) { return t.name == name; });
+  };
+  const auto tx_indices = find_table("tx_indices");
+  ASSERT_NE(stats.tables.end(), tx_indices);
+  ASSERT_EQ(1 + this->m_txs[0].size(), tx_indices->entries);
+  ASSERT_EQ(1 + this->m_txs[0].size(), tx_indices->puts);
+  ASSERT_GE(tx_indices->gets, 1);
+
+  const auto spent_keys = find_table("spent_keys");
+  ASSERT_NE(stats.tables.end(), spent_keys);
+  ASSERT_GE(spent_keys->gets, 1);
+  ASSERT_GE(spent_keys->misses, 1);
+  uint64_t histogram_total = 0;
+  for (uint64_t n: spent_keys->get_latency_histogram)
+    histogram_total += n;
+  ASSERT_EQ(spent_keys->gets, histogram_total);
+}
+
+TYPED_TEST(BlockchainDBTest, KeyImageFilter)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_KEY_IMAGE_FILTER));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  }
+  this->m_db->close();
+
+  // the first block's key images come from the table, the second's are added live
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_KEY_IMAGE_FILTER));
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  std::vector<crypto::key_image> key_images;
+  for (size_t i = 0; i < 2; ++i)
+    for (const auto &tx: this->m_txs[i])
+      for (const auto &in: tx.first.vin)
+        if (in.type() == typeid(txin_to_key))
+          key_images.push_back(boost::get<txin_to_key>(in).k_image);
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+
+  key_images.push_back(crypto::key_image{});
+  std::vector<bool> spent;
+  this->m_db->have_key_images_batch(epee::to_span(key_images), spent);
+  ASSERT_EQ(key_images.size(), spent.size());
+  for (size_t i = 0; i + 1 < spent.size(); ++i)
+    ASSERT_TRUE(spent[i]);
+  ASSERT_FALSE(spent.back());
+  ASSERT_FALSE(this->m_db->has_key_image(crypto::key_image{}));
+}
+
+TYPED_TEST(BlockchainDBTest, TxIndexCacheInvalidatedOnPop)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // twice, so the second lookup is served from the cache
+  const crypto::hash h = get_transaction_hash(this->m_blocks[1].first.miner_tx);
+  uint64_t tx_id;
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_TRUE(this->m_db->tx_exists(h, tx_id));
+    ASSERT_EQ(1, this->m_db->get_tx_block_height(h));
+  }
+
+  {
+    // pop_block runs its own write txn
+    block b;
+    std::vector<transaction> txs;
+    ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  }
+
+  ASSERT_FALSE(this->m_db->tx_exists(h));
+  ASSERT_THROW(this->m_db->get_tx_block_height(h), TX_DNE);
+  ASSERT_TRUE(this->m_db->tx_exists(get_transaction_hash(this->m_blocks[0].first.miner_tx)));
+}
+
+TYPED_TEST(BlockchainDBTest, ReadAhead)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_READ_AHEAD));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // sequential reads schedule read-ahead jobs, which must not change what is read
+  for (int pass = 0; pass < 3; ++pass)
+  {
+    for (uint64_t h = 0; h < 2; ++h)
+      ASSERT_EQ(this->m_blocks[h].second, this->m_db->get_block_blob_from_height(h));
+
+    std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata>>>> blocks;
+    ASSERT_TRUE(this->m_db->get_blocks_from(0, 1, 2, 100, 1 << 20, blocks, false, true, false));
+    ASSERT_EQ(2u, blocks.size());
+    for (size_t h = 0; h < 2; ++h)
+    {
+      ASSERT_EQ(this->m_blocks[h].second, blocks[h].first.first);
+      ASSERT_EQ(this->m_txs[h].size(), blocks[h].second.size());
+      for (size_t i = 0; i < this->m_txs[h].size(); ++i)
+        ASSERT_EQ(this->m_txs[h][i].second, blocks[h].second[i].second);
+    }
+  }
+
+  // stops the read-ahead thread before the env goes away
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+TYPED_TEST(BlockchainDBTest, ParallelScans)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  std::mutex lock;
+  std::vector<crypto::key_image> serial_kis, parallel_kis;
+  ASSERT_TRUE(this->m_db->for_all_key_images([&](const crypto::key_image &ki) { serial_kis.push_back(ki); return true; }));
+  ASSERT_TRUE(this->m_db->for_all_key_images_parallel([&](const crypto::key_image &ki) { std::lock_guard<std::mutex> l(lock); parallel_kis.push_back(ki); return true; }));
+  std::sort(serial_kis.begin(), serial_kis.end());
+  std::sort(parallel_kis.begin(), parallel_kis.end());
+  ASSERT_FALSE(serial_kis.empty());
+  ASSERT_EQ(serial_kis, parallel_kis);
+
+  std::vector<std::string> serial_txs, parallel_txs;
+  ASSERT_TRUE(this->m_db->for_all_transactions([&](const crypto::hash &h, const transaction&) { serial_txs.push_back(epee::string_tools::pod_to_hex(h)); return true; }, true));
+  ASSERT_TRUE(this->m_db->for_all_transactions_parallel([&](const crypto::hash &h, const transaction&) { std::lock_guard<std::mutex> l(lock); parallel_txs.push_back(epee::string_tools::pod_to_hex(h)); return true; }, false));
+  std::sort(serial_txs.begin(), serial_txs.end());
+  std::sort(parallel_txs.begin(), parallel_txs.end());
+  ASSERT_EQ(serial_txs, parallel_txs);
+
+  std::vector<std::pair<std::string, size_t>> serial_outs, parallel_outs;
+  ASSERT_TRUE(this->m_db->for_all_outputs([&](uint64_t, const crypto::hash &h, uint64_t, size_t idx) { serial_outs.push_back({epee::string_tools::pod_to_hex(h), idx}); return true; }));
+  ASSERT_TRUE(this->m_db->for_all_outputs_parallel([&](uint64_t, const crypto::hash &h, uint64_t, size_t idx) { std::lock_guard<std::mutex> l(lock); parallel_outs.push_back({epee::string_tools::pod_to_hex(h), idx}); return true; }));
+  std::sort(serial_outs.begin(), serial_outs.end());
+  std::sort(parallel_outs.begin(), parallel_outs.end());
+  ASSERT_FALSE(serial_outs.empty());
+  ASSERT_EQ(serial_outs, parallel_outs);
+
+  std::vector<uint64_t> heights;
+  ASSERT_TRUE(this->m_db->for_blocks_range_parallel(0, 1, [&](uint64_t height, const crypto::hash&, const block&) { std::lock_guard<std::mutex> l(lock); heights.push_back(height); return true; }));
+  std::sort(heights.begin(), heights.end());
+  ASSERT_EQ(std::vector<uint64_t>({0, 1}), heights);
+
+  // stopping early is reported whichever range hits it
+  ASSERT_FALSE(this->m_db->for_all_transactions_parallel([&](const crypto::hash&, const transaction&) { return false; }, true));
+}
+
 }  // anonymous namespace
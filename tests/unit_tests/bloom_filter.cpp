@@ -0,0 +1,79 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "common/bloom_filter.h"
+#include "crypto/crypto.h"
+
+TEST(bloom_filter, empty_may_contain_anything)
+{
+  tools::bloom_filter filter;
+  ASSERT_TRUE(filter.empty());
+  ASSERT_TRUE(filter.may_contain(42));
+}
+
+TEST(bloom_filter, no_false_negatives)
+{
+  tools::bloom_filter filter;
+  filter.reset(1000);
+  ASSERT_FALSE(filter.empty());
+  std::vector<uint64_t> added(1000);
+  for (auto &h: added)
+  {
+    h = crypto::rand<uint64_t>();
+    filter.add(h);
+  }
+  ASSERT_EQ(1000, filter.count());
+  for (const auto h: added)
+    ASSERT_TRUE(filter.may_contain(h));
+}
+
+TEST(bloom_filter, false_positive_rate)
+{
+  tools::bloom_filter filter;
+  filter.reset(10000);
+  for (int i = 0; i < 10000; ++i)
+    filter.add(crypto::rand<uint64_t>());
+  size_t positives = 0;
+  for (int i = 0; i < 100000; ++i)
+    positives += filter.may_contain(crypto::rand<uint64_t>());
+  // about 1% at 10 bits per element, less here as the size is rounded up
+  ASSERT_LT(positives, 2000);
+}
+
+TEST(bloom_filter, reset_empties)
+{
+  tools::bloom_filter filter;
+  filter.reset(100);
+  const uint64_t h = crypto::rand<uint64_t>();
+  filter.add(h);
+  filter.reset(100);
+  ASSERT_EQ(0, filter.count());
+  ASSERT_FALSE(filter.may_contain(h));
+}
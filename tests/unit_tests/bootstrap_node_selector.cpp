@@ -171,3 +171,54 @@ TEST_F(bootstrap_node_selector, selector_auto_max_nodes)
 
   EXPECT_EQ(unique_nodes.size(), max_nodes);
 }
+
+TEST_F(bootstrap_node_selector, selector_auto_latency)
+{
+  cryptonote::bootstrap_node::selector_auto selector([this]() {
+    return nodes;
+  });
+
+  const auto current = selector.next_node();
+  EXPECT_EQ(std::chrono::milliseconds{}, selector.latency(current->address));
+
+  selector.handle_latency(current->address, std::chrono::milliseconds{100});
+  EXPECT_EQ(std::chrono::milliseconds{100}, selector.latency(current->address));
+
+  selector.handle_latency(current->address, std::chrono::milliseconds{200});
+  EXPECT_EQ(std::chrono::milliseconds{125}, selector.latency(current->address));
+
+  selector.handle_latency("unknown:18081", std::chrono::milliseconds{100});
+  EXPECT_EQ(std::chrono::milliseconds{}, selector.latency("unknown:18081"));
+}
+
+TEST_F(bootstrap_node_selector, selector_auto_next_nodes)
+{
+  cryptonote::bootstrap_node::selector_auto selector([this]() {
+    return nodes;
+  });
+
+  EXPECT_TRUE(selector.next_nodes(0).empty());
+
+  // only nodes with the fewest fails are candidates
+  const auto candidates = selector.next_nodes(nodes.size());
+  ASSERT_EQ(white_nodes.size(), candidates.size());
+  EXPECT_NE(candidates[0].address, candidates[1].address);
+  for (const auto &candidate : candidates)
+  {
+    EXPECT_TRUE(white_nodes.count(candidate.address) > 0);
+  }
+
+  selector.handle_latency("white_node_1:18089", std::chrono::milliseconds{10});
+  selector.handle_latency("white_node_2:18081", std::chrono::milliseconds{1000});
+
+  // the slow node only wins when both random picks land on it
+  size_t fast = 0;
+  for (size_t i = 0; i < 400; ++i)
+  {
+    if (selector.next_node()->address == "white_node_1:18089")
+    {
+      ++fast;
+    }
+  }
+  EXPECT_GT(fast, 200u);
+}
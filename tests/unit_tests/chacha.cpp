@@ -28,6 +28,8 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 #include "gtest/gtest.h"
@@ -108,3 +110,47 @@ TEST_CHACHA8(0)
 TEST_CHACHA8(1)
 TEST_CHACHA8(2)
 TEST_CHACHA8(3)
+
+TEST(chacha20, multi_block)
+{
+  // more than one lane batch, then whole and partial blocks
+  std::string plain_text(4099, '\0');
+  for (size_t n = 0; n < plain_text.size(); ++n)
+    plain_text[n] = n * 7 + 3;
+  std::string buf(plain_text.size(), '\0');
+  crypto::chacha20(plain_text.data(), plain_text.size(), test_key_1, test_iv_1, &buf[0]);
+
+  static const uint8_t expected[] = {
+    0xb6, 0xd2, 0xb9, 0x8a, 0xf9, 0xb5, 0x76, 0x60, 0x83, 0x73, 0x51, 0x3a, 0xed, 0x18, 0x70, 0x41,
+    0xa1, 0xcc, 0x1c, 0x16, 0xd2, 0x88, 0x46, 0x71, 0xf2, 0x53, 0xce, 0x54, 0x99, 0x91, 0xa2, 0xe4
+  };
+  crypto::hash h;
+  crypto::cn_fast_hash(buf.data(), buf.size(), h);
+  ASSERT_EQ(memcmp(&h, expected, sizeof(expected)), 0);
+
+  // in place
+  crypto::chacha20(buf.data(), buf.size(), test_key_1, test_iv_1, &buf[0]);
+  ASSERT_EQ(buf, plain_text);
+}
+
+TEST(chacha20, stream)
+{
+  std::string plain_text(3000, '\0');
+  for (size_t n = 0; n < plain_text.size(); ++n)
+    plain_text[n] = n * 13 + 1;
+  std::string expected(plain_text.size(), '\0');
+  crypto::chacha20(plain_text.data(), plain_text.size(), test_key_1, test_iv_1, &expected[0]);
+
+  for (size_t chunk: {size_t(1), size_t(7), size_t(64), size_t(100), size_t(513)})
+  {
+    crypto::chacha_state state;
+    crypto::chacha20_init(&state, test_key_1, test_iv_1);
+    std::string buf(plain_text.size(), '\0');
+    for (size_t offset = 0; offset < plain_text.size(); offset += chunk)
+    {
+      const size_t length = std::min(chunk, plain_text.size() - offset);
+      crypto::chacha_update(&state, plain_text.data() + offset, length, &buf[offset]);
+    }
+    ASSERT_EQ(buf, expected);
+  }
+}
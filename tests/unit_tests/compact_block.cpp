@@ -0,0 +1,91 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/compact_block.h"
+
+TEST(compact_block, pack_unpack)
+{
+  const std::vector<uint64_t> short_ids = {0, 1, 0xffffffffffff, 0x123456789abc};
+  const std::string blob = cryptonote::pack_short_tx_ids(short_ids);
+  ASSERT_EQ(blob.size(), short_ids.size() * COMPACT_BLOCK_SHORT_TX_ID_SIZE);
+  std::vector<uint64_t> unpacked;
+  ASSERT_TRUE(cryptonote::unpack_short_tx_ids(blob, unpacked));
+  ASSERT_EQ(unpacked, short_ids);
+
+  ASSERT_FALSE(cryptonote::unpack_short_tx_ids(blob + "x", unpacked));
+  ASSERT_TRUE(cryptonote::unpack_short_tx_ids("", unpacked));
+  ASSERT_TRUE(unpacked.empty());
+}
+
+TEST(compact_block, short_ids)
+{
+  std::vector<crypto::hash> txids(17);
+  for (auto &txid: txids)
+    txid = crypto::rand<crypto::hash>();
+
+  const std::vector<uint64_t> short_ids = cryptonote::get_short_tx_ids(42, txids);
+  ASSERT_EQ(short_ids.size(), txids.size());
+  for (size_t i = 0; i < txids.size(); ++i)
+  {
+    ASSERT_EQ(short_ids[i], cryptonote::get_short_tx_id(42, txids[i]));
+    ASSERT_LT(short_ids[i], uint64_t(1) << (8 * COMPACT_BLOCK_SHORT_TX_ID_SIZE));
+  }
+
+  // the salt changes the ids
+  ASSERT_NE(cryptonote::get_short_tx_id(42, txids[0]), cryptonote::get_short_tx_id(43, txids[0]));
+}
+
+TEST(compact_block, match)
+{
+  std::vector<crypto::hash> pool(20);
+  for (auto &txid: pool)
+    txid = crypto::rand<crypto::hash>();
+
+  // a block with five pool txes, one tx we do not have and one prefilled tx
+  const std::vector<crypto::hash> block_txids = {pool[3], pool[0], crypto::rand<crypto::hash>(), pool[19], pool[7], crypto::rand<crypto::hash>(), pool[12]};
+  const std::vector<uint64_t> short_ids = cryptonote::get_short_tx_ids(7, block_txids);
+  std::vector<crypto::hash> tx_hashes(block_txids.size(), crypto::null_hash);
+  tx_hashes[5] = block_txids[5];
+
+  ASSERT_EQ(cryptonote::match_short_tx_ids(7, short_ids, pool, tx_hashes), 1);
+  for (size_t i = 0; i < block_txids.size(); ++i)
+    ASSERT_EQ(tx_hashes[i], i == 2 ? crypto::null_hash : block_txids[i]);
+
+  // a wrong salt matches nothing
+  std::vector<crypto::hash> unmatched;
+  ASSERT_EQ(cryptonote::match_short_tx_ids(8, short_ids, pool, unmatched), block_txids.size());
+
+  // the same txid twice in the candidates is not a collision
+  pool.push_back(pool[0]);
+  tx_hashes.clear();
+  ASSERT_EQ(cryptonote::match_short_tx_ids(7, short_ids, pool, tx_hashes), 2);
+  ASSERT_EQ(tx_hashes[1], pool[0]);
+}
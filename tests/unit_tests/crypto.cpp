@@ -31,9 +31,17 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/merge_mining.h"
+#include "string_tools.h"
+
+extern "C"
+{
+#include "crypto/crypto-ops.h"
+}
 
 namespace
 {
@@ -312,3 +320,214 @@ TEST(Crypto, tree_branch)
     }
   }
 }
+
+TEST(Crypto, mm_block_template)
+{
+  for (uint8_t tx_version = 1; tx_version <= 2; ++tx_version)
+  {
+    cryptonote::block b;
+    b.major_version = b.minor_version = 16;
+    b.timestamp = 1700000000;
+    b.prev_id = crypto::rand<crypto::hash>();
+    b.nonce = 42;
+    b.miner_tx.version = tx_version;
+    b.miner_tx.unlock_time = 60;
+    b.miner_tx.vin.push_back(cryptonote::txin_gen{1000});
+    b.miner_tx.vout.push_back(cryptonote::tx_out{600000000000, cryptonote::txout_to_key{crypto::rand<crypto::public_key>()}});
+    ASSERT_TRUE(cryptonote::add_tx_pub_key_to_extra(b.miner_tx, crypto::rand<crypto::public_key>()));
+    b.miner_tx.rct_signatures.type = rct::RCTTypeNull;
+
+    for (size_t n_txes: {0, 1, 2, 5})
+    {
+      b.tx_hashes.clear();
+      for (size_t i = 0; i < n_txes; ++i)
+        b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+
+      cryptonote::mm_block_template t;
+      ASSERT_TRUE(cryptonote::make_mm_block_template(b, 0, t));
+
+      // patched blobs match reserializing the whole block, repeatedly
+      for (int i = 0; i < 3; ++i)
+      {
+        const crypto::hash root = crypto::rand<crypto::hash>();
+        ASSERT_TRUE(cryptonote::set_mm_merkle_root(t, root));
+
+        cryptonote::block expected = b;
+        ASSERT_TRUE(cryptonote::add_mm_merkle_root_to_tx_extra(expected.miner_tx.extra, root, 0));
+        expected.invalidate_hashes();
+        expected.miner_tx.invalidate_hashes();
+        ASSERT_EQ(t.block_blob, cryptonote::t_serializable_object_to_blob(expected));
+        ASSERT_EQ(t.hashing_blob, cryptonote::get_block_hashing_blob(expected));
+      }
+    }
+  }
+}
+
+TEST(Crypto, tx_tree_hash_coinbase_change)
+{
+  cryptonote::block b;
+  b.miner_tx.version = 2;
+  b.miner_tx.vin.push_back(cryptonote::txin_gen{1000});
+  b.miner_tx.vout.push_back(cryptonote::tx_out{600000000000, cryptonote::txout_to_key{crypto::rand<crypto::public_key>()}});
+  b.miner_tx.rct_signatures.type = rct::RCTTypeNull;
+
+  for (size_t n_txes: {16, 17, 31, 64, 100})
+  {
+    b.tx_hashes.clear();
+    for (size_t i = 0; i < n_txes; ++i)
+      b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+
+    // the first calls fill the cache, the later ones only rehash the coinbase branch
+    for (int i = 0; i < 4; ++i)
+    {
+      b.miner_tx.extra.clear();
+      ASSERT_TRUE(cryptonote::add_tx_pub_key_to_extra(b.miner_tx, crypto::rand<crypto::public_key>()));
+      b.miner_tx.invalidate_hashes();
+
+      std::vector<crypto::hash> hashes;
+      hashes.push_back(cryptonote::get_transaction_hash(b.miner_tx));
+      hashes.insert(hashes.end(), b.tx_hashes.begin(), b.tx_hashes.end());
+      crypto::hash expected;
+      crypto::tree_hash(hashes.data(), hashes.size(), expected);
+      ASSERT_EQ(cryptonote::get_tx_tree_hash(b), expected);
+    }
+  }
+}
+
+TEST(Crypto, field_inversion)
+{
+  static const unsigned char one[32] = {1};
+  for (int n = 0; n < 256; ++n)
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+
+    // decoding takes a square root and encoding an inversion
+    ge_p3 point;
+    ASSERT_EQ(ge_frombytes_vartime(&point, (const unsigned char*)pkey.data), 0);
+    crypto::public_key pkey2;
+    ge_p3_tobytes((unsigned char*)pkey2.data, &point);
+    ASSERT_EQ(pkey, pkey2);
+
+    fe inv, prod;
+    unsigned char bytes[32];
+    fe_invert(inv, point.Y);
+    fe_mul(prod, inv, point.Y);
+    fe_tobytes(bytes, prod);
+    ASSERT_EQ(memcmp(bytes, one, 32), 0);
+  }
+}
+
+TEST(Crypto, group_ops_vectors)
+{
+  unsigned char a[32], b[32], c[32], out[32];
+  for (int i = 0; i < 32; ++i)
+  {
+    a[i] = i;
+    b[i] = 0x80 + i;
+    c[i] = 0xff - i;
+  }
+  sc_reduce32(a);
+  sc_reduce32(b);
+  sc_reduce32(c);
+  const auto hex = [](const unsigned char *data) { return epee::string_tools::buff_to_hex_nodelimer(std::string((const char*)data, 32)); };
+
+  ge_p3 A;
+  ge_scalarmult_base(&A, c);
+  ge_p3_tobytes(out, &A);
+  ASSERT_EQ(hex(out), "69330441bed8a878a73f8f70f955a6799530b167f2d80a3afe9fe8bc94b0b3e6");
+
+  ge_p3 A2;
+  ASSERT_EQ(ge_frombytes_vartime(&A2, out), 0);
+  ge_p2 r;
+  ge_double_scalarmult_base_vartime(&r, a, &A2, b);
+  ge_tobytes(out, &r);
+  ASSERT_EQ(hex(out), "74a34201506fd0cab839e3846f859c455c35131f4c971460ddedd696a2c460f4");
+
+  ge_scalarmult(&r, a, &A2);
+  ge_tobytes(out, &r);
+  ASSERT_EQ(hex(out), "30b5180b4d07d9b4ba9abe5c45b1443d0c1ff3ba9cefc2b2c658cdc6e74390f1");
+}
+
+TEST(Crypto, ge_p3_batch_tobytes)
+{
+  // more than one internal chunk, and a partial one
+  std::vector<ge_p3> points(150);
+  std::vector<crypto::public_key> expected(points.size()), batch(points.size());
+  for (size_t n = 0; n < points.size(); ++n)
+  {
+    crypto::secret_key skey;
+    crypto::generate_keys(expected[n], skey);
+    ge_p1p1 p1;
+    ge_p3 p3;
+    ge_cached cached;
+    ASSERT_EQ(ge_frombytes_vartime(&p3, (const unsigned char*)expected[n].data), 0);
+    // double to get a Z other than 1
+    ge_p3_to_cached(&cached, &p3);
+    ge_add(&p1, &p3, &cached);
+    ge_p1p1_to_p3(&points[n], &p1);
+    ge_p3_tobytes((unsigned char*)expected[n].data, &points[n]);
+  }
+
+  for (size_t count: {size_t(1), size_t(63), size_t(64), size_t(65), points.size()})
+  {
+    ge_p3_batch_tobytes((unsigned char*)batch.data(), points.data(), count);
+    for (size_t n = 0; n < count; ++n)
+      ASSERT_EQ(batch[n], expected[n]);
+  }
+}
+
+TEST(Crypto, check_signatures)
+{
+  const crypto::hash prefix_hash = crypto::cn_fast_hash("check_signatures", 16);
+  std::vector<crypto::public_key> pubs(10);
+  std::vector<crypto::signature> sigs(pubs.size());
+  for (size_t n = 0; n < pubs.size(); ++n)
+  {
+    crypto::secret_key skey;
+    crypto::generate_keys(pubs[n], skey);
+    crypto::generate_signature(prefix_hash, pubs[n], skey, sigs[n]);
+  }
+
+  ASSERT_TRUE(crypto::check_signatures(prefix_hash, pubs.data(), sigs.data(), 0));
+  ASSERT_TRUE(crypto::check_signatures(prefix_hash, pubs.data(), sigs.data(), 1));
+  ASSERT_TRUE(crypto::check_signatures(prefix_hash, pubs.data(), sigs.data(), pubs.size()));
+
+  std::swap(sigs[3], sigs[4]);
+  ASSERT_FALSE(crypto::check_signatures(prefix_hash, pubs.data(), sigs.data(), pubs.size()));
+  ASSERT_TRUE(crypto::check_signatures(prefix_hash, pubs.data(), sigs.data(), 3));
+  std::swap(sigs[3], sigs[4]);
+
+  const crypto::hash other_hash = crypto::cn_fast_hash("check_signature", 15);
+  ASSERT_FALSE(crypto::check_signatures(other_hash, pubs.data(), sigs.data(), pubs.size()));
+}
+
+TEST(Crypto, ring_signature)
+{
+  const crypto::hash prefix_hash = crypto::cn_fast_hash("ring_signature", 14);
+  for (size_t ring_size: {size_t(1), size_t(2), size_t(11)})
+  {
+    std::vector<crypto::public_key> pubs(ring_size);
+    std::vector<const crypto::public_key*> ring(ring_size);
+    crypto::secret_key real_skey;
+    const size_t real = ring_size / 2;
+    for (size_t n = 0; n < ring_size; ++n)
+    {
+      crypto::secret_key skey;
+      crypto::generate_keys(pubs[n], skey);
+      if (n == real)
+        real_skey = skey;
+      ring[n] = &pubs[n];
+    }
+    crypto::key_image image;
+    crypto::generate_key_image(pubs[real], real_skey, image);
+
+    std::vector<crypto::signature> sigs(ring_size);
+    crypto::generate_ring_signature(prefix_hash, image, ring, real_skey, real, sigs.data());
+    ASSERT_TRUE(crypto::check_ring_signature(prefix_hash, image, ring, sigs.data()));
+
+    sigs[0].r.data[0] ^= 1;
+    ASSERT_FALSE(crypto::check_ring_signature(prefix_hash, image, ring, sigs.data()));
+  }
+}
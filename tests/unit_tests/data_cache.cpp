@@ -0,0 +1,114 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "common/data_cache.h"
+
+TEST(data_cache, add_has)
+{
+  tools::data_cache<int, 4> cache;
+  ASSERT_FALSE(cache.has(1));
+  cache.add(1);
+  ASSERT_TRUE(cache.has(1));
+  ASSERT_FALSE(cache.has(2));
+}
+
+TEST(data_cache, evicts_oldest)
+{
+  tools::data_cache<int, 4> cache;
+  for (int i = 1; i <= 5; ++i)
+    cache.add(i);
+  ASSERT_FALSE(cache.has(1));
+  for (int i = 2; i <= 5; ++i)
+    ASSERT_TRUE(cache.has(i));
+}
+
+TEST(sharded_data_cache, counts_hits_and_misses)
+{
+  tools::sharded_data_cache<int, 64, 4> cache;
+  for (int i = 0; i < 16; ++i)
+    cache.add(i);
+  for (int i = 0; i < 16; ++i)
+    ASSERT_TRUE(cache.has(i));
+  for (int i = 16; i < 20; ++i)
+    ASSERT_FALSE(cache.has(i));
+  ASSERT_EQ(cache.get_hits(), 16);
+  ASSERT_EQ(cache.get_misses(), 4);
+}
+
+TEST(lru_cache, evicts_least_recently_used)
+{
+  tools::lru_cache<int, int> cache(2);
+  int v;
+  cache.add(1, 10);
+  cache.add(2, 20);
+  ASSERT_TRUE(cache.get(1, v));
+  ASSERT_EQ(10, v);
+  cache.add(3, 30);
+  ASSERT_FALSE(cache.get(2, v));
+  ASSERT_TRUE(cache.get(1, v));
+  ASSERT_TRUE(cache.get(3, v));
+  ASSERT_EQ(30, v);
+  ASSERT_EQ(2, cache.size());
+}
+
+TEST(lru_cache, add_updates_and_remove_erases)
+{
+  tools::lru_cache<int, int> cache(4);
+  int v;
+  cache.add(1, 10);
+  cache.add(1, 11);
+  ASSERT_EQ(1, cache.size());
+  ASSERT_TRUE(cache.get(1, v));
+  ASSERT_EQ(11, v);
+  ASSERT_FALSE(cache.add_if(2, 20, []() { return false; }));
+  ASSERT_FALSE(cache.get(2, v));
+  cache.remove(1);
+  ASSERT_FALSE(cache.get(1, v));
+  ASSERT_EQ(0, cache.size());
+}
+
+TEST(sharded_lru_cache, counts_hits_and_misses)
+{
+  tools::sharded_lru_cache<int, int, 4> cache(64);
+  int v;
+  for (int i = 0; i < 16; ++i)
+    cache.add(i, i * 2);
+  for (int i = 0; i < 16; ++i)
+  {
+    ASSERT_TRUE(cache.get(i, v));
+    ASSERT_EQ(i * 2, v);
+  }
+  for (int i = 16; i < 20; ++i)
+    ASSERT_FALSE(cache.get(i, v));
+  ASSERT_EQ(cache.get_hits(), 16);
+  ASSERT_EQ(cache.get_misses(), 4);
+  cache.clear();
+  ASSERT_EQ(0, cache.size());
+}
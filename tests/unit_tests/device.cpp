@@ -30,6 +30,8 @@
 #include "gtest/gtest.h"
 #include "ringct/rctOps.h"
 #include "device/device_default.hpp"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/subaddress_index.h"
 
 TEST(device, name)
 {
@@ -129,3 +131,87 @@ TEST(device, ecdh32)
   ASSERT_EQ(tuple2.amount, tuple.amount);
 }
 
+
+TEST(device, subaddress_spend_public_keys)
+{
+  hw::core::device_default dev;
+  cryptonote::account_base account;
+  account.generate();
+  const cryptonote::account_keys &keys = account.get_keys();
+
+  // crosses the batch encoding chunk size, and includes the main address
+  for (uint32_t major: {0, 1})
+  {
+    const std::vector<crypto::public_key> pkeys = dev.get_subaddress_spend_public_keys(keys, major, 0, 150);
+    ASSERT_EQ(pkeys.size(), 150);
+    cryptonote::subaddress_index index;
+    index.major = major;
+    for (index.minor = 0; index.minor < 150; ++index.minor)
+      ASSERT_EQ(pkeys[index.minor], dev.get_subaddress_spend_public_key(keys, index));
+  }
+  ASSERT_EQ(dev.get_subaddress_spend_public_keys(keys, 0, 0, 1)[0], keys.m_account_address.m_spend_public_key);
+
+  const std::vector<crypto::public_key> pkeys = dev.get_subaddress_spend_public_keys(keys, 2, 70, 75);
+  ASSERT_EQ(pkeys.size(), 5);
+  cryptonote::subaddress_index index;
+  index.major = 2;
+  for (index.minor = 70; index.minor < 75; ++index.minor)
+    ASSERT_EQ(pkeys[index.minor - 70], dev.get_subaddress_spend_public_key(keys, index));
+  ASSERT_TRUE(dev.get_subaddress_spend_public_keys(keys, 2, 10, 10).empty());
+}
+
+TEST(device, batched_derivations)
+{
+  hw::core::device_default dev;
+  cryptonote::account_base account;
+  account.generate();
+  const cryptonote::account_keys &keys = account.get_keys();
+
+  // crosses the batch encoding chunk size
+  static const size_t N = 150;
+  std::vector<crypto::public_key> pubs(N);
+  std::vector<crypto::secret_key> secs(N);
+  std::vector<size_t> indices(N);
+  for (size_t i = 0; i < N; ++i)
+  {
+    crypto::generate_keys(pubs[i], secs[i]);
+    indices[i] = i * 7;
+  }
+
+  std::vector<crypto::key_derivation> derivations(N);
+  ASSERT_TRUE(dev.generate_key_derivations(epee::to_span(pubs), keys.m_view_secret_key, epee::to_mut_span(derivations)));
+  for (size_t i = 0; i < N; ++i)
+  {
+    crypto::key_derivation derivation;
+    ASSERT_TRUE(dev.generate_key_derivation(pubs[i], keys.m_view_secret_key, derivation));
+    ASSERT_FALSE(memcmp(&derivations[i], &derivation, sizeof(derivation)));
+  }
+
+  std::vector<crypto::public_key> derived_pubs(N);
+  ASSERT_TRUE(dev.derive_public_keys(epee::to_span(derivations), epee::to_span(indices), epee::to_span(pubs), epee::to_mut_span(derived_pubs)));
+  for (size_t i = 0; i < N; ++i)
+  {
+    crypto::public_key derived_pub;
+    ASSERT_TRUE(dev.derive_public_key(derivations[i], indices[i], pubs[i], derived_pub));
+    ASSERT_EQ(derived_pubs[i], derived_pub);
+  }
+
+  std::vector<crypto::key_image> images(N);
+  ASSERT_TRUE(dev.generate_key_images(epee::to_span(pubs), epee::to_span(secs), epee::to_mut_span(images)));
+  for (size_t i = 0; i < N; ++i)
+  {
+    crypto::key_image image;
+    ASSERT_TRUE(dev.generate_key_image(pubs[i], secs[i], image));
+    ASSERT_EQ(images[i], image);
+  }
+
+  // an invalid point fails the whole batch, and mismatched sizes are rejected
+  crypto::public_key invalid;
+  memset(&invalid, 0xff, sizeof(invalid));
+  pubs[N / 2] = invalid;
+  ASSERT_FALSE(dev.generate_key_derivations(epee::to_span(pubs), keys.m_view_secret_key, epee::to_mut_span(derivations)));
+  ASSERT_FALSE(dev.derive_public_keys(epee::to_span(derivations), epee::to_span(indices), epee::to_span(pubs), epee::to_mut_span(derived_pubs)));
+  derivations.pop_back();
+  ASSERT_FALSE(dev.generate_key_derivations(epee::to_span(pubs), keys.m_view_secret_key, epee::to_mut_span(derivations)));
+  ASSERT_TRUE(dev.generate_key_derivations({}, keys.m_view_secret_key, {}));
+}
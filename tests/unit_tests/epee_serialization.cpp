@@ -30,9 +30,51 @@
 #include <cstdint>
 #include <gtest/gtest.h>
 
+#include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_bin_writer.h"
+#include "storages/portable_storage_json_writer.h"
+#include "storages/portable_storage_template_helper.h"
+#include "byte_slice.h"
 #include "span.h"
 
+namespace
+{
+  struct blobs
+  {
+    std::string blob;
+    std::vector<std::string> list;
+    std::uint64_t number;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(list)
+      KV_SERIALIZE(number)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct nested
+  {
+    blobs inner;
+    std::vector<blobs> entries;
+    std::vector<std::uint32_t> values;
+    std::vector<std::uint64_t> packed;
+    std::vector<blobs> none;
+    bool flag;
+    double ratio;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(inner)
+      KV_SERIALIZE(entries)
+      KV_SERIALIZE(values)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(packed)
+      KV_SERIALIZE(none)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(ratio)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
 TEST(epee_binary, two_keys)
 {
   static constexpr const std::uint8_t data[] = {
@@ -54,3 +96,239 @@ TEST(epee_binary, duplicate_key)
   epee::serialization::portable_storage storage{};
   EXPECT_FALSE(storage.load_from_binary(data));
 }
+
+TEST(epee_binary, move_strings)
+{
+  blobs in{std::string(100000, 'x'), {"a", std::string(5000, 'b'), ""}, 42};
+  epee::byte_slice buffer;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(in, buffer));
+
+  blobs out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(out, epee::to_span(buffer)));
+  EXPECT_EQ(in.blob, out.blob);
+  EXPECT_EQ(in.list, out.list);
+  EXPECT_EQ(in.number, out.number);
+
+  epee::serialization::portable_storage storage{};
+  ASSERT_TRUE(storage.load_from_binary(epee::to_span(buffer)));
+  std::string blob;
+  ASSERT_TRUE(storage.get_value("blob", blob, nullptr));
+  ASSERT_TRUE(storage.get_value("blob", blob, nullptr));
+  EXPECT_EQ(in.blob, blob);
+
+  storage.set_move_strings(true);
+  ASSERT_TRUE(storage.get_value("blob", blob, nullptr));
+  EXPECT_EQ(in.blob, blob);
+  ASSERT_TRUE(storage.get_value("blob", blob, nullptr));
+  EXPECT_TRUE(blob.empty());
+}
+
+TEST(epee_binary, writer)
+{
+  nested in{};
+  in.inner = {"inner", {"x", "y"}, 7};
+  for (std::uint64_t i = 0; i < 100; ++i)
+    in.entries.push_back({std::string(i, 'e'), {std::to_string(i)}, i});
+  in.values = {1, 2, 3};
+  in.packed = {4, 5};
+  in.flag = true;
+  in.ratio = 0.5;
+
+  std::string written;
+  ASSERT_TRUE(epee::serialization::write_t_to_binary(in, written));
+
+  nested out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(out, epee::strspan<std::uint8_t>(written)));
+  EXPECT_EQ(in.inner.blob, out.inner.blob);
+  EXPECT_EQ(in.inner.list, out.inner.list);
+  EXPECT_EQ(in.inner.number, out.inner.number);
+  ASSERT_EQ(in.entries.size(), out.entries.size());
+  for (std::size_t i = 0; i < in.entries.size(); ++i)
+  {
+    EXPECT_EQ(in.entries[i].blob, out.entries[i].blob);
+    EXPECT_EQ(in.entries[i].list, out.entries[i].list);
+    EXPECT_EQ(in.entries[i].number, out.entries[i].number);
+  }
+  EXPECT_EQ(in.values, out.values);
+  EXPECT_EQ(in.packed, out.packed);
+  EXPECT_TRUE(out.none.empty());
+  EXPECT_TRUE(out.flag);
+  EXPECT_EQ(in.ratio, out.ratio);
+
+  // same storage tree as the regular path
+  epee::byte_slice stored;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(in, stored));
+  epee::serialization::portable_storage from_written{}, from_stored{};
+  ASSERT_TRUE(from_written.load_from_binary(epee::strspan<std::uint8_t>(written)));
+  ASSERT_TRUE(from_stored.load_from_binary(epee::to_span(stored)));
+  std::string json_written, json_stored;
+  from_written.dump_as_json(json_written);
+  from_stored.dump_as_json(json_stored);
+  EXPECT_EQ(json_stored, json_written);
+}
+
+TEST(epee_binary, reader)
+{
+  nested in{};
+  in.inner = {"inner", {"x", "y"}, 7};
+  in.entries.push_back({"a", {}, 1});
+  in.entries.push_back({"b", {"c"}, 2});
+  in.values = {1, 2, 3};
+  in.packed = {4, 5};
+  in.flag = true;
+  in.ratio = 0.25;
+
+  // counts from portable_storage are minimal varints, unlike the writer's
+  epee::serialization::portable_storage storage{};
+  ASSERT_TRUE(in.store(storage));
+  epee::byte_slice stored;
+  ASSERT_TRUE(storage.store_to_binary(stored));
+
+  nested out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(out, epee::to_span(stored)));
+  EXPECT_EQ(in.inner.blob, out.inner.blob);
+  EXPECT_EQ(in.inner.list, out.inner.list);
+  ASSERT_EQ(2, out.entries.size());
+  EXPECT_EQ("b", out.entries[1].blob);
+  EXPECT_EQ(in.entries[1].list, out.entries[1].list);
+  EXPECT_EQ(2, out.entries[1].number);
+  EXPECT_EQ(in.values, out.values);
+  EXPECT_EQ(in.packed, out.packed);
+  EXPECT_TRUE(out.flag);
+  EXPECT_EQ(in.ratio, out.ratio);
+
+  // narrower integers convert like they do through portable_storage
+  static constexpr const std::uint8_t narrow[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x04, 0x06, 'n', 'u', 'm', 'b', 'e', 'r',
+    0x08, 0x2a
+  };
+  blobs b{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(b, narrow));
+  EXPECT_EQ(42, b.number);
+}
+
+TEST(epee_binary, reader_rejects)
+{
+  static constexpr const std::uint8_t duplicate[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x08, 0x01, 'a',
+    0x0B, 0x00, 0x01, 'a', 0x0B, 0x00
+  };
+  epee::serialization::binary_reader reader;
+  EXPECT_FALSE(reader.load_from_binary(duplicate));
+
+  static constexpr const std::uint8_t bad_bool[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x04, 0x01, 'a', 0x0B, 0x02
+  };
+  EXPECT_FALSE(reader.load_from_binary(bad_bool));
+
+  static constexpr const std::uint8_t truncated[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x04, 0x01, 'a', 0x0A, 0x08, 'x'
+  };
+  EXPECT_FALSE(reader.load_from_binary(truncated));
+
+  static constexpr const std::uint8_t huge_count[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+  };
+  EXPECT_FALSE(reader.load_from_binary(huge_count));
+
+  blobs in{"x", {"a", "b", "c"}, 1};
+  epee::byte_slice buffer;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(in, buffer));
+  const epee::serialization::portable_storage::limits_t limits{8, 8, 2};
+  EXPECT_FALSE(reader.load_from_binary(epee::to_span(buffer), &limits));
+  EXPECT_TRUE(reader.load_from_binary(epee::to_span(buffer)));
+}
+
+TEST(epee_json, writer)
+{
+  // fields of blobs are declared sorted, so the text matches the tree dump exactly
+  blobs flat{"q\"u/o\te\\", {"x", "", "\n"}, 18446744073709551615ull};
+  epee::serialization::portable_storage flat_storage{};
+  ASSERT_TRUE(flat.store(flat_storage));
+  for (const bool newlines : {true, false})
+  {
+    std::string written, dumped;
+    ASSERT_TRUE(epee::serialization::write_t_to_json(flat, written, 1, newlines));
+    ASSERT_TRUE(flat_storage.dump_as_json(dumped, 1, newlines));
+    EXPECT_EQ(dumped, written);
+  }
+
+  nested in{};
+  in.inner = {"inner", {"x", "y"}, 7};
+  for (std::uint64_t i = 0; i < 10; ++i)
+    in.entries.push_back({std::string(i, 'e'), {std::to_string(i)}, i});
+  in.values = {1, 2, 3};
+  in.packed = {4, 5};
+  in.flag = true;
+  in.ratio = 0.125;
+
+  std::string written;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(in, written));
+
+  epee::serialization::portable_storage parsed{}, stored{};
+  ASSERT_TRUE(parsed.load_from_json(written));
+  ASSERT_TRUE(in.store(stored));
+  std::string json_parsed, json_stored;
+  ASSERT_TRUE(parsed.dump_as_json(json_parsed));
+  ASSERT_TRUE(stored.dump_as_json(json_stored));
+  EXPECT_EQ(json_stored, json_parsed);
+
+  std::string empty_written;
+  ASSERT_TRUE(epee::serialization::write_t_to_json(blobs{}, empty_written));
+  EXPECT_EQ("{\r\n  \"blob\": \"\",\r\n  \"number\": 0\r\n}", empty_written);
+}
+
+TEST(epee_json, reader)
+{
+  const std::string json =
+    "{\"inner\": {\"blob\": \"in\\\"ner\", \"list\": [\"x\", \"y\"], \"number\": 7},"
+    " \"entries\": [{\"blob\": \"a\", \"number\": 1}, {\"blob\": \"b\", \"list\": [\"c\"], \"number\": 2}],"
+    " \"values\": [1, 2, 3], \"none\": [], \"skipped\": null, \"flag\": true, \"ratio\": 0.5} trailing";
+
+  nested out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_json(out, json));
+  EXPECT_EQ("in\"ner", out.inner.blob);
+  EXPECT_EQ((std::vector<std::string>{"x", "y"}), out.inner.list);
+  EXPECT_EQ(7, out.inner.number);
+  ASSERT_EQ(2, out.entries.size());
+  EXPECT_EQ("a", out.entries[0].blob);
+  EXPECT_TRUE(out.entries[0].list.empty());
+  EXPECT_EQ(std::vector<std::string>{"c"}, out.entries[1].list);
+  EXPECT_EQ(2, out.entries[1].number);
+  EXPECT_EQ((std::vector<std::uint32_t>{1, 2, 3}), out.values);
+  EXPECT_TRUE(out.none.empty());
+  EXPECT_TRUE(out.flag);
+  EXPECT_EQ(0.5, out.ratio);
+
+  // control characters are written as \u escapes and read back as bytes
+  const blobs binary{std::string{"\0\v\x1f\x80", 4}, {}, 0};
+  std::string written;
+  ASSERT_TRUE(epee::serialization::write_t_to_json(binary, written));
+  EXPECT_NE(std::string::npos, written.find("\\u0000\\u000b\\u001f"));
+  blobs binary_out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_json(binary_out, written));
+  EXPECT_EQ(binary.blob, binary_out.blob);
+
+epee::serialization::portable_storage storage{};
+  ASSERT_TRUE(storage.load_from_json("{\"neg\": -5, \"big\": 18446744073709551615}"));
+  epee::serialization::storage_entry entry{};
+  ASSERT_TRUE(storage.get_value("neg", entry, nullptr));
+  EXPECT_EQ(-5, boost::get<std::int64_t>(entry));
+  ASSERT_TRUE(storage.get_value("big", entry, nullptr));
+  EXPECT_EQ(18446744073709551615ull, boost::get<std::uint64_t>(entry));
+
+  for (const char* bad : {"", "[1]", "\"x\"", "{\"a\": [[1]]}", "{\"a\": [1, \"x\"]}", "{\"a\": [null]}", "{\"a\": 1", "{\"a\" 1}"})
+  {
+    epee::serialization::portable_storage rejected{};
+    EXPECT_FALSE(rejected.load_from_json(bad)) << bad;
+  }
+
+  // objects nest at most 100 deep
+  std::string deep;
+  for (unsigned i = 0; i < 100; ++i)
+    deep += "{\"a\":";
+  deep += "{}";
+  deep += std::string(100, '}');
+  EXPECT_FALSE(storage.load_from_json(deep));
+  EXPECT_TRUE(storage.load_from_json(deep.substr(5, deep.size() - 6)));
+}
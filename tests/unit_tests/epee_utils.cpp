@@ -26,12 +26,14 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <array>
 #include <boost/predef/other/endian.h>
 #include <boost/endian/conversion.hpp>
 #include <boost/range/algorithm/equal.hpp>
 #include <boost/range/algorithm_ext/iota.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <cctype>
 #include <cstdint>
 #include <gtest/gtest.h>
 #include <iterator>
@@ -1321,6 +1323,45 @@ TEST(FromHex, ToBuffer)
   EXPECT_EQ(expected, out);
 }
 
+TEST(ToHex, Buffer)
+{
+  const std::vector<unsigned char> all_bytes = get_all_bytes();
+  std::string out(all_bytes.size() * 2, 'x');
+
+  EXPECT_FALSE(epee::to_hex::buffer({&out[0], out.size() - 1}, epee::to_span(all_bytes)));
+  EXPECT_FALSE(epee::to_hex::buffer({&out[0], out.size() - 2}, epee::to_span(all_bytes)));
+  EXPECT_TRUE(epee::to_hex::buffer({&out[0], out.size()}, epee::to_span(all_bytes)));
+  EXPECT_EQ(std_to_hex(all_bytes), out);
+  EXPECT_TRUE(epee::to_hex::buffer({&out[0], 0}, nullptr));
+}
+
+TEST(FromHex, LongInput)
+{
+  // long enough for the vectorized paths, odd tail for the scalar one
+  std::vector<unsigned char> all_bytes = get_all_bytes();
+  all_bytes.push_back(0x5a);
+  const std::string hex = std_to_hex(all_bytes);
+
+  std::vector<std::uint8_t> out(all_bytes.size());
+  EXPECT_TRUE(epee::from_hex::to_buffer(epee::to_mut_span(out), hex));
+  EXPECT_EQ(all_bytes, out);
+
+  std::string upper = hex;
+  std::transform(upper.begin(), upper.end(), upper.begin(), [](char c) { return std::toupper(c); });
+  EXPECT_TRUE(epee::from_hex::to_buffer(epee::to_mut_span(out), upper));
+  EXPECT_EQ(all_bytes, out);
+
+  for (std::size_t i = 0; i < hex.size(); ++i)
+  {
+    for (const char bad : {'g', 'G', '/', ':', '@', '`', ' ', char(0), char(0x80), char(0xff)})
+    {
+      std::string corrupted = hex;
+      corrupted[i] = bad;
+      EXPECT_FALSE(epee::from_hex::to_buffer(epee::to_mut_span(out), corrupted)) << "position " << i;
+    }
+  }
+}
+
 TEST(StringTools, BuffToHex)
 {
   const std::vector<unsigned char> all_bytes = get_all_bytes();
@@ -0,0 +1,128 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <random>
+#include <unordered_map>
+#include "gtest/gtest.h"
+
+#include "common/flat_index_map.h"
+#include "crypto/crypto.h"
+
+namespace
+{
+  crypto::key_image make_key(std::mt19937_64 &rng)
+  {
+    crypto::key_image key;
+    for (size_t i = 0; i < sizeof(key.data); i += sizeof(uint64_t))
+    {
+      const uint64_t r = rng();
+      memcpy(key.data + i, &r, sizeof(r));
+    }
+    return key;
+  }
+}
+
+TEST(flat_index_map, basic)
+{
+  std::mt19937_64 rng(1);
+  tools::flat_index_map<crypto::key_image> map;
+  const crypto::key_image a = make_key(rng), b = make_key(rng);
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.find(a) == map.end());
+  ASSERT_TRUE(map.emplace(a, 1).second);
+  ASSERT_FALSE(map.emplace(a, 2).second);
+  ASSERT_EQ(1, map.find(a)->second);
+  map[b] = 7;
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(7, map.find(b)->second);
+  ASSERT_EQ(1, map.erase(a));
+  ASSERT_EQ(0, map.erase(a));
+  ASSERT_TRUE(map.find(a) == map.end());
+  ASSERT_EQ(7, map.find(b)->second);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.begin() == map.end());
+  ASSERT_EQ(0, map.memory_usage());
+}
+
+TEST(flat_index_map, matches_unordered_map)
+{
+  std::mt19937_64 rng(2);
+  tools::flat_index_map<crypto::key_image> map;
+  std::unordered_map<crypto::key_image, uint32_t> reference;
+  std::vector<crypto::key_image> keys;
+  for (uint32_t n = 0; n < 20000; ++n)
+  {
+    if (!keys.empty() && rng() % 3 == 0)
+    {
+      const size_t idx = rng() % keys.size();
+      ASSERT_EQ(reference.erase(keys[idx]), map.erase(keys[idx]));
+      keys[idx] = keys.back();
+      keys.pop_back();
+    }
+    else
+    {
+      keys.push_back(make_key(rng));
+      reference[keys.back()] = n;
+      map[keys.back()] = n;
+    }
+    ASSERT_EQ(reference.size(), map.size());
+  }
+  for (const auto &e: reference)
+  {
+    const auto it = map.find(e.first);
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(e.second, it->second);
+  }
+  size_t iterated = 0;
+  for (const auto &e: map)
+  {
+    ASSERT_EQ(reference.at(e.first), e.second);
+    ++iterated;
+  }
+  ASSERT_EQ(reference.size(), iterated);
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_TRUE(map.find(make_key(rng)) == map.end());
+}
+
+TEST(flat_index_map, reserve)
+{
+  std::mt19937_64 rng(3);
+  tools::flat_index_map<crypto::public_key> map;
+  map.reserve(1000);
+  const size_t reserved = map.memory_usage();
+  ASSERT_LE(reserved, 1200 * (sizeof(crypto::public_key) + sizeof(uint32_t)));
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    crypto::public_key key;
+    const crypto::key_image random = make_key(rng);
+    memcpy(key.data, random.data, sizeof(key.data));
+    ASSERT_TRUE(map.emplace(key, i).second);
+  }
+  ASSERT_EQ(reserved, map.memory_usage());
+}
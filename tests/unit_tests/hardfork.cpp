@@ -69,6 +69,19 @@ public:
   virtual uint8_t get_hard_fork_version(uint64_t height) const override {
     return versions.at(height);
   }
+  virtual void set_hard_fork_voting_window(const hard_fork_voting_window &w) override {
+    window = w;
+    has_window = true;
+  }
+  virtual bool get_hard_fork_voting_window(hard_fork_voting_window &w) const override {
+    if (!has_window)
+      return false;
+    w = window;
+    return true;
+  }
+
+  hard_fork_voting_window window;
+  bool has_window = false;
 
 private:
   std::vector<block> blocks;
@@ -604,3 +617,48 @@ TEST(get, earliest_ideal_height)
     ASSERT_EQ(hf.get_earliest_ideal_height_for_version(10), std::numeric_limits<uint64_t>::max());
 }
 
+TEST(voting_window, restore)
+{
+  TestDB db;
+  HardFork hf(db, 1, 0, 1, 1, 4, 50); // window size 4, default threshold 50%
+
+  //                      v  h  ts
+  ASSERT_TRUE(hf.add_fork(1, 0, 0));
+  ASSERT_TRUE(hf.add_fork(2, 4, 1));
+  hf.init();
+
+  static const uint8_t votes[] = { 1, 1, 2, 2, 2, 2 };
+  for (uint64_t h = 0; h < sizeof(votes) / sizeof(votes[0]); ++h) {
+    db.add_block(mkblock(hf, h, votes[h]), 0, 0, 0, 0, 0, crypto::hash());
+    ASSERT_TRUE(hf.add(db.get_block_from_height(h), h));
+  }
+  ASSERT_EQ(hf.get_current_version(), 2);
+
+  uint32_t window, nvotes, threshold;
+  uint64_t earliest_height;
+  uint8_t voting;
+  hf.store_voting_window();
+  ASSERT_TRUE(db.has_window);
+  ASSERT_EQ(db.window.height, 6);
+  ASSERT_EQ(db.window.versions, std::vector<uint8_t>({ 2, 2, 2, 2 }));
+
+  // a matching snapshot is used as is, even if it disagrees with the blocks
+  db.window.versions = { 2, 2, 1, 1 };
+  HardFork restored(db, 1, 0, 1, 1, 4, 50);
+  ASSERT_TRUE(restored.add_fork(1, 0, 0));
+  ASSERT_TRUE(restored.add_fork(2, 4, 1));
+  restored.init();
+  ASSERT_EQ(restored.get_current_version(), 2);
+  ASSERT_TRUE(restored.get_voting_info(2, window, nvotes, threshold, earliest_height, voting));
+  ASSERT_EQ(nvotes, 2);
+
+  // a snapshot for another height is ignored
+  db.window.height = 5;
+  HardFork rescanned(db, 1, 0, 1, 1, 4, 50);
+  ASSERT_TRUE(rescanned.add_fork(1, 0, 0));
+  ASSERT_TRUE(rescanned.add_fork(2, 4, 1));
+  rescanned.init();
+  ASSERT_EQ(rescanned.get_current_version(), 2);
+  ASSERT_TRUE(rescanned.get_voting_info(2, window, nvotes, threshold, earliest_height, voting));
+  ASSERT_EQ(nvotes, 4);
+}
@@ -28,6 +28,7 @@
 
 #include "gtest/gtest.h"
 #include "net/http_auth.h"
+#include "net/http_protocol_handler.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -743,3 +744,123 @@ TEST(HTTP, Add_Field)
 
   EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+TEST(HTTP, Parse_Request_Line)
+{
+  http::http_method method = http::http_method_unknown;
+  boost::string_ref method_str, uri;
+  int major = 0, minor = 0;
+
+  EXPECT_TRUE(http::parse_request_line("post /json_rpc HTTP/1.1\r", method, method_str, uri, major, minor));
+  EXPECT_EQ(http::http_method_post, method);
+  EXPECT_EQ("post", method_str);
+  EXPECT_EQ("/json_rpc", uri);
+  EXPECT_EQ(1, major);
+  EXPECT_EQ(1, minor);
+
+  EXPECT_TRUE(http::parse_request_line("GET /get_info http/1.0", method, method_str, uri, major, minor));
+  EXPECT_EQ(http::http_method_get, method);
+  EXPECT_EQ("/get_info", uri);
+  EXPECT_EQ(0, minor);
+
+  EXPECT_TRUE(http::parse_request_line("DELETE / HTTP/1.1", method, method_str, uri, major, minor));
+  EXPECT_EQ(http::http_method_etc, method);
+
+  EXPECT_FALSE(http::parse_request_line("CONNECT / HTTP/1.1", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET  HTTP/1.1", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET /a b HTTP/1.1", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET / HTTP/1.1 ", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET / HTTP/1", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET / HTTP/1.99999999999", method, method_str, uri, major, minor));
+  EXPECT_FALSE(http::parse_request_line("GET /", method, method_str, uri, major, minor));
+}
+
+TEST(HTTP, Parse_Header_Fields)
+{
+  http::http_header_info info{};
+  http::parse_header_fields(
+    "Host: 127.0.0.1:18081\r\n"
+    "content-length:12\r\n"
+    "Content-Type : application/json\r\n"
+    "not a field\r\n"
+    "X-Folded: one\r\n two\r\n"
+    "X-Empty:\r\n"
+    "\r\n",
+    info);
+
+  EXPECT_EQ("127.0.0.1:18081", info.m_host);
+  EXPECT_EQ("12", info.m_content_length);
+  EXPECT_EQ("application/json", info.m_content_type);
+  ASSERT_EQ(2u, info.m_etc_fields.size());
+  EXPECT_EQ("X-Folded", info.m_etc_fields.front().first);
+  EXPECT_EQ("one\r\n two", info.m_etc_fields.front().second);
+  EXPECT_EQ("X-Empty", info.m_etc_fields.back().first);
+  EXPECT_EQ("", info.m_etc_fields.back().second);
+
+  http::parse_header_fields("Connection: close\n\n", info);
+  EXPECT_EQ("close", info.m_connection);
+  EXPECT_TRUE(info.m_host.empty());
+  EXPECT_TRUE(info.m_etc_fields.empty());
+}
+
+namespace
+{
+  struct dummy_endpoint final : epee::net_utils::i_service_endpoint
+  {
+    std::vector<std::string> sent;
+
+    virtual bool do_send(epee::byte_slice message) override
+    {
+      sent.emplace_back(reinterpret_cast<const char*>(message.data()), message.size());
+      return true;
+    }
+    virtual bool close() override { return true; }
+    virtual bool send_done() override { return true; }
+    virtual bool call_run_once_service_io() override { return true; }
+    virtual bool request_callback() override { return true; }
+    virtual boost::asio::io_service& get_io_service() override { throw std::logic_error{"not implemented"}; }
+    virtual bool add_ref() override { return true; }
+    virtual bool release() override { return true; }
+  };
+
+  struct recording_handler final : http::i_http_server_handler<epee::net_utils::connection_context_base>
+  {
+    std::vector<std::pair<std::string, std::string>> requests;
+
+    virtual bool handle_http_request(const http::http_request_info& query_info, http::http_response_info& response, epee::net_utils::connection_context_base&) override
+    {
+      requests.emplace_back(query_info.m_URI, query_info.m_body);
+      return true;
+    }
+  };
+}
+
+TEST(HTTP, Server_Split_Requests)
+{
+  const std::string stream =
+    "POST /json_rpc HTTP/1.1\r\nContent-Length: 10\r\n\r\n{\"id\":\"0\"}"
+    "GET /get_info HTTP/1.1\r\nHost: localhost\r\n\r\n"
+    "POST /get_height HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}";
+
+  for (std::size_t split = 1; split < stream.size(); ++split)
+  {
+    recording_handler handler{};
+    http::custum_handler_config<epee::net_utils::connection_context_base> config{};
+    config.m_phandler = std::addressof(handler);
+    dummy_endpoint endpoint{};
+    epee::net_utils::connection_context_base context{};
+    http::http_custom_handler<epee::net_utils::connection_context_base> server{std::addressof(endpoint), config, context};
+
+    ASSERT_TRUE(server.handle_recv(stream.data(), split));
+    ASSERT_TRUE(server.handle_recv(stream.data() + split, stream.size() - split));
+
+    ASSERT_EQ(3u, handler.requests.size()) << "split at " << split;
+    EXPECT_EQ("/json_rpc", handler.requests[0].first);
+    EXPECT_EQ("{\"id\":\"0\"}", handler.requests[0].second);
+    EXPECT_EQ("/get_info", handler.requests[1].first);
+    EXPECT_EQ("", handler.requests[1].second);
+    EXPECT_EQ("/get_height", handler.requests[2].first);
+    EXPECT_EQ("{}", handler.requests[2].second);
+    EXPECT_EQ(3u, endpoint.sent.size());
+  }
+}
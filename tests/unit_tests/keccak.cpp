@@ -162,3 +162,46 @@ TEST(keccak, alignment)
     ASSERT_TRUE(!memcmp(md, amd, 32));
   }
 }
+
+TEST(keccak, lanes)
+{
+  uint8_t data[KECCAK_LANES][3 * KECCAK_BLOCKLEN + 1];
+  for (size_t l = 0; l < KECCAK_LANES; ++l)
+    for (size_t i = 0; i < sizeof(data[l]); ++i)
+      data[l][i] = i * 17 + l;
+
+  for (size_t sz = 0; sz <= sizeof(data[0]); ++sz)
+  {
+    uint8_t md[KECCAK_LANES][32], md_lanes[KECCAK_LANES][32];
+    const uint8_t *in[KECCAK_LANES];
+    uint8_t *out[KECCAK_LANES];
+    for (size_t l = 0; l < KECCAK_LANES; ++l)
+    {
+      keccak(data[l], sz, md[l], 32);
+      in[l] = data[l];
+      out[l] = md_lanes[l];
+    }
+    keccak_lanes(in, sz, out, 32);
+    for (size_t l = 0; l < KECCAK_LANES; ++l)
+      ASSERT_EQ(memcmp(md[l], md_lanes[l], 32), 0);
+  }
+}
+
+TEST(keccak, lanes_in_place)
+{
+  uint8_t data[KECCAK_LANES * 64], expected[KECCAK_LANES][32];
+  for (size_t i = 0; i < sizeof(data); ++i)
+    data[i] = i * 17;
+
+  const uint8_t *in[KECCAK_LANES];
+  uint8_t *out[KECCAK_LANES];
+  for (size_t l = 0; l < KECCAK_LANES; ++l)
+  {
+    keccak(data + l * 64, 64, expected[l], 32);
+    in[l] = data + l * 64;
+    out[l] = data + l * 32;
+  }
+  keccak_lanes(in, 64, out, 32);
+  for (size_t l = 0; l < KECCAK_LANES; ++l)
+    ASSERT_EQ(memcmp(data + l * 32, expected[l], 32), 0);
+}
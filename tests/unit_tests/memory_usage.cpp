@@ -0,0 +1,61 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <map>
+#include <unordered_map>
+#include "gtest/gtest.h"
+
+#include "common/memory_usage.h"
+
+TEST(memory_usage, containers)
+{
+  std::vector<uint64_t> v;
+  EXPECT_EQ(0, tools::memory::vector_bytes(v));
+  v.reserve(100);
+  EXPECT_EQ(100 * sizeof(uint64_t), tools::memory::vector_bytes(v));
+
+  std::map<uint64_t, uint64_t> m;
+  EXPECT_EQ(0, tools::memory::tree_container_bytes(m));
+  for (uint64_t i = 0; i < 10; ++i)
+    m[i] = i;
+  EXPECT_GE(tools::memory::tree_container_bytes(m), 10 * sizeof(std::pair<const uint64_t, uint64_t>));
+
+  std::unordered_map<uint64_t, uint64_t> h;
+  const uint64_t empty = tools::memory::hash_container_bytes(h);
+  for (uint64_t i = 0; i < 10; ++i)
+    h[i] = i;
+  EXPECT_GT(tools::memory::hash_container_bytes(h), empty);
+}
+
+TEST(memory_usage, resident)
+{
+#if defined(__linux__)
+  EXPECT_GT(tools::get_resident_memory(), 0);
+#endif
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "gtest/gtest.h"
+
+#include "common/metrics.h"
+#include "common/perf_timer.h"
+
+TEST(metrics, histogram_buckets)
+{
+  using tools::metrics::histogram;
+  EXPECT_EQ(0, histogram::bucket_index(0));
+  EXPECT_EQ(0, histogram::bucket_index(1));
+  EXPECT_EQ(1, histogram::bucket_index(2));
+  EXPECT_EQ(2, histogram::bucket_index(3));
+  EXPECT_EQ(2, histogram::bucket_index(4));
+  EXPECT_EQ(3, histogram::bucket_index(5));
+  EXPECT_EQ(10, histogram::bucket_index(1024));
+  EXPECT_EQ(11, histogram::bucket_index(1025));
+  const std::uint64_t largest = std::uint64_t(1) << (histogram::bucket_count - 2);
+  EXPECT_EQ(histogram::bucket_count - 2, histogram::bucket_index(largest));
+  EXPECT_EQ(histogram::bucket_count - 1, histogram::bucket_index(largest + 1));
+  EXPECT_EQ(histogram::bucket_count - 1, histogram::bucket_index(std::uint64_t(-1)));
+}
+
+TEST(metrics, render)
+{
+  tools::metrics::counter c("test_metrics_counter_total", "A counter");
+  tools::metrics::gauge g("test_metrics_gauge", "A gauge");
+  c.inc();
+  c.inc(4);
+  g.set(10);
+  g.add(-3);
+  EXPECT_EQ(5, c.value());
+  EXPECT_EQ(7, g.value());
+
+  const std::string out = tools::metrics::render();
+  EXPECT_NE(std::string::npos, out.find("# HELP test_metrics_counter_total A counter\n# TYPE test_metrics_counter_total counter\ntest_metrics_counter_total 5\n"));
+  EXPECT_NE(std::string::npos, out.find("# TYPE test_metrics_gauge gauge\ntest_metrics_gauge 7\n"));
+}
+
+TEST(metrics, labelled_family)
+{
+  tools::metrics::histogram a("test_metrics_duration", "Durations", "rpc=\"a\"");
+  tools::metrics::histogram b("test_metrics_duration", "Durations", "rpc=\"b\"");
+  a.observe(3);
+  a.observe(100);
+  b.observe(1);
+  EXPECT_EQ(2, a.count());
+  EXPECT_EQ(103, a.sum());
+
+  const std::string out = tools::metrics::render();
+  const size_t type = out.find("# TYPE test_metrics_duration histogram\n");
+  ASSERT_NE(std::string::npos, type);
+  EXPECT_EQ(std::string::npos, out.find("# TYPE test_metrics_duration", type + 1));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_bucket{rpc=\"a\",le=\"2\"} 0\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_bucket{rpc=\"a\",le=\"4\"} 1\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_bucket{rpc=\"a\",le=\"128\"} 2\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_bucket{rpc=\"a\",le=\"+Inf\"} 2\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_sum{rpc=\"a\"} 103\n"));
+  EXPECT_NE(std::string::npos, out.find("test_metrics_duration_count{rpc=\"b\"} 1\n"));
+}
+
+TEST(metrics, unregisters)
+{
+  {
+    tools::metrics::counter c("test_metrics_scoped_total", "Scoped");
+    EXPECT_NE(std::string::npos, tools::metrics::render().find("test_metrics_scoped_total"));
+  }
+  EXPECT_EQ(std::string::npos, tools::metrics::render().find("test_metrics_scoped_total"));
+}
+
+TEST(metrics, restricted)
+{
+  tools::metrics::counter open("test_metrics_open_total", "Open");
+  tools::metrics::counter hidden("test_metrics_hidden_total", "Hidden", {}, true);
+  EXPECT_NE(std::string::npos, tools::metrics::render().find("test_metrics_hidden_total"));
+  const std::string out = tools::metrics::render(true);
+  EXPECT_NE(std::string::npos, out.find("test_metrics_open_total"));
+  EXPECT_EQ(std::string::npos, out.find("test_metrics_hidden_total"));
+}
+
+TEST(metrics, quantile)
+{
+  tools::metrics::histogram h("test_metrics_quantile", "Quantiles");
+  EXPECT_EQ(0, h.quantile(0.5));
+  for (int i = 0; i < 90; ++i)
+    h.observe(100);
+  for (int i = 0; i < 10; ++i)
+    h.observe(5000);
+  EXPECT_EQ(128, h.quantile(0));
+  EXPECT_EQ(128, h.quantile(0.5));
+  EXPECT_EQ(128, h.quantile(0.9));
+  EXPECT_EQ(8192, h.quantile(0.91));
+  EXPECT_EQ(8192, h.quantile(1));
+}
+
+TEST(metrics, perf_timer_agg)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    PERF_TIMER_AGG(test_metrics_site);
+  }
+  const auto stats = tools::get_aggregate_performance_stats();
+  const auto it = std::find_if(stats.begin(), stats.end(), [](const tools::aggregate_performance_stats &s) { return s.name == "test_metrics_site"; });
+  ASSERT_NE(stats.end(), it);
+  EXPECT_EQ(3, it->count);
+  EXPECT_LE(it->median_ns, it->p99_ns);
+  EXPECT_NE(std::string::npos, tools::metrics::render().find("monero_perf_nanoseconds_count{site=\"test_metrics_site\"} 3\n"));
+}
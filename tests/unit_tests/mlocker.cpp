@@ -27,6 +27,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
+#include <atomic>
+#include <set>
+#include <thread>
 #include "gtest/gtest.h"
 
 #include "misc_log_ex.h"
@@ -193,4 +197,81 @@ TEST(mlocker, mlocked)
   ASSERT_EQ(epee::mlocker::get_num_locked_objects(), base_objects + 0);
 }
 
+TEST(mlocked_pool, allocate)
+{
+  ASSERT_EQ(NULL, epee::mlocked_pool::allocate(epee::mlocked_pool::max_slot_size + 1));
+
+  const size_t base_pages = epee::mlocker::get_num_locked_pages();
+  const size_t base_objects = epee::mlocker::get_num_locked_objects();
+  std::vector<char*> slots;
+  for (size_t n = 0; n < 1000; ++n)
+  {
+    char *slot = (char*)epee::mlocked_pool::allocate(n % 100 + 1);
+    ASSERT_TRUE(slot != NULL);
+    ASSERT_TRUE(epee::mlocked_pool::contains(slot));
+    memset(slot, 0x55, n % 100 + 1);
+    slots.push_back(slot);
+  }
+  ASSERT_EQ(slots.size(), std::set<char*>(slots.begin(), slots.end()).size());
+  ASSERT_GT(epee::mlocked_pool::get_num_slabs(), 0);
+
+  // objects in the pool do not need locking on their own
+  epee::mlocked<std::array<char, 32>> *l = new (slots[0]) epee::mlocked<std::array<char, 32>>();
+  ASSERT_EQ(epee::mlocker::get_num_locked_pages(), base_pages);
+  ASSERT_EQ(epee::mlocker::get_num_locked_objects(), base_objects);
+  l->~mlocked();
+
+  for (size_t n = 0; n < slots.size(); ++n)
+    epee::mlocked_pool::deallocate(slots[n], n % 100 + 1);
+  // the first bytes of a free slot link to the next one, the rest must be wiped
+  for (size_t n = sizeof(void*); n < 32; ++n)
+    ASSERT_EQ(0, slots[slots.size() - 1][n]);
+
+  int stack_var;
+  ASSERT_FALSE(epee::mlocked_pool::contains(&stack_var));
+}
+
+TEST(mlocked_pool, threads)
+{
+  std::vector<std::thread> threads;
+  std::atomic<bool> failed{false};
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&failed, t]() {
+      std::vector<void*> slots;
+      for (int n = 0; n < 10000; ++n)
+      {
+        slots.push_back(epee::mlocked_pool::allocate(64));
+        if (!slots.back())
+          failed = true;
+        else
+          memset(slots.back(), t, 64);
+        if (n % 3 == 0)
+        {
+          epee::mlocked_pool::deallocate(slots.back(), 64);
+          slots.pop_back();
+        }
+      }
+      for (void *slot: slots)
+        epee::mlocked_pool::deallocate(slot, 64);
+    });
+  }
+  for (auto &thread: threads)
+    thread.join();
+  ASSERT_FALSE(failed);
+}
+
+TEST(mlocked_pool, allocator)
+{
+  std::vector<uint64_t, epee::mlocked_allocator<uint64_t>> v;
+  for (uint64_t n = 0; n < 100; ++n)
+    v.push_back(n);
+  ASSERT_TRUE(epee::mlocked_pool::contains(v.data()));
+  for (uint64_t n = 100; n < 1000; ++n)
+    v.push_back(n);
+  ASSERT_FALSE(epee::mlocked_pool::contains(v.data()));
+  for (uint64_t n = 0; n < 1000; ++n)
+    ASSERT_EQ(n, v[n]);
+}
+
 #endif
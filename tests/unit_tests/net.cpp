@@ -1286,6 +1286,53 @@ TEST(socks_connector, timeout)
     EXPECT_THROW(sock.get().is_open(), boost::system::system_error);
 }
 
+TEST(socks_connector, parallel_spare)
+{
+    io_thread io{};
+    boost::asio::steady_timer timeout{io.io_service};
+    timeout.expires_from_now(std::chrono::seconds{5});
+
+    const auto pool = std::make_shared<net::socks::connection_pool>(std::chrono::minutes{1}, 1);
+    const net::socks::connector connect{io.acceptor.local_endpoint(), 2, pool};
+    boost::unique_future<boost::asio::ip::tcp::socket> sock = connect("example.com", "8080", timeout);
+
+    while (!io.connected)
+        ASSERT_FALSE(sock.is_ready());
+    stream_type::socket second{io.io_service};
+    io.acceptor.accept(second);
+
+    const std::uint8_t expected_bytes[] = {
+        4, 1, 0x1f, 0x90, 0x00, 0x00, 0x00, 0x01, 0x00,
+        'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm', 0x00
+    };
+
+    std::uint8_t actual_bytes[sizeof(expected_bytes)];
+    boost::asio::read(io.server, boost::asio::buffer(actual_bytes));
+    EXPECT_TRUE(std::memcmp(expected_bytes, actual_bytes, sizeof(actual_bytes)) == 0);
+    boost::asio::read(second, boost::asio::buffer(actual_bytes));
+    EXPECT_TRUE(std::memcmp(expected_bytes, actual_bytes, sizeof(actual_bytes)) == 0);
+
+    const std::uint8_t reply_bytes[] = {0, 90, 0, 0, 0, 0, 0, 0};
+    boost::asio::write(second, boost::asio::buffer(reply_bytes));
+
+    ASSERT_EQ(boost::future_status::ready, sock.wait_for(boost::chrono::seconds{3}));
+    EXPECT_TRUE(sock.get().is_open());
+
+    boost::asio::write(io.server, boost::asio::buffer(reply_bytes));
+    for (unsigned i = 0; i < 300 && !pool->size(); ++i)
+        boost::this_thread::sleep_for(boost::chrono::milliseconds{10});
+    ASSERT_EQ(1u, pool->size());
+
+    sock = connect("example.org", "8080", timeout);
+    EXPECT_FALSE(sock.is_ready());
+    EXPECT_EQ(1u, pool->size());
+
+    sock = connect("example.com", "8080", timeout);
+    ASSERT_TRUE(sock.is_ready());
+    EXPECT_TRUE(sock.get().is_open());
+    EXPECT_EQ(0u, pool->size());
+}
+
 TEST(dandelionpp_map, traits)
 {
     EXPECT_TRUE(std::is_default_constructible<net::dandelionpp::connection_map>());
@@ -0,0 +1,67 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "net/network_throttle-detail.hpp"
+
+using epee::net_utils::network_throttle;
+
+TEST(network_throttle, burst_within_bucket)
+{
+  network_throttle throttle("test", "test"); // 16 KiB/s, the bucket holds one second
+
+  EXPECT_EQ(0, throttle.get_sleep_time(16 * 1024));
+  throttle.handle_trafic_exact(8 * 1024);
+  EXPECT_EQ(0, throttle.get_sleep_time(4 * 1024));
+  EXPECT_LT(0, throttle.get_sleep_time(12 * 1024));
+}
+
+TEST(network_throttle, debt_delays)
+{
+  network_throttle throttle("test", "test");
+  throttle.set_target_speed(1);
+
+  throttle.handle_trafic_exact(3 * 1024);
+
+  // 2 KiB in debt at 1 KiB/s
+  EXPECT_NEAR(2.0, throttle.get_sleep_time(0), 0.1);
+  EXPECT_NEAR(3.0, throttle.get_sleep_time(1024), 0.1);
+  EXPECT_NEAR(2.0, throttle.get_sleep_time_after_tick(0), 0.1);
+}
+
+TEST(network_throttle, lower_limit_shrinks_bucket)
+{
+  network_throttle throttle("test", "test");
+  throttle.set_target_speed(1024);
+  throttle.set_target_speed(1);
+
+  // the bucket filled at the old rate must not allow a burst at the new one
+  EXPECT_EQ(0, throttle.get_sleep_time(1024));
+  EXPECT_NEAR(1.0, throttle.get_sleep_time(2 * 1024), 0.1);
+}
@@ -72,6 +72,8 @@ public:
   bool get_test_drop_download_height() const {return true;}
   bool prepare_handle_incoming_blocks(const std::vector<cryptonote::block_complete_entry>  &blocks_entry, std::vector<cryptonote::block> &blocks) { return true; }
   bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+  bool prefetch_incoming_blocks_pow(uint64_t height, const std::vector<cryptonote::block_complete_entry> &blocks_entry) { return false; }
+  bool queue_block_pow(const cryptonote::block &b) { return false; }
   bool update_checkpoints(const bool skip_dns = false) { return true; }
   uint64_t get_target_blockchain_height() const { return 1; }
   size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
@@ -547,6 +549,9 @@ TEST(cryptonote_protocol_handler, race_condition)
     virtual zone_t send_txs(blobs_t, const zone_t, const uuid_t&, relay_t) override {
       return {};
     }
+    virtual void on_tx_sketch_request(const contexts::basic&, uint64_t, uint64_t) override {}
+    virtual void on_tx_sketch(const contexts::basic&, std::string) override {}
+    virtual void on_tx_reconciliation_diff(const contexts::basic&, bool, std::string) override {}
     virtual bans::subnets get_blocked_subnets() override {
       return {};
     }
@@ -1170,5 +1175,84 @@ TEST(node_server, race_condition)
   remove_tree(dir);
 }
 
+namespace
+{
+  class pool_test_core: public test_core
+  {
+  public:
+    std::vector<crypto::hash> pool;
+    bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const { txs = pool; return true; }
+  };
+
+  struct notify_recorder: public nodetool::p2p_endpoint_stub<cryptonote::cryptonote_connection_context>
+  {
+    std::vector<int> commands;
+    virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context)
+    {
+      commands.push_back(command);
+      return true;
+    }
+  };
+
+  template<typename t_protocol>
+  void notify_sketch_failed(t_protocol &cprotocol, cryptonote::cryptonote_connection_context &context, uint64_t cells)
+  {
+    cryptonote::NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::request failed;
+    failed.set_size = 5000;
+    failed.cells = cells;
+    epee::byte_stream in;
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(failed, in));
+    epee::byte_stream out;
+    bool handled = false;
+    cprotocol.handle_invoke_map(true, cryptonote::NOTIFY_TXPOOL_COMPLEMENT_SKETCH_FAILED::ID, epee::span<const uint8_t>(in.data(), in.size()), out, context, handled);
+    ASSERT_TRUE(handled);
+  }
+}
+
+TEST(cryptonote_protocol_handler, txpool_complement_sketch_failed_unrequested)
+{
+  pool_test_core pr_core;
+  for (size_t i = 0; i < 1000; ++i)
+    pr_core.pool.push_back(crypto::rand<crypto::hash>());
+  notify_recorder p2p;
+  cryptonote::t_cryptonote_protocol_handler<pool_test_core> cprotocol(pr_core, &p2p);
+  cryptonote::cryptonote_connection_context context;
+  context.m_state = cryptonote::cryptonote_connection_context::state_normal;
+
+  // no sketch sent to this peer
+  notify_sketch_failed(cprotocol, context, 64);
+  EXPECT_TRUE(p2p.commands.empty());
+
+  // a sketch was sent, but not of that size
+  context.m_txpool_complement_sketch_cells = 64;
+  notify_sketch_failed(cprotocol, context, 128);
+  EXPECT_TRUE(p2p.commands.empty());
+  EXPECT_EQ(64, context.m_txpool_complement_sketch_cells);
+}
+
+TEST(cryptonote_protocol_handler, txpool_complement_sketch_failed_requested)
+{
+  pool_test_core pr_core;
+  for (size_t i = 0; i < 1000; ++i)
+    pr_core.pool.push_back(crypto::rand<crypto::hash>());
+  notify_recorder p2p;
+  cryptonote::t_cryptonote_protocol_handler<pool_test_core> cprotocol(pr_core, &p2p);
+  cryptonote::cryptonote_connection_context context;
+  context.m_state = cryptonote::cryptonote_connection_context::state_normal;
+
+  context.m_txpool_complement_sketch_cells = 64;
+  notify_sketch_failed(cprotocol, context, 64);
+  ASSERT_EQ(1, p2p.commands.size());
+  EXPECT_EQ(cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID, p2p.commands[0]);
+  // the retry is a larger sketch, or the hash list once sketches get too big
+  EXPECT_TRUE(context.m_txpool_complement_sketch_cells == 0 || context.m_txpool_complement_sketch_cells > 64);
+
+  // the same failure only gets one answer
+  const uint64_t cells = context.m_txpool_complement_sketch_cells;
+  notify_sketch_failed(cprotocol, context, 64);
+  EXPECT_EQ(1, p2p.commands.size());
+  EXPECT_EQ(cells, context.m_txpool_complement_sketch_cells);
+}
+
 namespace nodetool { template class node_server<cryptonote::t_cryptonote_protocol_handler<test_core>>; }
 namespace cryptonote { template class t_cryptonote_protocol_handler<test_core>; }
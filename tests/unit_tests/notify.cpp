@@ -88,3 +88,36 @@ TEST(notify, works)
   boost::filesystem::remove(name_template);
   ASSERT_TRUE(ok);
 }
+
+#ifndef _WIN32
+TEST(notify, batched)
+{
+  const char *tmp = getenv("TEMP");
+  if (!tmp)
+    tmp = "/tmp";
+  std::string name_template = std::string(tmp) + "/monero-notify-unit-test-XXXXXX";
+  int fd = mkstemp(&name_template[0]);
+  ASSERT_TRUE(fd >= 0);
+  close(fd);
+
+  const std::string spec = "batch:" + epee::string_tools::get_current_module_folder() + "/test_notifier " + name_template + " %s";
+
+  const std::string expected = "1111111111111111111111111111111111111111111111111111111111111111\n"
+      "2222222222222222222222222222222222222222222222222222222222222222\n";
+  bool ok = false;
+  {
+    tools::Notify notify(spec.c_str());
+    notify.notify("%s", "1111111111111111111111111111111111111111111111111111111111111111", NULL);
+    notify.notify("%s", "2222222222222222222222222222222222222222222222222222222222222222", NULL);
+
+    for (int i = 0; i < 10 && !ok; ++i)
+    {
+      epee::misc_utils::sleep_no_w(100);
+      std::string s;
+      ok = epee::file_io_utils::load_file_to_string(name_template, s) && s == expected;
+    }
+  }
+  boost::filesystem::remove(name_template);
+  ASSERT_TRUE(ok);
+}
+#endif
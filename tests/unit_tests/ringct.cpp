@@ -1234,7 +1234,15 @@ TEST(ringct, H)
 {
   ge_p3 p3;
   ASSERT_EQ(ge_frombytes_vartime(&p3, rct::H.bytes), 0);
-  ASSERT_EQ(memcmp(&p3, &ge_p3_H, sizeof(ge_p3)), 0);
+  // limbs are not unique, compare the coordinates by their canonical encoding
+  const fe *const coords[][2] = {{&p3.X, &ge_p3_H.X}, {&p3.Y, &ge_p3_H.Y}, {&p3.Z, &ge_p3_H.Z}, {&p3.T, &ge_p3_H.T}};
+  for (const auto &c: coords)
+  {
+    unsigned char a[32], b[32];
+    fe_tobytes(a, *c[0]);
+    fe_tobytes(b, *c[1]);
+    ASSERT_EQ(memcmp(a, b, sizeof(a)), 0);
+  }
 }
 
 TEST(ringct, mul8)
@@ -1268,3 +1276,26 @@ TEST(ringct, aggregated)
 
   ASSERT_TRUE(verRctSemanticsSimple(sp));
 }
+
+TEST(ringct, aggregated_non_semantics)
+{
+  static const size_t N_SIGS = 8;
+  std::vector<rctSig> s(N_SIGS);
+  std::vector<const rctSig*> sp(N_SIGS);
+
+  for (size_t n = 0; n < N_SIGS; ++n)
+  {
+    static const uint64_t inputs[] = {1000, 1000};
+    static const uint64_t outputs[] = {500, 1500};
+    s[n] = make_sample_simple_rct_sig(NELTS(inputs), inputs, NELTS(outputs), outputs, 0);
+    sp[n] = &s[n];
+  }
+
+  ASSERT_TRUE(verRctNonSemanticsSimple(sp));
+
+  // one bad signature anywhere in the batch fails it
+  s[N_SIGS / 2].p.MGs[1].cc = rct::skGen();
+  ASSERT_FALSE(verRctNonSemanticsSimple(sp));
+  ASSERT_TRUE(verRctNonSemanticsSimple(s[0]));
+  ASSERT_FALSE(verRctNonSemanticsSimple(s[N_SIGS / 2]));
+}
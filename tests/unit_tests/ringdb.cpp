@@ -197,3 +197,46 @@ TEST(spent_outputs, clear)
   ASSERT_FALSE(ringdb.blackballed(OUTPUT_1));
 }
 
+
+TEST(spent_outputs, bulk)
+{
+  RingDB ringdb;
+  std::vector<std::pair<uint64_t, uint64_t>> outs;
+  outs.push_back(std::make_pair(10, 5));
+  outs.push_back(std::make_pair(20, 1));
+  ASSERT_TRUE(ringdb.blackball(outs));
+
+  // unsorted, with duplicates, some before and some after the existing entries
+  outs.clear();
+  outs.push_back(std::make_pair(30, 2));
+  outs.push_back(std::make_pair(10, 3));
+  outs.push_back(std::make_pair(20, 1));
+  outs.push_back(std::make_pair(20, 7));
+  outs.push_back(std::make_pair(30, 1));
+  outs.push_back(std::make_pair(0, 9));
+  outs.push_back(std::make_pair(30, 2));
+  ASSERT_TRUE(ringdb.blackball(outs));
+
+  for (const auto &out: outs)
+    ASSERT_TRUE(ringdb.blackballed(out));
+  ASSERT_TRUE(ringdb.blackballed(std::make_pair(10, 5)));
+  ASSERT_FALSE(ringdb.blackballed(std::make_pair(10, 4)));
+  ASSERT_FALSE(ringdb.blackballed(std::make_pair(20, 2)));
+  ASSERT_FALSE(ringdb.blackballed(std::make_pair(30, 3)));
+  ASSERT_FALSE(ringdb.blackballed(std::make_pair(40, 2)));
+}
+
+TEST(ringdb, set_rings)
+{
+  RingDB ringdb;
+  std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> rings;
+  for (uint64_t i = 0; i < 32; ++i)
+    rings.push_back(std::make_pair(generate_key_image(), std::vector<uint64_t>{i, i + 10, i + 200}));
+  ASSERT_TRUE(ringdb.set_rings(KEY_1, rings, false));
+  for (const auto &ring: rings)
+  {
+    std::vector<uint64_t> outs;
+    ASSERT_TRUE(ringdb.get_ring(KEY_1, ring.first, outs));
+    ASSERT_EQ(outs, ring.second);
+  }
+}
@@ -229,3 +229,78 @@ TEST(rolling_median, copy)
     ASSERT_EQ(m.median(), copy.median());
   }
 }
+
+TEST(rolling_median, undo_insert)
+{
+  epee::misc_utils::rolling_median_t<uint64_t> m(10);
+  std::vector<uint64_t> history;
+
+  for (int i = 0; i < 9; ++i)
+  {
+    history.push_back(rand() % 100);
+    m.insert(history.back());
+  }
+  ASSERT_FALSE(m.undo_insert(0));
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    history.push_back(rand() % 100);
+    m.insert(history.back());
+  }
+
+  // walk back to a full window, checking against a fresh median each step
+  while (history.size() > 10)
+  {
+    const uint64_t evicted = history[history.size() - 11];
+    history.pop_back();
+    ASSERT_TRUE(m.undo_insert(evicted));
+    ASSERT_EQ(m.size(), 10);
+    std::vector<uint64_t> window(history.end() - 10, history.end());
+    ASSERT_EQ(m.median(), epee::misc_utils::median(window));
+  }
+
+  // and forward again
+  for (int i = 0; i < 100; ++i)
+  {
+    history.push_back(rand() % 100);
+    m.insert(history.back());
+    std::vector<uint64_t> window(history.end() - 10, history.end());
+    ASSERT_EQ(m.median(), epee::misc_utils::median(window));
+  }
+}
+
+TEST(rolling_median, assign)
+{
+  // empty, partial, exactly full, and more than a window, with duplicates
+  for (size_t n: {0, 1, 2, 3, 7, 10, 11, 25})
+  {
+    epee::misc_utils::rolling_median_t<uint64_t> m(10);
+    std::vector<uint64_t> history;
+    for (size_t i = 0; i < n; ++i)
+      history.push_back(rand() % 20);
+    m.assign(history.begin(), history.end());
+    ASSERT_EQ(m.size(), std::min<size_t>(n, 10));
+    if (n > 0)
+    {
+      std::vector<uint64_t> window(history.end() - std::min<size_t>(n, 10), history.end());
+      ASSERT_EQ(m.median(), epee::misc_utils::median(window));
+    }
+
+    // the state is as if inserted one by one, so carries on in step
+    for (int i = 0; i < 100; ++i)
+    {
+      history.push_back(rand() % 20);
+      m.insert(history.back());
+      std::vector<uint64_t> window(history.end() - std::min<size_t>(history.size(), 10), history.end());
+      ASSERT_EQ(m.median(), epee::misc_utils::median(window));
+    }
+    while (history.size() > 10)
+    {
+      const uint64_t evicted = history[history.size() - 11];
+      history.pop_back();
+      ASSERT_TRUE(m.undo_insert(evicted));
+      std::vector<uint64_t> window(history.end() - 10, history.end());
+      ASSERT_EQ(m.median(), epee::misc_utils::median(window));
+    }
+  }
+}
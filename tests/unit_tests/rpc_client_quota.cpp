@@ -0,0 +1,81 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <chrono>
+#include "gtest/gtest.h"
+
+#include "rpc/rpc_client_quota.h"
+
+using quota_clock = cryptonote::rpc::client_quota::clock;
+
+TEST(rpc_client_quota, disabled_by_default)
+{
+  cryptonote::rpc::client_quota quota;
+  EXPECT_FALSE(quota.enabled());
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(quota.charge("1.2.3.0/24", 1000000));
+  EXPECT_EQ(0, quota.get_stats().clients);
+}
+
+TEST(rpc_client_quota, sheds_while_in_debt)
+{
+  cryptonote::rpc::client_quota quota;
+  quota.set_limits(10, 100);
+  ASSERT_TRUE(quota.enabled());
+
+  const quota_clock::time_point now = quota_clock::now();
+  EXPECT_TRUE(quota.charge("a", 60, now));
+  EXPECT_TRUE(quota.charge("a", 60, now));
+  // -20 credits, 2 seconds of refill before the next call gets in
+  EXPECT_FALSE(quota.charge("a", 1, now));
+  EXPECT_FALSE(quota.charge("a", 1, now + std::chrono::seconds(1)));
+  EXPECT_TRUE(quota.charge("a", 1, now + std::chrono::seconds(2)));
+
+  // other clients have their own bucket
+  EXPECT_TRUE(quota.charge("b", 1, now));
+
+  const auto stats = quota.get_stats();
+  EXPECT_EQ(4, stats.admitted);
+  EXPECT_EQ(2, stats.shed);
+  EXPECT_EQ(2, stats.clients);
+}
+
+TEST(rpc_client_quota, refill_is_capped_and_prunes)
+{
+  cryptonote::rpc::client_quota quota;
+  quota.set_limits(10, 100);
+
+  const quota_clock::time_point now = quota_clock::now();
+  EXPECT_TRUE(quota.charge("a", 100, now));
+  EXPECT_TRUE(quota.charge("b", 50, now));
+  // a long wait only refills up to the burst
+  EXPECT_TRUE(quota.charge("a", 101, now + std::chrono::hours(1)));
+  EXPECT_FALSE(quota.charge("a", 1, now + std::chrono::hours(1)));
+
+  quota.prune(now + std::chrono::hours(1));
+  EXPECT_EQ(1, quota.get_stats().clients);
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "rpc/rpc_request_gate.h"
+
+TEST(rpc_request_gate, sheds_over_limit)
+{
+  cryptonote::rpc::request_gate gate(2, 0, std::chrono::milliseconds(0));
+  {
+    const auto first = gate.enter();
+    const auto second = gate.enter();
+    EXPECT_TRUE(bool(first));
+    EXPECT_TRUE(bool(second));
+    EXPECT_FALSE(bool(gate.enter()));
+    EXPECT_EQ(2, gate.get_stats().running);
+  }
+  EXPECT_TRUE(bool(gate.enter()));
+
+  const auto stats = gate.get_stats();
+  EXPECT_EQ(3, stats.admitted);
+  EXPECT_EQ(1, stats.shed);
+  EXPECT_EQ(0, stats.running);
+  EXPECT_EQ(0, stats.queued);
+}
+
+TEST(rpc_request_gate, queued_request_gets_freed_slot)
+{
+  cryptonote::rpc::request_gate gate(1, 1, std::chrono::seconds(30));
+  std::atomic<bool> admitted{false};
+  std::thread waiter;
+  {
+    const auto running = gate.enter();
+    ASSERT_TRUE(bool(running));
+    waiter = std::thread([&]{ admitted = bool(gate.enter()); });
+    while (gate.get_stats().queued == 0)
+      std::this_thread::yield();
+    // the queue is full now
+    EXPECT_FALSE(bool(gate.enter()));
+    EXPECT_FALSE(admitted);
+  }
+  waiter.join();
+  EXPECT_TRUE(admitted);
+  EXPECT_EQ(2, gate.get_stats().admitted);
+  EXPECT_EQ(1, gate.get_stats().shed);
+}
+
+TEST(rpc_request_gate, queued_request_times_out)
+{
+  cryptonote::rpc::request_gate gate(1, 4, std::chrono::milliseconds(10));
+  const auto running = gate.enter();
+  ASSERT_TRUE(bool(running));
+  EXPECT_FALSE(bool(gate.enter()));
+  EXPECT_EQ(0, gate.get_stats().queued);
+
+  gate.set_limits(2, 4);
+  EXPECT_TRUE(bool(gate.enter()));
+}
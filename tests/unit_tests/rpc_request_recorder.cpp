@@ -0,0 +1,87 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "rpc/rpc_request_recorder.h"
+
+namespace
+{
+  std::vector<std::string> read_lines(const boost::filesystem::path &path)
+  {
+    std::ifstream f(path.string());
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(f, line); )
+      lines.push_back(line);
+    return lines;
+  }
+}
+
+TEST(rpc_request_recorder, rejects_bad_sample_rate)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  cryptonote::rpc::request_recorder recorder;
+  EXPECT_FALSE(recorder.open(path.string(), 0));
+  EXPECT_FALSE(recorder.open(path.string(), 1.5));
+  EXPECT_FALSE(recorder.enabled());
+  recorder.record("POST", "/get_info", 1, "{}");
+  EXPECT_FALSE(boost::filesystem::exists(path));
+}
+
+TEST(rpc_request_recorder, samples_evenly)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  {
+    cryptonote::rpc::request_recorder recorder;
+    ASSERT_TRUE(recorder.open(path.string(), 0.25));
+    for (int i = 0; i < 100; ++i)
+      recorder.record("POST", "/get_info", i, "{}");
+  }
+  EXPECT_EQ(25, read_lines(path).size());
+  boost::filesystem::remove(path);
+}
+
+TEST(rpc_request_recorder, line_format)
+{
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  {
+    cryptonote::rpc::request_recorder recorder;
+    ASSERT_TRUE(recorder.open(path.string(), 1));
+    recorder.record("POST", "/json_rpc", 42, "{\"a\":1}");
+    recorder.record("GET", "/metrics", 7, "");
+  }
+  const std::vector<std::string> lines = read_lines(path);
+  ASSERT_EQ(2, lines.size());
+  EXPECT_EQ("POST /json_rpc 42 7b2261223a317d", lines[0]);
+  EXPECT_EQ("GET /metrics 7 -", lines[1]);
+  boost::filesystem::remove(path);
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "rpc/rpc_response_cache.h"
+
+namespace
+{
+  typedef cryptonote::COMMAND_RPC_GET_BASE_FEE_ESTIMATE command;
+
+  command::request make_request(uint64_t grace_blocks)
+  {
+    command::request req;
+    req.grace_blocks = grace_blocks;
+    return req;
+  }
+}
+
+TEST(rpc_response_cache, hit_needs_same_request_and_tag)
+{
+  cryptonote::rpc::response_cache<command> cache("test");
+  const cryptonote::rpc::response_cache_tag tag{1, 100, 0};
+  const std::string key = cache.get_key(make_request(10));
+  ASSERT_FALSE(key.empty());
+  ASSERT_EQ(key, cache.get_key(make_request(10)));
+  ASSERT_NE(key, cache.get_key(make_request(11)));
+
+  command::response res;
+  ASSERT_FALSE(cache.get(key, tag, res));
+
+  res.fee = 42;
+  res.status = "OK";
+  cache.put(key, tag, res);
+
+  command::response cached;
+  ASSERT_TRUE(cache.get(key, tag, cached));
+  ASSERT_EQ(cached.fee, 42);
+  ASSERT_FALSE(cache.get(cache.get_key(make_request(11)), tag, cached));
+  ASSERT_FALSE(cache.get(key, {2, 100, 0}, cached));
+  ASSERT_FALSE(cache.get(key, {1, 99, 0}, cached));
+  ASSERT_FALSE(cache.get(key, {1, 100, 7}, cached));
+
+  const cryptonote::rpc::response_cache_stats stats = cache.get_stats();
+  ASSERT_EQ(stats.name, "test");
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 5);
+  ASSERT_EQ(stats.entries, 1);
+}
+
+TEST(rpc_response_cache, max_age)
+{
+  cryptonote::rpc::response_cache<command> cache("test", std::chrono::milliseconds(1));
+  const cryptonote::rpc::response_cache_tag tag{0, 1, 0};
+  const std::string key = cache.get_key(make_request(0));
+  command::response res;
+  cache.put(key, tag, res);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ASSERT_FALSE(cache.get(key, tag, res));
+}
+
+TEST(rpc_response_cache, bounded)
+{
+  cryptonote::rpc::response_cache<command> cache("test");
+  command::response res;
+  for (uint64_t i = 0; i < 4 * RPC_RESPONSE_CACHE_MAX_ENTRIES; ++i)
+    cache.put(cache.get_key(make_request(i)), {0, i, 0}, res);
+  ASSERT_LE(cache.get_stats().entries, RPC_RESPONSE_CACHE_MAX_ENTRIES);
+  ASSERT_TRUE(cache.get(cache.get_key(make_request(4 * RPC_RESPONSE_CACHE_MAX_ENTRIES - 1)), {0, 4 * RPC_RESPONSE_CACHE_MAX_ENTRIES - 1, 0}, res));
+}
@@ -202,6 +202,30 @@ TEST(Serialization, Overflow) {
   ASSERT_EQ(0, bigvector.size());
 }
 
+TEST(Serialization, serializes_vector_of_blobs)
+{
+  std::vector<crypto::hash> v(3);
+  for (std::size_t i = 0; i < v.size(); ++i)
+    v[i].data[i] = char(i + 1);
+
+  string blob;
+  ASSERT_TRUE(serialization::dump_binary(v, blob));
+  ASSERT_EQ(1 + v.size() * sizeof(crypto::hash), blob.size());
+
+  std::vector<crypto::hash> v1{crypto::null_hash};
+  ASSERT_TRUE(serialization::parse_binary(blob, v1));
+  ASSERT_EQ(v, v1);
+
+  // one byte short of the last element
+  blob.pop_back();
+  ASSERT_FALSE(serialization::parse_binary(blob, v1));
+
+  // count larger than the data left
+  blob = "\x04";
+  blob.append(3 * sizeof(crypto::hash), '\0');
+  ASSERT_FALSE(serialization::parse_binary(blob, v1));
+}
+
 TEST(Serialization, serializes_vector_uint64_as_varint)
 {
   std::vector<uint64_t> v;
@@ -465,6 +489,51 @@ TEST(Serialization, serializes_transacion_signatures_correctly)
   ASSERT_FALSE(serialization::parse_binary(blob, tx1));
 }
 
+TEST(Serialization, move_keeps_cached_hashes)
+{
+  using namespace cryptonote;
+
+  transaction tx;
+  tx.set_null();
+  txin_gen txin_gen1;
+  txin_gen1.height = 1;
+  tx.vin.push_back(txin_gen1);
+  const crypto::hash tx_hash = get_transaction_hash(tx);
+  ASSERT_TRUE(tx.is_hash_valid());
+
+  uint64_t tx_calculated0, tx_cached0, block_calculated0, block_cached0;
+  get_hash_stats(tx_calculated0, tx_cached0, block_calculated0, block_cached0);
+
+  transaction tx1(std::move(tx));
+  ASSERT_TRUE(tx1.is_hash_valid());
+  ASSERT_FALSE(tx.is_hash_valid());
+  transaction tx2;
+  tx2 = std::move(tx1);
+  ASSERT_TRUE(tx2.is_hash_valid());
+  ASSERT_FALSE(tx1.is_hash_valid());
+  ASSERT_EQ(tx_hash, get_transaction_hash(tx2));
+
+  block b;
+  b.miner_tx = std::move(tx2);
+  const crypto::hash block_hash = get_block_hash(b);
+  get_hash_stats(tx_calculated0, tx_cached0, block_calculated0, block_cached0);
+
+  block b1(std::move(b));
+  ASSERT_TRUE(b1.is_hash_valid());
+  ASSERT_FALSE(b.is_hash_valid());
+  block b2;
+  b2 = std::move(b1);
+  ASSERT_TRUE(b2.is_hash_valid());
+  ASSERT_TRUE(b2.miner_tx.is_hash_valid());
+  ASSERT_EQ(block_hash, get_block_hash(b2));
+
+  uint64_t tx_calculated1, tx_cached1, block_calculated1, block_cached1;
+  get_hash_stats(tx_calculated1, tx_cached1, block_calculated1, block_cached1);
+  ASSERT_EQ(tx_calculated0, tx_calculated1);
+  ASSERT_EQ(block_calculated0, block_calculated1);
+  ASSERT_EQ(block_cached0 + 1, block_cached1);
+}
+
 TEST(Serialization, serializes_ringct_types)
 {
   string blob;
@@ -82,6 +82,34 @@ TEST_F(WalletSubaddress, AddSubaddress)
   EXPECT_EQ(label, w1.get_subaddress_label({0, 1}));
 }
 
+TEST_F(WalletSubaddress, AddSubaddresses)
+{
+  std::string label = "test adding subaddresses";
+  const size_t lookahead = w1.get_subaddress_lookahead().second;
+  EXPECT_EQ(1, w1.add_subaddresses(0, 1000, label));
+  EXPECT_EQ(1001, w1.get_num_subaddresses(0));
+  EXPECT_EQ(test_label, w1.get_subaddress_label({0, 0}));
+  EXPECT_EQ(label, w1.get_subaddress_label({0, 1}));
+  EXPECT_EQ(label, w1.get_subaddress_label({0, 1000}));
+
+  // the batch is looked ahead past its last index, with the same keys one at a time would give
+  for (uint32_t minor: {1u, 500u, 1000u, (uint32_t)(1000 + lookahead - 1)})
+  {
+    const cryptonote::subaddress_index index = {0, minor};
+    const auto found = w1.get_subaddress_index(w1.get_subaddress(index));
+    ASSERT_TRUE(!!found);
+    EXPECT_EQ(index, *found);
+  }
+
+  const std::vector<std::string> addresses = w1.get_subaddresses_as_str(0, {1, 1000});
+  EXPECT_EQ(w1.get_subaddress_as_str({0, 1}), addresses[0]);
+  EXPECT_EQ(w1.get_subaddress_as_str({0, 1000}), addresses[1]);
+  EXPECT_NE(addresses[0], addresses[1]);
+
+  EXPECT_THROW(w1.add_subaddresses(0, 0, label), std::exception);
+  EXPECT_THROW(w1.add_subaddresses(2, 1, label), std::exception);
+}
+
 TEST_F(WalletSubaddress, OutOfBoundsIndexes)
 {
   try 
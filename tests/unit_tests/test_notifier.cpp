@@ -34,13 +34,13 @@
 
 int main(int argc, char **argv)
 {
-  if (argc < 3)
+  if (argc < 2)
   {
-    fprintf(stderr, "usage: %s <filename> <hash>\n", argv[0]);
+    fprintf(stderr, "usage: %s <filename> [<hash>]\n", argv[0]);
     return 1;
   }
   const char *filename = argv[1];
-  const char *hash = argv[2];
+  const char *hash = argc > 2 ? argv[2] : NULL;
 
   FILE *f = fopen(filename, "a+");
   if (!f)
@@ -48,7 +48,18 @@ int main(int argc, char **argv)
     fprintf(stderr, "error opening file %s: %s\n", filename, strerror(errno));
     return 1;
   }
-  fprintf(f, "%s", hash);
+  if (hash)
+    fprintf(f, "%s", hash);
+  else
+  {
+    // batched, copy lines from stdin until EOF
+    char line[256];
+    while (fgets(line, sizeof(line), stdin))
+    {
+      fputs(line, f);
+      fflush(f);
+    }
+  }
   fclose(f);
 
   return 0;
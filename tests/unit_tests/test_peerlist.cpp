@@ -82,6 +82,39 @@ TEST(peer_list, merge_peer_lists)
 #define ADD_NODE_TO_PL(ip_, port_, id_, timestamp_) {  nodetool::peerlist_entry ple; epee::string_tools::get_ip_int32_from_string(ple.adr.ip, ip_); ple.last_seen = timestamp_; ple.adr.port = port_; ple.id = id_;outer_bs.push_back(ple);}  
 }
 
+TEST(peer_list, version)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+  const uint64_t initial = plm.get_version();
+
+  nodetool::peerlist_entry ple{};
+  ple.adr = MAKE_IPV4_ADDRESS(123,43,12,1, 8080);
+  ple.id = 1;
+  ple.last_seen = 100;
+
+  ASSERT_TRUE(plm.append_with_peer_gray(ple));
+  const uint64_t after_gray = plm.get_version();
+  EXPECT_LT(initial, after_gray);
+  EXPECT_EQ(1u, plm.get_gray_peers_count());
+
+  // reading does not count as a change
+  nodetool::peerlist_entry out{};
+  ASSERT_TRUE(plm.get_random_gray_peer(out));
+  EXPECT_EQ(after_gray, plm.get_version());
+
+  // nor does removing an unknown peer
+  nodetool::peerlist_entry unknown = ple;
+  unknown.adr = MAKE_IPV4_ADDRESS(123,43,12,2, 8080);
+  ASSERT_TRUE(plm.remove_from_peer_white(unknown));
+  EXPECT_EQ(after_gray, plm.get_version());
+
+  ASSERT_TRUE(plm.append_with_peer_white(ple));
+  EXPECT_LT(after_gray, plm.get_version());
+  EXPECT_EQ(0u, plm.get_gray_peers_count());
+  EXPECT_EQ(1u, plm.get_white_peers_count());
+}
+
 namespace
 {
   bool check_empty(nodetool::peerlist_storage& peers, std::initializer_list<epee::net_utils::zone> zones)
@@ -33,7 +33,9 @@
 #include <vector>
 
 #include "common/util.h"
+#include "int-util.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/tx_extra.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 
@@ -357,3 +359,26 @@ TEST(remove_field_from_tx_extra, invalid_varint)
   ASSERT_FALSE(cryptonote::remove_field_from_tx_extra(extra, typeid(cryptonote::tx_extra_nonce)));
   ASSERT_EQ(sizeof(extra_arr), extra.size());
 }
+
+TEST(block_hashing_blob, nonce_offset)
+{
+  cryptonote::block b;
+  b.major_version = 16;
+  b.minor_version = 16;
+  b.timestamp = 1700000000;
+  b.prev_id = crypto::null_hash;
+  b.miner_tx.version = 2;
+  b.nonce = 0;
+
+  cryptonote::blobdata blob = cryptonote::get_block_hashing_blob(b);
+  const size_t offset = cryptonote::get_block_hashing_blob_nonce_offset(b);
+  ASSERT_LE(offset + sizeof(uint32_t), blob.size());
+
+  // patching the nonce in place must give the blob of the block with that nonce
+  const uint32_t nonce = 0x12345678;
+  const uint32_t le_nonce = SWAP32LE(nonce);
+  memcpy(&blob[offset], &le_nonce, sizeof(le_nonce));
+  b.nonce = nonce;
+  ASSERT_EQ(blob, cryptonote::get_block_hashing_blob(b));
+  ASSERT_EQ(0, memcmp(cryptonote::block_to_blob(b).data() + offset, &le_nonce, sizeof(le_nonce)));
+}
@@ -145,3 +145,44 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait();
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, stats)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  tools::threadpool::waiter waiter(*tpool);
+
+  std::atomic<int> counter(0);
+  for (int i = 0; i < 1000; ++i)
+    tpool->submit(&waiter, [&](){ ++counter; }, true);
+  ASSERT_TRUE(waiter.wait());
+  ASSERT_EQ(counter, 1000);
+
+  const tools::threadpool::stats stats = tpool->get_stats();
+  ASSERT_EQ(stats.threads, 3);
+  ASSERT_EQ(stats.submitted, 1000);
+  ASSERT_EQ(stats.inlined, 0);
+  ASSERT_EQ(stats.executed, 1000);
+  ASSERT_EQ(stats.queue_depth, 0);
+  ASSERT_LE(stats.steals, stats.executed);
+}
+
+TEST(threadpool, wait_runs_nested_leaves)
+{
+  // no worker threads: everything has to run from within wait
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(1));
+  tools::threadpool::waiter waiter(*tpool);
+
+  std::atomic<int> counter(0);
+  for (int i = 0; i < 10; ++i)
+  {
+    tpool->submit(&waiter, [&](){
+      tools::threadpool::waiter inner(*tpool);
+      for (int j = 0; j < 10; ++j)
+        tpool->submit(&inner, [&](){ ++counter; }, true);
+      inner.wait();
+    });
+  }
+  ASSERT_TRUE(waiter.wait());
+  ASSERT_EQ(counter, 100);
+  ASSERT_EQ(tpool->get_stats().threads, 0);
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/tx_pool.h"
+
+namespace
+{
+  crypto::hash make_hash(uint8_t n)
+  {
+    crypto::hash h = crypto::null_hash;
+    h.data[0] = n;
+    return h;
+  }
+}
+
+TEST(sorted_tx_container, orders_by_fee_then_time)
+{
+  cryptonote::sorted_tx_container txs;
+  txs.emplace({1.0, 100}, make_hash(1), 0);
+  txs.emplace({3.0, 100}, make_hash(2), 0);
+  txs.emplace({1.0, 50}, make_hash(3), 0);
+  txs.emplace({1.0, 50}, make_hash(4), 0);
+  ASSERT_EQ(txs.size(), 4);
+
+  auto it = txs.begin();
+  ASSERT_EQ(it->second, make_hash(2));
+  ++it;
+  ASSERT_EQ(it->second, make_hash(3));
+  ++it;
+  ASSERT_EQ(it->second, make_hash(4));
+  ++it;
+  ASSERT_EQ(it->second, make_hash(1));
+}
+
+TEST(sorted_tx_container, find_erase)
+{
+  cryptonote::sorted_tx_container txs;
+  for (uint8_t i = 0; i < 10; ++i)
+    txs.emplace({double(i), 0}, make_hash(i), 0);
+
+  ASSERT_EQ(txs.find(make_hash(4))->first.first, 4.0);
+  ASSERT_TRUE(txs.find(make_hash(10)) == txs.end());
+
+  ASSERT_TRUE(txs.erase(make_hash(4)));
+  ASSERT_FALSE(txs.erase(make_hash(4)));
+  ASSERT_TRUE(txs.find(make_hash(4)) == txs.end());
+
+  auto it = txs.erase(txs.find(make_hash(9)));
+  ASSERT_EQ(it->second, make_hash(8));
+  ASSERT_TRUE(txs.find(make_hash(9)) == txs.end());
+  ASSERT_EQ(txs.size(), 8);
+
+  txs.clear();
+  ASSERT_TRUE(txs.empty());
+  ASSERT_TRUE(txs.find(make_hash(1)) == txs.end());
+}
+
+TEST(sorted_tx_container, reemplace_replaces)
+{
+  cryptonote::sorted_tx_container txs;
+  txs.emplace({1.0, 10}, make_hash(1), 0);
+  txs.emplace({2.0, 10}, make_hash(2), 0);
+  txs.emplace({5.0, 20}, make_hash(1), 0);
+  ASSERT_EQ(txs.size(), 2);
+  ASSERT_EQ(txs.begin()->second, make_hash(1));
+  ASSERT_EQ(txs.find(make_hash(1))->first.first, 5.0);
+}
+
+TEST(sorted_tx_container, expiry)
+{
+  cryptonote::sorted_tx_container txs;
+  txs.emplace({1.0, 10}, make_hash(1), 300);
+  txs.emplace({2.0, 10}, make_hash(2), 100);
+  txs.emplace({3.0, 10}, make_hash(3), 200);
+  ASSERT_TRUE(txs.get_expired(100).empty());
+  ASSERT_EQ(txs.get_expired(201), std::vector<crypto::hash>({make_hash(2), make_hash(3)}));
+
+  txs.erase(make_hash(2));
+  txs.erase(txs.find(make_hash(3)));
+  ASSERT_TRUE(txs.get_expired(201).empty());
+
+  txs.emplace({1.0, 10}, make_hash(1), 50);
+  ASSERT_EQ(txs.get_expired(201), std::vector<crypto::hash>({make_hash(1)}));
+
+  txs.clear();
+  ASSERT_TRUE(txs.get_expired(1000).empty());
+}
+
+TEST(fee_rate_quantiles, weighted_by_bytes)
+{
+  std::map<uint64_t, cryptonote::txpool_histo> by_fee_rate;
+  by_fee_rate[10] = {1, 1000};
+  by_fee_rate[20] = {2, 2000};
+  by_fee_rate[80] = {1, 7000};
+
+  cryptonote::fee_rate_quantiles quantiles;
+  cryptonote::get_fee_rate_quantiles(by_fee_rate, {0, 10, 11, 30, 50, 100, 1000}, quantiles);
+  ASSERT_EQ(quantiles.txs, 4);
+  ASSERT_EQ(quantiles.bytes, 10000);
+  ASSERT_EQ(quantiles.fee_rates, std::vector<uint64_t>({10, 10, 20, 20, 80, 80, 80}));
+}
+
+TEST(fee_rate_quantiles, empty)
+{
+  cryptonote::fee_rate_quantiles quantiles;
+  cryptonote::get_fee_rate_quantiles({}, {50}, quantiles);
+  ASSERT_EQ(quantiles.txs, 0);
+  ASSERT_EQ(quantiles.bytes, 0);
+  ASSERT_EQ(quantiles.fee_rates, std::vector<uint64_t>({0}));
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include "crypto/crypto.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol/tx_sketch.h"
+
+namespace
+{
+  std::vector<uint64_t> make_ids(size_t count)
+  {
+    std::vector<uint64_t> ids;
+    for (size_t i = 0; i < count; ++i)
+      ids.push_back(crypto::rand<uint64_t>() & ((uint64_t(1) << 48) - 1));
+    return ids;
+  }
+
+  bool reconcile(const std::vector<uint64_t> &common, const std::vector<uint64_t> &local, const std::vector<uint64_t> &remote, size_t cells, std::vector<uint64_t> &local_only, std::vector<uint64_t> &remote_only)
+  {
+    cryptonote::tx_sketch local_sketch(cells), remote_sketch(cells);
+    for (uint64_t id: common)
+    {
+      local_sketch.add(id);
+      remote_sketch.add(id);
+    }
+    for (uint64_t id: local)
+      local_sketch.add(id);
+    for (uint64_t id: remote)
+      remote_sketch.add(id);
+
+    // over the wire
+    cryptonote::tx_sketch received;
+    if (!received.parse(remote_sketch.serialize()))
+      return false;
+    if (!local_sketch.subtract(received))
+      return false;
+    if (!local_sketch.decode(local_only, remote_only))
+      return false;
+    std::sort(local_only.begin(), local_only.end());
+    std::sort(remote_only.begin(), remote_only.end());
+    return true;
+  }
+}
+
+TEST(tx_sketch, decode)
+{
+  const std::vector<uint64_t> common = make_ids(1000);
+  std::vector<uint64_t> local = make_ids(30), remote = make_ids(20);
+  std::sort(local.begin(), local.end());
+  std::sort(remote.begin(), remote.end());
+
+  std::vector<uint64_t> local_only, remote_only;
+  const size_t cells = cryptonote::tx_sketch::get_cell_count(common.size() + local.size(), 100);
+  ASSERT_TRUE(reconcile(common, local, remote, cells, local_only, remote_only));
+  ASSERT_EQ(local_only, local);
+  ASSERT_EQ(remote_only, remote);
+}
+
+TEST(tx_sketch, identical)
+{
+  const std::vector<uint64_t> common = make_ids(500);
+  std::vector<uint64_t> local_only, remote_only;
+  ASSERT_TRUE(reconcile(common, {}, {}, 12, local_only, remote_only));
+  ASSERT_TRUE(local_only.empty());
+  ASSERT_TRUE(remote_only.empty());
+}
+
+TEST(tx_sketch, too_small)
+{
+  std::vector<uint64_t> local_only, remote_only;
+  ASSERT_FALSE(reconcile(make_ids(100), make_ids(200), make_ids(200), 30, local_only, remote_only));
+}
+
+TEST(tx_sketch, cell_count)
+{
+  ASSERT_EQ(cryptonote::tx_sketch::get_cell_count(0, 0) % 3, 0);
+  ASSERT_GE(cryptonote::tx_sketch::get_cell_count(0, 0), 12);
+  ASSERT_GE(cryptonote::tx_sketch::get_cell_count(100, 10), 2 * 90);
+  ASSERT_EQ(cryptonote::tx_sketch::get_cell_count(1000000, 0), CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS);
+}
+
+TEST(tx_sketch, parse)
+{
+  cryptonote::tx_sketch sketch(30);
+  ASSERT_EQ(sketch.cells(), 30);
+  sketch.add(42);
+  const std::string blob = sketch.serialize();
+  ASSERT_EQ(blob.size(), 30 * TX_SKETCH_CELL_SIZE);
+
+  cryptonote::tx_sketch parsed;
+  ASSERT_TRUE(parsed.parse(blob));
+  ASSERT_EQ(parsed.serialize(), blob);
+  std::vector<uint64_t> local_only, remote_only;
+  ASSERT_TRUE(parsed.decode(local_only, remote_only));
+  ASSERT_EQ(local_only, std::vector<uint64_t>{42});
+  ASSERT_TRUE(remote_only.empty());
+
+  ASSERT_FALSE(parsed.parse(""));
+  ASSERT_FALSE(parsed.parse(blob.substr(TX_SKETCH_CELL_SIZE)));
+  ASSERT_FALSE(parsed.parse(std::string((CRYPTONOTE_TX_RECONCILIATION_MAX_SKETCH_CELLS + 3) * TX_SKETCH_CELL_SIZE, '\0')));
+  ASSERT_FALSE(parsed.subtract(cryptonote::tx_sketch(60)));
+}
+
+TEST(tx_sketch, garbage)
+{
+  // random cells must not keep the peeling going forever
+  std::string blob(300 * TX_SKETCH_CELL_SIZE, '\0');
+  for (char &c: blob)
+    c = crypto::rand<char>();
+  cryptonote::tx_sketch sketch;
+  ASSERT_TRUE(sketch.parse(blob));
+  std::vector<uint64_t> local_only, remote_only;
+  ASSERT_FALSE(sketch.decode(local_only, remote_only));
+}
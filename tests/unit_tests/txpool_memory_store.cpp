@@ -0,0 +1,151 @@
+// Copyright (c) 2022, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <unordered_map>
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/testdb.h"
+#include "cryptonote_core/txpool_memory_store.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  // the txpool tables and nothing else
+  class TestDB: public BaseTestDB
+  {
+  public:
+    virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const txpool_tx_meta_t& meta) override {
+      ++writes;
+      txes[txid] = {meta, cryptonote::blobdata(blob.data(), blob.size())};
+    }
+    virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta) override {
+      ++writes;
+      txes.at(txid).first = meta;
+    }
+    virtual void remove_txpool_tx(const crypto::hash& txid) override {
+      ++writes;
+      txes.erase(txid);
+    }
+    virtual bool txpool_has_tx(const crypto::hash &txid, relay_category tx_category) const override {
+      return txes.find(txid) != txes.end();
+    }
+    virtual bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob = false, relay_category category = relay_category::broadcasted) const override {
+      for (const auto &e: txes)
+      {
+        const cryptonote::blobdata_ref bd{e.second.second};
+        if (!f(e.first, e.second.first, &bd))
+          return false;
+      }
+      return true;
+    }
+
+    std::unordered_map<crypto::hash, std::pair<txpool_tx_meta_t, cryptonote::blobdata>> txes;
+    size_t writes = 0;
+  };
+
+  crypto::hash make_txid(unsigned char n)
+  {
+    crypto::hash h = crypto::null_hash;
+    h.data[0] = n;
+    return h;
+  }
+
+  txpool_tx_meta_t make_meta(relay_method method, uint64_t fee)
+  {
+    txpool_tx_meta_t meta{};
+    meta.set_relay_method(method);
+    meta.fee = fee;
+    return meta;
+  }
+}
+
+TEST(txpool_memory_store, mirrors_db_semantics)
+{
+  txpool_memory_store store;
+  store.add_tx(make_txid(1), "blob1", make_meta(relay_method::fluff, 10));
+  store.add_tx(make_txid(2), "blob2", make_meta(relay_method::local, 20));
+  EXPECT_THROW(store.add_tx(make_txid(1), "blob1", make_meta(relay_method::fluff, 10)), DB_ERROR);
+  EXPECT_THROW(store.update_tx(make_txid(3), make_meta(relay_method::fluff, 30)), DB_ERROR);
+
+  EXPECT_EQ(2, store.get_tx_count(relay_category::all));
+  EXPECT_EQ(1, store.get_tx_count(relay_category::broadcasted));
+
+  cryptonote::blobdata bd;
+  EXPECT_TRUE(store.get_tx_blob(make_txid(1), bd, relay_category::broadcasted));
+  EXPECT_EQ("blob1", bd);
+  EXPECT_FALSE(store.get_tx_blob(make_txid(2), bd, relay_category::broadcasted));
+  EXPECT_TRUE(store.get_tx_blob(make_txid(2), bd, relay_category::all));
+  EXPECT_EQ("blob2", bd);
+
+  store.update_tx(make_txid(2), make_meta(relay_method::fluff, 25));
+  txpool_tx_meta_t meta;
+  ASSERT_TRUE(store.get_tx_meta(make_txid(2), meta));
+  EXPECT_EQ(25, meta.fee);
+
+  store.remove_tx(make_txid(1));
+  store.remove_tx(make_txid(1));
+  EXPECT_FALSE(store.get_tx_meta(make_txid(1), meta));
+  size_t seen = 0;
+  EXPECT_TRUE(store.for_all_txes([&seen](const crypto::hash &txid, const txpool_tx_meta_t&, const cryptonote::blobdata_ref *bd) {
+    ++seen;
+    EXPECT_EQ(make_txid(2), txid);
+    EXPECT_EQ("blob2", *bd);
+    return true;
+  }, true, relay_category::all));
+  EXPECT_EQ(1, seen);
+}
+
+TEST(txpool_memory_store, snapshot_writes_changes_only)
+{
+  TestDB db;
+  db.txes[make_txid(1)] = {make_meta(relay_method::fluff, 10), "blob1"};
+  db.txes[make_txid(2)] = {make_meta(relay_method::fluff, 20), "blob2"};
+
+  txpool_memory_store store;
+  EXPECT_EQ(2, store.load(db));
+  EXPECT_EQ(0, store.pending_changes());
+  EXPECT_EQ(0, store.write_snapshot(db));
+  EXPECT_EQ(0, db.writes);
+
+  store.remove_tx(make_txid(1));
+  store.update_tx(make_txid(2), make_meta(relay_method::fluff, 21));
+  store.add_tx(make_txid(3), "blob3", make_meta(relay_method::fluff, 30));
+  // added and removed between snapshots, which only costs a no-op removal
+  store.add_tx(make_txid(4), "blob4", make_meta(relay_method::fluff, 40));
+  store.remove_tx(make_txid(4));
+  EXPECT_EQ(4, store.pending_changes());
+
+  EXPECT_EQ(4, store.write_snapshot(db));
+  EXPECT_EQ(0, store.pending_changes());
+  ASSERT_EQ(2, db.txes.size());
+  EXPECT_EQ(21, db.txes.at(make_txid(2)).first.fee);
+  EXPECT_EQ("blob2", db.txes.at(make_txid(2)).second);
+  EXPECT_EQ("blob3", db.txes.at(make_txid(3)).second);
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2022, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+// reaches the wallet2 internals refresh and scan_tx go through
+class wallet_accessor_test
+{
+public:
+  static void extend_blockchain(tools::wallet2 &wallet, uint64_t height)
+  {
+    while (wallet.m_blockchain.size() < height)
+      wallet.m_blockchain.push_back(crypto::rand<crypto::hash>());
+  }
+
+  // the call scan_tx makes for each tx it fetches, refresh makes the same one for block txes
+  static void process_new_transaction(tools::wallet2 &wallet, const cryptonote::transaction &tx, uint64_t global_index, uint64_t height)
+  {
+    wallet.process_new_transaction(cryptonote::get_transaction_hash(tx), tx, {global_index}, height, HF_VERSION_VIEW_TAGS, 0, false, false, false, {}, {});
+  }
+
+  static void detach_blockchain(tools::wallet2 &wallet, uint64_t height)
+  {
+    wallet.detach_blockchain(height);
+  }
+
+  static size_t num_key_images(const tools::wallet2 &wallet) { return wallet.m_key_images.size(); }
+  static size_t num_pub_keys(const tools::wallet2 &wallet) { return wallet.m_pub_keys.size(); }
+};
+
+namespace
+{
+  // a single output tx paying amount to the wallet's main address
+  cryptonote::transaction make_tx(const tools::wallet2 &wallet, uint64_t amount)
+  {
+    const cryptonote::account_public_address &destination = wallet.get_account().get_keys().m_account_address;
+    cryptonote::transaction tx;
+    tx.version = 2;
+    tx.unlock_time = 0;
+    cryptonote::txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.assign(16, 1);
+    in.k_image = rct::rct2ki(rct::pkGen());
+    tx.vin.push_back(in);
+
+    const crypto::secret_key r = rct::rct2sk(rct::skGen());
+    crypto::key_derivation derivation;
+    crypto::generate_key_derivation(destination.m_view_public_key, r, derivation);
+    cryptonote::add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::scalarmultBase(rct::sk2rct(r))));
+
+    cryptonote::txout_to_tagged_key tk;
+    crypto::derive_public_key(derivation, 0, destination.m_spend_public_key, tk.key);
+    crypto::derive_view_tag(derivation, 0, tk.view_tag);
+    tx.vout.push_back({0, tk});
+
+    crypto::secret_key scalar;
+    crypto::derivation_to_scalar(derivation, 0, scalar);
+    const rct::key shared_secret = rct::sk2rct(scalar);
+    tx.rct_signatures.type = rct::RCTTypeBulletproofPlus;
+    tx.rct_signatures.txnFee = 30000000;
+    rct::ecdhTuple ecdh;
+    ecdh.mask = rct::zero();
+    ecdh.amount = rct::d2h(amount);
+    rct::ecdhEncode(ecdh, shared_secret, true);
+    tx.rct_signatures.ecdhInfo.push_back(ecdh);
+    tx.rct_signatures.outPk.push_back({rct::pk2rct(tk.key), rct::commit(amount, rct::genCommitmentMask(shared_secret))});
+    return tx;
+  }
+}
+
+TEST(wallet_reorg, detach_after_out_of_order_scan_tx)
+{
+  tools::wallet2 w;
+  w.generate("", "", rct::rct2sk(rct::skGen()), true, false);
+  const uint64_t H = 100;
+  wallet_accessor_test::extend_blockchain(w, H + 4);
+
+  // refresh finds Y at H-1 and X at H+3, then scan_tx adds S at H after them
+  wallet_accessor_test::process_new_transaction(w, make_tx(w, 1000), 0, H - 1);
+  wallet_accessor_test::process_new_transaction(w, make_tx(w, 2000), 2, H + 3);
+  wallet_accessor_test::process_new_transaction(w, make_tx(w, 4000), 1, H);
+  ASSERT_EQ(w.get_num_transfer_details(), 3);
+  ASSERT_EQ(w.balance(0, false), 7000);
+
+  // X's block is orphaned, and S goes with it since it was appended after X
+  wallet_accessor_test::detach_blockchain(w, H + 2);
+  ASSERT_EQ(w.get_num_transfer_details(), 1);
+  ASSERT_EQ(w.get_transfer_details(0).m_block_height, H - 1);
+  ASSERT_EQ(w.balance(0, false), 1000);
+  ASSERT_EQ(wallet_accessor_test::num_key_images(w), 1);
+  ASSERT_EQ(wallet_accessor_test::num_pub_keys(w), 1);
+
+  // the reorg index kept from the first detach still matches the shortened transfers
+  wallet_accessor_test::extend_blockchain(w, H + 3);
+  wallet_accessor_test::process_new_transaction(w, make_tx(w, 8000), 3, H + 2);
+  ASSERT_EQ(w.balance(0, false), 9000);
+  wallet_accessor_test::detach_blockchain(w, H + 2);
+  ASSERT_EQ(w.get_num_transfer_details(), 1);
+  ASSERT_EQ(w.balance(0, false), 1000);
+}
@@ -28,6 +28,7 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/preprocessor/stringize.hpp>
+#include <boost/thread/future.hpp>
 #include <gtest/gtest.h>
 #include <rapidjson/document.h>
 
@@ -41,6 +42,8 @@
 #include "rpc/zmq_pub.h"
 #include "rpc/zmq_server.h"
 #include "serialization/json_object.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
 
 #define MASSERT(...)                                                      \
   if (!(__VA_ARGS__))                                                     \
@@ -120,6 +123,66 @@ namespace
     return out;
   }
 
+  struct bin_chain
+  {
+    std::uint64_t first_height;
+    std::vector<cryptonote::blobdata> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(first_height)
+      KV_SERIALIZE(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_txpool_entry
+  {
+    crypto::hash id;
+    cryptonote::blobdata blob;
+    std::uint64_t weight;
+    std::uint64_t fee;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB(id)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(weight)
+      KV_SERIALIZE(fee)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_txpool
+  {
+    std::uint64_t sequence;
+    std::vector<bin_txpool_entry> txes;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(sequence)
+      KV_SERIALIZE(txes)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  template<typename T>
+  std::vector<std::pair<std::string, T>> get_published_bin(void* socket, int count = -1)
+  {
+    std::vector<std::pair<std::string, T>> out;
+
+    const auto messages = get_messages(socket, count);
+    out.reserve(messages.size());
+
+    for (const std::string& message : messages)
+    {
+      const std::size_t split = message.find(':');
+      if (split == std::string::npos)
+        throw std::runtime_error{"Invalid ZMQ/Pub message"};
+
+      out.emplace_back();
+      out.back().first = message.substr(0, split);
+      if (!epee::serialization::load_t_from_binary(out.back().second, message.substr(split + 1)))
+        throw std::runtime_error{"Failed to parse ZMQ/Pub message"};
+    }
+
+    return out;
+  }
+
   testing::AssertionResult compare_full_txpool(epee::span<const cryptonote::txpool_event> events, const published_json& pub)
   {
     MASSERT(pub.first == "json-full-txpool_add");
@@ -310,6 +373,23 @@ namespace
     }
   };
 
+  struct echo_handler final : cryptonote::rpc::RpcHandler
+  {
+    boost::promise<void> release;
+    boost::shared_future<void> released;
+
+    echo_handler()
+      : cryptonote::rpc::RpcHandler(), release(), released(release.get_future().share())
+    {}
+
+    virtual epee::byte_slice handle(std::string&& request) override final
+    {
+      if (request == "slow")
+        released.wait_for(boost::chrono::seconds{10});
+      return epee::byte_slice{std::move(request)};
+    }
+  };
+
   struct zmq_server : public zmq_base
   {
     dummy_handler handler;
@@ -470,6 +550,115 @@ TEST_F(zmq_pub, JsonMinimalTxpool)
   EXPECT_TRUE(compare_minimal_txpool(epee::to_span(events), pubs.front()));
 }
 
+TEST_F(zmq_pub, BinFullTxpool)
+{
+  static constexpr const char topic[] = "\1bin-full-txpool_add";
+
+  ASSERT_TRUE(sub_request(topic));
+
+  std::vector<cryptonote::txpool_event> events
+  {
+   {make_transaction(), {}, true}, {make_transaction(), {}, true}
+  };
+  for (cryptonote::txpool_event& event : events)
+  {
+    event.hash = cryptonote::get_transaction_hash(event.tx);
+    event.weight = 100;
+  }
+
+  events.at(0).res = false;
+  EXPECT_EQ(1u, pub->send_txpool_add(events));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  const auto pubs = get_published_bin<bin_txpool>(dummy_client.get());
+  ASSERT_EQ(1u, pubs.size());
+  EXPECT_EQ("bin-full-txpool_add", pubs.front().first);
+  ASSERT_EQ(1u, pubs.front().second.txes.size());
+
+  const bin_txpool_entry& entry = pubs.front().second.txes.front();
+  EXPECT_EQ(events.at(1).hash, entry.id);
+  EXPECT_EQ(cryptonote::tx_to_blob(events.at(1).tx), entry.blob);
+  EXPECT_EQ(100u, entry.weight);
+  EXPECT_EQ(cryptonote::get_tx_fee(events.at(1).tx), entry.fee);
+}
+
+TEST_F(zmq_pub, ReplayTxpool)
+{
+  static constexpr const char topic[] = "\1bin-full-txpool_add";
+
+  // history is kept even without subscribers
+  std::vector<cryptonote::txpool_event> events{{make_transaction(), {}, true}};
+  EXPECT_EQ(0u, pub->send_txpool_add(events));
+
+  ASSERT_TRUE(sub_request(topic));
+
+  events = {{make_transaction(), {}, true}};
+  EXPECT_EQ(1u, pub->send_txpool_add(events));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  auto pubs = get_published_bin<bin_txpool>(dummy_client.get());
+  ASSERT_EQ(1u, pubs.size());
+  const std::uint64_t last = pubs.front().second.sequence;
+  ASSERT_LT(1u, last);
+
+  const std::string replay = "\1replay:bin-full-txpool_add:" + std::to_string(last - 1);
+  EXPECT_TRUE(pub->sub_request(replay));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  pubs = get_published_bin<bin_txpool>(dummy_client.get());
+  ASSERT_EQ(2u, pubs.size());
+  EXPECT_EQ(last - 1, pubs[0].second.sequence);
+  EXPECT_EQ(last, pubs[1].second.sequence);
+  EXPECT_EQ(1u, pubs[1].second.txes.size());
+
+  EXPECT_TRUE(sub_request("\0replay:bin-full-txpool_add:0"));
+  EXPECT_FALSE(sub_request("\1replay:bin-full-txpool_add"));
+  EXPECT_FALSE(sub_request("\1replay:bin-full:0"));
+}
+
+TEST_F(zmq_pub, ReplayChain)
+{
+  static constexpr const char topic[] = "\1bin-full-chain_main";
+
+  const std::array<cryptonote::block, 3> blocks{{make_block(), make_block(), make_block()}};
+  EXPECT_EQ(0u, pub->send_chain_main(100, {blocks.data(), 2}));
+
+  // reorg replacing block 101
+  EXPECT_EQ(0u, pub->send_chain_main(101, {blocks.data() + 2, 1}));
+
+  ASSERT_TRUE(sub_request(topic));
+  EXPECT_TRUE(sub_request("\1replay:bin-full-chain_main:50"));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  const auto pubs = get_published_bin<bin_chain>(dummy_client.get());
+  ASSERT_EQ(1u, pubs.size());
+  EXPECT_EQ(100u, pubs.front().second.first_height);
+  ASSERT_EQ(2u, pubs.front().second.blocks.size());
+  EXPECT_EQ(cryptonote::block_to_blob(blocks[0]), pubs.front().second.blocks[0]);
+  EXPECT_EQ(cryptonote::block_to_blob(blocks[2]), pubs.front().second.blocks[1]);
+}
+
+TEST_F(zmq_pub, BinFullChain)
+{
+  static constexpr const char topic[] = "\1bin-full-chain_main";
+
+  ASSERT_TRUE(sub_request(topic));
+
+  const std::array<cryptonote::block, 2> blocks{{make_block(), make_block()}};
+
+  EXPECT_EQ(1u, pub->send_chain_main(100, epee::to_span(blocks)));
+  EXPECT_TRUE(pub->relay_to_pub(relay.get(), dummy_pub.get()));
+
+  const auto pubs = get_published_bin<bin_chain>(dummy_client.get());
+  ASSERT_EQ(1u, pubs.size());
+  EXPECT_EQ("bin-full-chain_main", pubs.front().first);
+  EXPECT_EQ(100u, pubs.front().second.first_height);
+  ASSERT_EQ(blocks.size(), pubs.front().second.blocks.size());
+  for (std::size_t i = 0; i < blocks.size(); ++i)
+    EXPECT_EQ(cryptonote::block_to_blob(blocks[i]), pubs.front().second.blocks[i]);
+}
+
 TEST_F(zmq_pub, JsonFullChain)
 {
   static constexpr const char topic[] = "\1json-full-chain_main";
@@ -775,3 +964,52 @@ TEST_F(zmq_server, pub)
   EXPECT_TRUE(compare_minimal_txpool(epee::to_span(events), pubs.front()));
   EXPECT_TRUE(compare_minimal_block(200, epee::to_span(blocks), pubs.back()));
 }
+
+TEST(ZmqServer, SlowRequestDoesNotBlock)
+{
+  echo_handler handler{};
+  cryptonote::rpc::ZmqServer server{handler};
+  void* const ctx = server.init_rpc("127.0.0.1", "38391", 2);
+  ASSERT_NE(nullptr, ctx);
+  server.run();
+
+  const auto connect = [ctx] ()
+  {
+    net::zmq::socket client{zmq_socket(ctx, ZMQ_REQ)};
+    if (!client)
+      MONERO_ZMQ_THROW("failed to create socket");
+    static constexpr const int timeout = 5000;
+    if (zmq_setsockopt(client.get(), ZMQ_RCVTIMEO, std::addressof(timeout), sizeof(timeout)) != 0)
+      MONERO_ZMQ_THROW("failed to set receive timeout");
+    if (zmq_connect(client.get(), "tcp://127.0.0.1:38391") != 0)
+      MONERO_ZMQ_THROW("failed to connect to server");
+    return client;
+  };
+  net::zmq::socket slow = connect();
+  net::zmq::socket fast = connect();
+
+  const std::string slow_request = "slow";
+  const std::string fast_request = "fast";
+  ASSERT_TRUE(net::zmq::send(epee::strspan<std::uint8_t>(slow_request), slow.get()));
+  ASSERT_TRUE(net::zmq::send(epee::strspan<std::uint8_t>(fast_request), fast.get()));
+
+  const expect<std::string> fast_reply = net::zmq::receive(fast.get());
+  handler.release.set_value();
+  const expect<std::string> slow_reply = net::zmq::receive(slow.get());
+
+  ASSERT_TRUE(fast_reply);
+  EXPECT_EQ(fast_request, *fast_reply);
+  ASSERT_TRUE(slow_reply);
+  EXPECT_EQ(slow_request, *slow_reply);
+
+  slow.reset();
+  fast.reset();
+  server.stop();
+}
+
+TEST(ZmqServer, InvalidThreads)
+{
+  dummy_handler handler{};
+  cryptonote::rpc::ZmqServer server{handler};
+  EXPECT_EQ(nullptr, server.init_rpc("127.0.0.1", "38392", 0));
+}
@@ -16,6 +16,7 @@ complete -c monerod -l proxy -r -d "Network communication through proxy: <socks-
 complete -c monerod -l proxy-allow-dns-leaks -d "Allow DNS leaks outside of proxy"
 complete -c monerod -l public-node -d "Allow other users to use the node as a remote (restricted RPC mode, view-only commands) and advertise it over P2P"
 complete -c monerod -l zmq-rpc-bind-ip -r -d "IP for ZMQ RPC server to listen on. Default: 127.0.0.1"
+complete -c monerod -l zmq-rpc-threads -r -d "Number of threads handling ZMQ RPC requests. Default: 1"
 complete -c monerod -l zmq-rpc-bind-port -r -d "Port for ZMQ RPC server to listen on. Default: 18082, 28082 if 'testnet', 38082 if 'stagenet'"
 complete -c monerod -l zmq-pub -r -d "Address for ZMQ pub - tcp://ip:port or ipc://path "
 complete -c monerod -l no-zmq -d "Disable ZMQ RPC server [114/349]"
@@ -29,6 +30,7 @@ complete -c monerod -l keep-fakechain -d "Don't delete any existing database whe
 complete -c monerod -l fixed-difficulty -r -d "Fixed difficulty used for testing. Default: 0"
 complete -c monerod -l enforce-dns-checkpointing -d "checkpoints from DNS server will be enforced"
 complete -c monerod -l prep-blocks-threads -r -d "Max number of threads to use when preparing block hashes in groups. Default: 4"
+complete -c monerod -l prep-historical-blocks-threads -r -d "Max number of threads to use when preparing pre-RandomX block hashes, 0 for all. Default: 0"
 complete -c monerod -l fast-block-sync -r -d "Sync up most of the way by using embedded, known block hashes. Default: 1"
 complete -c monerod -l show-time-stats -r -d "(=0) Show time-stats when processing blocks/txs and disk synchronization. Default: 0"
 complete -c monerod -l block-sync-size -r -d "(=0) How many blocks to sync at once during chain synchronization (0 = adaptive). Default: 0"
@@ -39,6 +41,7 @@ complete -c monerod -l test-dbg-lock-sleep -r -d "Sleep time in ms, defaults to
 complete -c monerod -l offline -d "Do not listen for peers, nor connect to any"
 complete -c monerod -l disable-dns-checkpoints -d "Do not retrieve checkpoints from DNS"
 complete -c monerod -l block-download-max-size -r -d "Set maximum size of block download queue in bytes (0 for default)"
+complete -c monerod -l block-download-spill-size -r -d "Move downloaded blocks past the block download queue size to disk, up to this many bytes (0 to disable)"
 complete -c monerod -l sync-pruned-blocks -d "Allow syncing from nodes with only pruned blocks"
 complete -c monerod -l max-txpool-weight -r -d "Set maximum txpool weight in bytes. Default: 648000000"
 complete -c monerod -l block-notify -r -d "Run a program for each new block, '%s' will be replaced by the block hash"
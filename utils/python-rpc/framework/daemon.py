@@ -455,6 +455,13 @@ class Daemon(object):
         }
         return self.rpc.send_request('/is_key_image_spent', is_key_image_spent)
 
+    def get_outputs_by_pubkey(self, keys = [], client = ""):
+        get_outputs_by_pubkey = {
+            'keys': keys,
+            'client': client,
+        }
+        return self.rpc.send_request('/get_outputs_by_pubkey', get_outputs_by_pubkey)
+
     def save_bc(self):
         save_bc = {
         }
@@ -481,6 +488,20 @@ class Daemon(object):
         }
         return self.rpc.send_request('/get_net_stats', get_net_stats)
 
+    def get_db_stats(self):
+        get_db_stats = {
+        }
+        return self.rpc.send_request('/get_db_stats', get_db_stats)
+
+    def scan_outputs(self, view_key, spend_public_keys, start_height, count = 0):
+        scan_outputs = {
+            'view_key': view_key,
+            'spend_public_keys': spend_public_keys,
+            'start_height': start_height,
+            'count': count,
+        }
+        return self.rpc.send_request('/scan_outputs', scan_outputs)
+
     def get_limit(self):
         get_limit = {
         }